@@ -54,6 +54,9 @@
  *           In this use case the functionality for New Alerts or Unread Alerts is based on which Radio Button is enabled.
  * 3) Once configured for Alert Notifications as mentioned above, Alerts generated from Server(i.e ANS) can be monitored through traces.
  *
+ * Commands received over WICED HCI are queued, so several can be sent without waiting for results.
+ * ANC sends them to the ANS one at a time in order, and reports the result of each one with the Command Complete event.
+ *
  */
 #include "sparcommon.h"
 #include "wiced_bt_dev.h"
@@ -69,6 +72,9 @@
 #include "wiced_hal_nvram.h"
 #include "wiced_result.h"
 #include "hci_control_api.h"
+#include "hci_control_dispatch.h"
+#include "gatt_disc_cache.h"
+#include "bond_store.h"
 #include "wiced_app_cfg.h"
 #include "wiced_platform.h"
 #include "wiced_bt_anc.h"
@@ -81,6 +87,8 @@
 
 #if defined WICED_BT_TRACE_ENABLE || defined TEST_HCI_CONTROL || defined HCI_TRACE_OVER_TRANSPORT
 #include "wiced_transport.h"
+#include "transport_pool.h"
+#include "hci_trace_ring.h"
 #endif
 
 #ifndef TEST_HCI_CONTROL
@@ -105,15 +113,43 @@
 #endif
 
 #define ANC_LOCAL_KEYS_NVRAM_ID                 WICED_NVRAM_VSID_START
-#define ANC_PAIRED_KEYS_NVRAM_ID                (WICED_NVRAM_VSID_START+1)
+#define ANC_PAIRED_KEYS_NVRAM_ID                (WICED_NVRAM_VSID_START+1)    /* bond store of one device, 2 ids */
+#define ANC_DISC_CACHE_NVRAM_ID                 (WICED_NVRAM_VSID_START+3)    /* cache of the bonded device, 1 id */
 
 /******************************************************************************************
  *                                      Constants
  *****************************************************************************************/
+/* Number of host commands that can wait for the ANS */
+#ifndef ANC_CMD_QUEUE_SIZE
+#define ANC_CMD_QUEUE_SIZE                      8
+#endif
+
+/* Result of a queued command: opcode, status, GATT status */
+#ifndef HCI_CONTROL_ANC_EVENT_COMMAND_COMPLETE
+#define HCI_CONTROL_ANC_EVENT_COMMAND_COMPLETE  ( ( HCI_CONTROL_GROUP_ANC << 8 ) | 0x20 )
+#endif
 
 /******************************************************************************************
  *                                     Structures
  ******************************************************************************************/
+/* Command waiting for the ANS */
+typedef struct
+{
+    uint16_t opcode;
+    uint8_t  param[2];                  /* control alerts command id and category */
+} anc_cmd_t;
+
+/* Commands are sent to the ANS one at a time, the first one in the queue is in progress */
+typedef struct
+{
+#define ANC_CMD_STATE_IDLE          0   /* first command not sent yet */
+#define ANC_CMD_STATE_SENT          1   /* waiting for the library result */
+#define ANC_CMD_STATE_WAIT_AUTH     2   /* insufficient authentication, sent again once encrypted */
+    uint8_t   state;
+    uint8_t   first;
+    uint8_t   count;
+    anc_cmd_t cmd[ANC_CMD_QUEUE_SIZE];
+} anc_cmd_queue_t;
 
 /******************************************************************************************
  *                                 Function Prototypes
@@ -127,6 +163,8 @@ static void                   anc_set_advertisement_data();
 static wiced_bt_gatt_status_t anc_gatt_operation_complete(wiced_bt_gatt_operation_complete_t *p_data);
 static wiced_bt_gatt_status_t anc_gatt_discovery_result(wiced_bt_gatt_discovery_result_t *p_data);
 static wiced_bt_gatt_status_t anc_gatt_discovery_complete(wiced_bt_gatt_discovery_complete_t *p_data);
+static void                   anc_start_service_discovery(void);
+static wiced_bool_t           anc_is_bonded(wiced_bt_device_address_t bd_addr);
 static void                   anc_start_pair(void);
 static void                   anc_load_keys_to_addr_resolution_db(void);
 static wiced_bool_t           anc_save_link_keys(wiced_bt_device_link_keys_t *p_keys);
@@ -134,8 +172,10 @@ static wiced_bool_t           anc_read_link_keys(wiced_bt_device_link_keys_t *p_
 static void                   anc_process_write_rsp(wiced_bt_gatt_operation_complete_t *p_data);
 static void                   anc_process_read_rsp(wiced_bt_gatt_operation_complete_t *p_data);
 static void                   anc_notification_handler(wiced_bt_gatt_operation_complete_t *p_data);
+static void                   anc_cmd_queue_next( void );
+static void                   anc_cmd_queue_result( wiced_bt_gatt_status_t gatt_status );
+static void                   anc_cmd_queue_flush( uint8_t status, wiced_bt_gatt_status_t gatt_status );
 static void                   anc_trigger_pending_action ( void );
-static void                   clear_anc_pending_cmd_context ( void );
 static void                   hci_control_send_anc_enabled( void );
 static void                   hci_control_send_anc_disabled( void );
 static void                   hci_control_send_supported_new_alerts( uint8_t status, uint16_t conn_id, uint8_t *p_data );
@@ -145,6 +185,7 @@ static void                   hci_control_send_enable_new_alerts_result( uint8_t
 static void                   hci_control_send_disable_new_alerts_result( uint8_t status, uint16_t conn_id );
 static void                   hci_control_send_enable_unread_alerts_result(uint8_t status, uint16_t conn_id);
 static void                   hci_control_send_disable_unread_alerts_result( uint8_t status, uint16_t conn_id );
+static void                   hci_control_send_command_complete( uint16_t opcode, uint8_t status, uint8_t gatt_status );
 static const char *           alert_type_name (wiced_bt_anp_alert_category_id_t id);
 #ifndef TEST_HCI_CONTROL
 static void                   anc_interrupt_handler(void* user_data, uint8_t value );
@@ -172,23 +213,23 @@ typedef struct
 }anc_app_state_t;
 
 anc_app_state_t anc_app_state;
+gatt_disc_cache_t anc_disc_cache;
+bond_store_t anc_bond_store;
 
 
-/* context of command that is failed due to gatt insufficient authentication.
-Need to re trigger the command after anc establish authentication with ans */
-uint8_t    anc_pending_cmd_context[4] = {0};
+/* host commands in the order they are sent to the ANS. A command that fails due to gatt
+insufficient authentication stays first and is sent again after anc establish authentication with ans */
+anc_cmd_queue_t anc_cmd_queue;
 
 #if defined WICED_BT_TRACE_ENABLE || defined HCI_TRACE_OVER_TRANSPORT || defined TEST_HCI_CONTROL
 
-#define TRANS_UART_BUFFER_SIZE          1024
-#define ANC_TRANS_MAX_BUFFERS          2
-
 #ifdef TEST_HCI_CONTROL
 static uint32_t  anc_proc_rx_hci_cmd(uint8_t *p_data, uint32_t length);
 void anc_transport_status( wiced_transport_type_t type );
 #endif
 
-const wiced_transport_cfg_t transport_cfg =
+/* the receive buffers are set from wiced_app_transport_pool_cfg */
+wiced_transport_cfg_t transport_cfg =
 {
     .type = WICED_TRANSPORT_UART,
     .cfg =
@@ -201,8 +242,8 @@ const wiced_transport_cfg_t transport_cfg =
     },
     .rx_buff_pool_cfg =
     {
-        .buffer_size  = TRANS_UART_BUFFER_SIZE,
-        .buffer_count = 1
+        .buffer_size  = 0,
+        .buffer_count = 0
     },
 #ifdef TEST_HCI_CONTROL
     .p_status_handler = anc_transport_status,
@@ -214,10 +255,19 @@ const wiced_transport_cfg_t transport_cfg =
     .p_tx_complete_cback = NULL
 };
 
-wiced_transport_buffer_pool_t*  host_trans_pool;
+transport_pool_t anc_transport_pool;
 static void anc_trace_callback(wiced_bt_hci_trace_type_t type, uint16_t length, uint8_t* p_data);
 #endif
 
+#ifdef HCI_TRACE_OVER_TRANSPORT
+static void anc_trace_send(wiced_bt_hci_trace_type_t type, uint16_t length, uint8_t* p_data);
+
+/* HCI traces are kept in the ring and sent to the host in the background */
+static const hci_trace_ring_cfg_t anc_trace_ring_cfg = HCI_TRACE_RING_CFG_DEFAULT(anc_trace_send);
+static uint8_t anc_trace_ring_buf[HCI_TRACE_RING_BUF_SIZE(HCI_TRACE_RING_SLOTS, HCI_TRACE_RING_MAX_PAYLOAD)];
+static hci_trace_ring_t anc_trace_ring;
+#endif
+
 #ifndef TEST_HCI_CONTROL
 uint32_t anc_app_timer_count=0;
 static uint8_t c = 0;
@@ -237,10 +287,8 @@ APPLICATION_START()
     wiced_result_t result;
 
 #if defined WICED_BT_TRACE_ENABLE || defined HCI_TRACE_OVER_TRANSPORT
-    wiced_transport_init(&transport_cfg);
-
-//    // create special pool for sending data to the MCU
-    host_trans_pool = wiced_transport_create_buffer_pool(TRANS_UART_BUFFER_SIZE, ANC_TRANS_MAX_BUFFERS);
+    // initialize the transport with the buffers of wiced_app_cfg.c, and the pool for sending data to the MCU
+    transport_pool_init(&anc_transport_pool, &transport_cfg, &wiced_app_transport_pool_cfg);
 
     // Set the debug uart as WICED_ROUTE_DEBUG_NONE to get rid of prints
     // wiced_set_debug_uart(WICED_ROUTE_DEBUG_NONE);
@@ -269,7 +317,7 @@ APPLICATION_START()
     WICED_BT_TRACE("ANC APP START\n");
 
     memset(&anc_app_state, 0, sizeof(anc_app_state));
-    memset(anc_pending_cmd_context, 0, sizeof(anc_pending_cmd_context));
+    memset(&anc_cmd_queue, 0, sizeof(anc_cmd_queue));
 
     /* Initialize Stack and Register Management Callback */
     wiced_bt_stack_init(anc_management_callback, &wiced_bt_cfg_settings, wiced_bt_cfg_buf_pools);
@@ -299,8 +347,9 @@ void anc_application_init()
 
     WICED_BT_TRACE("wiced_bt_gatt_register: %d\n", gatt_status);
 
-#ifdef WICED_BT_TRACE_ENABLE
+#ifdef HCI_TRACE_OVER_TRANSPORT
     /* Register callback for receiving hci traces */
+    hci_trace_ring_init(&anc_trace_ring, &anc_trace_ring_cfg, anc_trace_ring_buf, sizeof(anc_trace_ring_buf));
     wiced_bt_dev_register_hci_trace(anc_trace_callback);
 #endif
 
@@ -313,6 +362,8 @@ void anc_application_init()
     wiced_bt_set_pairable_mode(WICED_TRUE, 0);
 
     /* Load the address resolution DB with the keys stored in the NVRAM */
+    bond_store_init(&anc_bond_store, ANC_PAIRED_KEYS_NVRAM_ID, 1);
+    gatt_disc_cache_init(&anc_disc_cache, ANC_DISC_CACHE_NVRAM_ID, &anc_bond_store);
     anc_load_keys_to_addr_resolution_db();
 
     /* Set the advertising params and make the device discoverable */
@@ -391,8 +442,9 @@ static wiced_result_t anc_management_callback(wiced_bt_management_evt_t event, w
         WICED_BT_TRACE("Encryption Status Event: bd (%B) res %d", p_event_data->encryption_status.bd_addr, p_event_data->encryption_status.result);
         if (p_event_data->encryption_status.result == WICED_BT_SUCCESS)
             anc_trigger_pending_action();
-        else /* pending command no more valid to send if authentication fails */
-            clear_anc_pending_cmd_context();
+        else if (anc_cmd_queue.state == ANC_CMD_STATE_WAIT_AUTH)
+            /* pending commands no more valid to send if authentication fails */
+            anc_cmd_queue_flush(HCI_CONTROL_STATUS_FAILED, WICED_BT_GATT_INSUF_AUTHENTICATION);
         break;
 
     case BTM_SECURITY_REQUEST_EVT:
@@ -490,8 +542,6 @@ static wiced_bt_gatt_status_t anc_gatts_callback(wiced_bt_gatt_evt_t event, wice
  */
 static void anc_connection_up(wiced_bt_gatt_connection_status_t *p_conn_status)
 {
-    wiced_bt_gatt_status_t  status;
-
     WICED_BT_TRACE("%s\n", __FUNCTION__);
 
     anc_app_state.conn_id = p_conn_status->conn_id;
@@ -508,21 +558,44 @@ static void anc_connection_up(wiced_bt_gatt_connection_status_t *p_conn_status)
     anc_app_state.anc_s_handle = 0;
     anc_app_state.anc_e_handle = 0;
 
-   // perform primary service search
+    // a bonded peer may have its Alert Notification Service range cached
+    if (!anc_is_bonded(anc_app_state.remote_addr) || !gatt_disc_cache_check(&anc_disc_cache, anc_app_state.conn_id, anc_app_state.remote_addr))
+    {
+        anc_start_service_discovery();
+    }
+}
+
+/*
+ * Look for the Alert Notification Service with a primary service search
+ */
+static void anc_start_service_discovery(void)
+{
+    wiced_bt_gatt_status_t  status;
+
     status = wiced_bt_util_send_gatt_discover(anc_app_state.conn_id, GATT_DISCOVER_SERVICES_ALL, UUID_ATTRIBUTE_PRIMARY_SERVICE, 1, 0xffff);
     WICED_BT_TRACE("start discover status:%d\n", status);
 }
 
+/*
+ * Check if the link keys of a device are saved
+ */
+static wiced_bool_t anc_is_bonded(wiced_bt_device_address_t bd_addr)
+{
+    return bond_store_is_bonded(&anc_bond_store, bd_addr);
+}
+
 static void anc_connection_down(wiced_bt_gatt_connection_status_t *p_conn_status)
 {
     WICED_BT_TRACE("%s\n", __FUNCTION__);
 
+    gatt_disc_cache_connection_down(&anc_disc_cache, p_conn_status->conn_id);
+
     anc_app_state.conn_id         = 0;
     anc_app_state.anc_s_handle   = 0;
     anc_app_state.anc_e_handle   = 0;
     anc_app_state.discovery_state = ANC_DISCOVERY_STATE_SERVICE;
-    /* pending command no more valid now */
-    clear_anc_pending_cmd_context();
+    /* pending commands no more valid now */
+    anc_cmd_queue_flush(HCI_CONTROL_STATUS_NOT_CONNECTED, WICED_BT_GATT_ERROR);
 
     memset(anc_app_state.remote_addr, 0, sizeof(wiced_bt_device_address_t));
     // tell library that connection is down
@@ -540,6 +613,7 @@ static wiced_bt_gatt_status_t anc_gatt_operation_complete(wiced_bt_gatt_operatio
     {
     case GATTC_OPTYPE_WRITE:
         anc_process_write_rsp(p_data);
+        anc_cmd_queue_next();
         break;
 
     case GATTC_OPTYPE_CONFIG:
@@ -551,7 +625,23 @@ static wiced_bt_gatt_status_t anc_gatt_operation_complete(wiced_bt_gatt_operatio
         break;
 
     case GATTC_OPTYPE_READ:
-        anc_process_read_rsp(p_data);
+        switch (gatt_disc_cache_read_rsp(&anc_disc_cache, p_data, &anc_app_state.anc_s_handle, &anc_app_state.anc_e_handle))
+        {
+        case GATT_DISC_CACHE_HIT:
+            // database did not change, tell WICED BT ANC library to start its discovery
+            anc_app_state.discovery_state = ANC_DISCOVERY_STATE_ANC;
+            wiced_bt_anc_discover(anc_app_state.conn_id, anc_app_state.anc_s_handle, anc_app_state.anc_e_handle);
+            break;
+
+        case GATT_DISC_CACHE_MISS:
+            anc_start_service_discovery();
+            break;
+
+        default:
+            anc_process_read_rsp(p_data);
+            anc_cmd_queue_next();
+            break;
+        }
         break;
 
     case GATTC_OPTYPE_INDICATION:
@@ -673,67 +763,123 @@ static void anc_notification_handler(wiced_bt_gatt_operation_complete_t *p_data)
     }
 }
 
-static void clear_anc_pending_cmd_context (void)
-{
-    WICED_BT_TRACE ("%s \n", __FUNCTION__);
-    memset(anc_pending_cmd_context, 0, sizeof(anc_pending_cmd_context));
-}
-
-static void anc_trigger_pending_action (void)
+/*
+ * Send a queued command to the ANS using the WICED BT ANC library
+ */
+static wiced_bt_gatt_status_t anc_cmd_send(anc_cmd_t *p_cmd)
 {
-    wiced_bt_gatt_status_t  gatt_status = WICED_BT_GATT_SUCCESS;
-    if (!anc_pending_cmd_context[0])
-    {
-        WICED_BT_TRACE(" anc_trigger_pending_action No commands pending! \n");
-        return;
-    }
-
-    switch (( HCI_CONTROL_GROUP_ANC << 8 ) | anc_pending_cmd_context[0])
+    switch (p_cmd->opcode)
     {
     case HCI_CONTROL_ANC_COMMAND_READ_SERVER_SUPPORTED_NEW_ALERTS:
-        gatt_status = wiced_bt_anc_read_server_supported_new_alerts( anc_app_state.conn_id );
-        break;
+        return wiced_bt_anc_read_server_supported_new_alerts( anc_app_state.conn_id );
 
     case HCI_CONTROL_ANC_COMMAND_READ_SERVER_SUPPORTED_UNREAD_ALERTS:
-        gatt_status = wiced_bt_anc_read_server_supported_unread_alerts(anc_app_state.conn_id);
-        break;
+        return wiced_bt_anc_read_server_supported_unread_alerts( anc_app_state.conn_id );
 
     case HCI_CONTROL_ANC_COMMAND_CONTROL_ALERTS:
-        gatt_status = wiced_bt_anc_control_required_alerts( anc_app_state.conn_id, anc_pending_cmd_context[1], anc_pending_cmd_context[2] );
-        break;
+        return wiced_bt_anc_control_required_alerts( anc_app_state.conn_id, p_cmd->param[0], p_cmd->param[1] );
 
     case HCI_CONTROL_ANC_COMMAND_ENABLE_NEW_ALERTS:
-        gatt_status = wiced_bt_anc_enable_new_alerts( anc_app_state.conn_id );
-        break;
+        return wiced_bt_anc_enable_new_alerts( anc_app_state.conn_id );
 
     case HCI_CONTROL_ANC_COMMAND_ENABLE_UNREAD_ALERTS:
-        gatt_status = wiced_bt_anc_enable_unread_alerts( anc_app_state.conn_id );
-        break;
+        return wiced_bt_anc_enable_unread_alerts( anc_app_state.conn_id );
 
     case HCI_CONTROL_ANC_COMMAND_DISABLE_NEW_ALERTS:
-        gatt_status = wiced_bt_anc_disable_new_alerts( anc_app_state.conn_id );
-        break;
+        return wiced_bt_anc_disable_new_alerts( anc_app_state.conn_id );
 
     case HCI_CONTROL_ANC_COMMAND_DISABLE_UNREAD_ALERTS:
-        gatt_status = wiced_bt_anc_disable_unread_alerts( anc_app_state.conn_id );
-        break;
+        return wiced_bt_anc_disable_unread_alerts( anc_app_state.conn_id );
+
     default:
         WICED_BT_TRACE("unkknown pending HCI command \n");
-        break;
+        return WICED_BT_GATT_REQ_NOT_SUPPORTED;
+    }
+}
+
+/*
+ * Report the result of the first queued command and remove it from the queue
+ */
+static void anc_cmd_queue_done(uint8_t status, wiced_bt_gatt_status_t gatt_status)
+{
+    hci_control_send_command_complete(anc_cmd_queue.cmd[anc_cmd_queue.first].opcode, status, gatt_status);
+
+    anc_cmd_queue.first = (anc_cmd_queue.first + 1) % ANC_CMD_QUEUE_SIZE;
+    anc_cmd_queue.count--;
+    anc_cmd_queue.state = ANC_CMD_STATE_IDLE;
+}
+
+/*
+ * Send the next queued command if the previous one is complete. Called once the
+ * library is done with a GATT response, so it is not reentered from its callback.
+ */
+static void anc_cmd_queue_next(void)
+{
+    wiced_bt_gatt_status_t  gatt_status;
+
+    while ((anc_cmd_queue.count != 0) && (anc_cmd_queue.state == ANC_CMD_STATE_IDLE))
+    {
+        gatt_status = anc_cmd_send(&anc_cmd_queue.cmd[anc_cmd_queue.first]);
+        if (gatt_status == WICED_BT_GATT_SUCCESS)
+        {
+            anc_cmd_queue.state = ANC_CMD_STATE_SENT;
+        }
+        else
+        {
+            /* should not keep trying if fail in sending the command */
+            WICED_BT_TRACE("anc_cmd_queue_next %04x %d \n", anc_cmd_queue.cmd[anc_cmd_queue.first].opcode, gatt_status);
+            anc_cmd_queue_done(HCI_CONTROL_STATUS_FAILED, gatt_status);
+        }
+    }
+}
+
+/*
+ * Library result of the command in progress
+ */
+static void anc_cmd_queue_result(wiced_bt_gatt_status_t gatt_status)
+{
+    if (anc_cmd_queue.state != ANC_CMD_STATE_SENT)
+        return;
+
+    if (gatt_status == WICED_BT_GATT_INSUF_AUTHENTICATION)
+        anc_cmd_queue.state = ANC_CMD_STATE_WAIT_AUTH;
+    else
+        anc_cmd_queue_done((gatt_status == WICED_BT_GATT_SUCCESS) ? HCI_CONTROL_STATUS_SUCCESS : HCI_CONTROL_STATUS_FAILED, gatt_status);
+}
+
+/*
+ * Drop all queued commands, reporting the status of each one
+ */
+static void anc_cmd_queue_flush(uint8_t status, wiced_bt_gatt_status_t gatt_status)
+{
+    WICED_BT_TRACE ("%s %d commands\n", __FUNCTION__, anc_cmd_queue.count);
+
+    while (anc_cmd_queue.count != 0)
+    {
+        anc_cmd_queue_done(status, gatt_status);
     }
+    anc_cmd_queue.first = 0;
+}
 
-    if (gatt_status != WICED_BT_GATT_SUCCESS)
+/*
+ * Link is encrypted, send again the command that failed due to insufficient authentication
+ */
+static void anc_trigger_pending_action (void)
+{
+    if (anc_cmd_queue.state != ANC_CMD_STATE_WAIT_AUTH)
     {
-        WICED_BT_TRACE("anc_trigger_pending_action %d \n", gatt_status);
+        WICED_BT_TRACE(" anc_trigger_pending_action No commands pending! \n");
+        return;
     }
 
-    /* should not keep trying if fail in sending pending command */
-    clear_anc_pending_cmd_context();
+    anc_cmd_queue.state = ANC_CMD_STATE_IDLE;
+    anc_cmd_queue_next();
 }
 
 static void anc_callback(wiced_bt_anc_event_t event, wiced_bt_anc_event_data_t *p_data)
 {
     wiced_bt_gatt_status_t result = WICED_BT_GATT_SUCCESS;
+    wiced_bool_t           cmd_result = WICED_TRUE;
 
     switch(event)
     {
@@ -742,8 +888,15 @@ static void anc_callback(wiced_bt_anc_event_t event, wiced_bt_anc_event_data_t *
             result = p_data->discovery_result.status;
             if (result == WICED_BT_GATT_SUCCESS)
             {
+                gatt_disc_cache_store(&anc_disc_cache, anc_app_state.remote_addr, anc_app_state.anc_s_handle, anc_app_state.anc_e_handle);
                 hci_control_send_anc_enabled();
             }
+            else
+            {
+                // the cached range, if it was used, is not right
+                gatt_disc_cache_invalidate(&anc_disc_cache, anc_app_state.remote_addr);
+            }
+            cmd_result = WICED_FALSE;
             break;
 
         case WICED_BT_ANC_READ_SUPPORTED_NEW_ALERTS_RESULT:
@@ -825,15 +978,18 @@ static void anc_callback(wiced_bt_anc_event_t event, wiced_bt_anc_event_data_t *
                 alert_type_name(p_data->new_alert_notification.new_alert_type),
                 p_data->new_alert_notification.new_alert_count,
                 p_data->new_alert_notification.p_last_alert_data);
+            cmd_result = WICED_FALSE;
             break;
 
         case WICED_BT_ANC_EVENT_UNREAD_ALERT_NOTIFICATION:
             WICED_BT_TRACE("Unread Alert type: %s Count: %d \n",
                 alert_type_name(p_data->unread_alert_notification.unread_alert_type),
                 p_data->unread_alert_notification.unread_count);
+            cmd_result = WICED_FALSE;
             break;
 
         default:
+            cmd_result = WICED_FALSE;
             break;
     }
     if ( result == WICED_BT_GATT_INSUF_AUTHENTICATION )
@@ -843,10 +999,10 @@ static void anc_callback(wiced_bt_anc_event_t event, wiced_bt_anc_event_data_t *
 #endif
         anc_start_pair();
     }
-    else
+    if (cmd_result)
     {
-        /* pending command no more valid other than authentication failure cases */
-        clear_anc_pending_cmd_context();
+        /* the command in progress is complete other than authentication failure cases */
+        anc_cmd_queue_result(result);
     }
 }
 
@@ -915,6 +1071,40 @@ void ans_start_advertisements (void)
     WICED_BT_TRACE("wiced_bt_start_advertisements %d\n", status);
 }
 
+/*
+ * Queue a command for the ANS, it is sent once the commands ahead of it complete
+ */
+static uint8_t anc_cmd_queue_put(uint16_t opcode, uint8_t *p_data, uint32_t data_len)
+{
+    anc_cmd_t *p_cmd;
+
+    if (anc_cmd_queue.count == ANC_CMD_QUEUE_SIZE)
+    {
+        WICED_BT_TRACE("ANC command queue full \n");
+        return HCI_CONTROL_STATUS_DISALLOWED;
+    }
+
+    p_cmd = &anc_cmd_queue.cmd[(anc_cmd_queue.first + anc_cmd_queue.count) % ANC_CMD_QUEUE_SIZE];
+    p_cmd->opcode = opcode;
+    memset(p_cmd->param, 0, sizeof(p_cmd->param));
+    memcpy(p_cmd->param, p_data, (data_len < sizeof(p_cmd->param)) ? data_len : sizeof(p_cmd->param));
+    anc_cmd_queue.count++;
+
+    return HCI_CONTROL_STATUS_SUCCESS;
+}
+
+/* GATT commands to the ANS, sorted by opcode. Each one is queued and sent in order */
+static const hci_control_cmd_entry_t anc_cmd_table[] =
+{
+    HCI_CONTROL_CMD_ENTRY(HCI_CONTROL_ANC_COMMAND_READ_SERVER_SUPPORTED_NEW_ALERTS,     0,  anc_cmd_queue_put),
+    HCI_CONTROL_CMD_ENTRY(HCI_CONTROL_ANC_COMMAND_READ_SERVER_SUPPORTED_UNREAD_ALERTS,  0,  anc_cmd_queue_put),
+    HCI_CONTROL_CMD_ENTRY(HCI_CONTROL_ANC_COMMAND_CONTROL_ALERTS,                       2,  anc_cmd_queue_put),
+    HCI_CONTROL_CMD_ENTRY(HCI_CONTROL_ANC_COMMAND_ENABLE_NEW_ALERTS,                    0,  anc_cmd_queue_put),
+    HCI_CONTROL_CMD_ENTRY(HCI_CONTROL_ANC_COMMAND_ENABLE_UNREAD_ALERTS,                 0,  anc_cmd_queue_put),
+    HCI_CONTROL_CMD_ENTRY(HCI_CONTROL_ANC_COMMAND_DISABLE_NEW_ALERTS,                   0,  anc_cmd_queue_put),
+    HCI_CONTROL_CMD_ENTRY(HCI_CONTROL_ANC_COMMAND_DISABLE_UNREAD_ALERTS,                0,  anc_cmd_queue_put),
+};
+
 /*
  * Handle received command over UART. Please refer to the WICED HCI Control
  * Protocol for details on the protocol.  The function converts from the WICED
@@ -925,8 +1115,7 @@ uint32_t  anc_proc_rx_hci_cmd(uint8_t *p_buffer, uint32_t length)
     uint16_t                opcode;
     uint8_t*                p_data = p_buffer;
     uint16_t                payload_len;
-    uint8_t                 status = HCI_CONTROL_STATUS_SUCCESS;
-    wiced_bt_gatt_status_t  gatt_status = WICED_BT_GATT_SUCCESS;
+    uint8_t                 status;
 
     // WICED_BT_TRACE("hci_control_proc_rx_cmd:%d\n", length);
 
@@ -935,94 +1124,53 @@ uint32_t  anc_proc_rx_hci_cmd(uint8_t *p_buffer, uint32_t length)
         return HCI_CONTROL_STATUS_INVALID_ARGS;
     }
 
+    transport_pool_rx_get(&anc_transport_pool);
+
     //Expected minimum 4 byte as the wiced header
     if (length < 4)
     {
         WICED_BT_TRACE("invalid params\n");
-        wiced_transport_free_buffer(p_data);
+        transport_pool_rx_free(&anc_transport_pool, p_data);
         return HCI_CONTROL_STATUS_INVALID_ARGS;
     }
-    if (anc_app_state.conn_id == 0)
+
+    STREAM_TO_UINT16(opcode, p_data);       // Get OpCode
+    STREAM_TO_UINT16(payload_len, p_data);  // Gen Payload Length
+    WICED_BT_TRACE("cmd_opcode 0x%02x %s payload_len %d \n", opcode,
+            hci_control_cmd_name(anc_cmd_table, HCI_CONTROL_CMD_TABLE_SIZE(anc_cmd_table), opcode), payload_len);
+
+    if (opcode == HCI_CONTROL_MISC_COMMAND_GET_VERSION)
     {
-        STREAM_TO_UINT16(opcode, p_data);       // Get OpCode
-        if(opcode == HCI_CONTROL_MISC_COMMAND_GET_VERSION)
-        {
-            WICED_BT_TRACE("HCI_CONTROL_MISC_COMMAND_GET_VERSION\n");
-            anc_handle_get_version();
+#ifdef WICED_BT_TRACE_ENABLE
+        hci_control_check_cmd_table(anc_cmd_table, HCI_CONTROL_CMD_TABLE_SIZE(anc_cmd_table));
+#endif
+        anc_handle_get_version();
+        if (anc_app_state.conn_id == 0)
             ans_start_advertisements();
-        }
-        else
-        {
-            WICED_BT_TRACE("no connection\n");
-            status = HCI_CONTROL_STATUS_NOT_CONNECTED;
-        }
+        status = HCI_CONTROL_STATUS_SUCCESS;
     }
-    else if (anc_pending_cmd_context[0])
+    else if (anc_app_state.conn_id == 0)
     {
-        /* previous command is not yet completed. Hold on until complete */
-        WICED_BT_TRACE("ANC busy with previous command \n");
-        status = HCI_CONTROL_STATUS_DISALLOWED;
+        WICED_BT_TRACE("no connection\n");
+        status = HCI_CONTROL_STATUS_NOT_CONNECTED;
     }
-    else
+    else if (payload_len > length - 4)
     {
-        STREAM_TO_UINT16(opcode, p_data);       // Get OpCode
-        STREAM_TO_UINT16(payload_len, p_data);  // Gen Payload Length
-        WICED_BT_TRACE("cmd_opcode 0x%02x payload_len %d \n", opcode, payload_len);
-
-        anc_pending_cmd_context[0] = opcode & 0xff;
-        switch (opcode)
-        {
-        case HCI_CONTROL_ANC_COMMAND_READ_SERVER_SUPPORTED_NEW_ALERTS:
-            gatt_status = wiced_bt_anc_read_server_supported_new_alerts( anc_app_state.conn_id );
-            break;
-
-        case HCI_CONTROL_ANC_COMMAND_READ_SERVER_SUPPORTED_UNREAD_ALERTS:
-            gatt_status = wiced_bt_anc_read_server_supported_unread_alerts(anc_app_state.conn_id);
-            break;
-
-        case HCI_CONTROL_ANC_COMMAND_CONTROL_ALERTS:
-            anc_pending_cmd_context[1] = p_data[0];
-            anc_pending_cmd_context[2] = p_data[1];
-            gatt_status = wiced_bt_anc_control_required_alerts( anc_app_state.conn_id, p_data[0], p_data[1] );
-            break;
-
-        case HCI_CONTROL_ANC_COMMAND_ENABLE_NEW_ALERTS:
-            gatt_status = wiced_bt_anc_enable_new_alerts( anc_app_state.conn_id );
-            break;
-
-        case HCI_CONTROL_ANC_COMMAND_ENABLE_UNREAD_ALERTS:
-            gatt_status = wiced_bt_anc_enable_unread_alerts( anc_app_state.conn_id );
-            break;
-
-        case HCI_CONTROL_ANC_COMMAND_DISABLE_NEW_ALERTS:
-            gatt_status = wiced_bt_anc_disable_new_alerts( anc_app_state.conn_id );
-            break;
-
-        case HCI_CONTROL_ANC_COMMAND_DISABLE_UNREAD_ALERTS:
-            gatt_status = wiced_bt_anc_disable_unread_alerts( anc_app_state.conn_id );
-            break;
-
-       case HCI_CONTROL_MISC_COMMAND_GET_VERSION:
-            anc_handle_get_version();
-            break;
-
-        default:
-            WICED_BT_TRACE("ignored\n", opcode);
-            status = HCI_CONTROL_STATUS_UNKNOWN_COMMAND;
-            break;
-        }
+        status = HCI_CONTROL_STATUS_INVALID_ARGS;
     }
-
-    if (gatt_status != WICED_BT_GATT_SUCCESS)
+    else
     {
-        /* pending command no more valid other than authentication failure cases */
-        clear_anc_pending_cmd_context();
-        status = HCI_CONTROL_STATUS_FAILED;
+        /* commands are accepted while previous ones are not yet completed */
+        status = hci_control_dispatch(anc_cmd_table, HCI_CONTROL_CMD_TABLE_SIZE(anc_cmd_table), opcode, p_data, payload_len);
     }
+
     wiced_transport_send_data(HCI_CONTROL_ANC_EVENT_COMMAND_STATUS, &status, 1);
 
+    // start the command if the ANS is not busy with previous ones
+    anc_cmd_queue_next();
+
     // Freeing the buffer in which data is received
-    wiced_transport_free_buffer(p_buffer);
+    transport_pool_rx_free(&anc_transport_pool, p_buffer);
     return HCI_CONTROL_STATUS_SUCCESS;
 }
 #endif
@@ -1040,23 +1188,7 @@ void anc_start_pair(void)
  */
 void anc_load_keys_to_addr_resolution_db(void)
 {
-    uint8_t                     bytes_read;
-    wiced_result_t              result;
-    wiced_bt_device_link_keys_t keys;
-
-    bytes_read = wiced_hal_read_nvram(ANC_PAIRED_KEYS_NVRAM_ID, sizeof(keys), (uint8_t *)&keys, &result);
-
-    WICED_BT_TRACE(" [%s] read status %d bytes read %d \n", __FUNCTION__, result, bytes_read);
-
-    // if failed to read NVRAM, there is nothing saved at that location
-    if (result == WICED_SUCCESS)
-    {
-#ifdef CYW20706A2
-        result = wiced_bt_dev_add_device_to_address_resolution_db(&keys, keys.key_data.ble_addr_type);
-#else
-        result = wiced_bt_dev_add_device_to_address_resolution_db(&keys);
-#endif
-    }
+    bond_store_load_addr_resolution_db(&anc_bond_store);
 }
 
 /*
@@ -1064,12 +1196,7 @@ void anc_load_keys_to_addr_resolution_db(void)
  */
 wiced_bool_t anc_save_link_keys(wiced_bt_device_link_keys_t *p_keys)
 {
-    uint8_t          bytes_written;
-    wiced_result_t   result;
-
-    bytes_written = wiced_hal_write_nvram(ANC_PAIRED_KEYS_NVRAM_ID, sizeof(wiced_bt_device_link_keys_t), (uint8_t *)p_keys, &result);
-    WICED_BT_TRACE("Saved %d bytes at id:%d \n", bytes_written, ANC_PAIRED_KEYS_NVRAM_ID);
-    return (bytes_written == sizeof (wiced_bt_device_link_keys_t));
+    return bond_store_save(&anc_bond_store, p_keys);
 }
 
 /*
@@ -1077,21 +1204,24 @@ wiced_bool_t anc_save_link_keys(wiced_bt_device_link_keys_t *p_keys)
  */
 wiced_bool_t anc_read_link_keys(wiced_bt_device_link_keys_t *p_keys)
 {
-    uint8_t         bytes_read;
-    wiced_result_t  result;
-
-    bytes_read = wiced_hal_read_nvram(ANC_PAIRED_KEYS_NVRAM_ID, sizeof(wiced_bt_device_link_keys_t), (uint8_t *)p_keys, &result);
-    WICED_BT_TRACE("read %d bytes at id:%d \n", bytes_read, ANC_PAIRED_KEYS_NVRAM_ID);
-    return (bytes_read == sizeof (wiced_bt_device_link_keys_t));
+    return bond_store_read(&anc_bond_store, p_keys);
 }
 
 #ifdef HCI_TRACE_OVER_TRANSPORT
 /*
- *  Pass protocol traces up over the transport
+ *  Keep protocol traces in the ring, they are passed up over the transport in the background
  */
 void anc_trace_callback(wiced_bt_hci_trace_type_t type, uint16_t length, uint8_t* p_data)
 {
-    wiced_transport_send_hci_trace(host_trans_pool, type, length, p_data);
+    hci_trace_ring_put(&anc_trace_ring, type, length, p_data);
+}
+
+/*
+ *  Pass a protocol trace from the ring up over the transport
+ */
+static void anc_trace_send(wiced_bt_hci_trace_type_t type, uint16_t length, uint8_t* p_data)
+{
+    transport_pool_send_hci_trace(&anc_transport_pool, type, length, p_data);
 }
 #endif
 
@@ -1195,6 +1325,22 @@ static void hci_control_send_disable_unread_alerts_result(uint8_t status, uint16
 #endif
 }
 
+static void hci_control_send_command_complete( uint16_t opcode, uint8_t status, uint8_t gatt_status )
+{
+    uint8_t event_data[4];
+
+    WICED_BT_TRACE( "[%s] opcode %04x status %d gatt_status %d\n", __FUNCTION__, opcode, status, gatt_status );
+
+    //Build event payload
+    event_data[0] = opcode & 0xff;
+    event_data[1] = (opcode >> 8) & 0xff;
+    event_data[2] = status;
+    event_data[3] = gatt_status;
+#ifdef TEST_HCI_CONTROL
+    wiced_transport_send_data(HCI_CONTROL_ANC_EVENT_COMMAND_COMPLETE, event_data, 4);
+#endif
+}
+
 #ifndef TEST_HCI_CONTROL
 void anc_app_timeout( uint32_t arg )
 {
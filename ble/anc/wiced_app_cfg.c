@@ -40,6 +40,8 @@
 #include "wiced_bt_ble.h"
 #include "wiced_bt_gatt.h"
 #include "wiced_bt_cfg.h"
+#include "transport_pool.h"
+#include "bond_store.h"
 
 /*****************************************************************************
  * wiced_bt core stack configuration
@@ -172,7 +174,7 @@ const wiced_bt_cfg_settings_t wiced_bt_cfg_settings =
     },
 
     /* LE Address Resolution DB size  */
-    .addr_resolution_db_size            = 5,                                                           /**< LE Address Resolution DB settings - effective only for pre 4.2 controller*/
+    .addr_resolution_db_size            = BOND_STORE_ADDR_RESOLUTION_DB_SIZE,                          /**< LE Address Resolution DB settings - effective only for pre 4.2 controller*/
 
 #ifdef CYW20706A2
     .max_mtu_size                       = 23,                                                         /**< Maximum MTU size for GATT connections, should be between 23 and (max_attr_len + 5) */
@@ -208,3 +210,34 @@ const wiced_bt_cfg_buf_pool_t wiced_bt_cfg_buf_pools[WICED_BT_CFG_NUM_BUF_POOLS]
     { 1024,     8   },      /* Large Buffer Pool  (used for HCI ACL messages) */
     { 1024,     5   },      /* Extra Large Buffer Pool - Used for avdt media packets and miscellaneous (if not needed, set buf_count to 0) */
 };
+
+/*****************************************************************************
+ * HCI transport buffers
+ *
+ * Each command from the host takes one rx buffer until it is processed, a
+ * burst of commands needs as many. The tx pool sends the HCI traces.
+ *****************************************************************************/
+#ifndef ANC_TRANS_RX_BUFFER_SIZE
+#define ANC_TRANS_RX_BUFFER_SIZE        1024
+#endif
+#ifndef ANC_TRANS_RX_BUFFER_COUNT
+#define ANC_TRANS_RX_BUFFER_COUNT       3
+#endif
+#ifndef ANC_TRANS_TX_BUFFER_SIZE
+#define ANC_TRANS_TX_BUFFER_SIZE        1024
+#endif
+#ifndef ANC_TRANS_TX_BUFFER_COUNT
+#define ANC_TRANS_TX_BUFFER_COUNT       2
+#endif
+#ifndef ANC_TRANS_LOW_WATER
+#define ANC_TRANS_LOW_WATER             1
+#endif
+
+const transport_pool_cfg_t wiced_app_transport_pool_cfg =
+{
+    .rx_buffer_size     = ANC_TRANS_RX_BUFFER_SIZE,
+    .rx_buffer_count    = ANC_TRANS_RX_BUFFER_COUNT,
+    .tx_buffer_size     = ANC_TRANS_TX_BUFFER_SIZE,
+    .tx_buffer_count    = ANC_TRANS_TX_BUFFER_COUNT,
+    .low_water          = ANC_TRANS_LOW_WATER,
+};
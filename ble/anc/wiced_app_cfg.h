@@ -42,9 +42,11 @@
 
 
 #include "wiced_bt_cfg.h"
+#include "transport_pool.h"
 
 extern const wiced_bt_cfg_settings_t wiced_bt_cfg_settings;
 extern const wiced_bt_cfg_buf_pool_t wiced_bt_cfg_buf_pools[];
 extern int wiced_app_cfg_get_num_buf_pools(void);
+extern const transport_pool_cfg_t wiced_app_transport_pool_cfg;
 
 #endif /* _WICED_APP_CFG_H_ */
@@ -58,6 +58,14 @@
 * configuration (for example to start or stop new alerts/unread alerts and to configure to send
 * only requested alert categories.)
 *
+* Alerts arriving in a burst are coalesced: counts are kept per category and, once the
+* alert window (ANS_ALERT_WINDOW_MS) closes, the client gets one New Alert and one Unread
+* Alert Status notification per category. The Generate Alerts command carries several
+* categories and alert counts in one frame.
+* Up to ANS_MAX_CLIENTS clients are served at the same time, scanning goes on while a client
+* can still connect. Each client enables its own categories, and every alert is notified to
+* all the clients that enabled its category.
+*
 * To test this snippet app use ClientControl application
 *
 * Features demonstrated
@@ -84,6 +92,8 @@
 #include "wiced_hal_nvram.h"
 #include "wiced_result.h"
 #include "hci_control_api.h"
+#include "hci_control_dispatch.h"
+#include "bond_store.h"
 #include "GeneratedSource/cycfg_gatt_db.h"
 
 #include "wiced_bt_anp.h"
@@ -91,7 +101,11 @@
 #include "string.h"
 #include "wiced_bt_stack.h"
 #include "wiced_transport.h"
+#include "transport_pool.h"
+#include "hci_trace_ring.h"
+#include "latency_probe.h"
 #include "wiced_hal_puart.h"
+#include "wiced_timer.h"
 
 #if ( defined(CYW20706A2) || defined(CYW20719B1) || defined(CYW20719B0) || defined(CYW20721B1) || defined(CYW20735B0) || defined(CYW43012C0) )
 #include "wiced_bt_app_common.h"
@@ -111,13 +125,47 @@
 #endif
 
 #define ANS_LOCAL_KEYS_NVRAM_ID         WICED_NVRAM_VSID_START
-#define ANS_PAIRED_KEYS_NVRAM_ID       (WICED_NVRAM_VSID_START + 1)
+#define ANS_PAIRED_KEYS_NVRAM_ID       (WICED_NVRAM_VSID_START + 1)   /* bond store of ANS_MAX_CLIENTS devices */
 
 /******************************************************
  *                      Constants
  ******************************************************/
 extern const wiced_bt_cfg_settings_t wiced_app_cfg_settings;
 extern const wiced_bt_cfg_buf_pool_t wiced_app_cfg_buf_pools[];
+extern const transport_pool_cfg_t wiced_app_transport_pool_cfg;
+
+/* Alert Notification Clients served at the same time, see also server_max_links in wiced_app_cfg.c */
+#ifndef ANS_MAX_CLIENTS
+#define ANS_MAX_CLIENTS                     2
+#endif
+
+/* Alerts generated within ANS_ALERT_WINDOW_MS of the first one are notified together, one New Alert
+ * and one Unread Alert Status notification per category. 0 notifies each alert as it is generated */
+#ifndef ANS_ALERT_WINDOW_MS
+#define ANS_ALERT_WINDOW_MS                 500
+#endif
+
+/* Delay before the notifications held back by a shortage of stack buffers are tried again */
+#ifndef ANS_ALERT_RETRY_MS
+#define ANS_ALERT_RETRY_MS                  20
+#endif
+
+#define ANS_ALERT_NUM_CATEGORIES            10      /* simple alert to instant message */
+#define ANS_ALERT_CATEGORY_ALL              0xFF
+
+/* Alert Notification Control Point commands */
+#define ANS_CP_ENABLE_NEW_ALERTS            0
+#define ANS_CP_ENABLE_UNREAD_STATUS         1
+#define ANS_CP_DISABLE_NEW_ALERTS           2
+#define ANS_CP_DISABLE_UNREAD_STATUS        3
+#define ANS_CP_NOTIFY_NEW_ALERTS            4
+#define ANS_CP_NOTIFY_UNREAD_STATUS         5
+#define ANS_CP_ERROR_CMD_NOT_SUPPORTED      0xA0
+
+/* Generate alerts in several categories at once: pairs of category id and number of alerts */
+#ifndef HCI_CONTROL_ANS_COMMAND_GENERATE_ALERTS
+#define HCI_CONTROL_ANS_COMMAND_GENERATE_ALERTS     ( ( HCI_CONTROL_GROUP_ANS << 8 ) | 0x20 )
+#endif
 
 /******************************************************
  *                     Structures
@@ -145,8 +193,18 @@ static wiced_bool_t           ans_read_link_keys(wiced_bt_device_link_keys_t *p_
 static void                   ans_send_connection_status_event( wiced_bool_t connected);
 static uint8_t                ans_handle_set_supported_new_alert_categories(uint16_t conn_id, uint8_t *p_data, uint16_t length);
 static uint8_t                ans_handle_set_supported_unread_alert_categories(uint16_t conn_id, uint8_t *p_data, uint16_t length);
-static uint8_t                ans_handle_generate_alert( uint16_t conn_id, uint8_t *p_data, uint8_t len);
-static uint8_t                ans_handle_clear_alert( uint16_t conn_id, uint8_t *p_data, uint8_t len);
+static uint8_t                ans_handle_generate_alert( uint16_t conn_id, uint8_t *p_data, uint16_t len);
+static uint8_t                ans_handle_clear_alert( uint16_t conn_id, uint8_t *p_data, uint16_t len);
+static uint8_t                ans_handle_generate_alerts( uint16_t conn_id, uint8_t *p_data, uint16_t len);
+static uint8_t                ans_alert_add( uint8_t category, uint8_t num_alerts );
+static void                   ans_alert_flush( void );
+static void                   ans_alert_timeout( uint32_t arg );
+static void                   ans_alert_flush_client( ans_client_t *p_client );
+static void                   ans_alert_retry( void );
+static wiced_bt_gatt_status_t ans_alert_control_point_write( ans_client_t *p_client, wiced_bt_gatt_write_t *p_data );
+static void                   ans_alert_client_config_written( ans_client_t *p_client, wiced_bt_gatt_write_t *p_data );
+static ans_client_t *         ans_client_find( uint16_t conn_id );
+static ans_client_t *         ans_client_find_addr( BD_ADDR bd_addr );
 static void                   ans_handle_get_version(void);
 static void                   ans_transport_status( wiced_transport_type_t type );
 static uint32_t               ans_proc_rx_hci_cmd(uint8_t *p_data, uint32_t length);
@@ -161,21 +219,48 @@ static void                   ans_app_timeout( uint32_t arg );
  *               Variables Definitions
  ******************************************************/
 
+/* Connected Alert Notification Client */
 typedef struct
 {
-    uint16_t                                conn_id;
+    uint16_t                                conn_id;        /* 0 if the entry is free */
+    BD_ADDR                                 bd_addr;
+
+    // client configuration, following the writes the ANS library accepts
+    uint16_t                                new_alert_cccd;
+    uint16_t                                unread_alert_cccd;
+    uint16_t                                new_alert_enabled_cat;
+    uint16_t                                unread_alert_enabled_cat;
+
+    // categories changed since the last notification to this client
+    uint16_t                                pending_new_alert_cat;
+    uint16_t                                pending_unread_alert_cat;
+    wiced_bool_t                            congested;
+} ans_client_t;
+
+typedef struct
+{
+    uint8_t                                 num_clients;
     wiced_bt_anp_alert_category_enable_t    current_enabled_alert_cat;
+    wiced_bt_anp_alert_category_enable_t    supported_new_alert_cat;
+    wiced_bt_anp_alert_category_enable_t    supported_unread_alert_cat;
+
+    // alert counts, the same for all the clients
+    uint8_t                                 new_alert_count[ANS_ALERT_NUM_CATEGORIES];
+    uint8_t                                 unread_count[ANS_ALERT_NUM_CATEGORIES];
+
+    ans_client_t                            client[ANS_MAX_CLIENTS];
 } ans_app_cb_t;
 
 ans_app_cb_t ans_app_cb;
+wiced_timer_t ans_alert_timer;
+bond_store_t ans_bond_store;
 
 #define ANS_CLIENT_NAME         "ANC"
 const char *p_ans_client_name = ANS_CLIENT_NAME;
 
 //#define HCI_TRACE_OVER_TRANSPORT        1 /* Uncomment to enable HCI trace */
-#define TRANS_UART_BUFFER_SIZE          1024
-#define ANS_TRANS_MAX_BUFFERS           2
-const wiced_transport_cfg_t transport_cfg =
+/* the receive buffers are set from wiced_app_transport_pool_cfg */
+wiced_transport_cfg_t transport_cfg =
 {
     .type = WICED_TRANSPORT_UART,
     .cfg =
@@ -188,14 +273,23 @@ const wiced_transport_cfg_t transport_cfg =
     },
     .rx_buff_pool_cfg =
     {
-        .buffer_size  = TRANS_UART_BUFFER_SIZE,
-        .buffer_count = 1
+        .buffer_size  = 0,
+        .buffer_count = 0
     },
     .p_status_handler       = ans_transport_status,
     .p_data_handler         = ans_proc_rx_hci_cmd,
     .p_tx_complete_cback    = NULL
 };
-wiced_transport_buffer_pool_t*  host_trans_pool;
+transport_pool_t ans_transport_pool;
+
+#ifdef HCI_TRACE_OVER_TRANSPORT
+static void ans_trace_send(wiced_bt_hci_trace_type_t type, uint16_t length, uint8_t* p_data);
+
+/* HCI traces are kept in the ring and sent to the host in the background */
+static const hci_trace_ring_cfg_t ans_trace_ring_cfg = HCI_TRACE_RING_CFG_DEFAULT(ans_trace_send);
+static uint8_t ans_trace_ring_buf[HCI_TRACE_RING_BUF_SIZE(HCI_TRACE_RING_SLOTS, HCI_TRACE_RING_MAX_PAYLOAD)];
+static hci_trace_ring_t ans_trace_ring;
+#endif
 
 
 /******************************************************
@@ -210,10 +304,8 @@ wiced_transport_buffer_pool_t*  host_trans_pool;
 APPLICATION_START()
 {
     wiced_result_t result;
-    wiced_transport_init(&transport_cfg);
-
-    // create special pool for sending data to the MCU
-    host_trans_pool = wiced_transport_create_buffer_pool(TRANS_UART_BUFFER_SIZE, ANS_TRANS_MAX_BUFFERS);
+    // initialize the transport with the buffers of wiced_app_cfg.c, and the pool for sending data to the MCU
+    transport_pool_init(&ans_transport_pool, &transport_cfg, &wiced_app_transport_pool_cfg);
 
 #ifdef WICED_BT_TRACE_ENABLE
     // Set the debug uart as WICED_ROUTE_DEBUG_NONE to get rid of prints
@@ -293,6 +385,7 @@ void ans_application_init(void)
 
 #ifdef HCI_TRACE_OVER_TRANSPORT
     /* Register callback for receiving hci traces */
+    hci_trace_ring_init(&ans_trace_ring, &ans_trace_ring_cfg, ans_trace_ring_buf, sizeof(ans_trace_ring_buf));
     wiced_bt_dev_register_hci_trace(ans_trace_callback);
 #endif
 
@@ -305,14 +398,19 @@ void ans_application_init(void)
     wiced_bt_set_pairable_mode(WICED_TRUE, 0);
 
     /* Load the address resolution DB with the keys stored in the NVRAM */
+    bond_store_init(&ans_bond_store, ANS_PAIRED_KEYS_NVRAM_ID, ANS_MAX_CLIENTS);
     ans_load_keys_to_addr_resolution_db();
 
     /* Currently application demonstrates, simple alerts, email and SMS or MMS categories*/
     ans_app_cb.current_enabled_alert_cat = ANP_ALERT_CATEGORY_ENABLE_SIMPLE_ALERT|ANP_ALERT_CATEGORY_ENABLE_EMAIL|ANP_ALERT_CATEGORY_ENABLE_SMS_OR_MMS;
 
     /* tell to ANS library on current supported categories */
-    wiced_bt_ans_set_supported_new_alert_categories(0, ans_app_cb.current_enabled_alert_cat);
-    wiced_bt_ans_set_supported_unread_alert_categories(0, ans_app_cb.current_enabled_alert_cat);
+    ans_app_cb.supported_new_alert_cat    = ans_app_cb.current_enabled_alert_cat;
+    ans_app_cb.supported_unread_alert_cat = ans_app_cb.current_enabled_alert_cat;
+    wiced_bt_ans_set_supported_new_alert_categories(0, ans_app_cb.supported_new_alert_cat);
+    wiced_bt_ans_set_supported_unread_alert_categories(0, ans_app_cb.supported_unread_alert_cat);
+
+    wiced_init_timer(&ans_alert_timer, ans_alert_timeout, 0, WICED_MILLI_SECONDS_TIMER);
 
 #ifdef ANS_UNIT_TESTING
     /* Start scan to find ANS Client */
@@ -455,6 +553,12 @@ void ans_scan_result_cback( wiced_bt_ble_scan_results_t *p_scan_result, uint8_t
             return;
         }
 
+        if ( ans_client_find_addr( p_scan_result->remote_bd_addr ) != NULL )
+        {
+            // already connected
+            return;
+        }
+
         WICED_BT_TRACE(" Found ANS client : %B \n", p_scan_result->remote_bd_addr );
 
         /* Stop the scan since the desired device is found */
@@ -479,6 +583,7 @@ void ans_scan_result_cback( wiced_bt_ble_scan_results_t *p_scan_result, uint8_t
 wiced_bt_gatt_status_t ans_gatts_callback(wiced_bt_gatt_evt_t event, wiced_bt_gatt_event_data_t *p_data)
 {
     wiced_bt_gatt_status_t result = WICED_BT_GATT_INVALID_PDU;
+    ans_client_t           *p_client;
 
     switch(event)
     {
@@ -497,6 +602,20 @@ wiced_bt_gatt_status_t ans_gatts_callback(wiced_bt_gatt_evt_t event, wiced_bt_ga
         result = ans_gatts_req_callback(&p_data->attribute_request);
         break;
 
+    case GATT_CONGESTION_EVT:
+        p_client = ans_client_find(p_data->congestion.conn_id);
+        if (p_client != NULL)
+        {
+            p_client->congested = p_data->congestion.congested;
+            if (!p_client->congested)
+            {
+                // send the notifications that did not fit
+                ans_alert_flush_client(p_client);
+            }
+        }
+        result = WICED_BT_GATT_SUCCESS;
+        break;
+
     default:
         break;
     }
@@ -509,31 +628,42 @@ wiced_bt_gatt_status_t ans_gatts_callback(wiced_bt_gatt_evt_t event, wiced_bt_ga
  */
 void ans_connection_up(wiced_bt_gatt_connection_status_t *p_conn_status)
 {
-    wiced_bt_gatt_status_t  status;
-    wiced_bt_device_link_keys_t keys;
+    ans_client_t *p_client;
     wiced_result_t result;
     wiced_bt_ble_sec_action_type_t sec_act = BTM_BLE_SEC_ENCRYPT;
 
     WICED_BT_TRACE("%s\n", __FUNCTION__);
 
-    ans_app_cb.conn_id   = p_conn_status->conn_id;
+    p_client = ans_client_find(0);
+    if (p_client == NULL)
+    {
+        WICED_BT_TRACE("no room for client %B\n", p_conn_status->bd_addr);
+        return;
+    }
+
+    // the client configures its notifications again on each connection
+    memset(p_client, 0, sizeof(ans_client_t));
+    p_client->conn_id = p_conn_status->conn_id;
+    memcpy(p_client->bd_addr, p_conn_status->bd_addr, BD_ADDR_LEN);
+    ans_app_cb.num_clients++;
 
     // Need to notify ANP Server library that the connection is up
     wiced_bt_ans_connection_up(p_conn_status->conn_id);
 
     /* if the peer already paired with us initiate encryption instead waiting client to
     initiate*/
-    if (ans_read_link_keys(&keys))
+    if (bond_store_is_bonded(&ans_bond_store, p_conn_status->bd_addr))
     {
-        if (!memcmp(p_conn_status->bd_addr, keys.bd_addr, 6))
-        {
-            result = wiced_bt_dev_set_encryption(keys.bd_addr, BT_TRANSPORT_LE, &sec_act);
-            WICED_BT_TRACE("Start Encryption %B %d \n", keys.bd_addr, result);
-        }
+        result = wiced_bt_dev_set_encryption(p_conn_status->bd_addr, BT_TRANSPORT_LE, &sec_act);
+        WICED_BT_TRACE("Start Encryption %B %d \n", p_conn_status->bd_addr, result);
     }
 
     /* Send ANS up status to transport to enable ANS services to the user */
-    ans_send_connection_status_event( WICED_TRUE);
+    if (ans_app_cb.num_clients == 1)
+        ans_send_connection_status_event( WICED_TRUE);
+
+    /* look for the next client */
+    ans_start_scan();
 }
 
 /*
@@ -541,15 +671,57 @@ void ans_connection_up(wiced_bt_gatt_connection_status_t *p_conn_status)
  */
 void ans_connection_down(wiced_bt_gatt_connection_status_t *p_conn_status)
 {
+    ans_client_t *p_client = ans_client_find(p_conn_status->conn_id);
+
     WICED_BT_TRACE("%s\n", __FUNCTION__);
 
     // tell library that connection is down
     wiced_bt_ans_connection_down(p_conn_status->conn_id);
 
-    ans_app_cb.conn_id           = 0;
+    if (p_client == NULL)
+        return;
+
+    // alert counts are kept, only notifications still in the window are dropped
+    memset(p_client, 0, sizeof(ans_client_t));
+    ans_app_cb.num_clients--;
+
+    if (ans_app_cb.num_clients == 0)
+    {
+        wiced_stop_timer(&ans_alert_timer);
+
+        /* Send ANS down status to transport to disable ANS services to the user */
+        ans_send_connection_status_event(  WICED_FALSE );
+    }
+}
+
+/*
+ * Client connected with conn_id, or a free entry for conn_id 0
+ */
+ans_client_t *ans_client_find(uint16_t conn_id)
+{
+    int i;
 
-    /* Send ANS down status to transport to disable ANS services to the user */
-    ans_send_connection_status_event(  WICED_FALSE );
+    for (i = 0; i < ANS_MAX_CLIENTS; i++)
+    {
+        if (ans_app_cb.client[i].conn_id == conn_id)
+            return &ans_app_cb.client[i];
+    }
+    return NULL;
+}
+
+/*
+ * Connected client with the address
+ */
+ans_client_t *ans_client_find_addr(BD_ADDR bd_addr)
+{
+    int i;
+
+    for (i = 0; i < ANS_MAX_CLIENTS; i++)
+    {
+        if ((ans_app_cb.client[i].conn_id != 0) && (memcmp(ans_app_cb.client[i].bd_addr, bd_addr, BD_ADDR_LEN) == 0))
+            return &ans_app_cb.client[i];
+    }
+    return NULL;
 }
 
 /*
@@ -642,12 +814,30 @@ wiced_bt_gatt_status_t ans_gatts_req_read_handler(uint16_t conn_id, wiced_bt_gat
  */
 wiced_bt_gatt_status_t ans_gatts_req_write_handler(uint16_t conn_id, wiced_bt_gatt_write_t * p_data)
 {
+    wiced_bt_gatt_status_t status;
+    ans_client_t           *p_client = ans_client_find(conn_id);
+
     WICED_BT_TRACE("write_handler: conn_id:%d hdl:0x%x prep:%d offset:%d len:%d \n ", conn_id, p_data->handle, p_data->is_prep, p_data->offset, p_data->val_len);
 
     /* ANP server library takes care writing to ANS service characteristics */
     if ( (p_data->handle >= HDLS_ANS) && ( p_data->handle <= HDLC_ANS_ALERT_NOTIFICATION_CONTROL_POINT_VALUE ) )
     {
-        return wiced_bt_ans_process_gatt_write_req(conn_id, p_data);
+        if (p_client == NULL)
+        {
+            return wiced_bt_ans_process_gatt_write_req(conn_id, p_data);
+        }
+
+        if (p_data->handle == HDLC_ANS_ALERT_NOTIFICATION_CONTROL_POINT_VALUE)
+        {
+            return ans_alert_control_point_write(p_client, p_data);
+        }
+
+        status = wiced_bt_ans_process_gatt_write_req(conn_id, p_data);
+        if (status == WICED_BT_GATT_SUCCESS)
+        {
+            ans_alert_client_config_written(p_client, p_data);
+        }
+        return status;
     }
 
     /* This snippet does not have any other services to support the GATT write */
@@ -698,13 +888,65 @@ void ans_start_scan (void)
     wiced_result_t  result;
     /* Start scan to find ANS Client */
     if( (wiced_bt_ble_get_current_scan_state() == BTM_BLE_SCAN_TYPE_NONE) &&
-        (ans_app_cb.conn_id == 0))
+        (ans_app_cb.num_clients < ANS_MAX_CLIENTS))
     {
          result = wiced_bt_ble_scan( BTM_BLE_SCAN_TYPE_HIGH_DUTY, WICED_TRUE, ans_scan_result_cback );
          WICED_BT_TRACE("wiced_bt_ble_scan: %d \n", result);
     }
 }
 
+static uint8_t ans_cmd_set_supported_new_alert_categories(uint16_t opcode, uint8_t *p_data, uint32_t data_len)
+{
+    WICED_BT_TRACE("Set Supported New Alert Categories\n");
+    return ans_handle_set_supported_new_alert_categories(0, p_data, data_len);
+}
+
+static uint8_t ans_cmd_set_supported_unread_alert_categories(uint16_t opcode, uint8_t *p_data, uint32_t data_len)
+{
+    WICED_BT_TRACE("Set Supported Unread Alert Categories\n");
+    return ans_handle_set_supported_unread_alert_categories(0, p_data, data_len);
+}
+
+static uint8_t ans_cmd_generate_alert(uint16_t opcode, uint8_t *p_data, uint32_t data_len)
+{
+    WICED_BT_TRACE("Generate Alert\n");
+    return ans_handle_generate_alert(0, p_data, data_len);
+}
+
+static uint8_t ans_cmd_clear_alert(uint16_t opcode, uint8_t *p_data, uint32_t data_len)
+{
+    WICED_BT_TRACE("Clear Alert\n");
+    return ans_handle_clear_alert(0, p_data, data_len);
+}
+
+static uint8_t ans_cmd_generate_alerts(uint16_t opcode, uint8_t *p_data, uint32_t data_len)
+{
+    WICED_BT_TRACE("Generate Alerts\n");
+    return ans_handle_generate_alerts(0, p_data, data_len);
+}
+
+static uint8_t ans_cmd_get_version(uint16_t opcode, uint8_t *p_data, uint32_t data_len)
+{
+    ans_handle_get_version();
+    ans_transport_status(0);
+    ans_start_scan ();
+    return HCI_CONTROL_STATUS_SUCCESS;
+}
+
+/* WICED HCI commands handled by the ANS, sorted by opcode */
+static const hci_control_cmd_entry_t ans_cmd_table[] =
+{
+    HCI_CONTROL_CMD_ENTRY(HCI_CONTROL_ANS_COMMAND_SET_SUPPORTED_NEW_ALERT_CATEGORIES,       2,  ans_cmd_set_supported_new_alert_categories),
+    HCI_CONTROL_CMD_ENTRY(HCI_CONTROL_ANS_COMMAND_SET_SUPPORTED_UNREAD_ALERT_CATEGORIES,    2,  ans_cmd_set_supported_unread_alert_categories),
+    HCI_CONTROL_CMD_ENTRY(HCI_CONTROL_ANS_COMMAND_GENERATE_ALERT,                           1,  ans_cmd_generate_alert),
+    HCI_CONTROL_CMD_ENTRY(HCI_CONTROL_ANS_COMMAND_CLEAR_ALERT,                              1,  ans_cmd_clear_alert),
+    HCI_CONTROL_CMD_ENTRY(HCI_CONTROL_ANS_COMMAND_GENERATE_ALERTS,                          2,  ans_cmd_generate_alerts),
+    HCI_CONTROL_CMD_ENTRY(HCI_CONTROL_MISC_COMMAND_GET_VERSION,                             0,  ans_cmd_get_version),
+#ifdef LATENCY_PROBES
+    HCI_CONTROL_CMD_ENTRY(HCI_CONTROL_MISC_COMMAND_READ_PROBES,                             0,  latency_probe_cmd_read),
+#endif
+};
+
 /*
  * Handle received command over UART. Please refer to the WICED HCI Control
  * Protocol for details on the protocol.  The function converts from the WICED
@@ -715,8 +957,7 @@ uint32_t  ans_proc_rx_hci_cmd(uint8_t *p_buffer, uint32_t length)
     uint16_t                opcode;
     uint8_t*                p_data = p_buffer;
     uint16_t                payload_len;
-    uint8_t                 status = HCI_CONTROL_STATUS_SUCCESS;
-    wiced_bt_gatt_status_t  gatt_status = WICED_BT_GATT_SUCCESS;
+    uint8_t                 status;
 
     // WICED_BT_TRACE("hci_control_proc_rx_cmd:%d\n", length);
 
@@ -725,57 +966,38 @@ uint32_t  ans_proc_rx_hci_cmd(uint8_t *p_buffer, uint32_t length)
         return HCI_CONTROL_STATUS_INVALID_ARGS;
     }
 
+    transport_pool_rx_get(&ans_transport_pool);
+
     //Expected minimum 4 byte as the wiced header
     if (length < 4)
     {
         WICED_BT_TRACE("invalid params\n");
-        wiced_transport_free_buffer(p_data);
+        transport_pool_rx_free(&ans_transport_pool, p_data);
         return HCI_CONTROL_STATUS_INVALID_ARGS;
     }
 
     STREAM_TO_UINT16(opcode, p_data);       // Get OpCode
     STREAM_TO_UINT16(payload_len, p_data);  // Gen Payload Length
+    LATENCY_PROBE(LATENCY_PROBE_HCI_CMD_RX, opcode);
 
-    WICED_BT_TRACE("cmd_opcode 0x%04x\n", opcode);
-
-    switch (opcode)
-    {
-        case HCI_CONTROL_ANS_COMMAND_SET_SUPPORTED_NEW_ALERT_CATEGORIES:
-            WICED_BT_TRACE("Set Supported New Alert Categories\n");
-            status = ans_handle_set_supported_new_alert_categories(ans_app_cb.conn_id, p_data, payload_len);
-            break;
-
-        case HCI_CONTROL_ANS_COMMAND_SET_SUPPORTED_UNREAD_ALERT_CATEGORIES:
-            WICED_BT_TRACE("Set Supported Unread Alert Categories\n");
-            status = ans_handle_set_supported_unread_alert_categories(ans_app_cb.conn_id, p_data, payload_len);
-            break;
-
-        case HCI_CONTROL_ANS_COMMAND_GENERATE_ALERT:
-            WICED_BT_TRACE("Generate Alert\n");
-            status = ans_handle_generate_alert(ans_app_cb.conn_id, p_data, payload_len);
-            break;
+    WICED_BT_TRACE("cmd_opcode 0x%04x %s\n", opcode, hci_control_cmd_name(ans_cmd_table, HCI_CONTROL_CMD_TABLE_SIZE(ans_cmd_table), opcode));
 
-        case HCI_CONTROL_ANS_COMMAND_CLEAR_ALERT:
-            WICED_BT_TRACE("Clear Alert\n");
-            status = ans_handle_clear_alert(ans_app_cb.conn_id, p_data, payload_len);
-            break;
-
-        case HCI_CONTROL_MISC_COMMAND_GET_VERSION:
-            ans_handle_get_version();
-            ans_transport_status(0);
-            ans_start_scan ();
-            break;
+#ifdef WICED_BT_TRACE_ENABLE
+    /* the host starts with GET_VERSION, a good time to check the table */
+    if (opcode == HCI_CONTROL_MISC_COMMAND_GET_VERSION)
+        hci_control_check_cmd_table(ans_cmd_table, HCI_CONTROL_CMD_TABLE_SIZE(ans_cmd_table));
+#endif
 
-        default:
-            WICED_BT_TRACE("ignored opcode:0x%04x\n", opcode);
-            status = HCI_CONTROL_STATUS_UNKNOWN_COMMAND;
-            break;
-    }
+    if (payload_len > length - 4)
+        status = HCI_CONTROL_STATUS_INVALID_ARGS;
+    else
+        status = hci_control_dispatch(ans_cmd_table, HCI_CONTROL_CMD_TABLE_SIZE(ans_cmd_table), opcode, p_data, payload_len);
+    LATENCY_PROBE(LATENCY_PROBE_HCI_CMD_DONE, opcode);
 
     wiced_transport_send_data(HCI_CONTROL_ANS_EVENT_COMMAND_STATUS, &status, 1);
 
     // Freeing the buffer in which data is received
-    wiced_transport_free_buffer(p_buffer);
+    transport_pool_rx_free(&ans_transport_pool, p_buffer);
     return HCI_CONTROL_STATUS_SUCCESS;
 }
 
@@ -824,18 +1046,18 @@ void test_ans(void)
             if (tc == 1)
             {
                 cat = ANP_ALERT_CATEGORY_ID_SIMPLE_ALERT;
-                ans_handle_generate_alert(ans_app_cb.conn_id, &cat, 1);
+                ans_handle_generate_alert(0, &cat, 1);
 
             }
             else if (tc ==2)
             {
                 cat = ANP_ALERT_CATEGORY_ID_EMAIL;
-                ans_handle_generate_alert(ans_app_cb.conn_id, &cat, 1);
+                ans_handle_generate_alert(0, &cat, 1);
             }
             else if (tc ==3)
             {
                 cat = ANP_ALERT_CATEGORY_ID_SMS_OR_MMS;
-                ans_handle_generate_alert(ans_app_cb.conn_id, &cat, 1);
+                ans_handle_generate_alert(0, &cat, 1);
 
                 tc = 0; // To repeat the sequence
             }
@@ -859,8 +1081,8 @@ void ans_interrupt_handler(void* user_data, uint8_t value )
     test_ans();
 #endif
 
-    /*start scan if not connected and no scan in progress*/
-    if ((ans_app_cb.conn_id == 0) && (wiced_bt_ble_get_current_scan_state() == BTM_BLE_SCAN_TYPE_NONE))
+    /*start scan if a client can still connect and no scan in progress*/
+    if ((ans_app_cb.num_clients < ANS_MAX_CLIENTS) && (wiced_bt_ble_get_current_scan_state() == BTM_BLE_SCAN_TYPE_NONE))
     {
         result = wiced_bt_ble_scan( BTM_BLE_SCAN_TYPE_HIGH_DUTY, WICED_TRUE, ans_scan_result_cback );
         WICED_BT_TRACE("wiced_bt_ble_scan: %d \n", result);
@@ -872,22 +1094,7 @@ void ans_interrupt_handler(void* user_data, uint8_t value )
  */
 void ans_load_keys_to_addr_resolution_db(void)
 {
-    uint8_t                     bytes_read;
-    wiced_result_t              result;
-    wiced_bt_device_link_keys_t keys;
-
-    bytes_read = wiced_hal_read_nvram(ANS_PAIRED_KEYS_NVRAM_ID, sizeof(keys), (uint8_t *)&keys, &result);
-
-    WICED_BT_TRACE(" [%s] read status %d bytes read %d \n", __FUNCTION__, result, bytes_read);
-    // if failed to read NVRAM, there is nothing saved at that location
-    if (result == WICED_SUCCESS)
-    {
-#ifdef CYW20706A2
-        result = wiced_bt_dev_add_device_to_address_resolution_db(&keys, keys.key_data.ble_addr_type);
-#else
-        result = wiced_bt_dev_add_device_to_address_resolution_db(&keys);
-#endif
-    }
+    bond_store_load_addr_resolution_db(&ans_bond_store);
 }
 
 /*
@@ -895,12 +1102,7 @@ void ans_load_keys_to_addr_resolution_db(void)
  */
 wiced_bool_t ans_save_link_keys(wiced_bt_device_link_keys_t *p_keys)
 {
-    uint8_t          bytes_written;
-    wiced_result_t   result;
-
-    bytes_written = wiced_hal_write_nvram(ANS_PAIRED_KEYS_NVRAM_ID, sizeof(wiced_bt_device_link_keys_t), (uint8_t *)p_keys, &result);
-    WICED_BT_TRACE("Saved %d bytes at id:%d \n", bytes_written, ANS_PAIRED_KEYS_NVRAM_ID);
-    return (bytes_written == sizeof (wiced_bt_device_link_keys_t));
+    return bond_store_save(&ans_bond_store, p_keys);
 }
 
 /*
@@ -908,21 +1110,24 @@ wiced_bool_t ans_save_link_keys(wiced_bt_device_link_keys_t *p_keys)
  */
 wiced_bool_t ans_read_link_keys(wiced_bt_device_link_keys_t *p_keys)
 {
-    uint8_t         bytes_read;
-    wiced_result_t  result;
-
-    bytes_read = wiced_hal_read_nvram(ANS_PAIRED_KEYS_NVRAM_ID, sizeof(wiced_bt_device_link_keys_t), (uint8_t *)p_keys, &result);
-    WICED_BT_TRACE("read %d bytes at id:%d \n", bytes_read, ANS_PAIRED_KEYS_NVRAM_ID);
-    return (bytes_read == sizeof (wiced_bt_device_link_keys_t));
+    return bond_store_read(&ans_bond_store, p_keys);
 }
 
 #ifdef HCI_TRACE_OVER_TRANSPORT
 /*
- *  Pass protocol traces up over the transport
+ *  Keep protocol traces in the ring, they are passed up over the transport in the background
  */
 void ans_trace_callback(wiced_bt_hci_trace_type_t type, uint16_t length, uint8_t* p_data)
 {
-    wiced_transport_send_hci_trace(host_trans_pool, type, length, p_data);
+    hci_trace_ring_put(&ans_trace_ring, type, length, p_data);
+}
+
+/*
+ *  Pass a protocol trace from the ring up over the transport
+ */
+static void ans_trace_send(wiced_bt_hci_trace_type_t type, uint16_t length, uint8_t* p_data)
+{
+    transport_pool_send_hci_trace(&ans_transport_pool, type, length, p_data);
 }
 #endif
 
@@ -946,7 +1151,7 @@ uint8_t ans_handle_set_supported_new_alert_categories(uint16_t conn_id, uint8_t
     uint16_t    supported_new_alert_cat = 0;
     uint8_t     status = HCI_CONTROL_STATUS_SUCCESS;
 
-    if (ans_app_cb.conn_id != 0)
+    if (ans_app_cb.num_clients != 0)
     {
         WICED_BT_TRACE("request not supported: ANS connected with ANC \n");
         return HCI_CONTROL_STATUS_WRONG_STATE;
@@ -958,6 +1163,7 @@ uint8_t ans_handle_set_supported_new_alert_categories(uint16_t conn_id, uint8_t
 
         /* Make sure user sets choice only in supported categories */
         supported_new_alert_cat &= ans_app_cb.current_enabled_alert_cat;
+        ans_app_cb.supported_new_alert_cat = supported_new_alert_cat;
         wiced_bt_ans_set_supported_new_alert_categories(conn_id, supported_new_alert_cat);
     }
     else
@@ -973,7 +1179,7 @@ uint8_t ans_handle_set_supported_unread_alert_categories(uint16_t conn_id, uint8
     uint16_t    supported_unread_alert_cat = 0;
     uint8_t     status = HCI_CONTROL_STATUS_SUCCESS;
 
-    if (ans_app_cb.conn_id != 0)
+    if (ans_app_cb.num_clients != 0)
     {
         WICED_BT_TRACE("request not supported: ANS connected with ANC \n");
         return HCI_CONTROL_STATUS_WRONG_STATE;
@@ -985,6 +1191,7 @@ uint8_t ans_handle_set_supported_unread_alert_categories(uint16_t conn_id, uint8
 
         /* Make sure user sets choice only in supported categories */
         supported_unread_alert_cat &= ans_app_cb.current_enabled_alert_cat;
+        ans_app_cb.supported_unread_alert_cat = supported_unread_alert_cat;
         wiced_bt_ans_set_supported_unread_alert_categories(conn_id, supported_unread_alert_cat);
     }
     else
@@ -996,61 +1203,353 @@ uint8_t ans_handle_set_supported_unread_alert_categories(uint16_t conn_id, uint8
 
 }
 
-uint8_t ans_handle_generate_alert( uint16_t conn_id, uint8_t *p_data, uint8_t len)
+uint8_t ans_handle_generate_alert( uint16_t conn_id, uint8_t *p_data, uint16_t len)
 {
-    uint8_t                 status = HCI_CONTROL_STATUS_FAILED;
-    wiced_bt_gatt_status_t  gatt_status;
-
-    if (ans_app_cb.conn_id == 0)
+    if (ans_app_cb.num_clients == 0)
     {
         WICED_BT_TRACE("ans_handle_generate_alert: Service not connected \n");
         return HCI_CONTROL_STATUS_NOT_CONNECTED;
     }
 
-    if (len == 1)
+    if (len != 1)
     {
-        gatt_status = wiced_bt_ans_process_and_send_new_alert( conn_id, *p_data);
-        if (gatt_status == WICED_BT_GATT_SUCCESS )
+        return HCI_CONTROL_STATUS_INVALID_ARGS;
+    }
+
+    return ans_alert_add(*p_data, 1);
+}
+
+/*
+ * Alerts in several categories, pairs of category id and number of alerts. The command is
+ * rejected as a whole if any category is not supported.
+ */
+uint8_t ans_handle_generate_alerts( uint16_t conn_id, uint8_t *p_data, uint16_t len)
+{
+    uint16_t    i;
+    uint16_t    supported_cat = ans_app_cb.supported_new_alert_cat | ans_app_cb.supported_unread_alert_cat;
+
+    if (ans_app_cb.num_clients == 0)
+    {
+        WICED_BT_TRACE("ans_handle_generate_alerts: Service not connected \n");
+        return HCI_CONTROL_STATUS_NOT_CONNECTED;
+    }
+
+    if ((len == 0) || (len & 1))
+    {
+        return HCI_CONTROL_STATUS_INVALID_ARGS;
+    }
+
+    for (i = 0; i < len; i += 2)
+    {
+        if ((p_data[i] >= ANS_ALERT_NUM_CATEGORIES) || !(supported_cat & (1 << p_data[i])))
+        {
+            WICED_BT_TRACE("ans_handle_generate_alerts: category %d not supported \n", p_data[i]);
+            return HCI_CONTROL_STATUS_FAILED;
+        }
+    }
+
+    for (i = 0; i < len; i += 2)
+    {
+        ans_alert_add(p_data[i], p_data[i + 1]);
+    }
+    return HCI_CONTROL_STATUS_SUCCESS;
+}
+
+uint8_t ans_handle_clear_alert( uint16_t conn_id, uint8_t *p_data, uint16_t len)
+{
+    uint16_t    clear_cat;
+    uint8_t     i;
+
+    if (len != 1)
+    {
+        return HCI_CONTROL_STATUS_INVALID_ARGS;
+    }
+
+    if (*p_data == ANS_ALERT_CATEGORY_ALL)
+    {
+        clear_cat = (1 << ANS_ALERT_NUM_CATEGORIES) - 1;
+    }
+    else if (*p_data < ANS_ALERT_NUM_CATEGORIES)
+    {
+        clear_cat = 1 << *p_data;
+    }
+    else
+    {
+        return HCI_CONTROL_STATUS_FAILED;
+    }
+
+    for (i = 0; i < ANS_ALERT_NUM_CATEGORIES; i++)
+    {
+        if (clear_cat & (1 << i))
+        {
+            ans_app_cb.new_alert_count[i] = 0;
+            ans_app_cb.unread_count[i]    = 0;
+        }
+    }
+
+    // the clients hear about the unread count going to zero, new alerts are not notified
+    for (i = 0; i < ANS_MAX_CLIENTS; i++)
+    {
+        if (ans_app_cb.client[i].conn_id != 0)
         {
-            gatt_status = wiced_bt_ans_process_and_send_unread_alert (conn_id, *p_data);
-            if (gatt_status != WICED_BT_GATT_SUCCESS)
+            ans_app_cb.client[i].pending_new_alert_cat    &= ~clear_cat;
+            ans_app_cb.client[i].pending_unread_alert_cat |= clear_cat & ans_app_cb.supported_unread_alert_cat;
+        }
+    }
+    ans_alert_flush();
+    return HCI_CONTROL_STATUS_SUCCESS;
+}
+
+/*
+ * Count alerts of one category. Notifications go out when the window started by the first alert closes.
+ */
+uint8_t ans_alert_add( uint8_t category, uint8_t num_alerts )
+{
+    uint16_t    mask;
+    uint16_t    new_alert_cat = 0;
+    uint16_t    unread_alert_cat = 0;
+    uint8_t     i;
+
+    if (category >= ANS_ALERT_NUM_CATEGORIES)
+    {
+        return HCI_CONTROL_STATUS_FAILED;
+    }
+
+    mask = 1 << category;
+    if (!((ans_app_cb.supported_new_alert_cat | ans_app_cb.supported_unread_alert_cat) & mask))
+    {
+        WICED_BT_TRACE("ans_alert_add: category %d not supported \n", category);
+        return HCI_CONTROL_STATUS_FAILED;
+    }
+
+    // counts saturate, the characteristics carry one byte
+    if (ans_app_cb.supported_new_alert_cat & mask)
+    {
+        ans_app_cb.new_alert_count[category] = (ans_app_cb.new_alert_count[category] > 0xFF - num_alerts) ?
+                0xFF : ans_app_cb.new_alert_count[category] + num_alerts;
+        new_alert_cat = mask;
+    }
+    if (ans_app_cb.supported_unread_alert_cat & mask)
+    {
+        ans_app_cb.unread_count[category] = (ans_app_cb.unread_count[category] > 0xFF - num_alerts) ?
+                0xFF : ans_app_cb.unread_count[category] + num_alerts;
+        unread_alert_cat = mask;
+    }
+
+    // every client gets the alert, filtered by its enabled categories when notified
+    for (i = 0; i < ANS_MAX_CLIENTS; i++)
+    {
+        if (ans_app_cb.client[i].conn_id != 0)
+        {
+            ans_app_cb.client[i].pending_new_alert_cat    |= new_alert_cat;
+            ans_app_cb.client[i].pending_unread_alert_cat |= unread_alert_cat;
+        }
+    }
+
+    if (ANS_ALERT_WINDOW_MS == 0)
+    {
+        ans_alert_flush();
+    }
+    else if (!wiced_is_timer_in_use(&ans_alert_timer))
+    {
+        wiced_start_timer(&ans_alert_timer, ANS_ALERT_WINDOW_MS);
+    }
+    return HCI_CONTROL_STATUS_SUCCESS;
+}
+
+/*
+ * Send one notification of the category to the client. Categories the client did not enable are skipped.
+ */
+static wiced_bt_gatt_status_t ans_alert_send( ans_client_t *p_client, uint16_t handle, uint16_t cccd, uint16_t enabled_cat, uint8_t category, uint8_t count )
+{
+    uint8_t value[2];
+
+    if (!(cccd & GATT_CLIENT_CONFIG_NOTIFICATION) || !(enabled_cat & (1 << category)))
+    {
+        return WICED_BT_GATT_SUCCESS;
+    }
+
+    value[0] = category;
+    value[1] = count;
+    LATENCY_PROBE(LATENCY_PROBE_TX_SENT, p_client->conn_id);
+    return wiced_bt_gatt_send_notification(p_client->conn_id, handle, sizeof(value), value);
+}
+
+/*
+ * No event tells when stack buffers are free again, flush all the clients after a short delay.
+ * A running alert window flushes them anyway when it closes.
+ */
+void ans_alert_retry( void )
+{
+    if (!wiced_is_timer_in_use(&ans_alert_timer))
+    {
+        wiced_start_timer(&ans_alert_timer, ANS_ALERT_RETRY_MS);
+    }
+}
+
+/*
+ * Notify a client of the categories changed since its last notification. On congestion the
+ * remaining categories wait for GATT_CONGESTION_EVT, on a shortage of buffers they are tried
+ * again from ans_alert_timer.
+ */
+void ans_alert_flush_client( ans_client_t *p_client )
+{
+    wiced_bt_gatt_status_t  gatt_status;
+    uint8_t                 i;
+
+    if ((p_client->conn_id == 0) || p_client->congested)
+    {
+        return;
+    }
+
+    for (i = 0; i < ANS_ALERT_NUM_CATEGORIES; i++)
+    {
+        if (p_client->pending_new_alert_cat & (1 << i))
+        {
+            gatt_status = ans_alert_send(p_client, HDLC_ANS_NEW_ALERT_VALUE, p_client->new_alert_cccd,
+                    p_client->new_alert_enabled_cat, i, ans_app_cb.new_alert_count[i]);
+            if (gatt_status == WICED_BT_GATT_CONGESTED)
             {
-                WICED_BT_TRACE("ans_handle_generate_alert: unread alert send error %d \n", gatt_status);
+                p_client->congested = WICED_TRUE;
+                return;
             }
-            else
+            if (gatt_status == WICED_BT_GATT_NO_RESOURCES)
             {
-                status = HCI_CONTROL_STATUS_SUCCESS;
+                ans_alert_retry();
+                return;
             }
+            p_client->pending_new_alert_cat &= ~(1 << i);
         }
-        else
+        if (p_client->pending_unread_alert_cat & (1 << i))
         {
-            WICED_BT_TRACE("ans_handle_generate_alert: new alert send error %d \n", gatt_status);
+            gatt_status = ans_alert_send(p_client, HDLC_ANS_UNREAD_ALERT_STATUS_VALUE, p_client->unread_alert_cccd,
+                    p_client->unread_alert_enabled_cat, i, ans_app_cb.unread_count[i]);
+            if (gatt_status == WICED_BT_GATT_CONGESTED)
+            {
+                p_client->congested = WICED_TRUE;
+                return;
+            }
+            if (gatt_status == WICED_BT_GATT_NO_RESOURCES)
+            {
+                ans_alert_retry();
+                return;
+            }
+            p_client->pending_unread_alert_cat &= ~(1 << i);
         }
     }
-    else
+}
+
+/*
+ * Notify all the clients of the categories changed during the window
+ */
+void ans_alert_flush( void )
+{
+    uint8_t i;
+
+    wiced_stop_timer(&ans_alert_timer);
+
+    for (i = 0; i < ANS_MAX_CLIENTS; i++)
     {
-        status = HCI_CONTROL_STATUS_INVALID_ARGS;
+        ans_alert_flush_client(&ans_app_cb.client[i]);
     }
+}
 
-    return status;
+/*
+ * The coalescing window is over, or the delay after a shortage of buffers
+ */
+void ans_alert_timeout( uint32_t arg )
+{
+    ans_alert_flush();
 }
 
-uint8_t ans_handle_clear_alert( uint16_t conn_id, uint8_t *p_data, uint8_t len)
+/*
+ * Follow the client configuration of the notifications accepted by the ANS library
+ */
+void ans_alert_client_config_written( ans_client_t *p_client, wiced_bt_gatt_write_t *p_data )
 {
-    uint8_t status = HCI_CONTROL_STATUS_SUCCESS;
+    if (p_data->val_len < 2)
+    {
+        return;
+    }
 
-    if (len == 1)
+    switch (p_data->handle)
     {
-        if (wiced_bt_ans_clear_alerts(conn_id, *p_data) != WICED_TRUE)
-        {
-            status = HCI_CONTROL_STATUS_FAILED;
-        }
+    case HDLD_ANS_NEW_ALERT_CLIENT_CHAR_CONFIG:
+        p_client->new_alert_cccd = p_data->p_val[0] | (p_data->p_val[1] << 8);
+        break;
+
+    case HDLD_ANS_UNREAD_ALERT_STATUS_CLIENT_CHAR_CONFIG:
+        p_client->unread_alert_cccd = p_data->p_val[0] | (p_data->p_val[1] << 8);
+        break;
     }
+}
+
+/*
+ * Alert Notification Control Point. The enable and disable commands go to the ANS library, the notify
+ * immediately commands are answered with the counts kept here.
+ */
+wiced_bt_gatt_status_t ans_alert_control_point_write( ans_client_t *p_client, wiced_bt_gatt_write_t *p_data )
+{
+    wiced_bt_gatt_status_t  status;
+    uint8_t                 cmd_id;
+    uint8_t                 category;
+    uint16_t                mask;
+
+    if (p_data->val_len != 2)
+    {
+        return wiced_bt_ans_process_gatt_write_req(p_client->conn_id, p_data);
+    }
+
+    cmd_id   = p_data->p_val[0];
+    category = p_data->p_val[1];
+    if (category == ANS_ALERT_CATEGORY_ALL)
+        mask = (1 << ANS_ALERT_NUM_CATEGORIES) - 1;
+    else if (category < ANS_ALERT_NUM_CATEGORIES)
+        mask = 1 << category;
     else
+        mask = 0;
+
+    switch (cmd_id)
     {
-        status = HCI_CONTROL_STATUS_INVALID_ARGS;
+    case ANS_CP_NOTIFY_NEW_ALERTS:
+        if (!(mask & ans_app_cb.supported_new_alert_cat))
+            return (wiced_bt_gatt_status_t)ANS_CP_ERROR_CMD_NOT_SUPPORTED;
+        p_client->pending_new_alert_cat |= mask & ans_app_cb.supported_new_alert_cat;
+        ans_alert_flush_client(p_client);
+        return WICED_BT_GATT_SUCCESS;
+
+    case ANS_CP_NOTIFY_UNREAD_STATUS:
+        if (!(mask & ans_app_cb.supported_unread_alert_cat))
+            return (wiced_bt_gatt_status_t)ANS_CP_ERROR_CMD_NOT_SUPPORTED;
+        p_client->pending_unread_alert_cat |= mask & ans_app_cb.supported_unread_alert_cat;
+        ans_alert_flush_client(p_client);
+        return WICED_BT_GATT_SUCCESS;
     }
 
+    status = wiced_bt_ans_process_gatt_write_req(p_client->conn_id, p_data);
+    if (status != WICED_BT_GATT_SUCCESS)
+    {
+        return status;
+    }
+
+    switch (cmd_id)
+    {
+    case ANS_CP_ENABLE_NEW_ALERTS:
+        p_client->new_alert_enabled_cat |= mask;
+        break;
+
+    case ANS_CP_ENABLE_UNREAD_STATUS:
+        p_client->unread_alert_enabled_cat |= mask;
+        break;
+
+    case ANS_CP_DISABLE_NEW_ALERTS:
+        p_client->new_alert_enabled_cat &= ~mask;
+        break;
+
+    case ANS_CP_DISABLE_UNREAD_STATUS:
+        p_client->unread_alert_enabled_cat &= ~mask;
+        break;
+    }
     return status;
 }
 
@@ -37,6 +37,8 @@
  *
  */
 #include "wiced_bt_cfg.h"
+#include "transport_pool.h"
+#include "bond_store.h"
 
 /*
  * Definitions
@@ -128,7 +130,7 @@ const wiced_bt_cfg_settings_t wiced_app_cfg_settings =
     {
         .appearance                     = APPEARANCE_WATCH_SPORTS,                                     /**< GATT appearance (see gatt_appearance_e) */
         .client_max_links               = 0,                                                           /**< Client config: maximum number of servers that local client can connect to  */
-        .server_max_links               = 1,                                                           /**< Server config: maximum number of remote clients connections allowed by the local */
+        .server_max_links               = 2,                                                           /**< Server config: maximum number of remote clients connections allowed by the local */
         .max_attr_len                   = 18,                                                         /**< Maximum attribute length; gki_cfg must have a corresponding buffer pool that can hold this length */
 #if !defined(CYW20706A2)
         .max_mtu_size                   = 23                                                           /**< Maximum MTU size for GATT connections, should be between 23 and (max_attr_len + 5) */
@@ -174,7 +176,7 @@ const wiced_bt_cfg_settings_t wiced_app_cfg_settings =
     },
 
     /* LE Address Resolution DB size  */
-    .addr_resolution_db_size            = 5,                                                           /**< LE Address Resolution DB settings - effective only for pre 4.2 controller*/
+    .addr_resolution_db_size            = BOND_STORE_ADDR_RESOLUTION_DB_SIZE,                          /**< LE Address Resolution DB settings - effective only for pre 4.2 controller*/
 
 #ifdef CYW20706A2
     .max_mtu_size                       = 23,                                                          /**< Maximum MTU size for GATT connections, should be between 23 and (max_attr_len + 5) */
@@ -210,3 +212,34 @@ const wiced_bt_cfg_buf_pool_t wiced_app_cfg_buf_pools[WICED_BT_CFG_NUM_BUF_POOLS
     { 1024,     8   },      /* Large Buffer Pool  (used for HCI ACL messages) */
     { 1024,     5   },      /* Extra Large Buffer Pool - Used for avdt media packets and miscellaneous (if not needed, set buf_count to 0) */
 };
+
+/*****************************************************************************
+ * HCI transport buffers
+ *
+ * Each command from the host takes one rx buffer until it is processed, a
+ * burst of commands needs as many. The tx pool sends the HCI traces.
+ *****************************************************************************/
+#ifndef ANS_TRANS_RX_BUFFER_SIZE
+#define ANS_TRANS_RX_BUFFER_SIZE        1024
+#endif
+#ifndef ANS_TRANS_RX_BUFFER_COUNT
+#define ANS_TRANS_RX_BUFFER_COUNT       3
+#endif
+#ifndef ANS_TRANS_TX_BUFFER_SIZE
+#define ANS_TRANS_TX_BUFFER_SIZE        1024
+#endif
+#ifndef ANS_TRANS_TX_BUFFER_COUNT
+#define ANS_TRANS_TX_BUFFER_COUNT       2
+#endif
+#ifndef ANS_TRANS_LOW_WATER
+#define ANS_TRANS_LOW_WATER             1
+#endif
+
+const transport_pool_cfg_t wiced_app_transport_pool_cfg =
+{
+    .rx_buffer_size     = ANS_TRANS_RX_BUFFER_SIZE,
+    .rx_buffer_count    = ANS_TRANS_RX_BUFFER_COUNT,
+    .tx_buffer_size     = ANS_TRANS_TX_BUFFER_SIZE,
+    .tx_buffer_count    = ANS_TRANS_TX_BUFFER_COUNT,
+    .low_water          = ANS_TRANS_LOW_WATER,
+};
@@ -55,7 +55,9 @@
 * 4. Upon successful Connection, the Battery Client App would discover all the characteristics/descriptors
 *    of the server device.
 * 5. Once the connection is established with the BLE peripheral (Battery Service found in the Peripheral),
-*    the application can enable/disable for notifications, to receive the change in the battery level.
+*    the application enables the notifications of the battery level if the server supports them, and
+*    otherwise reads it periodically, less often while the level does not change.
+*    The application can enable/disable for notifications, to receive the change in the battery level.
 *    To enable/disable notifications from the server, push the button on the tag board and release after 5 secs.
 * 6. To read the battery level of the server, push the button on the tag board and release between 2-4 secs.
 */
@@ -80,6 +82,10 @@
 #include "wiced_hal_puart.h"
 #include "string.h"
 #include "wiced_bt_stack.h"
+#include "scan_filter.h"
+#include "gatt_disc_cache.h"
+#include "bond_store.h"
+#include "hci_trace_ring.h"
 #include "wiced_bt_gatt_util.h"
 
 #ifdef  WICED_BT_TRACE_ENABLE
@@ -102,6 +108,15 @@ extern const wiced_bt_cfg_buf_pool_t wiced_app_cfg_buf_pools[];
 /* App Timer Timeout in seconds  */
 #define BATTC_APP_TIMEOUT_IN_SECONDS           1
 
+/* Polling of a server without Battery Level notifications. The period follows the rate of change of the
+ * level, the time it last took the level to change by one percent, and doubles while it does not change. */
+#ifndef BAC_POLL_MIN_S
+#define BAC_POLL_MIN_S                         10
+#endif
+#ifndef BAC_POLL_MAX_S
+#define BAC_POLL_MAX_S                         600
+#endif
+
 #if !defined(CYW20819A1)
 #define BUTTON_PRESSED                         WICED_BUTTON_PRESSED_VALUE
 #endif
@@ -121,7 +136,8 @@ extern const wiced_bt_cfg_buf_pool_t wiced_app_cfg_buf_pools[];
 #endif
 
 #define BATTERY_CLIENT_LOCAL_KEYS_VS_ID         ( WICED_NVRAM_VSID_START )
-#define BATTERY_CLIENT_PAIRED_KEYS_START_VS_ID  ( WICED_NVRAM_VSID_START + 1 )
+#define BATTERY_CLIENT_PAIRED_KEYS_START_VS_ID  ( WICED_NVRAM_VSID_START + 1 )  /* bond store, BOND_STORE_NUM_VS_ID() ids */
+#define BATTERY_CLIENT_DISC_CACHE_VS_ID         ( BATTERY_CLIENT_PAIRED_KEYS_START_VS_ID + BOND_STORE_NUM_VS_ID( BOND_STORE_MAX_DEVICES ) )  /* one per bonded device */
 
 /******************************************************************************
  *                                Structures
@@ -154,6 +170,16 @@ typedef struct
     // Current value of the client configuration descriptor for characteristic 'Report'
     uint16_t                    bac_s_handle;
     uint16_t                    bac_e_handle;
+
+    wiced_bool_t                notification_supported;
+
+    // Battery Level polling, when the server does not notify it
+    wiced_bool_t                polling;
+    uint16_t                    poll_interval;      // seconds
+    uint16_t                    poll_countdown;     // seconds to the next read
+    wiced_bool_t                level_valid;
+    uint8_t                     level;              // last level read
+    uint32_t                    level_time;         // app_timer_count of the last change
 }battery_service_client_app_t;
 
 /*****************************************************************************
@@ -164,6 +190,7 @@ static void                   battery_client_app_init();
 static wiced_bt_gatt_status_t battery_client_gatts_callback( wiced_bt_gatt_evt_t event, wiced_bt_gatt_event_data_t *p_data );
 static void                   battery_client_load_keys_to_addr_resolution_db();
 static void                   battery_client_scan_result_cback( wiced_bt_ble_scan_results_t *p_scan_result, uint8_t *p_adv_data );
+static wiced_bool_t           battery_client_scan_match( wiced_bt_ble_scan_results_t *p_scan_result, uint8_t *p_adv_data );
 static wiced_bool_t           battery_client_save_link_keys( wiced_bt_device_link_keys_t *p_keys );
 static wiced_bool_t           battery_client_read_link_keys(wiced_bt_device_link_keys_t *p_keys);
 static wiced_bt_gatt_status_t battery_client_connection_up( wiced_bt_gatt_connection_status_t *p_conn_status );
@@ -172,16 +199,22 @@ static wiced_bt_gatt_status_t battery_client_gatt_operation_complete( wiced_bt_g
 static void                   battery_client_process_read_rsp(wiced_bt_gatt_operation_complete_t *p_data);
 static wiced_bt_gatt_status_t battery_client_gatt_discovery_result(wiced_bt_gatt_discovery_result_t *p_data);
 static wiced_bt_gatt_status_t battery_client_gatt_discovery_complete(wiced_bt_gatt_discovery_complete_t *p_data);
+static void                   battery_client_start_service_discovery( uint16_t conn_id );
 static void                   battery_client_interrupt_handler( void *user_data, uint8_t value );
 static void                   battery_client_app_timer( uint32_t arg );
 static wiced_bool_t           battery_client_is_device_bonded( wiced_bt_device_address_t bd_address );
 static void                   battery_client_callback(wiced_bt_bac_event_t event, wiced_bt_bac_event_data_t *p_data);
+static void                   battery_client_start_polling( uint16_t conn_id );
+static void                   battery_client_poll_level( uint8_t level );
 
 /******************************************************************************
  *                           Variables Definitions
  ******************************************************************************/
 battery_service_client_peer_info_t  battery_client_app_data;
 battery_service_client_app_t battery_client_app_state;
+scan_filter_t battery_client_scan_filter;
+gatt_disc_cache_t battery_client_disc_cache;
+bond_store_t battery_client_bond_store;
 uint32_t app_timer_count = 0;
 wiced_bool_t is_enabled_notification = WICED_FALSE;
 wiced_timer_t app_timer;
@@ -278,6 +311,71 @@ void battery_client_app_timer( uint32_t arg )
     app_timer_count++;
     if ((app_timer_count % 10) == 0)
         WICED_BT_TRACE("%d \n", app_timer_count);
+
+    if ( battery_client_app_state.polling && ( battery_client_app_data.conn_id != 0 ) &&
+         ( battery_client_app_state.poll_countdown != 0 ) && ( --battery_client_app_state.poll_countdown == 0 ) )
+    {
+        if ( wiced_bt_bac_read_battery_level( battery_client_app_data.conn_id ) != WICED_BT_GATT_SUCCESS )
+            battery_client_app_state.poll_countdown = battery_client_app_state.poll_interval;
+    }
+}
+
+/*
+ * The server does not notify the Battery Level, read it now and then periodically
+ */
+static void battery_client_start_polling( uint16_t conn_id )
+{
+    wiced_bt_gatt_status_t status;
+
+    battery_client_app_state.polling        = WICED_TRUE;
+    battery_client_app_state.poll_interval  = BAC_POLL_MIN_S;
+    battery_client_app_state.poll_countdown = 0;
+    battery_client_app_state.level_valid    = WICED_FALSE;
+
+    BAC_TRACE_DBG("Read Battery Level\n");
+    status = wiced_bt_bac_read_battery_level( conn_id );
+    if (status != WICED_BT_GATT_SUCCESS)
+    {
+        BAC_TRACE_ERR("wiced_bt_bac_read_battery_level failed status:%d\n", status);
+        battery_client_app_state.poll_countdown = battery_client_app_state.poll_interval;
+    }
+}
+
+/*
+ * Schedule the next read from the level just read: as long as the level last took to change by one
+ * percent, or twice the current period if it did not change
+ */
+static void battery_client_poll_level( uint8_t level )
+{
+    uint32_t interval = battery_client_app_state.poll_interval;
+    uint8_t  delta;
+
+    if ( !battery_client_app_state.level_valid )
+    {
+        battery_client_app_state.level_valid = WICED_TRUE;
+        battery_client_app_state.level       = level;
+        battery_client_app_state.level_time  = app_timer_count;
+    }
+    else if ( level != battery_client_app_state.level )
+    {
+        delta = ( level > battery_client_app_state.level ) ? ( level - battery_client_app_state.level ) : ( battery_client_app_state.level - level );
+        interval = ( app_timer_count - battery_client_app_state.level_time ) / delta;
+        battery_client_app_state.level      = level;
+        battery_client_app_state.level_time = app_timer_count;
+    }
+    else
+    {
+        interval *= 2;
+    }
+
+    if ( interval < BAC_POLL_MIN_S )
+        interval = BAC_POLL_MIN_S;
+    if ( interval > BAC_POLL_MAX_S )
+        interval = BAC_POLL_MAX_S;
+
+    battery_client_app_state.poll_interval  = (uint16_t)interval;
+    battery_client_app_state.poll_countdown = (uint16_t)interval;
+    BAC_TRACE_DBG("next read in %d s\n", interval);
 }
 
 void battery_client_interrupt_handler( void *user_data, uint8_t value )
@@ -317,6 +415,7 @@ void battery_client_interrupt_handler( void *user_data, uint8_t value )
             /*start scan if not connected and no scan in progress*/
             if (( battery_client_app_data.conn_id == 0 ) && (wiced_bt_ble_get_current_scan_state() == BTM_BLE_SCAN_TYPE_NONE))
             {
+                scan_filter_reset( &battery_client_scan_filter );
                 result = wiced_bt_ble_scan( BTM_BLE_SCAN_TYPE_HIGH_DUTY, WICED_TRUE, battery_client_scan_result_cback );
                 WICED_BT_TRACE("wiced_bt_ble_scan: %d \n", result);
             }
@@ -324,14 +423,19 @@ void battery_client_interrupt_handler( void *user_data, uint8_t value )
     }
 }
 
+#ifdef ENABLE_HCI_TRACE
+/* HCI traces are kept in the ring and sent up through the UART in the background */
+static const hci_trace_ring_cfg_t battery_client_trace_ring_cfg = HCI_TRACE_RING_CFG_DEFAULT( NULL );
+static uint8_t battery_client_trace_ring_buf[HCI_TRACE_RING_BUF_SIZE( HCI_TRACE_RING_SLOTS, HCI_TRACE_RING_MAX_PAYLOAD )];
+static hci_trace_ring_t battery_client_trace_ring;
+
 /*
  *  Pass protocol traces up through the UART
  */
-#ifdef ENABLE_HCI_TRACE
 void battery_client_hci_trace_cback( wiced_bt_hci_trace_type_t type, uint16_t length, uint8_t* p_data )
 {
-    //send the trace
-    wiced_transport_send_hci_trace( NULL, type, length, p_data  );
+    //keep the trace until the ring drains
+    hci_trace_ring_put( &battery_client_trace_ring, type, length, p_data );
 }
 #endif
 
@@ -343,6 +447,7 @@ static void battery_client_app_init()
     /* Initialize wiced app */
     wiced_bt_app_init();
 #endif
+    scan_filter_init( &battery_client_scan_filter, battery_client_scan_match );
 
     /* Register with stack to receive GATT callback */
     gatt_status = wiced_bt_gatt_register(battery_client_gatts_callback);
@@ -351,10 +456,13 @@ static void battery_client_app_init()
 
 #ifdef ENABLE_HCI_TRACE
     /* Register callback for receiving hci traces */
+    hci_trace_ring_init( &battery_client_trace_ring, &battery_client_trace_ring_cfg, battery_client_trace_ring_buf, sizeof( battery_client_trace_ring_buf ) );
     wiced_bt_dev_register_hci_trace( battery_client_hci_trace_cback );
 #endif
 
     /* Load the address resolution DB with the keys stored in the NVRAM */
+    bond_store_init( &battery_client_bond_store, BATTERY_CLIENT_PAIRED_KEYS_START_VS_ID, BOND_STORE_MAX_DEVICES );
+    gatt_disc_cache_init( &battery_client_disc_cache, BATTERY_CLIENT_DISC_CACHE_VS_ID, &battery_client_bond_store );
     battery_client_load_keys_to_addr_resolution_db();
 }
 
@@ -396,7 +504,7 @@ static wiced_result_t battery_client_management_cback( wiced_bt_management_evt_t
 
     case BTM_ENCRYPTION_STATUS_EVT:
         WICED_BT_TRACE("Encryption Status Event: bd (%B) res %d\n", p_event_data->encryption_status.bd_addr, p_event_data->encryption_status.result);
-        if (p_event_data->encryption_status.result == WICED_BT_SUCCESS)
+        if ((p_event_data->encryption_status.result == WICED_BT_SUCCESS) && battery_client_app_state.notification_supported)
         {
             wiced_bt_bac_enable_notification( battery_client_app_data.conn_id );
         }
@@ -529,7 +637,22 @@ static wiced_bt_gatt_status_t battery_client_gatt_operation_complete( wiced_bt_g
     {
         case GATTC_OPTYPE_READ:
             WICED_BT_TRACE( "read_rsp status:%d\n", p_data->status );
-            battery_client_process_read_rsp(p_data);
+            switch ( gatt_disc_cache_read_rsp( &battery_client_disc_cache, p_data, &battery_client_app_state.bac_s_handle, &battery_client_app_state.bac_e_handle ) )
+            {
+                case GATT_DISC_CACHE_HIT:
+                    // database did not change, tell WICED BT bac library to start its discovery
+                    battery_client_app_state.discovery_state = BAC_DISCOVERY_STATE_CHAR;
+                    wiced_bt_bac_discover( p_data->conn_id, battery_client_app_state.bac_s_handle, battery_client_app_state.bac_e_handle );
+                    return WICED_BT_GATT_SUCCESS;
+
+                case GATT_DISC_CACHE_MISS:
+                    battery_client_start_service_discovery( p_data->conn_id );
+                    return WICED_BT_GATT_SUCCESS;
+
+                default:
+                    battery_client_process_read_rsp(p_data);
+                    break;
+            }
             break;
 
         case GATTC_OPTYPE_WRITE:
@@ -545,6 +668,13 @@ static wiced_bt_gatt_status_t battery_client_gatt_operation_complete( wiced_bt_g
                     is_enabled_notification = WICED_FALSE;
                 }
             }
+            else if ( !is_enabled_notification && !battery_client_app_state.polling &&
+                      ( p_data->status != WICED_BT_GATT_INSUF_AUTHENTICATION ) &&
+                      ( p_data->status != WICED_BT_GATT_INSUF_ENCRYPTION ) )
+            {
+                // the server refused the notifications, fall back to polling
+                battery_client_start_polling( p_data->conn_id );
+            }
             break;
 
         case GATTC_OPTYPE_CONFIG:
@@ -595,8 +725,6 @@ void battery_client_add_peer_info( uint16_t conn_id, uint8_t* p_bd_addr, uint8_t
 static wiced_bt_gatt_status_t battery_client_connection_up( wiced_bt_gatt_connection_status_t *p_conn_status )
 {
     uint8_t dev_role;
-    wiced_bt_dev_status_t status ;
-    wiced_bt_ble_sec_action_type_t  encryption_type = BTM_BLE_SEC_ENCRYPT;
 
     wiced_bt_dev_get_role( p_conn_status->bd_addr, &dev_role, BT_TRANSPORT_LE );
 
@@ -614,17 +742,36 @@ static wiced_bt_gatt_status_t battery_client_connection_up( wiced_bt_gatt_connec
     battery_client_app_state.bac_s_handle = 0;
     battery_client_app_state.bac_e_handle = 0;
 
-   // perform primary service search
-    status = wiced_bt_util_send_gatt_discover( p_conn_status->conn_id, GATT_DISCOVER_SERVICES_ALL, UUID_ATTRIBUTE_PRIMARY_SERVICE, 1, 0xffff);
-    WICED_BT_TRACE("start discover status:%d\n", status);
+    // a bonded peer may have its Battery Service range cached
+    if ( !battery_client_is_device_bonded( p_conn_status->bd_addr ) ||
+         !gatt_disc_cache_check( &battery_client_disc_cache, p_conn_status->conn_id, p_conn_status->bd_addr ) )
+    {
+        battery_client_start_service_discovery( p_conn_status->conn_id );
+    }
 
     return WICED_BT_GATT_SUCCESS;
 }
 
+/*
+ * Look for the Battery Service with a primary service search
+ */
+static void battery_client_start_service_discovery( uint16_t conn_id )
+{
+    wiced_bt_gatt_status_t status;
+
+    status = wiced_bt_util_send_gatt_discover( conn_id, GATT_DISCOVER_SERVICES_ALL, UUID_ATTRIBUTE_PRIMARY_SERVICE, 1, 0xffff);
+    WICED_BT_TRACE("start discover status:%d\n", status);
+}
+
 static wiced_bt_gatt_status_t battery_client_connection_down( wiced_bt_gatt_connection_status_t *p_conn_status )
 {
     WICED_BT_TRACE("battery client connection down\n");
+    gatt_disc_cache_connection_down( &battery_client_disc_cache, p_conn_status->conn_id );
     battery_client_app_data.conn_id = 0;
+    is_enabled_notification = WICED_FALSE;
+
+    battery_client_app_state.notification_supported = WICED_FALSE;
+    battery_client_app_state.polling = WICED_FALSE;
 
     battery_client_app_state.discovery_state = BAC_DISCOVERY_STATE_SERVICE;
     battery_client_app_state.bac_s_handle = 0;
@@ -635,6 +782,14 @@ static wiced_bt_gatt_status_t battery_client_connection_down( wiced_bt_gatt_conn
     return WICED_BT_GATT_SUCCESS;
 }
 
+/*
+ * Search for the Battery Service in the complete and partial UUID_16 lists
+ */
+static wiced_bool_t battery_client_scan_match( wiced_bt_ble_scan_results_t *p_scan_result, uint8_t *p_adv_data )
+{
+    return scan_filter_adv_has_uuid16( p_adv_data, UUID_SERVICE_BATTERY );
+}
+
 /*
  * This function handles the scan results and attempt to connect to Battery Service Server.
  */
@@ -642,34 +797,11 @@ static void battery_client_scan_result_cback( wiced_bt_ble_scan_results_t *p_sca
 {
     wiced_result_t          status;
     wiced_bool_t            ret_status;
-    uint8_t                 length;
-    uint8_t *               p_data;
-    uint16_t                service_uuid16=0;
 
     if ( p_scan_result )
     {
-        // Search for SERVICE_UUID_16 element in the Advertisement data received.Check for both
-        // complete and partial list
-        p_data = wiced_bt_ble_check_advertising_data( p_adv_data, BTM_BLE_ADVERT_TYPE_16SRV_COMPLETE, &length );
-        if ( p_data == NULL )
-        {
-            p_data = wiced_bt_ble_check_advertising_data( p_adv_data, BTM_BLE_ADVERT_TYPE_16SRV_PARTIAL, &length );
-            if (p_data == NULL)
-                return;     // No UUID_16 element
-        }
-
-        while (length >= LEN_UUID_16)
-        {
-            STREAM_TO_UINT16(service_uuid16, p_data);
-            if (service_uuid16 == UUID_SERVICE_BATTERY)
-            {
-                // UUID16 Battery Service found
-                break;
-            }
-            length -= LEN_UUID_16;
-        }
-
-        if (service_uuid16 != UUID_SERVICE_BATTERY)
+        // The filter remembers the devices already checked
+        if ( !scan_filter_check( &battery_client_scan_filter, p_scan_result, p_adv_data ) )
         {
             // UUID16 Battery Service not found. Ignore device
             return;
@@ -776,23 +908,28 @@ static void battery_client_callback(wiced_bt_bac_event_t event, wiced_bt_bac_eve
         /* If Battery Service successfully discovered */
         if (p_data->discovery.status == WICED_BT_GATT_SUCCESS)
         {
+            gatt_disc_cache_store(&battery_client_disc_cache, battery_client_app_data.peer_addr,
+                    battery_client_app_state.bac_s_handle, battery_client_app_state.bac_e_handle);
+
             /* if the Battery Service supports (optional) Notification, enable Notifications. */
+            battery_client_app_state.notification_supported = p_data->discovery.notification_supported;
             if (p_data->discovery.notification_supported)
             {
                 /* Enable Battery Level Notification */
                 BAC_TRACE_DBG("Enable Battery Level Notification\n");
                 status = wiced_bt_bac_enable_notification(p_data->discovery.conn_id);
-                if (status != WICED_BT_GATT_SUCCESS)
-                    BAC_TRACE_ERR("wiced_bt_bac_enable_notification failed status:%d\n", status);
-            }
-            else
-            {
-                /* Notification not supported by Server, just Read the Current Battery Level */
-                BAC_TRACE_DBG("Read Battery Level\n");
-                status = wiced_bt_bac_read_battery_level(p_data->discovery.conn_id);
-                if (status != WICED_BT_GATT_SUCCESS)
-                    BAC_TRACE_ERR("wiced_bt_bac_read_battery_level failed status:%d\n", status);
+                if (status == WICED_BT_GATT_SUCCESS)
+                    break;
+                BAC_TRACE_ERR("wiced_bt_bac_enable_notification failed status:%d\n", status);
             }
+
+            /* Notification not supported by Server, poll the Battery Level */
+            battery_client_start_polling(p_data->discovery.conn_id);
+        }
+        else
+        {
+            /* the cached range, if it was used, is not right */
+            gatt_disc_cache_invalidate(&battery_client_disc_cache, battery_client_app_data.peer_addr);
         }
         break;
 
@@ -800,6 +937,17 @@ static void battery_client_callback(wiced_bt_bac_event_t event, wiced_bt_bac_eve
         BAC_TRACE_DBG("Battery Level Rsp conn_id:%d status:%d level:%d\n",
                 p_data->battery_level_rsp.conn_id, p_data->battery_level_rsp.status,
                 p_data->battery_level_rsp.battery_level);
+        if (battery_client_app_state.polling)
+        {
+            if (p_data->battery_level_rsp.status == WICED_BT_GATT_SUCCESS)
+            {
+                battery_client_poll_level(p_data->battery_level_rsp.battery_level);
+            }
+            else
+            {
+                battery_client_app_state.poll_countdown = battery_client_app_state.poll_interval;
+            }
+        }
         break;
 
     case WICED_BT_BAC_EVENT_BATTERY_LEVEL_NOTIFICATION:
@@ -816,135 +964,21 @@ static void battery_client_callback(wiced_bt_bac_event_t event, wiced_bt_bac_eve
 
 static void battery_client_load_keys_to_addr_resolution_db()
 {
-    uint8_t                     bytes_read;
-    wiced_result_t              result;
-    wiced_bt_device_link_keys_t keys;
-    uint16_t                    i;
-
-    for ( i = BATTERY_CLIENT_PAIRED_KEYS_START_VS_ID; i < WICED_NVRAM_VSID_END; i++ )
-    {
-        bytes_read = wiced_hal_read_nvram(i, sizeof(keys), (uint8_t *)&keys, &result);
-
-        WICED_BT_TRACE("[%s] read status %d bytes read %d \n", __FUNCTION__, result, bytes_read);
-
-        // if failed to read NVRAM, there is nothing saved at that location
-        if ((result == WICED_SUCCESS) && (bytes_read == sizeof(wiced_bt_device_link_keys_t)))
-        {
-#ifdef CYW20706A2
-            result = wiced_bt_dev_add_device_to_address_resolution_db(&keys, keys.key_data.ble_addr_type);
-#else
-            result = wiced_bt_dev_add_device_to_address_resolution_db(&keys);
-#endif
-        }
-        else
-        {
-            break;
-        }
-    }
+    bond_store_load_addr_resolution_db( &battery_client_bond_store );
 }
 
 static wiced_bool_t battery_client_save_link_keys( wiced_bt_device_link_keys_t *p_keys )
 {
-    uint8_t                     bytes_written, bytes_read;
-    wiced_bt_device_link_keys_t temp_keys;
-    uint16_t                    id = 0;
-    uint32_t i;
-    wiced_result_t              result;
-
-    // search through all available NVRAM IDs.
-    for ( i = BATTERY_CLIENT_PAIRED_KEYS_START_VS_ID; i < WICED_NVRAM_VSID_END; i++ )
-    {
-        bytes_read = wiced_hal_read_nvram( i, sizeof( temp_keys ), (uint8_t *)&temp_keys, &result );
-
-        WICED_BT_TRACE( "Read NVRAM at:%d bytes:%d result:%d\n", i, bytes_read, result );
-
-        // if failed to read NVRAM, there is nothing saved at that location
-        if ( ( result != WICED_SUCCESS ) || ( bytes_read != sizeof( temp_keys ) ) )
-        {
-            id = i;
-            break;
-        }
-        else
-        {
-            if ( memcmp( temp_keys.bd_addr, p_keys->bd_addr, BD_ADDR_LEN ) == 0 )
-            {
-                // keys for this device have been saved, reuse the ID
-                id = i;
-                break;
-            }
-        }
-    }
-    if ( id == 0 )
-    {
-        // all NVRAM locations are already occupied.  Cann't save anything.
-        WICED_BT_TRACE( "Failed to save NVRAM\n" );
-        return WICED_FALSE;
-    }
-    WICED_BT_TRACE( "writing to id:%d\n", id );
-    bytes_written = wiced_hal_write_nvram( id, sizeof( wiced_bt_device_link_keys_t ), (uint8_t *)p_keys, &result );
-    WICED_BT_TRACE( "Saved %d bytes at id:%d %d\n", bytes_written, id );
-    return WICED_TRUE;
+    return bond_store_save( &battery_client_bond_store, p_keys );
 }
 
 static wiced_bool_t battery_client_read_link_keys(wiced_bt_device_link_keys_t *p_keys)
 {
-    wiced_bt_device_link_keys_t temp_keys;
-    uint8_t                     bytes_read;
-    uint16_t                    i;
-    wiced_result_t              result;
-
-    // search through all available NVRAM IDs.
-    for ( i = BATTERY_CLIENT_PAIRED_KEYS_START_VS_ID; i < WICED_NVRAM_VSID_END; i++ )
-    {
-        bytes_read = wiced_hal_read_nvram( i, sizeof( temp_keys ), (uint8_t *)&temp_keys, &result );
-
-        WICED_BT_TRACE("[%s] read status %d bytes read %d \n", __FUNCTION__, result, bytes_read);
-
-        // if failed to read NVRAM, there is nothing saved at that location
-        if ( result == WICED_SUCCESS )
-        {
-            if ( memcmp( temp_keys.bd_addr, p_keys->bd_addr, BD_ADDR_LEN ) == 0 )
-            {
-                // keys for this device have been saved
-                memcpy( &p_keys->key_data, &temp_keys.key_data, sizeof( temp_keys.key_data ) );
-                return WICED_TRUE;
-            }
-        }
-        else
-        {
-            break;
-        }
-    }
-    return WICED_FALSE;
+    return bond_store_read( &battery_client_bond_store, p_keys );
 }
 
-/* Check for device entry exists in NVRAM list */
+/* Check for device entry exists in the bonded device index */
 static wiced_bool_t battery_client_is_device_bonded( wiced_bt_device_address_t bd_address )
 {
-    wiced_bt_device_link_keys_t temp_keys;
-    uint8_t                     bytes_read;
-    uint16_t                    i;
-    wiced_result_t              result;
-
-    // search through all available NVRAM IDs.
-    for ( i = BATTERY_CLIENT_PAIRED_KEYS_START_VS_ID; i < WICED_NVRAM_VSID_END; i++ )
-    {
-        bytes_read = wiced_hal_read_nvram( i, sizeof( temp_keys ), (uint8_t *)&temp_keys, &result );
-
-        WICED_BT_TRACE("[%s] read status %d bytes read %d \n", __FUNCTION__, result, bytes_read);
-
-        // if failed to read NVRAM, there is nothing saved at that location
-        if ( result == WICED_SUCCESS )
-        {
-            if ( memcmp( temp_keys.bd_addr, bd_address, BD_ADDR_LEN ) == 0 )
-            {
-                return WICED_TRUE;
-            }
-        }
-        else
-        {
-            break;
-        }
-    }
-    return WICED_FALSE;
+    return bond_store_is_bonded( &battery_client_bond_store, bd_address );
 }
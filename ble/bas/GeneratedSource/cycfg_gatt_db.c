@@ -50,6 +50,17 @@ const uint8_t gatt_database[] =
         CHARACTERISTIC_UUID16 (HDLC_BAS_BATTERY_LEVEL, HDLC_BAS_BATTERY_LEVEL_VALUE, __UUID_CHARACTERISTIC_BATTERY_LEVEL, LEGATTDB_CHAR_PROP_READ | LEGATTDB_CHAR_PROP_NOTIFY, LEGATTDB_PERM_READABLE),
             /* Descriptor: Client Characteristic Configuration */
             CHAR_DESCRIPTOR_UUID16_WRITABLE (HDLD_BAS_BATTERY_LEVEL_CLIENT_CHAR_CONFIG, __UUID_DESCRIPTOR_CLIENT_CHARACTERISTIC_CONFIGURATION, LEGATTDB_PERM_READABLE | LEGATTDB_PERM_WRITE_REQ),
+            /* Descriptor: Characteristic Presentation Format */
+            CHAR_DESCRIPTOR_UUID16 (HDLD_BAS_BATTERY_LEVEL_CHAR_PRESENTATION_FORMAT, __UUID_DESCRIPTOR_CHARACTERISTIC_PRESENTATION_FORMAT, LEGATTDB_PERM_READABLE),
+
+    /* Primary Service: Battery */
+    PRIMARY_SERVICE_UUID16 (HDLS_BAS_COIN, __UUID_SERVICE_BATTERY),
+        /* Characteristic: Battery Level */
+        CHARACTERISTIC_UUID16 (HDLC_BAS_COIN_BATTERY_LEVEL, HDLC_BAS_COIN_BATTERY_LEVEL_VALUE, __UUID_CHARACTERISTIC_BATTERY_LEVEL, LEGATTDB_CHAR_PROP_READ | LEGATTDB_CHAR_PROP_NOTIFY, LEGATTDB_PERM_READABLE),
+            /* Descriptor: Client Characteristic Configuration */
+            CHAR_DESCRIPTOR_UUID16_WRITABLE (HDLD_BAS_COIN_BATTERY_LEVEL_CLIENT_CHAR_CONFIG, __UUID_DESCRIPTOR_CLIENT_CHARACTERISTIC_CONFIGURATION, LEGATTDB_PERM_READABLE | LEGATTDB_PERM_WRITE_REQ),
+            /* Descriptor: Characteristic Presentation Format */
+            CHAR_DESCRIPTOR_UUID16 (HDLD_BAS_COIN_BATTERY_LEVEL_CHAR_PRESENTATION_FORMAT, __UUID_DESCRIPTOR_CHARACTERISTIC_PRESENTATION_FORMAT, LEGATTDB_PERM_READABLE),
 };
 
 /* Length of the GATT database */
@@ -59,10 +70,14 @@ const uint16_t gatt_database_len = sizeof(gatt_database);
  * GATT Initial Value Arrays
  ************************************************************************************/
 
-uint8_t app_gap_device_name[]                      = {'B', 'a', 't', 't', 'e', 'r', 'y', ' ', 'S', 'e', 'r', 'v', 'i', 'c', 'e', };
-uint8_t app_gap_appearance[]                       = {0x00, 0x02, };
-uint8_t app_bas_battery_level[]                    = {0x00, };
-uint8_t app_bas_battery_level_client_char_config[] = {0x00, 0x00, };
+uint8_t app_gap_device_name[]                                 = {'B', 'a', 't', 't', 'e', 'r', 'y', ' ', 'S', 'e', 'r', 'v', 'i', 'c', 'e', };
+uint8_t app_gap_appearance[]                                  = {0x00, 0x02, };
+uint8_t app_bas_battery_level[]                               = {0x00, };
+uint8_t app_bas_battery_level_client_char_config[]            = {0x00, 0x00, };
+uint8_t app_bas_battery_level_char_presentation_format[]      = {0x04, 0x00, 0xAD, 0x27, 0x01, 0x01, 0x00, };
+uint8_t app_bas_coin_battery_level[]                          = {0x00, };
+uint8_t app_bas_coin_battery_level_client_char_config[]       = {0x00, 0x00, };
+uint8_t app_bas_coin_battery_level_char_presentation_format[] = {0x04, 0x00, 0xAD, 0x27, 0x01, 0x02, 0x00, };
 
  /************************************************************************************
  * GATT Lookup Table
@@ -70,11 +85,15 @@ uint8_t app_bas_battery_level_client_char_config[] = {0x00, 0x00, };
 
 gatt_db_lookup_table_t app_gatt_db_ext_attr_tbl[] =
 {
-    /* { attribute handle,                       maxlen, curlen, attribute data } */
-    { HDLC_GAP_DEVICE_NAME_VALUE,                15,     15,     app_gap_device_name },
-    { HDLC_GAP_APPEARANCE_VALUE,                 2,      2,      app_gap_appearance },
-    { HDLC_BAS_BATTERY_LEVEL_VALUE,              1,      1,      app_bas_battery_level },
-    { HDLD_BAS_BATTERY_LEVEL_CLIENT_CHAR_CONFIG, 2,      2,      app_bas_battery_level_client_char_config },
+    /* { attribute handle,                                  maxlen, curlen, attribute data } */
+    { HDLC_GAP_DEVICE_NAME_VALUE,                           15,     15,     app_gap_device_name },
+    { HDLC_GAP_APPEARANCE_VALUE,                            2,      2,      app_gap_appearance },
+    { HDLC_BAS_BATTERY_LEVEL_VALUE,                         1,      1,      app_bas_battery_level },
+    { HDLD_BAS_BATTERY_LEVEL_CLIENT_CHAR_CONFIG,            2,      2,      app_bas_battery_level_client_char_config },
+    { HDLD_BAS_BATTERY_LEVEL_CHAR_PRESENTATION_FORMAT,      7,      7,      app_bas_battery_level_char_presentation_format },
+    { HDLC_BAS_COIN_BATTERY_LEVEL_VALUE,                    1,      1,      app_bas_coin_battery_level },
+    { HDLD_BAS_COIN_BATTERY_LEVEL_CLIENT_CHAR_CONFIG,       2,      2,      app_bas_coin_battery_level_client_char_config },
+    { HDLD_BAS_COIN_BATTERY_LEVEL_CHAR_PRESENTATION_FORMAT, 7,      7,      app_bas_coin_battery_level_char_presentation_format },
 };
 
 /* Number of Lookup Table entries */
@@ -85,3 +104,7 @@ const uint16_t app_gap_device_name_len = (sizeof(app_gap_device_name));
 const uint16_t app_gap_appearance_len = (sizeof(app_gap_appearance));
 const uint16_t app_bas_battery_level_len = (sizeof(app_bas_battery_level));
 const uint16_t app_bas_battery_level_client_char_config_len = (sizeof(app_bas_battery_level_client_char_config));
+const uint16_t app_bas_battery_level_char_presentation_format_len = (sizeof(app_bas_battery_level_char_presentation_format));
+const uint16_t app_bas_coin_battery_level_len = (sizeof(app_bas_coin_battery_level));
+const uint16_t app_bas_coin_battery_level_client_char_config_len = (sizeof(app_bas_coin_battery_level_client_char_config));
+const uint16_t app_bas_coin_battery_level_char_presentation_format_len = (sizeof(app_bas_coin_battery_level_char_presentation_format));
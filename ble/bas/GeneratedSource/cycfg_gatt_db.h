@@ -30,33 +30,46 @@
 
 #include "stdint.h"
 
-#define __UUID_SERVICE_GENERIC_ACCESS                0x1800
-#define __UUID_CHARACTERISTIC_DEVICE_NAME            0x2A00
-#define __UUID_CHARACTERISTIC_APPEARANCE             0x2A01
-#define __UUID_SERVICE_GENERIC_ATTRIBUTE             0x1801
-#define __UUID_SERVICE_BATTERY                       0x180F
-#define __UUID_CHARACTERISTIC_BATTERY_LEVEL          0x2A19
+#define __UUID_SERVICE_GENERIC_ACCESS                           0x1800
+#define __UUID_CHARACTERISTIC_DEVICE_NAME                       0x2A00
+#define __UUID_CHARACTERISTIC_APPEARANCE                        0x2A01
+#define __UUID_SERVICE_GENERIC_ATTRIBUTE                        0x1801
+#define __UUID_SERVICE_BATTERY                                  0x180F
+#define __UUID_CHARACTERISTIC_BATTERY_LEVEL                     0x2A19
 #define __UUID_DESCRIPTOR_CLIENT_CHARACTERISTIC_CONFIGURATION    0x2902
+#define __UUID_DESCRIPTOR_CHARACTERISTIC_PRESENTATION_FORMAT    0x2904
 
 /* Service Generic Access */
-#define HDLS_GAP                                     0x01
+#define HDLS_GAP                                                0x01
 /* Characteristic Device Name */
-#define HDLC_GAP_DEVICE_NAME                         0x02
-#define HDLC_GAP_DEVICE_NAME_VALUE                   0x03
+#define HDLC_GAP_DEVICE_NAME                                    0x02
+#define HDLC_GAP_DEVICE_NAME_VALUE                              0x03
 /* Characteristic Appearance */
-#define HDLC_GAP_APPEARANCE                          0x04
-#define HDLC_GAP_APPEARANCE_VALUE                    0x05
+#define HDLC_GAP_APPEARANCE                                     0x04
+#define HDLC_GAP_APPEARANCE_VALUE                               0x05
 
 /* Service Generic Attribute */
-#define HDLS_GATT                                    0x06
+#define HDLS_GATT                                               0x06
 
 /* Service Battery */
-#define HDLS_BAS                                     0x07
+#define HDLS_BAS                                                0x07
 /* Characteristic Battery Level */
-#define HDLC_BAS_BATTERY_LEVEL                       0x08
-#define HDLC_BAS_BATTERY_LEVEL_VALUE                 0x09
+#define HDLC_BAS_BATTERY_LEVEL                                  0x08
+#define HDLC_BAS_BATTERY_LEVEL_VALUE                            0x09
 /* Descriptor Client Characteristic Configuration */
-#define HDLD_BAS_BATTERY_LEVEL_CLIENT_CHAR_CONFIG    0x0A
+#define HDLD_BAS_BATTERY_LEVEL_CLIENT_CHAR_CONFIG               0x0A
+/* Descriptor Characteristic Presentation Format */
+#define HDLD_BAS_BATTERY_LEVEL_CHAR_PRESENTATION_FORMAT         0x0B
+
+/* Service Battery */
+#define HDLS_BAS_COIN                                           0x0C
+/* Characteristic Battery Level */
+#define HDLC_BAS_COIN_BATTERY_LEVEL                             0x0D
+#define HDLC_BAS_COIN_BATTERY_LEVEL_VALUE                       0x0E
+/* Descriptor Client Characteristic Configuration */
+#define HDLD_BAS_COIN_BATTERY_LEVEL_CLIENT_CHAR_CONFIG          0x0F
+/* Descriptor Characteristic Presentation Format */
+#define HDLD_BAS_COIN_BATTERY_LEVEL_CHAR_PRESENTATION_FORMAT    0x10
 
 /* External Lookup Table Entry */
 typedef struct
@@ -80,5 +93,13 @@ extern uint8_t app_bas_battery_level[];
 extern const uint16_t app_bas_battery_level_len;
 extern uint8_t app_bas_battery_level_client_char_config[];
 extern const uint16_t app_bas_battery_level_client_char_config_len;
+extern uint8_t app_bas_battery_level_char_presentation_format[];
+extern const uint16_t app_bas_battery_level_char_presentation_format_len;
+extern uint8_t app_bas_coin_battery_level[];
+extern const uint16_t app_bas_coin_battery_level_len;
+extern uint8_t app_bas_coin_battery_level_client_char_config[];
+extern const uint16_t app_bas_coin_battery_level_client_char_config_len;
+extern uint8_t app_bas_coin_battery_level_char_presentation_format[];
+extern const uint16_t app_bas_coin_battery_level_char_presentation_format_len;
 
 #endif /* CYCFG_GATT_DB_H */
@@ -37,6 +37,10 @@
  *
  * Features demonstrated
  *  -Battery Service implementation. For details refer to BT SIG Battery Service Profile 1.0 spec.
+ *  -Several Battery Service instances, the main battery pack and a coin cell, told apart by their
+ *   Characteristic Presentation Format descriptor.
+ *  -Several clients connected at the same time, each with its own client configuration descriptors,
+ *   saved in NVRAM for each bonded client.
  *
  * On startup this demo:
  *  - Initializes the Battery Service GATT database
@@ -48,11 +52,15 @@
  * 2. Build and download the application (to the WICED board)
  * 3. On application start the device acts as a GATT server and advertises itself as Battery Service.
  * 4. Connect to Battery Service using one of the LE clients (LEExplorer(android)) or (BLE Utility(Apple Store))
- *    or battery_service_client application.
+ *    or battery_service_client application. Up to BATTERY_SERVICE_GATTS_MAX_CONN clients can be connected, the
+ *    Battery Server keeps advertising while it can take one more.
  * 5. Once connected the client can read Battery levels.
- * 6. If the client enables the notification, the Battery Server will send battery level every 30secs.
- * 7. Battery Level starts from 100 and keeps decrementing to 0. The Battery Server App is designed such that,
- *    once it hits 0, it will be rolled back to 100.
+ * 6. The Battery Server samples the battery levels every 10secs. If a client enables the notification of a
+ *    battery, the Battery Server notifies it the level when it moved by BATTERY_SERVICE_NOTIFY_THRESHOLD percents
+ *    since the last notification to this client, at most once every BATTERY_SERVICE_NOTIFY_MIN_INTERVAL_MS.
+ * 7. On chips with the ADC driver the levels are computed from the battery voltages. Otherwise Battery Levels start
+ *    from 100 and keep decrementing to 0, the coin cell more slowly. The Battery Server App is designed such that,
+ *    once a level hits 0, it will be rolled back to 100.
  */
 
 #include "sparcommon.h"
@@ -71,11 +79,19 @@
 #include "wiced_memory.h"
 #include "wiced_transport.h"
 #include "GeneratedSource/cycfg_gatt_db.h"
+#include "gatt_attr_index.h"
 #include "wiced_hal_nvram.h"
 #include "wiced_timer.h"
 #include "wiced_hal_puart.h"
 #include "string.h"
 #include "wiced_bt_stack.h"
+#include "sample_filter.h"
+#include "bond_store.h"
+#include "power_mgr.h"
+#if defined(CYW20735B1) || defined(CYW20819A1) || defined(CYW20719B2) || defined(CYW20721B2)
+#include "wiced_hal_adc.h"
+#define BATTERY_SERVICE_BATT_ADC
+#endif
 
 #ifdef  WICED_BT_TRACE_ENABLE
 #include "wiced_bt_trace.h"
@@ -90,23 +106,76 @@ extern const wiced_bt_cfg_buf_pool_t wiced_app_cfg_buf_pools[];
 /******************************************************************************
  *                                Constants
  ******************************************************************************/
-#define BATTERY_SERVICE_GATTS_MAX_CONN              1
+#define BATTERY_SERVICE_GATTS_MAX_CONN              3       /* server_max_links in wiced_app_cfg.c */
+#define BATTERY_SERVICE_MAX_BONDS                   4       /* clients whose keys and configuration are saved */
+#define BATTERY_SERVICE_NUM_BATTERIES               2       /* Battery Service instances */
 #define MAX_BATTERY_LEVEL                         100
-#define BATTERY_SERVICE_TIMER_DURATION_IN_MS    30000
-#define BATTERY_SERVICE_VS_ID              WICED_NVRAM_VSID_START
+#define BATTERY_SERVICE_TIMER_PERIOD_IN_SECONDS 10      /* battery sampling period */
+#define BATTERY_SERVICE_VS_ID              WICED_NVRAM_VSID_START    /* configuration of the bonded clients */
 #define BATTERY_SERVICE_LOCAL_KEYS_VS_ID   ( BATTERY_SERVICE_VS_ID + 1 )
-#define BATTERY_SERVICE_PAIRED_KEYS_VS_ID  BATTERY_SERVICE_LOCAL_KEYS_VS_ID + 1
+#define BATTERY_SERVICE_PAIRED_KEYS_VS_ID  ( BATTERY_SERVICE_LOCAL_KEYS_VS_ID + 1 )   /* BOND_STORE_NUM_VS_ID( BATTERY_SERVICE_MAX_BONDS ) ids */
+
+/* A notification is sent when the level moved by the threshold since the last one, not more often than the interval */
+#ifndef BATTERY_SERVICE_NOTIFY_THRESHOLD
+#define BATTERY_SERVICE_NOTIFY_THRESHOLD            2
+#endif
+#ifndef BATTERY_SERVICE_NOTIFY_MIN_INTERVAL_MS
+#define BATTERY_SERVICE_NOTIFY_MIN_INTERVAL_MS  60000
+#endif
+
+/* Voltages of a full and of an empty battery, the level is linear in between */
+#define BATTERY_SERVICE_MAIN_FULL_MV             3000
+#define BATTERY_SERVICE_MAIN_EMPTY_MV            2000
+#define BATTERY_SERVICE_COIN_FULL_MV             3000
+#define BATTERY_SERVICE_COIN_EMPTY_MV            2200
+#define BATTERY_SERVICE_BATT_FILTER_WINDOW          5
+
+#ifdef BATTERY_SERVICE_BATT_ADC
+#define BATTERY_SERVICE_MAIN_ADC_INPUT     ADC_INPUT_VDDIO
+#ifndef BATTERY_SERVICE_COIN_ADC_INPUT
+#define BATTERY_SERVICE_COIN_ADC_INPUT     ADC_INPUT_P10    /* coin cell on a GPIO, through a divider if above VDDIO */
+#endif
+#else
+#define BATTERY_SERVICE_MAIN_ADC_INPUT     0
+#define BATTERY_SERVICE_COIN_ADC_INPUT     0
+#endif
+
+/* Handles of the Battery Service instances, a battery per handle in battery_service_handle_battery[] */
+#define BATTERY_SERVICE_FIRST_HANDLE       HDLS_BAS
+#define BATTERY_SERVICE_LAST_HANDLE        HDLD_BAS_COIN_BATTERY_LEVEL_CHAR_PRESENTATION_FORMAT
+#define BATTERY_SERVICE_NO_BATTERY         0xFF
 
 /******************************************************************************
  *                                Structures
  ******************************************************************************/
+/* One Battery Service instance */
 typedef struct
 {
-    BD_ADDR   remote_addr;              // remote peer device address
-    uint16_t  conn_id;                  // connection ID referenced by the stack
-    uint8_t   flag_notify_sent;         // flag to check whether notifiation was sent
+    uint16_t  value_handle;             // Battery Level characteristic value
+    uint16_t  cccd_handle;              // its client configuration descriptor
+    uint8_t   *p_value;                 // Battery Level in the GATT database
+    uint8_t   adc_input;                // ADC channel of the battery voltage
+    uint16_t  full_mv;
+    uint16_t  empty_mv;
+    uint8_t   sim_period;               // samples per percent of the simulated discharge, without ADC
+    uint8_t   sim_count;
     uint8_t   battery_level;                        /* Battery level */
-}battery_service_app_state_t;
+#ifdef BATTERY_SERVICE_BATT_ADC
+    sample_filter_t filter;             // median of the last voltage samples, ignores the spikes of the radio activity
+#endif
+} battery_service_battery_t;
+
+/* State of one connected client */
+typedef struct
+{
+    BD_ADDR   remote_addr;              // remote peer device address
+    uint16_t  conn_id;                  // connection ID referenced by the stack, 0 if the entry is free
+    uint8_t   flag_congested;           // link congested, wait for the congestion event
+    uint8_t   notify_pending;           // batteries whose level has to be notified, one bit each
+    uint16_t  characteristic_client_configuration[BATTERY_SERVICE_NUM_BATTERIES];  // client configuration descriptors of this client
+    uint8_t   notified_level[BATTERY_SERVICE_NUM_BATTERIES];    // level in the last notification
+    uint32_t  notify_time_ms[BATTERY_SERVICE_NUM_BATTERIES];    // time of the last notification, 0 if none on this connection
+} battery_service_conn_t;
 
 #pragma pack(1)
 
@@ -114,14 +183,11 @@ typedef struct
 typedef PACKED struct
 {
     BD_ADDR  bdaddr;                               /* BD address of the bonded host */
-    uint16_t characteristic_client_configuration;  /* Current value of the client configuration descriptor */
+    uint16_t characteristic_client_configuration[BATTERY_SERVICE_NUM_BATTERIES];  /* Current value of the client configuration descriptors */
 } host_info_t;
 
 #pragma pack()
 
-extern uint8_t app_bas_battery_level[];
-extern uint8_t app_bas_battery_level_client_char_config[];
-
 /******************************************************************************
  *                           Variables Definitions
  ******************************************************************************/
@@ -147,13 +213,34 @@ const wiced_transport_cfg_t  transport_cfg =
     .p_tx_complete_cback = NULL
 };
 
-/* Holds global state of the App */
-battery_service_app_state_t battery_service_app_state;
+/* The Battery Service instances, in the order of the GATT database */
+battery_service_battery_t battery_service_battery[BATTERY_SERVICE_NUM_BATTERIES] =
+{
+    /* main battery pack */
+    { HDLC_BAS_BATTERY_LEVEL_VALUE, HDLD_BAS_BATTERY_LEVEL_CLIENT_CHAR_CONFIG, app_bas_battery_level,
+      BATTERY_SERVICE_MAIN_ADC_INPUT, BATTERY_SERVICE_MAIN_FULL_MV, BATTERY_SERVICE_MAIN_EMPTY_MV, 1 },
+    /* coin cell */
+    { HDLC_BAS_COIN_BATTERY_LEVEL_VALUE, HDLD_BAS_COIN_BATTERY_LEVEL_CLIENT_CHAR_CONFIG, app_bas_coin_battery_level,
+      BATTERY_SERVICE_COIN_ADC_INPUT, BATTERY_SERVICE_COIN_FULL_MV, BATTERY_SERVICE_COIN_EMPTY_MV, 4 },
+};
+
+/* Battery of each handle of the Battery Service instances, BATTERY_SERVICE_NO_BATTERY for none */
+uint8_t battery_service_handle_battery[BATTERY_SERVICE_LAST_HANDLE - BATTERY_SERVICE_FIRST_HANDLE + 1];
+
+/* Connected clients */
+battery_service_conn_t battery_service_conn[BATTERY_SERVICE_GATTS_MAX_CONN];
+
+/* Host info of the bonded clients saved in the NVRAM, most recently updated first */
+host_info_t battery_service_hostinfo[BATTERY_SERVICE_MAX_BONDS];
 
-/* Holds the host info saved in the NVRAM */
-host_info_t battery_service_hostinfo;
+/* Link keys of the bonded clients */
+bond_store_t battery_service_bond_store;
 
-wiced_timer_t battery_service_timer;
+power_mgr_tick_t battery_service_tick;
+
+/* Handle index of app_gatt_db_ext_attr_tbl */
+gatt_attr_index_t battery_service_attr_index;
+uint8_t           battery_service_attr_slots[GATT_ATTR_INDEX_SLOTS( HDLC_GAP_DEVICE_NAME_VALUE, BATTERY_SERVICE_LAST_HANDLE )];
 
 /*****************************************************************************
  *                           Function Prototypes
@@ -161,7 +248,6 @@ wiced_timer_t battery_service_timer;
 static wiced_result_t             battery_service_management_cback( wiced_bt_management_evt_t event, wiced_bt_management_evt_data_t *p_event_data );
 static void                       battery_service_application_init();
 static wiced_bt_gatt_status_t     battery_service_gatt_cback( wiced_bt_gatt_evt_t event, wiced_bt_gatt_event_data_t *p_data );
-static void                       battery_service_load_keys_for_address_resolution( void );
 static void                       battery_service_set_advertisement_data();
 static wiced_bt_gatt_status_t     battery_service_gatts_conn_status_cb( wiced_bt_gatt_connection_status_t *p_status );
 static wiced_bt_gatt_status_t     battery_service_gatts_connection_up(wiced_bt_gatt_connection_status_t *p_status);
@@ -169,10 +255,17 @@ static wiced_bt_gatt_status_t     battery_service_gatts_connection_down( wiced_b
 static wiced_bt_gatt_status_t     battery_service_gatts_req_cb( wiced_bt_gatt_attribute_request_t *p_data );
 static wiced_bt_gatt_status_t     battery_service_gatts_req_read_handler( uint16_t conn_id, wiced_bt_gatt_read_t * p_read_data );
 static wiced_bt_gatt_status_t     battery_service_gatts_req_write_handler( uint16_t conn_id, wiced_bt_gatt_write_t * p_data );
-static void                       battery_service_smp_bond_result( uint8_t result );
+static void                       battery_service_smp_bond_result( uint8_t result, uint8_t* bd_addr );
 static void                       battery_service_encryption_changed( wiced_result_t result, uint8_t* bd_addr );
 static void                       battery_service_send_message();
+static void                       battery_service_send_message_to( battery_service_conn_t *p_conn );
+static void                       battery_service_sample_level( void );
 static void                       battery_service_timer_expiry_handler(  uint32_t param );
+static battery_service_conn_t *   battery_service_conn_find( uint16_t conn_id );
+static uint8_t                    battery_service_conn_count( void );
+static uint8_t                    battery_service_battery_of_handle( uint16_t handle );
+static host_info_t *              battery_service_hostinfo_find( const uint8_t *bd_addr );
+static void                       battery_service_hostinfo_save( battery_service_conn_t *p_conn );
 #ifdef ENABLE_HCI_TRACE
 static void                       battery_service_hci_trace_cback( wiced_bt_hci_trace_type_t type, uint16_t length, uint8_t* p_data );
 #endif
@@ -188,6 +281,8 @@ static void                       battery_service_hci_trace_cback( wiced_bt_hci_
  */
 APPLICATION_START( )
 {
+    uint8_t i;
+
     wiced_transport_init( &transport_cfg );
 
 #ifdef WICED_BT_TRACE_ENABLE
@@ -216,16 +311,18 @@ APPLICATION_START( )
     wiced_bt_stack_init( battery_service_management_cback ,
                     &wiced_app_cfg_settings, wiced_app_cfg_buf_pools );
 
-    battery_service_app_state.battery_level = MAX_BATTERY_LEVEL;
-    app_bas_battery_level[0] = battery_service_app_state.battery_level;
-    battery_service_hostinfo.characteristic_client_configuration = 0;
-    app_bas_battery_level_client_char_config[0] = 0;
-    app_bas_battery_level_client_char_config[1] = 0;
+    for ( i = 0; i < BATTERY_SERVICE_NUM_BATTERIES; i++ )
+    {
+        battery_service_battery[i].battery_level = MAX_BATTERY_LEVEL;
+        battery_service_battery[i].p_value[0]    = MAX_BATTERY_LEVEL;
+    }
 }
 
 static void battery_service_application_init()
 {
     wiced_bt_gatt_status_t gatt_status;
+    wiced_result_t         result;
+    uint8_t                i;
 #if !defined(CYW20735B1) && !defined(CYW20819A1) && !defined(CYW20719B2) && !defined(CYW20721B2)
     /* Initialize wiced app */
     wiced_bt_app_init();
@@ -240,6 +337,16 @@ static void battery_service_application_init()
 
     WICED_BT_TRACE("wiced_bt_gatt_db_init %d\n", gatt_status);
 
+    GATT_ATTR_INDEX_INIT( &battery_service_attr_index, app_gatt_db_ext_attr_tbl, app_gatt_db_ext_attr_tbl_size, battery_service_attr_slots );
+
+    /* Index the batteries by the handles of their characteristic value and descriptor */
+    memset( battery_service_handle_battery, BATTERY_SERVICE_NO_BATTERY, sizeof( battery_service_handle_battery ) );
+    for ( i = 0; i < BATTERY_SERVICE_NUM_BATTERIES; i++ )
+    {
+        battery_service_handle_battery[battery_service_battery[i].value_handle - BATTERY_SERVICE_FIRST_HANDLE] = i;
+        battery_service_handle_battery[battery_service_battery[i].cccd_handle - BATTERY_SERVICE_FIRST_HANDLE]  = i;
+    }
+
 #ifdef ENABLE_HCI_TRACE
     /* Register callback for receiving hci traces */
     wiced_bt_dev_register_hci_trace( battery_service_hci_trace_cback );
@@ -252,9 +359,16 @@ static void battery_service_application_init()
     /* Allow peer to pair */
     wiced_bt_set_pairable_mode(WICED_TRUE, 0);
 
-
     /* Load the address resolution DB with the keys stored in the NVRAM */
-    battery_service_load_keys_for_address_resolution();
+    bond_store_init( &battery_service_bond_store, BATTERY_SERVICE_PAIRED_KEYS_VS_ID, BATTERY_SERVICE_MAX_BONDS );
+    bond_store_load_addr_resolution_db( &battery_service_bond_store );
+
+    /* Configuration of the bonded clients */
+    wiced_hal_read_nvram( BATTERY_SERVICE_VS_ID, sizeof(battery_service_hostinfo), (uint8_t*)battery_service_hostinfo, &result );
+    if ( result != WICED_SUCCESS )
+    {
+        memset( battery_service_hostinfo, 0, sizeof(battery_service_hostinfo) );
+    }
 
     battery_service_set_advertisement_data();
 
@@ -262,8 +376,13 @@ static void battery_service_application_init()
     wiced_bt_start_advertisements( BTM_BLE_ADVERT_UNDIRECTED_HIGH, 0, NULL );
     WICED_BT_TRACE("Waiting for Battery Service to connect...\n");
 
-    wiced_init_timer( &battery_service_timer, battery_service_timer_expiry_handler, 0,
-            WICED_MILLI_SECONDS_TIMER );
+#ifdef BATTERY_SERVICE_BATT_ADC
+    wiced_hal_adc_init( );
+    for ( i = 0; i < BATTERY_SERVICE_NUM_BATTERIES; i++ )
+    {
+        sample_filter_init( &battery_service_battery[i].filter, SAMPLE_FILTER_MEDIAN, BATTERY_SERVICE_BATT_FILTER_WINDOW, 0 );
+    }
+#endif
 }
 
 static void battery_service_set_advertisement_data()
@@ -295,25 +414,77 @@ static void battery_service_set_advertisement_data()
     WICED_BT_TRACE( "wiced_bt_ble_set_advertisement_data %d\n", result );
 }
 
+/*
+ * Update the battery levels from the battery voltages, or simulate a discharge without ADC
+ */
+static void battery_service_sample_level( void )
+{
+    battery_service_battery_t *p_batt;
+    uint8_t                   i;
+#ifdef BATTERY_SERVICE_BATT_ADC
+    int16_t mv;
+#endif
+
+    for ( i = 0; i < BATTERY_SERVICE_NUM_BATTERIES; i++ )
+    {
+        p_batt = &battery_service_battery[i];
+#ifdef BATTERY_SERVICE_BATT_ADC
+        mv = sample_filter_add( &p_batt->filter, (int16_t)wiced_hal_adc_read_voltage( p_batt->adc_input ) );
+        if ( mv >= p_batt->full_mv )
+            p_batt->battery_level = MAX_BATTERY_LEVEL;
+        else if ( mv <= p_batt->empty_mv )
+            p_batt->battery_level = 0;
+        else
+            p_batt->battery_level = (uint8_t)( ( mv - p_batt->empty_mv ) * MAX_BATTERY_LEVEL / ( p_batt->full_mv - p_batt->empty_mv ) );
+#else
+        if ( ++p_batt->sim_count >= p_batt->sim_period )
+        {
+            p_batt->sim_count = 0;
+            p_batt->battery_level--;
+            if( p_batt->battery_level  <= 0 )
+            {
+                p_batt->battery_level = MAX_BATTERY_LEVEL;
+            }
+        }
+#endif
+        p_batt->p_value[0] = p_batt->battery_level;
+    }
+}
+
 static void battery_service_timer_expiry_handler(  uint32_t param )
 {
-    battery_service_app_state.battery_level--;
-    app_bas_battery_level[0] = battery_service_app_state.battery_level;
-    if(battery_service_app_state.battery_level  <= 0 )
+    battery_service_conn_t *p_conn;
+    uint8_t                i, j, level, delta;
+
+    battery_service_sample_level();
+
+    for ( i = 0; i < BATTERY_SERVICE_GATTS_MAX_CONN; i++ )
     {
-        battery_service_app_state.battery_level = MAX_BATTERY_LEVEL;
-        app_bas_battery_level[0] = battery_service_app_state.battery_level;
+        p_conn = &battery_service_conn[i];
+        if ( p_conn->conn_id == 0 )
+        {
+            continue;
+        }
+        for ( j = 0; j < BATTERY_SERVICE_NUM_BATTERIES; j++ )
+        {
+            level = battery_service_battery[j].battery_level;
+            delta = ( level > p_conn->notified_level[j] ) ? ( level - p_conn->notified_level[j] ) : ( p_conn->notified_level[j] - level );
+            if ( delta >= BATTERY_SERVICE_NOTIFY_THRESHOLD )
+            {
+                p_conn->notify_pending |= ( 1 << j );
+            }
+        }
     }
 
+    /* also retries the notifications held back by the minimum interval */
     battery_service_send_message();
-
-    wiced_start_timer( &battery_service_timer, BATTERY_SERVICE_TIMER_DURATION_IN_MS );
 }
 
 /* GATT event handler */
 static wiced_bt_gatt_status_t battery_service_gatt_cback( wiced_bt_gatt_evt_t event, wiced_bt_gatt_event_data_t *p_data )
 {
     wiced_bt_gatt_status_t result = WICED_BT_GATT_INVALID_PDU;
+    battery_service_conn_t *p_conn;
 
     switch ( event )
     {
@@ -325,6 +496,19 @@ static wiced_bt_gatt_status_t battery_service_gatt_cback( wiced_bt_gatt_evt_t ev
             result = battery_service_gatts_req_cb( &p_data->attribute_request );
             break;
 
+        case GATT_CONGESTION_EVT:
+            WICED_BT_TRACE( "congestion conn %d congested %d\n", p_data->congestion.conn_id, p_data->congestion.congested );
+            if ( ( p_conn = battery_service_conn_find( p_data->congestion.conn_id ) ) != NULL )
+            {
+                p_conn->flag_congested = p_data->congestion.congested;
+                if ( !p_conn->flag_congested )
+                {
+                    battery_service_send_message_to( p_conn );
+                }
+            }
+            result = WICED_BT_GATT_SUCCESS;
+            break;
+
         default:
             break;
     }
@@ -344,40 +528,75 @@ static wiced_bt_gatt_status_t battery_service_gatts_conn_status_cb( wiced_bt_gat
 /* This function is invoked when connection is established */
 static wiced_bt_gatt_status_t battery_service_gatts_connection_up( wiced_bt_gatt_connection_status_t *p_status )
 {
-    wiced_result_t result;
-    uint8_t        bytes_written = 0;
+    wiced_result_t         result;
+    battery_service_conn_t *p_conn = NULL;
+    uint8_t                i;
 
     WICED_BT_TRACE( "battery_service_conn_up %B id:%d\n:", p_status->bd_addr, p_status->conn_id);
 
-    /* Update the connection handler.  Save address of the connected device. */
-    battery_service_app_state.conn_id = p_status->conn_id;
-    memcpy(battery_service_app_state.remote_addr, p_status->bd_addr, sizeof(BD_ADDR));
-
-    /* Stop advertising */
-    result =  wiced_bt_start_advertisements( BTM_BLE_ADVERT_OFF, 0, NULL );
+    /* Take a free client entry, the stack allows no more links than there are entries */
+    for ( i = 0; ( i < BATTERY_SERVICE_GATTS_MAX_CONN ) && ( p_conn == NULL ); i++ )
+    {
+        if ( battery_service_conn[i].conn_id == 0 )
+        {
+            p_conn = &battery_service_conn[i];
+        }
+    }
+    if ( p_conn == NULL )
+    {
+        WICED_BT_TRACE( "no free client entry\n" );
+        wiced_bt_gatt_disconnect( p_status->conn_id );
+        return WICED_BT_GATT_SUCCESS;
+    }
 
-    WICED_BT_TRACE( "Stopping Advertisements%d\n", result );
+    /* Update the connection handler.  Save address of the connected device. */
+    memset( p_conn, 0, sizeof( battery_service_conn_t ) );
+    p_conn->conn_id = p_status->conn_id;
+    memcpy( p_conn->remote_addr, p_status->bd_addr, sizeof(BD_ADDR) );
 
-    /* Updating the bd address in the  host info in NVRAM  */
-    memcpy( battery_service_hostinfo.bdaddr, p_status->bd_addr, sizeof( BD_ADDR ) );
+    /* Sample the batteries while connected, the clients read the last levels */
+    if ( battery_service_conn_count() == 1 )
+    {
+        battery_service_sample_level();
+        /* On the shared tick, with the other periodic work */
+        power_mgr_tick_start( &battery_service_tick, battery_service_timer_expiry_handler, 0, BATTERY_SERVICE_TIMER_PERIOD_IN_SECONDS );
+    }
+    for ( i = 0; i < BATTERY_SERVICE_NUM_BATTERIES; i++ )
+    {
+        p_conn->notified_level[i] = battery_service_battery[i].battery_level;
+    }
 
-    /* Save the  host info in NVRAM  */
-    bytes_written = wiced_hal_write_nvram( BATTERY_SERVICE_VS_ID, sizeof(battery_service_hostinfo), (uint8_t*)&battery_service_hostinfo, &result );
-    WICED_BT_TRACE("NVRAM write %d\n", bytes_written);
+    /* Keep advertising while another client can connect */
+    if ( battery_service_conn_count() < BATTERY_SERVICE_GATTS_MAX_CONN )
+    {
+        result = wiced_bt_start_advertisements( BTM_BLE_ADVERT_UNDIRECTED_LOW, 0, NULL );
+        WICED_BT_TRACE( "wiced_bt_start_advertisements %d\n", result );
+    }
+    else
+    {
+        result = wiced_bt_start_advertisements( BTM_BLE_ADVERT_OFF, 0, NULL );
+        WICED_BT_TRACE( "Stopping Advertisements%d\n", result );
+    }
 
     return WICED_BT_GATT_SUCCESS;
 }
 
 static wiced_bt_gatt_status_t battery_service_gatts_connection_down( wiced_bt_gatt_connection_status_t *p_status )
 {
-    wiced_result_t result;
+    wiced_result_t         result;
+    battery_service_conn_t *p_conn = battery_service_conn_find( p_status->conn_id );
 
-    WICED_BT_TRACE( "connection_down %B conn_id:%d reason:%d\n", battery_service_app_state.remote_addr, p_status->conn_id, p_status->reason );
+    WICED_BT_TRACE( "connection_down %B conn_id:%d reason:%d\n", p_status->bd_addr, p_status->conn_id, p_status->reason );
 
     /* Resetting the device info */
-    memset( battery_service_app_state.remote_addr, 0, 6 );
-    battery_service_app_state.conn_id = 0;
-    wiced_stop_timer( &battery_service_timer );
+    if ( p_conn != NULL )
+    {
+        memset( p_conn, 0, sizeof( battery_service_conn_t ) );
+    }
+    if ( battery_service_conn_count() == 0 )
+    {
+        power_mgr_tick_stop( &battery_service_tick );
+    }
 
     result =  wiced_bt_start_advertisements( BTM_BLE_ADVERT_UNDIRECTED_LOW, 0, NULL );
     WICED_BT_TRACE( "wiced_bt_start_advertisements %d\n", result );
@@ -427,21 +646,19 @@ static wiced_result_t battery_service_management_cback( wiced_bt_management_evt_
     case BTM_PAIRING_COMPLETE_EVT:
         p_info =  &p_event_data->pairing_complete.pairing_complete_info.ble;
         WICED_BT_TRACE( "Pairing Complete: %d",p_info->reason);
-        battery_service_smp_bond_result( p_info->reason );
+        battery_service_smp_bond_result( p_info->reason, p_event_data->pairing_complete.bd_addr );
         break;
 
     case BTM_PAIRED_DEVICE_LINK_KEYS_UPDATE_EVT:
         /* save keys to NVRAM */
-        p_keys = (uint8_t*)&p_event_data->paired_device_link_keys_update;
-        wiced_hal_write_nvram ( BATTERY_SERVICE_PAIRED_KEYS_VS_ID, sizeof( wiced_bt_device_link_keys_t ), p_keys ,&result );
-        WICED_BT_TRACE("keys save to NVRAM %B result: %d \n", p_keys, result);
+        bond_store_save( &battery_service_bond_store, &p_event_data->paired_device_link_keys_update );
+        WICED_BT_TRACE("keys save to NVRAM %B\n", p_event_data->paired_device_link_keys_update.bd_addr);
         break;
 
     case BTM_PAIRED_DEVICE_LINK_KEYS_REQUEST_EVT:
         /* read keys from NVRAM */
-        p_keys = (uint8_t *)&p_event_data->paired_device_link_keys_request;
-        wiced_hal_read_nvram( BATTERY_SERVICE_PAIRED_KEYS_VS_ID, sizeof(wiced_bt_device_link_keys_t), p_keys, &result );
-        WICED_BT_TRACE("keys read from NVRAM %B result: %d \n", p_keys, result);
+        result = bond_store_read( &battery_service_bond_store, &p_event_data->paired_device_link_keys_request ) ? WICED_BT_SUCCESS : WICED_BT_ERROR;
+        WICED_BT_TRACE("keys read from NVRAM %B result: %d \n", p_event_data->paired_device_link_keys_request.bd_addr, result);
         break;
 
     case BTM_LOCAL_IDENTITY_KEYS_UPDATE_EVT:
@@ -475,7 +692,7 @@ static wiced_result_t battery_service_management_cback( wiced_bt_management_evt_
         WICED_BT_TRACE( "Advertisement State Change: %d\n", *p_mode);
         if ( *p_mode == BTM_BLE_ADVERT_OFF )
         {
-            if ( !battery_service_app_state.conn_id )
+            if ( battery_service_conn_count() < BATTERY_SERVICE_GATTS_MAX_CONN )
             {
                 result =  wiced_bt_start_advertisements( BTM_BLE_ADVERT_UNDIRECTED_LOW, 0, NULL );
                 WICED_BT_TRACE( "wiced_bt_start_advertisements: %d\n", result );
@@ -495,27 +712,6 @@ static wiced_result_t battery_service_management_cback( wiced_bt_management_evt_
     return result;
 }
 
-static void battery_service_load_keys_for_address_resolution( void )
-{
-    wiced_bt_device_link_keys_t link_keys;
-    wiced_result_t              result;
-    uint8_t                     *p;
-
-    memset( &link_keys, 0, sizeof(wiced_bt_device_link_keys_t));
-    p = (uint8_t*)&link_keys;
-    wiced_hal_read_nvram( BATTERY_SERVICE_PAIRED_KEYS_VS_ID, sizeof(wiced_bt_device_link_keys_t), p, &result);
-
-    if(result == WICED_BT_SUCCESS)
-    {
-#ifdef CYW20706A2
-        result = wiced_bt_dev_add_device_to_address_resolution_db ( &link_keys, link_keys.key_data.ble_addr_type );
-#else
-        result = wiced_bt_dev_add_device_to_address_resolution_db(&link_keys);
-#endif
-    }
-    WICED_BT_TRACE("battery_service_load_keys_for_address_resolution %B result:%d \n", p, result );
-}
-
 static wiced_bt_gatt_status_t battery_service_gatts_req_cb( wiced_bt_gatt_attribute_request_t *p_data )
 {
     wiced_result_t result = WICED_BT_GATT_INVALID_PDU;
@@ -553,25 +749,69 @@ static wiced_bt_gatt_status_t battery_service_gatts_req_cb( wiced_bt_gatt_attrib
  */
 gatt_db_lookup_table_t * battery_service_get_attribute( uint16_t handle )
 {
-    int i;
-    for ( i = 0; i <  app_gatt_db_ext_attr_tbl_size; i++ )
+    gatt_db_lookup_table_t *puAttribute = gatt_attr_index_find( &battery_service_attr_index, handle );
+
+    if ( puAttribute == NULL )
+    {
+        WICED_BT_TRACE( "attr not found:%x\n", handle );
+    }
+    return puAttribute;
+}
+
+/*
+ * Find the battery whose Battery Level value or client configuration descriptor has this handle
+ */
+static uint8_t battery_service_battery_of_handle( uint16_t handle )
+{
+    if ( ( handle < BATTERY_SERVICE_FIRST_HANDLE ) || ( handle > BATTERY_SERVICE_LAST_HANDLE ) )
+    {
+        return BATTERY_SERVICE_NO_BATTERY;
+    }
+    return battery_service_handle_battery[handle - BATTERY_SERVICE_FIRST_HANDLE];
+}
+
+/*
+ * Find the client of a connection
+ */
+static battery_service_conn_t * battery_service_conn_find( uint16_t conn_id )
+{
+    uint8_t i;
+
+    for ( i = 0; i < BATTERY_SERVICE_GATTS_MAX_CONN; i++ )
     {
-        if ( app_gatt_db_ext_attr_tbl[i].handle == handle )
+        if ( ( conn_id != 0 ) && ( battery_service_conn[i].conn_id == conn_id ) )
         {
-            return ( &app_gatt_db_ext_attr_tbl[i] );
+            return &battery_service_conn[i];
         }
     }
-    WICED_BT_TRACE( "attr not found:%x\n", handle );
     return NULL;
 }
 
+/*
+ * Number of connected clients
+ */
+static uint8_t battery_service_conn_count( void )
+{
+    uint8_t i, count = 0;
+
+    for ( i = 0; i < BATTERY_SERVICE_GATTS_MAX_CONN; i++ )
+    {
+        if ( battery_service_conn[i].conn_id != 0 )
+        {
+            count++;
+        }
+    }
+    return count;
+}
+
 /*
  * Process Read request or command from peer device
  */
 static wiced_bt_gatt_status_t battery_service_gatts_req_read_handler( uint16_t conn_id, wiced_bt_gatt_read_t * p_read_data )
 {
     gatt_db_lookup_table_t *puAttribute;
-    int          attr_len_to_copy;
+    battery_service_conn_t *p_conn;
+    uint8_t                batt;
 
     if ( ( puAttribute = battery_service_get_attribute(p_read_data->handle) ) == NULL)
     {
@@ -579,95 +819,130 @@ static wiced_bt_gatt_status_t battery_service_gatts_req_read_handler( uint16_t c
         return WICED_BT_GATT_INVALID_HANDLE;
     }
 
-    attr_len_to_copy = puAttribute->cur_len;
-
-    WICED_BT_TRACE("read_hndlr conn_id:%d hdl:%x offset:%d len:%d\n", conn_id, p_read_data->handle, p_read_data->offset, attr_len_to_copy );
+    WICED_BT_TRACE("read_hndlr conn_id:%d hdl:%x offset:%d len:%d\n", conn_id, p_read_data->handle, p_read_data->offset, puAttribute->cur_len );
 
-    if ( p_read_data->offset >= puAttribute->cur_len )
+    /* Every client has its own client configuration */
+    batt = battery_service_battery_of_handle( p_read_data->handle );
+    if ( ( batt != BATTERY_SERVICE_NO_BATTERY ) && ( p_read_data->handle == battery_service_battery[batt].cccd_handle ) &&
+         ( ( p_conn = battery_service_conn_find( conn_id ) ) != NULL ) )
     {
-        attr_len_to_copy = 0;
+        return gatt_attr_read( &p_conn->characteristic_client_configuration[batt], 2, p_read_data );
     }
 
-    if ( attr_len_to_copy != 0 )
-    {
-        uint8_t *from;
-        int      to_copy = attr_len_to_copy - p_read_data->offset;
+    return gatt_attr_read( puAttribute->p_data, puAttribute->cur_len, p_read_data );
+}
+
+/*
+ * Process write request or write command from peer device
+ */
+static wiced_bt_gatt_status_t battery_service_gatts_req_write_handler( uint16_t conn_id, wiced_bt_gatt_write_t * p_data )
+{
+    uint8_t                *p_attr   = p_data->p_val;
+    battery_service_conn_t *p_conn;
+    uint8_t                batt;
 
+    WICED_BT_TRACE("write_handler: conn_id:%d hdl:0x%x prep:%d offset:%d len:%d\n ", conn_id, p_data->handle, p_data->is_prep, p_data->offset, p_data->val_len );
 
-        if ( to_copy > *p_read_data->p_val_len )
-        {
-            to_copy = *p_read_data->p_val_len;
-        }
+    batt = battery_service_battery_of_handle( p_data->handle );
+    if ( ( batt == BATTERY_SERVICE_NO_BATTERY ) || ( p_data->handle != battery_service_battery[batt].cccd_handle ) ||
+         ( ( p_conn = battery_service_conn_find( conn_id ) ) == NULL ) )
+    {
+        return WICED_BT_GATT_INVALID_HANDLE;
+    }
+    if ( p_data->val_len != 2 )
+    {
+        return WICED_BT_GATT_INVALID_ATTR_LEN;
+    }
 
-        from = ((uint8_t *)puAttribute->p_data) + p_read_data->offset;
-        *p_read_data->p_val_len = to_copy;
+    p_conn->characteristic_client_configuration[batt] = p_attr[0] | ( p_attr[1] << 8 );
 
-        memcpy( p_read_data->p_val, from, to_copy);
+    /* Send the current level, then the changes */
+    if( p_conn->characteristic_client_configuration[batt] & GATT_CLIENT_CONFIG_NOTIFICATION )
+    {
+        p_conn->notify_pending |= ( 1 << batt );
+        battery_service_send_message_to( p_conn );
     }
 
+    battery_service_hostinfo_save( p_conn );
+
     return WICED_BT_GATT_SUCCESS;
 }
 
 /*
- * Process write request or write command from peer device
+ * Find the saved configuration of a client
  */
-static wiced_bt_gatt_status_t battery_service_gatts_req_write_handler( uint16_t conn_id, wiced_bt_gatt_write_t * p_data )
+static host_info_t * battery_service_hostinfo_find( const uint8_t *bd_addr )
 {
-    wiced_bt_gatt_status_t result    = WICED_BT_GATT_SUCCESS;
-    uint8_t                *p_attr   = p_data->p_val;
-    uint8_t                nv_update = WICED_FALSE;
+    uint8_t i;
 
-    WICED_BT_TRACE("write_handler: conn_id:%d hdl:0x%x prep:%d offset:%d len:%d\n ", conn_id, p_data->handle, p_data->is_prep, p_data->offset, p_data->val_len );
-
-    switch ( p_data->handle )
+    for ( i = 0; i < BATTERY_SERVICE_MAX_BONDS; i++ )
     {
-        case HDLD_BAS_BATTERY_LEVEL_CLIENT_CHAR_CONFIG:
-            if ( p_data->val_len != 2 )
-            {
-                return WICED_BT_GATT_INVALID_ATTR_LEN;
-            }
-            battery_service_hostinfo.characteristic_client_configuration = p_attr[0] | ( p_attr[1] << 8 );
-            app_bas_battery_level_client_char_config[0] = p_attr[0];
-            app_bas_battery_level_client_char_config[1] = p_attr[1];
-
-            if( battery_service_hostinfo.characteristic_client_configuration & GATT_CLIENT_CONFIG_NOTIFICATION )
-            {
-                wiced_start_timer( &battery_service_timer, BATTERY_SERVICE_TIMER_DURATION_IN_MS );
-            }
-            else
-            {
-                wiced_stop_timer( &battery_service_timer );
-            }
+        if ( memcmp( battery_service_hostinfo[i].bdaddr, bd_addr, BD_ADDR_LEN ) == 0 )
+        {
+            return &battery_service_hostinfo[i];
+        }
+    }
+    return NULL;
+}
 
-            nv_update = WICED_TRUE;
-            break;
+/*
+ * Save the configuration of a bonded client in NVRAM, first in the table. The entry
+ * of a client no longer bonded is reused first, otherwise the last updated one.
+ */
+static void battery_service_hostinfo_save( battery_service_conn_t *p_conn )
+{
+    host_info_t    *p_info;
+    uint8_t        i;
+    wiced_result_t rc;
+    int            bytes_written;
 
-        default:
-            result = WICED_BT_GATT_INVALID_HANDLE;
-            break;
+    if ( !bond_store_is_bonded( &battery_service_bond_store, p_conn->remote_addr ) )
+    {
+        return;
     }
 
-    if ( nv_update )
+    if ( ( p_info = battery_service_hostinfo_find( p_conn->remote_addr ) ) == NULL )
     {
-        wiced_result_t rc;
-        int bytes_written = wiced_hal_write_nvram( BATTERY_SERVICE_VS_ID, sizeof(battery_service_hostinfo), (uint8_t*)&battery_service_hostinfo, &rc );
-        WICED_BT_TRACE("NVRAM write:%d rc:%d", bytes_written, rc);
+        for ( i = 0; i < BATTERY_SERVICE_MAX_BONDS - 1; i++ )
+        {
+            if ( !bond_store_is_bonded( &battery_service_bond_store, battery_service_hostinfo[i].bdaddr ) )
+            {
+                break;
+            }
+        }
+        p_info = &battery_service_hostinfo[i];
     }
 
-    return result;
+    memmove( &battery_service_hostinfo[1], &battery_service_hostinfo[0], (uint8_t *)p_info - (uint8_t *)&battery_service_hostinfo[0] );
+    memcpy( battery_service_hostinfo[0].bdaddr, p_conn->remote_addr, BD_ADDR_LEN );
+    memcpy( battery_service_hostinfo[0].characteristic_client_configuration, p_conn->characteristic_client_configuration,
+            sizeof( p_conn->characteristic_client_configuration ) );
+
+    bytes_written = wiced_hal_write_nvram( BATTERY_SERVICE_VS_ID, sizeof(battery_service_hostinfo), (uint8_t*)battery_service_hostinfo, &rc );
+    WICED_BT_TRACE("NVRAM write:%d rc:%d", bytes_written, rc);
 }
 
 /*
  * Process SMP bonding result. If we successfully paired with the
- * central device, save its BDADDR in the NVRAM and initialize
- * associated data
+ * central device, save the configuration it already wrote
  */
 
-static void battery_service_smp_bond_result( uint8_t result )
+static void battery_service_smp_bond_result( uint8_t result, uint8_t* bd_addr )
 {
-    wiced_result_t status;
-    uint8_t written_byte = 0;
+    uint8_t i;
+
     WICED_BT_TRACE( "battery_service, bond result: %d\n", result );
+
+    if ( result == WICED_BT_SUCCESS )
+    {
+        for ( i = 0; i < BATTERY_SERVICE_GATTS_MAX_CONN; i++ )
+        {
+            if ( ( battery_service_conn[i].conn_id != 0 ) && ( memcmp( battery_service_conn[i].remote_addr, bd_addr, BD_ADDR_LEN ) == 0 ) )
+            {
+                battery_service_hostinfo_save( &battery_service_conn[i] );
+            }
+        }
+    }
 }
 
 /*
@@ -677,58 +952,109 @@ static void battery_service_smp_bond_result( uint8_t result )
  */
 static void battery_service_encryption_changed( wiced_result_t result, uint8_t* bd_addr )
 {
-    WICED_BT_TRACE( "encryption change bd ( %B ) res: %d \n", battery_service_hostinfo.bdaddr,  result);
+    host_info_t            *p_info;
+    battery_service_conn_t *p_conn;
+    uint8_t                i, j;
+
+    WICED_BT_TRACE( "encryption change bd ( %B ) res: %d \n", bd_addr,  result);
 
     /* Connection has been encrypted meaning that we have correct/paired device
      * restore values in the database
      */
-   if( result == WICED_SUCCESS )
-   {
-        wiced_hal_read_nvram( BATTERY_SERVICE_VS_ID, sizeof(battery_service_hostinfo), (uint8_t*)&battery_service_hostinfo, &result );
+    if( ( result != WICED_SUCCESS ) || ( ( p_info = battery_service_hostinfo_find( bd_addr ) ) == NULL ) )
+    {
+        return;
+    }
+
+    for ( i = 0; i < BATTERY_SERVICE_GATTS_MAX_CONN; i++ )
+    {
+        p_conn = &battery_service_conn[i];
+        if ( ( p_conn->conn_id == 0 ) || ( memcmp( p_conn->remote_addr, bd_addr, BD_ADDR_LEN ) != 0 ) )
+        {
+            continue;
+        }
 
-        if( result == WICED_SUCCESS )
+        /* The client registered for notifications on a previous connection, send it the current levels once */
+        for ( j = 0; j < BATTERY_SERVICE_NUM_BATTERIES; j++ )
         {
-            if ( (memcmp(battery_service_hostinfo.bdaddr, battery_service_app_state.remote_addr, BD_ADDR_LEN) == 0) )
+            p_conn->characteristic_client_configuration[j] = p_info->characteristic_client_configuration[j];
+            if ( p_conn->characteristic_client_configuration[j] & GATT_CLIENT_CONFIG_NOTIFICATION )
             {
-                if( battery_service_hostinfo.characteristic_client_configuration & GATT_CLIENT_CONFIG_NOTIFICATION )
-                {
-                    /* Ideally, after encryption server should comes to know that client had registered for notifications and
-                     * application has to check whether the current battery level is different than the previous notified battery level
-                     * and then the client need to be notified. So essentially only one notification should be resulted.
-                     * But with our current dummy battery level implementation, it is not possible to get current battery level,
-                     *  so battery level should be notified with value less than 1 level compared to last notification.
-                     */
-                    battery_service_app_state.battery_level--;
-                    app_bas_battery_level[0] = battery_service_app_state.battery_level;
-
-                    battery_service_send_message();
-                    wiced_start_timer( &battery_service_timer, BATTERY_SERVICE_TIMER_DURATION_IN_MS );
-                }
+                p_conn->notify_pending |= ( 1 << j );
             }
         }
-   }
+        battery_service_send_message_to( p_conn );
+    }
 }
 
+/*
+ * Notify the pending battery levels to all the clients
+ */
 static void battery_service_send_message()
 {
-    wiced_bt_gatt_status_t result;
-    wiced_result_t status;
-    uint8_t written_byte = 0;
-    WICED_BT_TRACE( "battery_service_send_message: CCC:%d\n", battery_service_hostinfo.characteristic_client_configuration );
+    uint8_t i;
 
-    /* If client has not registered for indication or notification, no action */
-    if ( battery_service_hostinfo.characteristic_client_configuration == 0 )
+    for ( i = 0; i < BATTERY_SERVICE_GATTS_MAX_CONN; i++ )
     {
-        return;
+        if ( battery_service_conn[i].conn_id != 0 )
+        {
+            battery_service_send_message_to( &battery_service_conn[i] );
+        }
     }
-    else if ( battery_service_hostinfo.characteristic_client_configuration & GATT_CLIENT_CONFIG_NOTIFICATION )
+}
+
+/*
+ * Notify the pending battery levels to a client. At most one notification per battery is queued in the stack:
+ * while it is congested or out of buffers, or before the minimum interval, the level stays pending and the
+ * latest one is sent when allowed.
+ */
+static void battery_service_send_message_to( battery_service_conn_t *p_conn )
+{
+    wiced_bt_gatt_status_t result;
+    uint32_t now_ms;
+    uint8_t  p_attr;
+    uint8_t  i;
+
+    now_ms = (uint32_t)( clock_SystemTimeMicroseconds64() / 1000 );
+
+    for ( i = 0; ( i < BATTERY_SERVICE_NUM_BATTERIES ) && !p_conn->flag_congested; i++ )
     {
-        uint8_t p_attr = battery_service_app_state.battery_level;
+        if ( !( p_conn->notify_pending & ( 1 << i ) ) )
+        {
+            continue;
+        }
+
+        /* If client has not registered for notification, no action */
+        if ( !( p_conn->characteristic_client_configuration[i] & GATT_CLIENT_CONFIG_NOTIFICATION ) )
+        {
+            p_conn->notify_pending &= ~( 1 << i );
+            continue;
+        }
+
+        if ( ( p_conn->notify_time_ms[i] != 0 ) && ( now_ms - p_conn->notify_time_ms[i] < BATTERY_SERVICE_NOTIFY_MIN_INTERVAL_MS ) )
+        {
+            continue;
+        }
 
-        battery_service_app_state.flag_notify_sent = TRUE;
+        p_attr = battery_service_battery[i].battery_level;
+        result = wiced_bt_gatt_send_notification( p_conn->conn_id, battery_service_battery[i].value_handle, sizeof(p_attr), &p_attr );
+        WICED_BT_TRACE( "notification conn:%d battery:%d level:%d result:%d\n", p_conn->conn_id, i, p_attr, result );
+
+        if ( result == WICED_BT_GATT_CONGESTED )
+        {
+            /* Keep the level pending, GATT_CONGESTION_EVT tells when to try again */
+            p_conn->flag_congested = TRUE;
+            break;
+        }
+        if ( result == WICED_BT_GATT_NO_RESOURCES )
+        {
+            /* Keep the level pending, no event comes for a shortage of buffers, the next tick tries again */
+            break;
+        }
 
-        result = wiced_bt_gatt_send_notification( battery_service_app_state.conn_id, HDLC_BAS_BATTERY_LEVEL_VALUE, sizeof(p_attr), &p_attr );
-        WICED_BT_TRACE("notification result: %d\n",result);
+        p_conn->notify_pending   &= ~( 1 << i );
+        p_conn->notified_level[i] = p_attr;
+        p_conn->notify_time_ms[i] = now_ms ? now_ms : 1;
     }
 }
 
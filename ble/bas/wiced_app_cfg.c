@@ -40,6 +40,7 @@
 #include "wiced_bt_ble.h"
 #include "wiced_bt_gatt.h"
 #include "wiced_bt_cfg.h"
+#include "bond_store.h"
 
 /*
  * Definitions
@@ -55,7 +56,7 @@ const wiced_bt_cfg_settings_t wiced_app_cfg_settings =
     .device_class                        = {0x20, 0x07, 0x04},                                         /**< Local device class */
     .security_requirement_mask           = BTM_SEC_NONE,                                               /**< Security requirements mask (BTM_SEC_NONE, or combinination of BTM_SEC_IN_AUTHENTICATE, BTM_SEC_OUT_AUTHENTICATE, BTM_SEC_ENCRYPT (see #wiced_bt_sec_level_e)) */
 
-    .max_simultaneous_links              = 1,                                                          /**< Maximum number simultaneous links to different devices */
+    .max_simultaneous_links              = 3,                                                          /**< Maximum number simultaneous links to different devices */
 
     .br_edr_scan_cfg =                                              /* BR/EDR scan config */
     {
@@ -131,7 +132,7 @@ const wiced_bt_cfg_settings_t wiced_app_cfg_settings =
     {
         .appearance                     = APPEARANCE_WATCH_SPORTS,                                     /**< GATT appearance (see gatt_appearance_e) */
         .client_max_links               = 1,                                                           /**< Client config: maximum number of servers that local client can connect to  */
-        .server_max_links               = 0,                                                           /**< Server config: maximum number of remote clients connections allowed by the local */
+        .server_max_links               = 3,                                                           /**< Server config: maximum number of remote clients connections allowed by the local, BATTERY_SERVICE_GATTS_MAX_CONN */
         .max_attr_len                   = 512,                                                         /**< Maximum attribute length; gki_cfg must have a corresponding buffer pool that can hold this length */
 #if !defined(CYW20706A2)
         .max_mtu_size                   = 23                                                           /**< Maximum MTU size for GATT connections, should be between 23 and (max_attr_len + 5) */
@@ -177,7 +178,7 @@ const wiced_bt_cfg_settings_t wiced_app_cfg_settings =
     },
 
     /* LE Address Resolution DB size  */
-    .addr_resolution_db_size            = 5,                                                           /**< LE Address Resolution DB settings - effective only for pre 4.2 controller*/
+    .addr_resolution_db_size            = BOND_STORE_ADDR_RESOLUTION_DB_SIZE,                          /**< LE Address Resolution DB settings - effective only for pre 4.2 controller*/
 
 #ifdef CYW20706A2
     .max_mtu_size                       = 23,                                                          /**< Maximum MTU size for GATT connections, should be between 23 and (max_attr_len + 5) */
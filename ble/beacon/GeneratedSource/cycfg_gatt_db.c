@@ -44,6 +44,13 @@ const uint8_t gatt_database[] =
     /* Primary Service: Generic Attribute */
     PRIMARY_SERVICE_UUID16 (HDLS_GATT, __UUID_SERVICE_GENERIC_ATTRIBUTE),
 
+    /* Primary Service: Beacon Config */
+    PRIMARY_SERVICE_UUID128 (HDLS_BEACON_CONFIG, __UUID_SERVICE_BEACON_CONFIG),
+        /* Characteristic: Schedule */
+        CHARACTERISTIC_UUID128_WRITABLE (HDLC_BEACON_CONFIG_SCHEDULE, HDLC_BEACON_CONFIG_SCHEDULE_VALUE, __UUID_CHARACTERISTIC_SCHEDULE, LEGATTDB_CHAR_PROP_READ | LEGATTDB_CHAR_PROP_WRITE, LEGATTDB_PERM_READABLE | LEGATTDB_PERM_VARIABLE_LENGTH | LEGATTDB_PERM_WRITE_REQ | LEGATTDB_PERM_AUTH_WRITABLE),
+        /* Characteristic: Battery Policy */
+        CHARACTERISTIC_UUID128_WRITABLE (HDLC_BEACON_CONFIG_BATTERY_POLICY, HDLC_BEACON_CONFIG_BATTERY_POLICY_VALUE, __UUID_CHARACTERISTIC_BATTERY_POLICY, LEGATTDB_CHAR_PROP_READ | LEGATTDB_CHAR_PROP_WRITE, LEGATTDB_PERM_READABLE | LEGATTDB_PERM_VARIABLE_LENGTH | LEGATTDB_PERM_WRITE_REQ | LEGATTDB_PERM_AUTH_WRITABLE),
+
     /* Primary Service: Custom OTA Secure Firmware Upgrade */
     PRIMARY_SERVICE_UUID128 (HDLS_OTA_FW_UPGRADE_SERVICE, __UUID_SERVICE_CUSTOM_OTA_SECURE_FIRMWARE_UPGRADE),
         /* Characteristic: Control Point */
@@ -63,6 +70,8 @@ const uint16_t gatt_database_len = sizeof(gatt_database);
 
 uint8_t app_gap_device_name[]                                         = {'B', 'e', 'a', 'c', 'o', 'n', };
 uint8_t app_gap_appearance[]                                          = {0x00, 0x02, };
+uint8_t app_beacon_config_schedule[]                                  = {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, };
+uint8_t app_beacon_config_battery_policy[]                            = {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, };
 uint8_t app_ota_fw_upgrade_service_control_point[]                    = {};
 uint8_t app_ota_fw_upgrade_service_control_point_client_char_config[] = {0x00, 0x00, };
 uint8_t app_ota_fw_upgrade_service_data[]                             = {};
@@ -76,6 +85,8 @@ gatt_db_lookup_table_t app_gatt_db_ext_attr_tbl[] =
     /* { attribute handle,                                          maxlen, curlen, attribute data } */
     { HDLC_GAP_DEVICE_NAME_VALUE,                                   6,      6,      app_gap_device_name },
     { HDLC_GAP_APPEARANCE_VALUE,                                    2,      2,      app_gap_appearance },
+    { HDLC_BEACON_CONFIG_SCHEDULE_VALUE,                            20,     20,     app_beacon_config_schedule },
+    { HDLC_BEACON_CONFIG_BATTERY_POLICY_VALUE,                      7,      7,      app_beacon_config_battery_policy },
     { HDLC_OTA_FW_UPGRADE_SERVICE_CONTROL_POINT_VALUE,              0,      0,      app_ota_fw_upgrade_service_control_point },
     { HDLD_OTA_FW_UPGRADE_SERVICE_CONTROL_POINT_CLIENT_CHAR_CONFIG, 2,      2,      app_ota_fw_upgrade_service_control_point_client_char_config },
     { HDLC_OTA_FW_UPGRADE_SERVICE_DATA_VALUE,                       0,      0,      app_ota_fw_upgrade_service_data },
@@ -87,6 +98,8 @@ const uint16_t app_gatt_db_ext_attr_tbl_size = (sizeof(app_gatt_db_ext_attr_tbl)
 /* Number of GATT initial value arrays entries */
 const uint16_t app_gap_device_name_len = (sizeof(app_gap_device_name));
 const uint16_t app_gap_appearance_len = (sizeof(app_gap_appearance));
+const uint16_t app_beacon_config_schedule_len = (sizeof(app_beacon_config_schedule));
+const uint16_t app_beacon_config_battery_policy_len = (sizeof(app_beacon_config_battery_policy));
 const uint16_t app_ota_fw_upgrade_service_control_point_len = (sizeof(app_ota_fw_upgrade_service_control_point));
 const uint16_t app_ota_fw_upgrade_service_control_point_client_char_config_len = (sizeof(app_ota_fw_upgrade_service_control_point_client_char_config));
 const uint16_t app_ota_fw_upgrade_service_data_len = (sizeof(app_ota_fw_upgrade_service_data));
@@ -35,6 +35,9 @@
 #define __UUID_CHARACTERISTIC_DEVICE_NAME                               0x2A00
 #define __UUID_CHARACTERISTIC_APPEARANCE                                0x2A01
 #define __UUID_SERVICE_GENERIC_ATTRIBUTE                                0x1801
+#define __UUID_SERVICE_BEACON_CONFIG                                    0x6Bu, 0x1Eu, 0x3Cu, 0x59u, 0x0Du, 0x2Eu, 0x4Au, 0x8Fu, 0x9Cu, 0x51u, 0x37u, 0xB4u, 0x00u, 0x01u, 0xE5u, 0x5Bu
+#define __UUID_CHARACTERISTIC_SCHEDULE                                  0x6Bu, 0x1Eu, 0x3Cu, 0x59u, 0x0Du, 0x2Eu, 0x4Au, 0x8Fu, 0x9Cu, 0x51u, 0x37u, 0xB4u, 0x01u, 0x01u, 0xE5u, 0x5Bu
+#define __UUID_CHARACTERISTIC_BATTERY_POLICY                            0x6Bu, 0x1Eu, 0x3Cu, 0x59u, 0x0Du, 0x2Eu, 0x4Au, 0x8Fu, 0x9Cu, 0x51u, 0x37u, 0xB4u, 0x02u, 0x01u, 0xE5u, 0x5Bu
 #define __UUID_SERVICE_CUSTOM_OTA_SECURE_FIRMWARE_UPGRADE               0xD8u, 0x8Bu, 0x76u, 0x46u, 0x72u, 0x9Du, 0xBDu, 0xA1u, 0x7Au, 0x44u, 0x25u, 0xF4u, 0x10u, 0x11u, 0x26u, 0xC7u
 #define __UUID_CHARACTERISTIC_CONTROL_POINT                             0x1Bu, 0x66u, 0x6Cu, 0x08u, 0x0Au, 0x57u, 0x8Eu, 0x83u, 0x99u, 0x4Eu, 0xA7u, 0xF7u, 0xBFu, 0x50u, 0xDDu, 0xA3u
 #define __UUID_DESCRIPTOR_CLIENT_CHARACTERISTIC_CONFIGURATION           0x2902
@@ -52,6 +55,15 @@
 /* Service Generic Attribute */
 #define HDLS_GATT                                                       0x06
 
+/* Service Beacon Config */
+#define HDLS_BEACON_CONFIG                                              0x07
+/* Characteristic Schedule */
+#define HDLC_BEACON_CONFIG_SCHEDULE                                     0x08
+#define HDLC_BEACON_CONFIG_SCHEDULE_VALUE                               0x09
+/* Characteristic Battery Policy */
+#define HDLC_BEACON_CONFIG_BATTERY_POLICY                               0x0A
+#define HDLC_BEACON_CONFIG_BATTERY_POLICY_VALUE                         0x0B
+
 /* Service Custom OTA Secure Firmware Upgrade */
 #define HDLS_OTA_FW_UPGRADE_SERVICE                                     HANDLE_OTA_FW_UPGRADE_SERVICE
 /* Characteristic Control Point */
@@ -81,6 +93,10 @@ extern uint8_t app_gap_device_name[];
 extern const uint16_t app_gap_device_name_len;
 extern uint8_t app_gap_appearance[];
 extern const uint16_t app_gap_appearance_len;
+extern uint8_t app_beacon_config_schedule[];
+extern const uint16_t app_beacon_config_schedule_len;
+extern uint8_t app_beacon_config_battery_policy[];
+extern const uint16_t app_beacon_config_battery_policy_len;
 extern uint8_t app_ota_fw_upgrade_service_control_point[];
 extern const uint16_t app_ota_fw_upgrade_service_control_point_len;
 extern uint8_t app_ota_fw_upgrade_service_control_point_client_char_config[];
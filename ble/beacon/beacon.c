@@ -75,21 +75,121 @@
 #include "wiced_hal_puart.h"
 #include "wiced_platform.h"
 #include "wiced_transport.h"
+#if defined(CYW20735B1) || defined(CYW20819A1) || defined(CYW20719B2) || defined(CYW20721B2)
+#include "wiced_hal_adc.h"
+#define BEACON_BATT_ADC
+#endif
 
 
 /******************************************************************************
 *                                Constants
 ******************************************************************************/
-/* Multi advertisement instance ID */
-#define BEACON_EDDYSTONE_UID 1
-#define BEACON_EDDYSTONE_URL 2
-#define BEACON_EDDYSTONE_EID 3
-#define BEACON_EDDYSTONE_TLM 4
-#define BEACON_IBEACON       5
+/* Beacon frames, index in the scheduler table */
+#define BEACON_EDDYSTONE_UID 0
+#define BEACON_EDDYSTONE_URL 1
+#define BEACON_EDDYSTONE_EID 2
+#define BEACON_EDDYSTONE_TLM 3
+#define BEACON_IBEACON       4
+#define BEACON_NUM_FRAMES    5
+
+/* Multi advertisement instances used for the frames, 1 to this value. When
+ * more frames are enabled, they take turns on the instances */
+#ifndef BEACON_ADV_INSTANCES
+#define BEACON_ADV_INSTANCES    BEACON_NUM_FRAMES
+#endif
+
+/* Seconds each group of frames advertises before the next one when rotating */
+#define BEACON_ROTATE_SECONDS   2
+
+/* Battery levels of the power policy. Below the low threshold the intervals
+ * stretch and the low priority frames stop, below the critical one more so.
+ * A level is left when the battery is HYSTERESIS above its threshold */
+#define BEACON_BATT_LEVEL_NORMAL    0
+#define BEACON_BATT_LEVEL_LOW       1
+#define BEACON_BATT_LEVEL_CRITICAL  2
+#define BEACON_BATT_NUM_LEVELS      3
+#define BEACON_BATT_NEVER_DROP      BEACON_BATT_NUM_LEVELS
+#ifndef BEACON_BATT_LOW_MV
+#define BEACON_BATT_LOW_MV          2700
+#endif
+#ifndef BEACON_BATT_CRITICAL_MV
+#define BEACON_BATT_CRITICAL_MV     2400
+#endif
+#define BEACON_BATT_HYSTERESIS_MV   50
+#define BEACON_BATT_CHECK_SECONDS   60
+
+/* Battery Policy characteristic: low and critical thresholds in mV (little
+ * endian, read and write), then the battery in mV and the level (read only) */
+#define BEACON_BATT_WRITE_LEN       4
+#define BEACON_BATT_READ_LEN        7
+
+#ifdef BEACON_EXT_ADV
+/* Extended advertising set carrying the UID, TLM and iBeacon frames. Its interval
+ * and TX power come from the UID entry of the scheduler table */
+#define BEACON_EXT_ADV_HANDLE       1
+#define BEACON_EXT_ADV_SID          1
+#define BEACON_EXT_ADV_PROPERTIES   0       /* non-connectable, non-scannable, extended PDUs */
+#define BEACON_EXT_ADV_PHY_1M       1
+#define BEACON_EXT_ADV_PHY_2M       2
+#define BEACON_EXT_ADV_PHY_CODED    3
+#ifdef BEACON_EXT_ADV_2M
+#define BEACON_EXT_ADV_PRIMARY_PHY  BEACON_EXT_ADV_PHY_1M   /* primary channels cannot use 2M */
+#define BEACON_EXT_ADV_SECONDARY_PHY BEACON_EXT_ADV_PHY_2M
+#else
+#define BEACON_EXT_ADV_PRIMARY_PHY  BEACON_EXT_ADV_PHY_CODED
+#define BEACON_EXT_ADV_SECONDARY_PHY BEACON_EXT_ADV_PHY_CODED
+#endif
+#define BEACON_EXT_ADV_MAX_LEN      ( EDDYSTONE_SERVICE_DATA_POS + 24 + 18 + 27 )
+#endif
+
+/* Schedule characteristic: 4 bytes for each frame on read (enabled, interval
+ * in 0.625 ms units little endian, TX power). A write carries one or more
+ * 5 byte records, the frame index followed by the same 4 bytes */
+#define BEACON_SCHED_READ_LEN   4
+#define BEACON_SCHED_WRITE_LEN  5
 
 /* User defined UUID for iBeacon */
 #define UUID_IBEACON     0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f
 
+/* Sample values of the beacon frames */
+#define BEACON_RANGING_DATA         0xf0
+#define BEACON_UID_NAMESPACE        1, 2, 3, 4, 5, 6, 7, 8, 9, 0
+#define BEACON_UID_INSTANCE         0, 1, 2, 3, 4, 5
+#define BEACON_URL_TX_POWER         0x01
+#define BEACON_URL_SCHEME           0x00    /* EDDYSTONE_URL_SCHEME_0, "http://www." */
+#define BEACON_URL                  'c', 'y', 'p', 'r', 'e', 's', 's', '.', 'c', 'o', 'm'
+#define BEACON_EID                  1, 2, 3, 4, 5, 6, 7, 8
+#define BEACON_IBEACON_MAJOR        0x00, 0x01
+#define BEACON_IBEACON_MINOR        0x00, 0x02
+#define BEACON_IBEACON_TX_POWER     0xb3
+#define BEACON_TLM_VBATT            10
+#define BEACON_TLM_TEMP             15
+
+/* Frame types of the Eddystone service data */
+#define EDDYSTONE_FRAME_UID         0x00
+#define EDDYSTONE_FRAME_URL         0x10
+#define EDDYSTONE_FRAME_TLM         0x20
+#define EDDYSTONE_FRAME_EID         0x30
+
+/* Flags, the Eddystone service UUID and the head of its service data up to the frame type.
+ * The service data length covers the AD type, the UUID, the frame type and the payload */
+#define BEACON_FRAME_FLAGS          0x02, BTM_BLE_ADVERT_TYPE_FLAG, BTM_BLE_GENERAL_DISCOVERABLE_FLAG | BTM_BLE_BREDR_NOT_SUPPORTED
+#define EDDYSTONE_UUID16            0xaa, 0xfe
+#define EDDYSTONE_FRAME_HEAD( frame_type, payload_len ) \
+    BEACON_FRAME_FLAGS, \
+    0x03, BTM_BLE_ADVERT_TYPE_16SRV_COMPLETE, EDDYSTONE_UUID16, \
+    ( payload_len ) + 4, BTM_BLE_ADVERT_TYPE_SERVICE_DATA, EDDYSTONE_UUID16, ( frame_type )
+#define EDDYSTONE_FRAME_HEAD_LEN    12
+#define BEACON_FRAME_FLAGS_LEN      3
+#define EDDYSTONE_SERVICE_DATA_POS  7       /* after the flags and the service UUID */
+
+/* Payload of the unencrypted TLM frame: version, battery, temperature, PDU count and uptime, big endian */
+#define EDDYSTONE_TLM_PAYLOAD_LEN   13
+#define EDDYSTONE_TLM_VBATT_OFFSET  ( EDDYSTONE_FRAME_HEAD_LEN + 1 )
+#define EDDYSTONE_TLM_TEMP_OFFSET   ( EDDYSTONE_FRAME_HEAD_LEN + 3 )
+#define EDDYSTONE_TLM_ADV_OFFSET    ( EDDYSTONE_FRAME_HEAD_LEN + 5 )
+#define EDDYSTONE_TLM_SEC_OFFSET    ( EDDYSTONE_FRAME_HEAD_LEN + 9 )
+
 #ifdef OTA_SECURE_FIRMWARE_UPGRADE
 #include "bt_types.h"
 #include "p_256_multprecision.h"
@@ -122,6 +222,23 @@ wiced_bt_beacon_multi_advert_data_t adv_param =
     .own_addr_type = BLE_ADDR_PUBLIC
 };
 
+/* Advertising of a frame */
+typedef struct
+{
+    uint8_t  enabled;                   /* frame is advertised */
+    uint8_t  instance;                  /* multi advertisement instance running the frame, 0 for none */
+    uint16_t adv_int;                   /* advertising interval, 0.625 ms units */
+    int8_t   tx_power;                  /* advertising TX power */
+    uint8_t  drop_level;                /* battery level from which the frame is not advertised */
+} beacon_sched_entry_t;
+
+/* Advertising data of a frame */
+typedef struct
+{
+    const uint8_t *p_data;
+    uint8_t        len;
+} beacon_frame_t;
+
 /******************************************************************************
  *                              Variables Definitions
  ******************************************************************************/
@@ -129,6 +246,80 @@ wiced_bt_beacon_multi_advert_data_t adv_param =
 static wiced_timer_t beacon_timer;
 uint16_t      beacon_conn_id = 0;
 
+/* Beacon frames, complete at build time */
+static const uint8_t beacon_eddystone_uid_frame[] =
+{
+    EDDYSTONE_FRAME_HEAD( EDDYSTONE_FRAME_UID, 19 ),
+    BEACON_RANGING_DATA, BEACON_UID_NAMESPACE, BEACON_UID_INSTANCE, 0x00, 0x00
+};
+
+static const uint8_t beacon_eddystone_url_frame[] =
+{
+    EDDYSTONE_FRAME_HEAD( EDDYSTONE_FRAME_URL, 13 ),
+    BEACON_URL_TX_POWER, BEACON_URL_SCHEME, BEACON_URL
+};
+
+static const uint8_t beacon_eddystone_eid_frame[] =
+{
+    EDDYSTONE_FRAME_HEAD( EDDYSTONE_FRAME_EID, 9 ),
+    BEACON_RANGING_DATA, BEACON_EID
+};
+
+static const uint8_t beacon_ibeacon_frame[] =
+{
+    BEACON_FRAME_FLAGS,
+    0x1a, BTM_BLE_ADVERT_TYPE_MANUFACTURER, 0x4c, 0x00, 0x02, 0x15,
+    UUID_IBEACON, BEACON_IBEACON_MAJOR, BEACON_IBEACON_MINOR, BEACON_IBEACON_TX_POWER
+};
+
+/* TLM frame, its fields are patched in place on every update */
+static uint8_t beacon_eddystone_tlm_frame[] =
+{
+    EDDYSTONE_FRAME_HEAD( EDDYSTONE_FRAME_TLM, EDDYSTONE_TLM_PAYLOAD_LEN ),
+    0x00,                                                   /* version, unencrypted */
+    0x00, 0x00,                                             /* battery voltage, mV */
+    0x00, 0x00,                                             /* temperature, 8.8 fixed point */
+    0x00, 0x00, 0x00, 0x00,                                 /* advertising PDU count */
+    0x00, 0x00, 0x00, 0x00                                  /* time since power-on */
+};
+
+static const beacon_frame_t beacon_frames[BEACON_NUM_FRAMES] =
+{
+    { beacon_eddystone_uid_frame, sizeof(beacon_eddystone_uid_frame) },
+    { beacon_eddystone_url_frame, sizeof(beacon_eddystone_url_frame) },
+    { beacon_eddystone_eid_frame, sizeof(beacon_eddystone_eid_frame) },
+    { beacon_eddystone_tlm_frame, sizeof(beacon_eddystone_tlm_frame) },
+    { beacon_ibeacon_frame,       sizeof(beacon_ibeacon_frame) },
+};
+
+/* Scheduler table, changed over the Beacon Configuration service */
+static beacon_sched_entry_t beacon_sched[BEACON_NUM_FRAMES] =
+{
+    { WICED_TRUE, 0, 320,  MULTI_ADV_TX_POWER_MAX, BEACON_BATT_NEVER_DROP },     /* UID, 200 ms */
+    { WICED_TRUE, 0, 80,   MULTI_ADV_TX_POWER_MAX, BEACON_BATT_LEVEL_LOW },      /* URL, 50 ms */
+    { WICED_TRUE, 0, 480,  MULTI_ADV_TX_POWER_MAX, BEACON_BATT_LEVEL_LOW },      /* EID, 300 ms */
+    { WICED_TRUE, 0, 1280, MULTI_ADV_TX_POWER_MAX, BEACON_BATT_NEVER_DROP },     /* TLM, 800 ms */
+    { WICED_TRUE, 0, 160,  MULTI_ADV_TX_POWER_MAX, BEACON_BATT_LEVEL_CRITICAL }, /* iBeacon, 100 ms */
+};
+static uint8_t beacon_sched_next = 0;           /* first frame of the next rotation */
+static uint8_t beacon_sched_ticks = 0;          /* seconds since the last rotation */
+static wiced_bool_t beacon_sched_rotating = WICED_FALSE;
+
+#ifdef BEACON_EXT_ADV
+/* Data of the extended advertising set, the TLM part is refreshed on every update */
+static uint8_t beacon_ext_adv_data[BEACON_EXT_ADV_MAX_LEN];
+static uint8_t beacon_ext_adv_len = 0;
+static uint8_t beacon_ext_adv_tlm_pos = 0;      /* position of the TLM service data, 0 if not carried */
+#endif
+
+/* Battery power policy */
+static const uint8_t beacon_batt_stretch[BEACON_BATT_NUM_LEVELS] = { 1, 2, 4 };  /* interval multiplier of each level */
+static uint16_t beacon_batt_low_mv      = BEACON_BATT_LOW_MV;
+static uint16_t beacon_batt_critical_mv = BEACON_BATT_CRITICAL_MV;
+static uint16_t beacon_batt_mv          = BEACON_TLM_VBATT;
+static uint8_t  beacon_batt_level       = BEACON_BATT_LEVEL_NORMAL;
+static uint8_t  beacon_batt_ticks       = 0;     /* seconds since the last battery check */
+
 extern const wiced_bt_cfg_settings_t app_cfg_settings;
 extern const wiced_bt_cfg_buf_pool_t app_buf_pools[];
 
@@ -161,7 +352,6 @@ static void                     beacon_init(void);
 static wiced_result_t           beacon_management_callback(wiced_bt_management_evt_t event, wiced_bt_management_evt_data_t *p_event_data);
 static void                     beacon_advertisement_stopped(void);
 static wiced_bt_gatt_status_t   beacon_gatts_callback(wiced_bt_gatt_evt_t event, wiced_bt_gatt_event_data_t *p_data);
-static void                     beacon_set_eddystone_ibecon_advertisement_data(void);
 
 static wiced_bt_gatt_status_t   beacon_connection_status_event(wiced_bt_gatt_connection_status_t *p_status);
 static wiced_bt_gatt_status_t   beacon_gatts_req_callback(wiced_bt_gatt_attribute_request_t *p_data);
@@ -174,12 +364,21 @@ static void beacon_stop_advertisement(void);
 static void beacon_set_timer(void);
 static void beacon_data_update(uint32_t arg);
 static void beacon_set_app_advertisement_data();
+static void beacon_sched_apply(void);
+static void beacon_sched_run(void);
+static void beacon_set_instance_params(uint8_t instance, beacon_sched_entry_t *p_entry);
+static wiced_bt_gatt_status_t beacon_sched_write(uint8_t *p_data, uint16_t len);
+static wiced_bool_t beacon_sched_is_active(uint8_t frame);
+static wiced_bool_t beacon_batt_check(void);
+static wiced_bt_gatt_status_t beacon_batt_write(uint8_t *p_data, uint16_t len);
 
-static void beacon_set_eddystone_uid_advertisement_data(void);
-static void beacon_set_eddystone_url_advertisement_data(void);
-static void beacon_set_eddystone_eid_advertisement_data(void);
 static void beacon_set_eddystone_tlm_advertisement_data(void);
-static void beacon_set_ibeacon_advertisement_data(void);
+#ifdef BEACON_EXT_ADV
+static void beacon_ext_adv_start(void);
+static void beacon_ext_adv_add(const uint8_t *p_frame, uint8_t len, uint8_t skip);
+#endif
+static void beacon_frame_put_be16(uint8_t *p, uint16_t value);
+static void beacon_frame_put_be32(uint8_t *p, uint32_t value);
 
 /******************************************************************************
  *                          Function Definitions
@@ -269,7 +468,6 @@ void beacon_init(void)
     beacon_set_app_advertisement_data();
 
     /* Fill the adv data and start advertisements */
-    beacon_set_eddystone_ibecon_advertisement_data();
     beacon_start_advertisement();
 
     result =  wiced_bt_start_advertisements(BTM_BLE_ADVERT_UNDIRECTED_HIGH, 0, NULL);
@@ -277,196 +475,315 @@ void beacon_init(void)
 }
 
 /*
- * This function set adv data
+ * Write a 16 bit value in big endian order
  */
-static void beacon_set_eddystone_ibecon_advertisement_data()
+static void beacon_frame_put_be16(uint8_t *p, uint16_t value)
 {
-    /* Set Google Eddystone adv data for each time of frame */
-    beacon_set_eddystone_uid_advertisement_data();
-    beacon_set_eddystone_url_advertisement_data();
-    beacon_set_eddystone_eid_advertisement_data();
-    beacon_set_eddystone_tlm_advertisement_data();
-
-    /* Set Apple iBeacon adv data */
-    beacon_set_ibeacon_advertisement_data();
+    p[0] = (uint8_t)(value >> 8);
+    p[1] = (uint8_t)value;
 }
 
 /*
- * This function prepares Google Eddystone UID advertising data
+ * Write a 32 bit value in big endian order
  */
-static void beacon_set_eddystone_uid_advertisement_data(void)
+static void beacon_frame_put_be32(uint8_t *p, uint32_t value)
+{
+    p[0] = (uint8_t)(value >> 24);
+    p[1] = (uint8_t)(value >> 16);
+    p[2] = (uint8_t)(value >> 8);
+    p[3] = (uint8_t)value;
+}
+
+/*
+* This function patches the changing fields of the Google Eddystone TLM frame
+* and sets it as the advertising data
+*/
+static uint32_t adv_cnt = 0;
+static uint32_t sec_cnt = 0;
+static void beacon_set_eddystone_tlm_advertisement_data(void)
 {
-    uint8_t adv_data_uid[31];
-    uint8_t adv_len_uid = 0;
+    /* Set the battery and the sample temperature for Eddystone TLM */
+    uint16_t vbatt = beacon_batt_mv;
+    uint16_t temp =  BEACON_TLM_TEMP;
 
-    /* Set sample values for Eddystone UID*/
-    uint8_t eddystone_ranging_data = 0xf0;
-    uint8_t eddystone_namespace[EDDYSTONE_UID_NAMESPACE_LEN] = { 1,2,3,4,5,6,7,8,9,0 };
-    uint8_t eddystone_instance[EDDYSTONE_UID_INSTANCE_ID_LEN] = { 0,1,2,3,4,5 };
+    /* For each invocation of API, update Advertising PDU count and Time since power-on or reboot*/
+    adv_cnt++;
+    sec_cnt++;
 
-    memset(adv_data_uid, 0, 31);
+    beacon_frame_put_be16(&beacon_eddystone_tlm_frame[EDDYSTONE_TLM_VBATT_OFFSET], vbatt);
+    beacon_frame_put_be16(&beacon_eddystone_tlm_frame[EDDYSTONE_TLM_TEMP_OFFSET], temp);
+    beacon_frame_put_be32(&beacon_eddystone_tlm_frame[EDDYSTONE_TLM_ADV_OFFSET], adv_cnt);
+    beacon_frame_put_be32(&beacon_eddystone_tlm_frame[EDDYSTONE_TLM_SEC_OFFSET], sec_cnt);
 
-    /* Call Eddystone UID api to prepare adv data*/
-    wiced_bt_eddystone_set_data_for_uid(eddystone_ranging_data, eddystone_namespace, eddystone_instance, adv_data_uid, &adv_len_uid);
+    /* Sets adv data for multi adv instance, if TLM is on the air */
+    if (beacon_sched[BEACON_EDDYSTONE_TLM].instance != 0)
+    {
+        wiced_set_multi_advertisement_data(beacon_eddystone_tlm_frame, sizeof(beacon_eddystone_tlm_frame),
+                beacon_sched[BEACON_EDDYSTONE_TLM].instance);
+    }
+#ifdef BEACON_EXT_ADV
+    /* or the copy carried by the extended advertising set */
+    if (beacon_ext_adv_tlm_pos != 0)
+    {
+        memcpy(&beacon_ext_adv_data[beacon_ext_adv_tlm_pos], &beacon_eddystone_tlm_frame[EDDYSTONE_SERVICE_DATA_POS],
+                sizeof(beacon_eddystone_tlm_frame) - EDDYSTONE_SERVICE_DATA_POS);
+        wiced_bt_ble_set_ext_adv_data(BEACON_EXT_ADV_HANDLE, beacon_ext_adv_len, beacon_ext_adv_data);
+    }
+#endif
+}
 
-    /* Sets adv data for multi adv instance*/
-    wiced_set_multi_advertisement_data(adv_data_uid, adv_len_uid, BEACON_EDDYSTONE_UID);
+#ifdef BEACON_EXT_ADV
+/*
+* This function appends a frame to the extended advertising data, without the
+* first skip bytes it shares with the frames already there
+*/
+static void beacon_ext_adv_add(const uint8_t *p_frame, uint8_t len, uint8_t skip)
+{
+    memcpy(&beacon_ext_adv_data[beacon_ext_adv_len], p_frame + skip, len - skip);
+    beacon_ext_adv_len += len - skip;
 }
 
 /*
-* This function prepares Google Eddystone URL advertising data
+* This function (re)starts the extended advertising set with the active UID,
+* TLM and iBeacon frames in one payload
 */
-static void beacon_set_eddystone_url_advertisement_data(void)
+static void beacon_ext_adv_start(void)
 {
-    uint8_t adv_data_url[31];
-    uint8_t adv_len_url = 0;
+    wiced_bt_ble_ext_adv_duration_config_t duration = { BEACON_EXT_ADV_HANDLE, 0, 0 };
+    beacon_sched_entry_t                   *p_entry = &beacon_sched[BEACON_EDDYSTONE_UID];
+    uint32_t                               adv_int = (uint32_t)p_entry->adv_int * beacon_batt_stretch[beacon_batt_level];
 
-    /* Set sample values for Eddystone URL*/
-    uint8_t beacon_tx_power = 0x01;
-    uint8_t urlscheme = EDDYSTONE_URL_SCHEME_0;
-    uint8_t encoded_url[EDDYSTONE_URL_VALUE_MAX_LEN] = "cypress.com";
+    wiced_bt_ble_start_ext_adv(WICED_FALSE, 1, &duration);
 
-    memset(adv_data_url, 0, 31);
+    /* flags and the Eddystone service UUID once, then the service data of each frame */
+    beacon_ext_adv_len = 0;
+    beacon_ext_adv_tlm_pos = 0;
+    beacon_ext_adv_add(beacon_eddystone_uid_frame, EDDYSTONE_SERVICE_DATA_POS, 0);
+    if (beacon_sched_is_active(BEACON_EDDYSTONE_UID))
+    {
+        beacon_ext_adv_add(beacon_eddystone_uid_frame, sizeof(beacon_eddystone_uid_frame), EDDYSTONE_SERVICE_DATA_POS);
+    }
+    if (beacon_sched_is_active(BEACON_EDDYSTONE_TLM))
+    {
+        beacon_ext_adv_tlm_pos = beacon_ext_adv_len;
+        beacon_ext_adv_add(beacon_eddystone_tlm_frame, sizeof(beacon_eddystone_tlm_frame), EDDYSTONE_SERVICE_DATA_POS);
+    }
+    if (beacon_sched_is_active(BEACON_IBEACON))
+    {
+        beacon_ext_adv_add(beacon_ibeacon_frame, sizeof(beacon_ibeacon_frame), BEACON_FRAME_FLAGS_LEN);
+    }
 
-    /* Call Eddystone URL api to prepare adv data*/
-    wiced_bt_eddystone_set_data_for_url(beacon_tx_power, urlscheme, encoded_url, adv_data_url, &adv_len_url);
+    wiced_bt_ble_set_ext_adv_parameters(BEACON_EXT_ADV_HANDLE, BEACON_EXT_ADV_PROPERTIES, adv_int, adv_int,
+            adv_param.channel_map, adv_param.own_addr_type, adv_param.peer_addr_type, adv_param.peer_bd_addr,
+            adv_param.adv_filter_policy, p_entry->tx_power, BEACON_EXT_ADV_PRIMARY_PHY, 0,
+            BEACON_EXT_ADV_SECONDARY_PHY, BEACON_EXT_ADV_SID, 0);
+    wiced_bt_ble_set_ext_adv_data(BEACON_EXT_ADV_HANDLE, beacon_ext_adv_len, beacon_ext_adv_data);
+    wiced_bt_ble_start_ext_adv(WICED_TRUE, 1, &duration);
 
-    /* Sets adv data for multi adv instance*/
-    wiced_set_multi_advertisement_data(adv_data_url, adv_len_url, BEACON_EDDYSTONE_URL);
+    WICED_BT_TRACE("beacon_ext_adv_start len:%d interval:%d\n", beacon_ext_adv_len, adv_int);
 }
+#endif
 
 /*
-* This function prepares Google Eddystone EID advertising data
+* This function sets the interval and the TX power of a multi adv instance
 */
-static void beacon_set_eddystone_eid_advertisement_data(void)
+static void beacon_set_instance_params(uint8_t instance, beacon_sched_entry_t *p_entry)
 {
-    uint8_t adv_data_eid[31];
-    uint8_t adv_len_eid = 0;
+    uint32_t adv_int = (uint32_t)p_entry->adv_int * beacon_batt_stretch[beacon_batt_level];
 
-    /* Set sample values for Eddystone EID*/
-    uint8_t eddystone_ranging_data = 0xf0;
-    uint8_t eid[EDDYSTONE_EID_LEN] = { 0x1,0x2,0x3,0x4,0x5,0x6,0x7,0x8 };
+    if (adv_int > BTM_BLE_ADVERT_INTERVAL_MAX)
+        adv_int = BTM_BLE_ADVERT_INTERVAL_MAX;
 
-    memset(adv_data_eid, 0, 31);
-
-    /* Call Eddystone EID api to prepare adv data*/
-    wiced_bt_eddystone_set_data_for_eid(eddystone_ranging_data, eid, adv_data_eid, &adv_len_eid);
+    adv_param.adv_int_min  = adv_int;
+    adv_param.adv_int_max  = adv_int;
+    adv_param.adv_tx_power = p_entry->tx_power;
+#if defined(CYW20735B1) || defined(CYW20819A1) || defined(CYW20719B2) || defined(CYW20721B2) || defined (WICEDX)
+    wiced_set_multi_advertisement_params(instance, &adv_param);
+#else
+    wiced_set_multi_advertisement_params(adv_param.adv_int_min, adv_param.adv_int_max, adv_param.adv_type,
+            adv_param.own_addr_type, adv_param.own_bd_addr, adv_param.peer_addr_type, adv_param.peer_bd_addr,
+            adv_param.channel_map, adv_param.adv_filter_policy,
+            instance, adv_param.adv_tx_power);
+#endif
+}
 
-    /* Sets adv data for multi adv instance*/
-    wiced_set_multi_advertisement_data(adv_data_eid, adv_len_eid, BEACON_EDDYSTONE_EID);
+/*
+* This function tells if a frame is enabled and not dropped by the battery policy
+*/
+static wiced_bool_t beacon_sched_is_active(uint8_t frame)
+{
+    return beacon_sched[frame].enabled && (beacon_batt_level < beacon_sched[frame].drop_level);
 }
 
 /*
-* This function prepares Google Eddystone TLM advertising data
+* This function stops the frames on the air and starts the next enabled ones,
+* one on each multi adv instance
 */
-static uint32_t adv_cnt = 0;
-static uint32_t sec_cnt = 0;
-static void beacon_set_eddystone_tlm_advertisement_data(void)
+static void beacon_sched_run(void)
 {
-    uint8_t adv_data_tlm[31];
-    uint8_t adv_len_tlm = 0;
+    beacon_sched_entry_t *p_entry;
+    uint8_t              frame;
+    uint8_t              instance = 0;
+    uint8_t              i;
 
-    /* Set sample values for Eddystone TLM */
-    uint16_t vbatt = 10;
-    uint16_t temp =  15;
+    for (frame = 0; frame < BEACON_NUM_FRAMES; frame++)
+    {
+        if (beacon_sched[frame].instance != 0)
+        {
+            wiced_start_multi_advertisements(MULTI_ADVERT_STOP, beacon_sched[frame].instance);
+            beacon_sched[frame].instance = 0;
+        }
+    }
 
-    /* For each invocation of API, update Advertising PDU count and Time since power-on or reboot*/
-    adv_cnt++;
-    sec_cnt++;
+    frame = beacon_sched_next;
+    for (i = 0; (i < BEACON_NUM_FRAMES) && (instance < BEACON_ADV_INSTANCES); i++)
+    {
+        p_entry = &beacon_sched[frame];
+        if (beacon_sched_is_active(frame))
+        {
+            p_entry->instance = ++instance;
+            wiced_set_multi_advertisement_data((uint8_t *)beacon_frames[frame].p_data, beacon_frames[frame].len, instance);
+            beacon_set_instance_params(instance, p_entry);
+            wiced_start_multi_advertisements(MULTI_ADVERT_START, instance);
+        }
+        frame = (frame + 1) % BEACON_NUM_FRAMES;
+    }
+    beacon_sched_next = frame;
+    beacon_sched_ticks = 0;
+}
 
-    memset(adv_data_tlm, 0, 31);
+/*
+* This function starts the enabled frames from the first one and finds out if
+* they have to rotate on the multi adv instances
+*/
+static void beacon_sched_apply(void)
+{
+#ifdef BEACON_EXT_ADV
+    /* all the frames go out in the extended advertising set */
+    beacon_ext_adv_start();
+#else
+    uint8_t frame;
+    uint8_t num_enabled = 0;
 
-    /* Call Eddystone TLM api to prepare adv data*/
-    wiced_bt_eddystone_set_data_for_tlm_unencrypted(vbatt, temp, adv_cnt, sec_cnt, adv_data_tlm, &adv_len_tlm);
+    for (frame = 0; frame < BEACON_NUM_FRAMES; frame++)
+    {
+        if (beacon_sched_is_active(frame))
+        {
+            num_enabled++;
+        }
+    }
+    beacon_sched_rotating = (num_enabled > BEACON_ADV_INSTANCES);
+    beacon_sched_next = 0;
+    beacon_sched_run();
 
-    /* Sets adv data for multi adv instance*/
-    wiced_set_multi_advertisement_data(adv_data_tlm, adv_len_tlm, BEACON_EDDYSTONE_TLM);
+    WICED_BT_TRACE("beacon_sched_apply frames:%d instances:%d rotating:%d battery level:%d\n",
+            num_enabled, BEACON_ADV_INSTANCES, beacon_sched_rotating, beacon_batt_level);
+#endif
 }
 
 /*
-* This function prepares Apple iBeacon advertising data
+* This function applies Schedule characteristic records written by the peer
 */
-static void beacon_set_ibeacon_advertisement_data(void)
+static wiced_bt_gatt_status_t beacon_sched_write(uint8_t *p_data, uint16_t len)
 {
-    uint8_t adv_data_ibeacon[31];
-    uint8_t adv_len_ibeacon = 0;
-
-    /* Set sample values for iBeacon */
-    uint8_t ibeacon_uuid[LEN_UUID_128] = { UUID_IBEACON };
-    uint16_t ibeacon_major_number = 0x01;
-    uint16_t ibeacon_minor_number = 0x02;
-    uint8_t tx_power_lcl = 0xb3;
+    beacon_sched_entry_t *p_entry;
+    uint16_t             adv_int;
+    uint16_t             i;
 
-    WICED_BT_TRACE("beacon_set_ibeacon_advertisement_data \n");
+    if ((len == 0) || (len % BEACON_SCHED_WRITE_LEN) != 0)
+        return WICED_BT_GATT_INVALID_ATTR_LEN;
 
-    /* Call iBeacon api to prepare adv data*/
-    wiced_bt_ibeacon_set_adv_data(ibeacon_uuid, ibeacon_major_number, ibeacon_minor_number, tx_power_lcl,
-            adv_data_ibeacon, &adv_len_ibeacon);
+    /* check all the records before changing any */
+    for (i = 0; i < len; i += BEACON_SCHED_WRITE_LEN)
+    {
+        adv_int = p_data[i + 2] | (p_data[i + 3] << 8);
+        if ((p_data[i] >= BEACON_NUM_FRAMES) ||
+            (adv_int < BTM_BLE_ADVERT_INTERVAL_MIN) || (adv_int > BTM_BLE_ADVERT_INTERVAL_MAX) ||
+            ((int8_t)p_data[i + 4] < MULTI_ADV_TX_POWER_MIN) || ((int8_t)p_data[i + 4] > MULTI_ADV_TX_POWER_MAX))
+            return WICED_BT_GATT_OUT_OF_RANGE;
+    }
 
-    /* Sets adv data for multi adv instance*/
-    wiced_set_multi_advertisement_data(adv_data_ibeacon, adv_len_ibeacon, BEACON_IBEACON);
+    for (i = 0; i < len; i += BEACON_SCHED_WRITE_LEN)
+    {
+        p_entry = &beacon_sched[p_data[i]];
+        p_entry->enabled  = (p_data[i + 1] != 0);
+        p_entry->adv_int  = p_data[i + 2] | (p_data[i + 3] << 8);
+        p_entry->tx_power = (int8_t)p_data[i + 4];
+    }
+    beacon_sched_apply();
+    return WICED_BT_GATT_SUCCESS;
 }
 
-
 /*
-* This function starts the advertisements.
+* This function reads the battery and moves to the level of the power policy
+* it falls in. Returns WICED_TRUE if the level changed.
 */
-static void beacon_start_advertisement(void)
+static wiced_bool_t beacon_batt_check(void)
 {
-    /* Start Eddystone UID advertisements */
-    adv_param.adv_int_min = 320; // 200 ms
-    adv_param.adv_int_max = 320;
-#if defined(CYW20735B1) || defined(CYW20819A1) || defined(CYW20719B2) || defined(CYW20721B2) || defined (WICEDX)
-    wiced_set_multi_advertisement_params(BEACON_EDDYSTONE_UID, &adv_param);
+    uint8_t level = beacon_batt_level;
+
+#ifdef BEACON_BATT_ADC
+    beacon_batt_mv = (uint16_t)wiced_hal_adc_read_voltage(ADC_INPUT_VDDIO);
 #else
-    wiced_set_multi_advertisement_params(adv_param.adv_int_min, adv_param.adv_int_max, adv_param.adv_type,
-            adv_param.own_addr_type, adv_param.own_bd_addr, adv_param.peer_addr_type, adv_param.peer_bd_addr,
-            adv_param.channel_map, adv_param.adv_filter_policy,
-            BEACON_EDDYSTONE_UID, adv_param.adv_tx_power);
+    /* no battery measurement, keep the sample value and the normal level */
+    return WICED_FALSE;
 #endif
 
-    wiced_start_multi_advertisements(MULTI_ADVERT_START, BEACON_EDDYSTONE_UID);
+    /* go down as soon as below a threshold, come back up past the hysteresis */
+    if (beacon_batt_mv < beacon_batt_critical_mv)
+        level = BEACON_BATT_LEVEL_CRITICAL;
+    else if (beacon_batt_mv < beacon_batt_low_mv)
+        level = (level == BEACON_BATT_LEVEL_CRITICAL) && (beacon_batt_mv < beacon_batt_critical_mv + BEACON_BATT_HYSTERESIS_MV) ?
+                BEACON_BATT_LEVEL_CRITICAL : BEACON_BATT_LEVEL_LOW;
+    else if ((level == BEACON_BATT_LEVEL_NORMAL) || (beacon_batt_mv >= beacon_batt_low_mv + BEACON_BATT_HYSTERESIS_MV))
+        level = BEACON_BATT_LEVEL_NORMAL;
+    else if (level == BEACON_BATT_LEVEL_CRITICAL)
+        level = BEACON_BATT_LEVEL_LOW;
+
+    if (level == beacon_batt_level)
+        return WICED_FALSE;
+
+    WICED_BT_TRACE("battery %d mV, level %d -> %d\n", beacon_batt_mv, beacon_batt_level, level);
+    beacon_batt_level = level;
+    return WICED_TRUE;
+}
 
-    /* Start Eddystone URL advertisements */
-    adv_param.adv_int_min = 80; // 50 ms
-    adv_param.adv_int_max = 80;
-#if defined(CYW20735B1) || defined(CYW20819A1) || defined(CYW20719B2) || defined(CYW20721B2) || defined (WICEDX)
-    wiced_set_multi_advertisement_params(BEACON_EDDYSTONE_URL, &adv_param);
-#else
-    wiced_set_multi_advertisement_params(adv_param.adv_int_min, adv_param.adv_int_max, adv_param.adv_type,
-            adv_param.own_addr_type, adv_param.own_bd_addr, adv_param.peer_addr_type, adv_param.peer_bd_addr,
-            adv_param.channel_map, adv_param.adv_filter_policy,
-            BEACON_EDDYSTONE_URL, adv_param.adv_tx_power);
-#endif
+/*
+* This function applies the Battery Policy thresholds written by the peer
+*/
+static wiced_bt_gatt_status_t beacon_batt_write(uint8_t *p_data, uint16_t len)
+{
+    uint16_t low_mv, critical_mv;
 
-    wiced_start_multi_advertisements(MULTI_ADVERT_START, BEACON_EDDYSTONE_URL);
+    if (len != BEACON_BATT_WRITE_LEN)
+        return WICED_BT_GATT_INVALID_ATTR_LEN;
 
-    /* Start Eddystone EID advertisements */
-    adv_param.adv_int_min = 480; // 300 ms
-    adv_param.adv_int_max = 480;
-#if defined(CYW20735B1) || defined(CYW20819A1) || defined(CYW20719B2) || defined(CYW20721B2) || defined (WICEDX)
-    wiced_set_multi_advertisement_params(BEACON_EDDYSTONE_EID, &adv_param);
-#else
-    wiced_set_multi_advertisement_params(adv_param.adv_int_min, adv_param.adv_int_max, adv_param.adv_type,
-            adv_param.own_addr_type, adv_param.own_bd_addr, adv_param.peer_addr_type, adv_param.peer_bd_addr,
-            adv_param.channel_map, adv_param.adv_filter_policy,
-            BEACON_EDDYSTONE_EID, adv_param.adv_tx_power);
-#endif
+    low_mv      = p_data[0] | (p_data[1] << 8);
+    critical_mv = p_data[2] | (p_data[3] << 8);
+    if (critical_mv > low_mv)
+        return WICED_BT_GATT_OUT_OF_RANGE;
 
-    wiced_start_multi_advertisements(MULTI_ADVERT_START, BEACON_EDDYSTONE_EID);
+    beacon_batt_low_mv      = low_mv;
+    beacon_batt_critical_mv = critical_mv;
+    if (beacon_batt_check())
+    {
+        beacon_sched_apply();
+    }
+    return WICED_BT_GATT_SUCCESS;
+}
 
-    /* Start iBeacon advertisements */
-    adv_param.adv_int_min = 160; // 100 ms
-    adv_param.adv_int_max = 160;
-#if defined(CYW20735B1) || defined(CYW20819A1) || defined(CYW20719B2) || defined(CYW20721B2) || defined (WICEDX)
-    wiced_set_multi_advertisement_params(BEACON_IBEACON, &adv_param);
-#else
-    wiced_set_multi_advertisement_params(adv_param.adv_int_min, adv_param.adv_int_max, adv_param.adv_type,
-            adv_param.own_addr_type, adv_param.own_bd_addr, adv_param.peer_addr_type, adv_param.peer_bd_addr,
-            adv_param.channel_map, adv_param.adv_filter_policy,
-            BEACON_IBEACON, adv_param.adv_tx_power);
+/*
+* This function starts the advertisements.
+*/
+static void beacon_start_advertisement(void)
+{
+    /* Fill the TLM fields, then start the frames of the scheduler table */
+#ifdef BEACON_BATT_ADC
+    wiced_hal_adc_init();
 #endif
-    wiced_start_multi_advertisements(MULTI_ADVERT_START, BEACON_IBEACON);
+    beacon_batt_check();
+    beacon_set_eddystone_tlm_advertisement_data();
+    beacon_sched_apply();
 
     /* start timer to change beacon ADV data */
     beacon_set_timer();
@@ -497,28 +814,30 @@ static void beacon_set_timer(void)
     }
 }
 
-/* Function called on timer */
+/*
+ * Function called on timer. The controller takes new data for a running
+ * instance, so the TLM instance keeps advertising through the update.
+ */
 void beacon_data_update(uint32_t arg)
 {
-    /* Stops Eddystone TLM advertisements */
-    wiced_start_multi_advertisements(MULTI_ADVERT_STOP, BEACON_EDDYSTONE_TLM);
+    // Follow the battery, a new level changes the frames on the air
+    if (++beacon_batt_ticks >= BEACON_BATT_CHECK_SECONDS)
+    {
+        beacon_batt_ticks = 0;
+        if (beacon_batt_check())
+        {
+            beacon_sched_apply();
+        }
+    }
 
     // Set Eddystone TLM adv data
     beacon_set_eddystone_tlm_advertisement_data();
 
-    /* Sets adv data for multi adv instance*/
-    adv_param.adv_int_min = 1280; // 800 ms
-    adv_param.adv_int_max = 1280; // 800 ms
-#if defined(CYW20735B1) || defined(CYW20819A1) || defined(CYW20719B2) || defined(CYW20721B2) || defined (WICEDX)
-    wiced_set_multi_advertisement_params(BEACON_EDDYSTONE_TLM, &adv_param);
-#else
-    wiced_set_multi_advertisement_params(adv_param.adv_int_min, adv_param.adv_int_max, adv_param.adv_type,
-            adv_param.own_addr_type, adv_param.own_bd_addr, adv_param.peer_addr_type, adv_param.peer_bd_addr,
-            adv_param.channel_map, adv_param.adv_filter_policy,
-            BEACON_EDDYSTONE_TLM, adv_param.adv_tx_power);
-#endif
-    /* Starts Eddystone TLM advertisements */
-    wiced_start_multi_advertisements(MULTI_ADVERT_START, BEACON_EDDYSTONE_TLM);
+    // Move to the next group of frames
+    if (beacon_sched_rotating && (++beacon_sched_ticks >= BEACON_ROTATE_SECONDS))
+    {
+        beacon_sched_run();
+    }
 }
 
 /*
@@ -526,15 +845,28 @@ void beacon_data_update(uint32_t arg)
 */
 static void beacon_stop_advertisement(void)
 {
+    uint8_t frame;
+
     /* Stop timer*/
     wiced_stop_timer( &beacon_timer);
 
     /* stop all advertisements */
-    wiced_start_multi_advertisements(MULTI_ADVERT_STOP, BEACON_EDDYSTONE_UID);
-    wiced_start_multi_advertisements(MULTI_ADVERT_STOP, BEACON_EDDYSTONE_URL);
-    wiced_start_multi_advertisements(MULTI_ADVERT_STOP, BEACON_EDDYSTONE_EID);
-    wiced_start_multi_advertisements(MULTI_ADVERT_STOP, BEACON_IBEACON);
-    wiced_start_multi_advertisements(MULTI_ADVERT_STOP, BEACON_EDDYSTONE_TLM);
+#ifdef BEACON_EXT_ADV
+    {
+        wiced_bt_ble_ext_adv_duration_config_t duration = { BEACON_EXT_ADV_HANDLE, 0, 0 };
+
+        wiced_bt_ble_start_ext_adv(WICED_FALSE, 1, &duration);
+        beacon_ext_adv_tlm_pos = 0;
+    }
+#endif
+    for (frame = 0; frame < BEACON_NUM_FRAMES; frame++)
+    {
+        if (beacon_sched[frame].instance != 0)
+        {
+            wiced_start_multi_advertisements(MULTI_ADVERT_STOP, beacon_sched[frame].instance);
+            beacon_sched[frame].instance = 0;
+        }
+    }
 }
 
 /*
@@ -645,7 +977,10 @@ wiced_result_t beacon_management_callback(wiced_bt_management_evt_t event, wiced
  */
 wiced_bt_gatt_status_t beacon_gatts_req_read_handler(uint16_t conn_id, wiced_bt_gatt_read_t * p_read_data)
 {
-    int to_copy;
+    int     to_copy;
+    uint8_t sched[BEACON_NUM_FRAMES * BEACON_SCHED_READ_LEN];
+    uint8_t batt[BEACON_BATT_READ_LEN];
+    uint8_t frame;
 
 #ifndef CYW43012C0
     // if read request is for the OTA FW upgrade service, pass it to the library to process
@@ -680,6 +1015,44 @@ wiced_bt_gatt_status_t beacon_gatts_req_read_handler(uint16_t conn_id, wiced_bt_
         *p_read_data->p_val_len = to_copy;
         break;
 
+    case HDLC_BEACON_CONFIG_SCHEDULE_VALUE:
+        for (frame = 0; frame < BEACON_NUM_FRAMES; frame++)
+        {
+            sched[frame * BEACON_SCHED_READ_LEN]     = beacon_sched[frame].enabled;
+            sched[frame * BEACON_SCHED_READ_LEN + 1] = beacon_sched[frame].adv_int & 0xff;
+            sched[frame * BEACON_SCHED_READ_LEN + 2] = beacon_sched[frame].adv_int >> 8;
+            sched[frame * BEACON_SCHED_READ_LEN + 3] = (uint8_t)beacon_sched[frame].tx_power;
+        }
+        if (p_read_data->offset >= sizeof(sched))
+            return WICED_BT_GATT_INVALID_OFFSET;
+
+        to_copy = sizeof(sched) - p_read_data->offset;
+        if (*p_read_data->p_val_len < to_copy)
+            to_copy = *p_read_data->p_val_len;
+
+        memcpy(p_read_data->p_val, sched + p_read_data->offset, to_copy);
+        *p_read_data->p_val_len = to_copy;
+        break;
+
+    case HDLC_BEACON_CONFIG_BATTERY_POLICY_VALUE:
+        batt[0] = beacon_batt_low_mv & 0xff;
+        batt[1] = beacon_batt_low_mv >> 8;
+        batt[2] = beacon_batt_critical_mv & 0xff;
+        batt[3] = beacon_batt_critical_mv >> 8;
+        batt[4] = beacon_batt_mv & 0xff;
+        batt[5] = beacon_batt_mv >> 8;
+        batt[6] = beacon_batt_level;
+        if (p_read_data->offset >= sizeof(batt))
+            return WICED_BT_GATT_INVALID_OFFSET;
+
+        to_copy = sizeof(batt) - p_read_data->offset;
+        if (*p_read_data->p_val_len < to_copy)
+            to_copy = *p_read_data->p_val_len;
+
+        memcpy(p_read_data->p_val, batt + p_read_data->offset, to_copy);
+        *p_read_data->p_val_len = to_copy;
+        break;
+
     default:
         return WICED_BT_GATT_INVALID_HANDLE;
     }
@@ -699,6 +1072,15 @@ wiced_bt_gatt_status_t beacon_gatts_req_write_handler(uint16_t conn_id, wiced_bt
     }
 #endif
 
+    if (p_write_data->handle == HDLC_BEACON_CONFIG_SCHEDULE_VALUE)
+    {
+        return beacon_sched_write(p_write_data->p_val, p_write_data->val_len);
+    }
+    if (p_write_data->handle == HDLC_BEACON_CONFIG_BATTERY_POLICY_VALUE)
+    {
+        return beacon_batt_write(p_write_data->p_val, p_write_data->val_len);
+    }
+
     return WICED_BT_GATT_INVALID_HANDLE;
 }
 
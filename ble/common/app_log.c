@@ -0,0 +1,151 @@
+/*
+ * Copyright 2016-2020, Cypress Semiconductor Corporation or a subsidiary of
+ * Cypress Semiconductor Corporation. All Rights Reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software"), is owned by Cypress Semiconductor Corporation
+ * or one of its subsidiaries ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products. Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ */
+
+/** @file
+ *
+ * Logging with compile time levels, and deferred formatting
+ *
+ * A deferred call is kept as 32-bit words: the address of the format, the
+ * sequence number and argument count, then the arguments. A host seeing a
+ * gap in the sequence numbers knows that calls were dropped.
+ */
+
+#include <stdarg.h>
+#include <string.h>
+#include "wiced_timer.h"
+#include "wiced_transport.h"
+#include "hci_control_api.h"
+#include "app_log.h"
+
+#ifdef APP_LOG_DEFERRED
+
+/******************************************************
+ *                     Constants
+ ******************************************************/
+
+/* A deferred call, format address, sequence number << 8 | number of arguments, arguments */
+#ifndef HCI_CONTROL_MISC_EVENT_LOG
+#define HCI_CONTROL_MISC_EVENT_LOG          ( ( HCI_CONTROL_GROUP_MISC << 8 ) | 0x20 )
+#endif
+
+#ifndef APP_LOG_RING_WORDS
+#define APP_LOG_RING_WORDS                  128
+#endif
+#ifndef APP_LOG_DRAIN_INTERVAL_MS
+#define APP_LOG_DRAIN_INTERVAL_MS           20
+#endif
+#ifndef APP_LOG_DRAIN_COUNT
+#define APP_LOG_DRAIN_COUNT                 4       /* calls sent per interval */
+#endif
+
+#define APP_LOG_HDR_WORDS                   2
+
+/******************************************************
+ *               Variables Definitions
+ ******************************************************/
+
+static uint32_t         app_log_ring[APP_LOG_RING_WORDS];
+static uint16_t         app_log_first;
+static uint16_t         app_log_used;
+static uint32_t         app_log_seq;
+static uint32_t         app_log_num_dropped;
+static wiced_timer_t    app_log_timer;
+static wiced_bool_t     app_log_timer_init;
+
+/******************************************************
+ *               Function Definitions
+ ******************************************************/
+
+static void app_log_drain(uint32_t arg)
+{
+    uint32_t record[APP_LOG_HDR_WORDS + APP_LOG_MAX_ARGS];
+    uint8_t  num_words;
+    uint8_t  i, sent;
+
+    for (sent = 0; sent < APP_LOG_DRAIN_COUNT && app_log_used != 0; sent++)
+    {
+        num_words = APP_LOG_HDR_WORDS + (app_log_ring[(app_log_first + 1) % APP_LOG_RING_WORDS] & 0xFF);
+
+        for (i = 0; i < num_words; i++)
+            record[i] = app_log_ring[(app_log_first + i) % APP_LOG_RING_WORDS];
+
+        app_log_first = (app_log_first + num_words) % APP_LOG_RING_WORDS;
+        app_log_used -= num_words;
+
+        wiced_transport_send_data(HCI_CONTROL_MISC_EVENT_LOG, (uint8_t *) record, num_words * sizeof(uint32_t));
+    }
+
+    if (app_log_used != 0)
+        wiced_start_timer(&app_log_timer, APP_LOG_DRAIN_INTERVAL_MS);
+}
+
+void app_log_defer(const char *p_fmt, uint8_t num_args, ...)
+{
+    uint16_t num_words = APP_LOG_HDR_WORDS + num_args;
+    uint16_t last;
+    va_list  args;
+    uint8_t  i;
+
+    app_log_seq++;
+    if (num_args > APP_LOG_MAX_ARGS || app_log_used + num_words > APP_LOG_RING_WORDS)
+    {
+        app_log_num_dropped++;
+        return;
+    }
+
+    last = (app_log_first + app_log_used) % APP_LOG_RING_WORDS;
+    app_log_ring[last] = (uint32_t) p_fmt;
+    app_log_ring[(last + 1) % APP_LOG_RING_WORDS] = (app_log_seq << 8) | num_args;
+
+    va_start(args, num_args);
+    for (i = 0; i < num_args; i++)
+        app_log_ring[(last + APP_LOG_HDR_WORDS + i) % APP_LOG_RING_WORDS] = va_arg(args, uint32_t);
+    va_end(args);
+
+    app_log_used += num_words;
+
+    if (!app_log_timer_init)
+    {
+        wiced_init_timer(&app_log_timer, app_log_drain, 0, WICED_MILLI_SECONDS_TIMER);
+        app_log_timer_init = WICED_TRUE;
+    }
+    if (!wiced_is_timer_in_use(&app_log_timer))
+        wiced_start_timer(&app_log_timer, APP_LOG_DRAIN_INTERVAL_MS);
+}
+
+uint32_t app_log_dropped(void)
+{
+    return app_log_num_dropped;
+}
+
+#endif /* APP_LOG_DEFERRED */
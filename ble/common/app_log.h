@@ -0,0 +1,128 @@
+/*
+ * Copyright 2016-2020, Cypress Semiconductor Corporation or a subsidiary of
+ * Cypress Semiconductor Corporation. All Rights Reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software"), is owned by Cypress Semiconductor Corporation
+ * or one of its subsidiaries ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products. Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ */
+
+/** @file
+ *
+ * Logging with compile time levels, and deferred formatting
+ *
+ * APP_LOG_ERR(), APP_LOG_WARN(), APP_LOG_INFO() and APP_LOG_DBG() take the
+ * arguments of WICED_BT_TRACE(). A call above the level of its module
+ * compiles to nothing, format string included. A module sets its level by
+ * defining APP_LOG_MODULE_LEVEL before including this file, the others use
+ * APP_LOG_LEVEL. Both can be set in the makefile.
+ *
+ * With APP_LOG_DEFERRED defined, the calls kept do not format. They store
+ * the address of the format string and up to APP_LOG_MAX_ARGS arguments, as
+ * 32-bit values, in a ring. The ring is sent to the host in the background
+ * with HCI_CONTROL_MISC_EVENT_LOG events, and the host decodes the formats
+ * from the ELF file of the application. A string or a %B address would be
+ * sent as a pointer, so the calls with those stay WICED_BT_TRACE() when
+ * modules are deferred.
+ */
+
+#pragma once
+
+#include "wiced_bt_types.h"
+#include "wiced_bt_trace.h"
+
+/******************************************************
+ *                     Constants
+ ******************************************************/
+
+#define APP_LOG_LEVEL_NONE                  0
+#define APP_LOG_LEVEL_ERROR                 1
+#define APP_LOG_LEVEL_WARNING               2
+#define APP_LOG_LEVEL_INFO                  3
+#define APP_LOG_LEVEL_DEBUG                 4
+
+#ifndef APP_LOG_LEVEL
+#define APP_LOG_LEVEL                       APP_LOG_LEVEL_INFO
+#endif
+
+#ifndef APP_LOG_MODULE_LEVEL
+#define APP_LOG_MODULE_LEVEL                APP_LOG_LEVEL
+#endif
+
+/* Arguments of a deferred call */
+#define APP_LOG_MAX_ARGS                    4
+
+/* Number of arguments after the format, up to APP_LOG_MAX_ARGS */
+#define APP_LOG_NARGS(...)                  APP_LOG_NARGS_(__VA_ARGS__, 4, 3, 2, 1, 0)
+#define APP_LOG_NARGS_(fmt, a1, a2, a3, a4, n, ...) n
+
+#ifdef APP_LOG_DEFERRED
+#define APP_LOG_EMIT(fmt, ...)              app_log_defer(fmt, APP_LOG_NARGS(fmt, ##__VA_ARGS__), ##__VA_ARGS__)
+#else
+#define APP_LOG_EMIT(...)                   WICED_BT_TRACE(__VA_ARGS__)
+#endif
+
+#if APP_LOG_MODULE_LEVEL >= APP_LOG_LEVEL_ERROR
+#define APP_LOG_ERR(...)                    APP_LOG_EMIT(__VA_ARGS__)
+#else
+#define APP_LOG_ERR(...)                    ((void) 0)
+#endif
+
+#if APP_LOG_MODULE_LEVEL >= APP_LOG_LEVEL_WARNING
+#define APP_LOG_WARN(...)                   APP_LOG_EMIT(__VA_ARGS__)
+#else
+#define APP_LOG_WARN(...)                   ((void) 0)
+#endif
+
+#if APP_LOG_MODULE_LEVEL >= APP_LOG_LEVEL_INFO
+#define APP_LOG_INFO(...)                   APP_LOG_EMIT(__VA_ARGS__)
+#else
+#define APP_LOG_INFO(...)                   ((void) 0)
+#endif
+
+#if APP_LOG_MODULE_LEVEL >= APP_LOG_LEVEL_DEBUG
+#define APP_LOG_DBG(...)                    APP_LOG_EMIT(__VA_ARGS__)
+#else
+#define APP_LOG_DBG(...)                    ((void) 0)
+#endif
+
+/******************************************************
+ *               Function Declarations
+ ******************************************************/
+
+#ifdef APP_LOG_DEFERRED
+/**
+ * Keep a log call in the ring, without formatting it. Called by the
+ * APP_LOG_xxx() macros.
+ */
+void app_log_defer(const char *p_fmt, uint8_t num_args, ...);
+
+/**
+ * Number of calls that did not fit in the ring.
+ */
+uint32_t app_log_dropped(void);
+#endif
@@ -0,0 +1,212 @@
+/*
+ * Copyright 2016-2020, Cypress Semiconductor Corporation or a subsidiary of
+ * Cypress Semiconductor Corporation. All Rights Reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software"), is owned by Cypress Semiconductor Corporation
+ * or one of its subsidiaries ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products. Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ */
+
+
+/** @file
+ *
+ * Runtime statistics of an application
+ */
+
+#include <string.h>
+#include "wiced_bt_dev.h"
+#include "wiced_bt_trace.h"
+#include "wiced_transport.h"
+#include "app_stats.h"
+
+/******************************************************
+ *                      Constants
+ ******************************************************/
+
+#define APP_STATS_INC16(counter)    do { if ((counter) != 0xFFFF) (counter)++; } while (0)
+
+/******************************************************
+ *               Variables Definitions
+ ******************************************************/
+
+static app_stats_t app_stats;
+
+/******************************************************
+ *               Function Definitions
+ ******************************************************/
+
+void app_stats_init(void)
+{
+    memset(&app_stats, 0, sizeof(app_stats));
+    app_stats.rssi     = APP_STATS_RSSI_NONE;
+    app_stats.rssi_min = APP_STATS_RSSI_NONE;
+    app_stats.rssi_max = -APP_STATS_RSSI_NONE;
+}
+
+const app_stats_t *app_stats_get(void)
+{
+    return &app_stats;
+}
+
+void app_stats_conn_up(void)
+{
+    APP_STATS_INC16(app_stats.connections);
+}
+
+void app_stats_conn_down(uint16_t reason)
+{
+    app_stats_reason_t *p_free = NULL;
+    uint8_t            i;
+
+    APP_STATS_INC16(app_stats.disconnections);
+
+    for (i = 0; i < APP_STATS_MAX_REASONS; i++)
+    {
+        if ((app_stats.reasons[i].count != 0) && (app_stats.reasons[i].reason == reason))
+        {
+            APP_STATS_INC16(app_stats.reasons[i].count);
+            return;
+        }
+        if ((p_free == NULL) && (app_stats.reasons[i].count == 0))
+            p_free = &app_stats.reasons[i];
+    }
+
+    if (p_free == NULL)
+    {
+        APP_STATS_INC16(app_stats.other_reasons);
+        return;
+    }
+    p_free->reason = reason;
+    p_free->count  = 1;
+}
+
+void app_stats_notify(wiced_bt_gatt_status_t status)
+{
+    if (status == WICED_BT_GATT_SUCCESS)
+    {
+        if (app_stats.notifications_sent != 0xFFFFFFFF)
+            app_stats.notifications_sent++;
+    }
+    else
+    {
+        APP_STATS_INC16(app_stats.notifications_failed);
+    }
+}
+
+void app_stats_gatt_status(wiced_bt_gatt_status_t status)
+{
+    if (status != WICED_BT_GATT_SUCCESS)
+        APP_STATS_INC16(app_stats.gatt_errors);
+}
+
+void app_stats_buf_failure(void)
+{
+    APP_STATS_INC16(app_stats.buf_failures);
+}
+
+static void app_stats_rssi_cback(void *p_data)
+{
+    wiced_bt_dev_rssi_result_t *p_result = (wiced_bt_dev_rssi_result_t *)p_data;
+
+    if (p_result->status != WICED_BT_SUCCESS)
+        return;
+
+    app_stats.rssi = p_result->rssi;
+    if (p_result->rssi < app_stats.rssi_min)
+        app_stats.rssi_min = p_result->rssi;
+    if (p_result->rssi > app_stats.rssi_max)
+        app_stats.rssi_max = p_result->rssi;
+}
+
+void app_stats_read_rssi(wiced_bt_device_address_t bd_addr)
+{
+    if (wiced_bt_dev_read_rssi(bd_addr, BT_TRANSPORT_LE, app_stats_rssi_cback) != WICED_BT_PENDING)
+        WICED_BT_TRACE("app_stats: read RSSI failed\n");
+}
+
+void app_stats_phy_update(uint8_t tx_phy, uint8_t rx_phy)
+{
+    app_stats.tx_phy = tx_phy;
+    app_stats.rx_phy = rx_phy;
+    APP_STATS_INC16(app_stats.phy_updates);
+}
+
+uint16_t app_stats_pack(uint8_t *p_buf, uint16_t max_len)
+{
+    uint8_t buf[APP_STATS_PACKED_LEN], *p = buf;
+    uint8_t num_reasons = 0;
+    uint8_t i;
+
+    for (i = 0; i < APP_STATS_MAX_REASONS; i++)
+    {
+        if (app_stats.reasons[i].count != 0)
+            num_reasons++;
+    }
+
+    UINT8_TO_STREAM(p, APP_STATS_VERSION);
+    UINT16_TO_STREAM(p, app_stats.connections);
+    UINT16_TO_STREAM(p, app_stats.disconnections);
+    UINT32_TO_STREAM(p, app_stats.notifications_sent);
+    UINT16_TO_STREAM(p, app_stats.notifications_failed);
+    UINT16_TO_STREAM(p, app_stats.gatt_errors);
+    UINT16_TO_STREAM(p, app_stats.buf_failures);
+    UINT8_TO_STREAM(p, app_stats.rssi);
+    UINT8_TO_STREAM(p, app_stats.rssi_min);
+    UINT8_TO_STREAM(p, app_stats.rssi_max);
+    UINT8_TO_STREAM(p, app_stats.tx_phy);
+    UINT8_TO_STREAM(p, app_stats.rx_phy);
+    UINT16_TO_STREAM(p, app_stats.phy_updates);
+    UINT16_TO_STREAM(p, app_stats.other_reasons);
+    UINT8_TO_STREAM(p, num_reasons);
+    for (i = 0; i < APP_STATS_MAX_REASONS; i++)
+    {
+        if (app_stats.reasons[i].count != 0)
+        {
+            UINT16_TO_STREAM(p, app_stats.reasons[i].reason);
+            UINT16_TO_STREAM(p, app_stats.reasons[i].count);
+        }
+    }
+
+    if (max_len > (uint16_t) (p - buf))
+        max_len = (uint16_t) (p - buf);
+    memcpy(p_buf, buf, max_len);
+    return max_len;
+}
+
+uint8_t app_stats_cmd_read(uint16_t opcode, uint8_t *p_data, uint32_t data_len)
+{
+    uint8_t evt[APP_STATS_PACKED_LEN];
+
+    wiced_transport_send_data(HCI_CONTROL_MISC_EVENT_STATS, evt, app_stats_pack(evt, sizeof(evt)));
+    return HCI_CONTROL_STATUS_SUCCESS;
+}
+
+uint8_t app_stats_cmd_reset(uint16_t opcode, uint8_t *p_data, uint32_t data_len)
+{
+    app_stats_init();
+    return HCI_CONTROL_STATUS_SUCCESS;
+}
@@ -0,0 +1,183 @@
+/*
+ * Copyright 2016-2020, Cypress Semiconductor Corporation or a subsidiary of
+ * Cypress Semiconductor Corporation. All Rights Reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software"), is owned by Cypress Semiconductor Corporation
+ * or one of its subsidiaries ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products. Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ */
+
+
+/** @file
+ *
+ * Runtime statistics of an application
+ *
+ * Fixed size counters the application updates from its event handlers:
+ * connections, disconnections by reason, notifications sent and failed,
+ * GATT errors returned to the clients, buffer allocation failures, and the
+ * RSSI and PHY of the link. The counters saturate instead of wrapping.
+ *
+ * HCI_CONTROL_MISC_COMMAND_READ_STATS is answered with one
+ * HCI_CONTROL_MISC_EVENT_STATS event, HCI_CONTROL_MISC_COMMAND_RESET_STATS
+ * clears the counters. app_stats_pack() gives the same payload for a vendor
+ * GATT characteristic, so a device in the field can be read without a
+ * debugger or a host on its transport.
+ */
+
+#pragma once
+
+#include "wiced_bt_types.h"
+#include "wiced_bt_gatt.h"
+#include "hci_control_api.h"
+
+/******************************************************
+ *                     Constants
+ ******************************************************/
+
+/* No payload */
+#ifndef HCI_CONTROL_MISC_COMMAND_READ_STATS
+#define HCI_CONTROL_MISC_COMMAND_READ_STATS     ( ( HCI_CONTROL_GROUP_MISC << 8 ) | 0x22 )
+#endif
+
+/* No payload */
+#ifndef HCI_CONTROL_MISC_COMMAND_RESET_STATS
+#define HCI_CONTROL_MISC_COMMAND_RESET_STATS    ( ( HCI_CONTROL_GROUP_MISC << 8 ) | 0x23 )
+#endif
+
+/* Payload: app_stats_pack() */
+#ifndef HCI_CONTROL_MISC_EVENT_STATS
+#define HCI_CONTROL_MISC_EVENT_STATS            ( ( HCI_CONTROL_GROUP_MISC << 8 ) | 0x22 )
+#endif
+
+/* Layout of app_stats_pack(), bumped when it changes */
+#define APP_STATS_VERSION                       1
+
+/* Disconnection reasons counted one by one, the others are counted together */
+#ifndef APP_STATS_MAX_REASONS
+#define APP_STATS_MAX_REASONS                   6
+#endif
+
+#define APP_STATS_RSSI_NONE                     127     /* no RSSI read yet */
+
+/*
+ * Packed length: version, connections, disconnections, notifications sent
+ * (uint32), notifications failed, GATT errors, buffer failures, last, lowest
+ * and highest RSSI, TX and RX PHY, PHY updates, other reasons, number of
+ * reasons, then reason and count for each one (uint16 unless noted)
+ */
+#define APP_STATS_PACKED_LEN                    ( 25 + APP_STATS_MAX_REASONS * 4 )
+
+/******************************************************
+ *                 Type Definitions
+ ******************************************************/
+
+typedef struct
+{
+    uint16_t    reason;             /* wiced_bt_gatt_disconn_reason_t */
+    uint16_t    count;              /* 0 if the slot is free */
+} app_stats_reason_t;
+
+typedef struct
+{
+    uint16_t            connections;
+    uint16_t            disconnections;
+    uint32_t            notifications_sent;
+    uint16_t            notifications_failed;
+    uint16_t            gatt_errors;
+    uint16_t            buf_failures;
+    int8_t              rssi;               /* last read, APP_STATS_RSSI_NONE if none */
+    int8_t              rssi_min;
+    int8_t              rssi_max;
+    uint8_t             tx_phy;             /* of the last PHY update, 0 if none */
+    uint8_t             rx_phy;
+    uint16_t            phy_updates;
+    uint16_t            other_reasons;      /* disconnections with no free slot for their reason */
+    app_stats_reason_t  reasons[APP_STATS_MAX_REASONS];
+} app_stats_t;
+
+/******************************************************
+ *               Function Declarations
+ ******************************************************/
+
+/**
+ * Clear the counters.
+ */
+void app_stats_init(void);
+
+/**
+ * Counters of the application, read only.
+ */
+const app_stats_t *app_stats_get(void);
+
+/**
+ * A connection is up.
+ */
+void app_stats_conn_up(void);
+
+/**
+ * A connection is down, for a wiced_bt_gatt_disconn_reason_t.
+ */
+void app_stats_conn_down(uint16_t reason);
+
+/**
+ * Count the status of a notification or indication sent.
+ */
+void app_stats_notify(wiced_bt_gatt_status_t status);
+
+/**
+ * Count a GATT error returned to a client, success is not counted.
+ */
+void app_stats_gatt_status(wiced_bt_gatt_status_t status);
+
+/**
+ * A buffer allocation failed.
+ */
+void app_stats_buf_failure(void);
+
+/**
+ * Read the RSSI of a link, the result is kept when it comes.
+ */
+void app_stats_read_rssi(wiced_bt_device_address_t bd_addr);
+
+/**
+ * The PHY of a link was updated, from BTM_BLE_PHY_UPDATE_EVT.
+ */
+void app_stats_phy_update(uint8_t tx_phy, uint8_t rx_phy);
+
+/**
+ * Pack the counters, little endian.
+ *
+ * @return  the length written, at most APP_STATS_PACKED_LEN
+ */
+uint16_t app_stats_pack(uint8_t *p_buf, uint16_t max_len);
+
+/**
+ * HCI_CONTROL_MISC_COMMAND_READ_STATS and HCI_CONTROL_MISC_COMMAND_RESET_STATS
+ * handlers, for the command table of the application.
+ */
+uint8_t app_stats_cmd_read(uint16_t opcode, uint8_t *p_data, uint32_t data_len);
+uint8_t app_stats_cmd_reset(uint16_t opcode, uint8_t *p_data, uint32_t data_len);
@@ -0,0 +1,315 @@
+/*
+ * Copyright 2016-2020, Cypress Semiconductor Corporation or a subsidiary of
+ * Cypress Semiconductor Corporation. All Rights Reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software"), is owned by Cypress Semiconductor Corporation
+ * or one of its subsidiaries ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products. Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ */
+
+/** @file
+ *
+ * Link keys of the bonded devices, saved in NVRAM
+ */
+
+#include <string.h>
+#include "wiced_bt_trace.h"
+#include "wiced_hal_nvram.h"
+#include "bond_store.h"
+
+/******************************************************
+ *                 Type Definitions
+ ******************************************************/
+
+/* Index saved before the table held the address type and IRK of each slot */
+typedef struct
+{
+    uint8_t         num_devices;
+    uint8_t         lru[BOND_STORE_MAX_DEVICES];
+    BD_ADDR         bd_addr[BOND_STORE_MAX_DEVICES];
+} bond_store_index_v1_t;
+
+/******************************************************
+ *               Function Definitions
+ ******************************************************/
+
+static void bond_store_write_index(bond_store_t *p_store)
+{
+    wiced_result_t result;
+
+    wiced_hal_write_nvram(p_store->first_vs_id, sizeof(p_store->index), (uint8_t *)&p_store->index, &result);
+    p_store->lru_changed = WICED_FALSE;
+
+    if (result != WICED_SUCCESS)
+        WICED_BT_TRACE("bond_store index write failed:%d\n", result);
+}
+
+/* position in the lru list of the slot holding an address, -1 if none */
+static int bond_store_find(bond_store_t *p_store, const uint8_t *bd_addr)
+{
+    int i;
+
+    for (i = 0; i < p_store->index.num_devices; i++)
+    {
+        if (memcmp(p_store->index.entry[p_store->index.lru[i]].bd_addr, bd_addr, BD_ADDR_LEN) == 0)
+            return i;
+    }
+    return -1;
+}
+
+/* make the slot at a position of the lru list the most recently used one */
+static uint8_t bond_store_touch(bond_store_t *p_store, int position)
+{
+    uint8_t slot = p_store->index.lru[position];
+
+    if (position != 0)
+    {
+        memmove(&p_store->index.lru[1], &p_store->index.lru[0], position);
+        p_store->index.lru[0] = slot;
+        p_store->lru_changed  = WICED_TRUE;
+    }
+    return slot;
+}
+
+/* update the table entry of a slot from the keys saved in it */
+static void bond_store_set_entry(bond_store_t *p_store, uint8_t slot, wiced_bt_device_link_keys_t *p_keys)
+{
+    bond_store_entry_t *p_entry = &p_store->index.entry[slot];
+    bond_store_entry_t  entry;
+
+    memset(&entry, 0, sizeof(entry));
+    memcpy(entry.bd_addr, p_keys->bd_addr, BD_ADDR_LEN);
+    entry.addr_type = p_keys->key_data.ble_addr_type;
+    entry.key_mask  = p_keys->key_data.le_keys_available_mask;
+    if (entry.key_mask & BTM_LE_KEY_PID)
+        memcpy(entry.irk, p_keys->key_data.le_keys.irk, sizeof(entry.irk));
+
+    if (memcmp(p_entry, &entry, sizeof(entry)) != 0)
+    {
+        memcpy(p_entry, &entry, sizeof(entry));
+        p_store->lru_changed = WICED_TRUE;
+    }
+}
+
+/* check that the lru list of a saved index holds each of the used slots once */
+static wiced_bool_t bond_store_lru_valid(const uint8_t *p_lru, uint8_t num_devices)
+{
+    int i, j;
+
+    for (i = 0; i < num_devices; i++)
+    {
+        // slots are used in order, so the used ones are below the number of devices
+        if (p_lru[i] >= num_devices)
+            return WICED_FALSE;
+        for (j = 0; j < i; j++)
+        {
+            if (p_lru[j] == p_lru[i])
+                return WICED_FALSE;
+        }
+    }
+    return WICED_TRUE;
+}
+
+/* build the table from the keys of an index saved in the previous format */
+static void bond_store_upgrade_index(bond_store_t *p_store, bond_store_index_v1_t *p_v1)
+{
+    wiced_bt_device_link_keys_t keys;
+    wiced_result_t              result;
+    uint16_t                    bytes_read;
+    uint8_t                     slot;
+    int                         i;
+
+    memset(&p_store->index, 0, sizeof(p_store->index));
+
+    for (i = 0; i < p_v1->num_devices; i++)
+    {
+        slot = p_v1->lru[i];
+        p_store->index.lru[i] = slot;
+        memcpy(p_store->index.entry[slot].bd_addr, p_v1->bd_addr[slot], BD_ADDR_LEN);
+
+        // a slot whose keys can't be read stays in use, as the next free
+        // slot is found from the number of devices
+        bytes_read = wiced_hal_read_nvram(p_store->first_vs_id + 1 + slot, sizeof(keys), (uint8_t *)&keys, &result);
+        if ((result == WICED_SUCCESS) && (bytes_read == sizeof(keys)) && (memcmp(keys.bd_addr, p_v1->bd_addr[slot], BD_ADDR_LEN) == 0))
+            bond_store_set_entry(p_store, slot, &keys);
+    }
+    p_store->index.num_devices = p_v1->num_devices;
+    bond_store_write_index(p_store);
+}
+
+void bond_store_init(bond_store_t *p_store, uint16_t first_vs_id, uint8_t max_devices)
+{
+    union
+    {
+        bond_store_index_t      index;
+        bond_store_index_v1_t   v1;
+    } saved;
+    wiced_result_t result;
+    uint16_t       bytes_read;
+
+    memset(p_store, 0, sizeof(*p_store));
+    p_store->first_vs_id = first_vs_id;
+    p_store->max_devices = (max_devices < BOND_STORE_MAX_DEVICES) ? max_devices : BOND_STORE_MAX_DEVICES;
+
+    bytes_read = wiced_hal_read_nvram(first_vs_id, sizeof(saved), (uint8_t *)&saved, &result);
+
+    if ((result == WICED_SUCCESS) && (bytes_read == sizeof(saved.index)) && (saved.index.num_devices <= p_store->max_devices))
+    {
+        if (bond_store_lru_valid(saved.index.lru, saved.index.num_devices))
+            memcpy(&p_store->index, &saved.index, sizeof(p_store->index));
+        else
+            WICED_BT_TRACE("bond_store id:%d bad index, reset\n", first_vs_id);
+    }
+    else if ((result == WICED_SUCCESS) && (bytes_read == sizeof(saved.v1)) && (saved.v1.num_devices <= p_store->max_devices))
+    {
+        // one time read of the keys of each device, to fill the table
+        if (bond_store_lru_valid(saved.v1.lru, saved.v1.num_devices))
+            bond_store_upgrade_index(p_store, &saved.v1);
+        else
+            WICED_BT_TRACE("bond_store id:%d bad index, reset\n", first_vs_id);
+    }
+    // else nothing saved yet, or saved by a store of another size
+
+    WICED_BT_TRACE("bond_store id:%d devices:%d/%d\n", first_vs_id, p_store->index.num_devices, p_store->max_devices);
+}
+
+wiced_bool_t bond_store_save(bond_store_t *p_store, wiced_bt_device_link_keys_t *p_keys)
+{
+    wiced_result_t result;
+    int            position = bond_store_find(p_store, p_keys->bd_addr);
+    uint8_t        slot;
+
+    if (position < 0)
+    {
+        if (p_store->index.num_devices < p_store->max_devices)
+        {
+            // slots are used in order, the next one is free
+            position = p_store->index.num_devices++;
+            p_store->index.lru[position] = position;
+        }
+        else
+        {
+            // replace the least recently used device
+            position = p_store->index.num_devices - 1;
+            WICED_BT_TRACE("bond_store replace <%B>\n", p_store->index.entry[p_store->index.lru[position]].bd_addr);
+            if (p_store->p_replace_cb != NULL)
+                p_store->p_replace_cb(p_store->p_replace_context, p_store->index.lru[position]);
+        }
+        memset(&p_store->index.entry[p_store->index.lru[position]], 0, sizeof(bond_store_entry_t));
+        memcpy(p_store->index.entry[p_store->index.lru[position]].bd_addr, p_keys->bd_addr, BD_ADDR_LEN);
+        p_store->lru_changed = WICED_TRUE;
+    }
+    slot = bond_store_touch(p_store, position);
+    bond_store_set_entry(p_store, slot, p_keys);
+
+    wiced_hal_write_nvram(p_store->first_vs_id + 1 + slot, sizeof(wiced_bt_device_link_keys_t), (uint8_t *)p_keys, &result);
+    WICED_BT_TRACE("bond_store save <%B> id:%d result:%d\n", p_keys->bd_addr, p_store->first_vs_id + 1 + slot, result);
+
+    if (p_store->lru_changed)
+        bond_store_write_index(p_store);
+
+    return (result == WICED_SUCCESS);
+}
+
+wiced_bool_t bond_store_read(bond_store_t *p_store, wiced_bt_device_link_keys_t *p_keys)
+{
+    wiced_bt_device_link_keys_t keys;
+    wiced_result_t              result;
+    uint16_t                    bytes_read;
+    int                         position = bond_store_find(p_store, p_keys->bd_addr);
+
+    if (position < 0)
+        return WICED_FALSE;
+
+    // the new order is saved with the next keys, not to write NVRAM on each connection
+    bytes_read = wiced_hal_read_nvram(p_store->first_vs_id + 1 + bond_store_touch(p_store, position), sizeof(keys), (uint8_t *)&keys, &result);
+
+    if ((result != WICED_SUCCESS) || (bytes_read != sizeof(keys)) || (memcmp(keys.bd_addr, p_keys->bd_addr, BD_ADDR_LEN) != 0))
+    {
+        WICED_BT_TRACE("bond_store read <%B> failed:%d\n", p_keys->bd_addr, result);
+        return WICED_FALSE;
+    }
+    memcpy(&p_keys->key_data, &keys.key_data, sizeof(keys.key_data));
+    return WICED_TRUE;
+}
+
+wiced_bool_t bond_store_is_bonded(bond_store_t *p_store, const uint8_t *bd_addr)
+{
+    return (bond_store_find(p_store, bd_addr) >= 0);
+}
+
+int bond_store_slot(bond_store_t *p_store, const uint8_t *bd_addr)
+{
+    int position = bond_store_find(p_store, bd_addr);
+
+    return (position < 0) ? -1 : p_store->index.lru[position];
+}
+
+void bond_store_register_replace_cb(bond_store_t *p_store, bond_store_replace_cb_t *p_cb, void *p_context)
+{
+    p_store->p_replace_cb      = p_cb;
+    p_store->p_replace_context = p_context;
+}
+
+uint8_t bond_store_load_addr_resolution_db(bond_store_t *p_store)
+{
+    wiced_bt_device_link_keys_t keys;
+    bond_store_entry_t         *p_entry;
+    wiced_result_t              result;
+    uint8_t                     added = 0;
+    int                         i;
+
+    // the stack takes one device per call, all of them are pushed here from
+    // the table in RAM without waiting on the NVRAM
+    memset(&keys, 0, sizeof(keys));
+
+    for (i = 0; (i < p_store->index.num_devices) && (added < BOND_STORE_ADDR_RESOLUTION_DB_SIZE); i++)
+    {
+        p_entry = &p_store->index.entry[p_store->index.lru[i]];
+
+        // nothing to resolve without an IRK
+        if ((p_entry->key_mask & BTM_LE_KEY_PID) == 0)
+            continue;
+
+        memcpy(keys.bd_addr, p_entry->bd_addr, BD_ADDR_LEN);
+        keys.key_data.ble_addr_type          = p_entry->addr_type;
+        keys.key_data.le_keys_available_mask = p_entry->key_mask;
+        memcpy(keys.key_data.le_keys.irk, p_entry->irk, sizeof(p_entry->irk));
+
+#ifdef CYW20706A2
+        result = wiced_bt_dev_add_device_to_address_resolution_db(&keys, keys.key_data.ble_addr_type);
+#else
+        result = wiced_bt_dev_add_device_to_address_resolution_db(&keys);
+#endif
+        if (result == WICED_SUCCESS)
+            added++;
+        else
+            WICED_BT_TRACE("bond_store <%B> add to resolution db failed:%d\n", p_entry->bd_addr, result);
+    }
+    WICED_BT_TRACE("bond_store %d/%d devices added to resolution db\n", added, p_store->index.num_devices);
+    return added;
+}
@@ -0,0 +1,154 @@
+/*
+ * Copyright 2016-2020, Cypress Semiconductor Corporation or a subsidiary of
+ * Cypress Semiconductor Corporation. All Rights Reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software"), is owned by Cypress Semiconductor Corporation
+ * or one of its subsidiaries ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products. Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ */
+
+/** @file
+ *
+ * Link keys of the bonded devices, saved in NVRAM
+ *
+ * The keys of each device live in their own NVRAM id. One more id, the
+ * first one of the store, holds a packed table with the address, address
+ * type and IRK saved in each slot and the order in which the devices were
+ * last used. The table is read once at init and kept in RAM, so finding the
+ * keys of a device takes one NVRAM read, saving them one write of the keys
+ * plus one of the table, and filling the address resolution database at
+ * startup no NVRAM read at all.
+ *
+ * When all the slots are in use, the keys of a new device replace the
+ * ones of the device used the longest time ago. Modules that save more data
+ * per slot register to be told, and drop the data of the replaced device.
+ */
+
+#pragma once
+
+#include "wiced_bt_types.h"
+#include "wiced_bt_dev.h"
+
+/******************************************************
+ *                      Constants
+ ******************************************************/
+
+#ifndef BOND_STORE_MAX_DEVICES
+#define BOND_STORE_MAX_DEVICES      8       /* largest max_devices given to bond_store_init() */
+#endif
+
+/* Size to give to addr_resolution_db_size in the stack configuration */
+#ifndef BOND_STORE_ADDR_RESOLUTION_DB_SIZE
+#define BOND_STORE_ADDR_RESOLUTION_DB_SIZE  BOND_STORE_MAX_DEVICES
+#endif
+
+/* NVRAM ids used by a store of max_devices, starting at its first id */
+#define BOND_STORE_NUM_VS_ID(max_devices)    ( 1 + (max_devices) )
+
+/******************************************************
+ *                 Type Definitions
+ ******************************************************/
+
+/* What the address resolution database needs of a device */
+typedef struct
+{
+    BD_ADDR         bd_addr;
+    uint8_t         addr_type;      /* wiced_bt_ble_address_type_t */
+    uint8_t         key_mask;       /* le_keys_available_mask of the keys */
+    BT_OCTET16      irk;
+} bond_store_entry_t;
+
+/* Saved in the first NVRAM id of the store */
+typedef struct
+{
+    uint8_t             num_devices;
+    uint8_t             lru[BOND_STORE_MAX_DEVICES];        /* slots, most recently used first */
+    bond_store_entry_t  entry[BOND_STORE_MAX_DEVICES];      /* device saved in each slot */
+} bond_store_index_t;
+
+/* Called before the keys of a new device replace the ones saved in a slot */
+typedef void (bond_store_replace_cb_t)(void *p_context, uint8_t slot);
+
+typedef struct
+{
+    uint16_t                 first_vs_id;
+    uint8_t                  max_devices;
+    wiced_bool_t             lru_changed;    /* order or table in RAM not saved yet */
+    bond_store_index_t       index;
+    bond_store_replace_cb_t *p_replace_cb;
+    void                    *p_replace_context;
+} bond_store_t;
+
+/******************************************************
+ *               Function Declarations
+ ******************************************************/
+
+/**
+ * Initialize a store of max_devices devices, using the NVRAM ids from
+ * first_vs_id on, see BOND_STORE_NUM_VS_ID().
+ */
+void bond_store_init(bond_store_t *p_store, uint16_t first_vs_id, uint8_t max_devices);
+
+/**
+ * Save the keys of a device, replacing the least recently used device if
+ * the store is full.
+ */
+wiced_bool_t bond_store_save(bond_store_t *p_store, wiced_bt_device_link_keys_t *p_keys);
+
+/**
+ * Read the keys of the device whose address is in p_keys->bd_addr.
+ *
+ * @return  WICED_FALSE if the device is not bonded
+ */
+wiced_bool_t bond_store_read(bond_store_t *p_store, wiced_bt_device_link_keys_t *p_keys);
+
+/**
+ * Check if the keys of a device are saved, without access to the NVRAM.
+ */
+wiced_bool_t bond_store_is_bonded(bond_store_t *p_store, const uint8_t *bd_addr);
+
+/**
+ * Find the slot holding the keys of a device, without access to the NVRAM
+ * and without changing the order of use.
+ *
+ * @return  slot, -1 if the device is not bonded
+ */
+int bond_store_slot(bond_store_t *p_store, const uint8_t *bd_addr);
+
+/**
+ * Register the function called when the keys of a new device replace the
+ * ones of the least recently used device. Call after bond_store_init().
+ */
+void bond_store_register_replace_cb(bond_store_t *p_store, bond_store_replace_cb_t *p_cb, void *p_context);
+
+/**
+ * Add the bonded devices which distributed an IRK to the address resolution
+ * database, most recently used first, from the table in RAM.
+ *
+ * @return  number of devices added
+ */
+uint8_t bond_store_load_addr_resolution_db(bond_store_t *p_store);
@@ -0,0 +1,166 @@
+/*
+ * Copyright 2016-2020, Cypress Semiconductor Corporation or a subsidiary of
+ * Cypress Semiconductor Corporation. All Rights Reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software"), is owned by Cypress Semiconductor Corporation
+ * or one of its subsidiaries ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products. Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ */
+
+/** @file
+ *
+ * Usage of the stack buffer pools, and sizing of wiced_bt_cfg_buf_pools[]
+ */
+
+#include <string.h>
+#include "wiced_bt_trace.h"
+#include "wiced_transport.h"
+#include "buf_pool_stats.h"
+
+/******************************************************
+ *               Variables Definitions
+ ******************************************************/
+
+static const wiced_bt_cfg_buf_pool_t   *buf_pool_stats_cfg;
+static uint16_t                         buf_pool_stats_failed[BUF_POOL_STATS_MAX_POOLS];
+
+/******************************************************
+ *               Function Definitions
+ ******************************************************/
+
+void buf_pool_stats_init(const wiced_bt_cfg_buf_pool_t *p_pools)
+{
+    buf_pool_stats_cfg = p_pools;
+    memset(buf_pool_stats_failed, 0, sizeof(buf_pool_stats_failed));
+}
+
+void *buf_pool_stats_get_buffer(uint16_t size)
+{
+    void    *p_buf = wiced_bt_get_buffer(size);
+    uint8_t i;
+
+    if (p_buf == NULL && buf_pool_stats_cfg != NULL)
+    {
+        for (i = 0; i < BUF_POOL_STATS_MAX_POOLS; i++)
+        {
+            if (buf_pool_stats_cfg[i].buf_count != 0 && buf_pool_stats_cfg[i].buf_size >= size)
+            {
+                if (buf_pool_stats_failed[i] != 0xFFFF)
+                    buf_pool_stats_failed[i]++;
+                break;
+            }
+        }
+    }
+    return p_buf;
+}
+
+uint8_t buf_pool_stats_read(buf_pool_stats_t *p_stats, uint8_t max_pools)
+{
+    wiced_bt_buffer_statistics_t usage[BUF_POOL_STATS_MAX_POOLS];
+    uint8_t i;
+
+    if (max_pools > BUF_POOL_STATS_MAX_POOLS)
+        max_pools = BUF_POOL_STATS_MAX_POOLS;
+
+    memset(usage, 0, sizeof(usage));
+    if (wiced_bt_get_buffer_usage(usage, sizeof(usage)) != WICED_BT_SUCCESS)
+        return 0;
+
+    for (i = 0; i < max_pools; i++)
+    {
+        p_stats[i].buf_size      = usage[i].pool_size;
+        p_stats[i].buf_count     = usage[i].total_count;
+        p_stats[i].current_count = usage[i].current_allocated_count;
+        p_stats[i].peak_count    = usage[i].max_allocated_count;
+        p_stats[i].failed_count  = buf_pool_stats_failed[i];
+        p_stats[i].recommended_count = buf_pool_stats_recommend(&p_stats[i]);
+    }
+    return max_pools;
+}
+
+uint16_t buf_pool_stats_recommend(const buf_pool_stats_t *p_stats)
+{
+    uint32_t headroom;
+
+    /* Unused pool, keep it as configured */
+    if (p_stats->peak_count == 0)
+        return p_stats->buf_count;
+
+    /* Short of buffers, the peak only says that the pool was exhausted */
+    if (p_stats->failed_count != 0 || p_stats->peak_count >= p_stats->buf_count)
+    {
+        headroom = ((uint32_t) p_stats->buf_count * BUF_POOL_STATS_HEADROOM_PCT + 99) / 100;
+        if (headroom < p_stats->failed_count)
+            headroom = p_stats->failed_count;
+        return (uint16_t) (p_stats->buf_count + (headroom ? headroom : 1));
+    }
+
+    headroom = ((uint32_t) p_stats->peak_count * BUF_POOL_STATS_HEADROOM_PCT + 99) / 100;
+    return (uint16_t) (p_stats->peak_count + headroom);
+}
+
+uint8_t buf_pool_stats_cmd_read(uint16_t opcode, uint8_t *p_data, uint32_t data_len)
+{
+    buf_pool_stats_t stats[BUF_POOL_STATS_MAX_POOLS];
+    uint8_t evt[2 + BUF_POOL_STATS_MAX_POOLS * 12], *p = evt;
+    uint8_t mode = BUF_POOL_REPORT_USAGE;
+    uint8_t num_pools, i;
+
+    if (data_len != 0)
+        mode = p_data[0];
+    if (mode > BUF_POOL_REPORT_SIZING)
+        return HCI_CONTROL_STATUS_INVALID_ARGS;
+
+    if ((num_pools = buf_pool_stats_read(stats, BUF_POOL_STATS_MAX_POOLS)) == 0)
+        return HCI_CONTROL_STATUS_FAILED;
+
+    UINT8_TO_STREAM(p, mode);
+    UINT8_TO_STREAM(p, num_pools);
+    for (i = 0; i < num_pools; i++)
+    {
+        UINT16_TO_STREAM(p, stats[i].buf_size);
+        UINT16_TO_STREAM(p, stats[i].buf_count);
+        UINT16_TO_STREAM(p, stats[i].current_count);
+        UINT16_TO_STREAM(p, stats[i].peak_count);
+        UINT16_TO_STREAM(p, stats[i].failed_count);
+        UINT16_TO_STREAM(p, stats[i].recommended_count);
+    }
+
+    if (mode == BUF_POOL_REPORT_SIZING)
+    {
+        WICED_BT_TRACE("wiced_bt_cfg_buf_pools[] =\n{\n");
+        for (i = 0; i < num_pools; i++)
+        {
+            WICED_BT_TRACE("    { %d, %d },  /* peak %d of %d, %d failed */\n", stats[i].buf_size, stats[i].recommended_count,
+                    stats[i].peak_count, stats[i].buf_count, stats[i].failed_count);
+        }
+        WICED_BT_TRACE("};\n");
+    }
+
+    wiced_transport_send_data(HCI_CONTROL_MISC_EVENT_BUF_POOLS, evt, (uint16_t) (p - evt));
+    return HCI_CONTROL_STATUS_SUCCESS;
+}
@@ -0,0 +1,131 @@
+/*
+ * Copyright 2016-2020, Cypress Semiconductor Corporation or a subsidiary of
+ * Cypress Semiconductor Corporation. All Rights Reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software"), is owned by Cypress Semiconductor Corporation
+ * or one of its subsidiaries ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products. Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ */
+
+/** @file
+ *
+ * Usage of the stack buffer pools, and sizing of wiced_bt_cfg_buf_pools[]
+ *
+ * The current and peak counts come from the stack. The stack does not count
+ * the allocations that fail, so the application gets its buffers with
+ * buf_pool_stats_get_buffer(), which counts a failure against the smallest
+ * pool that fits the request. The stack falls back to the larger pools, so a
+ * failure means that the pools from that one up were all in use.
+ *
+ * HCI_CONTROL_MISC_COMMAND_READ_BUF_POOLS is answered with one
+ * HCI_CONTROL_MISC_EVENT_BUF_POOLS event. After a workload run the
+ * recommended counts can be copied to wiced_bt_cfg_buf_pools[], the sizing
+ * report mode also traces them in that syntax.
+ */
+
+#pragma once
+
+#include "wiced_bt_types.h"
+#include "wiced_bt_cfg.h"
+#include "wiced_memory.h"
+#include "hci_control_api.h"
+
+/******************************************************
+ *                     Constants
+ ******************************************************/
+
+/* Payload: report mode (BUF_POOL_REPORT_xx) */
+#ifndef HCI_CONTROL_MISC_COMMAND_READ_BUF_POOLS
+#define HCI_CONTROL_MISC_COMMAND_READ_BUF_POOLS ( ( HCI_CONTROL_GROUP_MISC << 8 ) | 0x20 )
+#endif
+
+/*
+ * Payload: report mode, number of pools, then for each pool buffer size,
+ * configured count, current count, peak count, failed allocations and
+ * recommended count (uint16 each)
+ */
+#ifndef HCI_CONTROL_MISC_EVENT_BUF_POOLS
+#define HCI_CONTROL_MISC_EVENT_BUF_POOLS        ( ( HCI_CONTROL_GROUP_MISC << 8 ) | 0x21 )
+#endif
+
+#define BUF_POOL_REPORT_USAGE                   0
+#define BUF_POOL_REPORT_SIZING                  1   /* traces the recommended wiced_bt_cfg_buf_pools[] */
+
+#ifndef BUF_POOL_STATS_MAX_POOLS
+#define BUF_POOL_STATS_MAX_POOLS                WICED_BT_CFG_NUM_BUF_POOLS
+#endif
+
+/* Buffers recommended above the peak of a pool, in percent of the peak */
+#ifndef BUF_POOL_STATS_HEADROOM_PCT
+#define BUF_POOL_STATS_HEADROOM_PCT             25
+#endif
+
+/******************************************************
+ *                 Type Definitions
+ ******************************************************/
+
+typedef struct
+{
+    uint16_t    buf_size;
+    uint16_t    buf_count;          /* configured */
+    uint16_t    current_count;
+    uint16_t    peak_count;
+    uint16_t    failed_count;
+    uint16_t    recommended_count;
+} buf_pool_stats_t;
+
+/******************************************************
+ *               Function Declarations
+ ******************************************************/
+
+/**
+ * Start counting for the pools given to wiced_bt_stack_init().
+ */
+void buf_pool_stats_init(const wiced_bt_cfg_buf_pool_t *p_pools);
+
+/**
+ * wiced_bt_get_buffer() that counts the failures.
+ */
+void *buf_pool_stats_get_buffer(uint16_t size);
+
+/**
+ * Read the usage of the pools.
+ *
+ * @return  the number of pools filled in
+ */
+uint8_t buf_pool_stats_read(buf_pool_stats_t *p_stats, uint8_t max_pools);
+
+/**
+ * Count to configure for a pool, from its peak and failures.
+ */
+uint16_t buf_pool_stats_recommend(const buf_pool_stats_t *p_stats);
+
+/**
+ * HCI_CONTROL_MISC_COMMAND_READ_BUF_POOLS handler, for the command table of
+ * the application.
+ */
+uint8_t buf_pool_stats_cmd_read(uint16_t opcode, uint8_t *p_data, uint32_t data_len);
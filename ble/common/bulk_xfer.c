@@ -0,0 +1,475 @@
+/*
+ * Copyright 2016-2020, Cypress Semiconductor Corporation or a subsidiary of
+ * Cypress Semiconductor Corporation. All Rights Reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software"), is owned by Cypress Semiconductor Corporation
+ * or one of its subsidiaries ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products. Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ */
+
+
+/** @file
+ *
+ * Bulk transfer over a connection oriented channel
+ */
+
+#include <string.h>
+#include "wiced_bt_trace.h"
+#include "bulk_xfer.h"
+
+/******************************************************
+ *                      Constants
+ ******************************************************/
+
+#define BULK_XFER_STATE_IDLE            0
+#define BULK_XFER_STATE_STARTING        1       /* sender, START sent */
+#define BULK_XFER_STATE_SENDING         2
+#define BULK_XFER_STATE_RECEIVING       3
+
+#define BULK_XFER_PENDING_NONE          0xFF
+
+/* Longest control frame, START */
+#define BULK_XFER_CTRL_MAX_LEN          ( BULK_XFER_HDR_LEN + 11 )
+
+/******************************************************
+ *               Variables Definitions
+ ******************************************************/
+
+/* CRC-16/CCITT-FALSE, a nibble at a time */
+static const uint16_t bulk_xfer_crc_table[16] =
+{
+    0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
+    0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF,
+};
+
+/******************************************************
+ *               Function Definitions
+ ******************************************************/
+
+uint16_t bulk_xfer_crc16(const uint8_t *p_data, uint16_t len)
+{
+    uint16_t crc = 0xFFFF;
+
+    while (len--)
+    {
+        crc = (uint16_t)(crc << 4) ^ bulk_xfer_crc_table[(crc >> 12) ^ (*p_data >> 4)];
+        crc = (uint16_t)(crc << 4) ^ bulk_xfer_crc_table[(crc >> 12) ^ (*p_data & 0x0F)];
+        p_data++;
+    }
+    return crc;
+}
+
+static uint8_t *bulk_xfer_build_hdr(uint8_t *p, uint8_t type)
+{
+    UINT16_TO_STREAM(p, BULK_XFER_MAGIC);
+    UINT8_TO_STREAM(p, type);
+    return p;
+}
+
+/*
+ * Send a control frame, built from the state of the transfer when it is
+ * sent. A frame the channel has no room for is kept, a later one replaces
+ * it: the acknowledgments are cumulative.
+ */
+static wiced_bool_t bulk_xfer_send_ctrl(bulk_xfer_t *p_xfer, uint8_t type, uint8_t status)
+{
+    uint8_t frame[BULK_XFER_CTRL_MAX_LEN];
+    uint8_t *p = bulk_xfer_build_hdr(frame, type);
+
+    switch (type)
+    {
+    case BULK_XFER_TYPE_START:
+        UINT32_TO_STREAM(p, p_xfer->xfer_id);
+        UINT32_TO_STREAM(p, p_xfer->length);
+        UINT16_TO_STREAM(p, p_xfer->chunk_len);
+        UINT8_TO_STREAM(p, p_xfer->window);
+        break;
+
+    case BULK_XFER_TYPE_START_ACK:
+        /* A refusal leaves the transfer running on the context, if any, alone */
+        UINT8_TO_STREAM(p, status);
+        UINT32_TO_STREAM(p, (status == BULK_XFER_STATUS_OK) ? p_xfer->next_offset : 0);
+        UINT8_TO_STREAM(p, (status == BULK_XFER_STATUS_OK) ? p_xfer->window : 0);
+        break;
+
+    case BULK_XFER_TYPE_ACK:
+        UINT8_TO_STREAM(p, status);
+        UINT32_TO_STREAM(p, p_xfer->next_offset);
+        break;
+
+    default:
+        UINT8_TO_STREAM(p, status);
+        break;
+    }
+
+    if (p_xfer->p_send(p_xfer->p_send_context, frame, (uint16_t)(p - frame)))
+    {
+        p_xfer->pending = BULK_XFER_PENDING_NONE;
+        return WICED_TRUE;
+    }
+
+    p_xfer->pending        = type;
+    p_xfer->pending_status = status;
+    return WICED_FALSE;
+}
+
+/* The transfer is over, the callbacks may start the next one */
+static void bulk_xfer_end(bulk_xfer_t *p_xfer, uint8_t status)
+{
+    uint8_t state = p_xfer->state;
+
+    WICED_BT_TRACE("[%s] id 0x%x status %d\n", __func__, p_xfer->xfer_id, status);
+
+    p_xfer->state = BULK_XFER_STATE_IDLE;
+
+    if (state == BULK_XFER_STATE_RECEIVING)
+        p_xfer->p_sink->p_close(p_xfer->p_sink_context, status, p_xfer->next_offset);
+    else if (state != BULK_XFER_STATE_IDLE)
+        p_xfer->p_source->p_done(p_xfer->p_source_context, status, p_xfer->acked_offset);
+}
+
+/* Keep up to a window of chunks in flight, as long as the channel takes them */
+static void bulk_xfer_pump(bulk_xfer_t *p_xfer)
+{
+    uint8_t  *p;
+    uint16_t len;
+
+    while ((p_xfer->state == BULK_XFER_STATE_SENDING) && (p_xfer->pending == BULK_XFER_PENDING_NONE) &&
+           (p_xfer->next_offset < p_xfer->length) &&
+           (p_xfer->next_offset - p_xfer->acked_offset < (uint32_t)p_xfer->window * p_xfer->chunk_len))
+    {
+        len = p_xfer->chunk_len;
+        if (p_xfer->length - p_xfer->next_offset < len)
+            len = (uint16_t)(p_xfer->length - p_xfer->next_offset);
+
+        if (!p_xfer->p_source->p_read(p_xfer->p_source_context, p_xfer->next_offset,
+                                      &p_xfer->frame[BULK_XFER_DATA_HDR_LEN], len))
+        {
+            bulk_xfer_abort(p_xfer, BULK_XFER_STATUS_SOURCE_ERROR);
+            return;
+        }
+
+        p = bulk_xfer_build_hdr(p_xfer->frame, BULK_XFER_TYPE_DATA);
+        UINT32_TO_STREAM(p, p_xfer->next_offset);
+        UINT16_TO_STREAM(p, bulk_xfer_crc16(&p_xfer->frame[BULK_XFER_DATA_HDR_LEN], len));
+
+        /* Read again when the channel has room, the source may be a flash */
+        if (!p_xfer->p_send(p_xfer->p_send_context, p_xfer->frame, BULK_XFER_DATA_HDR_LEN + len))
+            break;
+
+        p_xfer->next_offset += len;
+    }
+}
+
+void bulk_xfer_init(bulk_xfer_t *p_xfer, bulk_xfer_send_t *p_send, void *p_send_context,
+                    const bulk_xfer_sink_t *p_sink, void *p_sink_context)
+{
+    memset(p_xfer, 0, sizeof(*p_xfer));
+    p_xfer->p_send         = p_send;
+    p_xfer->p_send_context = p_send_context;
+    p_xfer->p_sink         = p_sink;
+    p_xfer->p_sink_context = p_sink_context;
+    p_xfer->state          = BULK_XFER_STATE_IDLE;
+    p_xfer->pending        = BULK_XFER_PENDING_NONE;
+}
+
+wiced_bool_t bulk_xfer_send(bulk_xfer_t *p_xfer, const bulk_xfer_source_t *p_source, void *p_source_context,
+                            uint32_t xfer_id, uint32_t length, uint16_t chunk_len, uint8_t window)
+{
+    if ((p_xfer->state != BULK_XFER_STATE_IDLE) || (chunk_len == 0) || (window == 0))
+        return WICED_FALSE;
+
+    p_xfer->p_source         = p_source;
+    p_xfer->p_source_context = p_source_context;
+    p_xfer->xfer_id          = xfer_id;
+    p_xfer->length           = length;
+    p_xfer->chunk_len        = (chunk_len > BULK_XFER_MAX_CHUNK_LEN) ? BULK_XFER_MAX_CHUNK_LEN : chunk_len;
+    p_xfer->window           = (window > BULK_XFER_MAX_WINDOW) ? BULK_XFER_MAX_WINDOW : window;
+    p_xfer->next_offset      = 0;
+    p_xfer->acked_offset     = 0;
+    p_xfer->state            = BULK_XFER_STATE_STARTING;
+
+    bulk_xfer_send_ctrl(p_xfer, BULK_XFER_TYPE_START, BULK_XFER_STATUS_OK);
+    return WICED_TRUE;
+}
+
+/* Receiver, the peer starts a transfer */
+static void bulk_xfer_rx_start(bulk_xfer_t *p_xfer, uint8_t *p, uint16_t len)
+{
+    uint32_t xfer_id, length, offset;
+    uint16_t chunk_len;
+    uint8_t  window;
+
+    if (len < 11)
+    {
+        bulk_xfer_send_ctrl(p_xfer, BULK_XFER_TYPE_ABORT, BULK_XFER_STATUS_PROTOCOL);
+        return;
+    }
+    STREAM_TO_UINT32(xfer_id, p);
+    STREAM_TO_UINT32(length, p);
+    STREAM_TO_UINT16(chunk_len, p);
+    STREAM_TO_UINT8(window, p);
+
+    /* A sender starting again gave up the previous transfer */
+    if (p_xfer->state == BULK_XFER_STATE_RECEIVING)
+        bulk_xfer_end(p_xfer, BULK_XFER_STATUS_ABORTED);
+
+    if ((p_xfer->state != BULK_XFER_STATE_IDLE) || (p_xfer->p_sink == NULL) || (chunk_len == 0) ||
+        (chunk_len > BULK_XFER_MAX_CHUNK_LEN) || (window == 0))
+    {
+        bulk_xfer_send_ctrl(p_xfer, BULK_XFER_TYPE_START_ACK, BULK_XFER_STATUS_REFUSED);
+        return;
+    }
+
+    offset = p_xfer->p_sink->p_open(p_xfer->p_sink_context, xfer_id, length);
+    if ((offset == BULK_XFER_OFFSET_REFUSED) || (offset > length))
+    {
+        bulk_xfer_send_ctrl(p_xfer, BULK_XFER_TYPE_START_ACK, BULK_XFER_STATUS_REFUSED);
+        return;
+    }
+
+    p_xfer->xfer_id      = xfer_id;
+    p_xfer->length       = length;
+    p_xfer->chunk_len    = chunk_len;
+    p_xfer->window       = (window > BULK_XFER_MAX_WINDOW) ? BULK_XFER_MAX_WINDOW : window;
+    p_xfer->next_offset  = offset;
+    p_xfer->unacked      = 0;
+    p_xfer->resend_asked = WICED_FALSE;
+    p_xfer->state        = BULK_XFER_STATE_RECEIVING;
+
+    WICED_BT_TRACE("[%s] id 0x%x length %d from %d\n", __func__, xfer_id, length, offset);
+
+    bulk_xfer_send_ctrl(p_xfer, BULK_XFER_TYPE_START_ACK, BULK_XFER_STATUS_OK);
+
+    /* The sink already has all of it */
+    if (offset == length)
+        bulk_xfer_end(p_xfer, BULK_XFER_STATUS_OK);
+}
+
+/* Receiver, a chunk of data */
+static void bulk_xfer_rx_data(bulk_xfer_t *p_xfer, uint8_t *p, uint16_t len)
+{
+    uint32_t offset;
+    uint16_t crc;
+    uint8_t  ack_every;
+
+    /* Data still in flight when the transfer ended */
+    if ((p_xfer->state != BULK_XFER_STATE_RECEIVING) || (len < 6))
+        return;
+
+    STREAM_TO_UINT32(offset, p);
+    STREAM_TO_UINT16(crc, p);
+    len -= 6;
+
+    /* Chunks sent again after a RESEND, already written */
+    if (offset < p_xfer->next_offset)
+        return;
+
+    if ((offset != p_xfer->next_offset) || (len == 0) || (len > p_xfer->chunk_len) ||
+        (len > p_xfer->length - offset) || (bulk_xfer_crc16(p, len) != crc))
+    {
+        /* Once per gap, the chunks following the bad one are dropped until it comes again */
+        if (!p_xfer->resend_asked)
+        {
+            WICED_BT_TRACE("[%s] resend from %d, got %d\n", __func__, p_xfer->next_offset, offset);
+            p_xfer->resend_asked = WICED_TRUE;
+            p_xfer->unacked      = 0;
+            bulk_xfer_send_ctrl(p_xfer, BULK_XFER_TYPE_ACK, BULK_XFER_STATUS_RESEND);
+        }
+        return;
+    }
+
+    if (!p_xfer->p_sink->p_write(p_xfer->p_sink_context, offset, p, len))
+    {
+        bulk_xfer_abort(p_xfer, BULK_XFER_STATUS_SINK_ERROR);
+        return;
+    }
+
+    p_xfer->next_offset += len;
+    p_xfer->resend_asked = WICED_FALSE;
+    p_xfer->unacked++;
+
+    if (p_xfer->next_offset == p_xfer->length)
+    {
+        bulk_xfer_send_ctrl(p_xfer, BULK_XFER_TYPE_ACK, BULK_XFER_STATUS_OK);
+        bulk_xfer_end(p_xfer, BULK_XFER_STATUS_OK);
+        return;
+    }
+
+    /* Every half window, so that the sender never waits for the window to open */
+    ack_every = (p_xfer->window > 1) ? (p_xfer->window / 2) : 1;
+    if (p_xfer->unacked >= ack_every)
+    {
+        p_xfer->unacked = 0;
+        bulk_xfer_send_ctrl(p_xfer, BULK_XFER_TYPE_ACK, BULK_XFER_STATUS_OK);
+    }
+}
+
+/* Sender, the answer to START */
+static void bulk_xfer_rx_start_ack(bulk_xfer_t *p_xfer, uint8_t *p, uint16_t len)
+{
+    uint32_t offset;
+    uint8_t  status, window;
+
+    if (p_xfer->state != BULK_XFER_STATE_STARTING)
+        return;
+
+    if (len < 6)
+    {
+        bulk_xfer_abort(p_xfer, BULK_XFER_STATUS_PROTOCOL);
+        return;
+    }
+    STREAM_TO_UINT8(status, p);
+    STREAM_TO_UINT32(offset, p);
+    STREAM_TO_UINT8(window, p);
+
+    if (status != BULK_XFER_STATUS_OK)
+    {
+        bulk_xfer_end(p_xfer, BULK_XFER_STATUS_REFUSED);
+        return;
+    }
+    if ((offset > p_xfer->length) || (window == 0))
+    {
+        bulk_xfer_abort(p_xfer, BULK_XFER_STATUS_PROTOCOL);
+        return;
+    }
+
+    p_xfer->next_offset  = offset;
+    p_xfer->acked_offset = offset;
+    if (window < p_xfer->window)
+        p_xfer->window = window;
+    p_xfer->state = BULK_XFER_STATE_SENDING;
+
+    if (offset == p_xfer->length)
+        bulk_xfer_end(p_xfer, BULK_XFER_STATUS_OK);
+    else
+        bulk_xfer_pump(p_xfer);
+}
+
+/* Sender, an acknowledgment */
+static void bulk_xfer_rx_ack(bulk_xfer_t *p_xfer, uint8_t *p, uint16_t len)
+{
+    uint32_t offset;
+    uint8_t  status;
+
+    if ((p_xfer->state != BULK_XFER_STATE_SENDING) || (len < 5))
+        return;
+
+    STREAM_TO_UINT8(status, p);
+    STREAM_TO_UINT32(offset, p);
+
+    /* An acknowledgment overtaken by a later one */
+    if (offset < p_xfer->acked_offset)
+        return;
+    if (offset > p_xfer->next_offset)
+    {
+        bulk_xfer_abort(p_xfer, BULK_XFER_STATUS_PROTOCOL);
+        return;
+    }
+
+    p_xfer->acked_offset = offset;
+    if (status == BULK_XFER_STATUS_RESEND)
+        p_xfer->next_offset = offset;
+
+    if (p_xfer->acked_offset == p_xfer->length)
+        bulk_xfer_end(p_xfer, BULK_XFER_STATUS_OK);
+    else
+        bulk_xfer_pump(p_xfer);
+}
+
+wiced_bool_t bulk_xfer_rx(bulk_xfer_t *p_xfer, uint8_t *p_data, uint16_t len)
+{
+    uint16_t magic;
+    uint8_t  type, status;
+
+    if (len < BULK_XFER_HDR_LEN)
+        return WICED_FALSE;
+
+    STREAM_TO_UINT16(magic, p_data);
+    STREAM_TO_UINT8(type, p_data);
+    if (magic != BULK_XFER_MAGIC)
+        return WICED_FALSE;
+    len -= BULK_XFER_HDR_LEN;
+
+    switch (type)
+    {
+    case BULK_XFER_TYPE_START:
+        bulk_xfer_rx_start(p_xfer, p_data, len);
+        break;
+
+    case BULK_XFER_TYPE_START_ACK:
+        bulk_xfer_rx_start_ack(p_xfer, p_data, len);
+        break;
+
+    case BULK_XFER_TYPE_DATA:
+        bulk_xfer_rx_data(p_xfer, p_data, len);
+        break;
+
+    case BULK_XFER_TYPE_ACK:
+        bulk_xfer_rx_ack(p_xfer, p_data, len);
+        break;
+
+    case BULK_XFER_TYPE_ABORT:
+        status = BULK_XFER_STATUS_ABORTED;
+        if (len >= 1)
+            STREAM_TO_UINT8(status, p_data);
+        WICED_BT_TRACE("[%s] aborted by the peer, status %d\n", __func__, status);
+        bulk_xfer_end(p_xfer, status);
+        break;
+
+    default:
+        break;
+    }
+    return WICED_TRUE;
+}
+
+void bulk_xfer_tx_ready(bulk_xfer_t *p_xfer)
+{
+    if ((p_xfer->pending != BULK_XFER_PENDING_NONE) &&
+        !bulk_xfer_send_ctrl(p_xfer, p_xfer->pending, p_xfer->pending_status))
+        return;
+
+    bulk_xfer_pump(p_xfer);
+}
+
+void bulk_xfer_abort(bulk_xfer_t *p_xfer, uint8_t status)
+{
+    if (p_xfer->state == BULK_XFER_STATE_IDLE)
+        return;
+
+    if (status == BULK_XFER_STATUS_CHANNEL)
+        p_xfer->pending = BULK_XFER_PENDING_NONE;
+    else
+        bulk_xfer_send_ctrl(p_xfer, BULK_XFER_TYPE_ABORT, status);
+
+    bulk_xfer_end(p_xfer, status);
+}
+
+wiced_bool_t bulk_xfer_active(bulk_xfer_t *p_xfer)
+{
+    return p_xfer->state != BULK_XFER_STATE_IDLE;
+}
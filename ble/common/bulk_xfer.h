@@ -0,0 +1,208 @@
+/*
+ * Copyright 2016-2020, Cypress Semiconductor Corporation or a subsidiary of
+ * Cypress Semiconductor Corporation. All Rights Reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software"), is owned by Cypress Semiconductor Corporation
+ * or one of its subsidiaries ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products. Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ */
+
+
+/** @file
+ *
+ * Bulk transfer over a connection oriented channel
+ *
+ * Frames the data of a firmware image, a log or any other large object on
+ * a channel that moves whole SDUs, an LE COC channel typically:
+ *  - the sender opens a transfer with its id and length, the receiver
+ *    answers with the offset to start from, so a transfer interrupted by a
+ *    disconnection resumes where the sink stopped instead of restarting;
+ *  - the data follows in chunks carrying their offset and a CRC-16, up to
+ *    a window of chunks ahead of the last acknowledgment;
+ *  - the receiver acknowledges cumulatively every half window and at the
+ *    end, and asks for the data again from the first chunk it could not
+ *    take (go back N).
+ * The channel delivers the SDUs reliably and in order, chunks are only
+ * asked again after a CRC error or a gap left by the forwarding path, so
+ * there are no retransmission timers.
+ *
+ * The data is read from a source on the sender and written to a sink on
+ * the receiver, both streaming: a sink writing to flash or forwarding to
+ * the HCI UART never holds more than a chunk. The module knows nothing
+ * about the channel, the application gives it a function sending a frame.
+ *
+ * Frame: magic (2), type (1), then
+ *  BULK_XFER_TYPE_START      id (4), length (4), chunk length (2), window (1)
+ *  BULK_XFER_TYPE_START_ACK  status (1), offset (4), window (1)
+ *  BULK_XFER_TYPE_DATA       offset (4), CRC-16 of the data (2), data
+ *  BULK_XFER_TYPE_ACK        status (1), offset (4), the next offset expected
+ *  BULK_XFER_TYPE_ABORT      status (1)
+ */
+
+#pragma once
+
+#include "wiced_bt_types.h"
+
+/******************************************************
+ *                      Constants
+ ******************************************************/
+
+#define BULK_XFER_MAGIC                 0x5842      /* "BX" */
+
+#define BULK_XFER_TYPE_START            0
+#define BULK_XFER_TYPE_START_ACK        1
+#define BULK_XFER_TYPE_DATA             2
+#define BULK_XFER_TYPE_ACK              3
+#define BULK_XFER_TYPE_ABORT            4
+
+#define BULK_XFER_HDR_LEN               3
+#define BULK_XFER_DATA_HDR_LEN          ( BULK_XFER_HDR_LEN + 6 )
+
+/* Largest chunk, the frames of a chunk have to fit the SDUs of the channel */
+#ifndef BULK_XFER_MAX_CHUNK_LEN
+#define BULK_XFER_MAX_CHUNK_LEN         ( 512 - BULK_XFER_DATA_HDR_LEN )
+#endif
+
+/* Chunks sent ahead of the last acknowledgment */
+#ifndef BULK_XFER_MAX_WINDOW
+#define BULK_XFER_MAX_WINDOW            8
+#endif
+
+/* Status of the acknowledgments, aborts and completion callbacks */
+#define BULK_XFER_STATUS_OK             0
+#define BULK_XFER_STATUS_RESEND         1       /* ACK: send again from the offset */
+#define BULK_XFER_STATUS_REFUSED        2       /* the sink does not take the transfer */
+#define BULK_XFER_STATUS_SINK_ERROR     3       /* the sink could not write the data */
+#define BULK_XFER_STATUS_SOURCE_ERROR   4       /* the source could not read the data */
+#define BULK_XFER_STATUS_PROTOCOL       5       /* unexpected frame */
+#define BULK_XFER_STATUS_ABORTED        6       /* by the application */
+#define BULK_XFER_STATUS_CHANNEL        7       /* the channel closed */
+
+/* Returned by the open function of a sink refusing the transfer */
+#define BULK_XFER_OFFSET_REFUSED        0xFFFFFFFF
+
+/******************************************************
+ *                 Type Definitions
+ ******************************************************/
+
+/* Receiver side, the data written in order */
+typedef struct
+{
+    /* A transfer starts: the offset to resume from, 0 for a new one, or BULK_XFER_OFFSET_REFUSED */
+    uint32_t     (*p_open)(void *p_context, uint32_t xfer_id, uint32_t length);
+    /* WICED_FALSE aborts the transfer with BULK_XFER_STATUS_SINK_ERROR */
+    wiced_bool_t (*p_write)(void *p_context, uint32_t offset, const uint8_t *p_data, uint16_t len);
+    /* The transfer ends, complete if the status is BULK_XFER_STATUS_OK */
+    void         (*p_close)(void *p_context, uint8_t status, uint32_t offset);
+} bulk_xfer_sink_t;
+
+/* Sender side, the data read by offset, the same chunk again after a RESEND */
+typedef struct
+{
+    /* WICED_FALSE aborts the transfer with BULK_XFER_STATUS_SOURCE_ERROR */
+    wiced_bool_t (*p_read)(void *p_context, uint32_t offset, uint8_t *p_buf, uint16_t len);
+    /* The transfer ends, offset is what the receiver acknowledged */
+    void         (*p_done)(void *p_context, uint8_t status, uint32_t offset);
+} bulk_xfer_source_t;
+
+/*
+ * Send a frame on the channel. WICED_FALSE if the channel has no room for
+ * it right now, the frame is sent again on bulk_xfer_tx_ready.
+ */
+typedef wiced_bool_t (bulk_xfer_send_t)(void *p_context, uint8_t *p_frame, uint16_t len);
+
+typedef struct
+{
+    bulk_xfer_send_t         *p_send;
+    void                     *p_send_context;
+    const bulk_xfer_sink_t   *p_sink;           /* NULL if the transfers are not received */
+    void                     *p_sink_context;
+    const bulk_xfer_source_t *p_source;
+    void                     *p_source_context;
+
+    uint8_t                   state;            /* BULK_XFER_STATE_ in bulk_xfer.c */
+    uint8_t                   pending;          /* control frame waiting for room on the channel */
+    uint8_t                   pending_status;
+    uint8_t                   window;           /* chunks */
+    uint8_t                   unacked;          /* receiver: chunks since the last ACK */
+    wiced_bool_t              resend_asked;     /* receiver: RESEND sent for next_offset */
+    uint16_t                  chunk_len;
+    uint32_t                  xfer_id;
+    uint32_t                  length;
+    uint32_t                  next_offset;      /* sender: next chunk to send, receiver: next chunk expected */
+    uint32_t                  acked_offset;     /* sender: acknowledged by the receiver */
+
+    uint8_t                   frame[BULK_XFER_DATA_HDR_LEN + BULK_XFER_MAX_CHUNK_LEN];
+} bulk_xfer_t;
+
+/******************************************************
+ *               Function Declarations
+ ******************************************************/
+
+/**
+ * Initialize a transfer context of a channel. p_sink handles the transfers
+ * the peer starts, NULL to refuse them.
+ */
+void bulk_xfer_init(bulk_xfer_t *p_xfer, bulk_xfer_send_t *p_send, void *p_send_context,
+                    const bulk_xfer_sink_t *p_sink, void *p_sink_context);
+
+/**
+ * Start sending length bytes read from p_source. chunk_len is capped to
+ * BULK_XFER_MAX_CHUNK_LEN and window to BULK_XFER_MAX_WINDOW.
+ *
+ * @return  WICED_FALSE if a transfer is already running on the context
+ */
+wiced_bool_t bulk_xfer_send(bulk_xfer_t *p_xfer, const bulk_xfer_source_t *p_source, void *p_source_context,
+                            uint32_t xfer_id, uint32_t length, uint16_t chunk_len, uint8_t window);
+
+/**
+ * Handle an SDU received on the channel.
+ *
+ * @return  WICED_TRUE if it was a transfer frame, consumed
+ */
+wiced_bool_t bulk_xfer_rx(bulk_xfer_t *p_xfer, uint8_t *p_data, uint16_t len);
+
+/**
+ * Send what waits for room, to call when the channel can take more SDUs.
+ */
+void bulk_xfer_tx_ready(bulk_xfer_t *p_xfer);
+
+/**
+ * Abort the running transfer, telling the peer unless the channel closed
+ * (BULK_XFER_STATUS_CHANNEL).
+ */
+void bulk_xfer_abort(bulk_xfer_t *p_xfer, uint8_t status);
+
+/**
+ * Tell whether a transfer is running on the context.
+ */
+wiced_bool_t bulk_xfer_active(bulk_xfer_t *p_xfer);
+
+/**
+ * CRC-16/CCITT-FALSE of the data chunks.
+ */
+uint16_t bulk_xfer_crc16(const uint8_t *p_data, uint16_t len);
@@ -0,0 +1,299 @@
+/*
+ * Copyright 2016-2020, Cypress Semiconductor Corporation or a subsidiary of
+ * Cypress Semiconductor Corporation. All Rights Reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software"), is owned by Cypress Semiconductor Corporation
+ * or one of its subsidiaries ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products. Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ */
+
+/** @file
+ *
+ * PHY and connection parameter policy of a peripheral link
+ */
+
+#include <string.h>
+#include "wiced_bt_trace.h"
+#include "wiced_bt_ble.h"
+#include "wiced_bt_l2c.h"
+#include "power_mgr.h"
+#include "conn_policy.h"
+
+/******************************************************
+ *                      Constants
+ ******************************************************/
+
+#define CONN_POLICY_EVENT_BYTES         40      /* two notifications of the default MTU per event */
+#define CONN_POLICY_INTERVAL_MIN        6       /* 7.5 ms */
+#define CONN_POLICY_INTERVAL_MAX        3200    /* 4 s */
+#define CONN_POLICY_LATENCY_MAX         499
+#define CONN_POLICY_TIMEOUT_MIN         10      /* 100 ms */
+#define CONN_POLICY_TIMEOUT_MAX         3200    /* 32 s */
+#define CONN_POLICY_TIMEOUT_MARGIN      3       /* latency periods missed before a disconnection */
+
+/******************************************************
+ *               Variables Definitions
+ ******************************************************/
+
+static conn_policy_t    *conn_policy_links[CONN_POLICY_MAX_LINKS];
+static uint8_t           conn_policy_next_link;
+static power_mgr_tick_t  conn_policy_tick;
+static wiced_bool_t      conn_policy_tick_on;
+
+static const uint8_t     conn_policy_phys[] = { BTM_BLE_PREFER_1M_PHY, BTM_BLE_PREFER_2M_PHY, BTM_BLE_PREFER_LELR_PHY };
+
+/******************************************************
+ *               Function Definitions
+ ******************************************************/
+
+/* Connection parameters of a configuration, in the units of the L2CAP request */
+static void conn_policy_compute(const conn_policy_cfg_t *p_cfg, uint16_t *p_interval, uint16_t *p_latency, uint16_t *p_timeout)
+{
+    uint32_t interval_ms = p_cfg->max_delay_ms;
+    uint32_t interval, latency, timeout, latency_max;
+
+    if ((p_cfg->bytes_per_s != 0) && ((CONN_POLICY_EVENT_BYTES * 1000) / p_cfg->bytes_per_s < interval_ms))
+        interval_ms = (CONN_POLICY_EVENT_BYTES * 1000) / p_cfg->bytes_per_s;
+
+    interval = (interval_ms * 4) / 5;
+    if (interval < CONN_POLICY_INTERVAL_MIN)
+        interval = CONN_POLICY_INTERVAL_MIN;
+    if (interval > CONN_POLICY_INTERVAL_MAX)
+        interval = CONN_POLICY_INTERVAL_MAX;
+    interval_ms = (interval * 5) / 4;
+
+    /* Sleep through the events up to max_idle_ms, as long as the timeout can cover it */
+    latency     = (p_cfg->max_idle_ms > interval_ms) ? (p_cfg->max_idle_ms / interval_ms) - 1 : 0;
+    latency_max = (CONN_POLICY_TIMEOUT_MAX * 10) / (CONN_POLICY_TIMEOUT_MARGIN * interval_ms);
+    latency_max = (latency_max > 0) ? latency_max - 1 : 0;
+    if (latency_max > CONN_POLICY_LATENCY_MAX)
+        latency_max = CONN_POLICY_LATENCY_MAX;
+    if (latency > latency_max)
+        latency = latency_max;
+
+    timeout = ((latency + 1) * interval_ms * CONN_POLICY_TIMEOUT_MARGIN) / 10;
+    if (timeout < CONN_POLICY_TIMEOUT_MIN)
+        timeout = CONN_POLICY_TIMEOUT_MIN;
+    if (timeout > CONN_POLICY_TIMEOUT_MAX)
+        timeout = CONN_POLICY_TIMEOUT_MAX;
+
+    *p_interval = (uint16_t)interval;
+    *p_latency  = (uint16_t)latency;
+    *p_timeout  = (uint16_t)timeout;
+}
+
+static void conn_policy_update_conn_params(conn_policy_t *p_policy)
+{
+    uint16_t interval, latency, timeout;
+
+    conn_policy_compute(&p_policy->cfg, &interval, &latency, &timeout);
+    if ((interval == p_policy->interval) && (latency == p_policy->latency) && (timeout == p_policy->timeout))
+        return;
+
+    WICED_BT_TRACE("conn_policy %B interval %d latency %d timeout %d\n", p_policy->bd_addr, interval, latency, timeout);
+
+    if (!wiced_bt_l2cap_update_ble_conn_params(p_policy->bd_addr, interval, interval, latency, timeout))
+        WICED_BT_TRACE("conn_policy: conn params update failed\n");
+
+    p_policy->interval = interval;
+    p_policy->latency  = latency;
+    p_policy->timeout  = timeout;
+}
+
+/* PHY for the smoothed RSSI, the current PHY is kept within the hysteresis */
+static uint8_t conn_policy_pick_phy(conn_policy_t *p_policy)
+{
+    int16_t rssi_2m    = CONN_POLICY_RSSI_2M -
+                         ((p_policy->phy == CONN_POLICY_PHY_2M) ? CONN_POLICY_RSSI_HYSTERESIS : 0);
+    int16_t rssi_coded = CONN_POLICY_RSSI_CODED +
+                         ((p_policy->phy == CONN_POLICY_PHY_CODED) ? CONN_POLICY_RSSI_HYSTERESIS : 0);
+
+    if (p_policy->rssi >= rssi_2m)
+        return CONN_POLICY_PHY_2M;
+    if (p_policy->cfg.allow_coded && (p_policy->rssi < rssi_coded))
+        return CONN_POLICY_PHY_CODED;
+    return CONN_POLICY_PHY_1M;
+}
+
+static void conn_policy_update_phy(conn_policy_t *p_policy)
+{
+    wiced_bt_ble_phy_preferences_t phy_preferences;
+    uint8_t                        phy = conn_policy_pick_phy(p_policy);
+
+    if (phy == p_policy->phy)
+        return;
+
+    WICED_BT_TRACE("conn_policy %B rssi %d PHY %s\n", p_policy->bd_addr, p_policy->rssi, conn_policy_phy_name(phy));
+
+    memcpy(phy_preferences.remote_bd_addr, p_policy->bd_addr, BD_ADDR_LEN);
+    phy_preferences.rx_phys = phy_preferences.tx_phys = conn_policy_phys[phy];
+#if defined(CYW20721B2) || defined(CYW20719B2)
+    phy_preferences.phy_opts = (phy == CONN_POLICY_PHY_CODED) ? BTM_BLE_PREFER_LELR_125K : BTM_BLE_PREFER_NO_LELR;
+#else
+    phy_preferences.phy_opts = (phy == CONN_POLICY_PHY_CODED) ? BTM_BLE_PREFER_CODED_PHY_S8 : BTM_BLE_PREFER_CODED_PHY_NONE;
+#endif
+    if (wiced_bt_ble_set_phy(&phy_preferences) != WICED_BT_SUCCESS)
+        WICED_BT_TRACE("conn_policy: set PHY failed\n");
+
+    p_policy->phy = phy;
+}
+
+static void conn_policy_rssi_cback(void *p_data)
+{
+    wiced_bt_dev_rssi_result_t *p_result = (wiced_bt_dev_rssi_result_t *)p_data;
+    int                         i;
+
+    if (p_result->status != WICED_BT_SUCCESS)
+        return;
+
+    for (i = 0; i < CONN_POLICY_MAX_LINKS; i++)
+    {
+        if ((conn_policy_links[i] != NULL) &&
+            (memcmp(conn_policy_links[i]->bd_addr, p_result->rem_bda, BD_ADDR_LEN) == 0))
+        {
+            conn_policy_rssi(conn_policy_links[i], p_result->rssi);
+            return;
+        }
+    }
+}
+
+static void conn_policy_read_rssi(conn_policy_t *p_policy)
+{
+    if (wiced_bt_dev_read_rssi(p_policy->bd_addr, BT_TRANSPORT_LE, conn_policy_rssi_cback) != WICED_BT_PENDING)
+        WICED_BT_TRACE("conn_policy: read RSSI failed\n");
+}
+
+/* Read the RSSI of the links in turn */
+static void conn_policy_timeout(uint32_t arg)
+{
+    int i;
+
+    for (i = 0; i < CONN_POLICY_MAX_LINKS; i++)
+    {
+        conn_policy_t *p_policy = conn_policy_links[(conn_policy_next_link + i) % CONN_POLICY_MAX_LINKS];
+
+        if (p_policy != NULL)
+        {
+            conn_policy_next_link = (conn_policy_next_link + i + 1) % CONN_POLICY_MAX_LINKS;
+            conn_policy_read_rssi(p_policy);
+            return;
+        }
+    }
+}
+
+wiced_bool_t conn_policy_start(conn_policy_t *p_policy, const conn_policy_cfg_t *p_cfg, wiced_bt_device_address_t bd_addr)
+{
+    int i;
+
+    for (i = 0; i < CONN_POLICY_MAX_LINKS; i++)
+    {
+        if (conn_policy_links[i] == NULL)
+            break;
+    }
+    if (i == CONN_POLICY_MAX_LINKS)
+        return WICED_FALSE;
+
+    memset(p_policy, 0, sizeof(*p_policy));
+    memcpy(p_policy->bd_addr, bd_addr, BD_ADDR_LEN);
+    p_policy->cfg    = *p_cfg;
+    p_policy->active = WICED_TRUE;
+    p_policy->phy    = CONN_POLICY_PHY_1M;      /* PHY of a new connection */
+    conn_policy_links[i] = p_policy;
+
+    /* On the shared tick, the reads wake the device up with the other periodic work */
+    if (!conn_policy_tick_on)
+    {
+        power_mgr_tick_start(&conn_policy_tick, conn_policy_timeout, 0, CONN_POLICY_RSSI_PERIOD_S);
+        conn_policy_tick_on = WICED_TRUE;
+    }
+
+    conn_policy_update_conn_params(p_policy);
+
+    /* The PHY is picked on the first RSSI reading */
+    conn_policy_read_rssi(p_policy);
+    return WICED_TRUE;
+}
+
+void conn_policy_stop(conn_policy_t *p_policy)
+{
+    int          i;
+    wiced_bool_t any = WICED_FALSE;
+
+    for (i = 0; i < CONN_POLICY_MAX_LINKS; i++)
+    {
+        if (conn_policy_links[i] == p_policy)
+            conn_policy_links[i] = NULL;
+        else if (conn_policy_links[i] != NULL)
+            any = WICED_TRUE;
+    }
+    p_policy->active = WICED_FALSE;
+
+    if (!any && conn_policy_tick_on)
+    {
+        power_mgr_tick_stop(&conn_policy_tick);
+        conn_policy_tick_on = WICED_FALSE;
+    }
+}
+
+void conn_policy_set_cfg(conn_policy_t *p_policy, const conn_policy_cfg_t *p_cfg)
+{
+    if (!p_policy->active)
+        return;
+
+    p_policy->cfg = *p_cfg;
+    conn_policy_update_conn_params(p_policy);
+    if (p_policy->rssi_valid)
+        conn_policy_update_phy(p_policy);
+}
+
+void conn_policy_rssi(conn_policy_t *p_policy, int8_t rssi)
+{
+    if (!p_policy->active)
+        return;
+
+    if (!p_policy->rssi_valid)
+    {
+        p_policy->rssi       = rssi;
+        p_policy->rssi_valid = WICED_TRUE;
+    }
+    else
+    {
+        p_policy->rssi = (int8_t)((3 * (int16_t)p_policy->rssi + rssi) / 4);
+    }
+    conn_policy_update_phy(p_policy);
+}
+
+const char *conn_policy_phy_name(uint8_t phy)
+{
+    switch (phy)
+    {
+    case CONN_POLICY_PHY_1M:    return "1M";
+    case CONN_POLICY_PHY_2M:    return "2M";
+    case CONN_POLICY_PHY_CODED: return "coded";
+    default:                    return "?";
+    }
+}
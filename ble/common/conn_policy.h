@@ -0,0 +1,149 @@
+/*
+ * Copyright 2016-2020, Cypress Semiconductor Corporation or a subsidiary of
+ * Cypress Semiconductor Corporation. All Rights Reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software"), is owned by Cypress Semiconductor Corporation
+ * or one of its subsidiaries ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products. Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ */
+
+/** @file
+ *
+ * PHY and connection parameter policy of a peripheral link
+ *
+ * A peripheral asking for 2M PHY and leaving the connection parameters to
+ * the central often wakes its radio far more than its data needs. The policy
+ * derives the connection parameters from what the application says about its
+ * traffic:
+ *  - the connection interval is short enough to carry bytes_per_s with a
+ *    couple of packets per connection event, and no longer than max_delay_ms
+ *    so that a notification is not held longer than that;
+ *  - the slave latency lets the peripheral sleep through the connection
+ *    events when it has nothing to send, up to max_idle_ms, which is how
+ *    long a write from the central may wait;
+ *  - the supervision timeout covers a few missed latency periods.
+ * The PHY follows the RSSI of the link, read periodically and smoothed:
+ * 2M when the signal is strong, 1M otherwise and coded when it is weak and
+ * the application allows it. Renegotiation is requested only when the
+ * inputs move the result, with a hysteresis on the RSSI thresholds.
+ *
+ * The central has the last word, the policy records what it asked for and
+ * does not insist if the central picks other values.
+ */
+
+#pragma once
+
+#include "wiced_bt_types.h"
+#include "wiced_bt_dev.h"
+
+/******************************************************
+ *                      Constants
+ ******************************************************/
+
+#ifndef CONN_POLICY_MAX_LINKS
+#define CONN_POLICY_MAX_LINKS           4       /* links followed by the policy at the same time */
+#endif
+
+#ifndef CONN_POLICY_RSSI_PERIOD_S
+#define CONN_POLICY_RSSI_PERIOD_S       10      /* RSSI read period, each link in turn */
+#endif
+
+/* RSSI thresholds of the PHY choice in dBm, a PHY is left once the RSSI
+ * crosses its threshold by CONN_POLICY_RSSI_HYSTERESIS
+ */
+#ifndef CONN_POLICY_RSSI_2M
+#define CONN_POLICY_RSSI_2M             (-65)
+#endif
+#ifndef CONN_POLICY_RSSI_CODED
+#define CONN_POLICY_RSSI_CODED          (-85)
+#endif
+#define CONN_POLICY_RSSI_HYSTERESIS     5
+
+#define CONN_POLICY_PHY_1M              0
+#define CONN_POLICY_PHY_2M              1
+#define CONN_POLICY_PHY_CODED           2
+
+/******************************************************
+ *                 Type Definitions
+ ******************************************************/
+
+/* What the application says about the traffic of a link */
+typedef struct
+{
+    uint32_t        bytes_per_s;        /* data sent to the central */
+    uint16_t        max_delay_ms;       /* longest hold of data to send */
+    uint16_t        max_idle_ms;        /* longest wait of data from the central */
+    wiced_bool_t    allow_coded;        /* coded PHY if the controller and the central support it */
+} conn_policy_cfg_t;
+
+typedef struct
+{
+    wiced_bt_device_address_t   bd_addr;
+    conn_policy_cfg_t           cfg;
+    wiced_bool_t                active;
+    wiced_bool_t                rssi_valid;
+    int8_t                      rssi;           /* smoothed, dBm */
+    uint8_t                     phy;            /* CONN_POLICY_PHY_ requested */
+    uint16_t                    interval;       /* requested, 1.25 ms */
+    uint16_t                    latency;        /* requested, connection events */
+    uint16_t                    timeout;        /* requested, 10 ms */
+} conn_policy_t;
+
+/******************************************************
+ *               Function Declarations
+ ******************************************************/
+
+/**
+ * Start following a new link, request the parameters of the configuration
+ * and start the RSSI reads. The policy structure must stay in place until
+ * conn_policy_stop.
+ *
+ * @return  WICED_FALSE if CONN_POLICY_MAX_LINKS links are already followed
+ */
+wiced_bool_t conn_policy_start(conn_policy_t *p_policy, const conn_policy_cfg_t *p_cfg, wiced_bt_device_address_t bd_addr);
+
+/**
+ * Stop following a link, typically on its disconnection.
+ */
+void conn_policy_stop(conn_policy_t *p_policy);
+
+/**
+ * Change the traffic of a link, an OTA upgrade for instance, and renegotiate
+ * if the parameters change.
+ */
+void conn_policy_set_cfg(conn_policy_t *p_policy, const conn_policy_cfg_t *p_cfg);
+
+/**
+ * Record an RSSI reading of a link obtained by the application itself and
+ * renegotiate the PHY if needed. The policy also reads it periodically.
+ */
+void conn_policy_rssi(conn_policy_t *p_policy, int8_t rssi);
+
+/**
+ * Get the name of a CONN_POLICY_PHY_ value for traces.
+ */
+const char *conn_policy_phy_name(uint8_t phy);
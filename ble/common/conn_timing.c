@@ -0,0 +1,120 @@
+/*
+ * Copyright 2016-2020, Cypress Semiconductor Corporation or a subsidiary of
+ * Cypress Semiconductor Corporation. All Rights Reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software"), is owned by Cypress Semiconductor Corporation
+ * or one of its subsidiaries ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products. Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ */
+
+
+
+/** @file
+ *
+ * Connection timing
+ */
+
+#include <string.h>
+#include "wiced_timer.h"
+#include "wiced_transport.h"
+#include "conn_timing.h"
+
+/******************************************************
+ *               Variables Definitions
+ ******************************************************/
+
+/* Connection on the way, and link up waiting for its encryption */
+static conn_timing_rec_t    conn_timing_pending;
+static conn_timing_rec_t    conn_timing_link;
+static wiced_bool_t         conn_timing_link_up;
+
+/******************************************************
+ *               Function Definitions
+ ******************************************************/
+
+static uint32_t conn_timing_since(uint64_t start_us, uint64_t now_us)
+{
+    if (start_us == 0)
+        return CONN_TIMING_NONE;
+    return (uint32_t) (now_us - start_us);
+}
+
+static void conn_timing_send(conn_timing_rec_t *p_rec, uint8_t stage, uint8_t status)
+{
+    uint8_t     event[BD_ADDR_LEN + 3 + 2 * 4];
+    uint8_t     *p = event;
+    uint64_t    now = clock_SystemTimeMicroseconds64();
+
+    BDADDR_TO_STREAM(p, p_rec->bd_addr);
+    UINT8_TO_STREAM(p, stage);
+    UINT8_TO_STREAM(p, p_rec->bonded);
+    UINT8_TO_STREAM(p, status);
+    UINT32_TO_STREAM(p, conn_timing_since(p_rec->scan_us, now));
+    UINT32_TO_STREAM(p, conn_timing_since(p_rec->connect_us, now));
+    wiced_transport_send_data(HCI_CONTROL_MISC_EVENT_CONN_TIMING, event, p - event);
+}
+
+void conn_timing_scan_start(void)
+{
+    if (conn_timing_pending.scan_us == 0)
+        conn_timing_pending.scan_us = clock_SystemTimeMicroseconds64();
+}
+
+void conn_timing_connect_start(wiced_bt_device_address_t bd_addr)
+{
+    memcpy(conn_timing_pending.bd_addr, bd_addr, BD_ADDR_LEN);
+    conn_timing_pending.connect_us = clock_SystemTimeMicroseconds64();
+}
+
+void conn_timing_connected(wiced_bt_device_address_t bd_addr, wiced_bool_t bonded)
+{
+    conn_timing_link = conn_timing_pending;
+    if (memcmp(conn_timing_link.bd_addr, bd_addr, BD_ADDR_LEN) != 0)
+    {
+        /* Not asked for, a peer connecting to us, the scan goes on */
+        memset(&conn_timing_link, 0, sizeof(conn_timing_link));
+        memcpy(conn_timing_link.bd_addr, bd_addr, BD_ADDR_LEN);
+    }
+    else
+    {
+        /* The next scan is for another peer */
+        memset(&conn_timing_pending, 0, sizeof(conn_timing_pending));
+    }
+    conn_timing_link.bonded = bonded;
+    conn_timing_link_up     = WICED_TRUE;
+
+    conn_timing_send(&conn_timing_link, CONN_TIMING_STAGE_CONNECTED, 0);
+}
+
+void conn_timing_encrypted(wiced_bt_device_address_t bd_addr, uint8_t status)
+{
+    if (!conn_timing_link_up || (memcmp(conn_timing_link.bd_addr, bd_addr, BD_ADDR_LEN) != 0))
+        return;
+
+    conn_timing_send(&conn_timing_link, CONN_TIMING_STAGE_ENCRYPTED, status);
+    conn_timing_link_up = WICED_FALSE;
+}
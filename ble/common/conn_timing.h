@@ -0,0 +1,115 @@
+/*
+ * Copyright 2016-2020, Cypress Semiconductor Corporation or a subsidiary of
+ * Cypress Semiconductor Corporation. All Rights Reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software"), is owned by Cypress Semiconductor Corporation
+ * or one of its subsidiaries ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products. Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ */
+
+
+
+/** @file
+ *
+ * Connection timing
+ *
+ * A central records when it starts looking for a peer, when it asks the
+ * stack for the connection, and sends the host one
+ * HCI_CONTROL_MISC_EVENT_CONN_TIMING event when the link is up and another
+ * one when it is encrypted. With a bonded peer the second event gives the
+ * reconnection time, keys included, without a sniffer.
+ *
+ * One connection is followed at a time, as the applications connect their
+ * peers one after the other. The time of the scan start is kept until a
+ * connection is up, the retries of connection attempts are counted in.
+ */
+
+#pragma once
+
+#include "wiced_bt_types.h"
+#include "hci_control_api.h"
+
+/******************************************************
+ *                     Constants
+ ******************************************************/
+
+/*
+ * Payload: peer BDA, CONN_TIMING_STAGE_xx, bonded, status, then uint32
+ * each: us since the scan start (CONN_TIMING_NONE without one), us since
+ * the connection request (CONN_TIMING_NONE without one).
+ */
+#ifndef HCI_CONTROL_MISC_EVENT_CONN_TIMING
+#define HCI_CONTROL_MISC_EVENT_CONN_TIMING      ( ( HCI_CONTROL_GROUP_MISC << 8 ) | 0x25 )
+#endif
+
+/* Stages of HCI_CONTROL_MISC_EVENT_CONN_TIMING */
+#define CONN_TIMING_STAGE_CONNECTED             0
+#define CONN_TIMING_STAGE_ENCRYPTED             1
+
+/* No time recorded for the step */
+#define CONN_TIMING_NONE                        0xFFFFFFFF
+
+/******************************************************
+ *                 Type Definitions
+ ******************************************************/
+
+/* A start time of 0 means the step is not followed */
+typedef struct
+{
+    uint64_t                    scan_us;
+    uint64_t                    connect_us;
+    wiced_bt_device_address_t   bd_addr;
+    wiced_bool_t                bonded;
+} conn_timing_rec_t;
+
+/******************************************************
+ *               Function Declarations
+ ******************************************************/
+
+/**
+ * The central starts looking for a peer. A scan already followed keeps its
+ * start time, the restarts of the scan around connection attempts do not
+ * count as new ones.
+ */
+void conn_timing_scan_start(void);
+
+/**
+ * The central asks the stack for a connection to the peer.
+ */
+void conn_timing_connect_start(wiced_bt_device_address_t bd_addr);
+
+/**
+ * The link to the peer is up, sends the CONN_TIMING_STAGE_CONNECTED event.
+ */
+void conn_timing_connected(wiced_bt_device_address_t bd_addr, wiced_bool_t bonded);
+
+/**
+ * The encryption of the link to the peer is done, or failed, sends the
+ * CONN_TIMING_STAGE_ENCRYPTED event. Nothing is sent for a link not
+ * followed.
+ */
+void conn_timing_encrypted(wiced_bt_device_address_t bd_addr, uint8_t status);
@@ -0,0 +1,139 @@
+/*
+ * Copyright 2016-2020, Cypress Semiconductor Corporation or a subsidiary of
+ * Cypress Semiconductor Corporation. All Rights Reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software"), is owned by Cypress Semiconductor Corporation
+ * or one of its subsidiaries ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products. Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ */
+
+/** @file
+ *
+ * Handle indexed lookup of GATT server attribute tables
+ */
+
+#include <string.h>
+#include "gatt_attr_index.h"
+#include "wiced_bt_trace.h"
+
+/******************************************************
+ *               Function Definitions
+ ******************************************************/
+static uint16_t gatt_attr_index_entry_handle(const gatt_attr_index_t *p_index, uint16_t entry)
+{
+    const uint8_t *p_entry = p_index->p_table + (entry * p_index->entry_size);
+
+    return *(const uint16_t *) p_entry;
+}
+
+void gatt_attr_index_init(gatt_attr_index_t *p_index, const void *p_table, uint16_t entry_size, uint16_t num_entries, uint8_t *p_slot, uint16_t max_slots)
+{
+    uint16_t i;
+    uint16_t handle;
+    uint16_t first = 0xFFFF;
+    uint16_t last = 0;
+
+    p_index->p_table      = (const uint8_t *) p_table;
+    p_index->entry_size   = entry_size;
+    p_index->num_entries  = num_entries;
+    p_index->p_slot       = p_slot;
+    p_index->has_outliers = WICED_FALSE;
+
+    for (i = 0; i < num_entries; i++)
+    {
+        handle = gatt_attr_index_entry_handle(p_index, i);
+        if (handle < first)
+            first = handle;
+        if (handle > last)
+            last = handle;
+    }
+
+    /* slot values are one byte */
+    if (num_entries > 0xFF)
+        max_slots = 0;
+
+    p_index->first_handle = first;
+    p_index->num_slots    = (num_entries == 0) ? 0 : GATT_ATTR_INDEX_SLOTS(first, last);
+    if (p_index->num_slots > max_slots)
+        p_index->num_slots = max_slots;
+
+    memset(p_slot, 0, p_index->num_slots);
+
+    for (i = 0; i < num_entries; i++)
+    {
+        handle = gatt_attr_index_entry_handle(p_index, i);
+        if ((uint16_t) (handle - first) < p_index->num_slots)
+            p_slot[handle - first] = (uint8_t) (i + 1);
+        else
+            p_index->has_outliers = WICED_TRUE;
+    }
+
+    WICED_BT_TRACE("[%s] %d entries, handles 0x%x-0x%x, %d slots%s\n", __func__, num_entries, first, last,
+            p_index->num_slots, p_index->has_outliers ? " + scan" : "");
+}
+
+void *gatt_attr_index_find(const gatt_attr_index_t *p_index, uint16_t handle)
+{
+    uint16_t offset = handle - p_index->first_handle;
+    uint16_t i;
+
+    if ((handle >= p_index->first_handle) && (offset < p_index->num_slots))
+    {
+        if (p_index->p_slot[offset] == 0)
+            return NULL;
+
+        return (void *) (p_index->p_table + ((p_index->p_slot[offset] - 1) * p_index->entry_size));
+    }
+
+    if (p_index->has_outliers)
+    {
+        for (i = 0; i < p_index->num_entries; i++)
+        {
+            if (gatt_attr_index_entry_handle(p_index, i) == handle)
+                return (void *) (p_index->p_table + (i * p_index->entry_size));
+        }
+    }
+
+    return NULL;
+}
+
+wiced_bt_gatt_status_t gatt_attr_read(const void *p_attr, uint16_t attr_len, wiced_bt_gatt_read_t *p_read_data)
+{
+    uint16_t to_copy;
+
+    if (p_read_data->offset > attr_len)
+        return WICED_BT_GATT_INVALID_OFFSET;
+
+    to_copy = attr_len - p_read_data->offset;
+    if (to_copy > *p_read_data->p_val_len)
+        to_copy = *p_read_data->p_val_len;
+
+    memcpy(p_read_data->p_val, ((const uint8_t *) p_attr) + p_read_data->offset, to_copy);
+    *p_read_data->p_val_len = to_copy;
+
+    return WICED_BT_GATT_SUCCESS;
+}
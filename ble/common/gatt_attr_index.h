@@ -0,0 +1,97 @@
+/*
+ * Copyright 2016-2020, Cypress Semiconductor Corporation or a subsidiary of
+ * Cypress Semiconductor Corporation. All Rights Reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software"), is owned by Cypress Semiconductor Corporation
+ * or one of its subsidiaries ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products. Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ */
+
+/** @file
+ *
+ * Handle indexed lookup of GATT server attribute tables
+ *
+ * The example applications keep the values of their GATT database in small
+ * tables whose entries start with the uint16_t attribute handle, for example
+ * gatt_db_lookup_table_t generated by the Bluetooth Configurator. The index
+ * maps a handle to its table entry with one array access. It covers the
+ * handles from the lowest one in the table up to the number of slots given
+ * by the application; entries beyond that (OTA handles for instance) are
+ * still found, with a scan of the table.
+ */
+
+#pragma once
+
+#include "wiced_bt_types.h"
+#include "wiced_bt_gatt.h"
+
+/******************************************************
+ *                 Type Definitions
+ ******************************************************/
+
+typedef struct
+{
+    const uint8_t   *p_table;       /* attribute table, each entry starts with its handle */
+    uint16_t        entry_size;
+    uint16_t        num_entries;
+    uint16_t        first_handle;
+    uint16_t        num_slots;
+    uint8_t         *p_slot;        /* entry index + 1 for each handle from first_handle, 0 if none */
+    wiced_bool_t    has_outliers;   /* some entries are beyond the slots */
+} gatt_attr_index_t;
+
+/* Slots needed to index handles first to last */
+#define GATT_ATTR_INDEX_SLOTS(first, last)     ( (last) - (first) + 1 )
+
+/* Build an index over a table, slots is an array sized with GATT_ATTR_INDEX_SLOTS() */
+#define GATT_ATTR_INDEX_INIT(p_index, table, num_entries, slots) \
+    gatt_attr_index_init((p_index), (table), sizeof((table)[0]), (num_entries), (slots), sizeof(slots))
+
+/******************************************************
+ *               Function Declarations
+ ******************************************************/
+
+/**
+ * Build the index of an attribute table. The table must stay in place and
+ * keep its handles while the index is in use.
+ */
+void gatt_attr_index_init(gatt_attr_index_t *p_index, const void *p_table, uint16_t entry_size, uint16_t num_entries, uint8_t *p_slot, uint16_t max_slots);
+
+/**
+ * Find the table entry of a handle.
+ *
+ * @return  the entry, or NULL if the handle is not in the table
+ */
+void *gatt_attr_index_find(const gatt_attr_index_t *p_index, uint16_t handle);
+
+/**
+ * Serve a read request, or a read blob request at an offset, from an
+ * attribute value.
+ *
+ * @return  WICED_BT_GATT_INVALID_OFFSET if the offset is beyond the value
+ */
+wiced_bt_gatt_status_t gatt_attr_read(const void *p_attr, uint16_t attr_len, wiced_bt_gatt_read_t *p_read_data);
@@ -0,0 +1,107 @@
+/*
+ * Copyright 2016-2020, Cypress Semiconductor Corporation or a subsidiary of
+ * Cypress Semiconductor Corporation. All Rights Reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software"), is owned by Cypress Semiconductor Corporation
+ * or one of its subsidiaries ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products. Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ */
+
+/** @file
+ *
+ * Attribute values of a GATT server, served from the lookup table generated
+ * by the Bluetooth Configurator
+ */
+
+#include <string.h>
+#include "wiced_bt_trace.h"
+#include "gatt_attr_store.h"
+
+/******************************************************
+ *               Function Definitions
+ ******************************************************/
+
+void gatt_attr_store_init(gatt_attr_store_t *p_store, uint8_t *p_attr_slot, uint16_t max_attr_slots,
+                          const gatt_attr_store_hook_t *p_hooks, uint16_t num_hooks, uint8_t *p_hook_slot, uint16_t max_hook_slots)
+{
+    gatt_attr_index_init(&p_store->attr_index, app_gatt_db_ext_attr_tbl, sizeof(app_gatt_db_ext_attr_tbl[0]),
+            app_gatt_db_ext_attr_tbl_size, p_attr_slot, max_attr_slots);
+    gatt_attr_index_init(&p_store->hook_index, p_hooks, sizeof(p_hooks[0]), num_hooks, p_hook_slot, max_hook_slots);
+}
+
+gatt_db_lookup_table_t *gatt_attr_store_find(const gatt_attr_store_t *p_store, uint16_t handle)
+{
+    return gatt_attr_index_find(&p_store->attr_index, handle);
+}
+
+wiced_bt_gatt_status_t gatt_attr_store_get_value(const gatt_attr_store_t *p_store, uint16_t handle, uint16_t conn_id,
+                                                 uint8_t *p_val, uint16_t len, uint16_t *p_len)
+{
+    const gatt_attr_store_hook_t *p_hook = gatt_attr_index_find(&p_store->hook_index, handle);
+    gatt_db_lookup_table_t *p_attr = gatt_attr_index_find(&p_store->attr_index, handle);
+
+    if ((p_hook != NULL) && (p_hook->p_read != NULL))
+        return p_hook->p_read(conn_id, p_attr, p_val, len, p_len);
+
+    if (p_attr == NULL)
+        return WICED_BT_GATT_INVALID_HANDLE;
+
+    if (p_attr->cur_len > len)
+    {
+        WICED_BT_TRACE("[%s] handle 0x%x len %d > %d\n", __func__, handle, p_attr->cur_len, len);
+        return WICED_BT_GATT_INVALID_ATTR_LEN;
+    }
+
+    memcpy(p_val, p_attr->p_data, p_attr->cur_len);
+    *p_len = p_attr->cur_len;
+    return WICED_BT_GATT_SUCCESS;
+}
+
+wiced_bt_gatt_status_t gatt_attr_store_set_value(const gatt_attr_store_t *p_store, uint16_t handle, uint16_t conn_id,
+                                                 uint8_t *p_val, uint16_t len)
+{
+    const gatt_attr_store_hook_t *p_hook = gatt_attr_index_find(&p_store->hook_index, handle);
+    gatt_db_lookup_table_t *p_attr = gatt_attr_index_find(&p_store->attr_index, handle);
+
+    if ((p_hook != NULL) && (p_hook->p_write != NULL))
+        return p_hook->p_write(conn_id, p_attr, p_val, len);
+
+    if (p_attr == NULL)
+        return WICED_BT_GATT_INVALID_HANDLE;
+
+    return gatt_attr_store_put(p_attr, p_val, len);
+}
+
+wiced_bt_gatt_status_t gatt_attr_store_put(gatt_db_lookup_table_t *p_attr, const uint8_t *p_val, uint16_t len)
+{
+    if (len > p_attr->max_len)
+        return WICED_BT_GATT_INVALID_ATTR_LEN;
+
+    memcpy(p_attr->p_data, p_val, len);
+    p_attr->cur_len = len;
+    return WICED_BT_GATT_SUCCESS;
+}
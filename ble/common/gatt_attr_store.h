@@ -0,0 +1,119 @@
+/*
+ * Copyright 2016-2020, Cypress Semiconductor Corporation or a subsidiary of
+ * Cypress Semiconductor Corporation. All Rights Reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software"), is owned by Cypress Semiconductor Corporation
+ * or one of its subsidiaries ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products. Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ */
+
+/** @file
+ *
+ * Attribute values of a GATT server, served from the lookup table generated
+ * by the Bluetooth Configurator
+ *
+ * The store indexes app_gatt_db_ext_attr_tbl of GeneratedSource/cycfg_gatt_db.c
+ * by handle, and runs the hooks the application registers for the attributes
+ * whose value is not served from the table as is: per connection values, or
+ * writes with side effects. Hooks are found by handle too, so neither reads
+ * nor writes scan a table. The application building it must have the
+ * generated GeneratedSource/cycfg_gatt_db.h.
+ */
+
+#pragma once
+
+#include "wiced_bt_types.h"
+#include "wiced_bt_gatt.h"
+#include "gatt_attr_index.h"
+#include "GeneratedSource/cycfg_gatt_db.h"
+
+/******************************************************
+ *                 Type Definitions
+ ******************************************************/
+
+/* p_attr is the table entry of the handle, NULL if the handle is not in the table */
+typedef wiced_bt_gatt_status_t (*gatt_attr_store_read_hook_t)(uint16_t conn_id, gatt_db_lookup_table_t *p_attr,
+                                                              uint8_t *p_val, uint16_t len, uint16_t *p_len);
+typedef wiced_bt_gatt_status_t (*gatt_attr_store_write_hook_t)(uint16_t conn_id, gatt_db_lookup_table_t *p_attr,
+                                                               uint8_t *p_val, uint16_t len);
+
+typedef struct
+{
+    uint16_t                        handle;
+    gatt_attr_store_read_hook_t     p_read;     /* NULL reads the table */
+    gatt_attr_store_write_hook_t    p_write;    /* NULL writes the table */
+} gatt_attr_store_hook_t;
+
+typedef struct
+{
+    gatt_attr_index_t               attr_index; /* over app_gatt_db_ext_attr_tbl */
+    gatt_attr_index_t               hook_index;
+} gatt_attr_store_t;
+
+/* Build a store, attr_slots and hook_slots are arrays sized with GATT_ATTR_INDEX_SLOTS() */
+#define GATT_ATTR_STORE_INIT(p_store, attr_slots, hooks, hook_slots) \
+    gatt_attr_store_init((p_store), (attr_slots), sizeof(attr_slots), \
+                         (hooks), sizeof(hooks) / sizeof((hooks)[0]), (hook_slots), sizeof(hook_slots))
+
+/******************************************************
+ *               Function Declarations
+ ******************************************************/
+
+/**
+ * Build the handle indexes of app_gatt_db_ext_attr_tbl and of the hooks,
+ * once the GATT database is initialized. The hooks must stay in place.
+ */
+void gatt_attr_store_init(gatt_attr_store_t *p_store, uint8_t *p_attr_slot, uint16_t max_attr_slots,
+                          const gatt_attr_store_hook_t *p_hooks, uint16_t num_hooks, uint8_t *p_hook_slot, uint16_t max_hook_slots);
+
+/**
+ * Find the table entry of a handle.
+ *
+ * @return  the entry, or NULL if the handle is not in the table
+ */
+gatt_db_lookup_table_t *gatt_attr_store_find(const gatt_attr_store_t *p_store, uint16_t handle);
+
+/**
+ * Read the value of an attribute, through its read hook if it has one.
+ *
+ * @return  WICED_BT_GATT_INVALID_ATTR_LEN if the value does not fit in len
+ */
+wiced_bt_gatt_status_t gatt_attr_store_get_value(const gatt_attr_store_t *p_store, uint16_t handle, uint16_t conn_id,
+                                                 uint8_t *p_val, uint16_t len, uint16_t *p_len);
+
+/**
+ * Write the value of an attribute, through its write hook if it has one.
+ */
+wiced_bt_gatt_status_t gatt_attr_store_set_value(const gatt_attr_store_t *p_store, uint16_t handle, uint16_t conn_id,
+                                                 uint8_t *p_val, uint16_t len);
+
+/**
+ * Write a value to its table entry, for write hooks storing the value.
+ *
+ * @return  WICED_BT_GATT_INVALID_ATTR_LEN if the value is longer than the entry
+ */
+wiced_bt_gatt_status_t gatt_attr_store_put(gatt_db_lookup_table_t *p_attr, const uint8_t *p_val, uint16_t len);
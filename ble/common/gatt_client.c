@@ -0,0 +1,366 @@
+/*
+ * Copyright 2016-2020, Cypress Semiconductor Corporation or a subsidiary of
+ * Cypress Semiconductor Corporation. All Rights Reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software"), is owned by Cypress Semiconductor Corporation
+ * or one of its subsidiaries ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products. Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ */
+
+
+/** @file
+ *
+ * GATT client core shared by the example applications
+ */
+
+#include <string.h>
+#include "wiced_bt_trace.h"
+#include "gatt_client.h"
+
+/******************************************************
+ *               Variables Definitions
+ ******************************************************/
+
+static gatt_client_conn_t   *gatt_client_conns;
+static uint8_t              gatt_client_max_conns;
+
+/******************************************************
+ *               Function Definitions
+ ******************************************************/
+
+void gatt_client_init(gatt_client_conn_t *p_conns, uint8_t max_conns)
+{
+    gatt_client_conns     = p_conns;
+    gatt_client_max_conns = max_conns;
+
+    memset(p_conns, 0, max_conns * sizeof(gatt_client_conn_t));
+}
+
+gatt_client_conn_t *gatt_client_conn_find(uint16_t conn_id)
+{
+    uint8_t i;
+
+    for (i = 0; i < gatt_client_max_conns; i++)
+    {
+        if ((conn_id != 0) && (gatt_client_conns[i].conn_id == conn_id))
+            return &gatt_client_conns[i];
+    }
+    return NULL;
+}
+
+gatt_client_conn_t *gatt_client_conn_up(uint16_t conn_id, wiced_bt_device_address_t bd_addr)
+{
+    gatt_client_conn_t *p_conn = gatt_client_conn_find(conn_id);
+    uint8_t            i;
+
+    for (i = 0; (p_conn == NULL) && (i < gatt_client_max_conns); i++)
+    {
+        if (gatt_client_conns[i].conn_id == 0)
+            p_conn = &gatt_client_conns[i];
+    }
+    if (p_conn == NULL)
+        return NULL;
+
+    memset(p_conn, 0, sizeof(*p_conn));
+    p_conn->conn_id = conn_id;
+    memcpy(p_conn->bd_addr, bd_addr, BD_ADDR_LEN);
+    return p_conn;
+}
+
+/*
+ * Send the operation in front of the queue
+ */
+static wiced_bt_gatt_status_t gatt_client_send(gatt_client_conn_t *p_conn, gatt_client_op_t *p_op)
+{
+    wiced_bt_gatt_read_param_t      read_param;
+    wiced_bt_gatt_discovery_param_t disc_param;
+
+    switch (p_op->type)
+    {
+    case GATT_CLIENT_OP_READ:
+        memset(&read_param, 0, sizeof(read_param));
+        read_param.by_handle.handle   = p_op->handle;
+        read_param.by_handle.auth_req = GATT_AUTH_REQ_NONE;
+        return wiced_bt_gatt_send_read(p_conn->conn_id, GATT_READ_BY_HANDLE, &read_param);
+
+    case GATT_CLIENT_OP_WRITE:
+        p_conn->write.value.handle   = p_op->handle;
+        p_conn->write.value.offset   = 0;
+        p_conn->write.value.len      = p_op->len;
+        p_conn->write.value.auth_req = GATT_AUTH_REQ_NONE;
+        memcpy(p_conn->write.value.value, p_op->value, p_op->len);
+        return wiced_bt_gatt_send_write(p_conn->conn_id, GATT_WRITE, &p_conn->write.value);
+
+    case GATT_CLIENT_OP_DISCOVER:
+        memset(&disc_param, 0, sizeof(disc_param));
+        disc_param.s_handle = p_op->handle;
+        disc_param.e_handle = p_op->e_handle;
+        if (p_op->uuid16 != 0)
+        {
+            disc_param.uuid.len       = LEN_UUID_16;
+            disc_param.uuid.uu.uuid16 = p_op->uuid16;
+        }
+        return wiced_bt_gatt_send_discover(p_conn->conn_id, (wiced_bt_gatt_discovery_type_t)p_op->disc_type, &disc_param);
+
+    case GATT_CLIENT_OP_CACHE_CHECK:
+        return gatt_disc_cache_check(p_op->p_cache, p_conn->conn_id, p_conn->bd_addr) ? WICED_BT_GATT_SUCCESS : WICED_BT_GATT_ERROR;
+    }
+    return WICED_BT_GATT_ILLEGAL_PARAMETER;
+}
+
+/*
+ * The operation in front is over: take it off the queue before its callback,
+ * which may queue more
+ */
+static void gatt_client_complete(gatt_client_conn_t *p_conn, gatt_client_result_t *p_result)
+{
+    gatt_client_op_t op = p_conn->queue[p_conn->queue_first];
+
+    p_conn->busy        = WICED_FALSE;
+    p_conn->queue_first = (p_conn->queue_first + 1) % GATT_CLIENT_QUEUE_SIZE;
+    p_conn->queue_count--;
+
+    if (op.p_cb != NULL)
+        op.p_cb(p_conn, &op, p_result);
+}
+
+/*
+ * Send the next operations of an idle connection, until one is in flight
+ */
+static void gatt_client_run(gatt_client_conn_t *p_conn)
+{
+    gatt_client_result_t result;
+    gatt_client_op_t     *p_op;
+
+    while ((p_conn->conn_id != 0) && !p_conn->busy && (p_conn->queue_count != 0))
+    {
+        p_op = &p_conn->queue[p_conn->queue_first];
+
+        memset(&result, 0, sizeof(result));
+        result.status = gatt_client_send(p_conn, p_op);
+        if (result.status == WICED_BT_GATT_SUCCESS)
+        {
+            p_conn->busy = WICED_TRUE;
+            break;
+        }
+
+        WICED_BT_TRACE("gatt_client conn_id:%d op:%d not sent:%d\n", p_conn->conn_id, p_op->type, result.status);
+
+        // a cache check that could not read the hash is a miss, the discovery follows
+        if (p_op->type == GATT_CLIENT_OP_CACHE_CHECK)
+        {
+            result.status = WICED_BT_GATT_SUCCESS;
+            result.cache  = GATT_DISC_CACHE_MISS;
+        }
+        gatt_client_complete(p_conn, &result);
+    }
+}
+
+wiced_bt_gatt_status_t gatt_client_queue(gatt_client_conn_t *p_conn, const gatt_client_op_t *p_op)
+{
+    if ((p_conn == NULL) || (p_conn->conn_id == 0))
+        return WICED_BT_GATT_ERROR;
+
+    if (p_op->len > GATT_CLIENT_MAX_WRITE_LEN)
+        return WICED_BT_GATT_ILLEGAL_PARAMETER;
+
+    if (p_conn->queue_count == GATT_CLIENT_QUEUE_SIZE)
+        return WICED_BT_GATT_NO_RESOURCES;
+
+    p_conn->queue[(p_conn->queue_first + p_conn->queue_count) % GATT_CLIENT_QUEUE_SIZE] = *p_op;
+    p_conn->queue_count++;
+
+    gatt_client_run(p_conn);
+    return WICED_BT_GATT_SUCCESS;
+}
+
+wiced_bt_gatt_status_t gatt_client_read(gatt_client_conn_t *p_conn, uint16_t handle, gatt_client_op_cb_t p_cb, void *p_context)
+{
+    gatt_client_op_t op;
+
+    memset(&op, 0, sizeof(op));
+    op.type      = GATT_CLIENT_OP_READ;
+    op.handle    = handle;
+    op.p_cb      = p_cb;
+    op.p_context = p_context;
+    return gatt_client_queue(p_conn, &op);
+}
+
+wiced_bt_gatt_status_t gatt_client_write(gatt_client_conn_t *p_conn, uint16_t handle, const uint8_t *p_val, uint16_t len, gatt_client_op_cb_t p_cb, void *p_context)
+{
+    gatt_client_op_t op;
+
+    if (len > GATT_CLIENT_MAX_WRITE_LEN)
+        return WICED_BT_GATT_ILLEGAL_PARAMETER;
+
+    memset(&op, 0, sizeof(op));
+    op.type      = GATT_CLIENT_OP_WRITE;
+    op.handle    = handle;
+    op.len       = len;
+    op.p_cb      = p_cb;
+    op.p_context = p_context;
+    memcpy(op.value, p_val, len);
+    return gatt_client_queue(p_conn, &op);
+}
+
+wiced_bt_gatt_status_t gatt_client_write_cccd(gatt_client_conn_t *p_conn, uint16_t cccd_handle, uint16_t cccd, gatt_client_op_cb_t p_cb, void *p_context)
+{
+    uint8_t value[2];
+
+    value[0] = cccd & 0xff;
+    value[1] = (cccd >> 8) & 0xff;
+    return gatt_client_write(p_conn, cccd_handle, value, sizeof(value), p_cb, p_context);
+}
+
+wiced_bt_gatt_status_t gatt_client_discover(gatt_client_conn_t *p_conn, wiced_bt_gatt_discovery_type_t disc_type, uint16_t uuid16,
+                                            uint16_t s_handle, uint16_t e_handle, gatt_client_disc_cb_t p_disc_cb, gatt_client_op_cb_t p_cb, void *p_context)
+{
+    gatt_client_op_t op;
+
+    memset(&op, 0, sizeof(op));
+    op.type      = GATT_CLIENT_OP_DISCOVER;
+    op.disc_type = disc_type;
+    op.uuid16    = uuid16;
+    op.handle    = s_handle;
+    op.e_handle  = e_handle;
+    op.p_disc_cb = p_disc_cb;
+    op.p_cb      = p_cb;
+    op.p_context = p_context;
+    return gatt_client_queue(p_conn, &op);
+}
+
+wiced_bt_gatt_status_t gatt_client_cache_check(gatt_client_conn_t *p_conn, gatt_disc_cache_t *p_cache, gatt_client_op_cb_t p_cb, void *p_context)
+{
+    gatt_client_op_t op;
+
+    memset(&op, 0, sizeof(op));
+    op.type      = GATT_CLIENT_OP_CACHE_CHECK;
+    op.p_cache   = p_cache;
+    op.p_cb      = p_cb;
+    op.p_context = p_context;
+    return gatt_client_queue(p_conn, &op);
+}
+
+/*
+ * Read or write response, the one of the operation in flight
+ */
+static wiced_bool_t gatt_client_operation_complete(wiced_bt_gatt_operation_complete_t *p_data)
+{
+    gatt_client_conn_t   *p_conn = gatt_client_conn_find(p_data->conn_id);
+    gatt_client_op_t     *p_op;
+    gatt_client_result_t result;
+
+    if ((p_conn == NULL) || !p_conn->busy)
+        return WICED_FALSE;
+
+    p_op = &p_conn->queue[p_conn->queue_first];
+
+    memset(&result, 0, sizeof(result));
+    result.status = p_data->status;
+    result.p_rsp  = p_data;
+
+    switch (p_data->op)
+    {
+    case GATTC_OPTYPE_READ:
+        if (p_op->type == GATT_CLIENT_OP_CACHE_CHECK)
+        {
+            result.cache  = gatt_disc_cache_read_rsp(p_op->p_cache, p_data, &result.s_handle, &result.e_handle);
+            result.status = WICED_BT_GATT_SUCCESS;
+        }
+        else if (p_op->type != GATT_CLIENT_OP_READ)
+        {
+            return WICED_FALSE;
+        }
+        break;
+
+    case GATTC_OPTYPE_WRITE:
+        if (p_op->type != GATT_CLIENT_OP_WRITE)
+            return WICED_FALSE;
+        break;
+
+    default:
+        return WICED_FALSE;
+    }
+
+    gatt_client_complete(p_conn, &result);
+    gatt_client_run(p_conn);
+    return WICED_TRUE;
+}
+
+static gatt_client_op_t *gatt_client_discovery_op(uint16_t conn_id, gatt_client_conn_t **pp_conn)
+{
+    gatt_client_conn_t *p_conn = gatt_client_conn_find(conn_id);
+
+    if ((p_conn == NULL) || !p_conn->busy || (p_conn->queue[p_conn->queue_first].type != GATT_CLIENT_OP_DISCOVER))
+        return NULL;
+
+    *pp_conn = p_conn;
+    return &p_conn->queue[p_conn->queue_first];
+}
+
+wiced_bool_t gatt_client_event_handler(wiced_bt_gatt_evt_t event, wiced_bt_gatt_event_data_t *p_data)
+{
+    gatt_client_conn_t   *p_conn;
+    gatt_client_op_t     *p_op;
+    gatt_client_result_t result;
+
+    switch (event)
+    {
+    case GATT_CONNECTION_STATUS_EVT:
+        // a response in flight will not come, the operations are dropped
+        if (!p_data->connection_status.connected && ((p_conn = gatt_client_conn_find(p_data->connection_status.conn_id)) != NULL))
+        {
+            if (p_conn->busy || (p_conn->queue_count != 0))
+                WICED_BT_TRACE("gatt_client conn_id:%d down, %d operations dropped\n", p_conn->conn_id, p_conn->queue_count);
+            memset(p_conn, 0, sizeof(*p_conn));
+        }
+        break;
+
+    case GATT_OPERATION_CPLT_EVT:
+        return gatt_client_operation_complete(&p_data->operation_complete);
+
+    case GATT_DISCOVERY_RESULT_EVT:
+        if ((p_op = gatt_client_discovery_op(p_data->discovery_result.conn_id, &p_conn)) == NULL)
+            return WICED_FALSE;
+        if (p_op->p_disc_cb != NULL)
+            p_op->p_disc_cb(p_conn, &p_data->discovery_result);
+        return WICED_TRUE;
+
+    case GATT_DISCOVERY_CPLT_EVT:
+        if ((p_op = gatt_client_discovery_op(p_data->discovery_complete.conn_id, &p_conn)) == NULL)
+            return WICED_FALSE;
+        memset(&result, 0, sizeof(result));
+        result.status = p_data->discovery_complete.status;
+        gatt_client_complete(p_conn, &result);
+        gatt_client_run(p_conn);
+        return WICED_TRUE;
+
+    default:
+        break;
+    }
+    return WICED_FALSE;
+}
@@ -0,0 +1,205 @@
+/*
+ * Copyright 2016-2020, Cypress Semiconductor Corporation or a subsidiary of
+ * Cypress Semiconductor Corporation. All Rights Reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software"), is owned by Cypress Semiconductor Corporation
+ * or one of its subsidiaries ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products. Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ */
+
+
+/** @file
+ *
+ * GATT client core shared by the example applications
+ *
+ * GATT lets a client have one request at a time on a connection. The core
+ * keeps a queue of operations per connection: reads, writes, writes of a
+ * Client Characteristic Configuration descriptor, discoveries, and checks of
+ * the bonded discovery cache (gatt_disc_cache). The first operation is sent
+ * as soon as it is queued on an idle connection, the next one as soon as the
+ * previous completes, and the callback of each operation gets its result.
+ * A connection setup is then a sequence of operations queued at once.
+ *
+ * The application gives the GATT events to gatt_client_event_handler()
+ * before its own handling. The core takes the completions of the operations
+ * it sent and leaves the others, notifications and indications for instance.
+ * Requests the application sends by other means, through a profile library,
+ * must not overlap with the operations queued on the same connection.
+ */
+
+#pragma once
+
+#include "wiced_bt_types.h"
+#include "wiced_bt_gatt.h"
+#include "gatt_disc_cache.h"
+
+/******************************************************
+ *                     Constants
+ ******************************************************/
+
+/* Operations waiting per connection, the one in flight included */
+#ifndef GATT_CLIENT_QUEUE_SIZE
+#define GATT_CLIENT_QUEUE_SIZE              4
+#endif
+
+/* Longest value written, the write of an operation is copied in the queue */
+#ifndef GATT_CLIENT_MAX_WRITE_LEN
+#define GATT_CLIENT_MAX_WRITE_LEN           20
+#endif
+
+typedef enum
+{
+    GATT_CLIENT_OP_READ,                /* read of a handle */
+    GATT_CLIENT_OP_WRITE,               /* write request */
+    GATT_CLIENT_OP_DISCOVER,            /* services, characteristics or descriptors in a range */
+    GATT_CLIENT_OP_CACHE_CHECK,         /* read of the peer Database Hash for the discovery cache */
+} gatt_client_op_type_t;
+
+/******************************************************
+ *                 Type Definitions
+ ******************************************************/
+
+typedef struct gatt_client_conn gatt_client_conn_t;
+typedef struct gatt_client_op   gatt_client_op_t;
+
+typedef struct
+{
+    wiced_bt_gatt_status_t              status;
+    wiced_bt_gatt_operation_complete_t  *p_rsp;     /* read, write: response of the server, NULL if none */
+    gatt_disc_cache_result_t            cache;      /* cache check: GATT_DISC_CACHE_HIT or MISS */
+    uint16_t                            s_handle;   /* cache check: range cached, on a hit */
+    uint16_t                            e_handle;
+} gatt_client_result_t;
+
+/* An operation is over, the next one of the connection is sent on return */
+typedef void (*gatt_client_op_cb_t)(gatt_client_conn_t *p_conn, const gatt_client_op_t *p_op, const gatt_client_result_t *p_result);
+
+/* An item found by a discovery */
+typedef void (*gatt_client_disc_cb_t)(gatt_client_conn_t *p_conn, wiced_bt_gatt_discovery_result_t *p_data);
+
+struct gatt_client_op
+{
+    uint8_t                 type;           /* GATT_CLIENT_OP_xx */
+    uint8_t                 disc_type;      /* discover: GATT_DISCOVER_xx */
+    uint16_t                handle;         /* read, write: attribute. discover: start of the range */
+    uint16_t                e_handle;       /* discover: end of the range */
+    uint16_t                uuid16;         /* discover: UUID looked for, 0 for all */
+    uint16_t                len;            /* write: length of the value */
+    uint8_t                 value[GATT_CLIENT_MAX_WRITE_LEN];
+    gatt_disc_cache_t       *p_cache;       /* cache check */
+    gatt_client_op_cb_t     p_cb;           /* optional */
+    gatt_client_disc_cb_t   p_disc_cb;      /* discover */
+    void                    *p_context;     /* for the application */
+};
+
+/* Pre-allocated write request, the stack reads it until the response */
+typedef union
+{
+    wiced_bt_gatt_value_t   value;
+    uint8_t                 buffer[sizeof(wiced_bt_gatt_value_t) + GATT_CLIENT_MAX_WRITE_LEN];
+} gatt_client_write_buf_t;
+
+struct gatt_client_conn
+{
+    uint16_t                    conn_id;        /* 0 if the entry is free */
+    wiced_bt_device_address_t   bd_addr;
+    wiced_bool_t                busy;           /* queue[queue_first] is in flight */
+    gatt_client_op_t            queue[GATT_CLIENT_QUEUE_SIZE];
+    uint8_t                     queue_first;
+    uint8_t                     queue_count;
+    gatt_client_write_buf_t     write;
+};
+
+/******************************************************
+ *               Function Declarations
+ ******************************************************/
+
+/**
+ * Start the client with the connection entries of the application. The
+ * entries must stay in place.
+ */
+void gatt_client_init(gatt_client_conn_t *p_conns, uint8_t max_conns);
+
+/**
+ * Give a GATT event to the core. Connections going down drop their queue,
+ * the callbacks of the operations dropped are not called.
+ *
+ * @return  WICED_TRUE if the event was the completion of a queued operation
+ *          or a discovery result for one: the application leaves it
+ */
+wiced_bool_t gatt_client_event_handler(wiced_bt_gatt_evt_t event, wiced_bt_gatt_event_data_t *p_data);
+
+/**
+ * Take an entry for a connection to a server.
+ *
+ * @return  the entry, or NULL if all are in use
+ */
+gatt_client_conn_t *gatt_client_conn_up(uint16_t conn_id, wiced_bt_device_address_t bd_addr);
+
+/**
+ * Find the entry of a connection.
+ *
+ * @return  the entry, or NULL if the connection has none
+ */
+gatt_client_conn_t *gatt_client_conn_find(uint16_t conn_id);
+
+/**
+ * Queue an operation, it is copied.
+ *
+ * @return  WICED_BT_GATT_SUCCESS if it is sent or queued,
+ *          WICED_BT_GATT_NO_RESOURCES if the queue is full,
+ *          WICED_BT_GATT_ILLEGAL_PARAMETER for a write too long
+ */
+wiced_bt_gatt_status_t gatt_client_queue(gatt_client_conn_t *p_conn, const gatt_client_op_t *p_op);
+
+/**
+ * Queue the read of a handle.
+ */
+wiced_bt_gatt_status_t gatt_client_read(gatt_client_conn_t *p_conn, uint16_t handle, gatt_client_op_cb_t p_cb, void *p_context);
+
+/**
+ * Queue a write request.
+ */
+wiced_bt_gatt_status_t gatt_client_write(gatt_client_conn_t *p_conn, uint16_t handle, const uint8_t *p_val, uint16_t len, gatt_client_op_cb_t p_cb, void *p_context);
+
+/**
+ * Queue the write of a Client Characteristic Configuration descriptor,
+ * GATT_CLIENT_CONFIG_xx bits.
+ */
+wiced_bt_gatt_status_t gatt_client_write_cccd(gatt_client_conn_t *p_conn, uint16_t cccd_handle, uint16_t cccd, gatt_client_op_cb_t p_cb, void *p_context);
+
+/**
+ * Queue a discovery. p_disc_cb gets the items found, p_cb the end.
+ */
+wiced_bt_gatt_status_t gatt_client_discover(gatt_client_conn_t *p_conn, wiced_bt_gatt_discovery_type_t disc_type, uint16_t uuid16,
+                                            uint16_t s_handle, uint16_t e_handle, gatt_client_disc_cb_t p_disc_cb, gatt_client_op_cb_t p_cb, void *p_context);
+
+/**
+ * Queue a check of the discovery cache. The result tells a hit, with the
+ * range cached, or a miss; a read that could not be sent is a miss.
+ */
+wiced_bt_gatt_status_t gatt_client_cache_check(gatt_client_conn_t *p_conn, gatt_disc_cache_t *p_cache, gatt_client_op_cb_t p_cb, void *p_context);
@@ -0,0 +1,193 @@
+/*
+ * Copyright 2016-2020, Cypress Semiconductor Corporation or a subsidiary of
+ * Cypress Semiconductor Corporation. All Rights Reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software"), is owned by Cypress Semiconductor Corporation
+ * or one of its subsidiaries ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products. Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ */
+
+/** @file
+ *
+ * Bonded peer cache of GATT discovery results
+ */
+
+#include <string.h>
+#include "wiced_bt_trace.h"
+#include "wiced_hal_nvram.h"
+#include "gatt_disc_cache.h"
+
+/******************************************************
+ *               Function Definitions
+ ******************************************************/
+
+/* the bond store gives a slot to a new device, its entry goes with the old keys */
+static void gatt_disc_cache_bond_replaced(void *p_context, uint8_t slot)
+{
+    gatt_disc_cache_t *p_cache = (gatt_disc_cache_t *)p_context;
+    wiced_result_t     result;
+
+    if (p_cache->loaded && (p_cache->slot == slot))
+        p_cache->loaded = WICED_FALSE;
+    wiced_hal_delete_nvram(p_cache->first_nvram_id + slot, &result);
+}
+
+void gatt_disc_cache_init(gatt_disc_cache_t *p_cache, uint16_t first_nvram_id, bond_store_t *p_bond_store)
+{
+    memset(p_cache, 0, sizeof(*p_cache));
+    p_cache->first_nvram_id = first_nvram_id;
+    p_cache->p_bond_store   = p_bond_store;
+    bond_store_register_replace_cb(p_bond_store, gatt_disc_cache_bond_replaced, p_cache);
+}
+
+wiced_bool_t gatt_disc_cache_check(gatt_disc_cache_t *p_cache, uint16_t conn_id, BD_ADDR bd_addr)
+{
+    wiced_bt_gatt_read_param_t read_param;
+    wiced_result_t             result;
+    uint16_t                   bytes_read;
+    int                        slot = bond_store_slot(p_cache->p_bond_store, bd_addr);
+
+    p_cache->loaded = WICED_FALSE;
+    if (slot >= 0)
+    {
+        bytes_read = wiced_hal_read_nvram(p_cache->first_nvram_id + slot, sizeof(p_cache->entry), (uint8_t *)&p_cache->entry, &result);
+
+        p_cache->slot   = slot;
+        p_cache->loaded = (result == WICED_SUCCESS) && (bytes_read == sizeof(p_cache->entry)) &&
+                          (memcmp(p_cache->entry.bd_addr, bd_addr, BD_ADDR_LEN) == 0);
+    }
+    p_cache->hash_read = WICED_FALSE;
+    memcpy(p_cache->hash_addr, bd_addr, BD_ADDR_LEN);
+
+    memset(&read_param, 0, sizeof(read_param));
+    read_param.char_type.s_handle        = 1;
+    read_param.char_type.e_handle        = 0xffff;
+    read_param.char_type.uuid.len        = LEN_UUID_16;
+    read_param.char_type.uuid.uu.uuid16  = GATT_DISC_CACHE_UUID_DATABASE_HASH;
+    read_param.char_type.auth_req        = GATT_AUTH_REQ_NONE;
+
+    if (wiced_bt_gatt_send_read(conn_id, GATT_READ_CHAR_VALUE, &read_param) != WICED_BT_GATT_SUCCESS)
+    {
+        p_cache->conn_id = 0;
+        return WICED_FALSE;
+    }
+    p_cache->conn_id = conn_id;
+    return WICED_TRUE;
+}
+
+gatt_disc_cache_result_t gatt_disc_cache_read_rsp(gatt_disc_cache_t *p_cache, wiced_bt_gatt_operation_complete_t *p_data, uint16_t *p_s_handle, uint16_t *p_e_handle)
+{
+    wiced_bool_t hit;
+
+    if ((p_cache->conn_id == 0) || (p_cache->conn_id != p_data->conn_id))
+        return GATT_DISC_CACHE_IGNORED;
+
+    p_cache->conn_id = 0;
+
+    if ((p_data->status == WICED_BT_GATT_SUCCESS) && (p_data->response_data.att_value.len == GATT_DISC_CACHE_HASH_LEN))
+    {
+        memcpy(p_cache->new_hash, p_data->response_data.att_value.p_data, GATT_DISC_CACHE_HASH_LEN);
+        p_cache->hash_read = WICED_TRUE;
+    }
+
+    // the peer database did not change if it has the same hash, a range saved
+    // without hash by an older version is not trusted
+    hit = p_cache->loaded && p_cache->hash_read && p_cache->entry.has_hash &&
+          (memcmp(p_cache->new_hash, p_cache->entry.db_hash, GATT_DISC_CACHE_HASH_LEN) == 0);
+
+    WICED_BT_TRACE("gatt_disc_cache conn_id:%d %s hash:%d\n", p_data->conn_id, hit ? "hit" : "miss", p_cache->hash_read);
+
+    if (!hit)
+        return GATT_DISC_CACHE_MISS;
+
+    *p_s_handle = p_cache->entry.s_handle;
+    *p_e_handle = p_cache->entry.e_handle;
+    return GATT_DISC_CACHE_HIT;
+}
+
+void gatt_disc_cache_store(gatt_disc_cache_t *p_cache, BD_ADDR bd_addr, uint16_t s_handle, uint16_t e_handle)
+{
+    wiced_result_t result;
+    int            slot = bond_store_slot(p_cache->p_bond_store, bd_addr);
+
+    // only the devices of the bond store have an entry
+    if (slot < 0)
+        return;
+
+    // the hash read is the one of another peer, this one was not checked
+    if (memcmp(p_cache->hash_addr, bd_addr, BD_ADDR_LEN) != 0)
+        return;
+
+    // without hash a change of the peer database could not be seen, drop
+    // what an older version saved for it
+    if (!p_cache->hash_read)
+    {
+        if (p_cache->loaded && (p_cache->slot == slot))
+            gatt_disc_cache_invalidate(p_cache, bd_addr);
+        return;
+    }
+
+    // nothing new to save
+    if (p_cache->loaded && (p_cache->slot == slot) && (memcmp(p_cache->entry.bd_addr, bd_addr, BD_ADDR_LEN) == 0) &&
+        (p_cache->entry.s_handle == s_handle) && (p_cache->entry.e_handle == e_handle) &&
+        p_cache->entry.has_hash && (memcmp(p_cache->entry.db_hash, p_cache->new_hash, GATT_DISC_CACHE_HASH_LEN) == 0))
+        return;
+
+    memcpy(p_cache->entry.bd_addr, bd_addr, BD_ADDR_LEN);
+    p_cache->entry.s_handle = s_handle;
+    p_cache->entry.e_handle = e_handle;
+    p_cache->entry.has_hash = WICED_TRUE;
+    memcpy(p_cache->entry.db_hash, p_cache->new_hash, GATT_DISC_CACHE_HASH_LEN);
+
+    wiced_hal_write_nvram(p_cache->first_nvram_id + slot, sizeof(p_cache->entry), (uint8_t *)&p_cache->entry, &result);
+    p_cache->slot   = slot;
+    p_cache->loaded = (result == WICED_SUCCESS);
+
+    WICED_BT_TRACE("gatt_disc_cache store <%B> slot:%d %04x-%04x result:%d\n", bd_addr, slot, s_handle, e_handle, result);
+}
+
+void gatt_disc_cache_invalidate(gatt_disc_cache_t *p_cache, BD_ADDR bd_addr)
+{
+    wiced_result_t result;
+    int            slot = bond_store_slot(p_cache->p_bond_store, bd_addr);
+
+    if (slot < 0)
+        return;
+
+    if (p_cache->loaded && (p_cache->slot == slot))
+    {
+        p_cache->loaded = WICED_FALSE;
+        memset(&p_cache->entry, 0, sizeof(p_cache->entry));
+    }
+    wiced_hal_delete_nvram(p_cache->first_nvram_id + slot, &result);
+}
+
+void gatt_disc_cache_connection_down(gatt_disc_cache_t *p_cache, uint16_t conn_id)
+{
+    if (p_cache->conn_id == conn_id)
+        p_cache->conn_id = 0;
+}
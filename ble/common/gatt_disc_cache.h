@@ -0,0 +1,144 @@
+/*
+ * Copyright 2016-2020, Cypress Semiconductor Corporation or a subsidiary of
+ * Cypress Semiconductor Corporation. All Rights Reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software"), is owned by Cypress Semiconductor Corporation
+ * or one of its subsidiaries ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products. Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ */
+
+/** @file
+ *
+ * Bonded peer cache of GATT discovery results
+ *
+ * The client applications look for one service on their peer with a
+ * discovery of all primary services, then let their profile library
+ * discover the characteristics of that service. The cache keeps the handle
+ * range of the service of each bonded peer in NVRAM, one entry per slot of
+ * the bond store holding its link keys, so that a reconnection goes straight
+ * to the library discovery. The entry of a device is deleted when the bond
+ * store gives its slot to a new device.
+ *
+ * The cached range is trusted only while the peer database has not changed.
+ * On each connection the Database Hash characteristic of the peer is read
+ * first: the cache is used when it matches the hash stored with the range.
+ * A peer without Database Hash is not cached, as nothing would tell that its
+ * database changed, it gets a full discovery on each connection.
+ */
+
+#pragma once
+
+#include "wiced_bt_types.h"
+#include "wiced_bt_gatt.h"
+#include "bond_store.h"
+
+/******************************************************
+ *                      Constants
+ ******************************************************/
+
+#define GATT_DISC_CACHE_HASH_LEN            16
+#define GATT_DISC_CACHE_UUID_DATABASE_HASH  0x2B2A
+
+/* NVRAM ids used by the cache of a bond store of max_devices */
+#define GATT_DISC_CACHE_NUM_VS_ID(max_devices)  (max_devices)
+
+/* Answer to the read of the Database Hash */
+typedef enum
+{
+    GATT_DISC_CACHE_IGNORED,    /* not a response to the cache check */
+    GATT_DISC_CACHE_HIT,        /* use the cached handle range */
+    GATT_DISC_CACHE_MISS        /* run the discovery, then store its result */
+} gatt_disc_cache_result_t;
+
+/******************************************************
+ *                 Type Definitions
+ ******************************************************/
+
+/* Saved in NVRAM, one per bond store slot */
+typedef struct
+{
+    BD_ADDR         bd_addr;
+    uint16_t        s_handle;
+    uint16_t        e_handle;
+    uint8_t         has_hash;
+    uint8_t         db_hash[GATT_DISC_CACHE_HASH_LEN];
+} gatt_disc_cache_entry_t;
+
+typedef struct
+{
+    uint16_t                first_nvram_id; /* id of the entry of slot 0 */
+    bond_store_t           *p_bond_store;
+    uint16_t                conn_id;        /* connection being checked, 0 if none */
+    wiced_bool_t            loaded;         /* entry holds the range of the connected peer */
+    uint8_t                 slot;           /* bond store slot of the entry loaded */
+    wiced_bool_t            hash_read;      /* hash of the peer checked last is in new_hash */
+    BD_ADDR                 hash_addr;      /* peer checked last */
+    uint8_t                 new_hash[GATT_DISC_CACHE_HASH_LEN];
+    gatt_disc_cache_entry_t entry;
+} gatt_disc_cache_t;
+
+/******************************************************
+ *               Function Declarations
+ ******************************************************/
+
+/**
+ * Initialize the cache of the devices of a bond store, using the NVRAM ids
+ * from first_nvram_id on, see GATT_DISC_CACHE_NUM_VS_ID(). Call after
+ * bond_store_init(), the cache registers to be told of replaced devices.
+ */
+void gatt_disc_cache_init(gatt_disc_cache_t *p_cache, uint16_t first_nvram_id, bond_store_t *p_bond_store);
+
+/**
+ * Start checking the cache for a new connection, with a read of the peer
+ * Database Hash. The answer comes with gatt_disc_cache_read_rsp().
+ *
+ * @return  WICED_FALSE if the read could not be sent, run the discovery
+ */
+wiced_bool_t gatt_disc_cache_check(gatt_disc_cache_t *p_cache, uint16_t conn_id, BD_ADDR bd_addr);
+
+/**
+ * Process a read response. On a hit, the cached range is returned.
+ */
+gatt_disc_cache_result_t gatt_disc_cache_read_rsp(gatt_disc_cache_t *p_cache, wiced_bt_gatt_operation_complete_t *p_data, uint16_t *p_s_handle, uint16_t *p_e_handle);
+
+/**
+ * Save the range found by a successful discovery of a bonded peer. Nothing
+ * is saved if the peer did not give its Database Hash, or was not the one
+ * checked last: an application with several connections checks and
+ * discovers its peers one at a time.
+ */
+void gatt_disc_cache_store(gatt_disc_cache_t *p_cache, BD_ADDR bd_addr, uint16_t s_handle, uint16_t e_handle);
+
+/**
+ * Forget the cached range of a peer, when the profile discovery failed in it.
+ */
+void gatt_disc_cache_invalidate(gatt_disc_cache_t *p_cache, BD_ADDR bd_addr);
+
+/**
+ * Stop checking, the connection is down.
+ */
+void gatt_disc_cache_connection_down(gatt_disc_cache_t *p_cache, uint16_t conn_id);
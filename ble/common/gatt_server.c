@@ -0,0 +1,485 @@
+/*
+ * Copyright 2016-2020, Cypress Semiconductor Corporation or a subsidiary of
+ * Cypress Semiconductor Corporation. All Rights Reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software"), is owned by Cypress Semiconductor Corporation
+ * or one of its subsidiaries ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products. Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ */
+
+/** @file
+ *
+ * GATT server core shared by the example applications
+ */
+
+#include <string.h>
+#include "wiced_bt_trace.h"
+#include "wiced_memory.h"
+#include "wiced_timer.h"
+#include "gatt_attr_index.h"
+#include "gatt_server.h"
+
+/******************************************************
+ *               Variables Definitions
+ ******************************************************/
+
+static const gatt_server_cfg_t  *gatt_server_cfg;
+static gatt_server_conn_t       *gatt_server_conns;
+static uint8_t                  gatt_server_max_conns;
+static wiced_timer_t            gatt_server_retry_timer;
+
+/******************************************************
+ *               Function Definitions
+ ******************************************************/
+
+static void gatt_server_queue_drain(gatt_server_conn_t *p_conn);
+
+/* The stack had no buffer for a queued value, try all the queues again */
+static void gatt_server_retry_timeout(uint32_t arg)
+{
+    uint8_t i;
+
+    for (i = 0; i < gatt_server_max_conns; i++)
+    {
+        if (gatt_server_conns[i].conn_id != 0)
+            gatt_server_queue_drain(&gatt_server_conns[i]);
+    }
+}
+
+void gatt_server_init(const gatt_server_cfg_t *p_cfg, gatt_server_conn_t *p_conns, uint8_t max_conns)
+{
+    gatt_server_cfg       = p_cfg;
+    gatt_server_conns     = p_conns;
+    gatt_server_max_conns = max_conns;
+    memset(p_conns, 0, max_conns * sizeof(gatt_server_conn_t));
+    wiced_init_timer(&gatt_server_retry_timer, gatt_server_retry_timeout, 0, WICED_MILLI_SECONDS_TIMER);
+}
+
+gatt_server_conn_t *gatt_server_conn_find(uint16_t conn_id)
+{
+    uint8_t i;
+
+    for (i = 0; i < gatt_server_max_conns; i++)
+    {
+        if (gatt_server_conns[i].conn_id == conn_id)
+            return &gatt_server_conns[i];
+    }
+    return NULL;
+}
+
+uint8_t gatt_server_conn_index(const gatt_server_conn_t *p_conn)
+{
+    return (uint8_t) (p_conn - gatt_server_conns);
+}
+
+uint8_t gatt_server_num_conns(void)
+{
+    uint8_t i, count = 0;
+
+    for (i = 0; i < gatt_server_max_conns; i++)
+    {
+        if (gatt_server_conns[i].conn_id != 0)
+            count++;
+    }
+    return count;
+}
+
+/* Position of a CCCD in the configuration, by its own handle or by the handle of its value */
+static int gatt_server_cccd_find(uint16_t handle, wiced_bool_t by_value)
+{
+    const gatt_server_cccd_t *p_cccd = gatt_server_cfg->p_cccds;
+    uint8_t i;
+
+    for (i = 0; i < gatt_server_cfg->num_cccds; i++, p_cccd++)
+    {
+        if ((by_value ? p_cccd->value_handle : p_cccd->cccd_handle) == handle)
+            return i;
+    }
+    return -1;
+}
+
+uint16_t gatt_server_cccd(const gatt_server_conn_t *p_conn, uint16_t value_handle)
+{
+    int i = gatt_server_cccd_find(value_handle, WICED_TRUE);
+
+    return (i < 0) ? 0 : p_conn->cccd[i];
+}
+
+static void gatt_server_queue_flush(gatt_server_conn_t *p_conn)
+{
+    while (p_conn->queue_count != 0)
+    {
+        wiced_bt_free_buffer(p_conn->queue[p_conn->queue_first].p_val);
+        p_conn->queue_first = (p_conn->queue_first + 1) % GATT_SERVER_QUEUE_SIZE;
+        p_conn->queue_count--;
+    }
+}
+
+static wiced_bt_gatt_status_t gatt_server_send_now(gatt_server_conn_t *p_conn, uint16_t handle, uint8_t *p_val, uint16_t len, wiced_bool_t indicate)
+{
+    wiced_bt_gatt_status_t status;
+
+    if (indicate)
+    {
+        status = wiced_bt_gatt_send_indication(p_conn->conn_id, handle, len, p_val);
+        if (status == WICED_BT_GATT_SUCCESS)
+            p_conn->indication_pending = WICED_TRUE;
+    }
+    else
+    {
+        status = wiced_bt_gatt_send_notification(p_conn->conn_id, handle, len, p_val);
+    }
+
+    /* Not sent, GATT_CONGESTION_EVT tells when to try again */
+    if (status == WICED_BT_GATT_CONGESTED)
+        p_conn->congested = WICED_TRUE;
+
+    /* Out of buffers without a congestion, no event comes, try again later */
+    if ((status == WICED_BT_GATT_NO_RESOURCES) && !wiced_is_timer_in_use(&gatt_server_retry_timer))
+        wiced_start_timer(&gatt_server_retry_timer, GATT_SERVER_RETRY_MS);
+
+    return status;
+}
+
+/* Send the queued values until the link is congested or an indication waits for its confirmation */
+static void gatt_server_queue_drain(gatt_server_conn_t *p_conn)
+{
+    gatt_server_msg_t       *p_msg;
+    wiced_bt_gatt_status_t  status;
+
+    while (p_conn->queue_count != 0 && !p_conn->congested)
+    {
+        p_msg = &p_conn->queue[p_conn->queue_first];
+        if (p_msg->indicate && p_conn->indication_pending)
+            break;
+
+        status = gatt_server_send_now(p_conn, p_msg->handle, p_msg->p_val, p_msg->len, p_msg->indicate);
+        if ((status == WICED_BT_GATT_CONGESTED) || (status == WICED_BT_GATT_NO_RESOURCES))
+            break;
+        if (status != WICED_BT_GATT_SUCCESS)
+            WICED_BT_TRACE("gatt_server: conn %d hdl 0x%x dropped, status %d\n", p_conn->conn_id, p_msg->handle, status);
+
+        wiced_bt_free_buffer(p_msg->p_val);
+        p_conn->queue_first = (p_conn->queue_first + 1) % GATT_SERVER_QUEUE_SIZE;
+        p_conn->queue_count--;
+    }
+}
+
+wiced_bt_gatt_status_t gatt_server_send(gatt_server_conn_t *p_conn, uint16_t value_handle, const uint8_t *p_val, uint16_t len)
+{
+    uint16_t                cccd = gatt_server_cccd(p_conn, value_handle);
+    wiced_bool_t            indicate;
+    gatt_server_msg_t       *p_msg;
+    wiced_bt_gatt_status_t  status;
+
+    if ((cccd & (GATT_CLIENT_CONFIG_NOTIFICATION | GATT_CLIENT_CONFIG_INDICATION)) == 0)
+        return WICED_BT_GATT_CCC_CFG_ERR;
+
+    /* A client that asked for both gets notifications */
+    indicate = (cccd & GATT_CLIENT_CONFIG_NOTIFICATION) ? WICED_FALSE : WICED_TRUE;
+
+    if (len > p_conn->mtu - 3)
+        len = p_conn->mtu - 3;
+
+    /* Values waiting for buffers go first */
+    gatt_server_queue_drain(p_conn);
+
+    /* Nothing in front of it, send it right away */
+    if (p_conn->queue_count == 0 && !p_conn->congested && !(indicate && p_conn->indication_pending))
+    {
+        status = gatt_server_send_now(p_conn, value_handle, (uint8_t *) p_val, len, indicate);
+        if (status == WICED_BT_GATT_SUCCESS)
+            return WICED_BT_GATT_SUCCESS;
+        if ((status != WICED_BT_GATT_CONGESTED) && (status != WICED_BT_GATT_NO_RESOURCES))
+            return WICED_BT_GATT_ERROR;
+    }
+
+    if (p_conn->queue_count == GATT_SERVER_QUEUE_SIZE)
+    {
+        p_conn->queue_dropped++;
+        return WICED_BT_GATT_NO_RESOURCES;
+    }
+
+    p_msg = &p_conn->queue[(p_conn->queue_first + p_conn->queue_count) % GATT_SERVER_QUEUE_SIZE];
+    if ((p_msg->p_val = (uint8_t *) wiced_bt_get_buffer(len ? len : 1)) == NULL)
+    {
+        p_conn->queue_dropped++;
+        return WICED_BT_GATT_NO_RESOURCES;
+    }
+    memcpy(p_msg->p_val, p_val, len);
+    p_msg->handle   = value_handle;
+    p_msg->len      = len;
+    p_msg->indicate = indicate;
+    p_conn->queue_count++;
+
+    return WICED_BT_GATT_SUCCESS;
+}
+
+uint8_t gatt_server_send_all(uint16_t value_handle, const uint8_t *p_val, uint16_t len)
+{
+    uint8_t i, count = 0;
+
+    for (i = 0; i < gatt_server_max_conns; i++)
+    {
+        if (gatt_server_conns[i].conn_id != 0 &&
+            gatt_server_send(&gatt_server_conns[i], value_handle, p_val, len) == WICED_BT_GATT_SUCCESS)
+        {
+            count++;
+        }
+    }
+    return count;
+}
+
+static wiced_bt_gatt_status_t gatt_server_read(gatt_server_conn_t *p_conn, uint16_t conn_id, wiced_bt_gatt_read_t *p_req)
+{
+    wiced_bt_gatt_status_t  status;
+    uint8_t                 value[2];
+    uint8_t                 *p_buf;
+    uint16_t                len;
+    int                     i;
+
+    if ((i = gatt_server_cccd_find(p_req->handle, WICED_FALSE)) >= 0)
+    {
+        value[0] = (uint8_t) p_conn->cccd[i];
+        value[1] = (uint8_t) (p_conn->cccd[i] >> 8);
+        return gatt_attr_read(value, sizeof(value), p_req);
+    }
+
+    /* Most values fit in the response */
+    if (p_req->offset == 0)
+    {
+        status = gatt_server_cfg->p_read(conn_id, p_req->handle, p_req->p_val, *p_req->p_val_len, p_req->p_val_len);
+        if (status != WICED_BT_GATT_INVALID_ATTR_LEN)
+            return status;
+    }
+
+    /* Long value, or read blob: the part at the offset */
+    if ((p_buf = (uint8_t *) wiced_bt_get_buffer(GATT_SERVER_MAX_ATTR_LEN)) == NULL)
+        return WICED_BT_GATT_INSUF_RESOURCE;
+
+    status = gatt_server_cfg->p_read(conn_id, p_req->handle, p_buf, GATT_SERVER_MAX_ATTR_LEN, &len);
+    if (status == WICED_BT_GATT_SUCCESS)
+        status = gatt_attr_read(p_buf, len, p_req);
+
+    wiced_bt_free_buffer(p_buf);
+    return status;
+}
+
+static wiced_bt_gatt_status_t gatt_server_write(gatt_server_conn_t *p_conn, uint16_t conn_id, uint16_t handle, uint8_t *p_val, uint16_t len)
+{
+    int i;
+
+    if ((i = gatt_server_cccd_find(handle, WICED_FALSE)) < 0)
+        return gatt_server_cfg->p_write(conn_id, handle, p_val, len);
+
+    if (len == 0 || len > 2)
+        return WICED_BT_GATT_INVALID_ATTR_LEN;
+
+    p_conn->cccd[i] = p_val[0] | ((len > 1) ? (p_val[1] << 8) : 0);
+
+    if (gatt_server_cfg->p_cccd_cb != NULL)
+        gatt_server_cfg->p_cccd_cb(p_conn, gatt_server_cfg->p_cccds[i].value_handle, p_conn->cccd[i]);
+
+    return WICED_BT_GATT_SUCCESS;
+}
+
+static void gatt_server_prep_write_free(gatt_server_conn_t *p_conn)
+{
+    if (p_conn->p_prep_val != NULL)
+    {
+        wiced_bt_free_buffer(p_conn->p_prep_val);
+        p_conn->p_prep_val = NULL;
+    }
+    p_conn->prep_len = 0;
+}
+
+/*
+ * Keep a prepared write until the execute. The writes of one execute must be
+ * for the same attribute; they are reassembled over its current value so that
+ * writes at an offset keep the bytes in front of them.
+ */
+static wiced_bt_gatt_status_t gatt_server_prep_write(gatt_server_conn_t *p_conn, uint16_t conn_id, wiced_bt_gatt_write_t *p_req)
+{
+    uint16_t len;
+
+    if (p_conn->p_prep_val == NULL)
+    {
+        if ((p_conn->p_prep_val = (uint8_t *) wiced_bt_get_buffer(GATT_SERVER_MAX_ATTR_LEN)) == NULL)
+            return WICED_BT_GATT_PREPARE_Q_FULL;
+
+        p_conn->prep_handle = p_req->handle;
+        p_conn->prep_len    = 0;
+        if (gatt_server_cccd_find(p_req->handle, WICED_FALSE) >= 0 ||
+            gatt_server_cfg->p_read(conn_id, p_req->handle, p_conn->p_prep_val, GATT_SERVER_MAX_ATTR_LEN, &len) != WICED_BT_GATT_SUCCESS)
+        {
+            memset(p_conn->p_prep_val, 0, GATT_SERVER_MAX_ATTR_LEN);
+        }
+    }
+    else if (p_conn->prep_handle != p_req->handle)
+    {
+        WICED_BT_TRACE("gatt_server: prep write hdl 0x%x while 0x%x queued\n", p_req->handle, p_conn->prep_handle);
+        return WICED_BT_GATT_PREPARE_Q_FULL;
+    }
+
+    if (p_req->offset > GATT_SERVER_MAX_ATTR_LEN)
+        return WICED_BT_GATT_INVALID_OFFSET;
+    if (p_req->offset + p_req->val_len > GATT_SERVER_MAX_ATTR_LEN)
+        return WICED_BT_GATT_PREPARE_Q_FULL;
+
+    memcpy(&p_conn->p_prep_val[p_req->offset], p_req->p_val, p_req->val_len);
+    if (p_req->offset + p_req->val_len > p_conn->prep_len)
+        p_conn->prep_len = p_req->offset + p_req->val_len;
+
+    return WICED_BT_GATT_SUCCESS;
+}
+
+/* Apply the reassembled value in one write, or drop it if the client cancelled */
+static wiced_bt_gatt_status_t gatt_server_write_exec(gatt_server_conn_t *p_conn, uint16_t conn_id, wiced_bt_gatt_exec_flag_t exec_flag)
+{
+    wiced_bt_gatt_status_t status = WICED_BT_GATT_SUCCESS;
+
+    if (exec_flag == GATT_PREP_WRITE_EXEC && p_conn->p_prep_val != NULL)
+        status = gatt_server_write(p_conn, conn_id, p_conn->prep_handle, p_conn->p_prep_val, p_conn->prep_len);
+
+    gatt_server_prep_write_free(p_conn);
+    return status;
+}
+
+static wiced_bt_gatt_status_t gatt_server_request(wiced_bt_gatt_attribute_request_t *p_req)
+{
+    gatt_server_conn_t      *p_conn;
+    wiced_bt_gatt_status_t  status = WICED_BT_GATT_INVALID_PDU;
+
+    if (gatt_server_cfg->p_request_hook != NULL && gatt_server_cfg->p_request_hook(p_req, &status))
+        return status;
+
+    if ((p_conn = gatt_server_conn_find(p_req->conn_id)) == NULL)
+        return WICED_BT_GATT_ERROR;
+
+    switch (p_req->request_type)
+    {
+    case GATTS_REQ_TYPE_READ:
+        status = gatt_server_read(p_conn, p_req->conn_id, &p_req->data.read_req);
+        break;
+
+    case GATTS_REQ_TYPE_WRITE:
+        if (p_req->data.write_req.is_prep)
+            status = gatt_server_prep_write(p_conn, p_req->conn_id, &p_req->data.write_req);
+        else
+            status = gatt_server_write(p_conn, p_req->conn_id, p_req->data.write_req.handle,
+                                       p_req->data.write_req.p_val, p_req->data.write_req.val_len);
+        break;
+
+    case GATTS_REQ_TYPE_WRITE_EXEC:
+        status = gatt_server_write_exec(p_conn, p_req->conn_id, p_req->data.exec_write);
+        break;
+
+    case GATTS_REQ_TYPE_MTU:
+        p_conn->mtu = p_req->data.mtu;
+        status = WICED_BT_GATT_SUCCESS;
+        break;
+
+    case GATTS_REQ_TYPE_CONF:
+        p_conn->indication_pending = WICED_FALSE;
+        gatt_server_queue_drain(p_conn);
+        status = WICED_BT_GATT_SUCCESS;
+        break;
+
+    default:
+        break;
+    }
+    return status;
+}
+
+static void gatt_server_conn_status(wiced_bt_gatt_connection_status_t *p_status)
+{
+    gatt_server_conn_t *p_conn;
+
+    if (p_status->connected)
+    {
+        if ((p_conn = gatt_server_conn_find(0)) != NULL)
+        {
+            memset(p_conn, 0, sizeof(*p_conn));
+            p_conn->conn_id   = p_status->conn_id;
+            p_conn->addr_type = p_status->addr_type;
+            p_conn->mtu       = GATT_DEF_BLE_MTU_SIZE;
+            memcpy(p_conn->bd_addr, p_status->bd_addr, BD_ADDR_LEN);
+        }
+        else
+        {
+            WICED_BT_TRACE("gatt_server: no room for conn %d\n", p_status->conn_id);
+        }
+
+        gatt_server_cfg->p_conn_cb(p_conn, p_status);
+        if (p_conn == NULL)
+            wiced_bt_gatt_disconnect(p_status->conn_id);
+    }
+    else
+    {
+        p_conn = gatt_server_conn_find(p_status->conn_id);
+
+        gatt_server_cfg->p_conn_cb(p_conn, p_status);
+        if (p_conn != NULL)
+        {
+            gatt_server_queue_flush(p_conn);
+            gatt_server_prep_write_free(p_conn);
+            p_conn->conn_id = 0;
+        }
+    }
+}
+
+wiced_bt_gatt_status_t gatt_server_event_handler(wiced_bt_gatt_evt_t event, wiced_bt_gatt_event_data_t *p_data)
+{
+    gatt_server_conn_t *p_conn;
+
+    switch (event)
+    {
+    case GATT_CONNECTION_STATUS_EVT:
+        gatt_server_conn_status(&p_data->connection_status);
+        return WICED_BT_GATT_SUCCESS;
+
+    case GATT_ATTRIBUTE_REQUEST_EVT:
+        return gatt_server_request(&p_data->attribute_request);
+
+    case GATT_CONGESTION_EVT:
+        if ((p_conn = gatt_server_conn_find(p_data->congestion.conn_id)) != NULL)
+        {
+            p_conn->congested = p_data->congestion.congested;
+            gatt_server_queue_drain(p_conn);
+        }
+        if (gatt_server_cfg->p_congestion_cb != NULL)
+            gatt_server_cfg->p_congestion_cb(p_data->congestion.conn_id, p_data->congestion.congested);
+        return WICED_BT_GATT_SUCCESS;
+
+    default:
+        break;
+    }
+
+    if (gatt_server_cfg->p_event_cb != NULL)
+        return gatt_server_cfg->p_event_cb(event, p_data);
+    return WICED_BT_GATT_SUCCESS;
+}
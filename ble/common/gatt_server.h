@@ -0,0 +1,206 @@
+/*
+ * Copyright 2016-2020, Cypress Semiconductor Corporation or a subsidiary of
+ * Cypress Semiconductor Corporation. All Rights Reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software"), is owned by Cypress Semiconductor Corporation
+ * or one of its subsidiaries ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products. Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ */
+
+/** @file
+ *
+ * GATT server core shared by the example applications
+ *
+ * The core takes the GATT events of the stack, keeps the state of each
+ * connection and serves the attribute requests: reads, read blobs, writes,
+ * prepared writes and their execution. The application gives the access to
+ * its attribute values, usually through a gatt_attr_store_t, and the Client
+ * Characteristic Configuration descriptors it has. The core keeps those per
+ * connection, so the applications only ask whether a client subscribed.
+ *
+ * Notifications and indications go through a queue per connection. A value
+ * is sent when the link has room, otherwise a copy waits for the congestion
+ * to end, or for the confirmation of the indication in front of it. When the
+ * stack is out of buffers without a congestion, the queue is sent again after
+ * GATT_SERVER_RETRY_MS.
+ *
+ * There is one server per device; gatt_server_event_handler() is the
+ * callback to give to wiced_bt_gatt_register().
+ */
+
+#pragma once
+
+#include "wiced_bt_types.h"
+#include "wiced_bt_gatt.h"
+
+/******************************************************
+ *                     Constants
+ ******************************************************/
+
+/* Client Characteristic Configuration descriptors kept per connection */
+#ifndef GATT_SERVER_MAX_CCCDS
+#define GATT_SERVER_MAX_CCCDS               4
+#endif
+
+/* Notifications and indications waiting per connection */
+#ifndef GATT_SERVER_QUEUE_SIZE
+#define GATT_SERVER_QUEUE_SIZE              4
+#endif
+
+/* Delay before sending the queue again after the stack ran out of buffers */
+#ifndef GATT_SERVER_RETRY_MS
+#define GATT_SERVER_RETRY_MS                20
+#endif
+
+/* Longest attribute value, for read blobs and prepared writes */
+#ifndef GATT_SERVER_MAX_ATTR_LEN
+#define GATT_SERVER_MAX_ATTR_LEN            512
+#endif
+
+/******************************************************
+ *                 Type Definitions
+ ******************************************************/
+
+/* A characteristic value and its Client Characteristic Configuration descriptor */
+typedef struct
+{
+    uint16_t        value_handle;
+    uint16_t        cccd_handle;
+} gatt_server_cccd_t;
+
+typedef struct
+{
+    uint8_t         *p_val;             /* copy of the value */
+    uint16_t        handle;
+    uint16_t        len;
+    wiced_bool_t    indicate;
+} gatt_server_msg_t;
+
+typedef struct
+{
+    uint16_t                    conn_id;            /* 0 if the entry is free */
+    wiced_bt_device_address_t   bd_addr;
+    uint8_t                     addr_type;
+    uint16_t                    mtu;
+    wiced_bool_t                congested;
+    wiced_bool_t                indication_pending; /* waiting for its confirmation */
+    uint16_t                    cccd[GATT_SERVER_MAX_CCCDS];
+    gatt_server_msg_t           queue[GATT_SERVER_QUEUE_SIZE];
+    uint8_t                     queue_first;
+    uint8_t                     queue_count;
+    uint32_t                    queue_dropped;
+    uint16_t                    prep_handle;        /* attribute of the prepared writes */
+    uint16_t                    prep_len;           /* end of the furthest prepared write */
+    uint8_t                     *p_prep_val;        /* reassembled value, allocated on the first prepare */
+} gatt_server_conn_t;
+
+/* Access to the attribute values, the CCCDs given in the configuration are not read or written with them */
+typedef wiced_bt_gatt_status_t (*gatt_server_read_cb_t)(uint16_t conn_id, uint16_t handle, uint8_t *p_val, uint16_t len, uint16_t *p_len);
+typedef wiced_bt_gatt_status_t (*gatt_server_write_cb_t)(uint16_t conn_id, uint16_t handle, uint8_t *p_val, uint16_t len);
+
+/*
+ * Connection up or down. p_conn is the new entry on a connection, and the
+ * entry about to be freed on a disconnection. It is NULL when there was no
+ * free entry, the core then disconnects.
+ */
+typedef void (*gatt_server_conn_cb_t)(gatt_server_conn_t *p_conn, wiced_bt_gatt_connection_status_t *p_status);
+
+/* A client wrote a CCCD */
+typedef void (*gatt_server_cccd_cb_t)(gatt_server_conn_t *p_conn, uint16_t value_handle, uint16_t cccd);
+
+/* Sees the attribute requests first, returns WICED_TRUE with *p_status for the ones it served */
+typedef wiced_bool_t (*gatt_server_request_hook_t)(wiced_bt_gatt_attribute_request_t *p_req, wiced_bt_gatt_status_t *p_status);
+
+typedef struct
+{
+    gatt_server_read_cb_t       p_read;
+    gatt_server_write_cb_t      p_write;
+    const gatt_server_cccd_t    *p_cccds;
+    uint8_t                     num_cccds;          /* up to GATT_SERVER_MAX_CCCDS */
+    gatt_server_conn_cb_t       p_conn_cb;
+    gatt_server_cccd_cb_t       p_cccd_cb;          /* optional */
+    gatt_server_request_hook_t  p_request_hook;     /* optional, OTA firmware upgrade for instance */
+    void                        (*p_congestion_cb)(uint16_t conn_id, wiced_bool_t congested);  /* optional */
+    wiced_bt_gatt_cback_t       *p_event_cb;        /* optional, the other GATT events */
+} gatt_server_cfg_t;
+
+/******************************************************
+ *               Function Declarations
+ ******************************************************/
+
+/**
+ * Start the server with the connection entries of the application. The
+ * configuration and the entries must stay in place.
+ */
+void gatt_server_init(const gatt_server_cfg_t *p_cfg, gatt_server_conn_t *p_conns, uint8_t max_conns);
+
+/**
+ * GATT event callback, for wiced_bt_gatt_register().
+ */
+wiced_bt_gatt_status_t gatt_server_event_handler(wiced_bt_gatt_evt_t event, wiced_bt_gatt_event_data_t *p_data);
+
+/**
+ * Find the entry of a connection.
+ *
+ * @return  the entry, or NULL if not connected
+ */
+gatt_server_conn_t *gatt_server_conn_find(uint16_t conn_id);
+
+/**
+ * Position of an entry in the array given to gatt_server_init(), to keep
+ * the application state of a connection in an array of its own.
+ */
+uint8_t gatt_server_conn_index(const gatt_server_conn_t *p_conn);
+
+/**
+ * Number of connected clients.
+ */
+uint8_t gatt_server_num_conns(void);
+
+/**
+ * CCCD value of a characteristic for a connection.
+ *
+ * @return  GATT_CLIENT_CONFIG_xx bits, 0 if the characteristic has no CCCD
+ */
+uint16_t gatt_server_cccd(const gatt_server_conn_t *p_conn, uint16_t value_handle);
+
+/**
+ * Notify, or indicate, a value to a client, as its CCCD asks. Values are
+ * truncated to the MTU. The value is copied if it has to wait.
+ *
+ * @return  WICED_BT_GATT_SUCCESS if the value is sent or queued,
+ *          WICED_BT_GATT_CCC_CFG_ERR if the client did not subscribe,
+ *          WICED_BT_GATT_NO_RESOURCES if the queue is full
+ */
+wiced_bt_gatt_status_t gatt_server_send(gatt_server_conn_t *p_conn, uint16_t value_handle, const uint8_t *p_val, uint16_t len);
+
+/**
+ * gatt_server_send() to every client.
+ *
+ * @return  the number of clients the value was sent or queued to
+ */
+uint8_t gatt_server_send_all(uint16_t value_handle, const uint8_t *p_val, uint16_t len);
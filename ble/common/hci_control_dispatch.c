@@ -0,0 +1,112 @@
+/*
+ * Copyright 2016-2020, Cypress Semiconductor Corporation or a subsidiary of
+ * Cypress Semiconductor Corporation. All Rights Reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software"), is owned by Cypress Semiconductor Corporation
+ * or one of its subsidiaries ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products. Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ */
+
+/** @file
+ *
+ * Table driven dispatch of WICED HCI control commands
+ */
+
+#include "hci_control_dispatch.h"
+#include "hci_control_api.h"
+
+/******************************************************
+ *               Function Definitions
+ ******************************************************/
+const hci_control_cmd_entry_t *hci_control_find_cmd(const hci_control_cmd_entry_t *p_table, uint16_t num_entries, uint16_t opcode)
+{
+    uint16_t low = 0;
+    uint16_t high = num_entries;
+    uint16_t mid;
+
+    while (low < high)
+    {
+        mid = low + ((high - low) / 2);
+
+        if (p_table[mid].opcode == opcode)
+            return &p_table[mid];
+
+        if (p_table[mid].opcode < opcode)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+
+    return NULL;
+}
+
+uint8_t hci_control_dispatch(const hci_control_cmd_entry_t *p_table, uint16_t num_entries, uint16_t opcode, uint8_t *p_data, uint32_t data_len)
+{
+    const hci_control_cmd_entry_t *p_entry = hci_control_find_cmd(p_table, num_entries, opcode);
+
+    if (p_entry == NULL)
+    {
+        WICED_BT_TRACE("[%s] opcode 0x%04x not handled\n", __func__, opcode);
+        return HCI_CONTROL_STATUS_UNKNOWN_COMMAND;
+    }
+
+    if (data_len < p_entry->min_len)
+    {
+        WICED_BT_TRACE("[%s] opcode 0x%04x payload %d < %d\n", __func__, opcode, data_len, p_entry->min_len);
+        return HCI_CONTROL_STATUS_INVALID_ARGS;
+    }
+
+    return p_entry->handler(opcode, p_data, data_len);
+}
+
+const char *hci_control_cmd_name(const hci_control_cmd_entry_t *p_table, uint16_t num_entries, uint16_t opcode)
+{
+#ifdef WICED_BT_TRACE_ENABLE
+    const hci_control_cmd_entry_t *p_entry = hci_control_find_cmd(p_table, num_entries, opcode);
+
+    if (p_entry != NULL)
+        return p_entry->name;
+#endif
+
+    return "** UNKNOWN **";
+}
+
+wiced_bool_t hci_control_check_cmd_table(const hci_control_cmd_entry_t *p_table, uint16_t num_entries)
+{
+    uint16_t i;
+
+    for (i = 1; i < num_entries; i++)
+    {
+        if (p_table[i].opcode <= p_table[i - 1].opcode)
+        {
+            WICED_BT_TRACE("[%s] entry %d opcode 0x%04x out of order\n", __func__, i, p_table[i].opcode);
+            return WICED_FALSE;
+        }
+    }
+
+    return WICED_TRUE;
+}
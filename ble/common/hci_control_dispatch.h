@@ -0,0 +1,106 @@
+/*
+ * Copyright 2016-2020, Cypress Semiconductor Corporation or a subsidiary of
+ * Cypress Semiconductor Corporation. All Rights Reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software"), is owned by Cypress Semiconductor Corporation
+ * or one of its subsidiaries ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products. Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ */
+
+/** @file
+ *
+ * Table driven dispatch of WICED HCI control commands
+ *
+ * An application describes the commands it handles in a constant table of
+ * hci_control_cmd_entry_t sorted by opcode. hci_control_dispatch() finds the
+ * entry with a binary search, checks the payload length against the minimum
+ * given in the table and calls the handler. Command names are kept in the
+ * table only when tracing is enabled.
+ */
+
+#pragma once
+
+#include "wiced_bt_types.h"
+#include "wiced_bt_trace.h"
+
+/******************************************************
+ *                 Type Definitions
+ ******************************************************/
+
+/* Command handler. Returns one of the HCI_CONTROL_STATUS_xx codes */
+typedef uint8_t (*hci_control_cmd_handler_t)(uint16_t opcode, uint8_t *p_data, uint32_t data_len);
+
+typedef struct
+{
+    uint16_t                    opcode;
+    uint16_t                    min_len;    /* shortest valid payload */
+    hci_control_cmd_handler_t   handler;
+#ifdef WICED_BT_TRACE_ENABLE
+    const char                  *name;
+#endif
+} hci_control_cmd_entry_t;
+
+/* Table entry; the entries of a table must be sorted by opcode */
+#ifdef WICED_BT_TRACE_ENABLE
+#define HCI_CONTROL_CMD_ENTRY(opcode, min_len, handler)     { (opcode), (min_len), (handler), #opcode }
+#else
+#define HCI_CONTROL_CMD_ENTRY(opcode, min_len, handler)     { (opcode), (min_len), (handler) }
+#endif
+
+#define HCI_CONTROL_CMD_TABLE_SIZE(table)                   ( sizeof(table) / sizeof((table)[0]) )
+
+/******************************************************
+ *               Function Declarations
+ ******************************************************/
+
+/**
+ * Find the entry for an opcode in a table sorted by opcode.
+ *
+ * @return  the entry, or NULL if the opcode is not in the table
+ */
+const hci_control_cmd_entry_t *hci_control_find_cmd(const hci_control_cmd_entry_t *p_table, uint16_t num_entries, uint16_t opcode);
+
+/**
+ * Dispatch a command to its handler.
+ *
+ * @return  the handler status, HCI_CONTROL_STATUS_UNKNOWN_COMMAND if the opcode
+ *          is not in the table or HCI_CONTROL_STATUS_INVALID_ARGS if the
+ *          payload is shorter than the entry's minimum length
+ */
+uint8_t hci_control_dispatch(const hci_control_cmd_entry_t *p_table, uint16_t num_entries, uint16_t opcode, uint8_t *p_data, uint32_t data_len);
+
+/**
+ * Name of the command for traces. Only looks the name up when tracing is enabled.
+ */
+const char *hci_control_cmd_name(const hci_control_cmd_entry_t *p_table, uint16_t num_entries, uint16_t opcode);
+
+/**
+ * Check that a table is sorted by opcode (traces the first offending entry).
+ *
+ * @return  WICED_TRUE if the table can be used with hci_control_dispatch()
+ */
+wiced_bool_t hci_control_check_cmd_table(const hci_control_cmd_entry_t *p_table, uint16_t num_entries);
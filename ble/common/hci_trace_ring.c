@@ -0,0 +1,158 @@
+/*
+ * Copyright 2016-2020, Cypress Semiconductor Corporation or a subsidiary of
+ * Cypress Semiconductor Corporation. All Rights Reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software"), is owned by Cypress Semiconductor Corporation
+ * or one of its subsidiaries ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products. Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ */
+
+/** @file
+ *
+ * Ring buffer of the HCI traces forwarded to the host
+ */
+
+#include <string.h>
+#include "wiced_bt_trace.h"
+#include "wiced_transport.h"
+#include "hci_trace_ring.h"
+
+/******************************************************
+ *               Variables Definitions
+ ******************************************************/
+
+const hci_trace_ring_filter_t hci_trace_ring_default_filters[HCI_TRACE_RING_NUM_DEFAULT_FILTERS] =
+{
+    { HCI_TRACE_EVENT, 0x13 },      /* Number of Completed Packets */
+};
+
+/******************************************************
+ *               Function Definitions
+ ******************************************************/
+
+static uint8_t *hci_trace_ring_slot(hci_trace_ring_t *p_ring, uint16_t index)
+{
+    return p_ring->p_buf + ((uint32_t) index * (HCI_TRACE_RING_SLOT_HDR_SIZE + p_ring->p_cfg->max_payload));
+}
+
+static wiced_bool_t hci_trace_ring_filtered(const hci_trace_ring_cfg_t *p_cfg, wiced_bt_hci_trace_type_t type, uint16_t length, const uint8_t *p_data)
+{
+    uint16_t opcode;
+    uint8_t i;
+
+    if ((p_cfg->type_mask & HCI_TRACE_RING_TYPE(type)) == 0)
+        return WICED_TRUE;
+
+    if (type == HCI_TRACE_COMMAND && length >= 2)
+        opcode = p_data[0] | (p_data[1] << 8);
+    else if (type == HCI_TRACE_EVENT && length >= 3 && p_data[0] == 0x3E)
+        opcode = HCI_TRACE_RING_LE_EVENT(p_data[2]);
+    else if (type == HCI_TRACE_EVENT && length >= 1)
+        opcode = p_data[0];
+    else
+        return WICED_FALSE;
+
+    for (i = 0; i < p_cfg->num_filters; i++)
+    {
+        if (p_cfg->p_filters[i].type == type && p_cfg->p_filters[i].opcode == opcode)
+            return WICED_TRUE;
+    }
+    return WICED_FALSE;
+}
+
+static void hci_trace_ring_drain(uint32_t arg)
+{
+    hci_trace_ring_t *p_ring = (hci_trace_ring_t *) arg;
+    uint8_t *p_slot;
+    uint8_t sent;
+
+    for (sent = 0; sent < p_ring->p_cfg->drain_count && p_ring->count != 0; sent++)
+    {
+        p_slot = hci_trace_ring_slot(p_ring, p_ring->first);
+
+        if (p_ring->p_cfg->p_send != NULL)
+            p_ring->p_cfg->p_send(p_slot[0], p_slot[1] | (p_slot[2] << 8), &p_slot[HCI_TRACE_RING_SLOT_HDR_SIZE]);
+        else
+            wiced_transport_send_hci_trace(NULL, p_slot[0], p_slot[1] | (p_slot[2] << 8), &p_slot[HCI_TRACE_RING_SLOT_HDR_SIZE]);
+
+        p_ring->first = (p_ring->first + 1) % p_ring->num_slots;
+        p_ring->count--;
+    }
+
+    if (p_ring->count != 0)
+    {
+        wiced_start_timer(&p_ring->drain_timer, p_ring->p_cfg->drain_interval_ms);
+    }
+    else if (p_ring->dropped != p_ring->reported_dropped)
+    {
+        WICED_BT_TRACE("hci trace: %d dropped, %d truncated, %d filtered\n", p_ring->dropped, p_ring->truncated, p_ring->filtered);
+        p_ring->reported_dropped = p_ring->dropped;
+    }
+}
+
+void hci_trace_ring_init(hci_trace_ring_t *p_ring, const hci_trace_ring_cfg_t *p_cfg, uint8_t *p_buf, uint16_t buf_size)
+{
+    memset(p_ring, 0, sizeof(*p_ring));
+    p_ring->p_cfg     = p_cfg;
+    p_ring->p_buf     = p_buf;
+    p_ring->num_slots = buf_size / (HCI_TRACE_RING_SLOT_HDR_SIZE + p_cfg->max_payload);
+
+    wiced_init_timer(&p_ring->drain_timer, hci_trace_ring_drain, (uint32_t) p_ring, WICED_MILLI_SECONDS_TIMER);
+}
+
+void hci_trace_ring_put(hci_trace_ring_t *p_ring, wiced_bt_hci_trace_type_t type, uint16_t length, uint8_t *p_data)
+{
+    uint8_t *p_slot;
+
+    if (hci_trace_ring_filtered(p_ring->p_cfg, type, length, p_data))
+    {
+        p_ring->filtered++;
+        return;
+    }
+
+    if (p_ring->count >= p_ring->num_slots)
+    {
+        p_ring->dropped++;
+        return;
+    }
+
+    if (length > p_ring->p_cfg->max_payload)
+    {
+        length = p_ring->p_cfg->max_payload;
+        p_ring->truncated++;
+    }
+
+    p_slot = hci_trace_ring_slot(p_ring, (p_ring->first + p_ring->count) % p_ring->num_slots);
+    p_slot[0] = (uint8_t) type;
+    p_slot[1] = (uint8_t) length;
+    p_slot[2] = (uint8_t) (length >> 8);
+    memcpy(&p_slot[HCI_TRACE_RING_SLOT_HDR_SIZE], p_data, length);
+    p_ring->count++;
+
+    if (!wiced_is_timer_in_use(&p_ring->drain_timer))
+        wiced_start_timer(&p_ring->drain_timer, p_ring->p_cfg->drain_interval_ms);
+}
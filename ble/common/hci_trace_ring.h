@@ -0,0 +1,151 @@
+/*
+ * Copyright 2016-2020, Cypress Semiconductor Corporation or a subsidiary of
+ * Cypress Semiconductor Corporation. All Rights Reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software"), is owned by Cypress Semiconductor Corporation
+ * or one of its subsidiaries ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products. Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ */
+
+/** @file
+ *
+ * Ring buffer of the HCI traces forwarded to the host
+ *
+ * Sending every HCI packet to the host from the trace callback can take the
+ * whole UART and changes the timing being debugged. The ring keeps the
+ * packets instead, filtered by type and opcode and truncated to a maximum
+ * payload, and a timer sends a bounded number of them per interval. The
+ * packets that do not fit are counted and the count is traced once the ring
+ * has drained.
+ */
+
+#pragma once
+
+#include "wiced_bt_types.h"
+#include "wiced_bt_dev.h"
+#include "wiced_timer.h"
+
+/******************************************************
+ *                     Constants
+ ******************************************************/
+
+/* Opcode of an LE meta event in the filters, the other events use their event code */
+#define HCI_TRACE_RING_LE_EVENT(subevent)       ( 0x3E00 | (subevent) )
+
+/* Bytes of ring buffer for num_slots packets of at most max_payload bytes */
+#define HCI_TRACE_RING_BUF_SIZE(num_slots, max_payload) \
+    ( (num_slots) * ( HCI_TRACE_RING_SLOT_HDR_SIZE + (max_payload) ) )
+
+#define HCI_TRACE_RING_SLOT_HDR_SIZE            3   /* type, length */
+
+/* Bit of a wiced_bt_hci_trace_type_t in type_mask */
+#define HCI_TRACE_RING_TYPE(type)               ( 1 << (type) )
+#define HCI_TRACE_RING_ALL_TYPES                0xFFFF
+
+/* Defaults of HCI_TRACE_RING_CFG_DEFAULT(), an application can set them in its makefile */
+#ifndef HCI_TRACE_RING_SLOTS
+#define HCI_TRACE_RING_SLOTS                    16
+#endif
+#ifndef HCI_TRACE_RING_MAX_PAYLOAD
+#define HCI_TRACE_RING_MAX_PAYLOAD              64
+#endif
+#ifndef HCI_TRACE_RING_DRAIN_INTERVAL_MS
+#define HCI_TRACE_RING_DRAIN_INTERVAL_MS        10
+#endif
+#ifndef HCI_TRACE_RING_DRAIN_COUNT
+#define HCI_TRACE_RING_DRAIN_COUNT              4
+#endif
+
+/* Number of Completed Packets events, one per few ACL packets */
+#define HCI_TRACE_RING_NUM_DEFAULT_FILTERS      1
+
+/******************************************************
+ *                 Type Definitions
+ ******************************************************/
+
+/* A packet type and opcode not kept */
+typedef struct
+{
+    wiced_bt_hci_trace_type_t   type;
+    uint16_t                    opcode;     /* command opcode, event code or HCI_TRACE_RING_LE_EVENT() */
+} hci_trace_ring_filter_t;
+
+typedef void (*hci_trace_ring_send_t)(wiced_bt_hci_trace_type_t type, uint16_t length, uint8_t *p_data);
+
+typedef struct
+{
+    uint16_t                        type_mask;          /* HCI_TRACE_RING_TYPE() of the packets kept */
+    const hci_trace_ring_filter_t   *p_filters;
+    uint8_t                         num_filters;
+    uint16_t                        max_payload;        /* longer packets are truncated */
+    uint16_t                        drain_interval_ms;
+    uint8_t                         drain_count;        /* packets sent per interval */
+    hci_trace_ring_send_t           p_send;             /* NULL for wiced_transport_send_hci_trace() */
+} hci_trace_ring_cfg_t;
+
+typedef struct
+{
+    const hci_trace_ring_cfg_t  *p_cfg;
+    uint8_t                     *p_buf;
+    uint16_t                    num_slots;
+    uint16_t                    first;
+    uint16_t                    count;
+    wiced_timer_t               drain_timer;
+    uint32_t                    dropped;            /* ring full */
+    uint32_t                    truncated;
+    uint32_t                    filtered;
+    uint32_t                    reported_dropped;   /* dropped when last traced */
+} hci_trace_ring_t;
+
+/* Configuration with the defaults above, filtering hci_trace_ring_default_filters */
+#define HCI_TRACE_RING_CFG_DEFAULT(send)                        \
+{                                                               \
+    .type_mask          = HCI_TRACE_RING_ALL_TYPES,             \
+    .p_filters          = hci_trace_ring_default_filters,       \
+    .num_filters        = HCI_TRACE_RING_NUM_DEFAULT_FILTERS,   \
+    .max_payload        = HCI_TRACE_RING_MAX_PAYLOAD,           \
+    .drain_interval_ms  = HCI_TRACE_RING_DRAIN_INTERVAL_MS,     \
+    .drain_count        = HCI_TRACE_RING_DRAIN_COUNT,           \
+    .p_send             = (send),                               \
+}
+
+extern const hci_trace_ring_filter_t hci_trace_ring_default_filters[HCI_TRACE_RING_NUM_DEFAULT_FILTERS];
+
+/******************************************************
+ *               Function Declarations
+ ******************************************************/
+
+/**
+ * Initialize a ring over buf_size bytes of p_buf, sized with
+ * HCI_TRACE_RING_BUF_SIZE() for the max_payload of p_cfg.
+ */
+void hci_trace_ring_init(hci_trace_ring_t *p_ring, const hci_trace_ring_cfg_t *p_cfg, uint8_t *p_buf, uint16_t buf_size);
+
+/**
+ * Keep a packet from the HCI trace callback, and start the drain timer.
+ */
+void hci_trace_ring_put(hci_trace_ring_t *p_ring, wiced_bt_hci_trace_type_t type, uint16_t length, uint8_t *p_data);
@@ -0,0 +1,112 @@
+/*
+ * Copyright 2016-2020, Cypress Semiconductor Corporation or a subsidiary of
+ * Cypress Semiconductor Corporation. All Rights Reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software"), is owned by Cypress Semiconductor Corporation
+ * or one of its subsidiaries ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products. Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ */
+
+
+/** @file
+ *
+ * Latency probes along the data path
+ */
+
+#include <string.h>
+#include "wiced_timer.h"
+#include "wiced_transport.h"
+#include "latency_probe.h"
+
+#ifdef LATENCY_PROBES
+
+/******************************************************
+ *               Variables Definitions
+ ******************************************************/
+
+static latency_probe_rec_t  latency_probe_ring[LATENCY_PROBE_RING_SIZE];
+static uint16_t             latency_probe_first;
+static uint16_t             latency_probe_count;
+static uint16_t             latency_probe_overwritten;
+
+/******************************************************
+ *               Function Definitions
+ ******************************************************/
+
+void latency_probe_record(uint8_t point, uint16_t arg)
+{
+    latency_probe_rec_t *p_rec;
+
+    if (latency_probe_count == LATENCY_PROBE_RING_SIZE)
+    {
+        latency_probe_first = (latency_probe_first + 1) & (LATENCY_PROBE_RING_SIZE - 1);
+        latency_probe_count--;
+        if (latency_probe_overwritten != 0xFFFF)
+            latency_probe_overwritten++;
+    }
+
+    p_rec = &latency_probe_ring[(latency_probe_first + latency_probe_count) & (LATENCY_PROBE_RING_SIZE - 1)];
+    p_rec->timestamp_us = (uint32_t) clock_SystemTimeMicroseconds64();
+    p_rec->point        = point;
+    p_rec->arg          = arg;
+    latency_probe_count++;
+}
+
+uint8_t latency_probe_cmd_read(uint16_t opcode, uint8_t *p_data, uint32_t data_len)
+{
+    uint8_t             evt[3 + LATENCY_PROBE_EVENT_RECORDS * 7], *p;
+    latency_probe_rec_t *p_rec;
+    uint8_t             num;
+
+    // at least one event, the last one is not full
+    do
+    {
+        num = (latency_probe_count < LATENCY_PROBE_EVENT_RECORDS) ? latency_probe_count : LATENCY_PROBE_EVENT_RECORDS;
+
+        p = evt;
+        UINT16_TO_STREAM(p, latency_probe_overwritten);
+        UINT8_TO_STREAM(p, num);
+        latency_probe_overwritten = 0;
+
+        while (num--)
+        {
+            p_rec = &latency_probe_ring[latency_probe_first];
+            UINT32_TO_STREAM(p, p_rec->timestamp_us);
+            UINT8_TO_STREAM(p, p_rec->point);
+            UINT16_TO_STREAM(p, p_rec->arg);
+
+            latency_probe_first = (latency_probe_first + 1) & (LATENCY_PROBE_RING_SIZE - 1);
+            latency_probe_count--;
+        }
+
+        wiced_transport_send_data(HCI_CONTROL_MISC_EVENT_PROBES, evt, (uint16_t) (p - evt));
+    } while (evt[2] == LATENCY_PROBE_EVENT_RECORDS);
+
+    return HCI_CONTROL_STATUS_SUCCESS;
+}
+
+#endif
@@ -0,0 +1,122 @@
+/*
+ * Copyright 2016-2020, Cypress Semiconductor Corporation or a subsidiary of
+ * Cypress Semiconductor Corporation. All Rights Reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software"), is owned by Cypress Semiconductor Corporation
+ * or one of its subsidiaries ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products. Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ */
+
+
+/** @file
+ *
+ * Latency probes along the data path
+ *
+ * A probe records the microsecond clock of the chip, a probe point and a
+ * 16 bits argument (an opcode, a connection id, a channel id) in a ring.
+ * When the ring is full the oldest records are overwritten and counted.
+ * HCI_CONTROL_MISC_COMMAND_READ_PROBES sends the records to the host in
+ * HCI_CONTROL_MISC_EVENT_PROBES events and empties the ring. The time
+ * between two points, host command to air and back, is then measured
+ * instead of guessed.
+ *
+ * LATENCY_PROBE() compiles to nothing unless the application is built with
+ * LATENCY_PROBES defined, the ring then takes LATENCY_PROBE_RING_SIZE
+ * records of 8 bytes.
+ */
+
+#pragma once
+
+#include "wiced_bt_types.h"
+#include "hci_control_api.h"
+
+/******************************************************
+ *                     Constants
+ ******************************************************/
+
+/* No payload */
+#ifndef HCI_CONTROL_MISC_COMMAND_READ_PROBES
+#define HCI_CONTROL_MISC_COMMAND_READ_PROBES    ( ( HCI_CONTROL_GROUP_MISC << 8 ) | 0x24 )
+#endif
+
+/*
+ * Payload: records overwritten since the previous read (uint16), number of
+ * records, then for each one timestamp in us (uint32), probe point and
+ * argument (uint16). The last event of a read has fewer than
+ * LATENCY_PROBE_EVENT_RECORDS records.
+ */
+#ifndef HCI_CONTROL_MISC_EVENT_PROBES
+#define HCI_CONTROL_MISC_EVENT_PROBES           ( ( HCI_CONTROL_GROUP_MISC << 8 ) | 0x24 )
+#endif
+
+/* Records kept, power of 2 */
+#ifndef LATENCY_PROBE_RING_SIZE
+#define LATENCY_PROBE_RING_SIZE                 64
+#endif
+
+/* Records per HCI_CONTROL_MISC_EVENT_PROBES event */
+#define LATENCY_PROBE_EVENT_RECORDS             24
+
+/* Probe points */
+#define LATENCY_PROBE_HCI_CMD_RX                1   /* HCI command received, opcode */
+#define LATENCY_PROBE_HCI_CMD_DONE              2   /* HCI command handled, opcode */
+#define LATENCY_PROBE_GATT_REQ                  3   /* GATT request from a client, request type */
+#define LATENCY_PROBE_TX_QUEUED                 4   /* notification or SDU queued, connection or channel */
+#define LATENCY_PROBE_TX_SENT                   5   /* notification or SDU given to the stack, connection or channel */
+#define LATENCY_PROBE_TX_COMPLETE               6   /* stack done with it, connection or channel */
+
+#ifdef LATENCY_PROBES
+#define LATENCY_PROBE(point, arg)               latency_probe_record((point), (uint16_t) (arg))
+#else
+#define LATENCY_PROBE(point, arg)               ((void) 0)
+#endif
+
+/******************************************************
+ *                 Type Definitions
+ ******************************************************/
+
+typedef struct
+{
+    uint32_t    timestamp_us;
+    uint16_t    arg;
+    uint8_t     point;              /* LATENCY_PROBE_xx */
+} latency_probe_rec_t;
+
+/******************************************************
+ *               Function Declarations
+ ******************************************************/
+
+/**
+ * Record a probe point, through LATENCY_PROBE().
+ */
+void latency_probe_record(uint8_t point, uint16_t arg);
+
+/**
+ * HCI_CONTROL_MISC_COMMAND_READ_PROBES handler, for the command table of
+ * the application.
+ */
+uint8_t latency_probe_cmd_read(uint16_t opcode, uint8_t *p_data, uint32_t data_len);
@@ -0,0 +1,64 @@
+#
+# Copyright 2016-2020, Cypress Semiconductor Corporation or a subsidiary of
+# Cypress Semiconductor Corporation. All Rights Reserved.
+#
+# This software, including source code, documentation and related
+# materials ("Software"), is owned by Cypress Semiconductor Corporation
+# or one of its subsidiaries ("Cypress") and is protected by and subject to
+# worldwide patent protection (United States and foreign),
+# United States copyright laws and international treaty provisions.
+# Therefore, you may use this Software only as provided in the license
+# agreement accompanying the software package from which you
+# obtained this Software ("EULA").
+# If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+# non-transferable license to copy, modify, and compile the Software
+# source code solely for use in connection with Cypress's
+# integrated circuit products. Any reproduction, modification, translation,
+# compilation, or representation of this Software except as specified
+# above is prohibited without the express written permission of Cypress.
+#
+# Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+# EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+# WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+# reserves the right to make changes to the Software without notice. Cypress
+# does not assume any liability arising out of the application or use of the
+# Software or any product or circuit described in the Software. Cypress does
+# not authorize its products for use in any products where a malfunction or
+# failure of the Cypress product may reasonably be expected to result in
+# significant property damage, injury or death ("High Risk Product"). By
+# including Cypress's product in a High Risk Product, the manufacturer
+# of such system or application assumes all risk of such use and in doing
+# so agrees to indemnify Cypress against all liability.
+#
+
+#
+# make mem_report: code, rodata, data and bss of each module of the last
+# build, the buffer pools configured by the application, and the changes
+# against the report stored with make mem_baseline. Included by the
+# makefile of each application, see tools/mem_report/read_me.txt.
+#
+#   MEM_REPORT_BASELINE     stored report, mem_baseline.json of the application by default
+#   MEM_REPORT_MAX_GROWTH   fail when data, bss and pools grew by more bytes than this
+#
+
+MEM_REPORT_BUILD_DIR?=$(or $(CY_BUILD_LOCATION),$(CY_APP_PATH)/build)/$(TARGET)/$(CONFIG)
+MEM_REPORT_BASELINE?=$(CY_APP_PATH)/mem_baseline.json
+MEM_REPORT_MAX_GROWTH?=
+MEM_REPORT_PYTHON?=$(or $(CY_PYTHON_PATH),python3)
+MEM_REPORT_SIZE?=$(if $(CY_COMPILER_PATH),$(CY_COMPILER_PATH)/bin/)arm-none-eabi-size
+
+MEM_REPORT_CMD=$(MEM_REPORT_PYTHON) $(CY_APP_PATH)/../tools/mem_report/mem_report.py \
+    --app $(APPNAME) \
+    --build-dir $(MEM_REPORT_BUILD_DIR) \
+    --src $(CY_APP_PATH) \
+    --include $(CY_APP_PATH)/../common \
+    --size $(MEM_REPORT_SIZE)
+
+.PHONY: mem_report mem_baseline
+
+mem_report:
+	$(MEM_REPORT_CMD) --baseline $(MEM_REPORT_BASELINE) --output $(MEM_REPORT_BUILD_DIR)/mem_report.json \
+	    $(if $(MEM_REPORT_MAX_GROWTH),--max-ram-growth $(MEM_REPORT_MAX_GROWTH))
+
+mem_baseline:
+	$(MEM_REPORT_CMD) --output $(MEM_REPORT_BASELINE)
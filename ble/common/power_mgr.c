@@ -0,0 +1,238 @@
+/*
+ * Copyright 2016-2020, Cypress Semiconductor Corporation or a subsidiary of
+ * Cypress Semiconductor Corporation. All Rights Reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software"), is owned by Cypress Semiconductor Corporation
+ * or one of its subsidiaries ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products. Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ */
+
+
+/** @file
+ *
+ * Power manager: sleep permission voted by the modules, and a shared
+ * seconds tick
+ */
+
+#include "wiced_bt_trace.h"
+#include "timer_wheel.h"
+#include "power_mgr.h"
+
+/******************************************************
+ *               Variables Definitions
+ ******************************************************/
+
+static wiced_sleep_config_t power_mgr_sleep_config;
+
+static const char          *power_mgr_voter_names[POWER_MGR_MAX_VOTERS];
+static uint8_t              power_mgr_votes[POWER_MGR_MAX_VOTERS];
+static uint8_t              power_mgr_num_voters;
+
+static power_mgr_tick_t    *power_mgr_ticks;
+static timer_wheel_timer_t  power_mgr_timer;
+static wiced_bool_t         power_mgr_timer_init;
+static uint64_t             power_mgr_timer_start_us;   /* time the remaining_s count from */
+static wiced_bool_t         power_mgr_tick_updating;
+
+/******************************************************
+ *               Function Definitions
+ ******************************************************/
+
+static void power_mgr_timeout(uint32_t arg);
+
+void power_mgr_init(const wiced_sleep_config_t *p_config)
+{
+    if (!power_mgr_timer_init)
+    {
+        /* On the timer wheel, the ticks share the wake-ups of the other application timers */
+        timer_wheel_init(&power_mgr_timer, power_mgr_timeout, 0, WICED_FALSE, TIMER_WHEEL_DEFAULT_SLACK_MS);
+        power_mgr_timer_init = WICED_TRUE;
+    }
+
+    if (p_config == NULL)
+        return;
+
+    /* The firmware keeps a pointer to the configuration */
+    power_mgr_sleep_config                      = *p_config;
+    power_mgr_sleep_config.sleep_permit_handler = power_mgr_sleep_permit_handler;
+    if (wiced_sleep_configure(&power_mgr_sleep_config) != WICED_SUCCESS)
+        WICED_BT_TRACE("[%s] sleep configuration failed\n", __func__);
+}
+
+uint8_t power_mgr_voter_add(const char *p_name)
+{
+    if (power_mgr_num_voters == POWER_MGR_MAX_VOTERS)
+    {
+        WICED_BT_TRACE("[%s] no voter left for %s\n", __func__, p_name);
+        return POWER_MGR_VOTER_INVALID;
+    }
+    power_mgr_voter_names[power_mgr_num_voters] = p_name;
+    power_mgr_votes[power_mgr_num_voters]       = POWER_MGR_SHUTDOWN;
+    return power_mgr_num_voters++;
+}
+
+void power_mgr_vote(uint8_t voter, power_mgr_level_t level)
+{
+    if ((voter >= power_mgr_num_voters) || (power_mgr_votes[voter] == level))
+        return;
+
+    power_mgr_votes[voter] = (uint8_t)level;
+}
+
+power_mgr_level_t power_mgr_level(void)
+{
+    uint8_t level = POWER_MGR_SHUTDOWN;
+    uint8_t i;
+
+    for (i = 0; i < power_mgr_num_voters; i++)
+    {
+        if (power_mgr_votes[i] < level)
+            level = power_mgr_votes[i];
+    }
+    return (power_mgr_level_t)level;
+}
+
+uint32_t power_mgr_sleep_permit_handler(wiced_sleep_poll_type_t type)
+{
+    power_mgr_level_t level = power_mgr_level();
+
+    switch (type)
+    {
+    case WICED_SLEEP_POLL_TIME_TO_SLEEP:
+        /* The timers of the stack, the shared tick among them, wake the device up */
+        return (level == POWER_MGR_AWAKE) ? 0 : WICED_SLEEP_MAX_TIME_TO_SLEEP;
+
+    case WICED_SLEEP_POLL_SLEEP_PERMISSION:
+        if (level == POWER_MGR_SHUTDOWN)
+            return WICED_SLEEP_ALLOWED_WITH_SHUTDOWN;
+        if (level == POWER_MGR_SLEEP)
+            return WICED_SLEEP_ALLOWED_WITHOUT_SHUTDOWN;
+        return WICED_SLEEP_NOT_ALLOWED;
+
+    default:
+        return WICED_SLEEP_NOT_ALLOWED;
+    }
+}
+
+/* Seconds since power_mgr_timer_start_us, to the nearest as the timer is not exact */
+static uint32_t power_mgr_elapsed_s(void)
+{
+    return (uint32_t)((clock_SystemTimeMicroseconds64() - power_mgr_timer_start_us + 500000) / 1000000);
+}
+
+/*
+ * Count the whole seconds elapsed since the timer was started off the
+ * remaining time of the ticks, run the ticks due and start the timer for
+ * the next one. The fraction of a second left over is kept in the start
+ * time so that the ticks do not drift when they are started or stopped.
+ */
+static void power_mgr_tick_update(void)
+{
+    power_mgr_tick_t *p_tick;
+    uint32_t          elapsed = power_mgr_elapsed_s();
+    uint16_t          next    = 0;
+
+    timer_wheel_stop(&power_mgr_timer);
+
+    if (power_mgr_ticks == NULL)
+        return;
+
+    power_mgr_timer_start_us += (uint64_t)elapsed * 1000000;
+
+    for (p_tick = power_mgr_ticks; p_tick != NULL; p_tick = p_tick->p_next)
+        p_tick->remaining_s = (p_tick->remaining_s > elapsed) ? (uint16_t)(p_tick->remaining_s - elapsed) : 0;
+
+    /* A callback may start or stop ticks, the list is walked again after each */
+    power_mgr_tick_updating = WICED_TRUE;
+    p_tick = power_mgr_ticks;
+    while (p_tick != NULL)
+    {
+        if (p_tick->remaining_s == 0)
+        {
+            p_tick->remaining_s = p_tick->period_s;
+            p_tick->p_cback(p_tick->arg);
+            p_tick = power_mgr_ticks;
+            continue;
+        }
+        p_tick = p_tick->p_next;
+    }
+    power_mgr_tick_updating = WICED_FALSE;
+
+    for (p_tick = power_mgr_ticks; p_tick != NULL; p_tick = p_tick->p_next)
+    {
+        if ((next == 0) || (p_tick->remaining_s < next))
+            next = p_tick->remaining_s;
+    }
+    if (next != 0)
+        timer_wheel_start(&power_mgr_timer, (uint32_t)next * 1000);
+}
+
+static void power_mgr_timeout(uint32_t arg)
+{
+    power_mgr_tick_update();
+}
+
+void power_mgr_tick_start(power_mgr_tick_t *p_tick, wiced_timer_callback_fp p_cback, uint32_t arg, uint16_t period_s)
+{
+    if (!power_mgr_timer_init)
+        power_mgr_init(NULL);
+
+    power_mgr_tick_stop(p_tick);
+
+    if (power_mgr_ticks == NULL)
+        power_mgr_timer_start_us = clock_SystemTimeMicroseconds64();
+
+    p_tick->p_cback  = p_cback;
+    p_tick->arg      = arg;
+    p_tick->period_s = (period_s != 0) ? period_s : 1;
+
+    /* Count from the start of the running timer, the seconds already elapsed are taken off on the next update */
+    p_tick->remaining_s = p_tick->period_s + (uint16_t)power_mgr_elapsed_s();
+    p_tick->p_next      = power_mgr_ticks;
+    power_mgr_ticks     = p_tick;
+
+    /* From a tick callback, the running update starts the timer once the callbacks are done */
+    if (!power_mgr_tick_updating)
+        power_mgr_tick_update();
+}
+
+void power_mgr_tick_stop(power_mgr_tick_t *p_tick)
+{
+    power_mgr_tick_t **pp_tick;
+
+    for (pp_tick = &power_mgr_ticks; *pp_tick != NULL; pp_tick = &(*pp_tick)->p_next)
+    {
+        if (*pp_tick == p_tick)
+        {
+            *pp_tick = p_tick->p_next;
+            break;
+        }
+    }
+
+    if ((power_mgr_ticks == NULL) && power_mgr_timer_init)
+        timer_wheel_stop(&power_mgr_timer);
+}
@@ -0,0 +1,133 @@
+/*
+ * Copyright 2016-2020, Cypress Semiconductor Corporation or a subsidiary of
+ * Cypress Semiconductor Corporation. All Rights Reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software"), is owned by Cypress Semiconductor Corporation
+ * or one of its subsidiaries ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products. Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ */
+
+
+/** @file
+ *
+ * Power manager: sleep permission voted by the modules, and a shared
+ * seconds tick
+ *
+ * The firmware polls one sleep permit handler before sleeping. Instead of
+ * each application writing its own, the modules that need the device awake,
+ * or need the state kept that shutdown sleep (ePDS) loses, hold a vote and
+ * the handler grants the deepest sleep all the votes allow. A PWM blinking
+ * an LED votes POWER_MGR_SLEEP for instance, an ongoing transfer over the
+ * HCI UART POWER_MGR_AWAKE.
+ *
+ * Periodic work counted in seconds shares a single timer: the ticks due at
+ * the same second run on the same wake-up, and the timer is started for the
+ * next due tick only, not every second.
+ */
+
+#pragma once
+
+#include "wiced_bt_types.h"
+#include "wiced_sleep.h"
+#include "wiced_timer.h"
+
+/******************************************************
+ *                      Constants
+ ******************************************************/
+
+#ifndef POWER_MGR_MAX_VOTERS
+#define POWER_MGR_MAX_VOTERS            8
+#endif
+
+#define POWER_MGR_VOTER_INVALID         0xFF
+
+/******************************************************
+ *                 Type Definitions
+ ******************************************************/
+
+/* Deepest sleep a voter allows, the lowest vote wins */
+typedef enum
+{
+    POWER_MGR_AWAKE,                    /* no sleep */
+    POWER_MGR_SLEEP,                    /* sleep keeping the state of the HW blocks */
+    POWER_MGR_SHUTDOWN,                 /* shutdown sleep, woken up by the stack or the wake source */
+} power_mgr_level_t;
+
+typedef struct power_mgr_tick
+{
+    struct power_mgr_tick  *p_next;
+    wiced_timer_callback_fp p_cback;
+    uint32_t                arg;
+    uint16_t                period_s;
+    uint16_t                remaining_s;
+} power_mgr_tick_t;
+
+/******************************************************
+ *               Function Declarations
+ ******************************************************/
+
+/**
+ * Configure sleep with the power manager as sleep permit handler. The other
+ * fields of the configuration (mode, wake source, post sleep callback) are
+ * the application's. Applications without sleep support pass NULL and still
+ * use the votes and ticks.
+ */
+void power_mgr_init(const wiced_sleep_config_t *p_config);
+
+/**
+ * Add a voter, voting POWER_MGR_SHUTDOWN until it votes otherwise.
+ *
+ * @return  the voter, POWER_MGR_VOTER_INVALID if POWER_MGR_MAX_VOTERS are taken
+ */
+uint8_t power_mgr_voter_add(const char *p_name);
+
+/**
+ * Change the vote of a voter.
+ */
+void power_mgr_vote(uint8_t voter, power_mgr_level_t level);
+
+/**
+ * Get the deepest sleep all the votes allow.
+ */
+power_mgr_level_t power_mgr_level(void);
+
+/**
+ * Sleep permit handler of the firmware, installed by power_mgr_init.
+ */
+uint32_t power_mgr_sleep_permit_handler(wiced_sleep_poll_type_t type);
+
+/**
+ * Run p_cback(arg) every period_s seconds, the first time period_s seconds
+ * from now. The tick structure must stay in place until power_mgr_tick_stop.
+ * Starting a running tick restarts it with the new period.
+ */
+void power_mgr_tick_start(power_mgr_tick_t *p_tick, wiced_timer_callback_fp p_cback, uint32_t arg, uint16_t period_s);
+
+/**
+ * Stop a tick, nothing is done if it is not running.
+ */
+void power_mgr_tick_stop(power_mgr_tick_t *p_tick);
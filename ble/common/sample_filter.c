@@ -0,0 +1,128 @@
+/*
+ * Copyright 2016-2020, Cypress Semiconductor Corporation or a subsidiary of
+ * Cypress Semiconductor Corporation. All Rights Reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software"), is owned by Cypress Semiconductor Corporation
+ * or one of its subsidiaries ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products. Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ */
+
+/** @file
+ *
+ * Integer filters for sensor samples
+ */
+
+#include <string.h>
+#include "wiced_bt_trace.h"
+#include "sample_filter.h"
+
+/******************************************************
+ *               Function Definitions
+ ******************************************************/
+
+void sample_filter_init(sample_filter_t *p_filter, uint8_t type, uint8_t window, uint8_t iir_shift)
+{
+    memset(p_filter, 0, sizeof(*p_filter));
+    p_filter->type      = type;
+    p_filter->window    = (window == 0) ? 1 : (window > SAMPLE_FILTER_MAX_WINDOW) ? SAMPLE_FILTER_MAX_WINDOW : window;
+    p_filter->iir_shift = iir_shift;
+}
+
+void sample_filter_reset(sample_filter_t *p_filter)
+{
+    sample_filter_init(p_filter, p_filter->type, p_filter->window, p_filter->iir_shift);
+}
+
+static int16_t sample_filter_median(sample_filter_t *p_filter)
+{
+    int16_t sorted[SAMPLE_FILTER_MAX_WINDOW];
+    int16_t value;
+    int     i, j;
+
+    /* insertion sort, the window is small */
+    for (i = 0; i < p_filter->count; i++)
+    {
+        value = p_filter->history[i];
+        for (j = i; (j > 0) && (sorted[j - 1] > value); j--)
+            sorted[j] = sorted[j - 1];
+        sorted[j] = value;
+    }
+    return sorted[p_filter->count / 2];
+}
+
+int16_t sample_filter_add(sample_filter_t *p_filter, int16_t sample)
+{
+    /* keep the last window samples and their sum */
+    if (p_filter->count == p_filter->window)
+        p_filter->sum -= p_filter->history[p_filter->next];
+    else
+        p_filter->count++;
+    p_filter->history[p_filter->next] = sample;
+    p_filter->sum += sample;
+    p_filter->next = (p_filter->next + 1) % p_filter->window;
+
+    switch (p_filter->type)
+    {
+    case SAMPLE_FILTER_AVERAGE:
+        p_filter->output = (int16_t)(p_filter->sum / p_filter->count);
+        break;
+
+    case SAMPLE_FILTER_MEDIAN:
+        p_filter->output = sample_filter_median(p_filter);
+        break;
+
+    case SAMPLE_FILTER_IIR:
+        if (!p_filter->iir_started)
+            p_filter->iir_state = (int32_t)sample * 256;
+        else
+            p_filter->iir_state += ((int32_t)sample * 256 - p_filter->iir_state) >> p_filter->iir_shift;
+        p_filter->iir_started = 1;
+        /* round to the nearest unit */
+        p_filter->output = (int16_t)((p_filter->iir_state + 128) >> 8);
+        break;
+
+    default:
+        p_filter->output = sample;
+        break;
+    }
+    return p_filter->output;
+}
+
+const char *sample_filter_name(uint8_t type)
+{
+    switch (type)
+    {
+    case SAMPLE_FILTER_AVERAGE:
+        return "average";
+    case SAMPLE_FILTER_MEDIAN:
+        return "median";
+    case SAMPLE_FILTER_IIR:
+        return "iir";
+    default:
+        return "none";
+    }
+}
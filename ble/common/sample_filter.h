@@ -0,0 +1,108 @@
+/*
+ * Copyright 2016-2020, Cypress Semiconductor Corporation or a subsidiary of
+ * Cypress Semiconductor Corporation. All Rights Reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software"), is owned by Cypress Semiconductor Corporation
+ * or one of its subsidiaries ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products. Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ */
+
+/** @file
+ *
+ * Integer filters for sensor samples
+ *
+ * A sensor read once per period gives a noisy value. The application takes
+ * several samples per period and passes each one to a filter, the value
+ * published is the filter output after the last sample. The filters work on
+ * signed 16 bit samples in the unit of the sensor (0.01 degree Celsius for
+ * the thermistor) and use no floating point:
+ *  - moving average of the last window samples
+ *  - median of the last window samples, which ignores isolated spikes
+ *  - first order IIR, out += (in - out) / 2^shift, whose state is kept with
+ *    8 fractional bits and carries over from one period to the next
+ */
+
+#pragma once
+
+#include "wiced_bt_types.h"
+
+/******************************************************
+ *                      Constants
+ ******************************************************/
+
+#ifndef SAMPLE_FILTER_MAX_WINDOW
+#define SAMPLE_FILTER_MAX_WINDOW    16      /* samples kept by the average and median filters */
+#endif
+
+#define SAMPLE_FILTER_NONE          0       /* last sample */
+#define SAMPLE_FILTER_AVERAGE       1
+#define SAMPLE_FILTER_MEDIAN        2
+#define SAMPLE_FILTER_IIR           3
+
+/******************************************************
+ *                 Type Definitions
+ ******************************************************/
+
+typedef struct
+{
+    uint8_t  type;                                  /* SAMPLE_FILTER_xxx */
+    uint8_t  window;                                /* samples of the average and median filters */
+    uint8_t  iir_shift;                             /* weight of a new sample in the IIR filter, 1 / 2^shift */
+    uint8_t  count;                                 /* samples in history, up to window */
+    uint8_t  next;                                  /* where the next sample goes in history */
+    int16_t  history[SAMPLE_FILTER_MAX_WINDOW];
+    int32_t  sum;                                   /* of the samples in history */
+    int32_t  iir_state;                             /* IIR output, 8 fractional bits */
+    uint8_t  iir_started;                           /* iir_state holds a value */
+    int16_t  output;
+} sample_filter_t;
+
+/******************************************************
+ *               Function Declarations
+ ******************************************************/
+
+/**
+ * Initialize a filter. window is capped to SAMPLE_FILTER_MAX_WINDOW.
+ */
+void sample_filter_init(sample_filter_t *p_filter, uint8_t type, uint8_t window, uint8_t iir_shift);
+
+/**
+ * Forget the samples, the next one starts the filter again.
+ */
+void sample_filter_reset(sample_filter_t *p_filter);
+
+/**
+ * Add a sample.
+ *
+ * @return  the filter output
+ */
+int16_t sample_filter_add(sample_filter_t *p_filter, int16_t sample);
+
+/**
+ * Name of a filter type for traces.
+ */
+const char *sample_filter_name(uint8_t type);
@@ -0,0 +1,172 @@
+/*
+ * Copyright 2016-2020, Cypress Semiconductor Corporation or a subsidiary of
+ * Cypress Semiconductor Corporation. All Rights Reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software"), is owned by Cypress Semiconductor Corporation
+ * or one of its subsidiaries ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products. Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ */
+
+/** @file
+ *
+ * Scan result filter with a cache of recently seen devices
+ */
+
+#include <string.h>
+#include "wiced_bt_trace.h"
+#include "scan_filter.h"
+
+/******************************************************
+ *               Function Definitions
+ ******************************************************/
+
+void scan_filter_init(scan_filter_t *p_filter, scan_filter_match_t p_match)
+{
+    memset(p_filter, 0, sizeof(*p_filter));
+    p_filter->p_match = p_match;
+}
+
+static int scan_filter_find(scan_filter_t *p_filter, const uint8_t *bd_addr)
+{
+    int i;
+
+    for (i = 0; i < p_filter->num_entries; i++)
+    {
+        if (memcmp(p_filter->entry[i].bd_addr, bd_addr, BD_ADDR_LEN) == 0)
+            return i;
+    }
+    return -1;
+}
+
+wiced_bool_t scan_filter_check(scan_filter_t *p_filter, wiced_bt_ble_scan_results_t *p_scan_result, uint8_t *p_adv_data)
+{
+    scan_filter_entry_t entry;
+    int                 index = scan_filter_find(p_filter, p_scan_result->remote_bd_addr);
+
+    if (index >= 0)
+    {
+        p_filter->cache_hits++;
+        entry = p_filter->entry[index];
+    }
+    else
+    {
+        p_filter->cache_misses++;
+        memcpy(entry.bd_addr, p_scan_result->remote_bd_addr, BD_ADDR_LEN);
+        entry.matched = p_filter->p_match(p_scan_result, p_adv_data);
+
+        if (!entry.matched && (p_scan_result->ble_evt_type == BTM_BLE_EVT_SCAN_RSP))
+            return WICED_FALSE;
+
+        // take the place of the oldest device when full
+        if (p_filter->num_entries < SCAN_FILTER_CACHE_SIZE)
+            p_filter->num_entries++;
+        index = p_filter->num_entries - 1;
+    }
+
+    // move to the front
+    memmove(&p_filter->entry[1], &p_filter->entry[0], index * sizeof(scan_filter_entry_t));
+    p_filter->entry[0] = entry;
+
+    return entry.matched;
+}
+
+void scan_filter_forget(scan_filter_t *p_filter, BD_ADDR bd_addr)
+{
+    int index = scan_filter_find(p_filter, bd_addr);
+
+    if (index >= 0)
+    {
+        p_filter->num_entries--;
+        memmove(&p_filter->entry[index], &p_filter->entry[index + 1], (p_filter->num_entries - index) * sizeof(scan_filter_entry_t));
+    }
+}
+
+void scan_filter_reset(scan_filter_t *p_filter)
+{
+    p_filter->num_entries = 0;
+}
+
+wiced_bool_t scan_filter_adv_has_uuid16(uint8_t *p_adv_data, uint16_t uuid16)
+{
+    static const wiced_bt_ble_advert_type_t types[] = { BTM_BLE_ADVERT_TYPE_16SRV_COMPLETE, BTM_BLE_ADVERT_TYPE_16SRV_PARTIAL };
+    uint8_t length;
+    uint8_t *p_data;
+    int     i;
+
+    for (i = 0; i < sizeof(types) / sizeof(types[0]); i++)
+    {
+        p_data = wiced_bt_ble_check_advertising_data(p_adv_data, types[i], &length);
+        if (p_data == NULL)
+            continue;
+
+        for (; length >= LEN_UUID_16; length -= LEN_UUID_16, p_data += LEN_UUID_16)
+        {
+            if ((p_data[0] | (p_data[1] << 8)) == uuid16)
+                return WICED_TRUE;
+        }
+    }
+    return WICED_FALSE;
+}
+
+wiced_bool_t scan_filter_adv_has_uuid128(uint8_t *p_adv_data, const uint8_t *p_uuid128)
+{
+    static const wiced_bt_ble_advert_type_t types[] = { BTM_BLE_ADVERT_TYPE_128SRV_COMPLETE, BTM_BLE_ADVERT_TYPE_128SRV_PARTIAL };
+    uint8_t length;
+    uint8_t *p_data;
+    int     i;
+
+    for (i = 0; i < sizeof(types) / sizeof(types[0]); i++)
+    {
+        p_data = wiced_bt_ble_check_advertising_data(p_adv_data, types[i], &length);
+        if (p_data == NULL)
+            continue;
+
+        for (; length >= LEN_UUID_128; length -= LEN_UUID_128, p_data += LEN_UUID_128)
+        {
+            if (memcmp(p_data, p_uuid128, LEN_UUID_128) == 0)
+                return WICED_TRUE;
+        }
+    }
+    return WICED_FALSE;
+}
+
+wiced_bool_t scan_filter_accept_list_add(BD_ADDR bd_addr, wiced_bt_ble_address_type_t addr_type)
+{
+    if (!wiced_bt_ble_update_scanner_white_list(WICED_TRUE, bd_addr, addr_type))
+    {
+        WICED_BT_TRACE("scan_filter accept list full <%B>\n", bd_addr);
+        return WICED_FALSE;
+    }
+    wiced_bt_ble_update_scanner_filter_policy(BTM_BLE_SCAN_POLICY_FILTER_ADV_RSP);
+    return WICED_TRUE;
+}
+
+void scan_filter_accept_list_clear(void)
+{
+    wiced_bt_ble_update_scanner_filter_policy(BTM_BLE_SCAN_POLICY_ACCEPT_ADV_RSP);
+    wiced_bt_ble_clear_white_list();
+}
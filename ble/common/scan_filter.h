@@ -0,0 +1,139 @@
+/*
+ * Copyright 2016-2020, Cypress Semiconductor Corporation or a subsidiary of
+ * Cypress Semiconductor Corporation. All Rights Reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software"), is owned by Cypress Semiconductor Corporation
+ * or one of its subsidiaries ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products. Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ */
+
+/** @file
+ *
+ * Scan result filter with a cache of recently seen devices
+ *
+ * A central scanning in a crowded place receives the same advertisements
+ * many times per second. The filter remembers the last devices seen and
+ * whether their advertising data matched what the application is looking
+ * for, so the payload of a repeating device is parsed only once. The cache
+ * is least recently used: a hit moves the device to the front and a new
+ * device takes the place of the oldest one.
+ *
+ * When the application knows the addresses it wants (a bonded peer for
+ * instance), the accept list functions hand the filtering over to the
+ * controller so that no other advertisement reaches the host at all.
+ */
+
+#pragma once
+
+#include "wiced_bt_types.h"
+#include "wiced_bt_ble.h"
+
+/******************************************************
+ *                      Constants
+ ******************************************************/
+
+#ifndef SCAN_FILTER_CACHE_SIZE
+#define SCAN_FILTER_CACHE_SIZE      16      /* devices remembered by a filter */
+#endif
+
+/******************************************************
+ *                 Type Definitions
+ ******************************************************/
+
+/* Decide if a device is wanted from its advertising data */
+typedef wiced_bool_t (*scan_filter_match_t)(wiced_bt_ble_scan_results_t *p_scan_result, uint8_t *p_adv_data);
+
+typedef struct
+{
+    BD_ADDR         bd_addr;
+    uint8_t         matched;
+} scan_filter_entry_t;
+
+typedef struct
+{
+    scan_filter_match_t p_match;
+    uint8_t             num_entries;
+    scan_filter_entry_t entry[SCAN_FILTER_CACHE_SIZE];  /* most recently seen first */
+    uint32_t            cache_hits;
+    uint32_t            cache_misses;
+} scan_filter_t;
+
+/******************************************************
+ *               Function Declarations
+ ******************************************************/
+
+/**
+ * Initialize a filter with the function deciding which devices match.
+ */
+void scan_filter_init(scan_filter_t *p_filter, scan_filter_match_t p_match);
+
+/**
+ * Check a scan result. A device seen recently gets its cached answer, a new
+ * one is checked with the match function and remembered. A scan response
+ * that does not match is not remembered, the data checked may be in the
+ * advertisement itself.
+ *
+ * @return  WICED_TRUE if the device matches
+ */
+wiced_bool_t scan_filter_check(scan_filter_t *p_filter, wiced_bt_ble_scan_results_t *p_scan_result, uint8_t *p_adv_data);
+
+/**
+ * Forget one device, its next advertisement is checked again.
+ */
+void scan_filter_forget(scan_filter_t *p_filter, BD_ADDR bd_addr);
+
+/**
+ * Forget all devices, typically when a new scan is started.
+ */
+void scan_filter_reset(scan_filter_t *p_filter);
+
+/**
+ * Check if advertising data lists a 16 bit service UUID, in the complete or
+ * in the partial list.
+ */
+wiced_bool_t scan_filter_adv_has_uuid16(uint8_t *p_adv_data, uint16_t uuid16);
+
+/**
+ * Check if advertising data lists a 128 bit service UUID, in the complete or
+ * in the partial list.
+ */
+wiced_bool_t scan_filter_adv_has_uuid128(uint8_t *p_adv_data, const uint8_t *p_uuid128);
+
+/**
+ * Add a device to the controller accept list and have the scanner report
+ * only the devices of that list. The list is sized by ble_white_list_size
+ * of the stack configuration.
+ *
+ * @return  WICED_FALSE if the controller has no room for the device
+ */
+wiced_bool_t scan_filter_accept_list_add(BD_ADDR bd_addr, wiced_bt_ble_address_type_t addr_type);
+
+/**
+ * Empty the controller accept list and have the scanner report all devices
+ * again.
+ */
+void scan_filter_accept_list_clear(void);
@@ -0,0 +1,216 @@
+/*
+ * Copyright 2016-2020, Cypress Semiconductor Corporation or a subsidiary of
+ * Cypress Semiconductor Corporation. All Rights Reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software"), is owned by Cypress Semiconductor Corporation
+ * or one of its subsidiaries ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products. Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ */
+
+
+/** @file
+ *
+ * Application timers sharing one timer
+ */
+
+#include "wiced_bt_trace.h"
+#include "timer_wheel.h"
+
+/******************************************************
+ *               Variables Definitions
+ ******************************************************/
+
+static timer_wheel_timer_t *timer_wheel_timers;        /* running timers */
+static wiced_timer_t        timer_wheel_timer;
+static wiced_bool_t         timer_wheel_timer_init;
+static wiced_bool_t         timer_wheel_dispatching;
+static uint32_t             timer_wheel_wakeup_ms;     /* time the timer was started for */
+
+/******************************************************
+ *               Function Definitions
+ ******************************************************/
+
+static void timer_wheel_timeout(uint32_t arg);
+
+static uint32_t timer_wheel_now_ms(void)
+{
+    return (uint32_t)(clock_SystemTimeMicroseconds64() / 1000);
+}
+
+/* Deadlines wrap around with the millisecond count */
+static wiced_bool_t timer_wheel_before(uint32_t a_ms, uint32_t b_ms)
+{
+    return (int32_t)(a_ms - b_ms) < 0;
+}
+
+static void timer_wheel_unlink(timer_wheel_timer_t *p_timer)
+{
+    timer_wheel_timer_t **pp_timer;
+
+    for (pp_timer = &timer_wheel_timers; *pp_timer != NULL; pp_timer = &(*pp_timer)->p_next)
+    {
+        if (*pp_timer == p_timer)
+        {
+            *pp_timer = p_timer->p_next;
+            break;
+        }
+    }
+    p_timer->in_use = WICED_FALSE;
+}
+
+/*
+ * Start the timer for the earliest deadline plus slack of the running
+ * timers, the latest the first of them may expire.
+ */
+static void timer_wheel_schedule(void)
+{
+    timer_wheel_timer_t *p_timer;
+    uint32_t             wakeup_ms = 0;
+    uint32_t             now_ms;
+    wiced_bool_t         any       = WICED_FALSE;
+
+    if (timer_wheel_dispatching)
+        return;
+
+    for (p_timer = timer_wheel_timers; p_timer != NULL; p_timer = p_timer->p_next)
+    {
+        if (!any || timer_wheel_before(p_timer->deadline_ms + p_timer->slack_ms, wakeup_ms))
+            wakeup_ms = p_timer->deadline_ms + p_timer->slack_ms;
+        any = WICED_TRUE;
+    }
+
+    if (wiced_is_timer_in_use(&timer_wheel_timer))
+    {
+        /* Already started for the same time, or before and the deadlines are rechecked then */
+        if (any && !timer_wheel_before(wakeup_ms, timer_wheel_wakeup_ms))
+            return;
+        wiced_stop_timer(&timer_wheel_timer);
+    }
+    if (!any)
+        return;
+
+    now_ms                = timer_wheel_now_ms();
+    timer_wheel_wakeup_ms = wakeup_ms;
+    wiced_start_timer(&timer_wheel_timer, timer_wheel_before(now_ms, wakeup_ms) ? wakeup_ms - now_ms : 1);
+}
+
+/*
+ * Dispatch every timer whose deadline has passed at the wake-up, not only
+ * the one the wake-up was set for. A callback may start or stop timers, the
+ * list is walked again after each.
+ */
+static void timer_wheel_timeout(uint32_t arg)
+{
+    timer_wheel_timer_t *p_timer;
+    uint32_t             now_ms = timer_wheel_now_ms();
+
+    /* The timer may expire a little early, the wake-up was meant for timer_wheel_wakeup_ms */
+    if (timer_wheel_before(now_ms, timer_wheel_wakeup_ms))
+        now_ms = timer_wheel_wakeup_ms;
+
+    timer_wheel_dispatching = WICED_TRUE;
+    p_timer = timer_wheel_timers;
+    while (p_timer != NULL)
+    {
+        if (timer_wheel_before(now_ms, p_timer->deadline_ms))
+        {
+            p_timer = p_timer->p_next;
+            continue;
+        }
+
+        if (p_timer->periodic)
+        {
+            p_timer->deadline_ms += p_timer->period_ms;
+            /* Skip the periods missed rather than expiring in a burst */
+            if (!timer_wheel_before(now_ms, p_timer->deadline_ms))
+                p_timer->deadline_ms = now_ms + p_timer->period_ms;
+        }
+        else
+        {
+            timer_wheel_unlink(p_timer);
+        }
+        p_timer->p_cback(p_timer->arg);
+        p_timer = timer_wheel_timers;
+    }
+    timer_wheel_dispatching = WICED_FALSE;
+
+    timer_wheel_schedule();
+}
+
+void timer_wheel_init(timer_wheel_timer_t *p_timer, wiced_timer_callback_fp p_cback, uint32_t arg, wiced_bool_t periodic, uint16_t slack_ms)
+{
+    if (!timer_wheel_timer_init)
+    {
+        wiced_init_timer(&timer_wheel_timer, timer_wheel_timeout, 0, WICED_MILLI_SECONDS_TIMER);
+        timer_wheel_timer_init = WICED_TRUE;
+    }
+
+    if (p_timer->in_use)
+        timer_wheel_unlink(p_timer);
+
+    p_timer->p_next   = NULL;
+    p_timer->p_cback  = p_cback;
+    p_timer->arg      = arg;
+    p_timer->periodic = periodic;
+    p_timer->slack_ms = slack_ms;
+    p_timer->in_use   = WICED_FALSE;
+}
+
+void timer_wheel_start(timer_wheel_timer_t *p_timer, uint32_t timeout_ms)
+{
+    if (p_timer->in_use)
+        timer_wheel_unlink(p_timer);
+
+    /* A periodic timer of 0 ms would expire for ever */
+    if (timeout_ms == 0)
+        timeout_ms = 1;
+
+    p_timer->period_ms   = timeout_ms;
+    p_timer->deadline_ms = timer_wheel_now_ms() + timeout_ms;
+    p_timer->in_use      = WICED_TRUE;
+    p_timer->p_next      = timer_wheel_timers;
+    timer_wheel_timers   = p_timer;
+
+    timer_wheel_schedule();
+}
+
+void timer_wheel_stop(timer_wheel_timer_t *p_timer)
+{
+    if (!p_timer->in_use)
+        return;
+
+    timer_wheel_unlink(p_timer);
+
+    /* Otherwise the wake-up set for it, if any, finds nothing due and moves on to the next */
+    if ((timer_wheel_timers == NULL) && wiced_is_timer_in_use(&timer_wheel_timer))
+        wiced_stop_timer(&timer_wheel_timer);
+}
+
+wiced_bool_t timer_wheel_in_use(timer_wheel_timer_t *p_timer)
+{
+    return p_timer->in_use;
+}
@@ -0,0 +1,104 @@
+/*
+ * Copyright 2016-2020, Cypress Semiconductor Corporation or a subsidiary of
+ * Cypress Semiconductor Corporation. All Rights Reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software"), is owned by Cypress Semiconductor Corporation
+ * or one of its subsidiaries ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products. Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ */
+
+
+/** @file
+ *
+ * Application timers sharing one timer
+ *
+ * Each wiced_timer_t expires on its own, so an application with a handful
+ * of timers wakes the CPU up for each of them. The timers of the wheel all
+ * run on a single one-shot timer started for the next wake-up. A timer may
+ * expire up to slack_ms after its deadline: a wake-up is set for the
+ * earliest deadline plus its slack, and every timer whose deadline has
+ * passed by then is dispatched on that same wake-up.
+ *
+ * The callbacks have the wiced_timer_t signature and run in the application
+ * thread, like the callbacks of the timers they replace.
+ */
+
+#pragma once
+
+#include "wiced_bt_types.h"
+#include "wiced_timer.h"
+
+/******************************************************
+ *                      Constants
+ ******************************************************/
+
+/* Slack of the timers whose expiry just has to happen, not at a given time */
+#ifndef TIMER_WHEEL_DEFAULT_SLACK_MS
+#define TIMER_WHEEL_DEFAULT_SLACK_MS    50
+#endif
+
+/******************************************************
+ *                 Type Definitions
+ ******************************************************/
+
+typedef struct timer_wheel_timer
+{
+    struct timer_wheel_timer *p_next;
+    wiced_timer_callback_fp   p_cback;
+    uint32_t                  arg;
+    uint32_t                  deadline_ms;
+    uint32_t                  period_ms;      /* timeout of the last start, the period if periodic */
+    uint16_t                  slack_ms;
+    wiced_bool_t              periodic;
+    wiced_bool_t              in_use;
+} timer_wheel_timer_t;
+
+/******************************************************
+ *               Function Declarations
+ ******************************************************/
+
+/**
+ * Initialize a timer, the counterpart of wiced_init_timer. slack_ms is how
+ * late the timer may expire so that it shares the wake-up of another one.
+ */
+void timer_wheel_init(timer_wheel_timer_t *p_timer, wiced_timer_callback_fp p_cback, uint32_t arg, wiced_bool_t periodic, uint16_t slack_ms);
+
+/**
+ * Start a timer to expire in timeout_ms, and then every timeout_ms if it is
+ * periodic. Starting a running timer restarts it.
+ */
+void timer_wheel_start(timer_wheel_timer_t *p_timer, uint32_t timeout_ms);
+
+/**
+ * Stop a timer, nothing is done if it is not running.
+ */
+void timer_wheel_stop(timer_wheel_timer_t *p_timer);
+
+/**
+ * Tell whether a timer is running.
+ */
+wiced_bool_t timer_wheel_in_use(timer_wheel_timer_t *p_timer);
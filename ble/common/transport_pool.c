@@ -0,0 +1,124 @@
+/*
+ * Copyright 2016-2020, Cypress Semiconductor Corporation or a subsidiary of
+ * Cypress Semiconductor Corporation. All Rights Reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software"), is owned by Cypress Semiconductor Corporation
+ * or one of its subsidiaries ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products. Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ */
+
+/** @file
+ *
+ * HCI transport buffers with usage accounting
+ */
+
+#include <string.h>
+#include "wiced_bt_trace.h"
+#include "transport_pool.h"
+
+/******************************************************
+ *               Function Definitions
+ ******************************************************/
+
+void transport_pool_init(transport_pool_t *p_pool, wiced_transport_cfg_t *p_transport_cfg, const transport_pool_cfg_t *p_cfg)
+{
+    memset(p_pool, 0, sizeof(*p_pool));
+    p_pool->p_cfg = p_cfg;
+
+    p_transport_cfg->rx_buff_pool_cfg.buffer_size  = p_cfg->rx_buffer_size;
+    p_transport_cfg->rx_buff_pool_cfg.buffer_count = p_cfg->rx_buffer_count;
+    wiced_transport_init(p_transport_cfg);
+
+    if (p_cfg->tx_buffer_count != 0)
+        p_pool->p_tx_pool = wiced_transport_create_buffer_pool(p_cfg->tx_buffer_size, p_cfg->tx_buffer_count);
+}
+
+/* Trace going down to the low water mark or running out, once until the buffers come back */
+static void transport_pool_check_level(const char *p_name, uint32_t num_free, uint8_t *p_level, uint8_t low_water)
+{
+    uint8_t level = TRANSPORT_POOL_LEVEL_OK;
+
+    if (num_free == 0)
+        level = TRANSPORT_POOL_LEVEL_EXHAUSTED;
+    else if (num_free <= low_water)
+        level = TRANSPORT_POOL_LEVEL_LOW;
+
+    if (level > *p_level)
+    {
+        if (level == TRANSPORT_POOL_LEVEL_EXHAUSTED)
+            WICED_BT_TRACE("transport %s buffers exhausted\n", p_name);
+        else
+            WICED_BT_TRACE("transport %s buffers low, %d free\n", p_name, num_free);
+    }
+    *p_level = level;
+}
+
+void transport_pool_rx_get(transport_pool_t *p_pool)
+{
+    if (p_pool->rx_in_use < p_pool->p_cfg->rx_buffer_count)
+        p_pool->rx_in_use++;
+    if (p_pool->rx_in_use == p_pool->p_cfg->rx_buffer_count)
+        p_pool->rx_exhausted++;
+
+    transport_pool_check_level("rx", p_pool->p_cfg->rx_buffer_count - p_pool->rx_in_use,
+            &p_pool->rx_level, p_pool->p_cfg->low_water);
+}
+
+void transport_pool_rx_free(transport_pool_t *p_pool, uint8_t *p_buffer)
+{
+    wiced_transport_free_buffer(p_buffer);
+
+    if (p_pool->rx_in_use != 0)
+        p_pool->rx_in_use--;
+
+    transport_pool_check_level("rx", p_pool->p_cfg->rx_buffer_count - p_pool->rx_in_use,
+            &p_pool->rx_level, p_pool->p_cfg->low_water);
+}
+
+wiced_bool_t transport_pool_tx_check(transport_pool_t *p_pool)
+{
+    uint32_t num_free;
+
+    if (p_pool->p_tx_pool == NULL)
+    {
+        p_pool->tx_exhausted++;
+        return WICED_FALSE;
+    }
+
+    num_free = wiced_transport_get_buffer_count(p_pool->p_tx_pool);
+    if (num_free == 0)
+        p_pool->tx_exhausted++;
+
+    transport_pool_check_level("tx", num_free, &p_pool->tx_level, p_pool->p_cfg->low_water);
+    return (num_free != 0);
+}
+
+void transport_pool_send_hci_trace(transport_pool_t *p_pool, wiced_bt_hci_trace_type_t type, uint16_t length, uint8_t *p_data)
+{
+    if (transport_pool_tx_check(p_pool))
+        wiced_transport_send_hci_trace(p_pool->p_tx_pool, type, length, p_data);
+}
@@ -0,0 +1,114 @@
+/*
+ * Copyright 2016-2020, Cypress Semiconductor Corporation or a subsidiary of
+ * Cypress Semiconductor Corporation. All Rights Reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software"), is owned by Cypress Semiconductor Corporation
+ * or one of its subsidiaries ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products. Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ */
+
+/** @file
+ *
+ * HCI transport buffers with usage accounting
+ *
+ * The size and number of the buffers receiving host commands, and of the
+ * pool the application sends from, come from a configuration block instead
+ * of being fixed in the transport configuration. The buffers in use are
+ * counted on both sides. Going down to the low water mark and running out
+ * of buffers are traced, once each time it happens, so that the host sees
+ * why commands or traces stall.
+ */
+
+#pragma once
+
+#include "wiced_bt_types.h"
+#include "wiced_bt_dev.h"
+#include "wiced_transport.h"
+
+/******************************************************
+ *                     Constants
+ ******************************************************/
+
+#define TRANSPORT_POOL_LEVEL_OK             0
+#define TRANSPORT_POOL_LEVEL_LOW            1   /* at or below the low water mark */
+#define TRANSPORT_POOL_LEVEL_EXHAUSTED      2
+
+/******************************************************
+ *                 Type Definitions
+ ******************************************************/
+
+typedef struct
+{
+    uint16_t    rx_buffer_size;     /* buffers receiving commands from the host */
+    uint8_t     rx_buffer_count;
+    uint16_t    tx_buffer_size;     /* pool of the application, 0 buffers for none */
+    uint8_t     tx_buffer_count;
+    uint8_t     low_water;          /* free buffers left when the host is warned */
+} transport_pool_cfg_t;
+
+typedef struct
+{
+    const transport_pool_cfg_t      *p_cfg;
+    wiced_transport_buffer_pool_t   *p_tx_pool;
+    uint8_t                         rx_in_use;
+    uint8_t                         rx_level;       /* TRANSPORT_POOL_LEVEL_xxx last reported */
+    uint8_t                         tx_level;
+    uint32_t                        rx_exhausted;   /* times the last receive buffer was taken */
+    uint32_t                        tx_exhausted;   /* sends dropped for lack of a buffer */
+} transport_pool_t;
+
+/******************************************************
+ *               Function Declarations
+ ******************************************************/
+
+/**
+ * Set the receive buffers of the transport configuration from p_cfg,
+ * initialize the transport and create the pool of the application.
+ */
+void transport_pool_init(transport_pool_t *p_pool, wiced_transport_cfg_t *p_transport_cfg, const transport_pool_cfg_t *p_cfg);
+
+/**
+ * Account for a receive buffer handed to the data handler.
+ */
+void transport_pool_rx_get(transport_pool_t *p_pool);
+
+/**
+ * Give a receive buffer back to the transport.
+ */
+void transport_pool_rx_free(transport_pool_t *p_pool, uint8_t *p_buffer);
+
+/**
+ * Check that the pool of the application has a buffer to send from.
+ *
+ * @return  WICED_FALSE if the pool is empty, the send is counted as dropped
+ */
+wiced_bool_t transport_pool_tx_check(transport_pool_t *p_pool);
+
+/**
+ * Send an HCI trace to the host from the pool of the application.
+ */
+void transport_pool_send_hci_trace(transport_pool_t *p_pool, wiced_bt_hci_trace_type_t type, uint16_t length, uint8_t *p_data);
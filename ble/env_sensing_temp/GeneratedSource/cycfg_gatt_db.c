@@ -54,6 +54,22 @@ const uint8_t gatt_database[] =
             CHAR_DESCRIPTOR_UUID16 (HDLD_ESS_TEMPERATURE_ENVIRONMENTAL_SENSING_MEASUREMENT, __UUID_DESCRIPTOR_ENVIRONMENTAL_SENSING_MEASUREMENT, LEGATTDB_PERM_READABLE),
             /* Descriptor: Valid Range */
             CHAR_DESCRIPTOR_UUID16 (HDLD_ESS_TEMPERATURE_VALID_RANGE, __UUID_DESCRIPTOR_VALID_RANGE, LEGATTDB_PERM_READABLE),
+            /* Descriptor: Environmental Sensing Trigger Setting */
+            CHAR_DESCRIPTOR_UUID16_WRITABLE (HDLD_ESS_TEMPERATURE_ES_TRIGGER_SETTING, __UUID_DESCRIPTOR_ENVIRONMENTAL_SENSING_TRIGGER_SETTING, LEGATTDB_PERM_READABLE | LEGATTDB_PERM_VARIABLE_LENGTH | LEGATTDB_PERM_WRITE_REQ),
+
+    /* Primary Service: Custom Temperature History */
+    PRIMARY_SERVICE_UUID128 (HDLS_TEMPERATURE_HISTORY, __UUID_SERVICE_CUSTOM_TEMPERATURE_HISTORY),
+        /* Characteristic: History */
+        CHARACTERISTIC_UUID128_WRITABLE (HDLC_TEMPERATURE_HISTORY_HISTORY, HDLC_TEMPERATURE_HISTORY_HISTORY_VALUE, __UUID_CHARACTERISTIC_HISTORY, LEGATTDB_CHAR_PROP_WRITE | LEGATTDB_CHAR_PROP_NOTIFY, LEGATTDB_PERM_VARIABLE_LENGTH | LEGATTDB_PERM_WRITE_REQ),
+            /* Descriptor: Client Characteristic Configuration */
+            CHAR_DESCRIPTOR_UUID16_WRITABLE (HDLD_TEMPERATURE_HISTORY_HISTORY_CLIENT_CHAR_CONFIG, __UUID_DESCRIPTOR_CLIENT_CHARACTERISTIC_CONFIGURATION, LEGATTDB_PERM_READABLE | LEGATTDB_PERM_WRITE_REQ),
+
+    /* Primary Service: Custom Sensor Aggregate */
+    PRIMARY_SERVICE_UUID128 (HDLS_SENSOR_AGGREGATE, __UUID_SERVICE_CUSTOM_SENSOR_AGGREGATE),
+        /* Characteristic: Aggregate */
+        CHARACTERISTIC_UUID128 (HDLC_SENSOR_AGGREGATE_AGGREGATE, HDLC_SENSOR_AGGREGATE_AGGREGATE_VALUE, __UUID_CHARACTERISTIC_AGGREGATE, LEGATTDB_CHAR_PROP_NOTIFY, LEGATTDB_PERM_NONE),
+            /* Descriptor: Client Characteristic Configuration */
+            CHAR_DESCRIPTOR_UUID16_WRITABLE (HDLD_SENSOR_AGGREGATE_AGGREGATE_CLIENT_CHAR_CONFIG, __UUID_DESCRIPTOR_CLIENT_CHARACTERISTIC_CONFIGURATION, LEGATTDB_PERM_READABLE | LEGATTDB_PERM_WRITE_REQ),
 
     /* Primary Service: Custom OTA Secure Firmware Upgrade */
     PRIMARY_SERVICE_UUID128 (HDLS_OTA_FW_UPGRADE_SERVICE, __UUID_SERVICE_CUSTOM_OTA_SECURE_FIRMWARE_UPGRADE),
@@ -78,6 +94,11 @@ uint8_t app_ess_temperature[]                                         = {0x00, 0
 uint8_t app_ess_temperature_client_char_config[]                      = {0x00, 0x00, };
 uint8_t app_ess_temperature_environmental_sensing_measurement[]       = {0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x05, 0x00, 0x00, 0x00, 0x0A, };
 uint8_t app_ess_temperature_valid_range[]                             = {0xD8, 0xFF, 0x7D, 0x00, };
+uint8_t app_ess_temperature_es_trigger_setting[]                      = {0x03, 0x00, 0x00, 0x00, };
+uint8_t app_temperature_history_history[]                             = {};
+uint8_t app_temperature_history_history_client_char_config[]          = {0x00, 0x00, };
+uint8_t app_sensor_aggregate_aggregate[]                              = {};
+uint8_t app_sensor_aggregate_aggregate_client_char_config[]           = {0x00, 0x00, };
 uint8_t app_ota_fw_upgrade_service_control_point[]                    = {};
 uint8_t app_ota_fw_upgrade_service_control_point_client_char_config[] = {0x00, 0x00, };
 uint8_t app_ota_fw_upgrade_service_data[]                             = {};
@@ -95,6 +116,11 @@ gatt_db_lookup_table_t app_gatt_db_ext_attr_tbl[] =
     { HDLD_ESS_TEMPERATURE_CLIENT_CHAR_CONFIG,                      2,      2,      app_ess_temperature_client_char_config },
     { HDLD_ESS_TEMPERATURE_ENVIRONMENTAL_SENSING_MEASUREMENT,       11,     11,     app_ess_temperature_environmental_sensing_measurement },
     { HDLD_ESS_TEMPERATURE_VALID_RANGE,                             4,      4,      app_ess_temperature_valid_range },
+    { HDLD_ESS_TEMPERATURE_ES_TRIGGER_SETTING,                      4,      1,      app_ess_temperature_es_trigger_setting },
+    { HDLC_TEMPERATURE_HISTORY_HISTORY_VALUE,                       0,      0,      app_temperature_history_history },
+    { HDLD_TEMPERATURE_HISTORY_HISTORY_CLIENT_CHAR_CONFIG,          2,      2,      app_temperature_history_history_client_char_config },
+    { HDLC_SENSOR_AGGREGATE_AGGREGATE_VALUE,                        0,      0,      app_sensor_aggregate_aggregate },
+    { HDLD_SENSOR_AGGREGATE_AGGREGATE_CLIENT_CHAR_CONFIG,           2,      2,      app_sensor_aggregate_aggregate_client_char_config },
     { HDLC_OTA_FW_UPGRADE_SERVICE_CONTROL_POINT_VALUE,              0,      0,      app_ota_fw_upgrade_service_control_point },
     { HDLD_OTA_FW_UPGRADE_SERVICE_CONTROL_POINT_CLIENT_CHAR_CONFIG, 2,      2,      app_ota_fw_upgrade_service_control_point_client_char_config },
     { HDLC_OTA_FW_UPGRADE_SERVICE_DATA_VALUE,                       0,      0,      app_ota_fw_upgrade_service_data },
@@ -110,6 +136,11 @@ const uint16_t app_ess_temperature_len = (sizeof(app_ess_temperature));
 const uint16_t app_ess_temperature_client_char_config_len = (sizeof(app_ess_temperature_client_char_config));
 const uint16_t app_ess_temperature_environmental_sensing_measurement_len = (sizeof(app_ess_temperature_environmental_sensing_measurement));
 const uint16_t app_ess_temperature_valid_range_len = (sizeof(app_ess_temperature_valid_range));
+const uint16_t app_ess_temperature_es_trigger_setting_len = (sizeof(app_ess_temperature_es_trigger_setting));
+const uint16_t app_temperature_history_history_len = (sizeof(app_temperature_history_history));
+const uint16_t app_temperature_history_history_client_char_config_len = (sizeof(app_temperature_history_history_client_char_config));
+const uint16_t app_sensor_aggregate_aggregate_len = (sizeof(app_sensor_aggregate_aggregate));
+const uint16_t app_sensor_aggregate_aggregate_client_char_config_len = (sizeof(app_sensor_aggregate_aggregate_client_char_config));
 const uint16_t app_ota_fw_upgrade_service_control_point_len = (sizeof(app_ota_fw_upgrade_service_control_point));
 const uint16_t app_ota_fw_upgrade_service_control_point_client_char_config_len = (sizeof(app_ota_fw_upgrade_service_control_point_client_char_config));
 const uint16_t app_ota_fw_upgrade_service_data_len = (sizeof(app_ota_fw_upgrade_service_data));
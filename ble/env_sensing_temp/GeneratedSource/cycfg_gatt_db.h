@@ -40,9 +40,14 @@
 #define __UUID_DESCRIPTOR_CLIENT_CHARACTERISTIC_CONFIGURATION           0x2902
 #define __UUID_DESCRIPTOR_ENVIRONMENTAL_SENSING_MEASUREMENT             0x290C
 #define __UUID_DESCRIPTOR_VALID_RANGE                                   0x2906
+#define __UUID_DESCRIPTOR_ENVIRONMENTAL_SENSING_TRIGGER_SETTING         0x290D
 #define __UUID_SERVICE_CUSTOM_OTA_SECURE_FIRMWARE_UPGRADE               0xD8u, 0x8Bu, 0x76u, 0x46u, 0x72u, 0x9Du, 0xBDu, 0xA1u, 0x7Au, 0x44u, 0x25u, 0xF4u, 0x10u, 0x11u, 0x26u, 0xC7u
 #define __UUID_CHARACTERISTIC_CONTROL_POINT                             0x1Bu, 0x66u, 0x6Cu, 0x08u, 0x0Au, 0x57u, 0x8Eu, 0x83u, 0x99u, 0x4Eu, 0xA7u, 0xF7u, 0xBFu, 0x50u, 0xDDu, 0xA3u
 #define __UUID_CHARACTERISTIC_DATA                                      0x26u, 0xFEu, 0x2Eu, 0xE7u, 0x09u, 0x24u, 0x4Fu, 0xB7u, 0x91u, 0x40u, 0x61u, 0xD9u, 0x7Au, 0x6Cu, 0xE8u, 0xA2u
+#define __UUID_SERVICE_CUSTOM_TEMPERATURE_HISTORY                       0x5Eu, 0x3Cu, 0x61u, 0x0Bu, 0x8Fu, 0x27u, 0x4Au, 0x9Du, 0xB1u, 0x46u, 0x0Cu, 0x72u, 0x01u, 0x00u, 0x4Eu, 0x1Fu
+#define __UUID_CHARACTERISTIC_HISTORY                                   0x5Eu, 0x3Cu, 0x61u, 0x0Bu, 0x8Fu, 0x27u, 0x4Au, 0x9Du, 0xB1u, 0x46u, 0x0Cu, 0x72u, 0x02u, 0x00u, 0x4Eu, 0x1Fu
+#define __UUID_SERVICE_CUSTOM_SENSOR_AGGREGATE                          0x5Eu, 0x3Cu, 0x61u, 0x0Bu, 0x8Fu, 0x27u, 0x4Au, 0x9Du, 0xB1u, 0x46u, 0x0Cu, 0x72u, 0x03u, 0x00u, 0x4Eu, 0x1Fu
+#define __UUID_CHARACTERISTIC_AGGREGATE                                 0x5Eu, 0x3Cu, 0x61u, 0x0Bu, 0x8Fu, 0x27u, 0x4Au, 0x9Du, 0xB1u, 0x46u, 0x0Cu, 0x72u, 0x04u, 0x00u, 0x4Eu, 0x1Fu
 
 /* Service Generic Access */
 #define HDLS_GAP                                                        0x01
@@ -67,6 +72,24 @@
 #define HDLD_ESS_TEMPERATURE_ENVIRONMENTAL_SENSING_MEASUREMENT          0x0B
 /* Descriptor Valid Range */
 #define HDLD_ESS_TEMPERATURE_VALID_RANGE                                0x0C
+/* Descriptor Environmental Sensing Trigger Setting */
+#define HDLD_ESS_TEMPERATURE_ES_TRIGGER_SETTING                         0x0D
+
+/* Service Custom Temperature History */
+#define HDLS_TEMPERATURE_HISTORY                                        0x0E
+/* Characteristic History */
+#define HDLC_TEMPERATURE_HISTORY_HISTORY                                0x0F
+#define HDLC_TEMPERATURE_HISTORY_HISTORY_VALUE                          0x10
+/* Descriptor Client Characteristic Configuration */
+#define HDLD_TEMPERATURE_HISTORY_HISTORY_CLIENT_CHAR_CONFIG             0x11
+
+/* Service Custom Sensor Aggregate */
+#define HDLS_SENSOR_AGGREGATE                                           0x12
+/* Characteristic Aggregate */
+#define HDLC_SENSOR_AGGREGATE_AGGREGATE                                 0x13
+#define HDLC_SENSOR_AGGREGATE_AGGREGATE_VALUE                           0x14
+/* Descriptor Client Characteristic Configuration */
+#define HDLD_SENSOR_AGGREGATE_AGGREGATE_CLIENT_CHAR_CONFIG              0x15
 
 /* Service Custom OTA Secure Firmware Upgrade */
 #define HDLS_OTA_FW_UPGRADE_SERVICE                                     HANDLE_OTA_FW_UPGRADE_SERVICE
@@ -105,6 +128,16 @@ extern uint8_t app_ess_temperature_environmental_sensing_measurement[];
 extern const uint16_t app_ess_temperature_environmental_sensing_measurement_len;
 extern uint8_t app_ess_temperature_valid_range[];
 extern const uint16_t app_ess_temperature_valid_range_len;
+extern uint8_t app_ess_temperature_es_trigger_setting[];
+extern const uint16_t app_ess_temperature_es_trigger_setting_len;
+extern uint8_t app_temperature_history_history[];
+extern const uint16_t app_temperature_history_history_len;
+extern uint8_t app_temperature_history_history_client_char_config[];
+extern const uint16_t app_temperature_history_history_client_char_config_len;
+extern uint8_t app_sensor_aggregate_aggregate[];
+extern const uint16_t app_sensor_aggregate_aggregate_len;
+extern uint8_t app_sensor_aggregate_aggregate_client_char_config[];
+extern const uint16_t app_sensor_aggregate_aggregate_client_char_config_len;
 extern uint8_t app_ota_fw_upgrade_service_control_point[];
 extern const uint16_t app_ota_fw_upgrade_service_control_point_len;
 extern uint8_t app_ota_fw_upgrade_service_control_point_client_char_config[];
@@ -68,6 +68,10 @@
 #endif
 #include "wiced.h"
 #include "wiced_bt_ota_firmware_upgrade.h"
+#include "sample_filter.h"
+#include "thermistor_history.h"
+#include "thermistor_sensors.h"
+#include "app_log.h"
 
 /******************************************************************************
  *                                Constants
@@ -77,6 +81,24 @@
  */
 #define POLL_TIMER_IN_MS         (5000)
 
+/* Thermistor readings taken every POLL_TIMER_IN_MS and the filter they go
+ * through. The filtered value is the one published. The IIR filter state
+ * carries over from one period to the next, the window of the average and
+ * median filters is usually the number of readings.
+ */
+#ifndef THERMISTOR_OVERSAMPLE
+#define THERMISTOR_OVERSAMPLE    (8)
+#endif
+#ifndef THERMISTOR_FILTER
+#define THERMISTOR_FILTER        SAMPLE_FILTER_MEDIAN
+#endif
+#ifndef THERMISTOR_FILTER_WINDOW
+#define THERMISTOR_FILTER_WINDOW THERMISTOR_OVERSAMPLE
+#endif
+#ifndef THERMISTOR_IIR_SHIFT
+#define THERMISTOR_IIR_SHIFT     (3)
+#endif
+
 /* Absolute value of an integer. The absolute value is always positive. */
 #ifndef ABS
 #define ABS(N) ((N<0)?(-N):(N))
@@ -115,8 +137,22 @@ extern const wiced_bt_cfg_buf_pool_t wiced_app_cfg_buf_pools[];
 /* This wiced_timer changes for every millisecond */
 static wiced_timer_t            milli_seconds_timer;
 
-/* Status variable for connection ID */
-uint16_t                        thermistor_conn_id;
+/* Filter of the thermistor readings */
+static sample_filter_t          thermistor_filter;
+
+/* Seconds since the application started, the time of the history records */
+static uint32_t                 thermistor_uptime_s;
+
+/* The thermistor as a sensor of the Aggregate characteristic. Its value is the
+ * one of the ESS Temperature characteristic.
+ */
+static const thermistor_sensor_t thermistor_temperature_sensor =
+{
+    .uuid      = __UUID_CHARACTERISTIC_TEMPERATURE,
+    .value_len = 2,
+    .p_value   = app_ess_temperature,
+    .p_sample  = thermistor_sample_temperature,
+};
 
 /*******************************************************************
  *                              Function Declarations/Prototypes
@@ -131,6 +167,10 @@ static void seconds_timer_temperature_cb(uint32_t arg);
 
 static void thermistor_app_init(void);
 
+static int16_t thermistor_read_filtered(void);
+
+static void thermistor_sample_temperature(uint8_t *p_value);
+
 extern void thermistor_init(void);
 extern int16_t thermistor_read(void);
 
@@ -275,51 +315,84 @@ static void seconds_timer_temperature_cb(uint32_t arg)
     volatile int16_t    temperature             = 0;
 
     /*
-     * Temperature values might vary upto +/-2 degree Celsius
+     * Sample all the registered sensors at once, each one updates the value
+     * of its characteristic for both read operation and notify operation.
      */
-    temperature = thermistor_read();
-    WICED_BT_TRACE("\r\nTemperature (in degree Celsius) \t\t%d.%02d\r\n",
-                    (temperature / 100),
-                    ABS(temperature % 100));
-
-    /*
-     * app_ess_temperature value is set both for read operation and
-     * notify operation.
-     */
-    app_ess_temperature[0] = (uint8_t) (temperature & 0xff);
-    app_ess_temperature[1] = (uint8_t) ((temperature >> 8) & 0xff);
-
-    /* To check that connection is up and
-     * client is registered to receive notifications
-     * to send temperature data in Little Endian Format
-     * as per BT SIG's ESS Specification
+    thermistor_sensors_sample();
+    temperature = (int16_t) (app_ess_temperature[0] |
+                             (app_ess_temperature[1] << 8));
+    APP_LOG_INFO("\r\nTemperature (in degree Celsius) \t\t%d.%02d\r\n",
+                 (temperature / 100),
+                 ABS(temperature % 100));
+
+    /* Keep every measurement for the gateway to download later on */
+    thermistor_uptime_s += POLL_TIMER_IN_MS / 1000;
+    thermistor_history_add(thermistor_uptime_s, temperature);
+
+    /* Send temperature data in Little Endian Format as per BT SIG's ESS
+     * Specification to each connected client registered to receive
+     * notifications, if its trigger condition is met
      */
-    if (0 != thermistor_conn_id)
+    if (0 != thermistor_conn_count)
     {
-        if (0 != (app_ess_temperature_client_char_config[0] &
-                 GATT_CLIENT_CONFIG_NOTIFICATION))
-        {
-            WICED_BT_TRACE("This device is connected to a central device and\r\n"
-                           "GATT client notifications are enabled\r\n");
+        thermistor_notify_temperature(temperature, POLL_TIMER_IN_MS);
 
-            wiced_bt_gatt_send_notification(thermistor_conn_id,
-                                            HDLC_ESS_TEMPERATURE_VALUE,
-                                            app_ess_temperature_len,
-                                            app_ess_temperature);
-        }
-        else
-        {
-            WICED_BT_TRACE("This device is connected to a central device and\r\n"
-                           "GATT client notifications are not enabled\r\n");
-        }
+        /* All the sensor values in a single batched notification */
+        thermistor_notify_aggregate();
     }
     else
     {
-        WICED_BT_TRACE("This device is not connected to any BLE central device\r\n");
+        APP_LOG_DBG("This device is not connected to any BLE central device\r\n");
     }
 
 }
 
+/*
+ Function name:
+ thermistor_read_filtered
+
+ Function Description:
+ @brief  Take THERMISTOR_OVERSAMPLE thermistor readings and pass them through
+         the filter. The thermistor library converts each ADC reading to
+         temperature with its resistance lookup table.
+
+ @param  void
+
+ @return int16_t Filtered temperature in 0.01 degree Celsius
+ */
+static int16_t thermistor_read_filtered(void)
+{
+    int16_t temperature = 0;
+    int     i;
+
+    for (i = 0; i < THERMISTOR_OVERSAMPLE; i++)
+    {
+        temperature = sample_filter_add(&thermistor_filter, thermistor_read());
+    }
+    return temperature;
+}
+
+/*
+ Function name:
+ thermistor_sample_temperature
+
+ Function Description:
+ @brief  Sampling function of the thermistor sensor. A single reading might
+         vary upto +/-2 degree Celsius, the value is the filtered one of
+         several readings.
+
+ @param  p_value  Temperature characteristic value, in Little Endian Format
+
+ @return void
+ */
+static void thermistor_sample_temperature(uint8_t *p_value)
+{
+    int16_t temperature = thermistor_read_filtered();
+
+    p_value[0] = (uint8_t) (temperature & 0xff);
+    p_value[1] = (uint8_t) ((temperature >> 8) & 0xff);
+}
+
 /*
  Function name:
  thermistor_app_init
@@ -337,8 +410,9 @@ static void thermistor_app_init(void)
 
     wiced_bt_gatt_status_t status;
 
-    /* Register with stack to receive GATT callback */
-    status = wiced_bt_gatt_register(thermistor_event_handler);
+    /* Register with stack to receive GATT callback, the GATT server core
+     * started by thermistor_gatt_index_init() serves the requests */
+    status = wiced_bt_gatt_register(gatt_server_event_handler);
     WICED_BT_TRACE("\r\nGATT status:\t");
     WICED_BT_TRACE(gatt_status_name(status));
     WICED_BT_TRACE("\r\n");
@@ -349,6 +423,7 @@ static void thermistor_app_init(void)
     {
         WICED_BT_TRACE("\r\n GATT DB Initialization not successful\r\n");
     }
+    thermistor_gatt_index_init();
 
     /*
      * The thermistor_init() automatically powers up ADC block before reading
@@ -357,6 +432,15 @@ static void thermistor_app_init(void)
      * accuracy of the reading.
      */
     thermistor_init();           /*ADC Initialization*/
+    sample_filter_init(&thermistor_filter, THERMISTOR_FILTER,
+                       THERMISTOR_FILTER_WINDOW, THERMISTOR_IIR_SHIFT);
+    WICED_BT_TRACE("Thermistor %d readings per period, %s filter\r\n",
+                   THERMISTOR_OVERSAMPLE,
+                   sample_filter_name(THERMISTOR_FILTER));
+    thermistor_sensor_register(&thermistor_temperature_sensor);
+
+    /* Restore the temperature history saved in NVRAM */
+    thermistor_history_init();
 
     /* Starting the MILLI_SECONDS timer for every POLL_TIMER_IN_MS*/
     if ( WICED_SUCCESS == wiced_init_timer( &milli_seconds_timer,
@@ -52,92 +52,214 @@
 #include "wiced_bt_ble.h"
 #include "wiced_bt_trace.h"
 #include "wiced_bt_ota_firmware_upgrade.h"
+#include "gatt_attr_store.h"
+#include "gatt_server.h"
+#include "conn_policy.h"
+#include "thermistor_history.h"
+#include "thermistor_sensors.h"
 
 /* *******************************************************************
- *                              FUNCTION DEFINITIONS
+ *                              CONSTANTS
  * *******************************************************************/
-/*
- Function Name:
- thermistor_event_handler
+/* Smallest change of the temperature, in 0.01 degree Celsius, that counts
+ * as a changed value for the ES Trigger Setting conditions
+ */
+#ifndef THERMISTOR_NOTIFY_DEADBAND
+#define THERMISTOR_NOTIFY_DEADBAND          (20)
+#endif
 
- Function Description:
- @brief  This Function handles the all the GATT events - GATT Event Handler
+/* Longest time without a notification while the trigger condition waits for
+ * a changed value, 0 disables the keep-alive notification
+ */
+#ifndef THERMISTOR_NOTIFY_MAX_INTERVAL_MS
+#define THERMISTOR_NOTIFY_MAX_INTERVAL_MS   (300000)
+#endif
 
- @param event            BLE GATT event type
- @param p_event_data     Pointer to BLE GATT event data
+#ifndef MIN
+#define MIN(A, B) (((A) < (B)) ? (A) : (B))
+#endif
 
- @return wiced_bt_gatt_status_t  BLE GATT status
+/* Absolute value of an integer. The absolute value is always positive. */
+#ifndef ABS
+#define ABS(N) ((N<0)?(-N):(N))
+#endif
+
+/* *******************************************************************
+ *                              TYPE DEFINITIONS
+ * *******************************************************************/
+/* Application state of a connected central, next to its entry in the GATT
+ * server core which keeps the CCCDs and the MTU of the connection
  */
-wiced_bt_gatt_status_t
-thermistor_event_handler(wiced_bt_gatt_evt_t event,
-                         wiced_bt_gatt_event_data_t *p_event_data)
+typedef struct
 {
+    /* Last notified temperature and the time since it was notified */
+    int16_t      notify_last;
+    wiced_bool_t notify_valid;
+    uint32_t     notify_age_ms;
 
-    wiced_bt_gatt_status_t status = WICED_BT_GATT_ERROR;
-    wiced_bt_gatt_connection_status_t *p_conn_status = NULL;
-    wiced_bt_gatt_attribute_request_t *p_attr_req = NULL;
+    /* PHY and connection parameters of the link */
+    conn_policy_t policy;
+} thermistor_conn_t;
 
-    switch (event)
-    {
+/* *******************************************************************
+ *                              VARIABLES
+ * *******************************************************************/
+/* Values of app_gatt_db_ext_attr_tbl with the hooks of thermistor_attr_hooks, the OTA
+ * handles beyond the ESS ones are not in the slots */
+static gatt_attr_store_t thermistor_attr_store;
+static uint8_t           thermistor_attr_slots[GATT_ATTR_INDEX_SLOTS(HDLC_GAP_DEVICE_NAME_VALUE, HDLD_SENSOR_AGGREGATE_AGGREGATE_CLIENT_CHAR_CONFIG)];
+static uint8_t           thermistor_hook_slots[GATT_ATTR_INDEX_SLOTS(HDLD_ESS_TEMPERATURE_ES_TRIGGER_SETTING, HDLC_TEMPERATURE_HISTORY_HISTORY_VALUE)];
+
+/* Connected centrals, in the GATT server core and in the application */
+static gatt_server_conn_t thermistor_server_conns[THERMISTOR_MAX_CONNECTIONS];
+static thermistor_conn_t  thermistor_conns[THERMISTOR_MAX_CONNECTIONS];
+
+/* Number of connected centrals */
+uint8_t                  thermistor_conn_count;
+
+/* A couple of bytes every few seconds: the interval lets a history download
+ * go at a fair pace and the latency lets the radio sleep for a second when
+ * there is nothing to send
+ */
+static const conn_policy_cfg_t thermistor_conn_policy_cfg =
+{
+    .bytes_per_s  = 1,
+    .max_delay_ms = 100,
+    .max_idle_ms  = 1000,
+    .allow_coded  = WICED_FALSE,
+};
 
-    case GATT_CONNECTION_STATUS_EVT:
-        status = thermistor_connect_callback(&p_event_data->connection_status);
-        break;
+/* *******************************************************************
+ *                              FUNCTION DECLARATIONS
+ * *******************************************************************/
+static void thermistor_notify_reset(thermistor_conn_t *p_conn);
 
-    case GATT_ATTRIBUTE_REQUEST_EVT:
-        p_attr_req = &p_event_data->attribute_request;
-        status = thermistor_server_callback(p_attr_req->conn_id,
-                                            p_attr_req->request_type,
-                                            &p_attr_req->data);
-        break;
+static wiced_bool_t thermistor_notify_due(thermistor_conn_t *p_conn,
+                                          int16_t temperature,
+                                          uint32_t elapsed_ms);
 
-    default:
-        WICED_BT_TRACE("Other than GATT_CONNECTION_STATUS_EVT and "
-                       "GATT_ATTRIBUTE_REQUEST_EVT\r\n");
-        status = WICED_BT_GATT_SUCCESS;
-        break;
+static void thermistor_cccd_changed(gatt_server_conn_t *p_conn, uint16_t value_handle, uint16_t cccd);
 
-    }
+static wiced_bool_t thermistor_ota_request(wiced_bt_gatt_attribute_request_t *p_req, wiced_bt_gatt_status_t *p_status);
 
-    return status;
-}
+static wiced_bt_gatt_status_t thermistor_set_trigger_setting(uint16_t conn_id, gatt_db_lookup_table_t *p_attr, uint8_t *p_val, uint16_t len);
+
+static wiced_bt_gatt_status_t thermistor_history_command(uint16_t conn_id, gatt_db_lookup_table_t *p_attr, uint8_t *p_val, uint16_t len);
+
+/* Attributes with hooks, a new characteristic adds its entries here */
+static const gatt_attr_store_hook_t thermistor_attr_hooks[] =
+{
+    /* { attribute handle,                                  read hook,              write hook } */
+    { HDLD_ESS_TEMPERATURE_ES_TRIGGER_SETTING,              NULL,                   thermistor_set_trigger_setting },
+    { HDLC_TEMPERATURE_HISTORY_HISTORY_VALUE,               NULL,                   thermistor_history_command },
+};
+
+/* Client Characteristic Configuration descriptors, kept per connection by the GATT server core */
+static const gatt_server_cccd_t thermistor_cccds[] =
+{
+    /* { characteristic value handle,              client configuration descriptor handle } */
+    { HDLC_ESS_TEMPERATURE_VALUE,                   HDLD_ESS_TEMPERATURE_CLIENT_CHAR_CONFIG },
+    { HDLC_TEMPERATURE_HISTORY_HISTORY_VALUE,       HDLD_TEMPERATURE_HISTORY_HISTORY_CLIENT_CHAR_CONFIG },
+    { HDLC_SENSOR_AGGREGATE_AGGREGATE_VALUE,        HDLD_SENSOR_AGGREGATE_AGGREGATE_CLIENT_CHAR_CONFIG },
+};
+
+static const gatt_server_cfg_t thermistor_gatt_server_cfg =
+{
+    .p_read          = thermistor_get_value,
+    .p_write         = thermistor_set_value,
+    .p_cccds         = thermistor_cccds,
+    .num_cccds       = sizeof(thermistor_cccds) / sizeof(thermistor_cccds[0]),
+    .p_conn_cb       = thermistor_connect_callback,
+    .p_cccd_cb       = thermistor_cccd_changed,
+    .p_request_hook  = thermistor_ota_request,
+    .p_congestion_cb = thermistor_history_congestion,
+};
+
+/* *******************************************************************
+ *                              FUNCTION DEFINITIONS
+ * *******************************************************************/
+/*
+ Function Name:
+ thermistor_gatt_index_init
 
+ Function Description:
+ @brief  Builds the attribute store, the handle indexes of the GATT lookup
+         table and of the attribute hooks used by thermistor_get_value and
+         thermistor_set_value, and starts the GATT server core which
+         serves the requests with them. Invoked once the GATT database is
+         initialized.
+
+ @param  void
+
+ @return void
+ */
+void thermistor_gatt_index_init(void)
+{
+    GATT_ATTR_STORE_INIT(&thermistor_attr_store,
+                         thermistor_attr_slots,
+                         thermistor_attr_hooks,
+                         thermistor_hook_slots);
+
+    gatt_server_init(&thermistor_gatt_server_cfg, thermistor_server_conns, THERMISTOR_MAX_CONNECTIONS);
+}
 
 /*
  Function Name:
  thermistor_connect_callback
 
  Function Description:
- @brief  The callback function is invoked when GATT_CONNECTION_STATUS_EVT occurs
-         in GATT Event handler function
+ @brief  The callback function is invoked by the GATT server core when
+         GATT_CONNECTION_STATUS_EVT occurs, once it updated its connection
+         entry
 
+ @param p_conn            Connection entry of the GATT server core, NULL if
+                          there was no room for the connection
  @param p_conn_status     Pointer to BLE GATT connection status
 
- @return wiced_bt_gatt_status_t  BLE GATT status
+ @return void
  */
-wiced_bt_gatt_status_t
-thermistor_connect_callback(wiced_bt_gatt_connection_status_t *p_conn_status)
+void
+thermistor_connect_callback(gatt_server_conn_t *p_conn,
+                            wiced_bt_gatt_connection_status_t *p_conn_status)
 {
 
-    wiced_result_t gatt_status = WICED_BT_GATT_ERROR;
+    thermistor_conn_t *p_state = NULL;
+
+    if (NULL != p_conn)
+    {
+        p_state = &thermistor_conns[gatt_server_conn_index(p_conn)];
+    }
 
-    if ((p_conn_status->connected) && (thermistor_conn_id == 0))
+    if (p_conn_status->connected)
     {
         /* Device has connected */
         WICED_BT_TRACE("\r\nConnected to BDA: '%B', Connection ID: '%d'\r\n",
                         p_conn_status->bd_addr,
                         p_conn_status->conn_id);
+
+        if (NULL == p_state)
+        {
+            /* The stack does not allow more than THERMISTOR_MAX_CONNECTIONS,
+             * the GATT server core disconnects */
+            WICED_BT_TRACE("\r\nNo room for connection %d\r\n", p_conn_status->conn_id);
+            return;
+        }
+        memset(p_state, 0, sizeof(*p_state));
+        thermistor_conn_count++;
+
         wiced_hal_gpio_set_pin_output(CONNECTION_LED, GPIO_PIN_OUTPUT_LOW);
-        thermistor_conn_id  = p_conn_status->conn_id;
-        gatt_status         = wiced_bt_start_advertisements(BTM_BLE_ADVERT_OFF,
-                                                            BLE_ADDR_PUBLIC,
-                                                            NULL);
 
-        /* Setting 2M PHY BLE connection if the peer device supports */
-        if (WICED_SUCCESS != set_ble_2m_phy(p_conn_status))
+        /* Keep advertising while another gateway can connect */
+        wiced_bt_start_advertisements(
+                (thermistor_conn_count < THERMISTOR_MAX_CONNECTIONS) ?
+                    BTM_BLE_ADVERT_UNDIRECTED_HIGH : BTM_BLE_ADVERT_OFF,
+                BLE_ADDR_PUBLIC,
+                NULL);
+
+        /* Pick the PHY from the RSSI and the connection parameters from the data rate */
+        if (!conn_policy_start(&p_state->policy, &thermistor_conn_policy_cfg, p_conn_status->bd_addr))
         {
-            WICED_BT_TRACE("\r\nUnable to configure "
-                           "preferred PHY as LE 2M PHY\r\n");
+            WICED_BT_TRACE("\r\nUnable to follow the link policy\r\n");
         }
     }
     else
@@ -148,335 +270,507 @@ thermistor_connect_callback(wiced_bt_gatt_connection_status_t *p_conn_status)
         WICED_BT_TRACE("\r\nReason for disconnection: \t");
         WICED_BT_TRACE(gatt_disconn_reason_name(p_conn_status->reason));
         WICED_BT_TRACE("\r\n");
-        wiced_hal_gpio_set_pin_output(CONNECTION_LED, GPIO_PIN_OUTPUT_HIGH);
-
-        /* Handle the disconnection */
-        thermistor_conn_id  = 0;
 
         /*
-         * Reset the CCCD value so that on a reconnect CCCD (notifications)
-         * will be off
+         * The GATT server core frees the connection entry so that on a
+         * reconnect CCCD (notifications) will be off. A download is not
+         * resumed either.
          */
-        app_ess_temperature_client_char_config[0] = 0;
-        gatt_status = wiced_bt_start_advertisements(BTM_BLE_ADVERT_UNDIRECTED_HIGH,
-                                                    BLE_ADDR_PUBLIC,
-                                                    NULL);
+        if (NULL != p_state)
+        {
+            conn_policy_stop(&p_state->policy);
+            thermistor_conn_count--;
+        }
+        thermistor_history_download_stop(p_conn_status->conn_id);
+
+        if (0 == thermistor_conn_count)
+        {
+            wiced_hal_gpio_set_pin_output(CONNECTION_LED, GPIO_PIN_OUTPUT_HIGH);
+        }
+
+        wiced_bt_start_advertisements(BTM_BLE_ADVERT_UNDIRECTED_HIGH,
+                                      BLE_ADDR_PUBLIC,
+                                      NULL);
     }
 
     /* Pass connection up/down event to the OTA FW upgrade library */
     wiced_ota_fw_upgrade_connection_status_event(p_conn_status);
-
-    return gatt_status;
 }
 
 /*
  Function Name:
- thermistor_server_callback
+ thermistor_ota_request
 
  Function Description:
- @brief  The callback function is invoked when GATT_ATTRIBUTE_REQUEST_EVT occurs
-         in GATT Event handler function. GATT Server Event Callback function.
+ @brief  Request hook of the GATT server core. The requests for the OTA FW
+         upgrade service are passed to the library to process, the GATT
+         server core serves the others.
 
- @param conn_id  Connection ID from GATT Connection event
- @param type     GATT Request type
- @param p_data   Pointer to BLE GATT request data
+ @param p_req     Pointer to BLE GATT attribute request
+ @param p_status  BLE GATT status of a request served
 
- @return wiced_bt_gatt_status_t  BLE GATT status
+ @return wiced_bool_t  WICED_TRUE if the request was for the OTA FW upgrade service
  */
-wiced_bt_gatt_status_t
-thermistor_server_callback(uint16_t conn_id,
-                           wiced_bt_gatt_request_type_t type,
-                           wiced_bt_gatt_request_data_t *p_data)
+static wiced_bool_t thermistor_ota_request(wiced_bt_gatt_attribute_request_t *p_req, wiced_bt_gatt_status_t *p_status)
 {
+    uint16_t handle;
 
-    wiced_bt_gatt_status_t status = WICED_BT_GATT_ERROR;
-
-    switch (type)
+    switch (p_req->request_type)
     {
-
     case GATTS_REQ_TYPE_READ:
-        status = thermistor_read_handler(&p_data->read_req, conn_id);
+        handle = p_req->data.read_req.handle;
         break;
 
     case GATTS_REQ_TYPE_WRITE:
-        status = thermistor_write_handler(&p_data->write_req, conn_id);
+        handle = p_req->data.write_req.handle;
         break;
 
     case GATTS_REQ_TYPE_CONF:
-        status = thermistor_indication_cfm_handler(conn_id, p_data->handle);
+        handle = p_req->data.handle;
         break;
+
+    default:
+        return WICED_FALSE;
     }
 
-    return status;
+    switch (handle)
+    {
+    case HANDLE_OTA_FW_UPGRADE_CHARACTERISTIC_CONTROL_POINT:
+    case HANDLE_OTA_FW_UPGRADE_CONTROL_POINT:
+    case HANDLE_OTA_FW_UPGRADE_CLIENT_CONFIGURATION_DESCRIPTOR:
+    case HANDLE_OTA_FW_UPGRADE_CHARACTERISTIC_DATA:
+    case HANDLE_OTA_FW_UPGRADE_DATA:
+    case HANDLE_OTA_FW_UPGRADE_CHARACTERISTIC_APP_INFO:
+    case HANDLE_OTA_FW_UPGRADE_APP_INFO:
+        break;
+
+    default:
+        return WICED_FALSE;
+    }
+
+    switch (p_req->request_type)
+    {
+    case GATTS_REQ_TYPE_READ:
+        *p_status = wiced_ota_fw_upgrade_read_handler(p_req->conn_id, &p_req->data.read_req);
+        break;
+
+    case GATTS_REQ_TYPE_WRITE:
+        *p_status = wiced_ota_fw_upgrade_write_handler(p_req->conn_id, &p_req->data.write_req);
+        break;
+
+    default:
+        *p_status = wiced_ota_fw_upgrade_indication_cfm_handler(p_req->conn_id, handle);
+        break;
+    }
+    return WICED_TRUE;
 }
 
 /*
  Function Name:
- thermistor_write_handler
+ thermistor_get_value
 
  Function Description:
- @brief  The function is invoked when GATTS_REQ_TYPE_WRITE is received from the
-         client device and is invoked GATT Server Event Callback function. This
-         handles "Write Requests" received from Client device.
+ @brief  The function is invoked by the GATT server core to get a Value from
+         GATT DB, or from the read hook of the attribute if it has one.
 
- @param p_write_req   Pointer to BLE GATT write request
- @param conn_id  Connection ID from GATT Connection event
+ @param conn_id      Connection ID from GATT Connection event
+ @param attr_handle  GATT attribute handle
+ @param p_val        Pointer to BLE GATT read request value
+ @param len          Maximum length of GATT read request
+ @param p_len        Pointer to BLE GATT read request length
 
  @return wiced_bt_gatt_status_t  BLE GATT status
  */
 wiced_bt_gatt_status_t
-thermistor_write_handler(wiced_bt_gatt_write_t *p_write_req,
-                         uint16_t conn_id)
+thermistor_get_value(uint16_t conn_id,
+                     uint16_t attr_handle,
+                     uint8_t *p_val,
+                     uint16_t len,
+                     uint16_t *p_len)
 {
+    /* A value longer than the buffer is read again by the GATT server core for a read blob */
+    return gatt_attr_store_get_value(&thermistor_attr_store, attr_handle, conn_id, p_val, len, p_len);
+}
 
-    switch(p_write_req->handle)
-    {
-    /*
-     * If write request is for the OTA FW upgrade service, pass it to the
-     * library to process
-     */
-        case HANDLE_OTA_FW_UPGRADE_CHARACTERISTIC_CONTROL_POINT:
-        case HANDLE_OTA_FW_UPGRADE_CONTROL_POINT:
-        case HANDLE_OTA_FW_UPGRADE_CLIENT_CONFIGURATION_DESCRIPTOR:
-        case HANDLE_OTA_FW_UPGRADE_CHARACTERISTIC_DATA:
-        case HANDLE_OTA_FW_UPGRADE_DATA:
-        case HANDLE_OTA_FW_UPGRADE_CHARACTERISTIC_APP_INFO:
-        case HANDLE_OTA_FW_UPGRADE_APP_INFO:
-                return wiced_ota_fw_upgrade_write_handler(conn_id, p_write_req);
-                break;
-        default:
-            /* Handle normal (non-OTA) indication confirmation requests here */
-            /* Attempt to perform the Write Request */
-            return thermistor_set_value(p_write_req->handle,
-                                        conn_id,
-                                        p_write_req->p_val,
-                                        p_write_req->val_len);
-            break;
-    }
+/*
+ Function Name:
+ thermistor_set_value
+
+ Function Description:
+ @brief  The function is invoked by the GATT server core to set a value
+         to GATT DB, through the write hook of the attribute if it has one.
+
+ @param conn_id      Connection ID from GATT Connection event
+ @param attr_handle  GATT attribute handle
+ @param p_val        Pointer to BLE GATT write request value
+ @param len          length of GATT write request
+
+ @return wiced_bt_gatt_status_t  BLE GATT status
+ */
+wiced_bt_gatt_status_t thermistor_set_value(uint16_t conn_id,
+                                            uint16_t attr_handle,
+                                            uint8_t *p_val,
+                                            uint16_t len)
+{
+    /* Only the attributes with a write hook are writable in the GATT database */
+    return gatt_attr_store_set_value(&thermistor_attr_store, attr_handle, conn_id, p_val, len);
 }
 
 /*
  Function Name:
- thermistor_read_handler
+ thermistor_set_trigger_setting
 
  Function Description:
- @brief  The function is invoked when GATTS_REQ_TYPE_READ is received from the
-         client device and is invoked by GATT Server Event Callback function.
-         This handles "Read Requests" received from Client device
+ @brief  Validates and stores a write to the ES Trigger Setting descriptor.
+         The condition is followed by a uint24 time in seconds for the
+         interval conditions, by a sint16 temperature in 0.01 degree Celsius
+         for the comparison conditions and by nothing otherwise.
 
- @param p_read_req   Pointer to BLE GATT read request
- @param conn_id  Connection ID from GATT Connection event
+ @param conn_id      Connection ID of the writer
+ @param p_attr       Lookup table entry of the descriptor
+ @param p_val        Pointer to BLE GATT write request value
+ @param len          length of GATT write request
 
  @return wiced_bt_gatt_status_t  BLE GATT status
  */
-wiced_bt_gatt_status_t
-thermistor_read_handler(wiced_bt_gatt_read_t *p_read_req,
-                        uint16_t conn_id)
+static wiced_bt_gatt_status_t thermistor_set_trigger_setting(uint16_t conn_id, gatt_db_lookup_table_t *p_attr, uint8_t *p_val, uint16_t len)
 {
+    uint16_t operand_len;
+    uint16_t i;
 
-    switch(p_read_req->handle)
+    if (0 == len)
     {
-    /*
-     * If read request is for the OTA FW upgrade service, pass it to the
-     * library to process
-     */
-        case HANDLE_OTA_FW_UPGRADE_CHARACTERISTIC_CONTROL_POINT:
-        case HANDLE_OTA_FW_UPGRADE_CONTROL_POINT:
-        case HANDLE_OTA_FW_UPGRADE_CLIENT_CONFIGURATION_DESCRIPTOR:
-        case HANDLE_OTA_FW_UPGRADE_CHARACTERISTIC_DATA:
-        case HANDLE_OTA_FW_UPGRADE_DATA:
-        case HANDLE_OTA_FW_UPGRADE_CHARACTERISTIC_APP_INFO:
-        case HANDLE_OTA_FW_UPGRADE_APP_INFO:
-                return wiced_ota_fw_upgrade_read_handler(conn_id, p_read_req);
-                break;
-        default:
-             /* Handle normal (non-OTA) indication confirmation requests here */
-             /* Attempt to perform the Read Request */
-                return thermistor_get_value(p_read_req->handle,
-                                            conn_id,
-                                            p_read_req->p_val,
-                                            *p_read_req->p_val_len,
-                                            p_read_req->p_val_len);
-                break;
+        return WICED_BT_GATT_INVALID_ATTR_LEN;
     }
 
+    switch (p_val[0])
+    {
+    case ESS_TRIGGER_INACTIVE:
+    case ESS_TRIGGER_VALUE_CHANGED:
+        operand_len = 0;
+        break;
+
+    case ESS_TRIGGER_FIXED_INTERVAL:
+    case ESS_TRIGGER_MIN_INTERVAL:
+        operand_len = 3;
+        break;
+
+    case ESS_TRIGGER_LESS_THAN:
+    case ESS_TRIGGER_LESS_OR_EQUAL:
+    case ESS_TRIGGER_GREATER_THAN:
+    case ESS_TRIGGER_GREATER_OR_EQUAL:
+    case ESS_TRIGGER_EQUAL:
+    case ESS_TRIGGER_NOT_EQUAL:
+        operand_len = 2;
+        break;
+
+    default:
+        WICED_BT_TRACE("Trigger condition %d not supported\r\n", p_val[0]);
+        return (wiced_bt_gatt_status_t) ESS_ERR_CONDITION_NOT_SUPPORTED;
+    }
+
+    if ((1 + operand_len) != len)
+    {
+        return WICED_BT_GATT_INVALID_ATTR_LEN;
+    }
+
+    gatt_attr_store_put(p_attr, p_val, len);
+
+    WICED_BT_TRACE("Trigger condition set to %d\r\n", p_val[0]);
+
+    /* Evaluate the new condition from the next measurement on */
+    for (i = 0; i < THERMISTOR_MAX_CONNECTIONS; i++)
+    {
+        thermistor_notify_reset(&thermistor_conns[i]);
+    }
+
+    return WICED_BT_GATT_SUCCESS;
 }
 
 /*
  Function Name:
- thermistor_indication_cfm_handler
+ thermistor_notify_reset
 
  Function Description:
- @brief  The function is invoked when GATTS_REQ_TYPE_CONF is received from the
-         client device and is invoked by GATT Server Event Callback function.
-         This handles "Confirmation Requests" received from Client device.
+ @brief  Forgets the last temperature notified to a central so that the next
+         measurement is notified whatever the trigger condition, unless it
+         is inactive.
 
- @param conn_id  Connection ID from GATT Connection event
- @param handle   Connection handle
+ @param p_conn       Connection state
 
- @return wiced_bt_gatt_status_t  BLE GATT status
+ @return void
  */
+static void thermistor_notify_reset(thermistor_conn_t *p_conn)
+{
+    p_conn->notify_valid  = WICED_FALSE;
+    p_conn->notify_age_ms = 0;
+}
+
 /*
- * Process indication_confirm from peer device
+ Function Name:
+ thermistor_notify_due
+
+ Function Description:
+ @brief  Applies the ES Trigger Setting condition to a new measurement for a
+         central. A value counts as changed once it moves
+         THERMISTOR_NOTIFY_DEADBAND away from the last one notified to it, so that the filter noise does not trigger
+         notifications. The value changed conditions also notify every
+         THERMISTOR_NOTIFY_MAX_INTERVAL_MS if nothing else did.
+
+ @param p_conn       Connection state
+ @param temperature  Measured temperature in 0.01 degree Celsius
+ @param elapsed_ms   Time since the previous measurement
+
+ @return wiced_bool_t  WICED_TRUE if the measurement is to be notified
  */
-wiced_bt_gatt_status_t
-thermistor_indication_cfm_handler(uint16_t conn_id, uint16_t handle)
+static wiced_bool_t thermistor_notify_due(thermistor_conn_t *p_conn,
+                                          int16_t temperature,
+                                          uint32_t elapsed_ms)
 {
+    uint8_t      *p_trigger = app_ess_temperature_es_trigger_setting;
+    uint32_t     interval_s = p_trigger[1] | (p_trigger[2] << 8) | ((uint32_t)p_trigger[3] << 16);
+    int16_t      operand    = (int16_t)(p_trigger[1] | (p_trigger[2] << 8));
+    int32_t      delta      = (int32_t)temperature - p_conn->notify_last;
+    wiced_bool_t changed;
+    wiced_bool_t due        = WICED_FALSE;
+
+    if (ESS_TRIGGER_INACTIVE == p_trigger[0])
+    {
+        return WICED_FALSE;
+    }
+
+    if (!p_conn->notify_valid)
+    {
+        return WICED_TRUE;
+    }
+
+    /* Saturate rather than wrap after a long time without notification */
+    p_conn->notify_age_ms = (p_conn->notify_age_ms > (0xFFFFFFFFu - elapsed_ms)) ?
+                            0xFFFFFFFFu : (p_conn->notify_age_ms + elapsed_ms);
+
+    changed = (ABS(delta) >= THERMISTOR_NOTIFY_DEADBAND) ? WICED_TRUE : WICED_FALSE;
+
+    switch (p_trigger[0])
+    {
+    case ESS_TRIGGER_FIXED_INTERVAL:
+        due = ((p_conn->notify_age_ms / 1000) >= interval_s);
+        break;
+
+    case ESS_TRIGGER_MIN_INTERVAL:
+        due = changed && ((p_conn->notify_age_ms / 1000) >= interval_s);
+        break;
+
+    case ESS_TRIGGER_VALUE_CHANGED:
+        due = changed;
+        break;
+
+    /* The comparisons only notify a changed value while they hold */
+    case ESS_TRIGGER_LESS_THAN:
+        due = changed && (temperature < operand);
+        break;
+
+    case ESS_TRIGGER_LESS_OR_EQUAL:
+        due = changed && (temperature <= operand);
+        break;
+
+    case ESS_TRIGGER_GREATER_THAN:
+        due = changed && (temperature > operand);
+        break;
+
+    case ESS_TRIGGER_GREATER_OR_EQUAL:
+        due = changed && (temperature >= operand);
+        break;
+
+    case ESS_TRIGGER_EQUAL:
+        due = changed && (temperature == operand);
+        break;
+
+    case ESS_TRIGGER_NOT_EQUAL:
+        due = changed && (temperature != operand);
+        break;
 
-    switch(handle)
+    default:
+        break;
+    }
+
+    if ((!due) && (0 != THERMISTOR_NOTIFY_MAX_INTERVAL_MS) &&
+        ((ESS_TRIGGER_VALUE_CHANGED == p_trigger[0]) || (ESS_TRIGGER_MIN_INTERVAL == p_trigger[0])) &&
+        (p_conn->notify_age_ms >= THERMISTOR_NOTIFY_MAX_INTERVAL_MS))
     {
-    /*
-     * If confirmation request is for the OTA FW upgrade service, pass it to the
-     * library to process
-     */
-        case HANDLE_OTA_FW_UPGRADE_CHARACTERISTIC_CONTROL_POINT:
-        case HANDLE_OTA_FW_UPGRADE_CONTROL_POINT:
-        case HANDLE_OTA_FW_UPGRADE_CLIENT_CONFIGURATION_DESCRIPTOR:
-        case HANDLE_OTA_FW_UPGRADE_CHARACTERISTIC_DATA:
-        case HANDLE_OTA_FW_UPGRADE_DATA:
-        case HANDLE_OTA_FW_UPGRADE_CHARACTERISTIC_APP_INFO:
-        case HANDLE_OTA_FW_UPGRADE_APP_INFO:
-             return wiced_ota_fw_upgrade_indication_cfm_handler(conn_id, handle);
-             break;
-        default:
-             /* Handle normal (non-OTA) indication confirmation requests here */
-             return WICED_BT_GATT_INVALID_HANDLE;
+        due = WICED_TRUE;
     }
 
+    return due;
 }
 
 /*
  Function Name:
- thermistor_get_value
+ thermistor_notify_temperature
 
  Function Description:
- @brief  The function is invoked by thermistor_read_handler to get a Value from
-         GATT DB.
+ @brief  Notifies a new measurement to every central that enabled the
+         notifications of the temperature and whose trigger condition is met.
+         A notification the link has no room for waits in the queue of the
+         GATT server core.
 
- @param attr_handle  GATT attribute handle
- @param conn_id      Connection ID from GATT Connection event
- @param p_val        Pointer to BLE GATT read request value
- @param len          Maximum length of GATT read request
- @param p_len        Pointer to BLE GATT read request length
+ @param temperature  Measured temperature in 0.01 degree Celsius
+ @param elapsed_ms   Time since the previous measurement
 
- @return wiced_bt_gatt_status_t  BLE GATT status
+ @return void
  */
-wiced_bt_gatt_status_t
-thermistor_get_value(uint16_t attr_handle,
-                     uint16_t conn_id,
-                     uint8_t *p_val,
-                     uint16_t len,
-                     uint16_t *p_len)
+void thermistor_notify_temperature(int16_t temperature, uint32_t elapsed_ms)
 {
+    gatt_server_conn_t *p_conn;
+    thermistor_conn_t  *p_state;
+    uint8_t             notified = 0;
+    uint8_t             i;
+
+    for (i = 0; i < THERMISTOR_MAX_CONNECTIONS; i++)
+    {
+        p_conn  = &thermistor_server_conns[i];
+        p_state = &thermistor_conns[i];
+
+        if ((0 == p_conn->conn_id) ||
+            (0 == (gatt_server_cccd(p_conn, HDLC_ESS_TEMPERATURE_VALUE) & GATT_CLIENT_CONFIG_NOTIFICATION)))
+        {
+            continue;
+        }
+        if (!thermistor_notify_due(p_state, temperature, elapsed_ms))
+        {
+            continue;
+        }
+
+        if (WICED_BT_GATT_SUCCESS ==
+                gatt_server_send(p_conn,
+                                 HDLC_ESS_TEMPERATURE_VALUE,
+                                 app_ess_temperature,
+                                 app_ess_temperature_len))
+        {
+            p_state->notify_last   = temperature;
+            p_state->notify_valid  = WICED_TRUE;
+            p_state->notify_age_ms = 0;
+            notified++;
+        }
+    }
+
+    WICED_BT_TRACE("%d central(s) connected, temperature notified to %d\r\n",
+                   thermistor_conn_count, notified);
+}
 
-    int i = 0;
-    wiced_bt_gatt_status_t res = WICED_BT_GATT_INVALID_HANDLE;
+/*
+ Function Name:
+ thermistor_notify_aggregate
 
-    for (i = 0; i < app_gatt_db_ext_attr_tbl_size; i++)
+ Function Description:
+ @brief  Notifies the values of all the registered sensors to every central
+         that enabled the notifications of the Aggregate characteristic, in
+         as few notifications as its MTU allows.
+
+ @param  void
+
+ @return void
+ */
+void thermistor_notify_aggregate(void)
+{
+    gatt_server_conn_t *p_conn;
+    uint8_t             aggregate[THERMISTOR_SENSORS_AGGREGATE_MAX_LEN];
+    uint16_t            len;
+    uint8_t             next;
+    uint8_t             i;
+
+    for (i = 0; i < THERMISTOR_MAX_CONNECTIONS; i++)
     {
-        /* Check for a matching handle entry */
-        if (app_gatt_db_ext_attr_tbl[i].handle == attr_handle)
+        p_conn = &thermistor_server_conns[i];
+
+        if ((0 == p_conn->conn_id) ||
+            (0 == (gatt_server_cccd(p_conn, HDLC_SENSOR_AGGREGATE_AGGREGATE_VALUE) & GATT_CLIENT_CONFIG_NOTIFICATION)))
         {
-            /* Detected a matching handle in the external lookup table */
-            if (app_gatt_db_ext_attr_tbl[i].cur_len <= len)
-            {
-                /* Value fits within the supplied buffer; copy over the value */
-                *p_len = app_gatt_db_ext_attr_tbl[i].cur_len;
-                memcpy(p_val,
-                       app_gatt_db_ext_attr_tbl[i].p_data,
-                       app_gatt_db_ext_attr_tbl[i].cur_len);
+            continue;
+        }
 
-                res = WICED_BT_GATT_SUCCESS;
-            }
-            else
+        next = 0;
+        while (next < thermistor_sensors_count())
+        {
+            len = thermistor_sensors_pack(aggregate,
+                                          MIN(sizeof(aggregate), p_conn->mtu - 3),
+                                          &next);
+            if ((0 == len) ||
+                (WICED_BT_GATT_SUCCESS != gatt_server_send(p_conn,
+                                                           HDLC_SENSOR_AGGREGATE_AGGREGATE_VALUE,
+                                                           aggregate,
+                                                           len)))
             {
-                /* Value to read will not fit within the buffer */
-                res = WICED_BT_GATT_INVALID_ATTR_LEN;
-                WICED_BT_TRACE("Invalid attribute length\r\n");
+                break;
             }
-            break;
-        }
-        else
-        {
-            res = WICED_BT_GATT_INVALID_HANDLE;
         }
     }
-
-    return res;
 }
 
 /*
  Function Name:
- thermistor_set_value
+ thermistor_cccd_changed
 
  Function Description:
- @brief  The function is invoked by thermistor_write_handler to set a value
-         to GATT DB.
+ @brief  Invoked by the GATT server core when a central writes a Client
+         Characteristic Configuration descriptor. The first temperature
+         after enabling its notifications is always notified.
 
- @param attr_handle  GATT attribute handle
- @param conn_id      Connection ID from GATT Connection event
- @param p_val        Pointer to BLE GATT write request value
- @param len          length of GATT write request
+ @param p_conn        Connection entry of the GATT server core
+ @param value_handle  Handle of the characteristic value of the descriptor
+ @param cccd          New value of the descriptor
 
- @return wiced_bt_gatt_status_t  BLE GATT status
+ @return void
  */
-wiced_bt_gatt_status_t thermistor_set_value(uint16_t attr_handle,
-                                            uint16_t conn_id,
-                                            uint8_t *p_val,
-                                            uint16_t len)
+static void thermistor_cccd_changed(gatt_server_conn_t *p_conn, uint16_t value_handle, uint16_t cccd)
 {
-    wiced_bt_gatt_status_t res = WICED_BT_GATT_INVALID_HANDLE;
-
-      /* Check for a matching handle entry */
-      if (HDLD_ESS_TEMPERATURE_CLIENT_CHAR_CONFIG == attr_handle)
-      {
-          /* Verify that size constraints have been met */
-          if (app_ess_temperature_client_char_config_len >= len)
-          {
-              /* Value fits within the supplied buffer; copy over the value */
-              memcpy(app_ess_temperature_client_char_config,
-                     p_val,
-                     len);
-
-              res = WICED_BT_GATT_SUCCESS;
-          }
-          else
-          {
-              /* Value to write does not meet size constraints */
-              res = WICED_BT_GATT_INVALID_ATTR_LEN;
-          }
-      }
-
-  return res;
+    if (HDLC_ESS_TEMPERATURE_VALUE == value_handle)
+    {
+        thermistor_notify_reset(&thermistor_conns[gatt_server_conn_index(p_conn)]);
+    }
 }
 
 /*
  Function Name:
- set_ble_2m_phy
+ thermistor_history_command
 
  Function Description:
- @brief  This function configures the PHY layer to support BLE 2Mbps feature.
-         The function is invoked by thermistor_connect_callback when the device
-         is connected.
+ @brief  Handles a command written to the History characteristic. A download
+         needs the notifications of the characteristic to be enabled.
 
- @param p_conn_status   wiced_bt_gatt_connection_status_t to set the PHY
-                        preferences for specific BD_ADDR
+ @param conn_id      Connection ID of the writer
+ @param p_attr       Lookup table entry of the characteristic
+ @param p_val        Pointer to BLE GATT write request value
+ @param len          length of GATT write request
 
- @return wiced_bt_dev_status_t      PHY 2M success or failure status
+ @return wiced_bt_gatt_status_t  BLE GATT status
  */
-wiced_bt_dev_status_t
-set_ble_2m_phy(wiced_bt_gatt_connection_status_t *p_conn_status)
+static wiced_bt_gatt_status_t thermistor_history_command(uint16_t conn_id, gatt_db_lookup_table_t *p_attr, uint8_t *p_val, uint16_t len)
 {
-        wiced_bt_ble_phy_preferences_t phy_preferences;
-        wiced_bt_dev_status_t result;
+    gatt_server_conn_t *p_conn = gatt_server_conn_find(conn_id);
 
-        memcpy(phy_preferences.remote_bd_addr,
-               p_conn_status->bd_addr,
-               BD_ADDR_LEN);
+    if (NULL == p_conn)
+    {
+        return WICED_BT_GATT_ERROR;
+    }
+    if (1 != len)
+    {
+        return WICED_BT_GATT_INVALID_ATTR_LEN;
+    }
 
-        phy_preferences.rx_phys = phy_preferences.tx_phys = BTM_BLE_PREFER_2M_PHY;
+    switch (p_val[0])
+    {
+    case THERMISTOR_HISTORY_CMD_DOWNLOAD:
+        if (0 == (gatt_server_cccd(p_conn, HDLC_TEMPERATURE_HISTORY_HISTORY_VALUE) & GATT_CLIENT_CONFIG_NOTIFICATION))
+        {
+            return WICED_BT_GATT_CCC_CFG_ERR;
+        }
+        return thermistor_history_download_start(p_conn->conn_id, p_conn->mtu);
 
-        result = wiced_bt_ble_set_phy(&phy_preferences);
+    case THERMISTOR_HISTORY_CMD_CLEAR:
+        thermistor_history_clear();
+        return WICED_BT_GATT_SUCCESS;
 
-        return result;
+    default:
+        return WICED_BT_GATT_REQ_NOT_SUPPORTED;
+    }
 }
@@ -49,6 +49,7 @@
  * *******************************************************************/
 #include "wiced_bt_gatt.h"
 #include "wiced_platform.h"
+#include "gatt_server.h"
 #include "GeneratedSource/cycfg_pins.h"
 
 /* *******************************************************************
@@ -56,11 +57,31 @@
  * *******************************************************************/
 #define CONNECTION_LED                  WICED_GET_PIN_FOR_LED(WICED_PLATFORM_LED_2)
 
+/* Centrals connected at the same time, the link limits of wiced_app_cfg.c must match */
+#ifndef THERMISTOR_MAX_CONNECTIONS
+#define THERMISTOR_MAX_CONNECTIONS      (2)
+#endif
+
+/* Conditions of the ES Trigger Setting descriptor as per BT SIG's ESS Specification */
+#define ESS_TRIGGER_INACTIVE            (0x00)
+#define ESS_TRIGGER_FIXED_INTERVAL      (0x01)
+#define ESS_TRIGGER_MIN_INTERVAL        (0x02)
+#define ESS_TRIGGER_VALUE_CHANGED       (0x03)
+#define ESS_TRIGGER_LESS_THAN           (0x04)
+#define ESS_TRIGGER_LESS_OR_EQUAL       (0x05)
+#define ESS_TRIGGER_GREATER_THAN        (0x06)
+#define ESS_TRIGGER_GREATER_OR_EQUAL    (0x07)
+#define ESS_TRIGGER_EQUAL               (0x08)
+#define ESS_TRIGGER_NOT_EQUAL           (0x09)
+
+/* ESS application error code for a trigger condition that is not supported */
+#define ESS_ERR_CONDITION_NOT_SUPPORTED (0x81)
+
 /* *******************************************************************
  *                              VARIABLES
  * *******************************************************************/
-/* A Global variable to check the status of this device if it is connected to any peer devices*/
-extern uint16_t thermistor_conn_id;
+/* A Global variable to check the number of peer devices this device is connected to */
+extern uint8_t thermistor_conn_count;
 
 /* LED configuration for the particular platform */
 extern const wiced_platform_led_config_t platform_led[];
@@ -68,34 +89,24 @@ extern const wiced_platform_led_config_t platform_led[];
 /* *******************************************************************
  *                              FUNCTION DECLARATIONS
  * *******************************************************************/
-wiced_bt_gatt_status_t thermistor_write_handler(wiced_bt_gatt_write_t *p_write_req,
-                                                uint16_t conn_id);
-
-wiced_bt_gatt_status_t thermistor_read_handler(wiced_bt_gatt_read_t *p_read_req,
-                                               uint16_t conn_id);
-
-wiced_bt_gatt_status_t thermistor_indication_cfm_handler(uint16_t conn_id, uint16_t handle);
+void thermistor_gatt_index_init(void);
 
-wiced_bt_gatt_status_t thermistor_connect_callback(wiced_bt_gatt_connection_status_t *p_conn_status);
+void thermistor_connect_callback(gatt_server_conn_t *p_conn,
+                                 wiced_bt_gatt_connection_status_t *p_conn_status);
 
-wiced_bt_gatt_status_t thermistor_server_callback(uint16_t conn_id,
-                                                  wiced_bt_gatt_request_type_t type,
-                                                  wiced_bt_gatt_request_data_t *p_data);
-
-wiced_bt_gatt_status_t thermistor_event_handler(wiced_bt_gatt_evt_t event,
-                                                wiced_bt_gatt_event_data_t *p_event_data);
-
-wiced_bt_gatt_status_t thermistor_get_value(uint16_t attr_handle,
-                                            uint16_t conn_id,
+wiced_bt_gatt_status_t thermistor_get_value(uint16_t conn_id,
+                                            uint16_t attr_handle,
                                             uint8_t *p_val,
                                             uint16_t len,
                                             uint16_t *p_len);
 
-wiced_bt_gatt_status_t thermistor_set_value(uint16_t attr_handle,
-                                            uint16_t conn_id,
+wiced_bt_gatt_status_t thermistor_set_value(uint16_t conn_id,
+                                            uint16_t attr_handle,
                                             uint8_t *p_val,
                                             uint16_t len);
 
-wiced_bt_dev_status_t set_ble_2m_phy(wiced_bt_gatt_connection_status_t *p_conn_status);
+void thermistor_notify_temperature(int16_t temperature, uint32_t elapsed_ms);
+
+void thermistor_notify_aggregate(void);
 
 #endif      /* __THERMISTOR_GATT_HANDLER_H__ */
@@ -0,0 +1,582 @@
+/*
+ * Copyright 2016-2020, Cypress Semiconductor Corporation or a subsidiary of
+ * Cypress Semiconductor Corporation. All Rights Reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software"), is owned by Cypress Semiconductor Corporation
+ * or one of its subsidiaries ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products. Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ */
+
+
+
+/** @file
+ * thermistor_history.c
+ *
+ *  @brief
+ * This file records the temperature history in RAM and NVRAM and sends it to
+ * a gateway on request, see thermistor_history.h for the record format.
+ */
+
+/* *******************************************************************
+ *                              INCLUDES
+ * *******************************************************************/
+#include <string.h>
+#include "thermistor_history.h"
+#include "GeneratedSource/cycfg_gatt_db.h"
+#include "wiced_bt_trace.h"
+#include "wiced_hal_nvram.h"
+#include "wiced_memory.h"
+#include "wiced_timer.h"
+
+/* *******************************************************************
+ *                              CONSTANTS
+ * *******************************************************************/
+/* Bytes of records in a block, a block is stored in one NVRAM item so that
+ * the block and its header must not exceed 255 bytes
+ */
+#ifndef THERMISTOR_HISTORY_BLOCK_SIZE
+#define THERMISTOR_HISTORY_BLOCK_SIZE           (240)
+#endif
+
+/* Number of NVRAM items holding full blocks, the oldest block is overwritten
+ * once they are all used
+ */
+#ifndef THERMISTOR_HISTORY_NVRAM_BLOCKS
+#define THERMISTOR_HISTORY_NVRAM_BLOCKS         (8)
+#endif
+
+#define THERMISTOR_HISTORY_INDEX_NVRAM_ID       (WICED_NVRAM_VSID_START)
+#define THERMISTOR_HISTORY_BLOCK_NVRAM_ID(seq)  (WICED_NVRAM_VSID_START + 1 + \
+                                                 ((seq) % THERMISTOR_HISTORY_NVRAM_BLOCKS))
+
+#define THERMISTOR_HISTORY_KEY_RECORD           (0x00)
+#define THERMISTOR_HISTORY_KEY_RECORD_LEN       (7)
+#define THERMISTOR_HISTORY_DELTA_RECORD_LEN     (2)
+
+/* Delay before a download held up by a shortage of stack buffers goes on */
+#ifndef THERMISTOR_HISTORY_RETRY_MS
+#define THERMISTOR_HISTORY_RETRY_MS             (20)
+#endif
+
+/* ATT opcode and handle ahead of the value of a notification */
+#define THERMISTOR_HISTORY_ATT_HDR_LEN          (3)
+
+/* *******************************************************************
+ *                              TYPE DEFINITIONS
+ * *******************************************************************/
+/* A block of records, as kept in RAM and in NVRAM */
+typedef struct
+{
+    uint16_t seq;
+    uint8_t  len;
+    uint8_t  data[THERMISTOR_HISTORY_BLOCK_SIZE];
+} thermistor_history_block_t;
+
+/* The blocks from first_seq to next_seq excluded are in NVRAM, the RAM block
+ * is block next_seq
+ */
+typedef struct
+{
+    uint16_t first_seq;
+    uint16_t next_seq;
+} thermistor_history_index_t;
+
+/* Position of a download, seq and offset give the next byte to send */
+typedef struct
+{
+    wiced_bool_t active;
+    wiced_bool_t congested;
+    wiced_bool_t loaded;        /* thermistor_history_tx holds block seq */
+    wiced_bool_t from_ram;      /* thermistor_history_tx is a copy of the RAM block */
+    wiced_bool_t done;
+    uint16_t     conn_id;
+    uint16_t     chunk_len;
+    uint16_t     seq;
+    uint8_t      offset;
+    uint8_t      chunk_seq;
+} thermistor_history_download_t;
+
+/* *******************************************************************
+ *                              VARIABLES
+ * *******************************************************************/
+static thermistor_history_index_t    thermistor_history_index;
+static thermistor_history_block_t    thermistor_history_ram;
+static uint32_t                      thermistor_history_last_time;
+static int16_t                       thermistor_history_last_temperature;
+
+/* Block being downloaded */
+static thermistor_history_block_t    thermistor_history_tx;
+static thermistor_history_download_t thermistor_history_dl;
+static wiced_timer_t                 thermistor_history_retry_timer;
+
+/* *******************************************************************
+ *                              FUNCTION DECLARATIONS
+ * *******************************************************************/
+static void thermistor_history_spill(void);
+
+static void thermistor_history_save_index(void);
+
+static uint16_t thermistor_history_fill(uint8_t *p_data, uint16_t max_len);
+
+static void thermistor_history_download_continue(void);
+
+static void thermistor_history_download_retry(uint32_t arg);
+
+/* *******************************************************************
+ *                              FUNCTION DEFINITIONS
+ * *******************************************************************/
+/*
+ Function Name:
+ thermistor_history_init
+
+ Function Description:
+ @brief  Restores the index of the blocks saved in NVRAM. Samples still in
+         the RAM block at a reset are lost.
+
+ @param  void
+
+ @return void
+ */
+void thermistor_history_init(void)
+{
+    wiced_result_t result;
+    uint16_t       bytes_read;
+
+    bytes_read = wiced_hal_read_nvram(THERMISTOR_HISTORY_INDEX_NVRAM_ID,
+                                      sizeof(thermistor_history_index),
+                                      (uint8_t *)&thermistor_history_index,
+                                      &result);
+    if ((WICED_SUCCESS != result) || (sizeof(thermistor_history_index) != bytes_read))
+    {
+        memset(&thermistor_history_index, 0, sizeof(thermistor_history_index));
+    }
+
+    thermistor_history_ram.seq = thermistor_history_index.next_seq;
+    thermistor_history_ram.len = 0;
+
+    wiced_init_timer(&thermistor_history_retry_timer, thermistor_history_download_retry, 0, WICED_MILLI_SECONDS_TIMER);
+
+    WICED_BT_TRACE("History: %d blocks in NVRAM\r\n",
+                   (uint16_t)(thermistor_history_index.next_seq - thermistor_history_index.first_seq));
+}
+
+/*
+ Function Name:
+ thermistor_history_add
+
+ Function Description:
+ @brief  Records a measurement, as a delta record when the time and the
+         temperature changes fit in one, as a key record otherwise.
+
+ @param time_s       Time of the measurement in seconds
+ @param temperature  Temperature in 0.01 degree Celsius
+
+ @return void
+ */
+void thermistor_history_add(uint32_t time_s, int16_t temperature)
+{
+    thermistor_history_block_t *p_block = &thermistor_history_ram;
+    int32_t                     delta   = (int32_t)temperature - thermistor_history_last_temperature;
+    wiced_bool_t                use_delta;
+
+    use_delta = (0 != p_block->len) &&
+                (time_s > thermistor_history_last_time) &&
+                ((time_s - thermistor_history_last_time) <= 0xFF) &&
+                (delta >= -128) && (delta <= 127);
+
+    if (use_delta && ((p_block->len + THERMISTOR_HISTORY_DELTA_RECORD_LEN) > THERMISTOR_HISTORY_BLOCK_SIZE))
+    {
+        thermistor_history_spill();
+        use_delta = WICED_FALSE;
+    }
+    if ((!use_delta) && ((p_block->len + THERMISTOR_HISTORY_KEY_RECORD_LEN) > THERMISTOR_HISTORY_BLOCK_SIZE))
+    {
+        thermistor_history_spill();
+    }
+
+    if (use_delta)
+    {
+        p_block->data[p_block->len++] = (uint8_t)(time_s - thermistor_history_last_time);
+        p_block->data[p_block->len++] = (uint8_t)(int8_t)delta;
+    }
+    else
+    {
+        p_block->data[p_block->len++] = THERMISTOR_HISTORY_KEY_RECORD;
+        p_block->data[p_block->len++] = (uint8_t)(time_s & 0xff);
+        p_block->data[p_block->len++] = (uint8_t)((time_s >> 8) & 0xff);
+        p_block->data[p_block->len++] = (uint8_t)((time_s >> 16) & 0xff);
+        p_block->data[p_block->len++] = (uint8_t)((time_s >> 24) & 0xff);
+        p_block->data[p_block->len++] = (uint8_t)(temperature & 0xff);
+        p_block->data[p_block->len++] = (uint8_t)((temperature >> 8) & 0xff);
+    }
+
+    thermistor_history_last_time        = time_s;
+    thermistor_history_last_temperature = temperature;
+}
+
+/*
+ Function Name:
+ thermistor_history_clear
+
+ Function Description:
+ @brief  Drops the whole history, typically once a gateway downloaded it.
+         The block numbers keep counting up.
+
+ @param  void
+
+ @return void
+ */
+void thermistor_history_clear(void)
+{
+    thermistor_history_download_stop(0);
+
+    thermistor_history_index.first_seq = thermistor_history_ram.seq;
+    thermistor_history_index.next_seq  = thermistor_history_ram.seq;
+    thermistor_history_ram.len         = 0;
+    thermistor_history_save_index();
+
+    WICED_BT_TRACE("History cleared\r\n");
+}
+
+/*
+ Function Name:
+ thermistor_history_download_start
+
+ Function Description:
+ @brief  Starts sending the history from the oldest block on, in notifications
+         of the History characteristic as large as the MTU allows. Each
+         notification is a header byte and a part of the record stream.
+
+ @param conn_id      Connection ID of the gateway
+ @param mtu          ATT MTU of the connection
+
+ @return wiced_bt_gatt_status_t  BLE GATT status
+ */
+wiced_bt_gatt_status_t thermistor_history_download_start(uint16_t conn_id, uint16_t mtu)
+{
+    if (thermistor_history_dl.active)
+    {
+        return WICED_BT_GATT_PRC_IN_PROGRESS;
+    }
+
+    memset(&thermistor_history_dl, 0, sizeof(thermistor_history_dl));
+    thermistor_history_dl.active    = WICED_TRUE;
+    thermistor_history_dl.conn_id   = conn_id;
+    thermistor_history_dl.chunk_len = mtu - THERMISTOR_HISTORY_ATT_HDR_LEN - 1;
+    thermistor_history_dl.seq       = thermistor_history_index.first_seq;
+
+    WICED_BT_TRACE("History download of %d blocks, %d bytes per notification\r\n",
+                   (uint16_t)(thermistor_history_index.next_seq - thermistor_history_index.first_seq) + 1,
+                   thermistor_history_dl.chunk_len);
+
+    thermistor_history_download_continue();
+
+    return WICED_BT_GATT_SUCCESS;
+}
+
+/*
+ Function Name:
+ thermistor_history_download_stop
+
+ Function Description:
+ @brief  Abandons the download to a connection, on its disconnection for
+         instance.
+
+ @param conn_id      Connection ID of the download, 0 for any
+
+ @return void
+ */
+void thermistor_history_download_stop(uint16_t conn_id)
+{
+    if ((0 == conn_id) || (conn_id == thermistor_history_dl.conn_id))
+    {
+        thermistor_history_dl.active = WICED_FALSE;
+        wiced_stop_timer(&thermistor_history_retry_timer);
+    }
+}
+
+/*
+ Function Name:
+ thermistor_history_congestion
+
+ Function Description:
+ @brief  Resumes a download held up by the congestion of its connection.
+
+ @param conn_id      Connection ID from GATT Congestion event
+ @param congested    Congestion status of the connection
+
+ @return void
+ */
+void thermistor_history_congestion(uint16_t conn_id, wiced_bool_t congested)
+{
+    if (thermistor_history_dl.active && (conn_id == thermistor_history_dl.conn_id))
+    {
+        thermistor_history_dl.congested = congested;
+        thermistor_history_download_continue();
+    }
+}
+
+/*
+ Function Name:
+ thermistor_history_spill
+
+ Function Description:
+ @brief  Saves the full RAM block in NVRAM, overwriting the oldest block if
+         needed, and starts a new RAM block.
+
+ @param  void
+
+ @return void
+ */
+static void thermistor_history_spill(void)
+{
+    wiced_result_t result;
+
+    wiced_hal_write_nvram(THERMISTOR_HISTORY_BLOCK_NVRAM_ID(thermistor_history_ram.seq),
+                          sizeof(thermistor_history_ram),
+                          (uint8_t *)&thermistor_history_ram,
+                          &result);
+    if (WICED_SUCCESS != result)
+    {
+        WICED_BT_TRACE("History block %d not saved, result %d\r\n",
+                       thermistor_history_ram.seq, result);
+    }
+
+    thermistor_history_index.next_seq = thermistor_history_ram.seq + 1;
+    if ((uint16_t)(thermistor_history_index.next_seq - thermistor_history_index.first_seq) >
+        THERMISTOR_HISTORY_NVRAM_BLOCKS)
+    {
+        thermistor_history_index.first_seq = thermistor_history_index.next_seq -
+                                             THERMISTOR_HISTORY_NVRAM_BLOCKS;
+    }
+    thermistor_history_save_index();
+
+    thermistor_history_ram.seq = thermistor_history_index.next_seq;
+    thermistor_history_ram.len = 0;
+}
+
+/*
+ Function Name:
+ thermistor_history_save_index
+
+ Function Description:
+ @brief  Writes the index of the NVRAM blocks to NVRAM.
+
+ @param  void
+
+ @return void
+ */
+static void thermistor_history_save_index(void)
+{
+    wiced_result_t result;
+
+    wiced_hal_write_nvram(THERMISTOR_HISTORY_INDEX_NVRAM_ID,
+                          sizeof(thermistor_history_index),
+                          (uint8_t *)&thermistor_history_index,
+                          &result);
+    if (WICED_SUCCESS != result)
+    {
+        WICED_BT_TRACE("History index not saved, result %d\r\n", result);
+    }
+}
+
+/*
+ Function Name:
+ thermistor_history_fill
+
+ Function Description:
+ @brief  Copies the next bytes of the download and moves its position on.
+         A block overwritten since the download started is skipped. The
+         download is done once the RAM block is copied.
+
+ @param p_data       Buffer to copy the bytes to
+ @param max_len      Size of the buffer
+
+ @return uint16_t    Number of bytes copied
+ */
+static uint16_t thermistor_history_fill(uint8_t *p_data, uint16_t max_len)
+{
+    thermistor_history_download_t *p_dl = &thermistor_history_dl;
+    wiced_result_t                 result;
+    uint16_t                       len = 0;
+    uint16_t                       count;
+
+    while ((len < max_len) && (!p_dl->done))
+    {
+        if (!p_dl->loaded)
+        {
+            if ((int16_t)(p_dl->seq - thermistor_history_index.first_seq) < 0)
+            {
+                p_dl->seq    = thermistor_history_index.first_seq;
+                p_dl->offset = 0;
+            }
+
+            p_dl->from_ram = (p_dl->seq == thermistor_history_ram.seq);
+            if (p_dl->from_ram)
+            {
+                memcpy(&thermistor_history_tx, &thermistor_history_ram, sizeof(thermistor_history_tx));
+            }
+            else if ((sizeof(thermistor_history_tx) !=
+                      wiced_hal_read_nvram(THERMISTOR_HISTORY_BLOCK_NVRAM_ID(p_dl->seq),
+                                           sizeof(thermistor_history_tx),
+                                           (uint8_t *)&thermistor_history_tx,
+                                           &result)) ||
+                     (WICED_SUCCESS != result) || (thermistor_history_tx.seq != p_dl->seq))
+            {
+                WICED_BT_TRACE("History block %d lost\r\n", p_dl->seq);
+                thermistor_history_tx.len = 0;
+            }
+            if (p_dl->offset > thermistor_history_tx.len)
+            {
+                p_dl->offset = thermistor_history_tx.len;
+            }
+            p_dl->loaded = WICED_TRUE;
+        }
+
+        count = thermistor_history_tx.len - p_dl->offset;
+        if (count > (max_len - len))
+        {
+            count = max_len - len;
+        }
+        memcpy(&p_data[len], &thermistor_history_tx.data[p_dl->offset], count);
+        len          += count;
+        p_dl->offset += count;
+
+        if (p_dl->offset == thermistor_history_tx.len)
+        {
+            p_dl->done   = p_dl->from_ram;
+            p_dl->seq++;
+            p_dl->offset = 0;
+            p_dl->loaded = WICED_FALSE;
+        }
+    }
+
+    return len;
+}
+
+/*
+ Function Name:
+ thermistor_history_download_continue
+
+ Function Description:
+ @brief  Sends download notifications until the history is sent or the
+         connection is congested. The position of a notification the stack
+         could not take is restored, and the notification sent again once
+         the congestion clears. A shortage of stack buffers brings no
+         congestion event, the download goes on after a delay then.
+
+ @param  void
+
+ @return void
+ */
+static void thermistor_history_download_continue(void)
+{
+    thermistor_history_download_t *p_dl = &thermistor_history_dl;
+    wiced_bt_gatt_status_t         status;
+    uint8_t                        *p_pdu;
+    uint16_t                       len;
+    uint16_t                       seq;
+    uint8_t                        offset;
+
+    if ((!p_dl->active) || p_dl->congested)
+    {
+        return;
+    }
+
+    if (NULL == (p_pdu = (uint8_t *)wiced_bt_get_buffer(1 + p_dl->chunk_len)))
+    {
+        WICED_BT_TRACE("History download: no buffer for %d bytes\r\n", 1 + p_dl->chunk_len);
+        wiced_start_timer(&thermistor_history_retry_timer, THERMISTOR_HISTORY_RETRY_MS);
+        return;
+    }
+
+    while (p_dl->active && (!p_dl->congested))
+    {
+        seq    = p_dl->seq;
+        offset = p_dl->offset;
+
+        len      = thermistor_history_fill(&p_pdu[1], p_dl->chunk_len);
+        p_pdu[0] = (p_dl->chunk_seq & THERMISTOR_HISTORY_CHUNK_SEQ_MASK) |
+                   (p_dl->done ? THERMISTOR_HISTORY_CHUNK_LAST : 0);
+
+        status = wiced_bt_gatt_send_notification(p_dl->conn_id,
+                                                 HDLC_TEMPERATURE_HISTORY_HISTORY_VALUE,
+                                                 1 + len,
+                                                 p_pdu);
+
+        if ((WICED_BT_GATT_CONGESTED == status) || (WICED_BT_GATT_NO_RESOURCES == status))
+        {
+            /* Send the same bytes again once GATT_CONGESTION_EVT clears, or after
+             * the retry delay if the stack was out of buffers
+             */
+            p_dl->seq       = seq;
+            p_dl->offset    = offset;
+            p_dl->loaded    = WICED_FALSE;
+            p_dl->done      = WICED_FALSE;
+            if (WICED_BT_GATT_CONGESTED == status)
+            {
+                p_dl->congested = WICED_TRUE;
+            }
+            else
+            {
+                wiced_start_timer(&thermistor_history_retry_timer, THERMISTOR_HISTORY_RETRY_MS);
+            }
+            break;
+        }
+        if (WICED_BT_GATT_SUCCESS != status)
+        {
+            WICED_BT_TRACE("History download aborted, status %d\r\n", status);
+            p_dl->active = WICED_FALSE;
+            break;
+        }
+
+        p_dl->chunk_seq++;
+        if (p_dl->done)
+        {
+            WICED_BT_TRACE("History download complete\r\n");
+            p_dl->active = WICED_FALSE;
+        }
+    }
+
+    wiced_bt_free_buffer(p_pdu);
+}
+
+/*
+ Function Name:
+ thermistor_history_download_retry
+
+ Function Description:
+ @brief  Goes on with a download held up by a shortage of stack buffers.
+
+ @param arg          Unused
+
+ @return void
+ */
+static void thermistor_history_download_retry(uint32_t arg)
+{
+    thermistor_history_download_continue();
+}
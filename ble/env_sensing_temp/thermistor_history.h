@@ -0,0 +1,88 @@
+/*
+ * Copyright 2016-2020, Cypress Semiconductor Corporation or a subsidiary of
+ * Cypress Semiconductor Corporation. All Rights Reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software"), is owned by Cypress Semiconductor Corporation
+ * or one of its subsidiaries ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products. Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ */
+
+
+
+/** @file
+ * thermistor_history.h
+ *
+ *  @brief
+ * Temperature history kept while no gateway is connected. Each measurement is
+ * recorded in a RAM block of delta encoded samples, full blocks are spilled to
+ * a ring of NVRAM items. A connecting gateway downloads the whole history with
+ * notifications of the History characteristic.
+ *
+ * The history is a stream of records. A key record is a 0x00 byte followed by
+ * the uint32 time in seconds and the sint16 temperature in 0.01 degree Celsius,
+ * both little endian. A delta record is the time since the previous record in
+ * seconds (1 to 255) followed by the sint8 temperature change. Every block
+ * starts with a key record.
+ */
+
+#ifndef __THERMISTOR_HISTORY_H__
+#define __THERMISTOR_HISTORY_H__
+
+/* *******************************************************************
+ *                              INCLUDES
+ * *******************************************************************/
+#include "wiced_bt_gatt.h"
+
+/* *******************************************************************
+ *                              CONSTANTS
+ * *******************************************************************/
+/* Commands written to the History characteristic */
+#define THERMISTOR_HISTORY_CMD_DOWNLOAD     (0x01)
+#define THERMISTOR_HISTORY_CMD_CLEAR        (0x02)
+
+/* Header byte of each download notification, the low bits count the
+ * notifications so that the gateway can tell if one is missing
+ */
+#define THERMISTOR_HISTORY_CHUNK_LAST       (0x80)
+#define THERMISTOR_HISTORY_CHUNK_SEQ_MASK   (0x7F)
+
+/* *******************************************************************
+ *                              FUNCTION DECLARATIONS
+ * *******************************************************************/
+void thermistor_history_init(void);
+
+void thermistor_history_add(uint32_t time_s, int16_t temperature);
+
+void thermistor_history_clear(void);
+
+wiced_bt_gatt_status_t thermistor_history_download_start(uint16_t conn_id, uint16_t mtu);
+
+void thermistor_history_download_stop(uint16_t conn_id);
+
+void thermistor_history_congestion(uint16_t conn_id, wiced_bool_t congested);
+
+#endif      /* __THERMISTOR_HISTORY_H__ */
@@ -0,0 +1,160 @@
+/*
+ * Copyright 2016-2020, Cypress Semiconductor Corporation or a subsidiary of
+ * Cypress Semiconductor Corporation. All Rights Reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software"), is owned by Cypress Semiconductor Corporation
+ * or one of its subsidiaries ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products. Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ */
+
+
+
+/** @file
+ * thermistor_sensors.c
+ *
+ *  @brief
+ * This file keeps the registry of the sensors and packs their values for the
+ * aggregate notification, see thermistor_sensors.h for the record format.
+ */
+
+/* *******************************************************************
+ *                              INCLUDES
+ * *******************************************************************/
+#include <string.h>
+#include "thermistor_sensors.h"
+#include "wiced_bt_trace.h"
+
+/* *******************************************************************
+ *                              VARIABLES
+ * *******************************************************************/
+static const thermistor_sensor_t *thermistor_sensors[THERMISTOR_MAX_SENSORS];
+static uint8_t                    thermistor_num_sensors;
+
+/* *******************************************************************
+ *                              FUNCTION DEFINITIONS
+ * *******************************************************************/
+/*
+ Function Name:
+ thermistor_sensor_register
+
+ Function Description:
+ @brief  Adds a sensor to the registry. The sensor structure must stay in
+         place, the application typically declares it const.
+
+ @param p_sensor     Sensor to add
+
+ @return wiced_bool_t  WICED_FALSE if the registry is full or the value too long
+ */
+wiced_bool_t thermistor_sensor_register(const thermistor_sensor_t *p_sensor)
+{
+    if ((THERMISTOR_MAX_SENSORS == thermistor_num_sensors) ||
+        (p_sensor->value_len > THERMISTOR_SENSOR_MAX_VALUE_LEN))
+    {
+        WICED_BT_TRACE("Sensor 0x%04x not registered\r\n", p_sensor->uuid);
+        return WICED_FALSE;
+    }
+
+    thermistor_sensors[thermistor_num_sensors++] = p_sensor;
+    return WICED_TRUE;
+}
+
+/*
+ Function Name:
+ thermistor_sensors_sample
+
+ Function Description:
+ @brief  Samples every registered sensor, invoked once per timer tick.
+
+ @param  void
+
+ @return void
+ */
+void thermistor_sensors_sample(void)
+{
+    uint8_t i;
+
+    for (i = 0; i < thermistor_num_sensors; i++)
+    {
+        thermistor_sensors[i]->p_sample(thermistor_sensors[i]->p_value);
+    }
+}
+
+/*
+ Function Name:
+ thermistor_sensors_count
+
+ Function Description:
+ @brief  Number of registered sensors.
+
+ @param  void
+
+ @return uint8_t     Number of sensors
+ */
+uint8_t thermistor_sensors_count(void)
+{
+    return thermistor_num_sensors;
+}
+
+/*
+ Function Name:
+ thermistor_sensors_pack
+
+ Function Description:
+ @brief  Packs the records of the sensors from *p_next on, as many as fit.
+         Invoked again from the updated *p_next until it reaches the number
+         of sensors when the MTU cannot take them all.
+
+ @param p_data       Buffer of the notification
+ @param max_len      Size of the buffer
+ @param p_next       Index of the first sensor to pack, updated
+
+ @return uint16_t    Number of bytes packed, 0 if the next record does not fit
+ */
+uint16_t thermistor_sensors_pack(uint8_t *p_data, uint16_t max_len, uint8_t *p_next)
+{
+    const thermistor_sensor_t *p_sensor;
+    uint16_t                   len = 0;
+
+    while (*p_next < thermistor_num_sensors)
+    {
+        p_sensor = thermistor_sensors[*p_next];
+        if ((len + THERMISTOR_SENSOR_RECORD_HDR_LEN + p_sensor->value_len) > max_len)
+        {
+            break;
+        }
+
+        p_data[len++] = (uint8_t)(p_sensor->uuid & 0xff);
+        p_data[len++] = (uint8_t)((p_sensor->uuid >> 8) & 0xff);
+        p_data[len++] = p_sensor->value_len;
+        memcpy(&p_data[len], p_sensor->p_value, p_sensor->value_len);
+        len += p_sensor->value_len;
+
+        (*p_next)++;
+    }
+
+    return len;
+}
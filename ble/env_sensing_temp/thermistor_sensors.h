@@ -0,0 +1,98 @@
+/*
+ * Copyright 2016-2020, Cypress Semiconductor Corporation or a subsidiary of
+ * Cypress Semiconductor Corporation. All Rights Reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software"), is owned by Cypress Semiconductor Corporation
+ * or one of its subsidiaries ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products. Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ */
+
+
+
+/** @file
+ * thermistor_sensors.h
+ *
+ *  @brief
+ * Registry of the sensors of the application. All registered sensors are
+ * sampled in the same timer tick, their values are kept in the GATT lookup
+ * table arrays of their ESS characteristics and packed together for the
+ * Aggregate characteristic notification.
+ *
+ * An aggregate notification is a sequence of records, one per sensor: the
+ * ESS characteristic UUID (uint16, little endian), the length of the value
+ * and the value as the ESS characteristic holds it. Sensors that do not fit
+ * in the MTU go in the next notification.
+ */
+
+#ifndef __THERMISTOR_SENSORS_H__
+#define __THERMISTOR_SENSORS_H__
+
+/* *******************************************************************
+ *                              INCLUDES
+ * *******************************************************************/
+#include "wiced_bt_types.h"
+
+/* *******************************************************************
+ *                              CONSTANTS
+ * *******************************************************************/
+#ifndef THERMISTOR_MAX_SENSORS
+#define THERMISTOR_MAX_SENSORS              (4)
+#endif
+
+/* Longest sensor value, the ESS characteristics take up to 4 bytes */
+#define THERMISTOR_SENSOR_MAX_VALUE_LEN     (4)
+
+/* Header of a record of the aggregate notification */
+#define THERMISTOR_SENSOR_RECORD_HDR_LEN    (3)
+
+/* Longest aggregate of all the sensors */
+#define THERMISTOR_SENSORS_AGGREGATE_MAX_LEN \
+    (THERMISTOR_MAX_SENSORS * (THERMISTOR_SENSOR_RECORD_HDR_LEN + THERMISTOR_SENSOR_MAX_VALUE_LEN))
+
+/* *******************************************************************
+ *                              TYPE DEFINITIONS
+ * *******************************************************************/
+typedef struct
+{
+    uint16_t uuid;                      /* ESS characteristic of the value */
+    uint8_t  value_len;
+    uint8_t  *p_value;                  /* value, as read from the characteristic */
+    void     (*p_sample)(uint8_t *p_value);
+} thermistor_sensor_t;
+
+/* *******************************************************************
+ *                              FUNCTION DECLARATIONS
+ * *******************************************************************/
+wiced_bool_t thermistor_sensor_register(const thermistor_sensor_t *p_sensor);
+
+void thermistor_sensors_sample(void);
+
+uint8_t thermistor_sensors_count(void);
+
+uint16_t thermistor_sensors_pack(uint8_t *p_data, uint16_t max_len, uint8_t *p_next);
+
+#endif      /* __THERMISTOR_SENSORS_H__ */
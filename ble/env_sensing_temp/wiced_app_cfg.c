@@ -76,7 +76,7 @@ const wiced_bt_cfg_settings_t wiced_app_cfg_settings =
      * */
     .security_requirement_mask           = BTM_SEC_NONE,                                               /**< Security requirements mask (BTM_SEC_NONE, or combinination of BTM_SEC_IN_AUTHENTICATE, BTM_SEC_OUT_AUTHENTICATE, BTM_SEC_ENCRYPT (see #wiced_bt_sec_level_e)) */
 
-    .max_simultaneous_links              = 1,                                                          /**< Maximum number simultaneous links to different devices */
+    .max_simultaneous_links              = 2,                                                          /**< Maximum number simultaneous links to different devices, THERMISTOR_MAX_CONNECTIONS */
 
     .br_edr_scan_cfg =                                              /* BR/EDR scan config */
     {
@@ -152,7 +152,7 @@ const wiced_bt_cfg_settings_t wiced_app_cfg_settings =
     {
         .appearance                     = APPEARANCE_SENSOR_TEMPERATURE,                               /**< GATT appearance (see gatt_appearance_e) */
         .client_max_links               = 1,                                                           /**< Client config: maximum number of servers that local client can connect to  */
-        .server_max_links               = 0,                                                           /**< Server config: maximum number of remote clients connections allowed by the local */
+        .server_max_links               = 2,                                                           /**< Server config: maximum number of remote clients connections allowed by the local, THERMISTOR_MAX_CONNECTIONS */
         .max_attr_len                   = 512,                                                         /**< Maximum attribute length; gki_cfg must have a corresponding buffer pool that can hold this length */
 #if !defined(CYW20706A2)
         .max_mtu_size                   = 517                                                          /**< Maximum MTU size for GATT connections, should be between 23 and (max_attr_len + 5) */
@@ -195,7 +195,7 @@ const wiced_bt_cfg_settings_t wiced_bt_cfg_settings =
     /* Interval of  random address refreshing */
     .rpa_refresh_timeout                = WICED_BT_CFG_DEFAULT_RANDOM_ADDRESS_CHANGE_TIMEOUT,          /**< Interval of  random address refreshing - secs */
     /* BLE white list size */
-    .ble_white_list_size                = 0,                                                           /**< Maximum number of white list devices allowed. Cannot be more than 128 */
+    .ble_white_list_size                = 1,                                                           /**< Maximum number of white list devices allowed. Cannot be more than 128 */
 #endif
 
 #if defined(CYW20719B2) || defined(CYW20721B2) || defined(CYW20819A1) || defined (CYW20820A1)
@@ -45,10 +45,15 @@
 *******************************************************************************/
 #include "app_bt_event_handler.h"
 #include "app_user_interface.h"
+#include "app_sleep.h"
 #include "GeneratedSource/cycfg_gatt_db.h"
+#include "gatt_attr_store.h"
+#include "gatt_server.h"
 #include "wiced_bt_dev.h"
 #include "wiced_bt_trace.h"
 #include "wiced_bt_stack.h"
+#include "wiced_bt_ble.h"
+#include "wiced_timer.h"
 
 /*******************************************************************************
 *        Variable Definitions
@@ -56,6 +61,29 @@
 uint16_t bt_connection_id = 0;
 app_bt_adv_conn_mode_t app_bt_adv_conn_state = APP_BT_ADV_OFF_CONN_OFF;
 
+/* Last peer connected, stored in NVRAM. The application does not pair, so a
+ * peer using a resolvable private address is only found again until it
+ * changes its address */
+static struct
+{
+    wiced_bool_t valid;
+    wiced_bt_ble_address_type_t addr_type;
+    wiced_bt_device_address_t bd_addr;
+} app_last_peer;
+
+static app_reconnect_state_t app_reconnect_state = APP_RECONNECT_OFF;
+static wiced_timer_t app_reconnect_timer;
+static uint32_t app_reconnect_backoff_ms;
+static uint8_t app_reconnect_retries;
+
+/* Attribute values, from the lookup table generated in cycfg_gatt_db.c */
+static gatt_attr_store_t app_attr_store;
+static uint8_t app_attr_slots[GATT_ATTR_INDEX_SLOTS(HDLC_GAP_DEVICE_NAME_VALUE, HDLC_IAS_ALERT_LEVEL_VALUE)];
+static uint8_t app_attr_hook_slots[GATT_ATTR_INDEX_SLOTS(HDLC_IAS_ALERT_LEVEL_VALUE, HDLC_IAS_ALERT_LEVEL_VALUE)];
+
+/* The find me locator connected, served by the GATT server core */
+static gatt_server_conn_t app_gatt_conns[1];
+
 /*******************************************************************************
 *        External Variable Declarations
 *******************************************************************************/
@@ -65,13 +93,31 @@ app_bt_adv_conn_mode_t app_bt_adv_conn_state = APP_BT_ADV_OFF_CONN_OFF;
 *******************************************************************************/
 static void                   ble_app_init               (void);
 static void                   ble_app_set_advertisement_data (void);
+static void                   ble_app_reconnect_start        (void);
+static void                   ble_app_reconnect_adv_changed  (wiced_bt_ble_advert_mode_t adv_mode);
+static void                   ble_app_reconnect_stop         (void);
+static void                   ble_app_reconnect_timer_cb     (uint32_t arg);
+static wiced_bt_gatt_status_t ble_app_write_alert_level      (uint16_t conn_id, gatt_db_lookup_table_t *p_attr, uint8_t *p_val, uint16_t len);
+
+/* GATT server core callbacks */
+static wiced_bt_gatt_status_t ble_app_get_value              (uint16_t conn_id, uint16_t attr_handle, uint8_t *p_val, uint16_t max_len, uint16_t *p_len);
+static wiced_bt_gatt_status_t ble_app_set_value              (uint16_t conn_id, uint16_t attr_handle, uint8_t *p_val, uint16_t len);
+static void                   ble_app_connect_callback       (gatt_server_conn_t *p_conn, wiced_bt_gatt_connection_status_t *p_conn_status);
+
+/* Hooks of the attributes whose writes have side effects */
+static const gatt_attr_store_hook_t app_attr_hooks[] =
+{
+    /* { attribute handle,              read hook,  write hook } */
+    { HDLC_IAS_ALERT_LEVEL_VALUE,       NULL,       ble_app_write_alert_level },
+};
 
-/* GATT Event Callback Functions */
-static wiced_bt_gatt_status_t ble_app_write_handler          (wiced_bt_gatt_write_t *p_write_req, uint16_t conn_id);
-static wiced_bt_gatt_status_t ble_app_read_handler           (wiced_bt_gatt_read_t *p_read_req, uint16_t conn_id);
-static wiced_bt_gatt_status_t ble_app_connect_callback       (wiced_bt_gatt_connection_status_t *p_conn_status);
-static wiced_bt_gatt_status_t ble_app_server_callback        (uint16_t conn_id, wiced_bt_gatt_request_type_t type, wiced_bt_gatt_request_data_t *p_data);
-static wiced_bt_gatt_status_t ble_app_gatt_event_handler     (wiced_bt_gatt_evt_t  event, wiced_bt_gatt_event_data_t *p_event_data);
+/* The Immediate Alert Service has no notification */
+static const gatt_server_cfg_t app_gatt_server_cfg =
+{
+    .p_read    = ble_app_get_value,
+    .p_write   = ble_app_set_value,
+    .p_conn_cb = ble_app_connect_callback,
+};
 
 /*******************************************************************************
 *        Function Definitions
@@ -150,6 +196,9 @@ wiced_result_t app_bt_management_callback(wiced_bt_management_evt_t event, wiced
             /* Update Advertisement LED to reflect the updated state */
             adv_led_update();
 
+            /* Move to the next reconnection phase */
+            ble_app_reconnect_adv_changed(*p_adv_mode);
+
             break;
 
         default:
@@ -180,65 +229,38 @@ wiced_result_t app_bt_management_callback(wiced_bt_management_evt_t event, wiced
 *************************************************************************************************/
 static void ble_app_init(void)
 {
+    wiced_result_t result;
+
     /* User interface initialization for LEDs, buttons */
     app_user_interface_init();
 
+    /* Sleep between BLE events, the button wakes the device */
+    app_sleep_init();
+
     /* Disable pairing for this application */
     wiced_bt_set_pairable_mode(WICED_FALSE, 0);
 
     /* Set Advertisement Data */
     ble_app_set_advertisement_data();
 
-    /* Register with BT stack to receive GATT callback */
-    wiced_bt_gatt_register(ble_app_gatt_event_handler);
+    /* Register with BT stack to receive GATT callback, the GATT server core serves the requests */
+    gatt_server_init(&app_gatt_server_cfg, app_gatt_conns, sizeof(app_gatt_conns) / sizeof(app_gatt_conns[0]));
+    wiced_bt_gatt_register(gatt_server_event_handler);
 
     /* Initialize GATT Database */
     wiced_bt_gatt_db_init(gatt_database, gatt_database_len);
+    GATT_ATTR_STORE_INIT(&app_attr_store, app_attr_slots, app_attr_hooks, app_attr_hook_slots);
 
-    /* Start Undirected LE Advertisements on device startup.
-     * The corresponding parameters are contained in 'app_bt_cfg.c' */
-    wiced_bt_start_advertisements(BTM_BLE_ADVERT_UNDIRECTED_HIGH, 0, NULL);
-}
-
-/**************************************************************************************************
-* Function Name: ble_app_gatt_event_handler()
-***************************************************************************************************
-* Summary:
-*   This function handles GATT events from the BT stack.
-*
-* Parameters:
-*   wiced_bt_gatt_evt_t event                   : BLE GATT event code of one byte length
-*   wiced_bt_gatt_event_data_t *p_event_data    : Pointer to BLE GATT event structures
-*
-* Return:
-*  wiced_bt_gatt_status_t: See possible status codes in wiced_bt_gatt_status_e in wiced_bt_gatt.h
-*
-**************************************************************************************************/
-static wiced_bt_gatt_status_t ble_app_gatt_event_handler(wiced_bt_gatt_evt_t event, wiced_bt_gatt_event_data_t *p_event_data)
-{
-    wiced_bt_gatt_status_t status = WICED_BT_GATT_ERROR;
-    wiced_bt_gatt_connection_status_t *p_conn_status = NULL;
-    wiced_bt_gatt_attribute_request_t *p_attr_req = NULL;
-
-    /* Call the appropriate callback function based on the GATT event type, and pass the relevant event
-     * parameters to the callback function */
-    switch ( event )
+    /* Read the last peer, the target reconnects to it after a disconnection */
+    if(wiced_hal_read_nvram(APP_LAST_PEER_NVRAM_ID, sizeof(app_last_peer), (uint8_t *)&app_last_peer, &result) != sizeof(app_last_peer))
     {
-        case GATT_CONNECTION_STATUS_EVT:
-            status = ble_app_connect_callback( &p_event_data->connection_status );
-            break;
-
-        case GATT_ATTRIBUTE_REQUEST_EVT:
-            p_attr_req = &p_event_data->attribute_request;
-            status = ble_app_server_callback( p_attr_req->conn_id, p_attr_req->request_type, &p_attr_req->data );
-            break;
-
-        default:
-            status = WICED_BT_GATT_SUCCESS;
-            break;
+        app_last_peer.valid = WICED_FALSE;
     }
+    wiced_init_timer(&app_reconnect_timer, ble_app_reconnect_timer_cb, 0, WICED_MILLI_SECONDS_TIMER);
 
-    return status;
+    /* Start Undirected LE Advertisements on device startup.
+     * The corresponding parameters are contained in 'app_bt_cfg.c' */
+    wiced_bt_start_advertisements(BTM_BLE_ADVERT_UNDIRECTED_HIGH, 0, NULL);
 }
 
 /**************************************************************************************************
@@ -292,8 +314,8 @@ static void ble_app_set_advertisement_data(void)
 *   starting address is passed as one of the function parameters
 *
 * Parameters:
-*   uint16_t attr_handle                    : Attribute handle for read operation
 *   uint16_t conn_id                        : Connection ID
+*   uint16_t attr_handle                    : Attribute handle for read operation
 *   uint8_t *p_val                          : Pointer to the buffer to store read data
 *   uint16_t max_len                        : Maximum buffer length available to store the read data
 *   uint16_t *p_len                         : Actual length of data copied to the buffer
@@ -302,61 +324,15 @@ static void ble_app_set_advertisement_data(void)
 *   wiced_bt_gatt_status_t: See possible status codes in wiced_bt_gatt_status_e in wiced_bt_gatt.h
 *
 **************************************************************************************************/
-static wiced_bt_gatt_status_t ble_app_get_value(uint16_t attr_handle, uint16_t conn_id, uint8_t *p_val, uint16_t max_len, uint16_t *p_len)
+static wiced_bt_gatt_status_t ble_app_get_value(uint16_t conn_id, uint16_t attr_handle, uint8_t *p_val, uint16_t max_len, uint16_t *p_len)
 {
-    int i = 0;
-    wiced_bool_t isHandleInTable = WICED_FALSE;
-    wiced_bt_gatt_status_t res = WICED_BT_GATT_INVALID_HANDLE;
-
-    /* Check for a matching handle entry */
-    for (i = 0; i < app_gatt_db_ext_attr_tbl_size; i++)
-    {
-        if (app_gatt_db_ext_attr_tbl[i].handle == attr_handle)
-        {
-            /* Detected a matching handle in external lookup table */
-            isHandleInTable = WICED_TRUE;
-
-            /* Check if the buffer has space to store the data */
-            if (app_gatt_db_ext_attr_tbl[i].cur_len <= max_len)
-            {
-                /* Value fits within the supplied buffer; copy over the value */
-                *p_len = app_gatt_db_ext_attr_tbl[i].cur_len;
-                memcpy(p_val, app_gatt_db_ext_attr_tbl[i].p_data, app_gatt_db_ext_attr_tbl[i].cur_len);
-                res = WICED_BT_GATT_SUCCESS;
-
-                /* Add code for any action required when a particular attribute is read */
-                switch ( attr_handle )
-                {
-                    case HDLC_GAP_DEVICE_NAME_VALUE:
-                        break;
-                    case HDLC_GAP_APPEARANCE_VALUE:
-                        break;
-                }
-            }
-            else
-            {
-                /* Value to read will not fit within the buffer */
-                res = WICED_BT_GATT_INVALID_ATTR_LEN;
-            }
-            break;
-        }
-    }
+    wiced_bt_gatt_status_t res = gatt_attr_store_get_value(&app_attr_store, attr_handle, conn_id, p_val, max_len, p_len);
 
-    if (!isHandleInTable)
+    if (res == WICED_BT_GATT_INVALID_HANDLE)
     {
-        /* Add code to read value for handles not contained within generated lookup table.
-         * This is a custom logic that depends on the application, and is not used in the
-         * current application. If the value for the current handle is successfully read in the
-         * below code snippet, then set the result using:
-         * res = WICED_BT_GATT_SUCCESS; */
-        switch ( attr_handle )
-        {
-            default:
-                /* The read operation was not performed for the indicated handle */
-                WICED_BT_TRACE("Read Request to Invalid Handle: 0x%x\n\r", attr_handle);
-                res = WICED_BT_GATT_READ_NOT_PERMIT;
-                break;
-        }
+        /* The read operation was not performed for the indicated handle */
+        WICED_BT_TRACE("Read Request to Invalid Handle: 0x%x\n\r", attr_handle);
+        res = WICED_BT_GATT_READ_NOT_PERMIT;
     }
 
     return res;
@@ -371,8 +347,8 @@ static wiced_bt_gatt_status_t ble_app_get_value(uint16_t attr_handle, uint16_t c
 *   whose starting address is passed as one of the function parameters
 *
 * Parameters:
-*   uint16_t attr_handle                    : Attribute handle for write operation
 *   uint16_t conn_id                        : Connection ID
+*   uint16_t attr_handle                    : Attribute handle for write operation
 *   uint8_t *p_val                          : Pointer to the buffer that stores the data to be written
 *   uint16_t len                            : Length of data to be written
 *
@@ -380,140 +356,68 @@ static wiced_bt_gatt_status_t ble_app_get_value(uint16_t attr_handle, uint16_t c
 *   wiced_bt_gatt_status_t: See possible status codes in wiced_bt_gatt_status_e in wiced_bt_gatt.h
 *
 **************************************************************************************************/
-static wiced_bt_gatt_status_t ble_app_set_value(uint16_t attr_handle, uint16_t conn_id, uint8_t *p_val, uint16_t len)
+static wiced_bt_gatt_status_t ble_app_set_value(uint16_t conn_id, uint16_t attr_handle, uint8_t *p_val, uint16_t len)
 {
-    int i = 0;
-    wiced_bool_t isHandleInTable = WICED_FALSE;
-    wiced_bool_t validLen = WICED_FALSE;
-    wiced_bt_gatt_status_t res = WICED_BT_GATT_INVALID_HANDLE;
+    wiced_bt_gatt_status_t res = gatt_attr_store_set_value(&app_attr_store, attr_handle, conn_id, p_val, len);
 
-    /* Check for a matching handle entry */
-    for (i = 0; i < app_gatt_db_ext_attr_tbl_size; i++)
+    if (res == WICED_BT_GATT_INVALID_HANDLE)
     {
-        if (app_gatt_db_ext_attr_tbl[i].handle == attr_handle)
-        {
-            /* Detected a matching handle in external lookup table */
-            isHandleInTable = WICED_TRUE;
-
-            /* Check if the buffer has space to store the data */
-            validLen = (app_gatt_db_ext_attr_tbl[i].max_len >= len);
-
-            if (validLen)
-            {
-                /* Value fits within the supplied buffer; copy over the value */
-                app_gatt_db_ext_attr_tbl[i].cur_len = len;
-                memcpy(app_gatt_db_ext_attr_tbl[i].p_data, p_val, len);
-                res = WICED_BT_GATT_SUCCESS;
-
-                /* Add code for any action required when this attribute is written.
-                 * In this case, we update the IAS led based on the IAS alert
-                 * level characteristic value */
-
-                switch ( attr_handle )
-                {
-                    case HDLC_IAS_ALERT_LEVEL_VALUE:
-                        WICED_BT_TRACE("Alert Level = %d\n\r", app_ias_alert_level[0]);
-                        ias_led_update();
-                        break;
-                }
-            }
-            else
-            {
-                /* Value to write does not meet size constraints */
-                res = WICED_BT_GATT_INVALID_ATTR_LEN;
-            }
-            break;
-        }
-    }
-
-    if (!isHandleInTable)
-    {
-        /* TODO: Add code to read value for handles not contained within generated lookup table.
-         * This is a custom logic that depends on the application, and is not used in the
-         * current application. If the value for the current handle is successfully written in the
-         * below code snippet, then set the result using:
-         * res = WICED_BT_GATT_SUCCESS; */
-        switch ( attr_handle )
-        {
-            default:
-                /* The write operation was not performed for the indicated handle */
-                WICED_BT_TRACE("Write Request to Invalid Handle: 0x%x\n\r", attr_handle);
-                res = WICED_BT_GATT_WRITE_NOT_PERMIT;
-                break;
-        }
+        /* The write operation was not performed for the indicated handle */
+        WICED_BT_TRACE("Write Request to Invalid Handle: 0x%x\n\r", attr_handle);
+        res = WICED_BT_GATT_WRITE_NOT_PERMIT;
     }
 
     return res;
 }
 
 /**************************************************************************************************
-* Function Name: ble_app_write_handler()
-***************************************************************************************************
-* Summary:
-*   This function handles Write Requests received from the client device
-*
-* Parameters:
-*   wiced_bt_gatt_write_t *p_write_req          : Pointer that contains details of Write Request
-*                                                 including the attribute handle
-*   uint16_t conn_id                            : Connection ID
-*
-* Return:
-*  wiced_bt_gatt_status_t: See possible status codes in wiced_bt_gatt_status_e in wiced_bt_gatt.h
-*
-**************************************************************************************************/
-static wiced_bt_gatt_status_t ble_app_write_handler(wiced_bt_gatt_write_t *p_write_req, uint16_t conn_id)
-{
-    wiced_bt_gatt_status_t status = WICED_BT_GATT_INVALID_HANDLE;
-
-    /* Attempt to perform the Write Request */
-    status = ble_app_set_value(p_write_req->handle, conn_id, p_write_req->p_val, p_write_req->val_len);
-
-    return status;
-}
-
-/**************************************************************************************************
-* Function Name: ble_app_read_handler()
+* Function Name: ble_app_write_alert_level()
 ***************************************************************************************************
 * Summary:
-*   This function handles Read Requests received from the client device
+*   This function is the write hook of the IAS alert level characteristic. It stores the value
+*   and updates the IAS led based on the alert level
 *
 * Parameters:
-*   wiced_bt_gatt_write_t *p_read_req           : Pointer that contains details of Read Request
-*                                                 including the attribute handle
-*   uint16_t conn_id                            : Connection ID
+*   uint16_t conn_id                        : Connection ID
+*   gatt_db_lookup_table_t *p_attr          : Lookup table entry of the alert level
+*   uint8_t *p_val                          : Pointer to the buffer that stores the data to be written
+*   uint16_t len                            : Length of data to be written
 *
 * Return:
-*  wiced_bt_gatt_status_t: See possible status codes in wiced_bt_gatt_status_e in wiced_bt_gatt.h
+*   wiced_bt_gatt_status_t: See possible status codes in wiced_bt_gatt_status_e in wiced_bt_gatt.h
 *
 **************************************************************************************************/
-static wiced_bt_gatt_status_t ble_app_read_handler( wiced_bt_gatt_read_t *p_read_req, uint16_t conn_id )
+static wiced_bt_gatt_status_t ble_app_write_alert_level(uint16_t conn_id, gatt_db_lookup_table_t *p_attr, uint8_t *p_val, uint16_t len)
 {
-    wiced_bt_gatt_status_t status = WICED_BT_GATT_INVALID_HANDLE;
+    wiced_bt_gatt_status_t res = gatt_attr_store_put(p_attr, p_val, len);
 
-    /* Attempt to perform the Read Request */
-    status = ble_app_get_value(p_read_req->handle, conn_id, p_read_req->p_val, *p_read_req->p_val_len, p_read_req->p_val_len);
+    if (res == WICED_BT_GATT_SUCCESS)
+    {
+        WICED_BT_TRACE("Alert Level = %d\n\r", app_ias_alert_level[0]);
+        ias_led_update();
+    }
 
-    return status;
+    return res;
 }
 
 /**************************************************************************************************
 * Function Name: ble_app_connect_callback()
 ***************************************************************************************************
 * Summary:
-*   This callback function handles connection status changes.
+*   This callback function handles connection status changes, once the GATT server core
+*   updated its connection entry.
 *
 * Parameters:
+*   gatt_server_conn_t *p_conn                        : Connection entry of the GATT server core
 *   wiced_bt_gatt_connection_status_t *p_conn_status  : Pointer to data that has connection details
 *
 * Return:
-*  wiced_bt_gatt_status_t: See possible status codes in wiced_bt_gatt_status_e in wiced_bt_gatt.h
+*   None
 *
 **************************************************************************************************/
-static wiced_bt_gatt_status_t ble_app_connect_callback(wiced_bt_gatt_connection_status_t *p_conn_status)
+static void ble_app_connect_callback(gatt_server_conn_t *p_conn, wiced_bt_gatt_connection_status_t *p_conn_status)
 {
-    wiced_bt_gatt_status_t status = WICED_BT_GATT_ERROR;
-
-    if ( NULL != p_conn_status )
+    if ( NULL != p_conn )
     {
         if ( p_conn_status->connected )
         {
@@ -523,6 +427,19 @@ static wiced_bt_gatt_status_t ble_app_connect_callback(wiced_bt_gatt_connection_
             /* Store the connection ID */
             bt_connection_id = p_conn_status->conn_id;
 
+            /* Reconnected, or connected to a new peer to reconnect to next time */
+            ble_app_reconnect_stop();
+            if(!app_last_peer.valid || (app_last_peer.addr_type != p_conn_status->addr_type) ||
+                memcmp(app_last_peer.bd_addr, p_conn_status->bd_addr, BD_ADDR_LEN))
+            {
+                wiced_result_t result;
+
+                app_last_peer.valid = WICED_TRUE;
+                app_last_peer.addr_type = p_conn_status->addr_type;
+                memcpy(app_last_peer.bd_addr, p_conn_status->bd_addr, BD_ADDR_LEN);
+                wiced_hal_write_nvram(APP_LAST_PEER_NVRAM_ID, sizeof(app_last_peer), (uint8_t *)&app_last_peer, &result);
+            }
+
             /* Update the adv/conn state */
             app_bt_adv_conn_state = APP_BT_ADV_OFF_CONN_ON;
         }
@@ -534,8 +451,8 @@ static wiced_bt_gatt_status_t ble_app_connect_callback(wiced_bt_gatt_connection_
             /* Set the connection id to zero to indicate disconnected state */
             bt_connection_id = 0;
 
-            /* Restart the advertisements */
-            wiced_bt_start_advertisements(BTM_BLE_ADVERT_UNDIRECTED_HIGH, 0, NULL);
+            /* Advertise to the last peer first */
+            ble_app_reconnect_start();
 
             /* Update the adv/conn state */
             app_bt_adv_conn_state = APP_BT_ADV_ON_CONN_OFF;
@@ -546,45 +463,162 @@ static wiced_bt_gatt_status_t ble_app_connect_callback(wiced_bt_gatt_connection_
 
         /* Update the advertisement LED to reflect updated state */
         adv_led_update();
+    }
+}
 
-        status = WICED_BT_GATT_SUCCESS;
+/**************************************************************************************************
+* Function Name: ble_app_reconnect_start()
+***************************************************************************************************
+* Summary:
+*   This function starts the reconnection after a disconnection, with high duty directed
+*   advertising to the last peer. Open advertising is started if there is no last peer
+*
+* Parameters:
+*   None
+*
+* Return:
+*   None
+*
+**************************************************************************************************/
+static void ble_app_reconnect_start(void)
+{
+    app_reconnect_backoff_ms = APP_RECONNECT_BACKOFF_MS;
+    app_reconnect_retries = 0;
+
+    if(!app_last_peer.valid)
+    {
+        app_reconnect_state = APP_RECONNECT_OFF;
+        wiced_bt_start_advertisements(BTM_BLE_ADVERT_UNDIRECTED_HIGH, 0, NULL);
+        return;
     }
 
-    return status;
+    WICED_BT_TRACE("Reconnecting to '%B'\n\r", app_last_peer.bd_addr);
+    app_reconnect_state = APP_RECONNECT_DIRECTED;
+    wiced_bt_start_advertisements(BTM_BLE_ADVERT_DIRECTED_HIGH, app_last_peer.addr_type, app_last_peer.bd_addr);
 }
 
 /**************************************************************************************************
-* Function Name: ble_app_server_callback()
+* Function Name: ble_app_reconnect_adv_changed()
 ***************************************************************************************************
 * Summary:
-*   This function handles GATT server events from the BT stack.
+*   This function moves the reconnection to its next phase when advertising changes. High duty
+*   directed advertising is followed by undirected advertising accepting only the last peer,
+*   which is followed by open advertising after the back-off
 *
 * Parameters:
-*   uint16_t conn_id                            : Connection ID
-*   wiced_bt_gatt_request_type_t type           : Type of GATT server event
-*   wiced_bt_gatt_request_data_t *p_data        : Pointer to GATT server event data
+*   wiced_bt_ble_advert_mode_t adv_mode        : New advertising mode
 *
 * Return:
-*  wiced_bt_gatt_status_t: See possible status codes in wiced_bt_gatt_status_e in wiced_bt_gatt.h
+*   None
 *
 **************************************************************************************************/
-static wiced_bt_gatt_status_t ble_app_server_callback(uint16_t conn_id, wiced_bt_gatt_request_type_t type, wiced_bt_gatt_request_data_t *p_data)
+static void ble_app_reconnect_adv_changed(wiced_bt_ble_advert_mode_t adv_mode)
 {
-    wiced_bt_gatt_status_t status = WICED_BT_GATT_ERROR;
+    /* Advertising stops when connected, the connection ends the reconnection */
+    if(bt_connection_id != 0)
+    {
+        return;
+    }
 
-    switch ( type )
+    switch(app_reconnect_state)
     {
-        case GATTS_REQ_TYPE_READ:
-            /* Attribute read request */
-            status = ble_app_read_handler( &p_data->read_req, conn_id );
+        case APP_RECONNECT_DIRECTED:
+            /* The stack follows high duty with low duty directed advertising, stop it instead */
+            if(adv_mode == BTM_BLE_ADVERT_DIRECTED_LOW)
+            {
+                wiced_bt_start_advertisements(BTM_BLE_ADVERT_OFF, 0, NULL);
+            }
+            else if(adv_mode == BTM_BLE_ADVERT_OFF)
+            {
+                /* The white list can only be changed while not advertising */
+                app_reconnect_state = APP_RECONNECT_FILTERED;
+                wiced_bt_ble_update_advertising_white_list(WICED_TRUE, app_last_peer.bd_addr);
+                wiced_bt_ble_update_advertisement_filter_policy(BTM_BLE_ADVERT_FILTER_WHITELIST_CONNECTION_REQ_WHITELIST_SCAN_REQ);
+                wiced_bt_start_advertisements(BTM_BLE_ADVERT_UNDIRECTED_HIGH, 0, NULL);
+            }
+            break;
+
+        case APP_RECONNECT_FILTERED:
+        case APP_RECONNECT_BACKOFF:
+            if(adv_mode == BTM_BLE_ADVERT_OFF)
+            {
+                if(app_reconnect_state == APP_RECONNECT_FILTERED)
+                {
+                    wiced_bt_ble_update_advertisement_filter_policy(BTM_BLE_ADVERT_FILTER_ALL_CONNECTION_REQ_ALL_SCAN_REQ);
+                    wiced_bt_ble_update_advertising_white_list(WICED_FALSE, app_last_peer.bd_addr);
+                    app_reconnect_state = APP_RECONNECT_BACKOFF;
+                }
+
+                if(app_reconnect_retries++ < APP_RECONNECT_MAX_RETRIES)
+                {
+                    wiced_start_timer(&app_reconnect_timer, app_reconnect_backoff_ms);
+                }
+                else
+                {
+                    WICED_BT_TRACE("Reconnection stopped\n\r");
+                    app_reconnect_state = APP_RECONNECT_OFF;
+                }
+            }
             break;
-        case GATTS_REQ_TYPE_WRITE:
-            /* Attribute write request */
-            status = ble_app_write_handler( &p_data->write_req, conn_id );
+
+        default:
             break;
     }
+}
 
-    return status;
+/**************************************************************************************************
+* Function Name: ble_app_reconnect_stop()
+***************************************************************************************************
+* Summary:
+*   This function ends the reconnection once connected, and restores the advertising filter
+*
+* Parameters:
+*   None
+*
+* Return:
+*   None
+*
+**************************************************************************************************/
+static void ble_app_reconnect_stop(void)
+{
+    if(app_reconnect_state == APP_RECONNECT_FILTERED)
+    {
+        wiced_bt_ble_update_advertisement_filter_policy(BTM_BLE_ADVERT_FILTER_ALL_CONNECTION_REQ_ALL_SCAN_REQ);
+        wiced_bt_ble_update_advertising_white_list(WICED_FALSE, app_last_peer.bd_addr);
+    }
+
+    wiced_stop_timer(&app_reconnect_timer);
+    app_reconnect_state = APP_RECONNECT_OFF;
+}
+
+/**************************************************************************************************
+* Function Name: ble_app_reconnect_timer_cb()
+***************************************************************************************************
+* Summary:
+*   This timer callback function restarts open advertising at the end of the back-off, and
+*   doubles the next back-off
+*
+* Parameters:
+*   uint32_t arg                                : The argument parameter is not used in this callback
+*
+* Return:
+*   None
+*
+**************************************************************************************************/
+static void ble_app_reconnect_timer_cb(uint32_t arg)
+{
+    if((app_reconnect_state != APP_RECONNECT_BACKOFF) || (bt_connection_id != 0))
+    {
+        return;
+    }
+
+    app_reconnect_backoff_ms *= 2;
+    if(app_reconnect_backoff_ms > APP_RECONNECT_BACKOFF_MAX_MS)
+    {
+        app_reconnect_backoff_ms = APP_RECONNECT_BACKOFF_MAX_MS;
+    }
+
+    wiced_bt_start_advertisements(BTM_BLE_ADVERT_UNDIRECTED_HIGH, 0, NULL);
 }
 
 /* [] END OF FILE */
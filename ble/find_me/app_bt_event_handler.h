@@ -47,10 +47,27 @@
 *        Header Files
 *******************************************************************************/
 #include "wiced_bt_dev.h"
+#include "wiced_hal_nvram.h"
 
 /*******************************************************************************
 *        Macro Definitions
 *******************************************************************************/
+/* Reconnection after a disconnection: high duty directed advertising to the
+ * last peer, then undirected advertising accepting only the last peer, then
+ * open advertising retried after a back-off doubling up to the maximum */
+#ifndef APP_RECONNECT_BACKOFF_MS
+#define APP_RECONNECT_BACKOFF_MS        2000
+#endif
+#ifndef APP_RECONNECT_BACKOFF_MAX_MS
+#define APP_RECONNECT_BACKOFF_MAX_MS    32000
+#endif
+#ifndef APP_RECONNECT_MAX_RETRIES
+#define APP_RECONNECT_MAX_RETRIES       4
+#endif
+
+/* NVRAM ID of the last peer connected */
+#define APP_LAST_PEER_NVRAM_ID          WICED_NVRAM_VSID_START
+
 /* This enumeration combines the advertising, connection states from two different
  * callbacks to maintain the status in a single state variable */
 typedef enum
@@ -60,6 +77,15 @@ typedef enum
     APP_BT_ADV_OFF_CONN_ON
 } app_bt_adv_conn_mode_t;
 
+/* Reconnection phases after a disconnection */
+typedef enum
+{
+    APP_RECONNECT_OFF,                  /* no reconnection, open advertising or none */
+    APP_RECONNECT_DIRECTED,             /* high duty directed advertising to the last peer */
+    APP_RECONNECT_FILTERED,             /* undirected advertising accepting only the last peer */
+    APP_RECONNECT_BACKOFF               /* open advertising, retried after the back-off */
+} app_reconnect_state_t;
+
 /*******************************************************************************
 *        External Variable Declarations
 *******************************************************************************/
@@ -0,0 +1,125 @@
+/*
+ * Copyright 2016-2020, Cypress Semiconductor Corporation or a subsidiary of
+ * Cypress Semiconductor Corporation. All Rights Reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software"), is owned by Cypress Semiconductor Corporation
+ * or one of its subsidiaries ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products. Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ */
+
+/*******************************************************************************
+* File Name: app_sleep.c
+* Version: 1.0
+*
+* Description:
+*   Source file for the low power (sleep) configuration of the application.
+*   The device sleeps whenever the application has nothing to do, and is woken
+*   up by the BT stack for connection events and GATT writes, or by the button.
+*
+*******************************************************************************/
+
+/*******************************************************************************
+*        Header Files
+*******************************************************************************/
+#include "app_sleep.h"
+#include "power_mgr.h"
+#include "app_user_interface.h"
+
+/*******************************************************************************
+*        Function Prototypes
+*******************************************************************************/
+#ifdef SLEEP_SUPPORTED
+static void app_sleep_post_sleep_cb(wiced_bool_t restore_configuration);
+#endif
+
+/*******************************************************************************
+*        Function Definitions
+*******************************************************************************/
+
+/*******************************************************************************
+* Function Name: app_sleep_init()
+********************************************************************************
+*
+* Summary:
+*   This function configures sleep, with the button as the wake source. The
+*   power manager grants the deepest sleep the votes of the modules allow, the
+*   user interface keeps the PWMs running while an LED blinks. It is called
+*   once the user interface is initialized
+*
+* Parameters:
+*   None
+*
+* Return:
+*   None
+*
+*******************************************************************************/
+void app_sleep_init(void)
+{
+#ifdef SLEEP_SUPPORTED
+    wiced_sleep_config_t app_sleep_config = { 0 };
+
+    /* No host is connected to the HCI UART, only the button wakes the device
+     * besides the BT stack */
+    app_sleep_config.sleep_mode            = WICED_SLEEP_MODE_NO_TRANSPORT;
+    app_sleep_config.host_wake_mode        = WICED_SLEEP_WAKE_ACTIVE_HIGH;
+    app_sleep_config.device_wake_mode      = WICED_SLEEP_WAKE_ACTIVE_LOW;
+    app_sleep_config.device_wake_source    = WICED_SLEEP_WAKE_SOURCE_GPIO;
+    app_sleep_config.device_wake_gpio_num  = APP_BUTTON_GPIO;
+    app_sleep_config.post_sleep_cback      = app_sleep_post_sleep_cb;
+
+    power_mgr_init(&app_sleep_config);
+#else
+    power_mgr_init(NULL);
+#endif
+}
+
+#ifdef SLEEP_SUPPORTED
+/*******************************************************************************
+* Function Name: app_sleep_post_sleep_cb()
+********************************************************************************
+*
+* Summary:
+*   This callback function is called on wake up, it restores the LEDs when the
+*   hardware configuration was lost in sleep
+*
+* Parameters:
+*   wiced_bool_t restore_configuration - WICED_TRUE after shutdown sleep
+*
+* Return:
+*   None
+*
+*******************************************************************************/
+static void app_sleep_post_sleep_cb(wiced_bool_t restore_configuration)
+{
+    if(restore_configuration)
+    {
+        app_user_interface_restore();
+    }
+}
+#endif
+
+/* [] END OF FILE */
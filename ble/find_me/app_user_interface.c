@@ -37,7 +37,8 @@
 *
 * Description:
 *   Source file for application user interface (LEDs, Buttons) related
-*   functionality
+*   functionality. Blinking LEDs are driven by the PWMs so that the CPU is not
+*   woken up to toggle them, and the device can sleep between BLE events.
 *
 *******************************************************************************/
 
@@ -46,23 +47,39 @@
 *******************************************************************************/
 #include "app_bt_event_handler.h"
 #include "app_user_interface.h"
-#include "wiced_timer.h"
 #include "wiced_platform.h"
 #include "wiced_hal_gpio.h"
+#include "wiced_hal_pwm.h"
+#include "wiced_hal_aclk.h"
+#include "wiced_bt_trace.h"
+#include "power_mgr.h"
 #include "GeneratedSource/cycfg_gatt_db.h"
 
+/*******************************************************************************
+*        Macro Definitions
+*******************************************************************************/
+/* LED states */
+typedef enum
+{
+    LED_MODE_OFF,
+    LED_MODE_ON,
+    LED_MODE_BLINK
+} led_mode_t;
+
 /*******************************************************************************
 *        Variable Definitions
 *******************************************************************************/
-static wiced_timer_t adv_led_timer, ias_led_timer;
-static wiced_bool_t adv_timer_stopped_flag = WICED_TRUE;
-static wiced_bool_t ias_timer_stopped_flag = WICED_TRUE;
+static led_mode_t adv_led_mode = LED_MODE_OFF;
+static led_mode_t ias_led_mode = LED_MODE_OFF;
+static uint8_t    ui_power_voter = POWER_MGR_VOTER_INVALID;
 
 /*******************************************************************************
 *        Function Prototypes
 *******************************************************************************/
-static void ias_led_timer_cb(uint32_t arg);
-static void adv_led_timer_cb(uint32_t arg);
+static void led_set_mode(wiced_bt_gpio_numbers_t gpio, PwmChannels channel, uint32_t pwm_function,
+                         uint32_t toggle_rate_ms, led_mode_t mode);
+static void app_button_cb(void *user_data, uint8_t port_pin);
+static void app_user_interface_vote(void);
 
 /*******************************************************************************
 *        Function Definitions
@@ -85,10 +102,57 @@ static void adv_led_timer_cb(uint32_t arg);
 *******************************************************************************/
 void app_user_interface_init(void)
 {
-    /* Initialize the timers used for advertising state LED, and IAS alert
-     * level LED */
-    wiced_init_timer(&adv_led_timer, adv_led_timer_cb, 0, WICED_MILLI_SECONDS_PERIODIC_TIMER);
-    wiced_init_timer(&ias_led_timer, ias_led_timer_cb, 0, WICED_MILLI_SECONDS_PERIODIC_TIMER);
+    /* Clock of the PWMs used for blinking the advertising state LED, and IAS
+     * alert level LED */
+    wiced_hal_aclk_enable(LED_PWM_CLK_HZ, ACLK1, ACLK_FREQ_24_MHZ);
+
+    /* The button silences the alert */
+    wiced_platform_register_button_callback(APP_BUTTON, app_button_cb, NULL, WICED_PLATFORM_BUTTON_RISING_EDGE);
+
+    ui_power_voter = power_mgr_voter_add("ui");
+}
+
+/*******************************************************************************
+* Function Name: app_user_interface_restore()
+********************************************************************************
+*
+* Summary:
+*   This function restores the LED states after the hardware configuration was
+*   lost in shutdown sleep
+*
+* Parameters:
+*   None
+*
+* Return:
+*   None
+*
+*******************************************************************************/
+void app_user_interface_restore(void)
+{
+    wiced_hal_aclk_enable(LED_PWM_CLK_HZ, ACLK1, ACLK_FREQ_24_MHZ);
+
+    led_set_mode(ADV_LED_GPIO, ADV_LED_PWM, ADV_LED_PWM_FUNCTION, ADV_LED_UPDATE_RATE_MS, adv_led_mode);
+    led_set_mode(IAS_LED_GPIO, IAS_LED_PWM, IAS_LED_PWM_FUNCTION, IAS_LED_UPDATE_RATE_MS, ias_led_mode);
+}
+
+/*******************************************************************************
+* Function Name: app_user_interface_is_blinking()
+********************************************************************************
+*
+* Summary:
+*   This function tells whether a PWM is blinking an LED. The PWMs stop in
+*   shutdown sleep
+*
+* Parameters:
+*   None
+*
+* Return:
+*   wiced_bool_t: WICED_TRUE if an LED is blinking
+*
+*******************************************************************************/
+wiced_bool_t app_user_interface_is_blinking(void)
+{
+    return (adv_led_mode == LED_MODE_BLINK) || (ias_led_mode == LED_MODE_BLINK);
 }
 
 /*******************************************************************************
@@ -108,36 +172,31 @@ void app_user_interface_init(void)
 *******************************************************************************/
 void adv_led_update(void)
 {
-    /* Stop the advertising led timer */
-    wiced_stop_timer(&adv_led_timer);
-
-    /* Set the stop flag to prevent any pending timer callback to change LED
-     * state */
-    adv_timer_stopped_flag = WICED_TRUE;
-
     /* Set LED state based on BLE advertising/connection state.
      * LED OFF for no advertisement/connection, LED blinking for advertisement
      * state, and LED ON for connected state  */
     switch(app_bt_adv_conn_state)
     {
         case APP_BT_ADV_OFF_CONN_OFF:
-            wiced_hal_gpio_set_pin_output(ADV_LED_GPIO, LED_OFF);
+            adv_led_mode = LED_MODE_OFF;
             break;
 
         case APP_BT_ADV_ON_CONN_OFF:
-            wiced_start_timer(&adv_led_timer, ADV_LED_UPDATE_RATE_MS);
-            adv_timer_stopped_flag = WICED_FALSE;
+            adv_led_mode = LED_MODE_BLINK;
             break;
 
         case APP_BT_ADV_OFF_CONN_ON:
-            wiced_hal_gpio_set_pin_output(ADV_LED_GPIO, LED_ON);
+            adv_led_mode = LED_MODE_ON;
             break;
 
         default:
             /* LED OFF for unexpected states */
-            wiced_hal_gpio_set_pin_output(ADV_LED_GPIO, LED_OFF);
+            adv_led_mode = LED_MODE_OFF;
             break;
     }
+
+    led_set_mode(ADV_LED_GPIO, ADV_LED_PWM, ADV_LED_PWM_FUNCTION, ADV_LED_UPDATE_RATE_MS, adv_led_mode);
+    app_user_interface_vote();
 }
 
 /*******************************************************************************
@@ -157,12 +216,8 @@ void adv_led_update(void)
 *******************************************************************************/
 void ias_led_update(void)
 {
-    /* Stop the IAS led timer */
-    wiced_stop_timer(&ias_led_timer);
-
-    /* Set the stop flag to prevent any pending timer callback to change LED
-     * state */
-    ias_timer_stopped_flag = WICED_TRUE;
+    /* In case of disconnection, turn off the IAS LED */
+    ias_led_mode = LED_MODE_OFF;
 
     /* Update LED based on IAS alert level only when the device is connected */
     if(app_bt_adv_conn_state == APP_BT_ADV_OFF_CONN_ON)
@@ -172,92 +227,110 @@ void ias_led_update(void)
         switch(app_ias_alert_level[0])
         {
             case IAS_ALERT_LEVEL_LOW:
-                wiced_hal_gpio_set_pin_output(IAS_LED_GPIO, LED_OFF);
+                ias_led_mode = LED_MODE_OFF;
                 break;
 
             case IAS_ALERT_LEVEL_MID:
-                ias_timer_stopped_flag = WICED_FALSE;
-                wiced_start_timer(&ias_led_timer, IAS_LED_UPDATE_RATE_MS);
+                ias_led_mode = LED_MODE_BLINK;
                 break;
 
             case IAS_ALERT_LEVEL_HIGH:
-                wiced_hal_gpio_set_pin_output(IAS_LED_GPIO, LED_ON);
+                ias_led_mode = LED_MODE_ON;
                 break;
 
             default:
                 /* Consider any other level as High alert level */
-                wiced_hal_gpio_set_pin_output(IAS_LED_GPIO, LED_ON);
+                ias_led_mode = LED_MODE_ON;
                 break;
         }
     }
-    else
-    {
-        /* In case of disconnection, turn off the IAS LED */
-        wiced_hal_gpio_set_pin_output(IAS_LED_GPIO, LED_OFF);
-    }
+
+    led_set_mode(IAS_LED_GPIO, IAS_LED_PWM, IAS_LED_PWM_FUNCTION, IAS_LED_UPDATE_RATE_MS, ias_led_mode);
+    app_user_interface_vote();
+}
+
+/*******************************************************************************
+* Function Name: app_user_interface_vote()
+********************************************************************************
+*
+* Summary:
+*   This function votes for the deepest sleep the LEDs allow. The PWMs stop in
+*   shutdown sleep, so only sleep without shutdown is allowed while an LED
+*   blinks
+*
+* Parameters:
+*   None
+*
+* Return:
+*   None
+*
+*******************************************************************************/
+static void app_user_interface_vote(void)
+{
+    power_mgr_vote(ui_power_voter, app_user_interface_is_blinking() ? POWER_MGR_SLEEP : POWER_MGR_SHUTDOWN);
 }
 
 /*******************************************************************************
-* Function Name: adv_led_timer_cb()
+* Function Name: led_set_mode()
 ********************************************************************************
 *
 * Summary:
-*   This timer callback function toggles the state of the advertising LED and is
-*   used to indicate the device is advertising
+*   This function drives an LED. A blinking LED is handed to its PWM, a steady
+*   LED is given back to the GPIO
 *
 * Parameters:
-*   uint32_t arg - The argument parameter is not used in this callback
+*   wiced_bt_gpio_numbers_t gpio - GPIO of the LED
+*   PwmChannels channel          - PWM channel blinking the LED
+*   uint32_t pwm_function        - GPIO function connecting the LED to the PWM
+*   uint32_t toggle_rate_ms      - Time the LED stays on, and off, when blinking
+*   led_mode_t mode              - LED state
 *
 * Return:
 *   None
 *
 *******************************************************************************/
-static void adv_led_timer_cb(uint32_t arg)
+static void led_set_mode(wiced_bt_gpio_numbers_t gpio, PwmChannels channel, uint32_t pwm_function,
+                         uint32_t toggle_rate_ms, led_mode_t mode)
 {
-    /* The timer stopped flag is checked to prevent any pending timer
-     * callback from changing LED state after the timer is stopped */
-    if(!adv_timer_stopped_flag)
+    pwm_config_t pwm_config;
+
+    if(mode == LED_MODE_BLINK)
     {
-        if(wiced_hal_gpio_get_pin_output(ADV_LED_GPIO) == LED_OFF)
-        {
-            wiced_hal_gpio_set_pin_output(ADV_LED_GPIO, LED_ON);
-        }
-        else
-        {
-            wiced_hal_gpio_set_pin_output(ADV_LED_GPIO, LED_OFF);
-        }
+        wiced_hal_pwm_get_params(LED_PWM_CLK_HZ, LED_PWM_DUTY_CYCLE, 1000 / (2 * toggle_rate_ms), &pwm_config);
+        wiced_hal_gpio_select_function(gpio, pwm_function);
+        wiced_hal_pwm_start(channel, PMU_CLK, pwm_config.toggle_count, pwm_config.init_count, 0);
+    }
+    else
+    {
+        wiced_hal_pwm_disable(channel);
+        wiced_hal_gpio_select_function(gpio, WICED_GPIO);
+        wiced_hal_gpio_set_pin_output(gpio, (mode == LED_MODE_ON) ? LED_ON : LED_OFF);
     }
 }
 
 /*******************************************************************************
-* Function Name: ias_led_timer_cb()
+* Function Name: app_button_cb()
 ********************************************************************************
 *
 * Summary:
-*   This timer callback function toggles the state of the IAS LED and is
-*   used to indicate the alert level is mid level
+*   This button callback function silences the alert of the target. The
+*   button press also wakes the device from sleep
 *
 * Parameters:
-*   uint32_t arg - The argument parameter is not used in this callback
+*   void *user_data  - The user data parameter is not used in this callback
+*   uint8_t port_pin - The port pin parameter is not used in this callback
 *
 * Return:
 *   None
 *
 *******************************************************************************/
-static void ias_led_timer_cb(uint32_t arg)
+static void app_button_cb(void *user_data, uint8_t port_pin)
 {
-    /* The timer stopped flag is checked to prevent any pending timer
-     * callback from changing LED state after the timer is stopped */
-    if(!ias_timer_stopped_flag)
+    if(app_ias_alert_level[0] != IAS_ALERT_LEVEL_LOW)
     {
-        if(wiced_hal_gpio_get_pin_output(IAS_LED_GPIO) == LED_OFF)
-        {
-            wiced_hal_gpio_set_pin_output(IAS_LED_GPIO, LED_ON);
-        }
-        else
-        {
-            wiced_hal_gpio_set_pin_output(IAS_LED_GPIO, LED_OFF);
-        }
+        WICED_BT_TRACE("Alert silenced\n\r");
+        app_ias_alert_level[0] = IAS_ALERT_LEVEL_LOW;
+        ias_led_update();
     }
 }
 
@@ -62,10 +62,30 @@
 #define IAS_LED_GPIO                    WICED_GET_PIN_FOR_LED(WICED_PLATFORM_LED_1)
 #endif
 
+/* PWM channels driving the LEDs when blinking, the EVK-03 kit shares one */
+#define ADV_LED_PWM                     PWM0
+#define ADV_LED_PWM_FUNCTION            WICED_PWM0
+#ifndef COMPONENT_CYW920721B2EVK_03_design_modus
+#define IAS_LED_PWM                     PWM1
+#define IAS_LED_PWM_FUNCTION            WICED_PWM1
+#else
+#define IAS_LED_PWM                     PWM0
+#define IAS_LED_PWM_FUNCTION            WICED_PWM0
+#endif
+
 /* Update rate of LED's in milliseconds when blinking */
 #define ADV_LED_UPDATE_RATE_MS          250
 #define IAS_LED_UPDATE_RATE_MS          250
 
+/* Input clock of the LED PWMs from ACLK1, low enough for the 16-bit
+ * counters to cover a blink period */
+#define LED_PWM_CLK_HZ                  100000
+#define LED_PWM_DUTY_CYCLE              50
+
+/* Button silencing the alert, configured as the wake source of sleep */
+#define APP_BUTTON                      WICED_PLATFORM_BUTTON_1
+#define APP_BUTTON_GPIO                 WICED_GET_PIN_FOR_BUTTON(APP_BUTTON)
+
 /* LED's on the kit are active low */
 #define LED_ON                          0
 #define LED_OFF                         1
@@ -81,6 +101,8 @@
 void app_user_interface_init(void);
 void adv_led_update(void);
 void ias_led_update(void);
+void app_user_interface_restore(void);
+wiced_bool_t app_user_interface_is_blinking(void);
 
 #endif /* APP_USER_INTERFACE_H_ */
 
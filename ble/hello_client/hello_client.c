@@ -79,6 +79,8 @@
 #include "wiced_bt_trace.h"
 #include "wiced_hal_nvram.h"
 #include "wiced_transport.h"
+#include "hci_control_api.h"
+#include "hci_control_dispatch.h"
 
 #if ( defined(CYW20706A2) || defined(CYW20719B1) || defined(CYW20719B0) || defined(CYW20721B1) || defined(CYW20735B0) || defined(CYW43012C0) )
 #include "wiced_bt_app_common.h"
@@ -88,6 +90,11 @@
 #include "wiced_memory.h"
 #include "wiced_hal_puart.h"
 #include "wiced_timer.h"
+#include "gatt_attr_index.h"
+#include "scan_filter.h"
+#include "bond_store.h"
+#include "gatt_client.h"
+#include "conn_timing.h"
 
 /******************************************************************************
  *                                Constants
@@ -96,6 +103,52 @@
 
 #define HELLO_CLIENT_MAX_SLAVES                     3       /* Hello Client maximum number of slaves that can be connected */
 #define HELLO_CLIENT_MAX_CONNECTIONS                4       /* Hello Client maximum number of connections including master/slave */
+#define HELLO_CLIENT_MAX_PENDING                    4       /* Hello Client maximum number of found devices waiting for a connection */
+#define HELLO_CLIENT_CONNECT_TIMEOUT_IN_SECONDS     5       /* Hello Client time given to one connection attempt */
+#define HELLO_CLIENT_PEER_HASH_SIZE                 8       /* Slots of the peer table indexes, power of 2 above HELLO_CLIENT_MAX_CONNECTIONS */
+
+/* State of the client configuration descriptor of a slave */
+#define HELLO_CLIENT_CCCD_DISABLED                  0
+#define HELLO_CLIENT_CCCD_PENDING                   1       /* write queued, waiting for the response */
+#define HELLO_CLIENT_CCCD_ENABLED                   2
+
+#define HELLO_CLIENT_BOND_STORE_VS_ID               WICED_NVRAM_VSID_START  /* index and link keys of the bonded devices */
+
+#define HELLO_CLIENT_HIST_BUCKETS                   12      /* inter-arrival histogram: <1ms, then [2^(k-1), 2^k) ms, the last one open */
+#define HELLO_CLIENT_SEQ_OFFSET_NONE                0xff    /* data from the slaves carries no sequence byte */
+
+#define HELLO_CLIENT_RELAY_QUEUE_SIZE               512     /* relay: bytes of slave data waiting for the master */
+#define HELLO_CLIENT_RELAY_FLUSH_MS                 20      /* relay: default longest wait for a fuller notification */
+#define HELLO_CLIENT_RELAY_RECORD_HDR_LEN           2       /* relay record: slave index, data length, then the data */
+
+/* Send the statistics of every slave, one HCI_CONTROL_LE_EVENT_PEER_STATS each */
+#ifndef HCI_CONTROL_LE_COMMAND_READ_PEER_STATS
+#define HCI_CONTROL_LE_COMMAND_READ_PEER_STATS      ( ( HCI_CONTROL_GROUP_LE << 8 ) | 0x31 )
+#endif
+/* Clear the statistics of every slave */
+#ifndef HCI_CONTROL_LE_COMMAND_RESET_PEER_STATS
+#define HCI_CONTROL_LE_COMMAND_RESET_PEER_STATS     ( ( HCI_CONTROL_GROUP_LE << 8 ) | 0x32 )
+#endif
+/* Set the offset of the sequence byte in the slave data, payload: offset (uint8, 0xff for none) */
+#ifndef HCI_CONTROL_LE_COMMAND_SET_SEQ_OFFSET
+#define HCI_CONTROL_LE_COMMAND_SET_SEQ_OFFSET       ( ( HCI_CONTROL_GROUP_LE << 8 ) | 0x33 )
+#endif
+/* Statistics of a slave: address, conn_id, notifications, indications, bytes, gaps, then the histogram (uint32 each) */
+#ifndef HCI_CONTROL_LE_EVENT_PEER_STATS
+#define HCI_CONTROL_LE_EVENT_PEER_STATS             ( ( HCI_CONTROL_GROUP_LE << 8 ) | 0x31 )
+#endif
+/* Set the relay mode, payload: enable (uint8), longest wait for a fuller notification in ms (uint16, 0 for the default) */
+#ifndef HCI_CONTROL_LE_COMMAND_SET_RELAY
+#define HCI_CONTROL_LE_COMMAND_SET_RELAY            ( ( HCI_CONTROL_GROUP_LE << 8 ) | 0x34 )
+#endif
+/* Send the relay statistics in one HCI_CONTROL_LE_EVENT_RELAY_STATS */
+#ifndef HCI_CONTROL_LE_COMMAND_READ_RELAY_STATS
+#define HCI_CONTROL_LE_COMMAND_READ_RELAY_STATS     ( ( HCI_CONTROL_GROUP_LE << 8 ) | 0x35 )
+#endif
+/* Relay statistics: records relayed, notifications or indications sent, records dropped, bytes queued (uint32 each) */
+#ifndef HCI_CONTROL_LE_EVENT_RELAY_STATS
+#define HCI_CONTROL_LE_EVENT_RELAY_STATS            ( ( HCI_CONTROL_GROUP_LE << 8 ) | 0x32 )
+#endif
 
 /* GPIO pins */
 #ifdef CYW20706A2
@@ -166,6 +219,19 @@ typedef struct
     const void *p_attr;
 } gatt_attribute_t;
 
+/* Data received from a slave */
+typedef struct
+{
+    uint32_t notifications;                         // notifications received
+    uint32_t indications;                           // indications received
+    uint32_t bytes;                                 // bytes received in notifications and indications
+    uint32_t gaps;                                  // values missed, from the sequence byte
+    uint32_t hist[HELLO_CLIENT_HIST_BUCKETS];       // time between two arrivals
+    uint32_t last_rx_us;                            // time of the last arrival
+    uint8_t  last_seq;                              // sequence byte of the last arrival
+    uint8_t  has_rx;                                // last_rx_us and last_seq are valid
+} hello_client_peer_stats_t;
+
 /* Peer Info */
 typedef struct
 {
@@ -174,8 +240,43 @@ typedef struct
     uint8_t  addr_type;                 // peer address type
     uint8_t  transport;                 // peer connected transport
     uint8_t  peer_addr[BD_ADDR_LEN];    // Peer BD Address
+    uint16_t notify_handle;             // slave: handle of the notify characteristic value
+    uint16_t cccd_handle;               // slave: handle of its client configuration descriptor
+    uint8_t  cccd_state;                // slave: HELLO_CLIENT_CCCD_xx
+    hello_client_peer_stats_t stats;    // slave: data received
 } hello_client_peer_info_t;
 
+/* Device waiting for a connection attempt */
+typedef struct
+{
+    BD_ADDR                     bd_addr;            // Peer BD Address
+    wiced_bt_ble_address_type_t addr_type;          // peer address type
+} hello_client_pending_dev_t;
+
+/* Connection manager, connects the found sensors one at a time */
+typedef struct
+{
+    hello_client_pending_dev_t  dev[HELLO_CLIENT_MAX_PENDING];  // found devices, next attempt first
+    uint8_t                     count;                          // number of devices waiting
+    wiced_bool_t                connecting;                     // a connection attempt is running
+    hello_client_pending_dev_t  target;                         // device of the running attempt
+} hello_client_conn_mgr_t;
+
+/* Relay of the slave data to the master, several values packed in each notification */
+typedef struct
+{
+    wiced_bool_t    enabled;                                // relay instead of forwarding each value
+    wiced_bool_t    congested;                              // the link to the master has no room
+    wiced_bool_t    indication_pending;                     // waiting for the confirmation of the master
+    uint16_t        flush_ms;                               // longest wait for a fuller notification
+    uint16_t        mtu;                                    // ATT MTU of the master connection
+    uint16_t        len;                                    // bytes queued
+    uint32_t        relayed;                                // records sent to the master
+    uint32_t        packets;                                // notifications or indications sent
+    uint32_t        dropped;                                // records dropped, queue full or longer than the MTU
+    uint8_t         queue[HELLO_CLIENT_RELAY_QUEUE_SIZE];   // records, oldest first
+} hello_client_relay_t;
+
 /* Host information to be stored in NVRAM */
 typedef struct
 {
@@ -193,6 +294,11 @@ typedef struct
     uint8_t                  battery_level;                           // dummy battery level
     hclient_host_info_t      host_info;                               // NVRAM save area
     hello_client_peer_info_t peer_info[HELLO_CLIENT_MAX_CONNECTIONS]; // Peer Info
+    uint8_t                  peer_by_conn_id[HELLO_CLIENT_PEER_HASH_SIZE]; // peer_info index + 1 by conn_id hash, 0 if empty
+    uint8_t                  peer_by_addr[HELLO_CLIENT_PEER_HASH_SIZE];    // peer_info index + 1 by BD address hash, 0 if empty
+    hello_client_conn_mgr_t  conn_mgr;                                // Slave connection manager
+    uint8_t                  seq_offset;                              // offset of the sequence byte in the slave data
+    hello_client_relay_t     relay;                                   // slave data waiting for the master
 } hello_client_app_t;
 
 /******************************************************************************
@@ -307,6 +413,12 @@ const gatt_attribute_t hello_client_gattdb_attributes[] =
     { HANDLE_HCLIENT_DEV_INFO_SERVICE_CHAR_SYSTEM_ID_VAL, sizeof(hello_client_char_system_id_value), hello_client_char_system_id_value },
 };
 
+/* Handle index of hello_client_gattdb_attributes */
+gatt_attr_index_t hello_client_attr_index;
+uint8_t           hello_client_attr_slots[GATT_ATTR_INDEX_SLOTS( HANDLE_HCLIENT_GAP_SERVICE_CHAR_DEV_NAME_VAL, HANDLE_HCLIENT_BATTERY_SERVICE_CHAR_LEVEL_VAL )];
+
+static uint32_t hello_client_proc_rx_cmd( uint8_t *p_buffer, uint32_t length );
+
 /* transport configuration */
 const wiced_transport_cfg_t  transport_cfg =
 {
@@ -325,7 +437,7 @@ const wiced_transport_cfg_t  transport_cfg =
         .buffer_count = 0
     },
     .p_status_handler = NULL,
-    .p_data_handler = NULL,
+    .p_data_handler = hello_client_proc_rx_cmd,
     .p_tx_complete_cback = NULL
 };
 
@@ -336,18 +448,21 @@ const wiced_transport_cfg_t  transport_cfg =
 const uint8_t hello_service[16] = {UUID_HELLO_SERVICE};
 
 /* Variable to indicate if the scan has to be started.
- * Set to 1 if the user pushes and holds the button for more than 5 seconds */
+ * Set to 1 if the user pushes and holds the button for more than 5 seconds
+ * or a slave drops, the scan then runs until all slaves are connected */
 uint8_t start_scan = 0;
 
-#ifdef CYW43012C0
-/* Application buffer pool. */
-wiced_bt_buffer_pool_t*        p_hello_client_buffer_pool;
-#endif
+/* GATT client operations queued to the slaves */
+gatt_client_conn_t hello_client_gatt_conns[HELLO_CLIENT_MAX_SLAVES];
 
 extern const wiced_bt_cfg_settings_t wiced_bt_cfg_settings;
 extern const wiced_bt_cfg_buf_pool_t wiced_bt_cfg_buf_pools[];
 
 wiced_timer_t hello_client_second_timer;
+wiced_timer_t hello_client_connect_timer;
+wiced_timer_t hello_client_relay_timer;
+scan_filter_t hello_client_scan_filter;
+bond_store_t  hello_client_bond_store;
 
 /******************************************************************************
  *                          Function Definitions
@@ -365,6 +480,7 @@ static void                     hello_client_set_advertisement_data( void );
 static void                     hello_client_interrupt_handler(void* user_data, uint8_t value );
 static void                     hello_client_app_timer( uint32_t arg );
 static void                     hello_client_scan_result_cback( wiced_bt_ble_scan_results_t *p_scan_result, uint8_t *p_adv_data );
+static wiced_bool_t             hello_client_scan_match( wiced_bt_ble_scan_results_t *p_scan_result, uint8_t *p_adv_data );
 static void                     hello_client_smp_bond_result( BD_ADDR bda, uint8_t result );
 static void                     hello_client_encryption_changed( wiced_result_t result, uint8_t* p_bd_addr );
 static void                     hello_client_add_peer_info( uint16_t conn_id, uint8_t* p_bd_addr, uint8_t role , uint8_t transport, uint8_t address_type );
@@ -373,12 +489,26 @@ static hello_client_peer_info_t *hello_client_get_peer_information( uint16_t con
 static wiced_bool_t             hello_client_save_link_keys( wiced_bt_device_link_keys_t *p_keys);
 static wiced_bool_t             hello_client_read_link_keys( wiced_bt_device_link_keys_t *p_keys);
 static void                     hello_client_load_keys_to_addr_resolution_db( void );
-static void                     hello_client_process_data_from_slave( int len, uint8_t *data );
-static void                     hello_client_gatt_enable_notification ( void );
+static void                     hello_client_process_data_from_slave( uint16_t conn_id, uint8_t op, int len, uint8_t *data );
+static void                     hello_client_peer_stats_update( hello_client_peer_stats_t *p_stats, uint8_t op, int len, uint8_t *data );
+static void                     hello_client_relay_queue( uint8_t source, int len, uint8_t *data );
+static void                     hello_client_relay_flush( wiced_bool_t partial );
+static void                     hello_client_relay_reset( void );
+static void                     hello_client_relay_timeout( uint32_t arg );
+static void                     hello_client_gatt_enable_notification ( hello_client_peer_info_t *p_peer_info );
+static void                     hello_client_gatt_enable_notification_all( void );
+static void                     hello_client_cccd_written( gatt_client_conn_t *p_conn, const gatt_client_op_t *p_op, const gatt_client_result_t *p_result );
 static const gatt_attribute_t*  hello_client_get_attribute(uint16_t handle);
 static wiced_bool_t             hello_client_is_device_bonded( wiced_bt_device_address_t bd_address );
 static int                      hello_client_get_num_slaves(void);
 static int                      hello_client_is_master( BD_ADDR bda );
+static void                     hello_client_conn_mgr_add( BD_ADDR bda, wiced_bt_ble_address_type_t addr_type, wiced_bool_t first );
+static void                     hello_client_conn_mgr_next( void );
+static void                     hello_client_conn_mgr_done( void );
+static void                     hello_client_conn_mgr_scan( void );
+static void                     hello_client_connect_timeout( uint32_t arg );
+static hello_client_peer_info_t *hello_client_get_peer_by_addr( BD_ADDR bda );
+static void                     hello_client_peer_index_rebuild( void );
 
 /*
  *  Entry point to the application. Set device configuration and start BT
@@ -565,12 +695,15 @@ void hello_client_app_init( void )
     WICED_BT_TRACE( "hello_client_app_init\n" );
 
     memset( &g_hello_client, 0, sizeof( g_hello_client ) );
+    g_hello_client.seq_offset = HELLO_CLIENT_SEQ_OFFSET_NONE;
+    g_hello_client.relay.flush_ms = HELLO_CLIENT_RELAY_FLUSH_MS;
+    g_hello_client.relay.mtu = GATT_DEF_BLE_MTU_SIZE;
+#ifdef HELLO_CLIENT_RELAY
+    g_hello_client.relay.enabled = WICED_TRUE;
+#endif
+    scan_filter_init( &hello_client_scan_filter, hello_client_scan_match );
 
-#ifdef CYW43012C0
-    p_hello_client_buffer_pool = wiced_bt_create_pool( 64, 5 );
-    if (p_hello_client_buffer_pool == NULL)
-        WICED_BT_TRACE("Err: wiced_bt_create_pool failed\n");
-#endif // CYW43012C0
+    gatt_client_init( hello_client_gatt_conns, HELLO_CLIENT_MAX_SLAVES );
 
 #ifdef CYW20706A2
     /* initialize common Bluetooth application logic */
@@ -592,6 +725,7 @@ void hello_client_app_init( void )
     {
         g_hello_client.peer_info[index].conn_id = 0;
     }
+    hello_client_peer_index_rebuild( );
 
     /* Register with stack to receive GATT related events */
     gatt_status = wiced_bt_gatt_register( hello_client_gatt_callback );
@@ -603,6 +737,9 @@ void hello_client_app_init( void )
 
     WICED_BT_TRACE( "wiced_bt_gatt_db_init %d \n", gatt_status );
 
+    GATT_ATTR_INDEX_INIT( &hello_client_attr_index, hello_client_gattdb_attributes,
+            sizeof( hello_client_gattdb_attributes ) / sizeof( hello_client_gattdb_attributes[0] ), hello_client_attr_slots );
+
 #ifdef ENABLE_HCI_TRACE
     /* Register callback for receiving hci traces */
     wiced_bt_dev_register_hci_trace( hello_client_hci_trace_cback );
@@ -612,6 +749,7 @@ void hello_client_app_init( void )
     wiced_bt_set_pairable_mode(WICED_TRUE, 0);
 
     /* Load the address resolution DB with the keys stored in the NVRAM */
+    bond_store_init( &hello_client_bond_store, HELLO_CLIENT_BOND_STORE_VS_ID, BOND_STORE_MAX_DEVICES );
     hello_client_load_keys_to_addr_resolution_db();
 
     /* Set the advertising data and make the device discoverable */
@@ -626,6 +764,8 @@ void hello_client_app_init( void )
     {
         wiced_start_timer( &hello_client_second_timer, HCLIENT_APP_TIMEOUT_IN_SECONDS );
     }
+    wiced_init_timer( &hello_client_connect_timer, hello_client_connect_timeout, 0, WICED_SECONDS_TIMER );
+    wiced_init_timer( &hello_client_relay_timer, hello_client_relay_timeout, 0, WICED_MILLI_SECONDS_TIMER );
     UNUSED_VARIABLE(result);
     UNUSED_VARIABLE(gatt_status);
 }
@@ -639,6 +779,12 @@ wiced_bt_gatt_status_t hello_client_gatt_callback( wiced_bt_gatt_evt_t event, wi
 
     WICED_BT_TRACE( "hello_client_gatt_callback event %d \n", event );
 
+    // Completions of the operations queued to the slaves
+    if ( gatt_client_event_handler( event, p_data ) )
+    {
+        return WICED_BT_GATT_SUCCESS;
+    }
+
     switch( event )
     {
         case GATT_CONNECTION_STATUS_EVT:
@@ -660,6 +806,18 @@ wiced_bt_gatt_status_t hello_client_gatt_callback( wiced_bt_gatt_evt_t event, wi
             result = hello_client_gatt_req_cb( &p_data->attribute_request );
             break;
 
+        case GATT_CONGESTION_EVT:
+            // relayed data waits for the link to the master to have room again
+            if ( p_data->congestion.conn_id == g_hello_client.master_conn_id )
+            {
+                g_hello_client.relay.congested = p_data->congestion.congested;
+                if ( !p_data->congestion.congested )
+                {
+                    hello_client_relay_flush( WICED_TRUE );
+                }
+            }
+            break;
+
         default:
             break;
     }
@@ -696,13 +854,22 @@ wiced_bt_gatt_status_t hello_client_gatt_connection_up( wiced_bt_gatt_connection
     if ( dev_role == HCI_ROLE_MASTER )
     {
         g_hello_client.conn_id = p_conn_status->conn_id;
+        conn_timing_connected( p_conn_status->bd_addr, hello_client_is_device_bonded( p_conn_status->bd_addr ) );
+        if ( gatt_client_conn_up( p_conn_status->conn_id, p_conn_status->bd_addr ) == NULL )
+        {
+            WICED_BT_TRACE( "no GATT client entry for conn_id:%d\n", p_conn_status->conn_id );
+        }
         /* Configure to receive notification from server */
-        hello_client_gatt_enable_notification( );
+        hello_client_gatt_enable_notification( hello_client_get_peer_information( p_conn_status->conn_id ) );
+
+        /* Attempt finished, go on with the next found device */
+        hello_client_conn_mgr_done( );
     }
     else // Connected as slave
     {
         // Update the connection handle to the master
         g_hello_client.master_conn_id = p_conn_status->conn_id;
+        hello_client_relay_reset( );
 
         // Stop the advertisement
         status =  wiced_bt_start_advertisements( BTM_BLE_ADVERT_OFF, 0, NULL );
@@ -715,37 +882,57 @@ wiced_bt_gatt_status_t hello_client_gatt_connection_up( wiced_bt_gatt_connection
 /* This function will be called when connection goes down */
 wiced_bt_gatt_status_t hello_client_gatt_connection_down( wiced_bt_gatt_connection_status_t *p_conn_status )
 {
-    wiced_result_t status;
+    wiced_result_t              status;
+    hello_client_peer_info_t    *p_peer_info;
+
+    /* A failed connection attempt has no connection id and no peer info */
+    p_peer_info = hello_client_get_peer_information( p_conn_status->conn_id );
 
-    WICED_BT_TRACE( "hello_client_connection_down %d <%B>\n", g_hello_client.num_connections, p_conn_status->bd_addr );
+    WICED_BT_TRACE( "hello_client_connection_down %d <%B> reason:%d\n", g_hello_client.num_connections, p_conn_status->bd_addr, p_conn_status->reason );
 
     /* Check if the device is there in the peer info table */
-    if ( ( g_hello_client.num_connections ) && hello_client_get_peer_information( p_conn_status->conn_id ) )
+    if ( ( g_hello_client.num_connections ) && ( p_peer_info != NULL ) )
     {
         // Decrement the number of  connections
         g_hello_client.num_connections--;
+
+        // A slave dropped without us asking for it, connect it again as soon as it is found
+        if ( ( p_peer_info->role == HCI_ROLE_MASTER ) && ( p_conn_status->reason != HCI_ERR_CONN_CAUSE_LOCAL_HOST ) )
+        {
+            hello_client_conn_mgr_add( p_peer_info->peer_addr, p_peer_info->addr_type, WICED_TRUE );
+            start_scan = 1;
+        }
+    }
+    else if ( g_hello_client.conn_mgr.connecting &&
+              ( memcmp( p_conn_status->bd_addr, g_hello_client.conn_mgr.target.bd_addr, BD_ADDR_LEN ) == 0 ) )
+    {
+        // The connection attempt failed
+        WICED_BT_TRACE( "connect to <%B> failed\n", p_conn_status->bd_addr );
+        hello_client_conn_mgr_done( );
     }
 
     if ( p_conn_status->link_role == HCI_ROLE_SLAVE )
     {
         //Resetting the connection handle to the master
         g_hello_client.master_conn_id = 0;
+        hello_client_relay_reset( );
     }
 
-    //Remove the peer info
+    //Remove the peer info, the GATT client core dropped the operations queued
     hello_client_remove_peer_info( p_conn_status->conn_id );
 
      /*  Start the inquiry to search for other available slaves */
     if ( g_hello_client.num_connections < HELLO_CLIENT_MAX_CONNECTIONS )
     {
-        uint8_t num_slaves = hello_client_get_num_slaves( );
-
         if ( g_hello_client.master_conn_id == 0 )
         {
             // Start the advertisement to enable slave connection
             status =  wiced_bt_start_advertisements( BTM_BLE_ADVERT_UNDIRECTED_HIGH, 0, NULL );
             WICED_BT_TRACE( "wiced_bt_start_advertisements: %d\n", status );
         }
+
+        hello_client_conn_mgr_next( );
+        hello_client_conn_mgr_scan( );
     }
     UNUSED_VARIABLE(status);
     return WICED_BT_GATT_SUCCESS;
@@ -756,10 +943,6 @@ wiced_bt_gatt_status_t hello_client_gatt_connection_down( wiced_bt_gatt_connecti
  */
 wiced_bt_gatt_status_t hello_client_gatt_op_comp_cb( wiced_bt_gatt_operation_complete_t *p_data )
 {
-    wiced_result_t              status;
-    hello_client_peer_info_t    *p_peer_info = NULL;
-    wiced_bt_ble_sec_action_type_t  encryption_type = BTM_BLE_SEC_ENCRYPT;
-
     WICED_BT_TRACE("hello_client_gatt_op_comp_cb conn %d op %d st %d\n", p_data->conn_id, p_data->op, p_data->status );
 
     switch ( p_data->op )
@@ -770,25 +953,6 @@ wiced_bt_gatt_status_t hello_client_gatt_op_comp_cb( wiced_bt_gatt_operation_com
 
     case GATTC_OPTYPE_WRITE:
         WICED_BT_TRACE( "write_rsp status:%d\n", p_data->status );
-
-        /* server puts authentication requirement. Encrypt the link */
-        if( ( p_data->status == WICED_BT_GATT_INSUF_AUTHENTICATION ) && ( p_data->response_data.handle == HANDLE_HSENS_SERVICE_CHAR_CFG_DESC ) )
-        {
-            if ( ( p_peer_info = hello_client_get_peer_information( p_data->conn_id ) ) != NULL )
-            {
-                if ( hello_client_is_device_bonded(p_peer_info->peer_addr) )
-                {
-                    status = wiced_bt_dev_set_encryption( p_peer_info->peer_addr, p_peer_info->transport, &encryption_type );
-                    WICED_BT_TRACE( "wiced_bt_dev_set_encryption %d \n", status );
-                }
-                else
-                {
-                    status = wiced_bt_dev_sec_bond( p_peer_info->peer_addr, p_peer_info->addr_type,
-                                                        p_peer_info->transport,0, NULL );
-                    WICED_BT_TRACE( "wiced_bt_dev_sec_bond %d \n", status );
-                }
-            }
-        }
         break;
 
     case GATTC_OPTYPE_CONFIG:
@@ -796,28 +960,43 @@ wiced_bt_gatt_status_t hello_client_gatt_op_comp_cb( wiced_bt_gatt_operation_com
         break;
 
     case GATTC_OPTYPE_NOTIFICATION:
-        hello_client_process_data_from_slave( p_data->response_data.att_value.len, p_data->response_data.att_value.p_data );
+        hello_client_process_data_from_slave( p_data->conn_id, p_data->op, p_data->response_data.att_value.len, p_data->response_data.att_value.p_data );
         break;
 
     case GATTC_OPTYPE_INDICATION:
-        hello_client_process_data_from_slave( p_data->response_data.att_value.len, p_data->response_data.att_value.p_data );
+        hello_client_process_data_from_slave( p_data->conn_id, p_data->op, p_data->response_data.att_value.len, p_data->response_data.att_value.p_data );
         wiced_bt_gatt_send_indication_confirm( p_data->conn_id, p_data->response_data.handle );
         break;
     }
-    UNUSED_VARIABLE(status);
     return WICED_BT_GATT_SUCCESS;
 }
 
 /*
  * This function handles notification/indication data received fromt the slave device
  */
-void hello_client_process_data_from_slave( int len, uint8_t *data )
+void hello_client_process_data_from_slave( uint16_t conn_id, uint8_t op, int len, uint8_t *data )
 {
-    WICED_BT_TRACE("hello_client_process_data_from_slave len:%d master conn_id:%d ccc:%d\n",
-            len, g_hello_client.master_conn_id, g_hello_client.host_info.characteristic_client_configuration );
+    hello_client_peer_info_t *p_peer_info = hello_client_get_peer_information( conn_id );
+
+    WICED_BT_TRACE("hello_client_process_data_from_slave conn_id:%d len:%d master conn_id:%d ccc:%d\n",
+            conn_id, len, g_hello_client.master_conn_id, g_hello_client.host_info.characteristic_client_configuration );
 
+    if ( p_peer_info != NULL )
+    {
+        hello_client_peer_stats_update( &p_peer_info->stats, op, len, data );
+    }
+
+    // in relay mode the data waits in the queue, to share a notification with the data of the other slaves
+    if ( g_hello_client.relay.enabled )
+    {
+        if ( ( p_peer_info != NULL ) && ( g_hello_client.master_conn_id != 0 ) &&
+             ( g_hello_client.host_info.characteristic_client_configuration != 0 ) )
+        {
+            hello_client_relay_queue( p_peer_info - g_hello_client.peer_info, len, data );
+        }
+    }
     // if master allows notifications, forward received data from the slave
-    if ( ( g_hello_client.host_info.characteristic_client_configuration & GATT_CLIENT_CONFIG_NOTIFICATION ) != 0 )
+    else if ( ( g_hello_client.host_info.characteristic_client_configuration & GATT_CLIENT_CONFIG_NOTIFICATION ) != 0 )
     {
         wiced_bt_gatt_send_notification( g_hello_client.master_conn_id, HANDLE_HELLO_CLIENT_SERVICE_CHAR_NOTIFY_VAL, len, data );
     }
@@ -827,6 +1006,181 @@ void hello_client_process_data_from_slave( int len, uint8_t *data )
     }
 }
 
+/*
+ * Account data received from a slave.  Gaps are found from the sequence
+ * byte, if the slaves have one, and the time since the previous arrival
+ * goes to a log2 histogram in milliseconds.
+ */
+void hello_client_peer_stats_update( hello_client_peer_stats_t *p_stats, uint8_t op, int len, uint8_t *data )
+{
+    uint32_t now_us = (uint32_t)clock_SystemTimeMicroseconds64( );
+    uint32_t delta_ms;
+    uint8_t  bucket = 0;
+    uint8_t  seq_delta;
+
+    if ( op == GATTC_OPTYPE_NOTIFICATION )
+    {
+        p_stats->notifications++;
+    }
+    else
+    {
+        p_stats->indications++;
+    }
+    p_stats->bytes += len;
+
+    if ( p_stats->has_rx )
+    {
+        delta_ms = ( now_us - p_stats->last_rx_us ) / 1000;
+        while ( ( delta_ms != 0 ) && ( bucket < HELLO_CLIENT_HIST_BUCKETS - 1 ) )
+        {
+            delta_ms >>= 1;
+            bucket++;
+        }
+        p_stats->hist[bucket]++;
+    }
+    p_stats->last_rx_us = now_us;
+
+    if ( g_hello_client.seq_offset < len )
+    {
+        // a repeated sequence byte is not a gap
+        seq_delta = data[g_hello_client.seq_offset] - p_stats->last_seq;
+        if ( p_stats->has_rx && ( seq_delta > 1 ) )
+        {
+            p_stats->gaps += seq_delta - 1;
+        }
+        p_stats->last_seq = data[g_hello_client.seq_offset];
+    }
+    p_stats->has_rx = WICED_TRUE;
+}
+
+/*
+ * Queue the data of a slave for the master, as a record with the index of
+ * the slave and the length of the data.  A record that does not fit is
+ * dropped, the queue does not grow while the link to the master is
+ * congested.  A notification is sent as soon as the records fill one,
+ * otherwise after the flush delay.
+ */
+void hello_client_relay_queue( uint8_t source, int len, uint8_t *data )
+{
+    hello_client_relay_t *p_relay = &g_hello_client.relay;
+    uint8_t              *p;
+
+    if ( ( len > 0xff ) ||
+         ( HELLO_CLIENT_RELAY_RECORD_HDR_LEN + len > p_relay->mtu - 3 ) ||
+         ( p_relay->len + HELLO_CLIENT_RELAY_RECORD_HDR_LEN + len > sizeof( p_relay->queue ) ) )
+    {
+        p_relay->dropped++;
+        return;
+    }
+
+    p = &p_relay->queue[p_relay->len];
+    *p++ = source;
+    *p++ = (uint8_t)len;
+    memcpy( p, data, len );
+    p_relay->len += HELLO_CLIENT_RELAY_RECORD_HDR_LEN + len;
+
+    hello_client_relay_flush( WICED_FALSE );
+}
+
+/*
+ * Send the queued records to the master, as many whole records in each
+ * notification as its MTU allows.  With partial WICED_FALSE only full
+ * notifications are sent, the rest waits for more data or the flush delay.
+ * Sending stops while the link is congested or an indication waits for
+ * its confirmation.
+ */
+void hello_client_relay_flush( wiced_bool_t partial )
+{
+    hello_client_relay_t   *p_relay = &g_hello_client.relay;
+    uint16_t               cccd     = g_hello_client.host_info.characteristic_client_configuration;
+    uint16_t               payload  = p_relay->mtu - 3;
+    uint16_t               len;
+    uint8_t                records;
+    wiced_bt_gatt_status_t status;
+
+    while ( ( p_relay->len != 0 ) && !p_relay->congested && !p_relay->indication_pending &&
+            ( g_hello_client.master_conn_id != 0 ) && ( cccd != 0 ) )
+    {
+        len     = 0;
+        records = 0;
+        while ( ( len < p_relay->len ) &&
+                ( len + HELLO_CLIENT_RELAY_RECORD_HDR_LEN + p_relay->queue[len + 1] <= payload ) )
+        {
+            len += HELLO_CLIENT_RELAY_RECORD_HDR_LEN + p_relay->queue[len + 1];
+            records++;
+        }
+
+        // all the records fit in one notification, there is room for more
+        if ( !partial && ( len == p_relay->len ) )
+        {
+            break;
+        }
+        if ( records == 0 )
+        {
+            // longer than the MTU, only if the master changed under the record
+            p_relay->dropped++;
+            p_relay->len -= HELLO_CLIENT_RELAY_RECORD_HDR_LEN + p_relay->queue[1];
+            memmove( p_relay->queue, &p_relay->queue[HELLO_CLIENT_RELAY_RECORD_HDR_LEN + p_relay->queue[1]], p_relay->len );
+            continue;
+        }
+
+        if ( ( cccd & GATT_CLIENT_CONFIG_NOTIFICATION ) != 0 )
+        {
+            status = wiced_bt_gatt_send_notification( g_hello_client.master_conn_id, HANDLE_HELLO_CLIENT_SERVICE_CHAR_NOTIFY_VAL, len, p_relay->queue );
+        }
+        else
+        {
+            status = wiced_bt_gatt_send_indication( g_hello_client.master_conn_id, HANDLE_HELLO_CLIENT_SERVICE_CHAR_NOTIFY_VAL, len, p_relay->queue );
+            p_relay->indication_pending = ( status == WICED_BT_GATT_SUCCESS );
+        }
+
+        if ( status != WICED_BT_GATT_SUCCESS )
+        {
+            // the records stay queued until the end of the congestion, or the next flush
+            WICED_BT_TRACE( "relay send len:%d status:%d\n", len, status );
+            p_relay->congested = ( status == WICED_BT_GATT_CONGESTED );
+            break;
+        }
+
+        p_relay->packets++;
+        p_relay->relayed += records;
+        p_relay->len     -= len;
+        memmove( p_relay->queue, &p_relay->queue[len], p_relay->len );
+    }
+
+    // what is left goes after the flush delay, or at the end of the
+    // congestion or with the confirmation of the indication
+    if ( p_relay->len == 0 )
+    {
+        wiced_stop_timer( &hello_client_relay_timer );
+    }
+    else if ( !p_relay->congested && !p_relay->indication_pending && !wiced_is_timer_in_use( &hello_client_relay_timer ) )
+    {
+        wiced_start_timer( &hello_client_relay_timer, p_relay->flush_ms );
+    }
+}
+
+/*
+ * Drop the records queued for the master, on a new connection of the master
+ * or when it is gone.  The statistics are kept.
+ */
+void hello_client_relay_reset( void )
+{
+    g_hello_client.relay.len                = 0;
+    g_hello_client.relay.congested          = WICED_FALSE;
+    g_hello_client.relay.indication_pending = WICED_FALSE;
+    g_hello_client.relay.mtu                = GATT_DEF_BLE_MTU_SIZE;
+    wiced_stop_timer( &hello_client_relay_timer );
+}
+
+/*
+ * Flush delay of the relay expired, send what is queued
+ */
+void hello_client_relay_timeout( uint32_t arg )
+{
+    hello_client_relay_flush( WICED_TRUE );
+}
+
 /*
  * Process various GATT requests received from the master
  */
@@ -848,6 +1202,18 @@ wiced_bt_gatt_status_t hello_client_gatt_req_cb( wiced_bt_gatt_attribute_request
 
         case GATTS_REQ_TYPE_MTU:
             WICED_BT_TRACE( "peer mtu:%d\n", p_data->data.mtu );
+            if ( p_data->conn_id == g_hello_client.master_conn_id )
+            {
+                g_hello_client.relay.mtu = MIN( p_data->data.mtu, wiced_bt_cfg_settings.gatt_cfg.max_mtu_size );
+            }
+            break;
+
+        case GATTS_REQ_TYPE_CONF:
+            if ( p_data->conn_id == g_hello_client.master_conn_id )
+            {
+                g_hello_client.relay.indication_pending = WICED_FALSE;
+                hello_client_relay_flush( WICED_TRUE );
+            }
             break;
 
         default:
@@ -863,8 +1229,6 @@ wiced_bt_gatt_status_t hello_client_gatt_req_cb( wiced_bt_gatt_attribute_request
 wiced_bt_gatt_status_t hello_client_gatt_read_handler( uint16_t conn_id, wiced_bt_gatt_read_t *p_read_data )
 {
     const gatt_attribute_t * puAttribute;
-    const uint8_t *          from;
-    int                      to_copy;
 
     WICED_BT_TRACE("read_hndlr conn %d hdl %x\n", conn_id, p_read_data->handle );
 
@@ -874,24 +1238,7 @@ wiced_bt_gatt_status_t hello_client_gatt_read_handler( uint16_t conn_id, wiced_b
         return WICED_BT_GATT_INVALID_HANDLE;
     }
 
-    if ( p_read_data->offset >= puAttribute->attr_len )
-    {
-        return WICED_BT_GATT_INVALID_OFFSET;
-    }
-
-    to_copy = puAttribute->attr_len - p_read_data->offset;
-
-    if ( to_copy >= *p_read_data->p_val_len )
-    {
-        to_copy = *p_read_data->p_val_len - 1;
-    }
-
-    from = ((uint8_t *)puAttribute->p_attr) + p_read_data->offset;
-    *p_read_data->p_val_len = to_copy;
-
-    memcpy( p_read_data->p_val, from, to_copy );
-
-    return WICED_BT_GATT_SUCCESS;
+    return gatt_attr_read( puAttribute->p_attr, puAttribute->attr_len, p_read_data );
 }
 
 /*
@@ -906,6 +1253,17 @@ wiced_bt_gatt_status_t hello_client_gatt_write_handler( uint16_t conn_id, wiced_
     if ( p_data->handle == HANDLE_HELLO_CLIENT_SERVICE_CHAR_CFG_DESC  )
     {
         g_hello_client.host_info.characteristic_client_configuration = p_attr[0] | ( p_attr[1] << 8 );
+
+        // The master wants the data, make sure all the slaves send it
+        if ( g_hello_client.host_info.characteristic_client_configuration != 0 )
+        {
+            hello_client_gatt_enable_notification_all( );
+        }
+        else
+        {
+            // nobody to relay to any more
+            g_hello_client.relay.len = 0;
+        }
     }
     return WICED_BT_GATT_SUCCESS;
 }
@@ -957,17 +1315,11 @@ static int hello_client_get_num_slaves(void)
 /* The function invoked on timeout of app seconds timer. */
 void hello_client_app_timer( uint32_t arg )
 {
-    wiced_result_t               status;
-
     g_hello_client.app_timer_count++;
     WICED_BT_TRACE( "%d\n", g_hello_client.app_timer_count );
 
-    if( start_scan && wiced_bt_ble_get_current_scan_state() == BTM_BLE_SCAN_TYPE_NONE )
-    {
-        status = wiced_bt_ble_scan( BTM_BLE_SCAN_TYPE_HIGH_DUTY, WICED_TRUE, hello_client_scan_result_cback );
-        WICED_BT_TRACE( "wiced_bt_ble_scan: %d\n", status );
-    }
-    UNUSED_VARIABLE(status);
+    /* Restart the scan when its duration expired */
+    hello_client_conn_mgr_scan( );
 }
 
 /*
@@ -982,8 +1334,6 @@ void hello_client_smp_bond_result( BD_ADDR bda, uint8_t result )
     /*  Start the inquiry to search for other available slaves */
     if ( g_hello_client.num_connections < HELLO_CLIENT_MAX_CONNECTIONS )
     {
-        int num_slaves = hello_client_get_num_slaves();
-
         if ( g_hello_client.master_conn_id == 0 )
         {
             // Start the advertisement to enable slave connection
@@ -991,14 +1341,7 @@ void hello_client_smp_bond_result( BD_ADDR bda, uint8_t result )
             WICED_BT_TRACE( "wiced_bt_start_advertisements: %d\n", status );
         }
 
-        if ( ( num_slaves < HELLO_CLIENT_MAX_SLAVES ) && ( start_scan ) )
-        {
-            if( wiced_bt_ble_get_current_scan_state() == BTM_BLE_SCAN_TYPE_NONE )
-            {
-                status = wiced_bt_ble_scan( BTM_BLE_SCAN_TYPE_HIGH_DUTY, WICED_TRUE, hello_client_scan_result_cback );
-                WICED_BT_TRACE( "hello_client_smp_bond_result wiced_bt_ble_scan: %d\n", status );
-            }
-        }
+        hello_client_conn_mgr_scan( );
     }
     UNUSED_VARIABLE(status);
 }
@@ -1012,6 +1355,8 @@ void hello_client_encryption_changed( wiced_result_t result, uint8_t* p_bd_addr
 {
     WICED_BT_TRACE( "hello_client_encryption_changed %d", result );
 
+    conn_timing_encrypted( p_bd_addr, ( uint8_t ) result );
+
     /* Bonding success */
     if( result == WICED_BT_SUCCESS )
     {
@@ -1020,7 +1365,7 @@ void hello_client_encryption_changed( wiced_result_t result, uint8_t* p_bd_addr
         // should be persistent across connections with bonded devices.
         if ( hello_client_is_master ( p_bd_addr) )
         {
-            hello_client_gatt_enable_notification( );
+            hello_client_gatt_enable_notification( hello_client_get_peer_by_addr( p_bd_addr ) );
         }
     }
 }
@@ -1028,7 +1373,6 @@ void hello_client_encryption_changed( wiced_result_t result, uint8_t* p_bd_addr
 /* This function is invoked on button interrupt events */
 void hello_client_interrupt_handler(void* user_data, uint8_t value )
 {
-    wiced_result_t  result;
     int             num_slaves = 0;
     static uint32_t button_pushed_time = 0;
 
@@ -1052,11 +1396,8 @@ void hello_client_interrupt_handler(void* user_data, uint8_t value )
             if ( num_slaves < HELLO_CLIENT_MAX_SLAVES )
             {
                 start_scan = 1;
-                if( wiced_bt_ble_get_current_scan_state() == BTM_BLE_SCAN_TYPE_NONE )
-                {
-                    result = wiced_bt_ble_scan( BTM_BLE_SCAN_TYPE_HIGH_DUTY, WICED_TRUE, hello_client_scan_result_cback );
-                    WICED_BT_TRACE( "\nhello_client_interrupt_handler wiced_bt_ble_scan: %d\n", result );
-                }
+                scan_filter_reset( &hello_client_scan_filter );
+                hello_client_conn_mgr_scan( );
             }
             else
             {
@@ -1075,79 +1416,323 @@ void hello_client_interrupt_handler(void* user_data, uint8_t value )
 #endif
 
 /*
- * This function handles the scan results
+ * This function handles the scan results.  The scan keeps running, found
+ * sensors are queued and connected one at a time by the connection manager.
  */
 void hello_client_scan_result_cback( wiced_bt_ble_scan_results_t *p_scan_result, uint8_t *p_adv_data )
 {
-    wiced_result_t         status;
-    wiced_bool_t           ret_status;
-    uint8_t                length;
-    uint8_t *              p_data;
-
     if ( p_scan_result )
     {
-        // Advertisement data from hello_server should have Advertisement type SERVICE_UUID_128
-        p_data = wiced_bt_ble_check_advertising_data( p_adv_data, BTM_BLE_ADVERT_TYPE_128SRV_COMPLETE, &length );
-
-        // Check if  the hello service uuid is there in the advertisement
-        if ( ( p_data == NULL ) || ( length != LEN_UUID_128 ) || ( memcmp( p_data, hello_service, LEN_UUID_128 ) != 0 ) )
+        // Repeated advertisements of a device are answered by the filter cache
+        if ( !scan_filter_check( &hello_client_scan_filter, p_scan_result, p_adv_data ) )
         {
             // wrong device
             return;
         }
 
-        WICED_BT_TRACE(" Found Device : %B \n", p_scan_result->remote_bd_addr );
-        start_scan = 0;
-        /* Stop the scan since the desired device is found */
-        status = wiced_bt_ble_scan( BTM_BLE_SCAN_TYPE_NONE, WICED_TRUE, hello_client_scan_result_cback );
+        hello_client_conn_mgr_add( p_scan_result->remote_bd_addr, p_scan_result->ble_addr_type, WICED_FALSE );
+        hello_client_conn_mgr_next( );
+    }
+    else
+    {
+        WICED_BT_TRACE( "Scan completed:\n" );
+    }
+}
 
-        WICED_BT_TRACE( "scan off status %d\n", status );
+/*
+ * Advertisement data from hello_sensor lists the hello service 128 bit uuid
+ */
+wiced_bool_t hello_client_scan_match( wiced_bt_ble_scan_results_t *p_scan_result, uint8_t *p_adv_data )
+{
+    return scan_filter_adv_has_uuid128( p_adv_data, hello_service );
+}
 
-        /* Initiate the connection */
-        ret_status = wiced_bt_gatt_le_connect( p_scan_result->remote_bd_addr, p_scan_result->ble_addr_type, BLE_CONN_MODE_HIGH_DUTY, TRUE );
+/*
+ * Queue a device for a connection attempt.  Devices already connected, queued
+ * or being connected are skipped.  A device put first (a dropped slave) pushes
+ * out the last one if the queue is full, a found device is dropped instead.
+ */
+void hello_client_conn_mgr_add( BD_ADDR bda, wiced_bt_ble_address_type_t addr_type, wiced_bool_t first )
+{
+    hello_client_conn_mgr_t *p_mgr = &g_hello_client.conn_mgr;
+    int                     index;
 
-        WICED_BT_TRACE( "wiced_bt_gatt_connect status %d\n", ret_status );
+    if ( hello_client_get_peer_by_addr( bda ) != NULL )
+    {
+        return;
+    }
+    if ( p_mgr->connecting && ( memcmp( p_mgr->target.bd_addr, bda, BD_ADDR_LEN ) == 0 ) )
+    {
+        return;
+    }
+    for ( index = 0; index < p_mgr->count; index++ )
+    {
+        if ( memcmp( p_mgr->dev[index].bd_addr, bda, BD_ADDR_LEN ) == 0 )
+        {
+            return;
+        }
+    }
+
+    if ( p_mgr->count == HELLO_CLIENT_MAX_PENDING )
+    {
+        if ( !first )
+        {
+            return;
+        }
+        p_mgr->count--;
+    }
+
+    if ( first )
+    {
+        memmove( &p_mgr->dev[1], &p_mgr->dev[0], p_mgr->count * sizeof( hello_client_pending_dev_t ) );
+        index = 0;
     }
     else
     {
-        WICED_BT_TRACE( "Scan completed:\n" );
+        index = p_mgr->count;
+    }
+    memcpy( p_mgr->dev[index].bd_addr, bda, BD_ADDR_LEN );
+    p_mgr->dev[index].addr_type = addr_type;
+    p_mgr->count++;
+
+    WICED_BT_TRACE( " Found Device : %B queued:%d\n", bda, p_mgr->count );
+}
+
+/*
+ * Start a connection attempt to the next queued device, unless one is running
+ * or all slaves are connected.  The scan is stopped for the attempt and
+ * restarted when it finishes, so an attempt never holds it off for more
+ * than HELLO_CLIENT_CONNECT_TIMEOUT_IN_SECONDS.  If no attempt could be
+ * started the scan is restarted right away.
+ */
+void hello_client_conn_mgr_next( void )
+{
+    hello_client_conn_mgr_t *p_mgr = &g_hello_client.conn_mgr;
+    wiced_bool_t            ret_status;
+    wiced_bool_t            scan_stopped = WICED_FALSE;
+    wiced_result_t          status;
+
+    while ( !p_mgr->connecting && ( p_mgr->count != 0 ) && ( hello_client_get_num_slaves( ) < HELLO_CLIENT_MAX_SLAVES ) )
+    {
+        p_mgr->target = p_mgr->dev[0];
+        p_mgr->count--;
+        memmove( &p_mgr->dev[0], &p_mgr->dev[1], p_mgr->count * sizeof( hello_client_pending_dev_t ) );
+
+        if ( wiced_bt_ble_get_current_scan_state() != BTM_BLE_SCAN_TYPE_NONE )
+        {
+            status = wiced_bt_ble_scan( BTM_BLE_SCAN_TYPE_NONE, WICED_TRUE, hello_client_scan_result_cback );
+            WICED_BT_TRACE( "scan off status %d\n", status );
+            scan_stopped = WICED_TRUE;
+        }
+
+        /* Initiate the connection */
+        ret_status = wiced_bt_gatt_le_connect( p_mgr->target.bd_addr, p_mgr->target.addr_type, BLE_CONN_MODE_HIGH_DUTY, TRUE );
+        WICED_BT_TRACE( "wiced_bt_gatt_connect <%B> status %d\n", p_mgr->target.bd_addr, ret_status );
+
+        if ( ret_status )
+        {
+            conn_timing_connect_start( p_mgr->target.bd_addr );
+            p_mgr->connecting = WICED_TRUE;
+            wiced_start_timer( &hello_client_connect_timer, HELLO_CLIENT_CONNECT_TIMEOUT_IN_SECONDS );
+        }
+    }
+
+    // Every connect failed, nothing will call hello_client_conn_mgr_done() to resume the scan
+    if ( scan_stopped && !p_mgr->connecting )
+    {
+        hello_client_conn_mgr_scan( );
     }
-    UNUSED_VARIABLE(ret_status);
     UNUSED_VARIABLE(status);
 }
 
+/*
+ * The running connection attempt finished, successfully or not.  Go on with
+ * the next device and resume the scan.
+ */
+void hello_client_conn_mgr_done( void )
+{
+    if ( !g_hello_client.conn_mgr.connecting )
+    {
+        return;
+    }
+
+    g_hello_client.conn_mgr.connecting = WICED_FALSE;
+    wiced_stop_timer( &hello_client_connect_timer );
+
+    hello_client_conn_mgr_next( );
+    hello_client_conn_mgr_scan( );
+}
+
+/*
+ * Keep the scan running while the user asked for slaves and there is room
+ * for one more.  Stop it once all slaves are connected.
+ */
+void hello_client_conn_mgr_scan( void )
+{
+    wiced_result_t status;
+
+    if ( hello_client_get_num_slaves( ) >= HELLO_CLIENT_MAX_SLAVES )
+    {
+        start_scan = 0;
+        if ( wiced_bt_ble_get_current_scan_state() != BTM_BLE_SCAN_TYPE_NONE )
+        {
+            status = wiced_bt_ble_scan( BTM_BLE_SCAN_TYPE_NONE, WICED_TRUE, hello_client_scan_result_cback );
+            WICED_BT_TRACE( "all slaves connected, scan off status %d\n", status );
+        }
+        return;
+    }
+
+    if ( start_scan && !g_hello_client.conn_mgr.connecting && ( wiced_bt_ble_get_current_scan_state() == BTM_BLE_SCAN_TYPE_NONE ) )
+    {
+        conn_timing_scan_start( );
+        status = wiced_bt_ble_scan( BTM_BLE_SCAN_TYPE_HIGH_DUTY, WICED_TRUE, hello_client_scan_result_cback );
+        WICED_BT_TRACE( "wiced_bt_ble_scan: %d\n", status );
+    }
+    UNUSED_VARIABLE(status);
+}
+
+/*
+ * The function invoked when a connection attempt takes too long.  The device
+ * is given up, it is queued again the next time the scan finds it.
+ */
+void hello_client_connect_timeout( uint32_t arg )
+{
+    WICED_BT_TRACE( "connect to <%B> timed out\n", g_hello_client.conn_mgr.target.bd_addr );
+
+    wiced_bt_gatt_cancel_connect( g_hello_client.conn_mgr.target.bd_addr, WICED_TRUE );
+    hello_client_conn_mgr_done( );
+}
+
 /*
  * This function writes into peer's client configuration descriptor to enable notifications
  */
-void hello_client_gatt_enable_notification ( void )
+void hello_client_gatt_enable_notification ( hello_client_peer_info_t *p_peer_info )
 {
     wiced_bt_gatt_status_t status;
-    uint16_t               u16 = GATT_CLIENT_CONFIG_NOTIFICATION;
 
-    // Allocating a buffer to send the write request
-#ifdef CYW43012C0
-    wiced_bt_gatt_value_t *p_write = ( wiced_bt_gatt_value_t* )wiced_bt_get_buffer_from_pool( p_hello_client_buffer_pool );
-#else
-    wiced_bt_gatt_value_t *p_write = ( wiced_bt_gatt_value_t* )wiced_bt_get_buffer( sizeof( wiced_bt_gatt_value_t ) + 1 );
-#endif
+    if ( ( p_peer_info == NULL ) || ( p_peer_info->cccd_state == HELLO_CLIENT_CCCD_PENDING ) )
+    {
+        return;
+    }
+
+    // Register with the server to receive notification, the core sends the write when the connection is idle
+    status = gatt_client_write_cccd( gatt_client_conn_find( p_peer_info->conn_id ), p_peer_info->cccd_handle,
+                                     GATT_CLIENT_CONFIG_NOTIFICATION, hello_client_cccd_written, NULL );
+    WICED_BT_TRACE( "gatt_client_write_cccd conn_id:%d status:%d\n", p_peer_info->conn_id, status );
+
+    p_peer_info->cccd_state = ( status == WICED_BT_GATT_SUCCESS ) ? HELLO_CLIENT_CCCD_PENDING : HELLO_CLIENT_CCCD_DISABLED;
+}
+
+/*
+ * Enable notifications on all the connected slaves that do not have them yet
+ */
+void hello_client_gatt_enable_notification_all( void )
+{
+    int index;
 
-    if ( p_write )
+    for ( index = 0; index < HELLO_CLIENT_MAX_CONNECTIONS; index++ )
     {
-        p_write->handle   = HANDLE_HSENS_SERVICE_CHAR_CFG_DESC; /* hard coded server ccd */
-        p_write->offset   = 0;
-        p_write->len      = 2;
-        p_write->auth_req = GATT_AUTH_REQ_NONE;
-        p_write->value[0] = u16 & 0xff;
-        p_write->value[1] = (u16 >> 8) & 0xff;
+        if ( ( g_hello_client.peer_info[index].conn_id != 0 ) &&
+             ( g_hello_client.peer_info[index].role == HCI_ROLE_MASTER ) &&
+             ( g_hello_client.peer_info[index].cccd_state == HELLO_CLIENT_CCCD_DISABLED ) )
+        {
+            hello_client_gatt_enable_notification( &g_hello_client.peer_info[index] );
+        }
+    }
+}
 
-        // Register with the server to receive notification
-        status = wiced_bt_gatt_send_write ( g_hello_client.conn_id, GATT_WRITE, p_write );
+/*
+ * The write of the client configuration descriptor of a slave is over
+ */
+void hello_client_cccd_written( gatt_client_conn_t *p_conn, const gatt_client_op_t *p_op, const gatt_client_result_t *p_result )
+{
+    hello_client_peer_info_t        *p_peer_info = hello_client_get_peer_information( p_conn->conn_id );
+    wiced_bt_ble_sec_action_type_t  encryption_type = BTM_BLE_SEC_ENCRYPT;
+    wiced_result_t                  status;
 
-        WICED_BT_TRACE("wiced_bt_gatt_send_write \n", status);
+    WICED_BT_TRACE( "cccd write conn_id:%d status:%d\n", p_conn->conn_id, p_result->status );
 
-        wiced_bt_free_buffer( p_write );
+    if ( p_peer_info == NULL )
+    {
+        return;
+    }
+    p_peer_info->cccd_state = ( p_result->status == WICED_BT_GATT_SUCCESS ) ? HELLO_CLIENT_CCCD_ENABLED : HELLO_CLIENT_CCCD_DISABLED;
+
+    /* server puts authentication requirement. Encrypt the link */
+    if ( p_result->status == WICED_BT_GATT_INSUF_AUTHENTICATION )
+    {
+        if ( hello_client_is_device_bonded( p_peer_info->peer_addr ) )
+        {
+            status = wiced_bt_dev_set_encryption( p_peer_info->peer_addr, p_peer_info->transport, &encryption_type );
+            WICED_BT_TRACE( "wiced_bt_dev_set_encryption %d \n", status );
+        }
+        else
+        {
+            status = wiced_bt_dev_sec_bond( p_peer_info->peer_addr, p_peer_info->addr_type,
+                                                p_peer_info->transport,0, NULL );
+            WICED_BT_TRACE( "wiced_bt_dev_sec_bond %d \n", status );
+        }
+        UNUSED_VARIABLE(status);
+    }
+}
+
+/*
+ * Hash of a connection id for the peer table index
+ */
+static uint8_t hello_client_conn_id_hash( uint16_t conn_id )
+{
+    return ( conn_id ^ ( conn_id >> 8 ) ) & ( HELLO_CLIENT_PEER_HASH_SIZE - 1 );
+}
+
+/*
+ * Hash of a BD address for the peer table index
+ */
+static uint8_t hello_client_addr_hash( const uint8_t *p_bd_addr )
+{
+    uint8_t hash = 0;
+    int     i;
+
+    for ( i = 0; i < BD_ADDR_LEN; i++ )
+    {
+        hash = ( hash * 31 ) + p_bd_addr[i];
+    }
+    return hash & ( HELLO_CLIENT_PEER_HASH_SIZE - 1 );
+}
+
+/*
+ * Rebuild the conn_id and BD address indexes of the peer table.  Peers come
+ * and go rarely compared to the lookups, so the indexes are rebuilt instead
+ * of supporting deletion in the open addressing tables.
+ */
+void hello_client_peer_index_rebuild( void )
+{
+    uint8_t slot;
+    int     index;
+
+    memset( g_hello_client.peer_by_conn_id, 0, sizeof( g_hello_client.peer_by_conn_id ) );
+    memset( g_hello_client.peer_by_addr, 0, sizeof( g_hello_client.peer_by_addr ) );
+
+    for ( index = 0; index < HELLO_CLIENT_MAX_CONNECTIONS; index++ )
+    {
+        if ( g_hello_client.peer_info[index].conn_id == 0 )
+        {
+            continue;
+        }
+
+        slot = hello_client_conn_id_hash( g_hello_client.peer_info[index].conn_id );
+        while ( g_hello_client.peer_by_conn_id[slot] != 0 )
+        {
+            slot = ( slot + 1 ) & ( HELLO_CLIENT_PEER_HASH_SIZE - 1 );
+        }
+        g_hello_client.peer_by_conn_id[slot] = index + 1;
+
+        slot = hello_client_addr_hash( g_hello_client.peer_info[index].peer_addr );
+        while ( g_hello_client.peer_by_addr[slot] != 0 )
+        {
+            slot = ( slot + 1 ) & ( HELLO_CLIENT_PEER_HASH_SIZE - 1 );
+        }
+        g_hello_client.peer_by_addr[slot] = index + 1;
     }
-    UNUSED_VARIABLE(status);
 }
 
 /*
@@ -1161,11 +1746,18 @@ void hello_client_add_peer_info( uint16_t conn_id, uint8_t* p_bd_addr, uint8_t r
     {
         if ( g_hello_client.peer_info[index].conn_id == 0 )
         {
+            memset( &g_hello_client.peer_info[index], 0, sizeof( hello_client_peer_info_t ) );
             g_hello_client.peer_info[index].conn_id         = conn_id;
             g_hello_client.peer_info[index].role            = role;
             g_hello_client.peer_info[index].transport       = transport;
             g_hello_client.peer_info[index].addr_type       = address_type;
             memcpy( g_hello_client.peer_info[index].peer_addr, p_bd_addr, BD_ADDR_LEN );
+
+            /* Handles of the hello_sensor are well known, no discovery */
+            g_hello_client.peer_info[index].notify_handle   = HANDLE_HSENS_SERVICE_CHAR_NOTIFY_VAL;
+            g_hello_client.peer_info[index].cccd_handle     = HANDLE_HSENS_SERVICE_CHAR_CFG_DESC;
+
+            hello_client_peer_index_rebuild( );
             break;
         }
     }
@@ -1176,14 +1768,15 @@ void hello_client_add_peer_info( uint16_t conn_id, uint8_t* p_bd_addr, uint8_t r
  */
 void hello_client_remove_peer_info( uint16_t conn_id )
 {
-    int index;
+    hello_client_peer_info_t *p_peer_info = hello_client_get_peer_information( conn_id );
 
-    for ( index = 0; index < HELLO_CLIENT_MAX_CONNECTIONS; index++ )
+    if ( p_peer_info != NULL )
     {
-        if ( g_hello_client.peer_info[index].conn_id == conn_id )
-        {
-            g_hello_client.peer_info[index].conn_id = 0;
-        }
+        WICED_BT_TRACE( "peer <%B> notifications:%d indications:%d bytes:%d gaps:%d\n", p_peer_info->peer_addr,
+                p_peer_info->stats.notifications, p_peer_info->stats.indications, p_peer_info->stats.bytes, p_peer_info->stats.gaps );
+
+        p_peer_info->conn_id = 0;
+        hello_client_peer_index_rebuild( );
     }
 }
 
@@ -1192,36 +1785,62 @@ void hello_client_remove_peer_info( uint16_t conn_id )
  */
 hello_client_peer_info_t * hello_client_get_peer_information( uint16_t conn_id )
 {
-    int index;
+    uint8_t slot = hello_client_conn_id_hash( conn_id );
+    int     probes;
+    uint8_t index;
 
-    for ( index = 0; index < HELLO_CLIENT_MAX_CONNECTIONS; index++ )
+    if ( conn_id == 0 )
     {
-        if ( g_hello_client.peer_info[index].conn_id == conn_id )
+        return NULL;
+    }
+
+    for ( probes = 0; probes < HELLO_CLIENT_PEER_HASH_SIZE; probes++ )
+    {
+        if ( ( index = g_hello_client.peer_by_conn_id[slot] ) == 0 )
+        {
+            break;
+        }
+        if ( g_hello_client.peer_info[index - 1].conn_id == conn_id )
         {
-            return &g_hello_client.peer_info[index];
+            return &g_hello_client.peer_info[index - 1];
         }
+        slot = ( slot + 1 ) & ( HELLO_CLIENT_PEER_HASH_SIZE - 1 );
     }
     return NULL;
 }
 
 /*
- * Find out if specific device is connected as a master
+ * This function gets the peer information of a connected device
  */
-static int hello_client_is_master( BD_ADDR bda )
+hello_client_peer_info_t * hello_client_get_peer_by_addr( BD_ADDR bda )
 {
-    int index;
+    uint8_t slot = hello_client_addr_hash( bda );
+    int     probes;
+    uint8_t index;
 
-    for ( index = 0; index < HELLO_CLIENT_MAX_CONNECTIONS; index++ )
+    for ( probes = 0; probes < HELLO_CLIENT_PEER_HASH_SIZE; probes++ )
     {
-        if ( g_hello_client.peer_info[index].conn_id != 0 )
+        if ( ( index = g_hello_client.peer_by_addr[slot] ) == 0 )
         {
-            if ( memcmp( g_hello_client.peer_info[index].peer_addr, bda, BD_ADDR_LEN) == 0 )
-            {
-                return ( g_hello_client.peer_info[index].role == HCI_ROLE_MASTER );
-            }
+            break;
+        }
+        if ( memcmp( g_hello_client.peer_info[index - 1].peer_addr, bda, BD_ADDR_LEN ) == 0 )
+        {
+            return &g_hello_client.peer_info[index - 1];
         }
+        slot = ( slot + 1 ) & ( HELLO_CLIENT_PEER_HASH_SIZE - 1 );
     }
-    return FALSE;
+    return NULL;
+}
+
+/*
+ * Find out if specific device is connected as a master
+ */
+static int hello_client_is_master( BD_ADDR bda )
+{
+    hello_client_peer_info_t *p_peer_info = hello_client_get_peer_by_addr( bda );
+
+    return ( ( p_peer_info != NULL ) && ( p_peer_info->role == HCI_ROLE_MASTER ) );
 }
 
 /*
@@ -1229,163 +1848,233 @@ static int hello_client_is_master( BD_ADDR bda )
  */
 wiced_bool_t hello_client_save_link_keys( wiced_bt_device_link_keys_t *p_keys)
 {
-    uint8_t                     bytes_written, bytes_read;
-    wiced_bt_device_link_keys_t temp_keys;
-    uint16_t                    id = 0, i;
-    wiced_result_t              result;
+    return bond_store_save( &hello_client_bond_store, p_keys );
+}
+
+/*
+ * This function is called to read keys for specific bdaddr
+ */
+wiced_bool_t hello_client_read_link_keys( wiced_bt_device_link_keys_t *p_keys)
+{
+    return bond_store_read( &hello_client_bond_store, p_keys );
+}
+
+void hello_client_load_keys_to_addr_resolution_db( void )
+{
+    bond_store_load_addr_resolution_db( &hello_client_bond_store );
+}
 
-    // search through all available NVRAM IDs.
-    for ( i = WICED_NVRAM_VSID_START; i < WICED_NVRAM_VSID_END; i++ )
+/*
+ * Find attribute based on attribute handle
+ */
+const gatt_attribute_t * hello_client_get_attribute(uint16_t handle)
+{
+    const gatt_attribute_t * puAttribute = gatt_attr_index_find( &hello_client_attr_index, handle );
+
+    if ( puAttribute == NULL )
     {
-        bytes_read = wiced_hal_read_nvram( i, sizeof( temp_keys ), (uint8_t *)&temp_keys, &result );
+        WICED_BT_TRACE( "Attr handle:0x%x not found\n", handle );
+    }
+    return puAttribute;
+}
 
-        WICED_BT_TRACE( "Read NVRAM at:%d bytes:%d result:%d\n", i, bytes_read, result );
+/* Check for device entry exists in the bonded device index */
+wiced_bool_t hello_client_is_device_bonded( wiced_bt_device_address_t bd_address )
+{
+    return bond_store_is_bonded( &hello_client_bond_store, bd_address );
+}
 
-        // if failed to read NVRAM, there is nothing saved at that location
-        if ( ( result != WICED_SUCCESS ) || ( bytes_read != sizeof( temp_keys ) ) )
-        {
-            id = i;
-            break;
-        }
-        else
-        {
-            if ( memcmp( temp_keys.bd_addr, p_keys->bd_addr, BD_ADDR_LEN ) == 0 )
-            {
-                // keys for this device have been saved, reuse the ID
-                id = i;
-                break;
-            }
-        }
+/*
+ * Handle HCI_CONTROL_LE_COMMAND_SCAN, payload: 1 to look for one more slave,
+ * 0 to stop.  Same as holding the button for more than 5 seconds.
+ */
+static uint8_t hello_client_cmd_scan( uint16_t opcode, uint8_t *p_data, uint32_t data_len )
+{
+    wiced_result_t status;
+
+    if ( p_data[0] == 0 )
+    {
+        start_scan = 0;
+        status = wiced_bt_ble_scan( BTM_BLE_SCAN_TYPE_NONE, WICED_TRUE, hello_client_scan_result_cback );
+        return ( ( status == WICED_BT_SUCCESS ) || ( status == WICED_BT_PENDING ) ) ? HCI_CONTROL_STATUS_SUCCESS : HCI_CONTROL_STATUS_FAILED;
     }
-    if ( id == 0 )
+    if ( hello_client_get_num_slaves( ) >= HELLO_CLIENT_MAX_SLAVES )
     {
-        // all NVRAM locations are already occupied.  Cann't save anything.
-        WICED_BT_TRACE( "Failed to save NVRAM\n" );
-        return WICED_FALSE;
+        return HCI_CONTROL_STATUS_FAILED;
     }
-    WICED_BT_TRACE( "writing to id:%d\n", id );
-    bytes_written = wiced_hal_write_nvram( id, sizeof( wiced_bt_device_link_keys_t ), (uint8_t *)p_keys, &result );
-    WICED_BT_TRACE( "Saved %d bytes at id:%d %d\n", bytes_written, id );
-    UNUSED_VARIABLE(bytes_written);
-    return WICED_TRUE;
+
+    start_scan = 1;
+    scan_filter_reset( &hello_client_scan_filter );
+    hello_client_conn_mgr_scan( );
+    return HCI_CONTROL_STATUS_SUCCESS;
 }
 
 /*
- * This function is called to read keys for specific bdaddr
+ * Handle HCI_CONTROL_LE_COMMAND_DISCONNECT, payload: peer BDA.  A slave
+ * disconnected this way is not connected again until the next scan.
  */
-wiced_bool_t hello_client_read_link_keys( wiced_bt_device_link_keys_t *p_keys)
+static uint8_t hello_client_cmd_disconnect( uint16_t opcode, uint8_t *p_data, uint32_t data_len )
 {
-    wiced_bt_device_link_keys_t temp_keys;
-    uint8_t                     bytes_read;
-    uint16_t                    i;
-    wiced_result_t              result;
+    hello_client_peer_info_t *p_peer_info;
+    BD_ADDR                  bda;
 
-    // search through all available NVRAM IDs.
-    for ( i = WICED_NVRAM_VSID_START; i < WICED_NVRAM_VSID_END; i++ )
+    STREAM_TO_BDADDR( bda, p_data );
+    if ( ( p_peer_info = hello_client_get_peer_by_addr( bda ) ) == NULL )
     {
-        bytes_read = wiced_hal_read_nvram( i, sizeof( temp_keys ), (uint8_t *)&temp_keys, &result );
+        return HCI_CONTROL_STATUS_INVALID_ARGS;
+    }
+    return ( wiced_bt_gatt_disconnect( p_peer_info->conn_id ) == WICED_BT_GATT_SUCCESS ) ? HCI_CONTROL_STATUS_SUCCESS : HCI_CONTROL_STATUS_FAILED;
+}
 
-        WICED_BT_TRACE(" [%s] read status %d bytes read %d \n", __FUNCTION__, result, bytes_read);
+/*
+ * Handle HCI_CONTROL_LE_COMMAND_READ_PEER_STATS
+ */
+static uint8_t hello_client_cmd_read_peer_stats( uint16_t opcode, uint8_t *p_data, uint32_t data_len )
+{
+    hello_client_peer_info_t *p_peer_info;
+    uint8_t                  event[BD_ADDR_LEN + 2 + ( 4 + HELLO_CLIENT_HIST_BUCKETS ) * 4];
+    uint8_t                  *p;
+    int                      index, i;
 
-        // if failed to read NVRAM, there is nothing saved at that location
-        if ( result == WICED_SUCCESS )
+    for ( index = 0; index < HELLO_CLIENT_MAX_CONNECTIONS; index++ )
+    {
+        p_peer_info = &g_hello_client.peer_info[index];
+        if ( ( p_peer_info->conn_id == 0 ) || ( p_peer_info->role != HCI_ROLE_MASTER ) )
         {
-            if ( memcmp( temp_keys.bd_addr, p_keys->bd_addr, BD_ADDR_LEN ) == 0 )
-            {
-                // keys for this device have been saved
-                memcpy( &p_keys->key_data, &temp_keys.key_data, sizeof( temp_keys.key_data ) );
-                return WICED_TRUE;
-            }
+            continue;
         }
-        else
+
+        p = event;
+        BDADDR_TO_STREAM( p, p_peer_info->peer_addr );
+        UINT16_TO_STREAM( p, p_peer_info->conn_id );
+        UINT32_TO_STREAM( p, p_peer_info->stats.notifications );
+        UINT32_TO_STREAM( p, p_peer_info->stats.indications );
+        UINT32_TO_STREAM( p, p_peer_info->stats.bytes );
+        UINT32_TO_STREAM( p, p_peer_info->stats.gaps );
+        for ( i = 0; i < HELLO_CLIENT_HIST_BUCKETS; i++ )
         {
-            break;
+            UINT32_TO_STREAM( p, p_peer_info->stats.hist[i] );
         }
+        wiced_transport_send_data( HCI_CONTROL_LE_EVENT_PEER_STATS, event, p - event );
     }
-    UNUSED_VARIABLE(bytes_read);
-    return WICED_FALSE;
+    return HCI_CONTROL_STATUS_SUCCESS;
 }
 
-void hello_client_load_keys_to_addr_resolution_db( void )
+/*
+ * Handle HCI_CONTROL_LE_COMMAND_RESET_PEER_STATS
+ */
+static uint8_t hello_client_cmd_reset_peer_stats( uint16_t opcode, uint8_t *p_data, uint32_t data_len )
 {
-    uint8_t                     bytes_read;
-    uint16_t                    i;
-    wiced_result_t              result;
-    wiced_bt_device_link_keys_t keys;
+    int index;
 
-    // search through all available NVRAM IDs.
-    for ( i = WICED_NVRAM_VSID_START; i < WICED_NVRAM_VSID_END; i++ )
+    for ( index = 0; index < HELLO_CLIENT_MAX_CONNECTIONS; index++ )
     {
-        bytes_read = wiced_hal_read_nvram( i, sizeof( keys ), (uint8_t *)&keys, &result );
-
-        WICED_BT_TRACE(" [%s] read status %d bytes read %d \n", __FUNCTION__, result, bytes_read);
+        memset( &g_hello_client.peer_info[index].stats, 0, sizeof( hello_client_peer_stats_t ) );
+    }
+    return HCI_CONTROL_STATUS_SUCCESS;
+}
 
-        // if failed to read NVRAM, there is nothing saved at that location
-        if ( result == WICED_SUCCESS )
-        {
-#ifdef CYW20706A2
-            result = wiced_bt_dev_add_device_to_address_resolution_db( &keys, keys.key_data.ble_addr_type );
-#else
-            result = wiced_bt_dev_add_device_to_address_resolution_db( &keys );
-#endif
+/*
+ * Handle HCI_CONTROL_LE_COMMAND_SET_SEQ_OFFSET.  The sequence of each slave
+ * starts again with its next data.
+ */
+static uint8_t hello_client_cmd_set_seq_offset( uint16_t opcode, uint8_t *p_data, uint32_t data_len )
+{
+    int index;
 
-            WICED_BT_TRACE("Updated Addr Resolution DB:%d\n", result );
-        }
-        else
-        {
-            break;
-        }
+    g_hello_client.seq_offset = p_data[0];
+    for ( index = 0; index < HELLO_CLIENT_MAX_CONNECTIONS; index++ )
+    {
+        g_hello_client.peer_info[index].stats.has_rx = WICED_FALSE;
     }
-    UNUSED_VARIABLE(bytes_read);
+    WICED_BT_TRACE( "sequence byte offset:%d\n", g_hello_client.seq_offset );
+    return HCI_CONTROL_STATUS_SUCCESS;
 }
 
 /*
- * Find attribute based on attribute handle
+ * Handle HCI_CONTROL_LE_COMMAND_SET_RELAY.  Disabling the relay drops the
+ * records still queued, the data of the slaves is then forwarded as it comes.
  */
-const gatt_attribute_t * hello_client_get_attribute(uint16_t handle)
+static uint8_t hello_client_cmd_set_relay( uint16_t opcode, uint8_t *p_data, uint32_t data_len )
 {
-    const gatt_attribute_t * puAttributes = hello_client_gattdb_attributes;
-    int   i;
+    uint16_t flush_ms;
+
+    g_hello_client.relay.enabled = ( *p_data++ != 0 );
+    STREAM_TO_UINT16( flush_ms, p_data );
+    g_hello_client.relay.flush_ms = ( flush_ms != 0 ) ? flush_ms : HELLO_CLIENT_RELAY_FLUSH_MS;
 
-    for ( i = 0; i < sizeof( hello_client_gattdb_attributes ) / sizeof( hello_client_gattdb_attributes[0] ); i++, puAttributes++ )
+    if ( !g_hello_client.relay.enabled )
     {
-        if ( puAttributes->handle == handle )
-        {
-            return puAttributes;
-        }
+        g_hello_client.relay.len = 0;
+        wiced_stop_timer( &hello_client_relay_timer );
     }
-    WICED_BT_TRACE( "Attr handle:0x%x not found\n", handle );
-    return NULL;
+    WICED_BT_TRACE( "relay:%d flush:%d ms\n", g_hello_client.relay.enabled, g_hello_client.relay.flush_ms );
+    return HCI_CONTROL_STATUS_SUCCESS;
 }
 
-/* Check for device entry exists in NVRAM list */
-wiced_bool_t hello_client_is_device_bonded( wiced_bt_device_address_t bd_address )
+/*
+ * Handle HCI_CONTROL_LE_COMMAND_READ_RELAY_STATS
+ */
+static uint8_t hello_client_cmd_read_relay_stats( uint16_t opcode, uint8_t *p_data, uint32_t data_len )
 {
-    wiced_bt_device_link_keys_t temp_keys;
-    uint8_t                     bytes_read;
-    uint16_t                    i;
-    wiced_result_t              result;
+    uint8_t event[4 * 4];
+    uint8_t *p = event;
+
+    UINT32_TO_STREAM( p, g_hello_client.relay.relayed );
+    UINT32_TO_STREAM( p, g_hello_client.relay.packets );
+    UINT32_TO_STREAM( p, g_hello_client.relay.dropped );
+    UINT32_TO_STREAM( p, g_hello_client.relay.len );
+    wiced_transport_send_data( HCI_CONTROL_LE_EVENT_RELAY_STATS, event, p - event );
+    return HCI_CONTROL_STATUS_SUCCESS;
+}
 
-    // search through all available NVRAM IDs.
-    for ( i = WICED_NVRAM_VSID_START; i < WICED_NVRAM_VSID_END; i++ )
-    {
-        bytes_read = wiced_hal_read_nvram( i, sizeof( temp_keys ), (uint8_t *)&temp_keys, &result );
+/* HCI commands of the application, sorted by opcode */
+static const hci_control_cmd_entry_t hello_client_cmd_table[] =
+{
+    HCI_CONTROL_CMD_ENTRY( HCI_CONTROL_LE_COMMAND_SCAN,             1,           hello_client_cmd_scan ),
+    HCI_CONTROL_CMD_ENTRY( HCI_CONTROL_LE_COMMAND_DISCONNECT,       BD_ADDR_LEN, hello_client_cmd_disconnect ),
+    HCI_CONTROL_CMD_ENTRY( HCI_CONTROL_LE_COMMAND_READ_PEER_STATS,  0,           hello_client_cmd_read_peer_stats ),
+    HCI_CONTROL_CMD_ENTRY( HCI_CONTROL_LE_COMMAND_RESET_PEER_STATS, 0,           hello_client_cmd_reset_peer_stats ),
+    HCI_CONTROL_CMD_ENTRY( HCI_CONTROL_LE_COMMAND_SET_SEQ_OFFSET,   1,           hello_client_cmd_set_seq_offset ),
+    HCI_CONTROL_CMD_ENTRY( HCI_CONTROL_LE_COMMAND_SET_RELAY,        3,           hello_client_cmd_set_relay ),
+    HCI_CONTROL_CMD_ENTRY( HCI_CONTROL_LE_COMMAND_READ_RELAY_STATS, 0,           hello_client_cmd_read_relay_stats ),
+};
 
-        WICED_BT_TRACE(" [%s] read status %d bytes read %d \n", __FUNCTION__, result, bytes_read);
+/*
+ * Handle a command packet received from the MCU over the WICED HCI transport
+ */
+uint32_t hello_client_proc_rx_cmd( uint8_t *p_buffer, uint32_t length )
+{
+    uint16_t opcode;
+    uint16_t payload_len;
+    uint8_t  *p_data = p_buffer;
+    uint8_t  status;
 
-        // if failed to read NVRAM, there is nothing saved at that location
-        if ( result == WICED_SUCCESS )
-        {
-            if ( memcmp( temp_keys.bd_addr, bd_address, BD_ADDR_LEN ) == 0 )
-            {
-                return WICED_TRUE;
-            }
-        }
-        else
+    /* Expected minimum 4 byte as the wiced header */
+    if ( ( p_buffer == NULL ) || ( length < 4 ) )
+    {
+        if ( p_buffer != NULL )
         {
-            break;
+            wiced_transport_free_buffer( p_buffer );
         }
+        return HCI_CONTROL_STATUS_INVALID_ARGS;
+    }
+
+    STREAM_TO_UINT16( opcode, p_data );
+    STREAM_TO_UINT16( payload_len, p_data );
+
+    WICED_BT_TRACE( "hello_client_proc_rx_cmd:%s len:%d\n", hci_control_cmd_name( hello_client_cmd_table, HCI_CONTROL_CMD_TABLE_SIZE( hello_client_cmd_table ), opcode ), payload_len );
+
+    if ( payload_len > length - 4 )
+    {
+        status = HCI_CONTROL_STATUS_INVALID_ARGS;
     }
-    UNUSED_VARIABLE(bytes_read);
-    return WICED_FALSE;
+    else
+    {
+        status = hci_control_dispatch( hello_client_cmd_table, HCI_CONTROL_CMD_TABLE_SIZE( hello_client_cmd_table ), opcode, p_data, payload_len );
+    }
+    wiced_transport_send_data( HCI_CONTROL_EVENT_COMMAND_STATUS, &status, 1 );
+
+    wiced_transport_free_buffer( p_buffer );
+    return 0;
 }
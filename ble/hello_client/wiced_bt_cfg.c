@@ -40,6 +40,7 @@
 #include "wiced_bt_ble.h"
 #include "wiced_bt_gatt.h"
 #include "wiced_bt_cfg.h"
+#include "bond_store.h"
 
 extern char hello_client_local_name[];
 
@@ -174,7 +175,7 @@ const wiced_bt_cfg_settings_t wiced_bt_cfg_settings =
     },
 
     /* LE Address Resolution DB size  */
-    .addr_resolution_db_size            = 5,                                                           /**< LE Address Resolution DB settings - effective only for pre 4.2 controller*/
+    .addr_resolution_db_size            = BOND_STORE_ADDR_RESOLUTION_DB_SIZE,                          /**< LE Address Resolution DB settings - effective only for pre 4.2 controller*/
 
 #ifdef CYW20706A2
     .max_mtu_size                       = 360,                                                         /**< Maximum MTU size for GATT connections, should be between 23 and (max_attr_len + 5) */
@@ -81,33 +81,56 @@
 #include "wiced_bt_trace.h"
 #endif
 #include "wiced_timer.h"
+#include "wiced_memory.h"
 
 #if !defined(CYW20735B1) && !defined(CYW20719B1) && !defined(CYW20721B1) && !defined(CYW20819A1) && !defined(CYW20719B2) && !defined(CYW20721B2)
 #include "wiced_bt_app_common.h"
 #endif
 #include "wiced_platform.h"
+#include "gatt_attr_index.h"
+#include "hci_control_api.h"
+#include "hci_control_dispatch.h"
+#include "app_log.h"
+#include "buf_pool_stats.h"
+#include "app_stats.h"
+#include "latency_probe.h"
+#include "power_mgr.h"
+#include "timer_wheel.h"
+#include "bond_store.h"
 /******************************************************************************
  *                                Constants
  ******************************************************************************/
-#define HELLO_SENSOR_GATTS_MAX_CONN     1
+#define HELLO_SENSOR_NOTIFY_VALUE_LEN   7
+
+/* Phases of the advertising schedule */
+#define HELLO_SENSOR_ADV_PHASE_IDLE     0   // not advertising, no room for another client
+#define HELLO_SENSOR_ADV_PHASE_FAST     1   // high duty advertising
+#define HELLO_SENSOR_ADV_PHASE_BURST    2   // low duty advertising
+#define HELLO_SENSOR_ADV_PHASE_PAUSE    3   // advertising stopped by the schedule
 
 /******************************************************************************
  *                                Structures
  ******************************************************************************/
 typedef struct
 {
-    BD_ADDR   remote_addr;              // remote peer device address
     uint32_t  timer_count;              // timer count
-    uint32_t  fine_timer_count;         // fine timer count
-    uint16_t  conn_id;                  // connection ID referenced by the stack
-    uint16_t  peer_mtu;                 // peer MTU
-    uint8_t   num_to_write;             // num msgs to send, incr on each button intr
-    uint8_t   flag_indication_sent;     // indicates waiting for ack/cfm
     uint8_t   flag_stay_connected;      // stay connected or disconnect after all messages are sent
     uint8_t   battery_level;            // dummy battery level
+    uint8_t   adv_phase;                // HELLO_SENSOR_ADV_PHASE_xx
+    uint16_t  adv_pause;                // length of the next advertising pause in seconds
+    uint16_t  sample_period;            // period of the sample timer in ms, 0 if stopped
 
 } hello_sensor_state_t;
 
+/* Values waiting to be sent to the client, one per button push */
+typedef struct
+{
+    char      value[HELLO_SENSOR_NOTIFY_QUEUE_SIZE][HELLO_SENSOR_NOTIFY_VALUE_LEN];
+    uint8_t   head;                     // oldest value
+    uint8_t   count;                    // number of values waiting
+    uint32_t  dropped;                  // values lost to a full queue
+} hello_sensor_notify_queue_t;
+
 #pragma pack(1)
 /* Host information saved in  NVRAM */
 typedef PACKED struct
@@ -125,6 +148,41 @@ typedef struct
     void     *p_attr;
 } attribute_t;
 
+/* Prepared writes of the client, applied together on execute */
+typedef struct
+{
+    uint16_t  handle;                   // attribute the writes are for
+    uint16_t  len;                      // end of the furthest write
+    uint8_t   *p_value;                 // reassembled value, allocated on the first prepare
+} hello_sensor_prep_write_t;
+
+/* Adaptive advertising schedule, times in seconds */
+typedef struct
+{
+    uint16_t  fast_duration;            // high duty advertising on a restart
+    uint16_t  burst_duration;           // low duty advertising between two pauses
+    uint16_t  min_pause;                // first pause after the fast window
+    uint16_t  max_pause;                // pauses double up to this one, 0 for no pause
+} hello_sensor_adv_schedule_t;
+
+/* State of one connected client */
+typedef struct
+{
+    BD_ADDR   remote_addr;              // remote peer device address
+    uint16_t  conn_id;                  // connection ID referenced by the stack, 0 if the entry is free
+    uint16_t  peer_mtu;                 // peer MTU
+    uint16_t  conn_interval;            // connection interval in 1.25 ms units
+    uint16_t  characteristic_client_configuration;  // client configuration descriptor of this client
+    uint8_t   flag_indication_sent;     // indicates waiting for ack/cfm
+    uint8_t   flag_congested;           // link congested, wait for the congestion event
+    uint8_t   flag_pack_values;         // client accepts several values per notification
+    uint8_t   flag_fill_mtu;            // notifications are padded to the MTU
+    uint8_t   flag_stream;              // client wants a value every connection interval
+    uint8_t   fill_seq;                 // next byte of the padding counter
+    hello_sensor_notify_queue_t notify_queue;   // values not yet sent to this client
+    hello_sensor_prep_write_t   prep_write;     // prepared writes of this client
+} hello_sensor_conn_t;
+
 extern const wiced_bt_cfg_settings_t wiced_bt_cfg_settings;
 extern const wiced_bt_cfg_buf_pool_t wiced_bt_cfg_buf_pools[];
 
@@ -182,6 +240,21 @@ const uint8_t hello_sensor_gatt_database[]=
             UUID_HELLO_CHARACTERISTIC_CONFIG, LEGATTDB_CHAR_PROP_READ | LEGATTDB_CHAR_PROP_WRITE,
             LEGATTDB_PERM_READABLE | LEGATTDB_PERM_WRITE_CMD | LEGATTDB_PERM_WRITE_REQ ),
 
+        // Declare characteristic Hello Long Message
+    // The value can be longer than one ATT MTU, clients write it with
+    // long (prepared) writes and read it back with read blob requests.
+        CHARACTERISTIC_UUID128_WRITABLE( HANDLE_HSENS_SERVICE_CHAR_LONG_MSG, HANDLE_HSENS_SERVICE_CHAR_LONG_MSG_VAL,
+            UUID_HELLO_CHARACTERISTIC_LONG_MSG, LEGATTDB_CHAR_PROP_READ | LEGATTDB_CHAR_PROP_WRITE,
+            LEGATTDB_PERM_READABLE | LEGATTDB_PERM_WRITE_REQ | LEGATTDB_PERM_VARIABLE_LENGTH | LEGATTDB_PERM_RELIABLE_WRITE ),
+
+#ifdef APP_STATS_GATT
+        // Declare characteristic Hello Statistics
+    // Runtime counters of the sensor in the app_stats_pack() layout, the
+    // same as the HCI_CONTROL_MISC_EVENT_STATS payload.
+        CHARACTERISTIC_UUID128( HANDLE_HSENS_SERVICE_CHAR_STATS, HANDLE_HSENS_SERVICE_CHAR_STATS_VAL,
+            UUID_HELLO_CHARACTERISTIC_STATS, LEGATTDB_CHAR_PROP_READ, LEGATTDB_PERM_READABLE ),
+#endif
+
     // Declare Device info service
     PRIMARY_SERVICE_UUID16( HANDLE_HSENS_DEV_INFO_SERVICE, UUID_SERVICE_DEVICE_INFORMATION ),
 
@@ -207,22 +280,50 @@ const uint8_t hello_sensor_gatt_database[]=
 
 uint8_t hello_sensor_device_name[]          = "Hello";                                              //GAP Service characteristic Device Name
 uint8_t hello_sensor_appearance_name[2]     = { BIT16_TO_8(APPEARANCE_GENERIC_TAG) };
-char    hello_sensor_char_notify_value[]    = { 'H', 'e', 'l', 'l', 'o', ' ', '0' };             //Notification Name
+char    hello_sensor_char_notify_value[HELLO_SENSOR_NOTIFY_VALUE_LEN] = { 'H', 'e', 'l', 'l', 'o', ' ', '0' }; //Notification Name
 char    hello_sensor_char_mfr_name_value[]  = { 'C', 'y', 'p', 'r', 'e', 's', 's', 0, };
 char    hello_sensor_char_model_num_value[] = { '1', '2', '3', '4',   0,   0,   0,   0 };
 uint8_t hello_sensor_char_system_id_value[] = { 0xbb, 0xb8, 0xa1, 0x80, 0x5f, 0x9f, 0x91, 0x71};
+uint8_t hello_sensor_char_long_msg_value[HELLO_SENSOR_LONG_MSG_MAX_LEN];
+#ifdef APP_STATS_GATT
+uint8_t hello_sensor_char_stats_value[APP_STATS_PACKED_LEN];
+#endif
 
 /* Holds the global state of the hello sensor application */
 hello_sensor_state_t hello_sensor_state;
 
+/* Holds the connected clients */
+hello_sensor_conn_t hello_sensor_conn[HELLO_SENSOR_MAX_NUM_CLIENTS];
+
+/* Holds the values pushed while no client is connected, handed to the next one */
+hello_sensor_notify_queue_t hello_sensor_notify_backlog;
+
 /* Holds the host info saved in the NVRAM */
 host_info_t hello_sensor_hostinfo;
-wiced_timer_t hello_sensor_second_timer;
-wiced_timer_t hello_sensor_ms_timer;
-wiced_timer_t hello_sensor_conn_idle_timer;
+bond_store_t hello_sensor_bond_store;
+uint8_t       hello_sensor_hostinfo_dirty = WICED_FALSE;   // changed since the last NVRAM write
+timer_wheel_timer_t hello_sensor_nvram_timer;
+power_mgr_tick_t hello_sensor_second_tick;
+timer_wheel_timer_t hello_sensor_conn_idle_timer;
+
+/* Advertising schedule, can be changed with HCI_CONTROL_LE_COMMAND_SET_ADV_SCHEDULE */
+hello_sensor_adv_schedule_t hello_sensor_adv_schedule =
+{
+    .fast_duration  = HELLO_SENSOR_ADV_FAST_DURATION_IN_SECONDS,
+    .burst_duration = HELLO_SENSOR_ADV_BURST_DURATION_IN_SECONDS,
+    .min_pause      = HELLO_SENSOR_ADV_MIN_PAUSE_IN_SECONDS,
+    .max_pause      = HELLO_SENSOR_ADV_MAX_PAUSE_IN_SECONDS,
+};
+timer_wheel_timer_t hello_sensor_adv_timer;
+
+/* Produces the streamed values, period follows the connection interval */
+timer_wheel_timer_t hello_sensor_sample_timer;
+
+/* Sends the queued values again after the stack ran out of buffers */
+timer_wheel_timer_t hello_sensor_send_retry_timer;
 
 /* LED timer and counters */
-wiced_timer_t hello_sensor_led_timer;
+timer_wheel_timer_t hello_sensor_led_timer;
 uint8_t       hello_sensor_led_blink_count  = 0;
 uint16_t       hello_sensor_led_on_ms  = 0;
 uint16_t       hello_sensor_led_off_ms  = 0;
@@ -254,12 +355,22 @@ attribute_t gauAttributes[] =
     { HANDLE_HSENS_SERVICE_CHAR_NOTIFY_VAL,             sizeof(hello_sensor_char_notify_value),     hello_sensor_char_notify_value },
     { HANDLE_HSENS_SERVICE_CHAR_CFG_DESC,               2,                                          (void*)&hello_sensor_hostinfo.characteristic_client_configuration },
     { HANDLE_HSENS_SERVICE_CHAR_BLINK_VAL,              1,                                          &hello_sensor_hostinfo.number_of_blinks },
+    { HANDLE_HSENS_SERVICE_CHAR_LONG_MSG_VAL,           0,                                          hello_sensor_char_long_msg_value },
+#ifdef APP_STATS_GATT
+    { HANDLE_HSENS_SERVICE_CHAR_STATS_VAL,              0,                                          hello_sensor_char_stats_value },
+#endif
     { HANDLE_HSENS_DEV_INFO_SERVICE_CHAR_MFR_NAME_VAL,  sizeof(hello_sensor_char_mfr_name_value),   hello_sensor_char_mfr_name_value },
     { HANDLE_HSENS_DEV_INFO_SERVICE_CHAR_MODEL_NUM_VAL, sizeof(hello_sensor_char_model_num_value),  hello_sensor_char_model_num_value },
     { HANDLE_HSENS_DEV_INFO_SERVICE_CHAR_SYSTEM_ID_VAL, sizeof(hello_sensor_char_system_id_value),  hello_sensor_char_system_id_value },
     { HANDLE_HSENS_BATTERY_SERVICE_CHAR_LEVEL_VAL,      1,                                          &hello_sensor_state.battery_level },
 };
 
+/* Handle index of gauAttributes */
+gatt_attr_index_t hello_sensor_attr_index;
+uint8_t           hello_sensor_attr_slots[GATT_ATTR_INDEX_SLOTS( HANDLE_HSENS_GAP_SERVICE_CHAR_DEV_NAME_VAL, HANDLE_HSENS_BATTERY_SERVICE_CHAR_LEVEL_VAL )];
+
+static uint32_t                 hello_sensor_proc_rx_cmd( uint8_t *p_buffer, uint32_t length );
+
 /* transport configuration */
 const wiced_transport_cfg_t transport_cfg =
 {
@@ -278,26 +389,42 @@ const wiced_transport_cfg_t transport_cfg =
         .buffer_count = 0
     },
     .p_status_handler = NULL,
-    .p_data_handler = NULL,
+    .p_data_handler = hello_sensor_proc_rx_cmd,
     .p_tx_complete_cback = NULL
 };
 
 static wiced_result_t           hello_sensor_management_cback( wiced_bt_management_evt_t event, wiced_bt_management_evt_data_t *p_event_data );
 static wiced_bt_gatt_status_t   hello_sensor_gatts_callback( wiced_bt_gatt_evt_t event, wiced_bt_gatt_event_data_t *p_data);
 static void                     hello_sensor_set_advertisement_data(void);
+static void                     hello_sensor_adv_restart( void );
+static void                     hello_sensor_adv_timeout( uint32_t arg );
+static void                     hello_sensor_sample_timer_update( void );
+static void                     hello_sensor_sample_timeout( uint32_t arg );
+static void                     hello_sensor_send_retry_timeout( uint32_t arg );
+static void                     hello_sensor_conn_param_updated( wiced_bt_ble_connection_param_update_t *p_update );
 static void                     hello_sensor_send_message( void );
+static void                     hello_sensor_send_message_to( hello_sensor_conn_t *p_conn );
+static void                     hello_sensor_notify_queue_put( hello_sensor_notify_queue_t *p_queue );
+static uint8_t                  hello_sensor_notify_queue_peek( hello_sensor_conn_t *p_conn, uint8_t *p_pdu, uint16_t max_len, uint16_t *p_len );
+static void                     hello_sensor_notify_queue_remove( hello_sensor_notify_queue_t *p_queue, uint8_t num_values );
+static hello_sensor_conn_t *    hello_sensor_conn_find( uint16_t conn_id );
+static uint8_t                  hello_sensor_conn_count( void );
+static wiced_bool_t             hello_sensor_indication_pending( void );
 static void                     hello_sensor_gatts_increment_notify_value( void );
 static void                     hello_sensor_timeout( uint32_t count );
-static void                     hello_sensor_fine_timeout( uint32_t finecount );
-static void                     hello_sensor_smp_bond_result( uint8_t result );
+static void                     hello_sensor_smp_bond_result( uint8_t result, uint8_t* bd_addr );
 static void                     hello_sensor_encryption_changed( wiced_result_t result, uint8_t* bd_addr );
 static void                     hello_sensor_interrupt_handler(void* user_data, uint8_t value );
 static void                     hello_sensor_application_init( void );
 static void                     hello_sensor_conn_idle_timeout ( uint32_t arg );
+static void                     hello_sensor_hostinfo_update( void );
+static void                     hello_sensor_hostinfo_flush( void );
+static void                     hello_sensor_nvram_timeout( uint32_t arg );
+static wiced_bt_gatt_status_t   hello_sensor_prep_write_queue( hello_sensor_prep_write_t *p_prep, wiced_bt_gatt_write_t *p_data );
+static void                     hello_sensor_prep_write_free( hello_sensor_prep_write_t *p_prep );
 #ifdef ENABLE_HCI_TRACE
 static void                     hello_sensor_hci_trace_cback( wiced_bt_hci_trace_type_t type, uint16_t length, uint8_t* p_data );
 #endif
-static void                     hello_sensor_load_keys_for_address_resolution( void );
 #ifndef CYW43012C0
 static void                     hello_sensor_led_timeout( uint32_t count );
 static void                     hello_sensor_led_blink(uint16_t on_ms, uint16_t off_ms, uint8_t num_of_blinks );
@@ -336,6 +463,9 @@ APPLICATION_START( )
 
     WICED_BT_TRACE( "Hello Sensor Start\n" );
 
+    buf_pool_stats_init( wiced_bt_cfg_buf_pools );
+    app_stats_init( );
+
     // Register call back and configuration with stack
     wiced_bt_stack_init( hello_sensor_management_cback ,
                     &wiced_bt_cfg_settings, wiced_bt_cfg_buf_pools );
@@ -347,7 +477,6 @@ APPLICATION_START( )
 void hello_sensor_application_init( void )
 {
     wiced_bt_gatt_status_t gatt_status;
-    wiced_result_t         result;
 
     WICED_BT_TRACE( "hello_sensor_application_init\n" );
 
@@ -363,23 +492,24 @@ void hello_sensor_application_init( void )
     gatt_status =  wiced_bt_gatt_db_init( hello_sensor_gatt_database, sizeof(hello_sensor_gatt_database) );
 
     WICED_BT_TRACE("wiced_bt_gatt_db_init %d\n", gatt_status);
+
+    GATT_ATTR_INDEX_INIT( &hello_sensor_attr_index, gauAttributes, sizeof( gauAttributes ) / sizeof( gauAttributes[0] ), hello_sensor_attr_slots );
 #ifdef ENABLE_HCI_TRACE
     wiced_bt_dev_register_hci_trace( hello_sensor_hci_trace_cback );
 #endif
-    /* Starting the app timers , seconds timer and the ms timer  */
-    if (wiced_init_timer(&hello_sensor_second_timer, hello_sensor_timeout, 0, WICED_SECONDS_PERIODIC_TIMER) == WICED_SUCCESS)
-    {
-        wiced_start_timer( &hello_sensor_second_timer, HELLO_SENSOR_APP_TIMEOUT_IN_SECONDS );
-    }
-    if (wiced_init_timer(&hello_sensor_ms_timer, hello_sensor_fine_timeout, 0, WICED_MILLI_SECONDS_PERIODIC_TIMER) == WICED_SUCCESS)
-    {
-        wiced_start_timer( &hello_sensor_ms_timer, HELLO_SENSOR_APP_FINE_TIMEOUT_IN_MS );
-    }
+    /* Starting the app seconds tick, on the shared timer of the power manager */
+    power_mgr_tick_start( &hello_sensor_second_tick, hello_sensor_timeout, 0, HELLO_SENSOR_APP_TIMEOUT_IN_SECONDS );
 
-    wiced_init_timer(&hello_sensor_conn_idle_timer, hello_sensor_conn_idle_timeout, 0, WICED_SECONDS_TIMER);
+    /* The app timers share the wake-ups of the timer wheel, the sample timer follows the connection events */
+    timer_wheel_init(&hello_sensor_conn_idle_timer, hello_sensor_conn_idle_timeout, 0, WICED_FALSE, TIMER_WHEEL_DEFAULT_SLACK_MS);
+    timer_wheel_init(&hello_sensor_nvram_timer, hello_sensor_nvram_timeout, 0, WICED_FALSE, TIMER_WHEEL_DEFAULT_SLACK_MS);
+    timer_wheel_init(&hello_sensor_adv_timer, hello_sensor_adv_timeout, 0, WICED_FALSE, TIMER_WHEEL_DEFAULT_SLACK_MS);
+    timer_wheel_init(&hello_sensor_sample_timer, hello_sensor_sample_timeout, 0, WICED_TRUE, 0);
+    timer_wheel_init(&hello_sensor_send_retry_timer, hello_sensor_send_retry_timeout, 0, WICED_FALSE, TIMER_WHEEL_DEFAULT_SLACK_MS);
 
-    /* Load previous paired keys for address resolution */
-    hello_sensor_load_keys_for_address_resolution();
+    /* Load previous paired keys for address resolution, one NVRAM read for all the bonded clients */
+    bond_store_init( &hello_sensor_bond_store, HELLO_SENSOR_PAIRED_KEYS_VS_ID, HELLO_SENSOR_MAX_BONDS );
+    bond_store_load_addr_resolution_db( &hello_sensor_bond_store );
 
 #if defined(CYW20706A2) || defined(CYW20735B0)
     /* Enable privacy to advertise with RPA */
@@ -391,8 +521,7 @@ void hello_sensor_application_init( void )
     /* Set the advertising params and make the device discoverable */
     hello_sensor_set_advertisement_data();
 
-    result =  wiced_bt_start_advertisements( BTM_BLE_ADVERT_UNDIRECTED_HIGH, 0, NULL );
-    WICED_BT_TRACE( "wiced_bt_start_advertisements %d\n", result );
+    hello_sensor_adv_restart();
 
     /*
      * Set flag_stay_connected to remain connected after all messages are sent
@@ -403,7 +532,7 @@ void hello_sensor_application_init( void )
 #ifdef CYW20706A2
     platform_led_init();
 #endif
-    wiced_init_timer(&hello_sensor_led_timer, hello_sensor_led_timeout, 0, WICED_MILLI_SECONDS_TIMER);
+    timer_wheel_init(&hello_sensor_led_timer, hello_sensor_led_timeout, 0, WICED_FALSE, HELLO_SENSOR_LED_TIMER_SLACK_MS);
     led_pin = HELLO_SENSOR_LED_GPIO;
 #endif
 }
@@ -466,27 +595,108 @@ void hello_sensor_set_advertisement_data(void)
 }
 
 /*
- * This function is invoked when advertisements stop.  If we are configured to stay connected,
- * disconnection was caused by the peer, start low advertisements, so that peer can connect
- * when it wakes up
+ * This function is invoked when advertisements stop.  If the schedule did not stop them, a client
+ * connected or the stack ran out of advertising time.  If we are configured to stay connected,
+ * continue with low advertisements while there is room for another client.
  */
 void hello_sensor_advertisement_stopped( void )
 {
     wiced_result_t result;
 
-    if ( hello_sensor_state.flag_stay_connected && !hello_sensor_state.conn_id )
+    if ( hello_sensor_state.adv_phase == HELLO_SENSOR_ADV_PHASE_PAUSE )
+    {
+        WICED_BT_TRACE( "ADV pause %d\n", hello_sensor_state.adv_pause );
+        return;
+    }
+
+    /* Keep advertising while there is room for another client */
+    if ( hello_sensor_state.flag_stay_connected && ( hello_sensor_conn_count() < HELLO_SENSOR_MAX_NUM_CLIENTS ) )
     {
+        hello_sensor_state.adv_phase = HELLO_SENSOR_ADV_PHASE_BURST;
+        if ( !timer_wheel_in_use( &hello_sensor_adv_timer ) && ( hello_sensor_adv_schedule.max_pause != 0 ) )
+        {
+            timer_wheel_start( &hello_sensor_adv_timer, hello_sensor_adv_schedule.burst_duration * 1000 );
+        }
         result =  wiced_bt_start_advertisements( BTM_BLE_ADVERT_UNDIRECTED_LOW, 0, NULL );
         WICED_BT_TRACE( "wiced_bt_start_advertisements: %d\n", result );
     }
     else
     {
+        hello_sensor_state.adv_phase = HELLO_SENSOR_ADV_PHASE_IDLE;
+        timer_wheel_stop( &hello_sensor_adv_timer );
         WICED_BT_TRACE( "ADV stop\n");
     }
 
     UNUSED_VARIABLE(result);
 }
 
+/*
+ * Start the advertising schedule over with high duty advertising.  Called after
+ * boot, a button push while nobody is connected and a disconnection, when a
+ * client is the most likely to look for us.
+ */
+void hello_sensor_adv_restart( void )
+{
+    wiced_result_t result;
+
+    hello_sensor_state.adv_phase = HELLO_SENSOR_ADV_PHASE_FAST;
+    hello_sensor_state.adv_pause = hello_sensor_adv_schedule.min_pause;
+
+    timer_wheel_stop( &hello_sensor_adv_timer );
+    timer_wheel_start( &hello_sensor_adv_timer, hello_sensor_adv_schedule.fast_duration * 1000 );
+
+    result = wiced_bt_start_advertisements( BTM_BLE_ADVERT_UNDIRECTED_HIGH, 0, NULL );
+    WICED_BT_TRACE( "wiced_bt_start_advertisements high:%d\n", result );
+    UNUSED_VARIABLE(result);
+}
+
+/*
+ * The function invoked on timeout of the advertising schedule timer.  The fast
+ * window and the bursts end in a pause, every pause twice as long as the one
+ * before, and a pause ends in a low duty burst.
+ */
+void hello_sensor_adv_timeout( uint32_t arg )
+{
+    wiced_result_t result;
+
+    switch ( hello_sensor_state.adv_phase )
+    {
+    case HELLO_SENSOR_ADV_PHASE_FAST:
+    case HELLO_SENSOR_ADV_PHASE_BURST:
+        if ( hello_sensor_adv_schedule.max_pause == 0 )
+        {
+            /* No pauses, low duty advertising until a client connects */
+            hello_sensor_state.adv_phase = HELLO_SENSOR_ADV_PHASE_BURST;
+            result = wiced_bt_start_advertisements( BTM_BLE_ADVERT_UNDIRECTED_LOW, 0, NULL );
+            break;
+        }
+
+        /* Set the phase first, stopping reports BTM_BLE_ADVERT_OFF */
+        hello_sensor_state.adv_phase = HELLO_SENSOR_ADV_PHASE_PAUSE;
+        timer_wheel_start( &hello_sensor_adv_timer, hello_sensor_state.adv_pause * 1000 );
+        result = wiced_bt_start_advertisements( BTM_BLE_ADVERT_OFF, 0, NULL );
+
+        hello_sensor_state.adv_pause *= 2;
+        if ( hello_sensor_state.adv_pause > hello_sensor_adv_schedule.max_pause )
+        {
+            hello_sensor_state.adv_pause = hello_sensor_adv_schedule.max_pause;
+        }
+        break;
+
+    case HELLO_SENSOR_ADV_PHASE_PAUSE:
+        hello_sensor_state.adv_phase = HELLO_SENSOR_ADV_PHASE_BURST;
+        timer_wheel_start( &hello_sensor_adv_timer, hello_sensor_adv_schedule.burst_duration * 1000 );
+        result = wiced_bt_start_advertisements( BTM_BLE_ADVERT_UNDIRECTED_LOW, 0, NULL );
+        break;
+
+    default:
+        return;
+    }
+
+    WICED_BT_TRACE( "adv schedule phase:%d result:%d\n", hello_sensor_state.adv_phase, result );
+    UNUSED_VARIABLE(result);
+}
+
 #ifndef CYW43012C0
 /*
  * The function invoked on timeout of led timer.
@@ -500,14 +710,14 @@ void hello_sensor_led_timeout( uint32_t count )
         if (--hello_sensor_led_blink_count)
         {
             led_on = WICED_FALSE;
-            wiced_start_timer( &hello_sensor_led_timer, hello_sensor_led_off_ms );
+            timer_wheel_start( &hello_sensor_led_timer, hello_sensor_led_off_ms );
         }
     }
     else
     {
         led_on = WICED_TRUE;
         wiced_hal_gpio_set_pin_output(led_pin, GPIO_PIN_OUTPUT_LOW);
-        wiced_start_timer( &hello_sensor_led_timer, hello_sensor_led_on_ms );
+        timer_wheel_start( &hello_sensor_led_timer, hello_sensor_led_on_ms );
     }
 }
 
@@ -526,8 +736,8 @@ void hello_sensor_led_blink(uint16_t on_ms, uint16_t off_ms, uint8_t num_of_blin
         hello_sensor_led_off_ms = off_ms;
         hello_sensor_led_on_ms = on_ms;
         wiced_hal_gpio_set_pin_output(led_pin, GPIO_PIN_OUTPUT_LOW);
-        wiced_stop_timer(&hello_sensor_led_timer);
-        wiced_start_timer(&hello_sensor_led_timer,on_ms);
+        timer_wheel_stop(&hello_sensor_led_timer);
+        timer_wheel_start(&hello_sensor_led_timer, on_ms);
     }
 }
 #endif
@@ -537,19 +747,103 @@ void hello_sensor_led_blink(uint16_t on_ms, uint16_t off_ms, uint8_t num_of_blin
  */
 void hello_sensor_timeout( uint32_t count )
 {
+    uint8_t i;
+
     hello_sensor_state.timer_count++;
+
+    // sample the RSSI of one client every HELLO_SENSOR_RSSI_PERIOD seconds, in turn
+    if ( ( hello_sensor_state.timer_count % HELLO_SENSOR_RSSI_PERIOD ) == 0 )
+    {
+        i = ( hello_sensor_state.timer_count / HELLO_SENSOR_RSSI_PERIOD ) % HELLO_SENSOR_MAX_NUM_CLIENTS;
+        if ( hello_sensor_conn[i].conn_id != 0 )
+        {
+            app_stats_read_rssi( hello_sensor_conn[i].remote_addr );
+        }
+    }
+
     // print for first 10 seconds, then once every 10 seconds thereafter
     if ((hello_sensor_state.timer_count <= 10) || (hello_sensor_state.timer_count % 10 == 0))
-        WICED_BT_TRACE("hello_sensor_timeout: %d, ft:%d \n",
-                hello_sensor_state.timer_count, hello_sensor_state.fine_timer_count );
+        WICED_BT_TRACE("hello_sensor_timeout: %d\n", hello_sensor_state.timer_count );
 }
 
 /*
- * The function invoked on timeout of app milliseconds fine timer
+ * Run the sample timer at the shortest connection interval of the streaming
+ * clients, so that every connection event has a fresh value to carry instead
+ * of values waiting for an unrelated timer.  Stop it if nobody streams.
  */
-void hello_sensor_fine_timeout( uint32_t finecount )
+void hello_sensor_sample_timer_update( void )
 {
-    hello_sensor_state.fine_timer_count++;
+    uint16_t interval = 0;
+    uint16_t period;
+    uint8_t  i;
+
+    for ( i = 0; i < HELLO_SENSOR_MAX_NUM_CLIENTS; i++ )
+    {
+        if ( ( hello_sensor_conn[i].conn_id != 0 ) && hello_sensor_conn[i].flag_stream &&
+             ( ( interval == 0 ) || ( hello_sensor_conn[i].conn_interval < interval ) ) )
+        {
+            interval = hello_sensor_conn[i].conn_interval;
+        }
+    }
+
+    /* Connection interval is in 1.25 ms units */
+    period = ( interval * 5 + 2 ) / 4;
+    if ( period == hello_sensor_state.sample_period )
+    {
+        return;
+    }
+
+    WICED_BT_TRACE( "sample period:%d ms\n", period );
+    hello_sensor_state.sample_period = period;
+    timer_wheel_stop( &hello_sensor_sample_timer );
+    if ( period != 0 )
+    {
+        timer_wheel_start( &hello_sensor_sample_timer, period );
+    }
+}
+
+/*
+ * The function invoked on timeout of the sample timer.  Produce a value for
+ * the streaming clients and send it.
+ */
+void hello_sensor_sample_timeout( uint32_t arg )
+{
+    uint8_t i;
+
+    hello_sensor_gatts_increment_notify_value();
+
+    for ( i = 0; i < HELLO_SENSOR_MAX_NUM_CLIENTS; i++ )
+    {
+        if ( ( hello_sensor_conn[i].conn_id != 0 ) && hello_sensor_conn[i].flag_stream )
+        {
+            hello_sensor_notify_queue_put( &hello_sensor_conn[i].notify_queue );
+            hello_sensor_send_message_to( &hello_sensor_conn[i] );
+        }
+    }
+}
+
+/*
+ * Process the connection parameters negotiated with a client
+ */
+void hello_sensor_conn_param_updated( wiced_bt_ble_connection_param_update_t *p_update )
+{
+    uint8_t i;
+
+    WICED_BT_TRACE( "conn param update %B status:%d interval:%d latency:%d\n", p_update->bd_addr, p_update->status, p_update->conn_interval, p_update->conn_latency );
+
+    if ( p_update->status != 0 )
+    {
+        return;
+    }
+
+    for ( i = 0; i < HELLO_SENSOR_MAX_NUM_CLIENTS; i++ )
+    {
+        if ( ( hello_sensor_conn[i].conn_id != 0 ) && ( memcmp( hello_sensor_conn[i].remote_addr, p_update->bd_addr, sizeof( BD_ADDR ) ) == 0 ) )
+        {
+            hello_sensor_conn[i].conn_interval = p_update->conn_interval;
+        }
+    }
+    hello_sensor_sample_timer_update();
 }
 
 /*
@@ -558,24 +852,72 @@ void hello_sensor_fine_timeout( uint32_t finecount )
  * associated data
  */
 
-void hello_sensor_smp_bond_result( uint8_t result )
+void hello_sensor_smp_bond_result( uint8_t result, uint8_t* bd_addr )
 {
-    wiced_result_t status;
-    uint8_t written_byte = 0;
     WICED_BT_TRACE( "hello_sensor, bond result: %d\n", result );
 
     /* Bonding success */
     if ( result == WICED_BT_SUCCESS )
     {
         /* Pack the data to be stored into the hostinfo structure */
-        memcpy( hello_sensor_hostinfo.bdaddr, hello_sensor_state.remote_addr, sizeof( BD_ADDR ) );
+        memcpy( hello_sensor_hostinfo.bdaddr, bd_addr, sizeof( BD_ADDR ) );
+
+        /* Write to NVRAM now, the bond must survive a reset */
+        hello_sensor_hostinfo_update();
+        hello_sensor_hostinfo_flush();
+    }
+}
+
+/*
+ * Mark the host info as changed.  The NVRAM write is deferred so that a burst
+ * of client writes, a client toggling notifications for example, costs a
+ * single flash write outside of the GATT callback.
+ */
+void hello_sensor_hostinfo_update( void )
+{
+    hello_sensor_hostinfo_dirty = WICED_TRUE;
 
-        /* Write to NVRAM */
-        written_byte = wiced_hal_write_nvram( HELLO_SENSOR_VS_ID, sizeof(hello_sensor_hostinfo), (uint8_t*)&hello_sensor_hostinfo, &status );
-        WICED_BT_TRACE("NVRAM write: %d\n", written_byte);
+    /* Do not restart a running timer, the write-back delay stays bounded */
+    if ( !timer_wheel_in_use( &hello_sensor_nvram_timer ) )
+    {
+        timer_wheel_start( &hello_sensor_nvram_timer, HELLO_SENSOR_NVRAM_FLUSH_DELAY_IN_MS );
+    }
+}
+
+/*
+ * Write the host info to NVRAM if it changed.  Called on the write-back timer,
+ * on disconnection and before anything that needs NVRAM to be up to date.
+ */
+void hello_sensor_hostinfo_flush( void )
+{
+    wiced_result_t rc;
+    uint16_t       bytes_written;
+
+    timer_wheel_stop( &hello_sensor_nvram_timer );
+
+    if ( !hello_sensor_hostinfo_dirty )
+    {
+        return;
+    }
+
+    bytes_written = wiced_hal_write_nvram( HELLO_SENSOR_VS_ID, sizeof(hello_sensor_hostinfo), (uint8_t*)&hello_sensor_hostinfo, &rc );
+    WICED_BT_TRACE( "NVRAM write:%d rc:%d\n", bytes_written, rc );
+
+    /* Keep the data dirty on failure, the next flush retries */
+    if ( rc == WICED_SUCCESS )
+    {
+        hello_sensor_hostinfo_dirty = WICED_FALSE;
     }
 
-    UNUSED_VARIABLE(written_byte);
+    UNUSED_VARIABLE(bytes_written);
+}
+
+/*
+ * The function invoked on timeout of the NVRAM write-back timer
+ */
+void hello_sensor_nvram_timeout( uint32_t arg )
+{
+    hello_sensor_hostinfo_flush();
 }
 
 
@@ -586,30 +928,42 @@ void hello_sensor_smp_bond_result( uint8_t result )
  */
 void hello_sensor_encryption_changed( wiced_result_t result, uint8_t* bd_addr )
 {
-    WICED_BT_TRACE( "encryp change bd ( %B ) res: %d ", hello_sensor_hostinfo.bdaddr,  result);
+    host_info_t hostinfo;
+    uint8_t     i;
+
+    WICED_BT_TRACE( "encryp change bd ( %B ) res: %d ", bd_addr,  result);
 
     /* Connection has been encrypted meaning that we have correct/paired device
-     * restore values in the database
+     * restore values in the database, after writing back any pending change.
+     * Only the host saved in the NVRAM gets its values back.
      */
-    wiced_hal_read_nvram( HELLO_SENSOR_VS_ID, sizeof(hello_sensor_hostinfo), (uint8_t*)&hello_sensor_hostinfo, &result );
+    hello_sensor_hostinfo_flush();
+    wiced_hal_read_nvram( HELLO_SENSOR_VS_ID, sizeof(hostinfo), (uint8_t*)&hostinfo, &result );
+    if ( ( result == WICED_SUCCESS ) && ( memcmp( hostinfo.bdaddr, bd_addr, sizeof( BD_ADDR ) ) == 0 ) )
+    {
+        memcpy( &hello_sensor_hostinfo, &hostinfo, sizeof( hostinfo ) );
+        for ( i = 0; i < HELLO_SENSOR_MAX_NUM_CLIENTS; i++ )
+        {
+            if ( ( hello_sensor_conn[i].conn_id != 0 ) && ( memcmp( hello_sensor_conn[i].remote_addr, bd_addr, sizeof( BD_ADDR ) ) == 0 ) )
+            {
+                hello_sensor_conn[i].characteristic_client_configuration = hostinfo.characteristic_client_configuration;
+            }
+        }
+    }
 
     // If there are outstanding messages that we could not send out because
     // connection was not up and/or encrypted, send them now.  If we are sending
     // indications, we can send only one and need to wait for ack.
-    while ( ( hello_sensor_state.num_to_write != 0 ) && !hello_sensor_state.flag_indication_sent )
-    {
-        hello_sensor_state.num_to_write--;
-        hello_sensor_send_message();
-    }
+    hello_sensor_send_message();
 
     // If configured to disconnect after delivering data, start idle timeout
     // to do disconnection
-    if ( ( !hello_sensor_state.flag_stay_connected ) && !hello_sensor_state.flag_indication_sent  )
+    if ( ( !hello_sensor_state.flag_stay_connected ) && !hello_sensor_indication_pending() )
     {
-        if (wiced_is_timer_in_use(&hello_sensor_conn_idle_timer) )
+        if (timer_wheel_in_use(&hello_sensor_conn_idle_timer) )
         {
-            wiced_stop_timer(&hello_sensor_conn_idle_timer);
-            wiced_start_timer(&hello_sensor_conn_idle_timer, HELLO_SENSOR_CONN_IDLE_TIMEOUT_IN_SECONDS);
+            timer_wheel_stop(&hello_sensor_conn_idle_timer);
+            timer_wheel_start(&hello_sensor_conn_idle_timer, HELLO_SENSOR_CONN_IDLE_TIMEOUT_IN_SECONDS * 1000);
         }
     }
 }
@@ -625,6 +979,8 @@ void hello_sensor_encryption_changed( wiced_result_t result, uint8_t* bd_addr )
  */
 void hello_sensor_interrupt_handler(void* user_data, uint8_t value )
 {
+    uint8_t i;
+
     WICED_BT_TRACE("[hello_sensor_interrupt_handler] \n");
 
     // Blink as configured
@@ -633,42 +989,40 @@ void hello_sensor_interrupt_handler(void* user_data, uint8_t value )
     /* Increment the last byte of the hello sensor notify value */
     hello_sensor_gatts_increment_notify_value();
 
-    /* Remember how many messages we need to send */
-    hello_sensor_state.num_to_write++;
-
-    /* If connection is down, start high duty advertisements, so client can connect */
-    if ( hello_sensor_state.conn_id == 0 )
+    /* If connection is down, keep the value for the next client and start high
+     * duty advertisements, so client can connect */
+    if ( hello_sensor_conn_count() == 0 )
     {
-        wiced_result_t result;
+        hello_sensor_notify_queue_put( &hello_sensor_notify_backlog );
 
         WICED_BT_TRACE( "ADV start high\n");
 
-        result = wiced_bt_start_advertisements( BTM_BLE_ADVERT_UNDIRECTED_HIGH, 0, NULL );
-
-        WICED_BT_TRACE( "wiced_bt_start_advertisements:%d\n", result );
-        UNUSED_VARIABLE(result);
+        hello_sensor_adv_restart();
         return;
     }
 
     /*
      * Connection up.
-     * Send message if client registered to receive indication
-     * or notification. After we send an indication wait for the ack
-     * before we can send anything else
+     * Queue the value for every client, send message if client registered
+     * to receive indication or notification. After we send an indication
+     * wait for the ack before we can send anything else to that client
      */
-    while ( ( hello_sensor_state.num_to_write != 0 ) && !hello_sensor_state.flag_indication_sent )
+    for ( i = 0; i < HELLO_SENSOR_MAX_NUM_CLIENTS; i++ )
     {
-        hello_sensor_state.num_to_write--;
-        hello_sensor_send_message();
+        if ( hello_sensor_conn[i].conn_id != 0 )
+        {
+            hello_sensor_notify_queue_put( &hello_sensor_conn[i].notify_queue );
+        }
     }
+    hello_sensor_send_message();
 
     // if we sent all messages, start connection idle timer to disconnect
-    if ( !hello_sensor_state.flag_stay_connected && !hello_sensor_state.flag_indication_sent )
+    if ( !hello_sensor_state.flag_stay_connected && !hello_sensor_indication_pending() )
     {
-        if (wiced_is_timer_in_use(&hello_sensor_conn_idle_timer) )
+        if (timer_wheel_in_use(&hello_sensor_conn_idle_timer) )
         {
-            wiced_stop_timer(&hello_sensor_conn_idle_timer);
-            wiced_start_timer(&hello_sensor_conn_idle_timer, HELLO_SENSOR_CONN_IDLE_TIMEOUT_IN_SECONDS);
+            timer_wheel_stop(&hello_sensor_conn_idle_timer);
+            timer_wheel_start(&hello_sensor_conn_idle_timer, HELLO_SENSOR_CONN_IDLE_TIMEOUT_IN_SECONDS * 1000);
         }
     }
 }
@@ -679,14 +1033,21 @@ void hello_sensor_interrupt_handler(void* user_data, uint8_t value )
  */
 void hello_sensor_conn_idle_timeout ( uint32_t arg )
 {
+    uint8_t i;
+
     WICED_BT_TRACE( "hello_sensor_conn_idle_timeout\n" );
 
     /* Stopping the app timers */
-    wiced_stop_timer(&hello_sensor_second_timer);
-    wiced_stop_timer(&hello_sensor_ms_timer);
+    power_mgr_tick_stop(&hello_sensor_second_tick);
 
-    /* Initiating the gatt disconnect */
-    wiced_bt_gatt_disconnect( hello_sensor_state.conn_id );
+    /* Initiating the gatt disconnect of every client */
+    for ( i = 0; i < HELLO_SENSOR_MAX_NUM_CLIENTS; i++ )
+    {
+        if ( hello_sensor_conn[i].conn_id != 0 )
+        {
+            wiced_bt_gatt_disconnect( hello_sensor_conn[i].conn_id );
+        }
+    }
 }
 
 /*
@@ -735,21 +1096,19 @@ wiced_result_t hello_sensor_management_cback( wiced_bt_management_evt_t event, w
         case BTM_PAIRING_COMPLETE_EVT:
             p_info =  &p_event_data->pairing_complete.pairing_complete_info.ble;
             WICED_BT_TRACE( "Pairing Complete: %d ", p_info->reason);
-            hello_sensor_smp_bond_result( p_info->reason );
+            hello_sensor_smp_bond_result( p_info->reason, p_event_data->pairing_complete.bd_addr );
             break;
 
         case BTM_PAIRED_DEVICE_LINK_KEYS_UPDATE_EVT:
             /* save keys to NVRAM */
-            p_keys = (uint8_t*)&p_event_data->paired_device_link_keys_update;
-            wiced_hal_write_nvram ( HELLO_SENSOR_PAIRED_KEYS_VS_ID, sizeof( wiced_bt_device_link_keys_t ), p_keys ,&result );
-            WICED_BT_TRACE("keys save to NVRAM %B result: %d \n", p_keys, result);
+            bond_store_save( &hello_sensor_bond_store, &p_event_data->paired_device_link_keys_update );
+            WICED_BT_TRACE("keys save to NVRAM %B\n", p_event_data->paired_device_link_keys_update.bd_addr);
             break;
 
         case  BTM_PAIRED_DEVICE_LINK_KEYS_REQUEST_EVT:
             /* read keys from NVRAM */
-            p_keys = (uint8_t *)&p_event_data->paired_device_link_keys_request;
-            wiced_hal_read_nvram( HELLO_SENSOR_PAIRED_KEYS_VS_ID, sizeof(wiced_bt_device_link_keys_t), p_keys, &result );
-            WICED_BT_TRACE("keys read from NVRAM %B result: %d \n", p_keys, result);
+            result = bond_store_read( &hello_sensor_bond_store, &p_event_data->paired_device_link_keys_request ) ? WICED_BT_SUCCESS : WICED_BT_ERROR;
+            WICED_BT_TRACE("keys read from NVRAM %B result: %d \n", p_event_data->paired_device_link_keys_request.bd_addr, result);
             break;
 
         case BTM_LOCAL_IDENTITY_KEYS_UPDATE_EVT:
@@ -785,6 +1144,15 @@ wiced_result_t hello_sensor_management_cback( wiced_bt_management_evt_t event, w
             }
             break;
 
+        case BTM_BLE_CONNECTION_PARAM_UPDATE:
+            hello_sensor_conn_param_updated( &p_event_data->ble_connection_param_update );
+            break;
+
+        case BTM_BLE_PHY_UPDATE_EVT:
+            WICED_BT_TRACE( "PHY update tx:%d rx:%d\n", p_event_data->ble_phy_update_event.tx_phy, p_event_data->ble_phy_update_event.rx_phy );
+            app_stats_phy_update( p_event_data->ble_phy_update_event.tx_phy, p_event_data->ble_phy_update_event.rx_phy );
+            break;
+
     default:
             break;
     }
@@ -794,62 +1162,254 @@ wiced_result_t hello_sensor_management_cback( wiced_bt_management_evt_t event, w
 
 
 /*
- * Check if client has registered for notification/indication
- * and send message if appropriate
+ * Send the queued values to every connected client
  */
 void hello_sensor_send_message( void )
 {
-    WICED_BT_TRACE( "hello_sensor_send_message: CCC:%d\n", hello_sensor_hostinfo.characteristic_client_configuration );
+    uint8_t i;
+
+    for ( i = 0; i < HELLO_SENSOR_MAX_NUM_CLIENTS; i++ )
+    {
+        if ( hello_sensor_conn[i].conn_id != 0 )
+        {
+            hello_sensor_send_message_to( &hello_sensor_conn[i] );
+        }
+    }
+}
+
+/*
+ * The stack ran out of buffers for a client, send the queued values again
+ */
+void hello_sensor_send_retry_timeout( uint32_t arg )
+{
+    hello_sensor_send_message( );
+}
+
+/*
+ * Check if client has registered for notification/indication and send the
+ * queued values.  Notifications go out back to back until the queue is empty,
+ * the link is congested or the stack runs out of buffers, an indication waits
+ * for its confirmation.
+ */
+void hello_sensor_send_message_to( hello_sensor_conn_t *p_conn )
+{
+    uint8_t                 *p_pdu;
+    uint16_t                max_len;
+    uint16_t                len;
+    uint8_t                 num_values;
+    wiced_bt_gatt_status_t  status;
+
+    WICED_BT_TRACE( "hello_sensor_send_message: conn_id:%d CCC:%d queued:%d\n", p_conn->conn_id, p_conn->characteristic_client_configuration, p_conn->notify_queue.count );
 
     /* If client has not registered for indication or notification, no action */
-    if ( hello_sensor_hostinfo.characteristic_client_configuration == 0 )
+    if ( p_conn->characteristic_client_configuration == 0 )
     {
+        p_conn->notify_queue.count = 0;
         return;
     }
-    else if ( hello_sensor_hostinfo.characteristic_client_configuration & GATT_CLIENT_CONFIG_NOTIFICATION )
-    {
-        uint8_t *p_attr = (uint8_t*)hello_sensor_char_notify_value;
 
-        wiced_bt_gatt_send_notification( hello_sensor_state.conn_id, HANDLE_HSENS_SERVICE_CHAR_NOTIFY_VAL, sizeof(hello_sensor_char_notify_value), p_attr );
+    /* The PDU can carry what fits in the negotiated MTU after the opcode and handle */
+    max_len = p_conn->peer_mtu - 3;
+    if ( max_len > HELLO_SENSOR_NOTIFY_MAX_LEN )
+    {
+        max_len = HELLO_SENSOR_NOTIFY_MAX_LEN;
     }
-    else
+    if ( ( p_pdu = (uint8_t *)buf_pool_stats_get_buffer( max_len ) ) == NULL )
     {
-        if ( !hello_sensor_state.flag_indication_sent )
+        WICED_BT_TRACE( "hello_sensor_send_message: no buffer for %d bytes\n", max_len );
+        app_stats_buf_failure( );
+        timer_wheel_start( &hello_sensor_send_retry_timer, HELLO_SENSOR_SEND_RETRY_MS );
+        return;
+    }
+
+    while ( ( p_conn->notify_queue.count != 0 ) && !p_conn->flag_indication_sent && !p_conn->flag_congested )
+    {
+        num_values = hello_sensor_notify_queue_peek( p_conn, p_pdu, max_len, &len );
+        LATENCY_PROBE( LATENCY_PROBE_TX_SENT, p_conn->conn_id );
+
+        if ( p_conn->characteristic_client_configuration & GATT_CLIENT_CONFIG_NOTIFICATION )
+        {
+            status = wiced_bt_gatt_send_notification( p_conn->conn_id, HANDLE_HSENS_SERVICE_CHAR_NOTIFY_VAL, len, p_pdu );
+        }
+        else
         {
-            uint8_t *p_attr = (uint8_t *)hello_sensor_char_notify_value;
+            status = wiced_bt_gatt_send_indication( p_conn->conn_id, HANDLE_HSENS_SERVICE_CHAR_NOTIFY_VAL, len, p_pdu );
+            if ( status == WICED_BT_GATT_SUCCESS )
+            {
+                p_conn->flag_indication_sent = TRUE;
+            }
+        }
 
-            hello_sensor_state.flag_indication_sent = TRUE;
+        if ( status == WICED_BT_GATT_CONGESTED )
+        {
+            /* Keep the values, GATT_CONGESTION_EVT tells when to try again */
+            p_conn->flag_congested = TRUE;
+            break;
+        }
+        if ( status == WICED_BT_GATT_NO_RESOURCES )
+        {
+            /* Keep the values, no event comes for a shortage of buffers, try again later */
+            timer_wheel_start( &hello_sensor_send_retry_timer, HELLO_SENSOR_SEND_RETRY_MS );
+            break;
+        }
+        app_stats_notify( status );
+        if ( status != WICED_BT_GATT_SUCCESS )
+        {
+            WICED_BT_TRACE( "hello_sensor_send_message: dropped %d values status:%d\n", num_values, status );
+        }
+
+        hello_sensor_notify_queue_remove( &p_conn->notify_queue, num_values );
+    }
+
+    wiced_bt_free_buffer( p_pdu );
+}
+
+/*
+ * Queue a copy of the current notify value.  If the queue is full the oldest
+ * value is dropped, the client is more interested in the latest ones.
+ */
+void hello_sensor_notify_queue_put( hello_sensor_notify_queue_t *p_queue )
+{
+    uint8_t idx;
+
+    if ( p_queue->count == HELLO_SENSOR_NOTIFY_QUEUE_SIZE )
+    {
+        hello_sensor_notify_queue_remove( p_queue, 1 );
+        p_queue->dropped++;
+        WICED_BT_TRACE( "notify queue full, dropped:%d\n", p_queue->dropped );
+    }
+
+    idx = ( p_queue->head + p_queue->count ) % HELLO_SENSOR_NOTIFY_QUEUE_SIZE;
+    memcpy( p_queue->value[idx], hello_sensor_char_notify_value, HELLO_SENSOR_NOTIFY_VALUE_LEN );
+    p_queue->count++;
+    LATENCY_PROBE( LATENCY_PROBE_TX_QUEUED, p_queue->count );
+}
+
+/*
+ * Copy the oldest queued values into a PDU of up to max_len bytes without
+ * removing them.  Only one value is copied unless the client accepts several
+ * values per notification, then as many as fit.  If the client asked for full
+ * PDUs the rest is padded with a running byte counter.  Returns the number of
+ * values copied.
+ */
+uint8_t hello_sensor_notify_queue_peek( hello_sensor_conn_t *p_conn, uint8_t *p_pdu, uint16_t max_len, uint16_t *p_len )
+{
+    uint16_t num_values = 1;
+    uint16_t len;
+    uint8_t  i;
+    uint8_t  idx;
+
+    if ( p_conn->flag_pack_values )
+    {
+        num_values = max_len / HELLO_SENSOR_NOTIFY_VALUE_LEN;
+    }
+    if ( num_values > p_conn->notify_queue.count )
+    {
+        num_values = p_conn->notify_queue.count;
+    }
+
+    for ( i = 0; i < num_values; i++ )
+    {
+        idx = ( p_conn->notify_queue.head + i ) % HELLO_SENSOR_NOTIFY_QUEUE_SIZE;
+        memcpy( &p_pdu[i * HELLO_SENSOR_NOTIFY_VALUE_LEN], p_conn->notify_queue.value[idx], HELLO_SENSOR_NOTIFY_VALUE_LEN );
+    }
 
-            wiced_bt_gatt_send_indication( hello_sensor_state.conn_id, HANDLE_HSENS_SERVICE_CHAR_NOTIFY_VAL, sizeof(hello_sensor_char_notify_value), p_attr );
+    len = num_values * HELLO_SENSOR_NOTIFY_VALUE_LEN;
+    if ( p_conn->flag_fill_mtu )
+    {
+        while ( len < max_len )
+        {
+            p_pdu[len++] = p_conn->fill_seq++;
         }
     }
+
+    *p_len = len;
+    return (uint8_t)num_values;
 }
 
 /*
- * Find attribute description by handle
+ * Remove the oldest values from the queue
  */
-attribute_t * hello_sensor_get_attribute( uint16_t handle )
+void hello_sensor_notify_queue_remove( hello_sensor_notify_queue_t *p_queue, uint8_t num_values )
 {
-    int i;
-    for ( i = 0; i <  sizeof( gauAttributes ) / sizeof( gauAttributes[0] ); i++ )
+    p_queue->head  = ( p_queue->head + num_values ) % HELLO_SENSOR_NOTIFY_QUEUE_SIZE;
+    p_queue->count -= num_values;
+}
+
+/*
+ * Find the client of a connection
+ */
+hello_sensor_conn_t * hello_sensor_conn_find( uint16_t conn_id )
+{
+    uint8_t i;
+
+    for ( i = 0; i < HELLO_SENSOR_MAX_NUM_CLIENTS; i++ )
     {
-        if ( gauAttributes[i].handle == handle )
+        if ( ( conn_id != 0 ) && ( hello_sensor_conn[i].conn_id == conn_id ) )
         {
-            return ( &gauAttributes[i] );
+            return &hello_sensor_conn[i];
         }
     }
-    WICED_BT_TRACE( "attr not found:%x\n", handle );
     return NULL;
 }
 
+/*
+ * Number of connected clients
+ */
+uint8_t hello_sensor_conn_count( void )
+{
+    uint8_t i;
+    uint8_t count = 0;
+
+    for ( i = 0; i < HELLO_SENSOR_MAX_NUM_CLIENTS; i++ )
+    {
+        if ( hello_sensor_conn[i].conn_id != 0 )
+        {
+            count++;
+        }
+    }
+    return count;
+}
+
+/*
+ * Check if any client still has to confirm an indication
+ */
+wiced_bool_t hello_sensor_indication_pending( void )
+{
+    uint8_t i;
+
+    for ( i = 0; i < HELLO_SENSOR_MAX_NUM_CLIENTS; i++ )
+    {
+        if ( ( hello_sensor_conn[i].conn_id != 0 ) && hello_sensor_conn[i].flag_indication_sent )
+        {
+            return WICED_TRUE;
+        }
+    }
+    return WICED_FALSE;
+}
+
+/*
+ * Find attribute description by handle
+ */
+attribute_t * hello_sensor_get_attribute( uint16_t handle )
+{
+    attribute_t *puAttribute = gatt_attr_index_find( &hello_sensor_attr_index, handle );
+
+    if ( puAttribute == NULL )
+    {
+        WICED_BT_TRACE( "attr not found:%x\n", handle );
+    }
+    return puAttribute;
+}
+
 
 /*
  * Process Read request or command from peer device
  */
 wiced_bt_gatt_status_t hello_sensor_gatts_req_read_handler( uint16_t conn_id, wiced_bt_gatt_read_t * p_read_data )
 {
-    attribute_t *puAttribute;
-    int          attr_len_to_copy;
+    attribute_t         *puAttribute;
+    hello_sensor_conn_t *p_conn;
 
     if ( ( puAttribute = hello_sensor_get_attribute(p_read_data->handle) ) == NULL)
     {
@@ -867,33 +1427,23 @@ wiced_bt_gatt_status_t hello_sensor_gatts_req_read_handler( uint16_t conn_id, wi
     }
 
 
-    attr_len_to_copy = puAttribute->attr_len;
-
-    WICED_BT_TRACE("read_hndlr conn_id:%d hdl:%x offset:%d len:%d\n", conn_id, p_read_data->handle, p_read_data->offset, attr_len_to_copy );
-
-    if ( p_read_data->offset >= puAttribute->attr_len )
+#ifdef APP_STATS_GATT
+    /* Counters are packed when a read starts, the read blobs go on from that copy */
+    if ( ( p_read_data->handle == HANDLE_HSENS_SERVICE_CHAR_STATS_VAL ) && ( p_read_data->offset == 0 ) )
     {
-        attr_len_to_copy = 0;
+        puAttribute->attr_len = app_stats_pack( hello_sensor_char_stats_value, sizeof( hello_sensor_char_stats_value ) );
     }
+#endif
 
-    if ( attr_len_to_copy != 0 )
-    {
-        uint8_t *from;
-        int      to_copy = attr_len_to_copy - p_read_data->offset;
-
-
-        if ( to_copy > *p_read_data->p_val_len )
-        {
-            to_copy = *p_read_data->p_val_len;
-        }
-
-        from = ((uint8_t *)puAttribute->p_attr) + p_read_data->offset;
-        *p_read_data->p_val_len = to_copy;
+    APP_LOG_DBG("read_hndlr conn_id:%d hdl:%x offset:%d len:%d\n", conn_id, p_read_data->handle, p_read_data->offset, puAttribute->attr_len );
 
-        memcpy( p_read_data->p_val, from, to_copy);
+    /* Every client has its own client configuration */
+    if ( ( p_read_data->handle == HANDLE_HSENS_SERVICE_CHAR_CFG_DESC ) && ( ( p_conn = hello_sensor_conn_find( conn_id ) ) != NULL ) )
+    {
+        return gatt_attr_read( &p_conn->characteristic_client_configuration, 2, p_read_data );
     }
 
-    return WICED_BT_GATT_SUCCESS;
+    return gatt_attr_read( puAttribute->p_attr, puAttribute->attr_len, p_read_data );
 }
 
 /*
@@ -904,9 +1454,21 @@ wiced_bt_gatt_status_t hello_sensor_gatts_req_write_handler( uint16_t conn_id, w
     wiced_bt_gatt_status_t result    = WICED_BT_GATT_SUCCESS;
     uint8_t                *p_attr   = p_data->p_val;
     uint8_t                nv_update = WICED_FALSE;
+    hello_sensor_conn_t    *p_conn;
 
     WICED_BT_TRACE("write_handler: conn_id:%d hdl:0x%x prep:%d offset:%d len:%d\n ", conn_id, p_data->handle, p_data->is_prep, p_data->offset, p_data->val_len );
 
+    if ( ( p_conn = hello_sensor_conn_find( conn_id ) ) == NULL )
+    {
+        return WICED_BT_GATT_ERROR;
+    }
+
+    /* Prepared writes are only applied on execute */
+    if ( p_data->is_prep )
+    {
+        return hello_sensor_prep_write_queue( &p_conn->prep_write, p_data );
+    }
+
     switch ( p_data->handle )
     {
     /* By writing into Characteristic Client Configuration descriptor
@@ -916,16 +1478,28 @@ wiced_bt_gatt_status_t hello_sensor_gatts_req_write_handler( uint16_t conn_id, w
         {
             return WICED_BT_GATT_INVALID_ATTR_LEN;
         }
-        hello_sensor_hostinfo.characteristic_client_configuration = p_attr[0] | ( p_attr[1] << 8 );
-        nv_update = WICED_TRUE;
+        p_conn->characteristic_client_configuration = p_attr[0] | ( p_attr[1] << 8 );
+
+        /* Only the configuration of the host saved in the NVRAM survives a disconnection */
+        if ( memcmp( p_conn->remote_addr, hello_sensor_hostinfo.bdaddr, sizeof( BD_ADDR ) ) == 0 )
+        {
+            hello_sensor_hostinfo.characteristic_client_configuration = p_conn->characteristic_client_configuration;
+            nv_update = WICED_TRUE;
+        }
         break;
 
     case HANDLE_HSENS_SERVICE_CHAR_BLINK_VAL:
-        if ( p_data->val_len != 1 )
+        if ( ( p_data->val_len != 1 ) && ( p_data->val_len != 2 ) )
         {
             return WICED_BT_GATT_INVALID_ATTR_LEN;
         }
         hello_sensor_hostinfo.number_of_blinks = p_attr[0];
+
+        /* Optional second byte tells which features the client supports */
+        p_conn->flag_pack_values = ( p_data->val_len == 2 ) && ( p_attr[1] & HELLO_SENSOR_CONFIG_PACK_VALUES );
+        p_conn->flag_fill_mtu    = ( p_data->val_len == 2 ) && ( p_attr[1] & HELLO_SENSOR_CONFIG_FILL_MTU );
+        p_conn->flag_stream      = ( p_data->val_len == 2 ) && ( p_attr[1] & HELLO_SENSOR_CONFIG_STREAM );
+        hello_sensor_sample_timer_update();
         if ( hello_sensor_hostinfo.number_of_blinks != 0 )
         {
             WICED_BT_TRACE( "hello_sensor_write_handler:num blinks: %d\n", hello_sensor_hostinfo.number_of_blinks );
@@ -937,6 +1511,16 @@ wiced_bt_gatt_status_t hello_sensor_gatts_req_write_handler( uint16_t conn_id, w
         }
         break;
 
+    case HANDLE_HSENS_SERVICE_CHAR_LONG_MSG_VAL:
+        if ( ( p_data->offset + p_data->val_len ) > HELLO_SENSOR_LONG_MSG_MAX_LEN )
+        {
+            return WICED_BT_GATT_INVALID_ATTR_LEN;
+        }
+        memcpy( &hello_sensor_char_long_msg_value[p_data->offset], p_attr, p_data->val_len );
+        hello_sensor_get_attribute( HANDLE_HSENS_SERVICE_CHAR_LONG_MSG_VAL )->attr_len = p_data->offset + p_data->val_len;
+        WICED_BT_TRACE( "long msg len:%d\n", p_data->offset + p_data->val_len );
+        break;
+
     default:
         result = WICED_BT_GATT_INVALID_HANDLE;
         break;
@@ -944,9 +1528,7 @@ wiced_bt_gatt_status_t hello_sensor_gatts_req_write_handler( uint16_t conn_id, w
 
     if ( nv_update )
     {
-        wiced_result_t rc;
-        int bytes_written = wiced_hal_write_nvram( HELLO_SENSOR_VS_ID, sizeof(hello_sensor_hostinfo), (uint8_t*)&hello_sensor_hostinfo, &rc );
-        WICED_BT_TRACE("NVRAM write:%d rc:%d", bytes_written, rc);
+        hello_sensor_hostinfo_update();
     }
 
     return result;
@@ -957,16 +1539,117 @@ wiced_bt_gatt_status_t hello_sensor_gatts_req_write_handler( uint16_t conn_id, w
  */
 wiced_bt_gatt_status_t hello_sensor_gatts_req_write_exec_handler( uint16_t conn_id, wiced_bt_gatt_exec_flag_t exec_falg )
 {
+    wiced_bt_gatt_write_t  write_req;
+    wiced_bt_gatt_status_t result = WICED_BT_GATT_SUCCESS;
+    hello_sensor_conn_t    *p_conn;
+
     WICED_BT_TRACE("write exec: flag:%d\n", exec_falg);
+
+    if ( ( p_conn = hello_sensor_conn_find( conn_id ) ) == NULL )
+    {
+        return WICED_BT_GATT_ERROR;
+    }
+
+    /* Apply the reassembled value in one write, or drop it if the client cancelled */
+    if ( ( exec_falg == GATT_PREP_WRITE_EXEC ) && ( p_conn->prep_write.p_value != NULL ) )
+    {
+        memset( &write_req, 0, sizeof( write_req ) );
+        write_req.handle  = p_conn->prep_write.handle;
+        write_req.p_val   = p_conn->prep_write.p_value;
+        write_req.val_len = p_conn->prep_write.len;
+
+        result = hello_sensor_gatts_req_write_handler( conn_id, &write_req );
+    }
+
+    hello_sensor_prep_write_free( &p_conn->prep_write );
+    return result;
+}
+
+/*
+ * Queue a prepared write of a client.  The writes of one execute must be for the same
+ * attribute; they are reassembled over its current value so that writes at
+ * an offset keep the bytes in front of them.
+ */
+wiced_bt_gatt_status_t hello_sensor_prep_write_queue( hello_sensor_prep_write_t *p_prep, wiced_bt_gatt_write_t *p_data )
+{
+    attribute_t *puAttribute;
+
+    if ( p_prep->p_value == NULL )
+    {
+        if ( ( puAttribute = hello_sensor_get_attribute( p_data->handle ) ) == NULL )
+        {
+            return WICED_BT_GATT_INVALID_HANDLE;
+        }
+        if ( ( p_prep->p_value = (uint8_t *)buf_pool_stats_get_buffer( HELLO_SENSOR_LONG_MSG_MAX_LEN ) ) == NULL )
+        {
+            app_stats_buf_failure( );
+            return WICED_BT_GATT_PREPARE_Q_FULL;
+        }
+
+        p_prep->handle = p_data->handle;
+        p_prep->len    = 0;
+        if ( puAttribute->attr_len <= HELLO_SENSOR_LONG_MSG_MAX_LEN )
+        {
+            memcpy( p_prep->p_value, puAttribute->p_attr, puAttribute->attr_len );
+        }
+    }
+    else if ( p_prep->handle != p_data->handle )
+    {
+        WICED_BT_TRACE( "prep write hdl:0x%x while 0x%x queued\n", p_data->handle, p_prep->handle );
+        return WICED_BT_GATT_PREPARE_Q_FULL;
+    }
+
+    if ( p_data->offset > HELLO_SENSOR_LONG_MSG_MAX_LEN )
+    {
+        return WICED_BT_GATT_INVALID_OFFSET;
+    }
+    if ( ( p_data->offset + p_data->val_len ) > HELLO_SENSOR_LONG_MSG_MAX_LEN )
+    {
+        return WICED_BT_GATT_PREPARE_Q_FULL;
+    }
+
+    memcpy( &p_prep->p_value[p_data->offset], p_data->p_val, p_data->val_len );
+    if ( ( p_data->offset + p_data->val_len ) > p_prep->len )
+    {
+        p_prep->len = p_data->offset + p_data->val_len;
+    }
+
     return WICED_BT_GATT_SUCCESS;
 }
 
+/*
+ * Drop the prepared writes
+ */
+void hello_sensor_prep_write_free( hello_sensor_prep_write_t *p_prep )
+{
+    if ( p_prep->p_value != NULL )
+    {
+        wiced_bt_free_buffer( p_prep->p_value );
+    }
+    memset( p_prep, 0, sizeof( hello_sensor_prep_write_t ) );
+}
+
 /*
  * Process MTU request from the peer
  */
 wiced_bt_gatt_status_t hello_sensor_gatts_req_mtu_handler( uint16_t conn_id, uint16_t mtu)
 {
+    hello_sensor_conn_t *p_conn = hello_sensor_conn_find( conn_id );
+
     WICED_BT_TRACE("req_mtu: %d\n", mtu);
+
+    /* Notifications are sized to the MTU both sides can handle */
+#if !defined(CYW20706A2)
+    if ( mtu > wiced_bt_cfg_settings.gatt_cfg.max_mtu_size )
+    {
+        mtu = wiced_bt_cfg_settings.gatt_cfg.max_mtu_size;
+    }
+#endif
+    if ( p_conn != NULL )
+    {
+        p_conn->peer_mtu = mtu;
+    }
+
     return WICED_BT_GATT_SUCCESS;
 }
 
@@ -982,29 +1665,28 @@ wiced_bt_gatt_status_t hello_sensor_gatts_req_mtu_handler( uint16_t conn_id, uin
  */
 wiced_bt_gatt_status_t hello_sensor_gatts_req_conf_handler( uint16_t conn_id, uint16_t handle )
 {
+    hello_sensor_conn_t *p_conn = hello_sensor_conn_find( conn_id );
+
     WICED_BT_TRACE( "hello_sensor_indication_cfm, conn %d hdl %d\n", conn_id, handle );
+    LATENCY_PROBE( LATENCY_PROBE_TX_COMPLETE, conn_id );
 
-    if ( !hello_sensor_state.flag_indication_sent )
+    if ( ( p_conn == NULL ) || !p_conn->flag_indication_sent )
     {
         WICED_BT_TRACE("Hello: Wrong Confirmation!");
         return WICED_BT_GATT_SUCCESS;
     }
 
-    hello_sensor_state.flag_indication_sent = 0;
+    p_conn->flag_indication_sent = 0;
 
     /* We might need to send more indications */
-    if ( hello_sensor_state.num_to_write )
-    {
-        hello_sensor_state.num_to_write--;
-        hello_sensor_send_message();
-    }
+    hello_sensor_send_message_to( p_conn );
     /* if we sent all messages, start connection idle timer to disconnect */
-    if ( !hello_sensor_state.flag_stay_connected && !hello_sensor_state.flag_indication_sent )
+    if ( !hello_sensor_state.flag_stay_connected && !hello_sensor_indication_pending() )
     {
-        if (wiced_is_timer_in_use(&hello_sensor_conn_idle_timer) )
+        if (timer_wheel_in_use(&hello_sensor_conn_idle_timer) )
         {
-            wiced_stop_timer(&hello_sensor_conn_idle_timer);
-            wiced_start_timer(&hello_sensor_conn_idle_timer, HELLO_SENSOR_CONN_IDLE_TIMEOUT_IN_SECONDS);
+            timer_wheel_stop(&hello_sensor_conn_idle_timer);
+            timer_wheel_start(&hello_sensor_conn_idle_timer, HELLO_SENSOR_CONN_IDLE_TIMEOUT_IN_SECONDS * 1000);
         }
     }
 
@@ -1014,28 +1696,48 @@ wiced_bt_gatt_status_t hello_sensor_gatts_req_conf_handler( uint16_t conn_id, ui
 /* This function is invoked when connection is established */
 wiced_bt_gatt_status_t hello_sensor_gatts_connection_up( wiced_bt_gatt_connection_status_t *p_status )
 {
-    wiced_result_t result;
+    hello_sensor_conn_t *p_conn = NULL;
+    uint8_t             i;
 
     WICED_BT_TRACE( "hello_sensor_conn_up %B id:%d\n:", p_status->bd_addr, p_status->conn_id);
 
+    /* Take a free client entry, the stack allows no more links than there are entries */
+    for ( i = 0; ( i < HELLO_SENSOR_MAX_NUM_CLIENTS ) && ( p_conn == NULL ); i++ )
+    {
+        if ( hello_sensor_conn[i].conn_id == 0 )
+        {
+            p_conn = &hello_sensor_conn[i];
+        }
+    }
+    if ( p_conn == NULL )
+    {
+        WICED_BT_TRACE( "no free client entry\n" );
+        wiced_bt_gatt_disconnect( p_status->conn_id );
+        return WICED_BT_GATT_SUCCESS;
+    }
+
     /* Update the connection handler.  Save address of the connected device. */
-    hello_sensor_state.conn_id = p_status->conn_id;
-    memcpy(hello_sensor_state.remote_addr, p_status->bd_addr, sizeof(BD_ADDR));
+    memset( p_conn, 0, sizeof( hello_sensor_conn_t ) );
+    p_conn->conn_id  = p_status->conn_id;
+    p_conn->peer_mtu = GATT_DEF_BLE_MTU_SIZE;
+    p_conn->conn_interval = HELLO_SENSOR_DEFAULT_CONN_INTERVAL;
+    memcpy( p_conn->remote_addr, p_status->bd_addr, sizeof(BD_ADDR) );
+    app_stats_conn_up( );
 
-    /* Stop idle timer */
-    wiced_stop_timer(&hello_sensor_conn_idle_timer);
+    /* Values pushed while nobody was connected go to the first client */
+    memcpy( &p_conn->notify_queue, &hello_sensor_notify_backlog, sizeof( hello_sensor_notify_queue_t ) );
+    memset( &hello_sensor_notify_backlog, 0, sizeof( hello_sensor_notify_queue_t ) );
 
-    /* Saving host info in NVRAM  */
-    memcpy( hello_sensor_hostinfo.bdaddr, p_status->bd_addr, sizeof( BD_ADDR ) );
-    hello_sensor_hostinfo.characteristic_client_configuration = 0;
-    hello_sensor_hostinfo.number_of_blinks                    = 0;
+    /* Stop idle timer */
+    timer_wheel_stop(&hello_sensor_conn_idle_timer);
 
+    /* Saving host info in NVRAM, the first client connected is the one saved */
+    if ( hello_sensor_conn_count() == 1 )
     {
-        uint8_t bytes_written = 0;
-        bytes_written = wiced_hal_write_nvram( HELLO_SENSOR_VS_ID, sizeof(hello_sensor_hostinfo), (uint8_t*)&hello_sensor_hostinfo, &result );
-
-        WICED_BT_TRACE("NVRAM write %d\n", bytes_written);
-        UNUSED_VARIABLE(bytes_written);
+        memcpy( hello_sensor_hostinfo.bdaddr, p_status->bd_addr, sizeof( BD_ADDR ) );
+        hello_sensor_hostinfo.characteristic_client_configuration = 0;
+        hello_sensor_hostinfo.number_of_blinks                    = 0;
+        hello_sensor_hostinfo_update();
     }
 
     return WICED_BT_GATT_SUCCESS;
@@ -1046,27 +1748,34 @@ wiced_bt_gatt_status_t hello_sensor_gatts_connection_up( wiced_bt_gatt_connectio
  */
 wiced_bt_gatt_status_t hello_sensor_gatts_connection_down( wiced_bt_gatt_connection_status_t *p_status )
 {
-    wiced_result_t result;
+    hello_sensor_conn_t *p_conn = hello_sensor_conn_find( p_status->conn_id );
 
-    WICED_BT_TRACE( "connection_down %B conn_id:%d reason:%d\n", hello_sensor_state.remote_addr, p_status->conn_id, p_status->reason );
+    WICED_BT_TRACE( "connection_down %B conn_id:%d reason:%d\n", p_status->bd_addr, p_status->conn_id, p_status->reason );
+    app_stats_conn_down( p_status->reason );
+
+    /* Write back what the client changed during the connection */
+    hello_sensor_hostinfo_flush();
+
+    if ( p_conn != NULL )
+    {
+        /* Writes not executed before the disconnection are discarded */
+        hello_sensor_prep_write_free( &p_conn->prep_write );
 
-    /* Resetting the device info */
-    memset( hello_sensor_state.remote_addr, 0, 6 );
-    hello_sensor_state.conn_id = 0;
+        /* Resetting the device info, values not sent to this client are dropped */
+        memset( p_conn, 0, sizeof( hello_sensor_conn_t ) );
+        hello_sensor_sample_timer_update();
+    }
 
     /*
      * If we are configured to stay connected, disconnection was
-     * caused by the peer, start low advertisements, so that peer
-     * can connect when it wakes up
+     * caused by the peer, restart the advertising schedule, so that
+     * peer can connect quickly when it comes back
      */
     if ( hello_sensor_state.flag_stay_connected )
     {
-        result =  wiced_bt_start_advertisements( BTM_BLE_ADVERT_UNDIRECTED_LOW, 0, NULL );
-        WICED_BT_TRACE( "wiced_bt_start_advertisements %d\n", result );
+        hello_sensor_adv_restart();
     }
 
-    UNUSED_VARIABLE(result);
-
     return WICED_BT_SUCCESS;
 }
 
@@ -1090,6 +1799,7 @@ wiced_bt_gatt_status_t hello_sensor_gatts_req_cb( wiced_bt_gatt_attribute_reques
 {
     wiced_bt_gatt_status_t result = WICED_BT_GATT_INVALID_PDU;
 
+    LATENCY_PROBE( LATENCY_PROBE_GATT_REQ, p_data->request_type );
     WICED_BT_TRACE( "hello_sensor_gatts_req_cb. conn %d, type %d\n", p_data->conn_id, p_data->request_type );
 
     switch ( p_data->request_type )
@@ -1118,6 +1828,7 @@ wiced_bt_gatt_status_t hello_sensor_gatts_req_cb( wiced_bt_gatt_attribute_reques
         break;
     }
 
+    app_stats_gatt_status( result );
     return result;
 }
 
@@ -1127,6 +1838,7 @@ wiced_bt_gatt_status_t hello_sensor_gatts_req_cb( wiced_bt_gatt_attribute_reques
 wiced_bt_gatt_status_t hello_sensor_gatts_callback( wiced_bt_gatt_evt_t event, wiced_bt_gatt_event_data_t *p_data)
 {
     wiced_bt_gatt_status_t result = WICED_BT_GATT_INVALID_PDU;
+    hello_sensor_conn_t    *p_conn;
 
     switch(event)
     {
@@ -1138,6 +1850,16 @@ wiced_bt_gatt_status_t hello_sensor_gatts_callback( wiced_bt_gatt_evt_t event, w
         result = hello_sensor_gatts_req_cb( &p_data->attribute_request );
         break;
 
+    case GATT_CONGESTION_EVT:
+        WICED_BT_TRACE( "congestion conn %d congested %d\n", p_data->congestion.conn_id, p_data->congestion.congested );
+        if ( ( p_conn = hello_sensor_conn_find( p_data->congestion.conn_id ) ) != NULL )
+        {
+            p_conn->flag_congested = p_data->congestion.congested;
+            hello_sensor_send_message_to( p_conn );
+        }
+        result = WICED_BT_GATT_SUCCESS;
+        break;
+
     default:
         break;
     }
@@ -1162,23 +1884,84 @@ void hello_sensor_gatts_increment_notify_value( void )
     hello_sensor_char_notify_value[last_byte] = c;
 }
 
-static void hello_sensor_load_keys_for_address_resolution( void )
+/*
+ * Handle HCI_CONTROL_LE_COMMAND_SET_ADV_SCHEDULE.  The new schedule starts
+ * right away if the sensor is looking for a client.
+ */
+static uint8_t hello_sensor_cmd_set_adv_schedule( uint16_t opcode, uint8_t *p_data, uint32_t data_len )
 {
-    wiced_bt_device_link_keys_t link_keys;
-    wiced_result_t              result;
-    uint8_t                     *p;
+    hello_sensor_adv_schedule_t schedule;
 
-    memset( &link_keys, 0, sizeof(wiced_bt_device_link_keys_t));
-    p = (uint8_t*)&link_keys;
-    wiced_hal_read_nvram( HELLO_SENSOR_PAIRED_KEYS_VS_ID, sizeof(wiced_bt_device_link_keys_t), p, &result);
+    STREAM_TO_UINT16( schedule.fast_duration, p_data );
+    STREAM_TO_UINT16( schedule.burst_duration, p_data );
+    STREAM_TO_UINT16( schedule.min_pause, p_data );
+    STREAM_TO_UINT16( schedule.max_pause, p_data );
 
-    if(result == WICED_BT_SUCCESS)
+    if ( ( schedule.fast_duration == 0 ) || ( schedule.burst_duration == 0 ) ||
+         ( ( schedule.max_pause != 0 ) && ( ( schedule.min_pause == 0 ) || ( schedule.min_pause > schedule.max_pause ) ) ) )
     {
-#ifdef CYW20706A2
-        result = wiced_bt_dev_add_device_to_address_resolution_db ( &link_keys, link_keys.key_data.ble_addr_type );
-#else
-        result = wiced_bt_dev_add_device_to_address_resolution_db ( &link_keys );
+        return HCI_CONTROL_STATUS_INVALID_ARGS;
+    }
+
+    hello_sensor_adv_schedule = schedule;
+    WICED_BT_TRACE( "adv schedule fast:%d burst:%d pause:%d..%d\n", schedule.fast_duration, schedule.burst_duration, schedule.min_pause, schedule.max_pause );
+
+    if ( hello_sensor_state.adv_phase != HELLO_SENSOR_ADV_PHASE_IDLE )
+    {
+        hello_sensor_adv_restart();
+    }
+    return HCI_CONTROL_STATUS_SUCCESS;
+}
+
+/* HCI commands of the application, sorted by opcode */
+static const hci_control_cmd_entry_t hello_sensor_cmd_table[] =
+{
+    HCI_CONTROL_CMD_ENTRY( HCI_CONTROL_LE_COMMAND_SET_ADV_SCHEDULE, 8, hello_sensor_cmd_set_adv_schedule ),
+    HCI_CONTROL_CMD_ENTRY( HCI_CONTROL_MISC_COMMAND_READ_BUF_POOLS, 0, buf_pool_stats_cmd_read ),
+    HCI_CONTROL_CMD_ENTRY( HCI_CONTROL_MISC_COMMAND_READ_STATS,     0, app_stats_cmd_read ),
+    HCI_CONTROL_CMD_ENTRY( HCI_CONTROL_MISC_COMMAND_RESET_STATS,    0, app_stats_cmd_reset ),
+#ifdef LATENCY_PROBES
+    HCI_CONTROL_CMD_ENTRY( HCI_CONTROL_MISC_COMMAND_READ_PROBES,    0, latency_probe_cmd_read ),
 #endif
+};
+
+/*
+ * Handle a command packet received from the MCU over the WICED HCI transport
+ */
+uint32_t hello_sensor_proc_rx_cmd( uint8_t *p_buffer, uint32_t length )
+{
+    uint16_t opcode;
+    uint16_t payload_len;
+    uint8_t  *p_data = p_buffer;
+    uint8_t  status;
+
+    /* Expected minimum 4 byte as the wiced header */
+    if ( ( p_buffer == NULL ) || ( length < 4 ) )
+    {
+        if ( p_buffer != NULL )
+        {
+            wiced_transport_free_buffer( p_buffer );
+        }
+        return HCI_CONTROL_STATUS_INVALID_ARGS;
+    }
+
+    STREAM_TO_UINT16( opcode, p_data );
+    STREAM_TO_UINT16( payload_len, p_data );
+    LATENCY_PROBE( LATENCY_PROBE_HCI_CMD_RX, opcode );
+
+    WICED_BT_TRACE( "hello_sensor_proc_rx_cmd:%s len:%d\n", hci_control_cmd_name( hello_sensor_cmd_table, HCI_CONTROL_CMD_TABLE_SIZE( hello_sensor_cmd_table ), opcode ), payload_len );
+
+    if ( payload_len > length - 4 )
+    {
+        status = HCI_CONTROL_STATUS_INVALID_ARGS;
+    }
+    else
+    {
+        status = hci_control_dispatch( hello_sensor_cmd_table, HCI_CONTROL_CMD_TABLE_SIZE( hello_sensor_cmd_table ), opcode, p_data, payload_len );
     }
-    WICED_BT_TRACE("hello_sensor_load_keys_for_address_resolution %B result:%d \n", p, result );
+    LATENCY_PROBE( LATENCY_PROBE_HCI_CMD_DONE, opcode );
+    wiced_transport_send_data( HCI_CONTROL_EVENT_COMMAND_STATUS, &status, 1 );
+
+    wiced_transport_free_buffer( p_buffer );
+    return 0;
 }
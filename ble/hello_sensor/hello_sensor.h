@@ -53,20 +53,70 @@
 /******************************************************************************
  *                                Constants
  ******************************************************************************/
-#define HELLO_SENSOR_MAX_NUM_CLIENTS 1
+/* Number of centrals connected at the same time */
+#define HELLO_SENSOR_MAX_NUM_CLIENTS 3
 
 /* Hello Sensor App Timer Timeout in seconds  */
 #define HELLO_SENSOR_APP_TIMEOUT_IN_SECONDS                 1
 
-/* Hello Sensor App Fine Timer Timeout in milli seconds  */
-#define HELLO_SENSOR_APP_FINE_TIMEOUT_IN_MS                 1
-
 /* Hello Sensor Connection Idle  Timeout in milli seconds  */
 #define HELLO_SENSOR_CONN_IDLE_TIMEOUT_IN_SECONDS           3
 
+/* Largest value of the Hello Long Message characteristic, also the size of the prepare write buffer */
+#define HELLO_SENSOR_LONG_MSG_MAX_LEN                       256
+
+/* Default adaptive advertising schedule in seconds.  High duty advertising
+ * runs for the fast window after boot, a button push or a disconnection, then
+ * low duty bursts alternate with pauses that double up to the maximum pause.
+ * A maximum pause of 0 keeps low duty advertising on without pauses. */
+#define HELLO_SENSOR_ADV_FAST_DURATION_IN_SECONDS           30
+#define HELLO_SENSOR_ADV_BURST_DURATION_IN_SECONDS          10
+#define HELLO_SENSOR_ADV_MIN_PAUSE_IN_SECONDS               5
+#define HELLO_SENSOR_ADV_MAX_PAUSE_IN_SECONDS               320
+
+/* Delay in milli seconds between a host info change and its NVRAM write-back */
+#define HELLO_SENSOR_NVRAM_FLUSH_DELAY_IN_MS                2000
+
+/* How late a blink of the LED may toggle to share the wake-up of another timer */
+#define HELLO_SENSOR_LED_TIMER_SLACK_MS                     10
+
+/* Delay in milli seconds before sending the queued values again after the stack ran out of buffers */
+#define HELLO_SENSOR_SEND_RETRY_MS                          20
+
+/* Hello Sensor values waiting to be notified, oldest is dropped when full */
+#define HELLO_SENSOR_NOTIFY_QUEUE_SIZE                      16
+
+/* Bit in the second byte of a Hello Configuration write, client accepts several values per notification */
+#define HELLO_SENSOR_CONFIG_PACK_VALUES                     0x01
+
+/* Bit in the second byte of a Hello Configuration write, pad every notification to the MTU with a byte counter */
+#define HELLO_SENSOR_CONFIG_FILL_MTU                        0x02
+
+/* Bit in the second byte of a Hello Configuration write, stream one value per connection interval */
+#define HELLO_SENSOR_CONFIG_STREAM                          0x04
+
+/* Connection interval in 1.25 ms units assumed until the stack reports the negotiated one */
+#define HELLO_SENSOR_DEFAULT_CONN_INTERVAL                  24
+
+/* Largest notification payload, the ATT limit on the length of a value */
+#define HELLO_SENSOR_NOTIFY_MAX_LEN                         512
+
+/* Seconds between two RSSI reads for the statistics, the clients are read in turn */
+#define HELLO_SENSOR_RSSI_PERIOD                            10
+
+/* Set the advertising schedule, payload: fast window, burst, minimum pause, maximum pause (uint16 seconds each) */
+#ifndef HCI_CONTROL_LE_COMMAND_SET_ADV_SCHEDULE
+#define HCI_CONTROL_LE_COMMAND_SET_ADV_SCHEDULE             ( ( HCI_CONTROL_GROUP_LE << 8 ) | 0x30 )
+#endif
+
 #define HELLO_SENSOR_VS_ID                      WICED_NVRAM_VSID_START
 #define HELLO_SENSOR_LOCAL_KEYS_VS_ID          ( WICED_NVRAM_VSID_START + 1 )
-#define HELLO_SENSOR_PAIRED_KEYS_VS_ID          ( WICED_NVRAM_VSID_START + 2 )
+#define HELLO_SENSOR_PAIRED_KEYS_VS_ID          ( WICED_NVRAM_VSID_START + 2 )   /* BOND_STORE_NUM_VS_ID( HELLO_SENSOR_MAX_BONDS ) ids */
+
+/* Clients whose keys are saved, and loaded to the address resolution database at startup */
+#ifndef HELLO_SENSOR_MAX_BONDS
+#define HELLO_SENSOR_MAX_BONDS                  BOND_STORE_MAX_DEVICES
+#endif
 
 #ifdef CYW20706A2
 #define HELLO_SENSOR_GPIO_BUTTON_SETTINGS       WICED_GPIO_BUTTON_SETTINGS( GPIO_EN_INT_RISING_EDGE )
@@ -105,6 +155,9 @@
 /* UUID value of the Hello Sensor Characteristic, Configuration */
 #define UUID_HELLO_CHARACTERISTIC_LONG_MSG    0x2a, 0x99, 0x17, 0x5a, 0x3f, 0x4b, 0x8e, 0xb6, 0x91, 0x54, 0x2f, 0x09, 0xb8, 0x02, 0xab, 0x6e
 
+/* UUID value of the Hello Sensor Characteristic, Statistics */
+#define UUID_HELLO_CHARACTERISTIC_STATS       0x3b, 0xa9, 0x27, 0x6a, 0x4f, 0x5b, 0x9e, 0xc6, 0xa1, 0x64, 0x3f, 0x19, 0xc8, 0x12, 0xbb, 0x7e
+
 /******************************************************************************
  *                         Type Definitions
  ******************************************************************************/
@@ -131,6 +184,9 @@ typedef enum
         HANDLE_HSENS_SERVICE_CHAR_LONG_MSG, // characteristic handl
         HANDLE_HSENS_SERVICE_CHAR_LONG_MSG_VAL, //long  char value handl......
 
+        HANDLE_HSENS_SERVICE_CHAR_STATS, // characteristic handl, in the database with APP_STATS_GATT
+        HANDLE_HSENS_SERVICE_CHAR_STATS_VAL, // char value handle
+
     HANDLE_HSENS_DEV_INFO_SERVICE = 0x40,
         HANDLE_HSENS_DEV_INFO_SERVICE_CHAR_MFR_NAME, // characteristic handle
         HANDLE_HSENS_DEV_INFO_SERVICE_CHAR_MFR_NAME_VAL,// char value handle
@@ -40,6 +40,8 @@
 #include "wiced_bt_ble.h"
 #include "wiced_bt_gatt.h"
 #include "wiced_bt_cfg.h"
+#include "hello_sensor.h"
+#include "bond_store.h"
 
 /*****************************************************************************
  * wiced_bt core stack configuration
@@ -126,7 +128,7 @@ const wiced_bt_cfg_settings_t wiced_bt_cfg_settings =
     {
         .appearance                     = APPEARANCE_GENERIC_TAG,                                      /**< GATT appearance (see gatt_appearance_e) */
         .client_max_links               = 0,                                                           /**< Client config: maximum number of servers that local client can connect to  */
-        .server_max_links               = 1,                                                           /**< Server config: maximum number of remote clients connections allowed by the local */
+        .server_max_links               = HELLO_SENSOR_MAX_NUM_CLIENTS,                                /**< Server config: maximum number of remote clients connections allowed by the local */
         .max_attr_len                   = 512,                                                         /**< Maximum attribute length; gki_cfg must have a corresponding buffer pool that can hold this length */
 #if !defined(CYW20706A2)
         .max_mtu_size                   = 515                                                          /**< Maximum MTU size for GATT connections, should be between 23 and (max_attr_len + 5) */
@@ -172,7 +174,7 @@ const wiced_bt_cfg_settings_t wiced_bt_cfg_settings =
     },
 
     /* LE Address Resolution DB size  */
-    .addr_resolution_db_size            = 5,                                                           /**< LE Address Resolution DB settings - effective only for pre 4.2 controller*/
+    .addr_resolution_db_size            = BOND_STORE_ADDR_RESOLUTION_DB_SIZE,                          /**< LE Address Resolution DB settings - effective only for pre 4.2 controller*/
 
 #ifdef CYW20706A2
     .max_mtu_size                       = 360,                                                         /**< Maximum MTU size for GATT connections, should be between 23 and (max_attr_len + 5) */
@@ -38,12 +38,14 @@
 * The HRC snippet application shows how to initialize and use WICED BT Heart Rate
 * Client library. This snippet implements GAP central role
 *
-* On initialization, the application starts scanning and connects to a nearby peripheral that advertises
-* Heart Rate Service UUID. After connecting successfully, application calls HRC library
-* to start GATT discovery for HRS characteristics and descriptors. The library then issues
-* callbacks to notify status of the discovery operation. On successful discovery,
-* application configures HRS to send heart rate notifications. User can use application button
-* to un-resgister and re-register to notifications and to reset energy expended value.
+* On initialization, the application starts scanning and connects to the nearby peripherals that advertise
+* Heart Rate Service UUID, up to HRC_MAX_SERVERS at the same time. After each connection, application calls
+* HRC library to start GATT discovery for HRS characteristics and descriptors, one server at a time. The
+* library then issues callbacks to notify status of the discovery operation. On successful discovery,
+* application configures HRS to send heart rate notifications. The measurements of all the servers are
+* decoded and sent to the host over the HCI transport, each one tagged with the index of its server.
+* User can use application button to un-resgister and re-register to notifications and to reset
+* energy expended value of all the servers.
 * Application tracks the duration of button pressed using a timer and performs the actions as explained below.
 *
 * Features demonstrated
@@ -80,11 +82,18 @@
 #include "wiced_result.h"
 #include "wiced_platform.h"
 #include "wiced_transport.h"
+#include "hci_control_api.h"
 #include "wiced_bt_hrp.h"
 #include "wiced_bt_hrc.h"
 #include "wiced_hal_puart.h"
 #include "string.h"
 #include "wiced_bt_stack.h"
+#include "scan_filter.h"
+#include "gatt_disc_cache.h"
+#include "bond_store.h"
+#include "gatt_client.h"
+#include "hci_control_dispatch.h"
+#include "conn_timing.h"
 
 
 /******************************************************
@@ -112,25 +121,125 @@ extern const wiced_bt_cfg_buf_pool_t wiced_app_cfg_buf_pools[];
 #define APP_BUTTON_DEFAULT_STATE    GPIO_PIN_OUTPUT_LOW
 #endif
 
+#define HRC_MAX_SERVERS          3      /* heart rate servers connected at the same time, client_max_links */
+
 #define HRC_LOCAL_KEYS_VS_ID     (WICED_NVRAM_VSID_START)
-#define HRC_PAIRED_KEYS_VS_ID    (WICED_NVRAM_VSID_START + 1)
+#define HRC_PAIRED_KEYS_VS_ID    (WICED_NVRAM_VSID_START + 2)   /* bond store of HRC_MAX_SERVERS devices */
+#define HRC_DISC_CACHE_VS_ID     (HRC_PAIRED_KEYS_VS_ID + BOND_STORE_NUM_VS_ID(HRC_MAX_SERVERS))    /* one per bonded server */
+
+/* Heart Rate Measurement flags */
+#define HRC_HRM_FLAG_HEART_RATE_UINT16      0x01
+#define HRC_HRM_FLAG_ENERGY_EXPENDED        0x08
+#define HRC_HRM_FLAG_RR_INTERVAL            0x10
+
+#define HRC_HRM_MAX_RR_INTERVALS            16      /* RR intervals forwarded per measurement */
+
+/* Measurements received within HRC_BATCH_WINDOW_MS of the first one go to the host together, in one
+ * HCI_CONTROL_HRC_EVENT_MEASUREMENTS of up to HRC_BATCH_MAX_LEN bytes. 0 sends each measurement alone,
+ * in an HCI_CONTROL_HRC_EVENT_MEASUREMENT. */
+#ifndef HRC_BATCH_WINDOW_MS
+#define HRC_BATCH_WINDOW_MS                 1000
+#endif
+#ifndef HRC_BATCH_MAX_LEN
+#define HRC_BATCH_MAX_LEN                   240
+#endif
+#define HRC_BATCH_HDR_LEN                   5       /* time of the first entry, number of entries */
+
+/* A server connected, payload: server index (uint8), address */
+#ifndef HCI_CONTROL_HRC_EVENT_PEER_UP
+#define HCI_CONTROL_HRC_EVENT_PEER_UP       ( ( HCI_CONTROL_GROUP_LE << 8 ) | 0x34 )
+#endif
+/* A server disconnected, payload: server index (uint8), notifications, RR intervals, malformed notifications (uint32 each) */
+#ifndef HCI_CONTROL_HRC_EVENT_PEER_DOWN
+#define HCI_CONTROL_HRC_EVENT_PEER_DOWN     ( ( HCI_CONTROL_GROUP_LE << 8 ) | 0x35 )
+#endif
+/* A measurement, payload: server index (uint8), flags (uint8), heart rate (uint16), energy expended (uint16)
+ * if the flags have HRC_HRM_FLAG_ENERGY_EXPENDED, then the RR intervals (uint16 each) */
+#ifndef HCI_CONTROL_HRC_EVENT_MEASUREMENT
+#define HCI_CONTROL_HRC_EVENT_MEASUREMENT   ( ( HCI_CONTROL_GROUP_LE << 8 ) | 0x36 )
+#endif
+/* Measurements of all the servers, payload: time of the first one (uint32, ms), number of entries (uint8),
+ * then the entries: server index (uint8), time since the first one (uint16, ms), flags (uint8), heart rate
+ * (uint16), energy expended (uint16) if the flags have HRC_HRM_FLAG_ENERGY_EXPENDED, number of RR intervals
+ * (uint8) and the RR intervals (uint16 each) if the flags have HRC_HRM_FLAG_RR_INTERVAL */
+#ifndef HCI_CONTROL_HRC_EVENT_MEASUREMENTS
+#define HCI_CONTROL_HRC_EVENT_MEASUREMENTS  ( ( HCI_CONTROL_GROUP_LE << 8 ) | 0x37 )
+#endif
 
 /******************************************************
  *                     Structures
  ******************************************************/
 
+typedef struct
+{
+    uint16_t                    conn_id;        // 0 if the entry is free
+
+#define HRC_DISCOVERY_STATE_SERVICE     0
+#define HRC_DISCOVERY_STATE_HRS         1
+#define HRC_DISCOVERY_STATE_WAIT        2       // waiting for the discovery of another server
+#define HRC_DISCOVERY_STATE_DONE        3
+
+    uint8_t                     discovery_state;
+
+    uint8_t                     started;
+
+    uint16_t                    hear_rate_service_s_handle; // Heart Rate Service start handle
+    uint16_t                    hear_rate_service_e_handle; // Heart Rate Service end handle
+
+    BD_ADDR                     remote_addr;    //address of the peer
+    wiced_bt_ble_address_type_t addr_type;
+
+    /* notification statistics */
+    uint32_t                    notifications;
+    uint32_t                    rr_intervals;
+    uint32_t                    malformed;
+} hrc_server_t;
+
+/* Measurements waiting to be sent to the host */
+typedef struct
+{
+    uint32_t                    start_ms;       // time of the first entry
+    uint8_t                     count;
+    uint16_t                    len;
+    uint8_t                     data[HRC_BATCH_MAX_LEN];
+} hrc_batch_t;
+
+typedef struct
+{
+    uint32_t                    timeout;
+    wiced_bool_t                connecting;     // connection to a new server in progress
+    hrc_server_t                server[HRC_MAX_SERVERS];
+} hrc_app_cb_t;
+
 /******************************************************
  *               Function Prototypes
  ******************************************************/
 static wiced_result_t         hrc_management_callback(wiced_bt_management_evt_t event, wiced_bt_management_evt_data_t *p_event_data);
 static void                   hrc_scan_result_cback( wiced_bt_ble_scan_results_t *p_scan_result, uint8_t *p_adv_data );
+static wiced_bool_t           hrc_scan_match( wiced_bt_ble_scan_results_t *p_scan_result, uint8_t *p_adv_data );
+static void                   hrc_scan_start(void);
 static void                   hrc_connection_up(wiced_bt_gatt_connection_status_t *p_conn_status);
 static void                   hrc_connection_down(wiced_bt_gatt_connection_status_t *p_conn_status);
-static void                   hrc_process_pairing_complete(uint8_t result);
+static void                   hrc_process_pairing_complete(BD_ADDR bd_addr, uint8_t result);
 static wiced_bt_gatt_status_t hrc_gatts_callback(wiced_bt_gatt_evt_t event, wiced_bt_gatt_event_data_t *p_data);
 static wiced_bt_gatt_status_t hrc_gatt_discovery_result(wiced_bt_gatt_discovery_result_t *p_data);
 static wiced_bt_gatt_status_t hrc_gatt_discovery_complete(wiced_bt_gatt_discovery_complete_t *p_data);
+static void                   hrc_start_service_discovery(hrc_server_t *p_server);
+static void                   hrc_cache_checked(gatt_client_conn_t *p_conn, const gatt_client_op_t *p_op, const gatt_client_result_t *p_result);
+static void                   hrc_service_found(gatt_client_conn_t *p_conn, wiced_bt_gatt_discovery_result_t *p_data);
+static void                   hrc_services_discovered(gatt_client_conn_t *p_conn, const gatt_client_op_t *p_op, const gatt_client_result_t *p_result);
+static void                   hrc_discovery_next(void);
+static void                   hrc_discovery_done(hrc_server_t *p_server);
+static wiced_bool_t           hrc_is_bonded(BD_ADDR bd_addr);
 static wiced_bt_gatt_status_t hrc_gatt_operation_complete(wiced_bt_gatt_operation_complete_t *p_data);
+static void                   hrc_process_measurement(hrc_server_t *p_server, uint8_t *p_data, uint16_t len);
+static void                   hrc_report_measurement(uint8_t index, uint8_t flags, uint16_t heart_rate, uint16_t energy_expended, uint16_t *p_rr, uint8_t num_rr);
+static void                   hrc_batch_flush(void);
+static void                   hrc_batch_timeout(uint32_t arg);
+static hrc_server_t          *hrc_server_find(uint16_t conn_id);
+static hrc_server_t          *hrc_server_alloc(void);
+static hrc_server_t          *hrc_server_find_addr(BD_ADDR bd_addr);
+static uint32_t               hrc_proc_rx_cmd(uint8_t *p_buffer, uint32_t length);
 
 static void                   hrc_callback(wiced_bt_hrc_event_t event, wiced_bt_hrc_event_data_t *p_data);
 static void                   hrc_interrupt_handler(void* user_data, uint8_t value );
@@ -144,27 +253,13 @@ static void                   hrc_trace_callback(wiced_bt_hci_trace_type_t type,
  *               Variables Definitions
  ******************************************************/
 
-typedef struct
-{
-    uint16_t                    conn_id;
-
-#define HRC_DISCOVERY_STATE_SERVICE     0
-#define HRC_DISCOVERY_STATE_HRS         1
-
-    uint8_t                     discovery_state;
-
-    uint8_t                     started;
-
-    uint32_t                    timeout;
-
-    uint16_t                    hear_rate_service_s_handle; // Heart Rate Service start handle
-    uint16_t                    hear_rate_service_e_handle; // Heart Rate Service end handle
-
-    BD_ADDR                     remote_addr;    //address of currently connected peer
-    wiced_bt_ble_address_type_t addr_type;
-} hrc_app_cb_t;
-
 hrc_app_cb_t hrc_app_cb;
+scan_filter_t hrc_scan_filter;
+gatt_disc_cache_t hrc_disc_cache;    /* one entry per bonded server, checked one server at a time */
+gatt_client_conn_t hrc_gatt_conns[HRC_MAX_SERVERS];
+bond_store_t hrc_bond_store;
+hrc_batch_t hrc_batch;
+wiced_timer_t hrc_batch_timer;
 
 const wiced_transport_cfg_t transport_cfg =
 {
@@ -183,7 +278,7 @@ const wiced_transport_cfg_t transport_cfg =
         .buffer_count = 0
     },
     .p_status_handler = NULL,
-    .p_data_handler = NULL,
+    .p_data_handler = hrc_proc_rx_cmd,
     .p_tx_complete_cback = NULL
 };
 
@@ -243,6 +338,9 @@ void hrc_application_init(void)
     /* Initialize wiced app */
     wiced_bt_app_init();
 #endif
+    scan_filter_init( &hrc_scan_filter, hrc_scan_match );
+    gatt_client_init( hrc_gatt_conns, HRC_MAX_SERVERS );
+
     /* Configure LED PIN as input and initial outvalue as high */
     wiced_hal_gpio_configure_pin( APP_LED, GPIO_OUTPUT_ENABLE, GPIO_PIN_OUTPUT_HIGH );
 
@@ -268,8 +366,12 @@ void hrc_application_init(void)
     wiced_bt_set_pairable_mode(WICED_TRUE, 0);
 
     /* Load the address resolution DB with the keys stored in the NVRAM */
+    bond_store_init( &hrc_bond_store, HRC_PAIRED_KEYS_VS_ID, HRC_MAX_SERVERS );
+    gatt_disc_cache_init( &hrc_disc_cache, HRC_DISC_CACHE_VS_ID, &hrc_bond_store );
     hrc_load_keys_to_addr_resolution_db();
 
+    wiced_init_timer(&hrc_batch_timer, hrc_batch_timeout, 0, WICED_MILLI_SECONDS_TIMER);
+
     /* Starting the periodic seconds timer */
     if ( wiced_init_timer(&app_timer,hrc_timeout,0,WICED_SECONDS_PERIODIC_TIMER) == WICED_SUCCESS)
     {
@@ -320,11 +422,12 @@ wiced_result_t hrc_management_callback(wiced_bt_management_evt_t event, wiced_bt
 
     case BTM_PAIRING_COMPLETE_EVT:
         WICED_BT_TRACE("Pairing Complete: %d\n", p_event_data->pairing_complete.pairing_complete_info.ble.reason);
-        hrc_process_pairing_complete(p_event_data->pairing_complete.pairing_complete_info.ble.reason);
+        hrc_process_pairing_complete(p_event_data->pairing_complete.bd_addr, p_event_data->pairing_complete.pairing_complete_info.ble.reason);
         break;
 
     case BTM_ENCRYPTION_STATUS_EVT:
         WICED_BT_TRACE("Encryption Status Event: bd (%B) res %d\n", p_event_data->encryption_status.bd_addr, p_event_data->encryption_status.result);
+        conn_timing_encrypted(p_event_data->encryption_status.bd_addr, (uint8_t) p_event_data->encryption_status.result);
         break;
 
     case BTM_SECURITY_REQUEST_EVT:
@@ -372,6 +475,14 @@ wiced_result_t hrc_management_callback(wiced_bt_management_evt_t event, wiced_bt
     return result;
 }
 
+/*
+ * Search for the Heart Rate service in the complete and partial UUID_16 lists
+ */
+wiced_bool_t hrc_scan_match( wiced_bt_ble_scan_results_t *p_scan_result, uint8_t *p_adv_data )
+{
+    return scan_filter_adv_has_uuid16( p_adv_data, UUID_SERVICE_HEART_RATE );
+}
+
 /*
  * This function process the scan results and attempt to connect to Heart Rate server
  */
@@ -379,41 +490,25 @@ void hrc_scan_result_cback( wiced_bt_ble_scan_results_t *p_scan_result, uint8_t
 {
     wiced_result_t          status;
     wiced_bool_t            ret_status;
-    uint8_t                 length;
-    uint8_t *               p_data;
-    uint16_t                service_uuid16=0;
+
     if ( p_scan_result )
     {
-        /* Search for SERVICE_UUID_16 element in the Advertisement data received.Check for both
-        complete and partial list */
-        p_data = wiced_bt_ble_check_advertising_data( p_adv_data, BTM_BLE_ADVERT_TYPE_16SRV_COMPLETE, &length );
-        if (p_data == NULL)
+        /* The filter remembers the devices already checked */
+        if ( !scan_filter_check( &hrc_scan_filter, p_scan_result, p_adv_data ) )
         {
-            p_data = wiced_bt_ble_check_advertising_data( p_adv_data, BTM_BLE_ADVERT_TYPE_16SRV_PARTIAL, &length );
-            if (p_data == NULL)
-                return;     // No UUID_16 element
-        }
-
-        while (length >= LEN_UUID_16)
-        {
-            STREAM_TO_UINT16(service_uuid16, p_data);
-            if (service_uuid16 == UUID_SERVICE_HEART_RATE)
-            {
-                // UUID16 Heart rate service found
-                break;
-            }
-            length -= LEN_UUID_16;
+            // UUID16 Heart rate service not found. Ignore device
+            return;
         }
 
-        if (service_uuid16 != UUID_SERVICE_HEART_RATE)
+        // Already connected, or connecting to another server
+        if ( hrc_app_cb.connecting || ( hrc_server_find_addr( p_scan_result->remote_bd_addr ) != NULL ) )
         {
-            // UUID16 Heart rate service not found. Ignore device
             return;
         }
 
         WICED_BT_TRACE(" Found Device : %B \n", p_scan_result->remote_bd_addr );
 
-        /* Stop the scan since the desired device is found */
+        /* Stop the scan while connecting, it goes on once connected if more servers can be connected */
         status = wiced_bt_ble_scan( BTM_BLE_SCAN_TYPE_NONE, WICED_TRUE, hrc_scan_result_cback );
 
         WICED_BT_TRACE( "scan off status %d\n", status );
@@ -421,6 +516,11 @@ void hrc_scan_result_cback( wiced_bt_ble_scan_results_t *p_scan_result, uint8_t
         /* Initiate the connection */
         ret_status = wiced_bt_gatt_le_connect( p_scan_result->remote_bd_addr, p_scan_result->ble_addr_type, BLE_CONN_MODE_HIGH_DUTY, TRUE );
         WICED_BT_TRACE( "wiced_bt_gatt_le_connect status %d\n", ret_status );
+        hrc_app_cb.connecting = ret_status;
+        if (ret_status)
+        {
+            conn_timing_connect_start(p_scan_result->remote_bd_addr);
+        }
     }
     else
     {
@@ -428,6 +528,75 @@ void hrc_scan_result_cback( wiced_bt_ble_scan_results_t *p_scan_result, uint8_t
     }
 }
 
+/*
+ * Scan for one more server, if there is room for it and no scan or connection is in progress
+ */
+void hrc_scan_start(void)
+{
+    wiced_result_t result;
+
+    if ( hrc_app_cb.connecting || ( hrc_server_alloc( ) == NULL ) ||
+         ( wiced_bt_ble_get_current_scan_state() != BTM_BLE_SCAN_TYPE_NONE ) )
+    {
+        return;
+    }
+
+    conn_timing_scan_start();
+    result = wiced_bt_ble_scan( BTM_BLE_SCAN_TYPE_HIGH_DUTY, WICED_TRUE, hrc_scan_result_cback );
+    WICED_BT_TRACE("wiced_bt_ble_scan: %d \n", result);
+}
+
+/*
+ * Find a connected server by its connection
+ */
+hrc_server_t *hrc_server_find(uint16_t conn_id)
+{
+    hrc_server_t *p_server;
+
+    for (p_server = hrc_app_cb.server; p_server < &hrc_app_cb.server[HRC_MAX_SERVERS]; p_server++)
+    {
+        if ((conn_id != 0) && (p_server->conn_id == conn_id))
+        {
+            return p_server;
+        }
+    }
+    return NULL;
+}
+
+/*
+ * Find a free entry for a new server
+ */
+hrc_server_t *hrc_server_alloc(void)
+{
+    hrc_server_t *p_server;
+
+    for (p_server = hrc_app_cb.server; p_server < &hrc_app_cb.server[HRC_MAX_SERVERS]; p_server++)
+    {
+        if (p_server->conn_id == 0)
+        {
+            return p_server;
+        }
+    }
+    return NULL;
+}
+
+/*
+ * Find a connected server by its address
+ */
+hrc_server_t *hrc_server_find_addr(BD_ADDR bd_addr)
+{
+    hrc_server_t *p_server;
+
+    for (p_server = hrc_app_cb.server; p_server < &hrc_app_cb.server[HRC_MAX_SERVERS]; p_server++)
+    {
+        if ((p_server->conn_id != 0) && (memcmp(p_server->remote_addr, bd_addr, BD_ADDR_LEN) == 0))
+        {
+            return p_server;
+        }
+    }
+    return NULL;
+}
+
 /*
  * Callback for various GATT events.  As this application performs only as a GATT client, some of the events are omitted.
  */
@@ -435,6 +604,12 @@ wiced_bt_gatt_status_t hrc_gatts_callback(wiced_bt_gatt_evt_t event, wiced_bt_ga
 {
     wiced_bt_gatt_status_t result = WICED_BT_GATT_INVALID_PDU;
 
+    // Completions of the cache checks and service discoveries queued, the library sends the other requests
+    if (gatt_client_event_handler(event, p_data))
+    {
+        return WICED_BT_GATT_SUCCESS;
+    }
+
     switch(event)
     {
     case GATT_CONNECTION_STATUS_EVT:
@@ -472,61 +647,210 @@ wiced_bt_gatt_status_t hrc_gatts_callback(wiced_bt_gatt_evt_t event, wiced_bt_ga
  */
 void hrc_connection_up(wiced_bt_gatt_connection_status_t *p_conn_status)
 {
-    wiced_bt_gatt_status_t  status;
+    hrc_server_t *p_server;
+    uint8_t       event[1 + BD_ADDR_LEN];
+    uint8_t      *p = event;
 
     WICED_BT_TRACE("%s\n", __FUNCTION__);
 
-    hrc_app_cb.conn_id   = p_conn_status->conn_id;
+    hrc_app_cb.connecting = WICED_FALSE;
+
+    if ((p_server = hrc_server_alloc()) == NULL)
+    {
+        WICED_BT_TRACE("no room for server %B\n", p_conn_status->bd_addr);
+        wiced_bt_gatt_disconnect(p_conn_status->conn_id);
+        return;
+    }
+
+    if (gatt_client_conn_up(p_conn_status->conn_id, p_conn_status->bd_addr) == NULL)
+    {
+        WICED_BT_TRACE("no GATT client entry for %B\n", p_conn_status->bd_addr);
+        wiced_bt_gatt_disconnect(p_conn_status->conn_id);
+        return;
+    }
+
+    memset(p_server, 0, sizeof(*p_server));
+    p_server->conn_id   = p_conn_status->conn_id;
 
     // save address of the connected device.
-    memcpy(hrc_app_cb.remote_addr, p_conn_status->bd_addr, sizeof(hrc_app_cb.remote_addr));
-    hrc_app_cb.addr_type = p_conn_status->addr_type;
+    memcpy(p_server->remote_addr, p_conn_status->bd_addr, sizeof(p_server->remote_addr));
+    p_server->addr_type = p_conn_status->addr_type;
+
+    conn_timing_connected(p_server->remote_addr, hrc_is_bonded(p_server->remote_addr));
 
     // tell library that connection is up
     wiced_bt_hrc_connection_up(p_conn_status->conn_id);
 
-    /* Initialize heart Rate Service discovery */
-    hrc_app_cb.discovery_state            = HRC_DISCOVERY_STATE_SERVICE;
-    hrc_app_cb.hear_rate_service_s_handle = 0;
-    hrc_app_cb.hear_rate_service_e_handle = 0;
+    /* Tell the host which index the measurements of the server come with */
+    UINT8_TO_STREAM(p, p_server - hrc_app_cb.server);
+    BDADDR_TO_STREAM(p, p_server->remote_addr);
+    wiced_transport_send_data(HCI_CONTROL_HRC_EVENT_PEER_UP, event, p - event);
+
+    /* Heart Rate Service discovery, once the other servers are done */
+    p_server->discovery_state = HRC_DISCOVERY_STATE_WAIT;
+    hrc_discovery_next();
+
+    hrc_scan_start();
+}
 
-   // perform primary service search
-    status = wiced_bt_util_send_gatt_discover(hrc_app_cb.conn_id, GATT_DISCOVER_SERVICES_ALL, UUID_ATTRIBUTE_PRIMARY_SERVICE, 1, 0xffff);
+/*
+ * Start the discovery of the next server waiting for it. The discoveries run
+ * one at a time, the cache and the library follow one of them.
+ */
+void hrc_discovery_next(void)
+{
+    hrc_server_t *p_server;
+    hrc_server_t *p_next = NULL;
+
+    for (p_server = hrc_app_cb.server; p_server < &hrc_app_cb.server[HRC_MAX_SERVERS]; p_server++)
+    {
+        if (p_server->conn_id == 0)
+        {
+            continue;
+        }
+        if ((p_server->discovery_state == HRC_DISCOVERY_STATE_SERVICE) ||
+            (p_server->discovery_state == HRC_DISCOVERY_STATE_HRS))
+        {
+            return;
+        }
+        if ((p_next == NULL) && (p_server->discovery_state == HRC_DISCOVERY_STATE_WAIT))
+        {
+            p_next = p_server;
+        }
+    }
+    if (p_next == NULL)
+    {
+        return;
+    }
+
+    p_next->discovery_state = HRC_DISCOVERY_STATE_SERVICE;
+
+    // a bonded peer may have its Heart Rate Service range cached, a miss goes on with the discovery
+    if (!hrc_is_bonded(p_next->remote_addr) ||
+        (gatt_client_cache_check(gatt_client_conn_find(p_next->conn_id), &hrc_disc_cache, hrc_cache_checked, NULL) != WICED_BT_GATT_SUCCESS))
+    {
+        hrc_start_service_discovery(p_next);
+    }
+}
+
+/*
+ * The check of the discovery cache of a bonded server is over
+ */
+void hrc_cache_checked(gatt_client_conn_t *p_conn, const gatt_client_op_t *p_op, const gatt_client_result_t *p_result)
+{
+    hrc_server_t *p_server = hrc_server_find(p_conn->conn_id);
+
+    if (p_server == NULL)
+    {
+        return;
+    }
+
+    if (p_result->cache == GATT_DISC_CACHE_HIT)
+    {
+        // database did not change, tell WICED BT HRC library to start its discovery
+        p_server->hear_rate_service_s_handle = p_result->s_handle;
+        p_server->hear_rate_service_e_handle = p_result->e_handle;
+        p_server->discovery_state = HRC_DISCOVERY_STATE_HRS;
+        wiced_bt_hrc_discover(p_server->conn_id, p_server->hear_rate_service_s_handle, p_server->hear_rate_service_e_handle);
+    }
+    else
+    {
+        hrc_start_service_discovery(p_server);
+    }
+}
+
+/*
+ * The discovery of a server is over, successful or not, go on with the next one
+ */
+void hrc_discovery_done(hrc_server_t *p_server)
+{
+    p_server->discovery_state = HRC_DISCOVERY_STATE_DONE;
+    hrc_discovery_next();
+}
+
+/*
+ * Look for the Heart Rate Service with a primary service search
+ */
+void hrc_start_service_discovery(hrc_server_t *p_server)
+{
+    wiced_bt_gatt_status_t  status;
+
+    status = gatt_client_discover(gatt_client_conn_find(p_server->conn_id), GATT_DISCOVER_SERVICES_ALL, 0, 1, 0xffff,
+                                  hrc_service_found, hrc_services_discovered, NULL);
     WICED_BT_TRACE("start discover status:%d\n", status);
 }
 
+/*
+ * Check if the link keys of a device are saved
+ */
+wiced_bool_t hrc_is_bonded(BD_ADDR bd_addr)
+{
+    return bond_store_is_bonded(&hrc_bond_store, bd_addr);
+}
+
 /*
  * This function will be called when connection goes down
  */
 void hrc_connection_down(wiced_bt_gatt_connection_status_t *p_conn_status)
 {
+    hrc_server_t *p_server;
+    uint8_t       event[1 + 3 * 4];
+    uint8_t      *p = event;
+    uint8_t       discovery_state;
+
     WICED_BT_TRACE("%s\n", __FUNCTION__);
 
-    hrc_app_cb.conn_id         = 0;
-    hrc_app_cb.discovery_state = HRC_DISCOVERY_STATE_SERVICE;
-    hrc_app_cb.hear_rate_service_s_handle    = 0;
-    hrc_app_cb.hear_rate_service_e_handle    = 0;
+    if ((p_server = hrc_server_find(p_conn_status->conn_id)) == NULL)
+    {
+        // the connection to a new server failed
+        hrc_app_cb.connecting = WICED_FALSE;
+        hrc_scan_start();
+        return;
+    }
+
+    WICED_BT_TRACE("server %d %B notifications:%d RR intervals:%d malformed:%d\n", p_server - hrc_app_cb.server,
+            p_server->remote_addr, p_server->notifications, p_server->rr_intervals, p_server->malformed);
+
+    /* The index may be reused, the batched measurements of the server go first */
+    hrc_batch_flush();
+
+    UINT8_TO_STREAM(p, p_server - hrc_app_cb.server);
+    UINT32_TO_STREAM(p, p_server->notifications);
+    UINT32_TO_STREAM(p, p_server->rr_intervals);
+    UINT32_TO_STREAM(p, p_server->malformed);
+    wiced_transport_send_data(HCI_CONTROL_HRC_EVENT_PEER_DOWN, event, p - event);
+
+    gatt_disc_cache_connection_down(&hrc_disc_cache, p_conn_status->conn_id);
+
+    discovery_state = p_server->discovery_state;
+    memset(p_server, 0, sizeof(*p_server));
 
     /* Turn off energy expended reset indication.*/
     wiced_hal_gpio_set_pin_output( APP_LED, GPIO_PIN_OUTPUT_HIGH);
 
     // tell library that connection is down
     wiced_bt_hrc_connection_down(p_conn_status->conn_id);
+
+    if ((discovery_state == HRC_DISCOVERY_STATE_SERVICE) || (discovery_state == HRC_DISCOVERY_STATE_HRS))
+    {
+        hrc_discovery_next();
+    }
 }
 
 /*
  * Process pairing complete event from the stack
  */
-void hrc_process_pairing_complete(uint8_t result)
+void hrc_process_pairing_complete(BD_ADDR bd_addr, uint8_t result)
 {
     wiced_bt_gatt_status_t status;
+    hrc_server_t          *p_server = hrc_server_find_addr(bd_addr);
 
-    if (result == WICED_SUCCESS)
+    if ((result == WICED_SUCCESS) && (p_server != NULL))
     {
         // if we started bonding because we could not start client, do it now
-        if ( (hrc_app_cb.hear_rate_service_s_handle != 0) && (hrc_app_cb.hear_rate_service_e_handle != 0))
+        if ( (p_server->hear_rate_service_s_handle != 0) && (p_server->hear_rate_service_e_handle != 0))
         {
-            status = wiced_bt_hrc_start(hrc_app_cb.conn_id);
+            status = wiced_bt_hrc_start(p_server->conn_id);
             WICED_BT_TRACE("HRC start %d\n", status);
         }
     }
@@ -537,36 +861,19 @@ void hrc_process_pairing_complete(uint8_t result)
  */
 wiced_bt_gatt_status_t hrc_gatt_discovery_result(wiced_bt_gatt_discovery_result_t *p_data)
 {
-    uint16_t HEART_RATE_SERVICE_UUID = UUID_SERVICE_HEART_RATE;
+    hrc_server_t *p_server = hrc_server_find(p_data->conn_id);
+
+    if (p_server == NULL)
+    {
+        return WICED_BT_GATT_SUCCESS;
+    }
 
-    WICED_BT_TRACE("[%s] conn %d type %d state 0x%02x\n", __FUNCTION__, p_data->conn_id, p_data->discovery_type, hrc_app_cb.discovery_state);
+    WICED_BT_TRACE("[%s] conn %d type %d state 0x%02x\n", __FUNCTION__, p_data->conn_id, p_data->discovery_type, p_server->discovery_state);
 
-    switch (hrc_app_cb.discovery_state)
+    // the primary service search goes through the GATT client core, the rest is the library's
+    if (p_server->discovery_state == HRC_DISCOVERY_STATE_HRS)
     {
-    case HRC_DISCOVERY_STATE_HRS:
         wiced_bt_hrc_discovery_result(p_data);
-        break;
-
-    default:
-        if (p_data->discovery_type  == GATT_DISCOVER_SERVICES_ALL)
-        {
-            if (p_data->discovery_data.group_value.service_type.len == 2)
-            {
-                WICED_BT_TRACE("s:%04x e:%04x uuid:%x\n", p_data->discovery_data.group_value.s_handle, p_data->discovery_data.group_value.e_handle, p_data->discovery_data.group_value.service_type.uu.uuid16);
-                if (memcmp(&p_data->discovery_data.group_value.service_type.uu, &HEART_RATE_SERVICE_UUID, 2) == 0)
-                {
-                    WICED_BT_TRACE("Heart Rate Service found s:%04x e:%04x\n",
-                            p_data->discovery_data.group_value.s_handle,
-                            p_data->discovery_data.group_value.e_handle);
-                    hrc_app_cb.hear_rate_service_s_handle = p_data->discovery_data.group_value.s_handle;
-                    hrc_app_cb.hear_rate_service_e_handle = p_data->discovery_data.group_value.e_handle;
-                }
-            }
-        }
-        else
-        {
-            WICED_BT_TRACE("!!!! invalid op:%d\n", p_data->discovery_type);
-        }
     }
     return WICED_BT_GATT_SUCCESS;
 }
@@ -576,35 +883,71 @@ wiced_bt_gatt_status_t hrc_gatt_discovery_result(wiced_bt_gatt_discovery_result_
  */
 wiced_bt_gatt_status_t hrc_gatt_discovery_complete(wiced_bt_gatt_discovery_complete_t *p_data)
 {
-    wiced_result_t result;
+    hrc_server_t *p_server = hrc_server_find(p_data->conn_id);
 
-    WICED_BT_TRACE("[%s] conn %d type %d state %d\n", __FUNCTION__, p_data->conn_id, p_data->disc_type, hrc_app_cb.discovery_state);
+    if (p_server == NULL)
+    {
+        return WICED_BT_GATT_SUCCESS;
+    }
 
-    switch (hrc_app_cb.discovery_state)
+    WICED_BT_TRACE("[%s] conn %d type %d state %d\n", __FUNCTION__, p_data->conn_id, p_data->disc_type, p_server->discovery_state);
+
+    if (p_server->discovery_state == HRC_DISCOVERY_STATE_HRS)
     {
-    case HRC_DISCOVERY_STATE_HRS:
         wiced_bt_hrc_discovery_complete(p_data);
-        break;
+    }
+    return WICED_BT_GATT_SUCCESS;
+}
 
-    default:
-        if (p_data->disc_type == GATT_DISCOVER_SERVICES_ALL)
-        {
-            WICED_BT_TRACE("HRC:%04x-%04x\n", hrc_app_cb.hear_rate_service_s_handle, hrc_app_cb.hear_rate_service_e_handle);
+/*
+ * A primary service found on a server
+ */
+void hrc_service_found(gatt_client_conn_t *p_conn, wiced_bt_gatt_discovery_result_t *p_data)
+{
+    uint16_t HEART_RATE_SERVICE_UUID = UUID_SERVICE_HEART_RATE;
+    hrc_server_t *p_server = hrc_server_find(p_data->conn_id);
 
-            /* If Heart Rate Service found tell WICED BT HRC library to start its discovery */
-            if ((hrc_app_cb.hear_rate_service_s_handle != 0) && (hrc_app_cb.hear_rate_service_e_handle != 0))
-            {
-                hrc_app_cb.discovery_state = HRC_DISCOVERY_STATE_HRS;
-                if (wiced_bt_hrc_discover(hrc_app_cb.conn_id, hrc_app_cb.hear_rate_service_s_handle, hrc_app_cb.hear_rate_service_e_handle))
-                    break;
-            }
-        }
-        else
-        {
-            WICED_BT_TRACE("!!!! invalid op:%d\n", p_data->disc_type);
-        }
+    if ((p_server == NULL) || (p_data->discovery_data.group_value.service_type.len != 2))
+    {
+        return;
+    }
+
+    WICED_BT_TRACE("s:%04x e:%04x uuid:%x\n", p_data->discovery_data.group_value.s_handle, p_data->discovery_data.group_value.e_handle, p_data->discovery_data.group_value.service_type.uu.uuid16);
+    if (memcmp(&p_data->discovery_data.group_value.service_type.uu, &HEART_RATE_SERVICE_UUID, 2) == 0)
+    {
+        WICED_BT_TRACE("Heart Rate Service found s:%04x e:%04x\n",
+                p_data->discovery_data.group_value.s_handle,
+                p_data->discovery_data.group_value.e_handle);
+        p_server->hear_rate_service_s_handle = p_data->discovery_data.group_value.s_handle;
+        p_server->hear_rate_service_e_handle = p_data->discovery_data.group_value.e_handle;
     }
-    return WICED_BT_GATT_SUCCESS;
+}
+
+/*
+ * The primary service search of a server is over
+ */
+void hrc_services_discovered(gatt_client_conn_t *p_conn, const gatt_client_op_t *p_op, const gatt_client_result_t *p_result)
+{
+    hrc_server_t *p_server = hrc_server_find(p_conn->conn_id);
+
+    if (p_server == NULL)
+    {
+        return;
+    }
+
+    WICED_BT_TRACE("HRC:%04x-%04x\n", p_server->hear_rate_service_s_handle, p_server->hear_rate_service_e_handle);
+
+    /* If Heart Rate Service found tell WICED BT HRC library to start its discovery */
+    if ((p_server->hear_rate_service_s_handle != 0) && (p_server->hear_rate_service_e_handle != 0))
+    {
+        p_server->discovery_state = HRC_DISCOVERY_STATE_HRS;
+        if (wiced_bt_hrc_discover(p_server->conn_id, p_server->hear_rate_service_s_handle, p_server->hear_rate_service_e_handle))
+            return;
+    }
+
+    // No point maintain connection without heart rate service, let the next server go on
+    hrc_discovery_done(p_server);
+    wiced_bt_gatt_disconnect(p_server->conn_id);
 }
 
 /*
@@ -612,15 +955,30 @@ wiced_bt_gatt_status_t hrc_gatt_discovery_complete(wiced_bt_gatt_discovery_compl
  */
 wiced_bt_gatt_status_t hrc_gatt_operation_complete(wiced_bt_gatt_operation_complete_t *p_data)
 {
+    hrc_server_t *p_server = hrc_server_find(p_data->conn_id);
+
+    if (p_server == NULL)
+    {
+        return WICED_BT_GATT_SUCCESS;
+    }
+
     switch (p_data->op)
     {
     case GATTC_OPTYPE_WRITE:
-    case GATTC_OPTYPE_NOTIFICATION:
         wiced_bt_hrc_gatt_op_complete(p_data);
         break;
 
-    case GATTC_OPTYPE_CONFIG:
+    case GATTC_OPTYPE_NOTIFICATION:
+        /* Measurements are decoded here, with the RR intervals and the server they come from */
+        if ((p_data->response_data.att_value.handle >= p_server->hear_rate_service_s_handle) &&
+            (p_data->response_data.att_value.handle <= p_server->hear_rate_service_e_handle))
+        {
+            hrc_process_measurement(p_server, p_data->response_data.att_value.p_data, p_data->response_data.att_value.len);
+        }
+        break;
+
     case GATTC_OPTYPE_READ:
+    case GATTC_OPTYPE_CONFIG:
     case GATTC_OPTYPE_INDICATION:
         WICED_BT_TRACE("This app does not support op:%d\n", p_data->op);
         break;
@@ -628,22 +986,196 @@ wiced_bt_gatt_status_t hrc_gatt_operation_complete(wiced_bt_gatt_operation_compl
     return WICED_BT_GATT_SUCCESS;
 }
 
+/*
+ * Decode a Heart Rate Measurement and send it to the host, tagged with the index of its server
+ */
+void hrc_process_measurement(hrc_server_t *p_server, uint8_t *p_data, uint16_t len)
+{
+    uint8_t  *p_end = p_data + len;
+    uint8_t   flags;
+    uint16_t  heart_rate;
+    uint16_t  energy_expended = 0;
+    uint16_t  rr[HRC_HRM_MAX_RR_INTERVALS];
+    uint8_t   num_rr = 0;
+
+    if (len < 2)
+    {
+        p_server->malformed++;
+        return;
+    }
+
+    /* server remembers previous configuration and enables notification. so client
+    has to set the flag when receive notification */
+    p_server->started = WICED_TRUE;
+    p_server->notifications++;
+
+    STREAM_TO_UINT8(flags, p_data);
+    if (flags & HRC_HRM_FLAG_HEART_RATE_UINT16)
+    {
+        STREAM_TO_UINT16(heart_rate, p_data);
+    }
+    else
+    {
+        STREAM_TO_UINT8(heart_rate, p_data);
+    }
+    if (flags & HRC_HRM_FLAG_ENERGY_EXPENDED)
+    {
+        STREAM_TO_UINT16(energy_expended, p_data);
+    }
+    if (p_data > p_end)
+    {
+        p_server->malformed++;
+        return;
+    }
+    if (flags & HRC_HRM_FLAG_RR_INTERVAL)
+    {
+        while ((p_data + 2 <= p_end) && (num_rr < HRC_HRM_MAX_RR_INTERVALS))
+        {
+            STREAM_TO_UINT16(rr[num_rr], p_data);
+            num_rr++;
+        }
+        p_server->rr_intervals += num_rr;
+    }
+
+    WICED_BT_TRACE("server %d heart_rate:%d energy_expended:%04x RR intervals:%d\n", p_server - hrc_app_cb.server,
+            heart_rate, energy_expended, num_rr);
+    hrc_report_measurement(p_server - hrc_app_cb.server, flags & (HRC_HRM_FLAG_ENERGY_EXPENDED | HRC_HRM_FLAG_RR_INTERVAL),
+            heart_rate, energy_expended, rr, num_rr);
+
+    /* Turn on LED to indicate  energy expended reset is required */
+    if ( energy_expended == 0xffff )
+    {
+        wiced_hal_gpio_set_pin_output( APP_LED, GPIO_PIN_OUTPUT_LOW);
+    }
+}
+
+/*
+ * Send a measurement to the host, alone or in the current batch
+ */
+void hrc_report_measurement(uint8_t index, uint8_t flags, uint16_t heart_rate, uint16_t energy_expended, uint16_t *p_rr, uint8_t num_rr)
+{
+    uint8_t   event[1 + 1 + 2 + 2 + 2 * HRC_HRM_MAX_RR_INTERVALS];
+    uint8_t  *p = event;
+    uint16_t  entry_len;
+    uint32_t  now_ms;
+    uint8_t   i;
+
+    if (HRC_BATCH_WINDOW_MS == 0)
+    {
+        UINT8_TO_STREAM(p, index);
+        UINT8_TO_STREAM(p, flags);
+        UINT16_TO_STREAM(p, heart_rate);
+        if (flags & HRC_HRM_FLAG_ENERGY_EXPENDED)
+        {
+            UINT16_TO_STREAM(p, energy_expended);
+        }
+        for (i = 0; i < num_rr; i++)
+        {
+            UINT16_TO_STREAM(p, p_rr[i]);
+        }
+        wiced_transport_send_data(HCI_CONTROL_HRC_EVENT_MEASUREMENT, event, p - event);
+        return;
+    }
+
+    entry_len = 1 + 2 + 1 + 2;
+    if (flags & HRC_HRM_FLAG_ENERGY_EXPENDED)
+        entry_len += 2;
+    if (flags & HRC_HRM_FLAG_RR_INTERVAL)
+        entry_len += 1 + 2 * num_rr;
+
+    /* Full, send the batch and start another one */
+    if (hrc_batch.len + entry_len > sizeof(hrc_batch.data))
+    {
+        hrc_batch_flush();
+    }
+
+    now_ms = (uint32_t)(clock_SystemTimeMicroseconds64() / 1000);
+    if (hrc_batch.count == 0)
+    {
+        hrc_batch.start_ms = now_ms;
+        hrc_batch.len      = HRC_BATCH_HDR_LEN;
+        wiced_start_timer(&hrc_batch_timer, HRC_BATCH_WINDOW_MS);
+    }
+
+    p = &hrc_batch.data[hrc_batch.len];
+    UINT8_TO_STREAM(p, index);
+    UINT16_TO_STREAM(p, now_ms - hrc_batch.start_ms);
+    UINT8_TO_STREAM(p, flags);
+    UINT16_TO_STREAM(p, heart_rate);
+    if (flags & HRC_HRM_FLAG_ENERGY_EXPENDED)
+    {
+        UINT16_TO_STREAM(p, energy_expended);
+    }
+    if (flags & HRC_HRM_FLAG_RR_INTERVAL)
+    {
+        UINT8_TO_STREAM(p, num_rr);
+        for (i = 0; i < num_rr; i++)
+        {
+            UINT16_TO_STREAM(p, p_rr[i]);
+        }
+    }
+    hrc_batch.len = p - hrc_batch.data;
+    hrc_batch.count++;
+}
+
+/*
+ * Send the batched measurements to the host in a single event
+ */
+void hrc_batch_flush(void)
+{
+    uint8_t *p = hrc_batch.data;
+
+    if (hrc_batch.count == 0)
+    {
+        return;
+    }
+    wiced_stop_timer(&hrc_batch_timer);
+
+    UINT32_TO_STREAM(p, hrc_batch.start_ms);
+    UINT8_TO_STREAM(p, hrc_batch.count);
+    wiced_transport_send_data(HCI_CONTROL_HRC_EVENT_MEASUREMENTS, hrc_batch.data, hrc_batch.len);
+
+    hrc_batch.count = 0;
+    hrc_batch.len   = 0;
+}
+
+/*
+ * The batch window is over
+ */
+void hrc_batch_timeout(uint32_t arg)
+{
+    hrc_batch_flush();
+}
+
 static void hrc_callback(wiced_bt_hrc_event_t event, wiced_bt_hrc_event_data_t *p_data)
 {
     wiced_bt_gatt_status_t status = WICED_BT_GATT_SUCCESS;
+    hrc_server_t          *p_server = NULL;
 
     switch(event)
     {
     case WICED_BT_HRC_EVENT_DISCOVERY:               /**< HRC Discovery event */
         status = p_data->discovery.status;
+        p_server = hrc_server_find(p_data->discovery.conn_id);
         WICED_BT_TRACE("%s Discovery status:%d\n", __FUNCTION__, status);
+        if (p_server == NULL)
+        {
+            break;
+        }
         // This app automatically starts the client
         if (status == WICED_BT_GATT_SUCCESS)
         {
-            wiced_bt_hrc_start(hrc_app_cb.conn_id);
+            // saved before the next server is checked, the cache holds the hash of this one
+            gatt_disc_cache_store(&hrc_disc_cache, p_server->remote_addr, p_server->hear_rate_service_s_handle, p_server->hear_rate_service_e_handle);
+            hrc_discovery_done(p_server);
+            wiced_bt_hrc_start(p_server->conn_id);
         }
         else
         {
+            // the cached range, if it was used, is not right
+            gatt_disc_cache_invalidate(&hrc_disc_cache, p_server->remote_addr);
+            hrc_discovery_done(p_server);
+
             // Disconnect. In the snippet, no point maintain connection without heart rate service
             status = wiced_bt_gatt_disconnect(p_data->discovery.conn_id);
             WICED_BT_TRACE("wiced_bt_gatt_discnnect %d\n", status);
@@ -652,24 +1184,27 @@ static void hrc_callback(wiced_bt_hrc_event_t event, wiced_bt_hrc_event_data_t *
 
     case WICED_BT_HRC_EVENT_START:                   /**< HRC Start event */
         status = p_data->start.status;
+        p_server = hrc_server_find(p_data->start.conn_id);
         WICED_BT_TRACE("%s Start status:%d\n", __FUNCTION__, status);
-        if (status == WICED_BT_GATT_SUCCESS)
+        if ((status == WICED_BT_GATT_SUCCESS) && (p_server != NULL))
         {
-            hrc_app_cb.started = WICED_TRUE;
+            p_server->started = WICED_TRUE;
         }
         break;
 
     case WICED_BT_HRC_EVENT_STOP:                    /**< HRC Stop event */
         status = p_data->stop.status;
+        p_server = hrc_server_find(p_data->stop.conn_id);
         WICED_BT_TRACE("%s Stop status:%d\n", __FUNCTION__, status);
-        if (status == WICED_BT_GATT_SUCCESS)
+        if ((status == WICED_BT_GATT_SUCCESS) && (p_server != NULL))
         {
-            hrc_app_cb.started = WICED_FALSE;
+            p_server->started = WICED_FALSE;
         }
         break;
 
     case WICED_BT_HRC_EVENT_RESET_ENERGY_EXPENDED:   /**< HRC Reset Energy Expended event */
         status = p_data->reset_energy_expended.status;
+        p_server = hrc_server_find(p_data->reset_energy_expended.conn_id);
         WICED_BT_TRACE("%s Reset Energy Expended status:%d\n", __FUNCTION__, status);
         if(status == WICED_BT_GATT_SUCCESS)
         {
@@ -678,49 +1213,26 @@ static void hrc_callback(wiced_bt_hrc_event_t event, wiced_bt_hrc_event_data_t *
         }
         break;
 
-    case WICED_BT_HRC_EVENT_NOTIFICATION_DATA:/**< HRC Notification event */
-        /* server remembers previous configuration and enables notification. so client
-        has to set the flag when receive notification */
-        hrc_app_cb.started = WICED_TRUE;
-        if (p_data->notification_data.energy_expended_present)
-        {
-            WICED_BT_TRACE( "%s heart_rate:%d energy_expended:%04x\n", __FUNCTION__,
-            p_data->notification_data.heart_rate, p_data->notification_data.energy_expended );
-        }
-        else
-        {
-            WICED_BT_TRACE( "%s heart_rate:%d\n", __FUNCTION__, p_data->notification_data.heart_rate);
-        }
-
-        /* Turn on LED to indicate  energy expended reset is required */
-        if ( p_data->notification_data.energy_expended == 0xffff )
-        {
-            wiced_hal_gpio_set_pin_output( APP_LED, GPIO_PIN_OUTPUT_LOW);
-        }
-        break;
-
     default:
         WICED_BT_TRACE( "%s unknown event:%d\n", __FUNCTION__, event);
         break;
     }
 
     /* If the peer device indicates an Insufficient Authentication */
-    if (status == WICED_BT_GATT_INSUF_AUTHENTICATION)
+    if ((status == WICED_BT_GATT_INSUF_AUTHENTICATION) && (p_server != NULL))
     {
-        wiced_bt_device_link_keys_t link_keys;
-
         /* Check if this device was already paired (LinkKey present) */
-        if (hrc_read_link_keys(&link_keys))
+        if (hrc_is_bonded(p_server->remote_addr))
         {
             /* Already Paired, Start Encryption */
             wiced_bt_ble_sec_action_type_t sec_act = BTM_BLE_SEC_ENCRYPT;
-            status = wiced_bt_dev_set_encryption(hrc_app_cb.remote_addr, BT_TRANSPORT_LE, &sec_act);
+            status = wiced_bt_dev_set_encryption(p_server->remote_addr, BT_TRANSPORT_LE, &sec_act);
             WICED_BT_TRACE("start encrypt result:%d\n", status);
         }
         else
         {
             /* Device Not Paired, Start Pairing (aka Bonding) */
-            status = wiced_bt_dev_sec_bond(hrc_app_cb.remote_addr, hrc_app_cb.addr_type, BT_TRANSPORT_LE, 0, NULL);
+            status = wiced_bt_dev_sec_bond(p_server->remote_addr, p_server->addr_type, BT_TRANSPORT_LE, 0, NULL);
             WICED_BT_TRACE("start bond result:%d\n", status);
         }
     }
@@ -729,9 +1241,9 @@ static void hrc_callback(wiced_bt_hrc_event_t event, wiced_bt_hrc_event_data_t *
 /* This function is invoked on button interrupt events */
 void hrc_interrupt_handler(void* user_data, uint8_t value )
 {
-    wiced_result_t  result;
     wiced_bt_gatt_status_t status;
-    int             num_slaves;
+    hrc_server_t   *p_server;
+    wiced_bool_t    discovered = WICED_FALSE;
     static uint32_t button_pushed_time = 0;
 
     //WICED_BT_TRACE( "But1 %d, But2 %d, But3 %d \n", value & 0x01, ( value & 0x02 ) >> 1, ( value & 0x04 ) >> 2 );
@@ -749,12 +1261,31 @@ void hrc_interrupt_handler(void* user_data, uint8_t value )
     else if ( button_pushed_time != 0 )
     {
         WICED_BT_TRACE( " Button released " );
-        if (hrc_app_cb.conn_id && (hrc_app_cb.hear_rate_service_s_handle != 0) && (hrc_app_cb.hear_rate_service_e_handle != 0) )
+        if ( hrc_app_cb.timeout - button_pushed_time < 2 )
+        {
+            WICED_BT_TRACE( " with in 2 seconds. " );
+            /*start scan if there is room for one more server and no scan in progress*/
+            if (wiced_bt_ble_get_current_scan_state() == BTM_BLE_SCAN_TYPE_NONE)
+            {
+                scan_filter_reset( &hrc_scan_filter );
+                hrc_scan_start();
+            }
+            return;
+        }
+
+        /* The longer pushes act on all the servers found */
+        for (p_server = hrc_app_cb.server; p_server < &hrc_app_cb.server[HRC_MAX_SERVERS]; p_server++)
         {
+            if ( (p_server->conn_id == 0) || (p_server->hear_rate_service_s_handle == 0) || (p_server->hear_rate_service_e_handle == 0) )
+            {
+                continue;
+            }
+            discovered = WICED_TRUE;
+
             if ( hrc_app_cb.timeout - button_pushed_time > 5 )
             {
                 WICED_BT_TRACE( " after more than 5s. Reset energy expended " );
-                status = wiced_bt_hrc_reset_energy_expended( hrc_app_cb.conn_id );
+                status = wiced_bt_hrc_reset_energy_expended( p_server->conn_id );
                 WICED_BT_TRACE( " %d \n", status );
             }
             else if ((hrc_app_cb.timeout - button_pushed_time > 2) &&
@@ -762,27 +1293,21 @@ void hrc_interrupt_handler(void* user_data, uint8_t value )
                     )
             {
                 WICED_BT_TRACE( " between 2 to 4 seconds " );
-                if (hrc_app_cb.started)
+                if (p_server->started)
                 {
-                    status = wiced_bt_hrc_stop( hrc_app_cb.conn_id );
+                    status = wiced_bt_hrc_stop( p_server->conn_id );
                     WICED_BT_TRACE( " Stop Heart %d \n", status );
                 }
                 else
                 {
-                    status = wiced_bt_hrc_start( hrc_app_cb.conn_id );
+                    status = wiced_bt_hrc_start( p_server->conn_id );
                     WICED_BT_TRACE( " Start Heart %d \n", status );
                 }
             }
         }
-        else if (hrc_app_cb.timeout - button_pushed_time < 2)
+        if (!discovered)
         {
-            WICED_BT_TRACE( " with in 2 seconds. " );
-            /*start scan if not connected and no scan in progress*/
-            if ((hrc_app_cb.conn_id == 0) && (wiced_bt_ble_get_current_scan_state() == BTM_BLE_SCAN_TYPE_NONE))
-            {
-                result = wiced_bt_ble_scan( BTM_BLE_SCAN_TYPE_HIGH_DUTY, WICED_TRUE, hrc_scan_result_cback );
-                WICED_BT_TRACE("wiced_bt_ble_scan: %d \n", result);
-            }
+            WICED_BT_TRACE( " no heart rate server\n" );
         }
     }
 }
@@ -801,49 +1326,109 @@ void hrc_timeout( uint32_t count )
  */
 void hrc_load_keys_to_addr_resolution_db(void)
 {
-    uint8_t                     bytes_read;
-    wiced_result_t              result;
-    wiced_bt_device_link_keys_t keys;
+    bond_store_load_addr_resolution_db(&hrc_bond_store);
+}
 
-    bytes_read = wiced_hal_read_nvram(HRC_PAIRED_KEYS_VS_ID, sizeof(keys), (uint8_t *)&keys, &result);
+/*
+ * This function is called to save keys generated as a result of pairing or keys update
+ */
+wiced_bool_t hrc_save_link_keys(wiced_bt_device_link_keys_t *p_keys)
+{
+    return bond_store_save(&hrc_bond_store, p_keys);
+}
 
-    WICED_BT_TRACE(" [%s] read status %d bytes read %d \n", __FUNCTION__, result, bytes_read);
+/*
+ * This function is called to read keys for specific bdaddr
+ */
+wiced_bool_t hrc_read_link_keys(wiced_bt_device_link_keys_t *p_keys)
+{
+    return bond_store_read(&hrc_bond_store, p_keys);
+}
+
+/*
+ * Handle HCI_CONTROL_LE_COMMAND_SCAN, payload: 1 to look for one more
+ * server, 0 to stop. Same as a short push of the button.
+ */
+static uint8_t hrc_cmd_scan(uint16_t opcode, uint8_t *p_data, uint32_t data_len)
+{
+    wiced_result_t result;
 
-    // if failed to read NVRAM, there is nothing saved at that location
-    if (result == WICED_SUCCESS)
+    if (p_data[0] == 0)
     {
-#ifdef CYW20706A2
-        result = wiced_bt_dev_add_device_to_address_resolution_db(&keys, keys.key_data.ble_addr_type);
-#else
-        result = wiced_bt_dev_add_device_to_address_resolution_db(&keys);
-#endif
+        result = wiced_bt_ble_scan(BTM_BLE_SCAN_TYPE_NONE, WICED_TRUE, hrc_scan_result_cback);
+        return ((result == WICED_BT_SUCCESS) || (result == WICED_BT_PENDING)) ? HCI_CONTROL_STATUS_SUCCESS : HCI_CONTROL_STATUS_FAILED;
+    }
+    if (hrc_server_alloc() == NULL)
+    {
+        return HCI_CONTROL_STATUS_FAILED;
     }
+
+    if (wiced_bt_ble_get_current_scan_state() == BTM_BLE_SCAN_TYPE_NONE)
+    {
+        scan_filter_reset(&hrc_scan_filter);
+        hrc_scan_start();
+    }
+    return HCI_CONTROL_STATUS_SUCCESS;
 }
 
 /*
- * This function is called to save keys generated as a result of pairing or keys update
+ * Handle HCI_CONTROL_LE_COMMAND_DISCONNECT, payload: server BDA
  */
-wiced_bool_t hrc_save_link_keys(wiced_bt_device_link_keys_t *p_keys)
+static uint8_t hrc_cmd_disconnect(uint16_t opcode, uint8_t *p_data, uint32_t data_len)
 {
-    uint8_t          bytes_written;
-    wiced_result_t   result;
+    hrc_server_t *p_server;
+    BD_ADDR       bd_addr;
 
-    bytes_written = wiced_hal_write_nvram(HRC_PAIRED_KEYS_VS_ID, sizeof(wiced_bt_device_link_keys_t), (uint8_t *)p_keys, &result);
-    WICED_BT_TRACE("Saved %d bytes at id:%d\n", bytes_written, HRC_PAIRED_KEYS_VS_ID);
-    return (bytes_written == sizeof (wiced_bt_device_link_keys_t));
+    STREAM_TO_BDADDR(bd_addr, p_data);
+    if ((p_server = hrc_server_find_addr(bd_addr)) == NULL)
+    {
+        return HCI_CONTROL_STATUS_INVALID_ARGS;
+    }
+    return (wiced_bt_gatt_disconnect(p_server->conn_id) == WICED_BT_GATT_SUCCESS) ? HCI_CONTROL_STATUS_SUCCESS : HCI_CONTROL_STATUS_FAILED;
 }
 
+/* HCI commands of the application, sorted by opcode */
+static const hci_control_cmd_entry_t hrc_cmd_table[] =
+{
+    HCI_CONTROL_CMD_ENTRY(HCI_CONTROL_LE_COMMAND_SCAN,          1,              hrc_cmd_scan),
+    HCI_CONTROL_CMD_ENTRY(HCI_CONTROL_LE_COMMAND_DISCONNECT,    BD_ADDR_LEN,    hrc_cmd_disconnect),
+};
+
 /*
- * This function is called to read keys for specific bdaddr
+ * Handle a command packet received from the MCU over the WICED HCI transport
  */
-wiced_bool_t hrc_read_link_keys(wiced_bt_device_link_keys_t *p_keys)
+uint32_t hrc_proc_rx_cmd(uint8_t *p_buffer, uint32_t length)
 {
-    uint8_t         bytes_read;
-    wiced_result_t  result;
+    uint16_t opcode;
+    uint16_t payload_len;
+    uint8_t *p_data = p_buffer;
+    uint8_t  status;
+
+    /* Expected minimum 4 byte as the wiced header */
+    if ((p_buffer == NULL) || (length < 4))
+    {
+        if (p_buffer != NULL)
+        {
+            wiced_transport_free_buffer(p_buffer);
+        }
+        return HCI_CONTROL_STATUS_INVALID_ARGS;
+    }
+
+    STREAM_TO_UINT16(opcode, p_data);
+    STREAM_TO_UINT16(payload_len, p_data);
+
+    if (payload_len > length - 4)
+    {
+        status = HCI_CONTROL_STATUS_INVALID_ARGS;
+    }
+    else
+    {
+        status = hci_control_dispatch(hrc_cmd_table, HCI_CONTROL_CMD_TABLE_SIZE(hrc_cmd_table), opcode, p_data, payload_len);
+    }
+    wiced_transport_send_data(HCI_CONTROL_EVENT_COMMAND_STATUS, &status, 1);
 
-    bytes_read = wiced_hal_read_nvram(HRC_PAIRED_KEYS_VS_ID, sizeof(wiced_bt_device_link_keys_t), (uint8_t *)p_keys, &result);
-    WICED_BT_TRACE("read %d bytes at id:%d\n", bytes_read, HRC_PAIRED_KEYS_VS_ID);
-    return (bytes_read == sizeof (wiced_bt_device_link_keys_t));
+    wiced_transport_free_buffer(p_buffer);
+    return 0;
 }
 
 /*
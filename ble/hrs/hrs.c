@@ -51,7 +51,11 @@
 * Application is notified by library whenever HRC configures heart rate notifications.
 * Application stores bonded HRC address and notification configuration in NVRAM. This information is
 * used in reconnection, after successful encryption, to start heart rate notifications automatically.
-* Application sends heart rate notifications to HRC on every 1 minute, until HRC stops.
+* Application sends heart rate notifications to HRC on every HRS_NOTIFY_PERIOD_MS (1 minute by default),
+* until HRC stops. It requests a connection interval and slave latency matching that period, and
+* when the central picks a longer interval the measurements in between go in a single notification.
+* Each notification carries the RR intervals of the beats since the previous one, as many as
+* the MTU allows, the ones which do not fit or could not be sent are queued for the next ones.
 
 * Features demonstrated
 *  - Initialize and use WICED BT HRS library
@@ -90,6 +94,8 @@
 #include "wiced_hal_puart.h"
 #include "string.h"
 #include "wiced_bt_stack.h"
+#include "bond_store.h"
+#include "conn_policy.h"
 
 /******************************************************
  *                      Constants
@@ -116,7 +122,26 @@ extern const wiced_bt_cfg_buf_pool_t wiced_app_cfg_buf_pools[];
 
 #define HRS_HOST_INFO_VS_ID      WICED_NVRAM_VSID_START
 #define HRS_LOCAL_KEYS_VS_ID     (WICED_NVRAM_VSID_START + 1)
-#define HRS_PAIRED_KEYS_VS_ID    (WICED_NVRAM_VSID_START + 2)
+#define HRS_PAIRED_KEYS_VS_ID    (WICED_NVRAM_VSID_START + 2)    /* bond store of one device, 2 ids */
+
+/* Heart rate measurement period. The connection interval and slave latency
+ * requested match it, and the measurements of the periods shorter than the
+ * connection interval the central picks go in a single notification. */
+#ifndef HRS_NOTIFY_PERIOD_MS
+#define HRS_NOTIFY_PERIOD_MS        60000   /* heart rate notified on every 1 minute */
+#endif
+#define HEART_BEAT_PER_MINUTE       72      /* typical value */
+
+/* Heart Rate Measurement flags, the heart rate value is always in UINT8 format */
+#define HRS_HRM_FLAG_ENERGY_EXPENDED    0x08
+#define HRS_HRM_FLAG_RR_INTERVAL        0x10
+
+/* RR intervals are in 1/1024 second. The queue keeps the ones not notified yet
+ * (the oldest being dropped when full) and each measurement carries as many as
+ * the MTU allows. */
+#define HRS_RR_UNITS_PER_S          1024
+#define HRS_RR_QUEUE_SIZE           128
+#define HRS_HRM_MAX_LEN             64      /* flags, heart rate, energy expended and 30 RR intervals */
 
 /******************************************************
  *                     Structures
@@ -146,6 +171,10 @@ static void                   hrs_trace_callback(wiced_bt_hci_trace_type_t type,
 static void                   heart_rate_notify_timeout(uint32_t count);
 static void                   hrs_event_cback(wiced_bt_hrs_event_t event_type, wiced_bt_hrs_event_data_t *p_data);
 static void                   hrs_interrput_config (void);
+static void                   hrs_conn_param_updated(wiced_bt_ble_connection_param_update_t *p_update);
+static uint16_t               hrs_next_rr_interval(void);
+static void                   hrs_rr_queue_push(uint16_t rr);
+static void                   hrs_send_measurements(void);
 
 /******************************************************
  *               Variables Definitions
@@ -164,11 +193,32 @@ typedef struct
     wiced_bt_device_address_t   peer_addr;  /* peer address */
     uint16_t                    conn_id;
     uint16_t                    energy_expended; /*Kilo jouls.Max value is 65535 */
+    wiced_bool_t                energy_expended_due; /* to be sent in the next measurement */
     wiced_timer_t               heart_rate_notify_timer;
+    uint16_t                    mtu;
+    wiced_bool_t                congested;
+    uint16_t                    conn_interval;  /* 1.25 ms, 0 until the central sets it */
+    uint32_t                    coalesced_ms;   /* measurement periods not notified yet */
+    uint32_t                    rr_elapsed;     /* 1/1024 s since the last beat */
+    uint8_t                     rr_first;       /* oldest RR interval of the queue */
+    uint8_t                     rr_count;
+    uint16_t                    rr_queue[HRS_RR_QUEUE_SIZE];
 } hrs_app_cb_t;
 #pragma pack()
 
 hrs_app_cb_t    hrs_app_cb;
+conn_policy_t   hrs_conn_policy;
+
+/* Two bytes per beat, notified once per period, and the control point may
+ * wait as long */
+static const conn_policy_cfg_t hrs_conn_policy_cfg =
+{
+    .bytes_per_s  = (2 * HEART_BEAT_PER_MINUTE) / 60 + 1,
+    .max_delay_ms = HRS_NOTIFY_PERIOD_MS,
+    .max_idle_ms  = HRS_NOTIFY_PERIOD_MS,
+    .allow_coded  = WICED_FALSE,
+};
+bond_store_t    hrs_bond_store;
 HOSTINFO        hrs_host_info;
 
 const wiced_transport_cfg_t transport_cfg =
@@ -272,6 +322,7 @@ void hrs_application_init(void)
     wiced_bt_set_pairable_mode(WICED_TRUE, 0);
 
     /* Load the address resolution DB with the keys stored in the NVRAM */
+    bond_store_init(&hrs_bond_store, HRS_PAIRED_KEYS_VS_ID, 1);
     hrs_load_keys_to_addr_resolution_db();
 
     /* Set the advertising params and make the device discoverable */
@@ -281,7 +332,7 @@ void hrs_application_init(void)
     WICED_BT_TRACE( "wiced_bt_start_advertisements %d\n", result );
 
     /* Initialize periodic timer */
-    wiced_init_timer (&hrs_app_cb.heart_rate_notify_timer, heart_rate_notify_timeout, 0, WICED_SECONDS_PERIODIC_TIMER);
+    wiced_init_timer (&hrs_app_cb.heart_rate_notify_timer, heart_rate_notify_timeout, 0, WICED_MILLI_SECONDS_PERIODIC_TIMER);
 }
 
 #ifndef CYW43012C0
@@ -390,6 +441,10 @@ wiced_result_t hrs_management_callback(wiced_bt_management_evt_t event, wiced_bt
         }
         break;
 
+    case BTM_BLE_CONNECTION_PARAM_UPDATE:
+        hrs_conn_param_updated(&p_event_data->ble_connection_param_update);
+        break;
+
     default:
         break;
     }
@@ -449,6 +504,17 @@ wiced_bt_gatt_status_t hrs_gatts_callback(wiced_bt_gatt_evt_t event, wiced_bt_ga
         result = hrs_gatts_req_callback(&p_data->attribute_request);
         break;
 
+    case GATT_CONGESTION_EVT:
+        WICED_BT_TRACE("congestion conn %d congested %d\n", p_data->congestion.conn_id, p_data->congestion.congested);
+        hrs_app_cb.congested = p_data->congestion.congested;
+        /* Send the RR intervals kept while the link was congested */
+        if (!hrs_app_cb.congested && (hrs_app_cb.rr_count != 0) && hrs_host_info.heart_rate_notifications_enabled)
+        {
+            hrs_send_measurements();
+        }
+        result = WICED_BT_GATT_SUCCESS;
+        break;
+
     default:
         break;
     }
@@ -466,6 +532,13 @@ void hrs_connection_up(wiced_bt_gatt_connection_status_t *p_conn_status)
     WICED_BT_TRACE("%s\n", __FUNCTION__);
 
     hrs_app_cb.conn_id   = p_conn_status->conn_id;
+    hrs_app_cb.mtu       = GATT_DEF_BLE_MTU_SIZE;
+    hrs_app_cb.congested = WICED_FALSE;
+    hrs_app_cb.conn_interval = 0;
+    hrs_app_cb.coalesced_ms  = 0;
+
+    /* Ask for a connection interval and slave latency matching the measurement period */
+    conn_policy_start(&hrs_conn_policy, &hrs_conn_policy_cfg, p_conn_status->bd_addr);
     memcpy(hrs_app_cb.peer_addr, p_conn_status->bd_addr, BD_ADDR_LEN);
     // Need to notify ANP Server library that the connection is up
     wiced_bt_hrs_connection_up(p_conn_status->conn_id);
@@ -482,10 +555,13 @@ void hrs_connection_down(wiced_bt_gatt_connection_status_t *p_conn_status)
 
     // tell library that connection is down
     wiced_bt_hrs_connection_down(p_conn_status->conn_id);
+    conn_policy_stop(&hrs_conn_policy);
 
     memset(hrs_app_cb.peer_addr, 0, sizeof(hrs_app_cb.peer_addr));
     hrs_app_cb.conn_id           = 0;
     hrs_app_cb.energy_expended   = 0;
+    hrs_app_cb.rr_count          = 0;
+    hrs_app_cb.rr_elapsed        = 0;
     wiced_stop_timer(&hrs_app_cb.heart_rate_notify_timer);
 
     /* Restart Advertissement to allow Client to reconenct */
@@ -611,6 +687,7 @@ wiced_bt_gatt_status_t hrs_gatts_req_write_exec_handler(uint16_t conn_id, wiced_
 wiced_bt_gatt_status_t hrs_gatts_req_mtu_handler(uint16_t conn_id, uint16_t mtu)
 {
     WICED_BT_TRACE("req_mtu: %d\n", mtu);
+    hrs_app_cb.mtu = mtu;
     return WICED_BT_GATT_SUCCESS;
 }
 
@@ -623,6 +700,19 @@ wiced_bt_gatt_status_t hrs_gatts_req_conf_handler(uint16_t conn_id, uint16_t han
     return WICED_BT_GATT_SUCCESS;
 }
 
+/*
+ * Process the connection parameters negotiated with the client
+ */
+void hrs_conn_param_updated(wiced_bt_ble_connection_param_update_t *p_update)
+{
+    WICED_BT_TRACE("conn param update %B status:%d interval:%d latency:%d\n", p_update->bd_addr, p_update->status, p_update->conn_interval, p_update->conn_latency);
+
+    if ((p_update->status == 0) && (memcmp(p_update->bd_addr, hrs_app_cb.peer_addr, BD_ADDR_LEN) == 0))
+    {
+        hrs_app_cb.conn_interval = p_update->conn_interval;
+    }
+}
+
 /*
  * Button Interrupt can be handled here.
  */
@@ -673,7 +763,7 @@ void hrs_process_encryption_status(wiced_result_t result)
                 wiced_bt_hrs_set_previous_connection_client_notification_configuration(hrs_app_cb.conn_id, hrs_host_info.heart_rate_notifications_enabled);
                 if( hrs_host_info.heart_rate_notifications_enabled )
                 {
-                    wiced_start_timer(&hrs_app_cb.heart_rate_notify_timer, 60);
+                    wiced_start_timer(&hrs_app_cb.heart_rate_notify_timer, HRS_NOTIFY_PERIOD_MS);
                 }
             }
         }
@@ -685,23 +775,7 @@ void hrs_process_encryption_status(wiced_result_t result)
  */
 void hrs_load_keys_to_addr_resolution_db(void)
 {
-    uint8_t                     bytes_read;
-    wiced_result_t              result;
-    wiced_bt_device_link_keys_t keys;
-
-    bytes_read = wiced_hal_read_nvram(HRS_PAIRED_KEYS_VS_ID, sizeof(keys), (uint8_t *)&keys, &result);
-
-    WICED_BT_TRACE(" [%s] read status %d bytes read %d \n", __FUNCTION__, result, bytes_read);
-
-    // if failed to read NVRAM, there is nothing saved at that location
-    if (result == WICED_SUCCESS)
-    {
-#ifdef CYW20706A2
-        result = wiced_bt_dev_add_device_to_address_resolution_db(&keys, keys.key_data.ble_addr_type);
-#else
-        result = wiced_bt_dev_add_device_to_address_resolution_db(&keys);
-#endif
-    }
+    bond_store_load_addr_resolution_db(&hrs_bond_store);
 }
 
 /*
@@ -709,12 +783,7 @@ void hrs_load_keys_to_addr_resolution_db(void)
  */
 wiced_bool_t hrs_save_link_keys(wiced_bt_device_link_keys_t *p_keys)
 {
-    uint8_t          bytes_written;
-    wiced_result_t   result;
-
-    bytes_written = wiced_hal_write_nvram(HRS_PAIRED_KEYS_VS_ID, sizeof(wiced_bt_device_link_keys_t), (uint8_t *)p_keys, &result);
-    WICED_BT_TRACE("Saved %d bytes at id:%d\n", bytes_written, HRS_PAIRED_KEYS_VS_ID);
-    return (bytes_written == sizeof (wiced_bt_device_link_keys_t));
+    return bond_store_save(&hrs_bond_store, p_keys);
 }
 
 /*
@@ -722,12 +791,7 @@ wiced_bool_t hrs_save_link_keys(wiced_bt_device_link_keys_t *p_keys)
  */
 wiced_bool_t hrs_read_link_keys(wiced_bt_device_link_keys_t *p_keys)
 {
-    uint8_t         bytes_read;
-    wiced_result_t  result;
-
-    bytes_read = wiced_hal_read_nvram(HRS_PAIRED_KEYS_VS_ID, sizeof(wiced_bt_device_link_keys_t), (uint8_t *)p_keys, &result);
-    WICED_BT_TRACE("read %d bytes at id:%d %d\n", bytes_read, HRS_PAIRED_KEYS_VS_ID);
-    return (bytes_read == sizeof (wiced_bt_device_link_keys_t));
+    return bond_store_read(&hrs_bond_store, p_keys);
 }
 
 
@@ -739,16 +803,99 @@ void hrs_trace_callback(wiced_bt_hci_trace_type_t type, uint16_t length, uint8_t
     wiced_transport_send_hci_trace(NULL, type, length, p_data);
 }
 
-void heart_rate_notify_timeout(uint32_t arg)
+/*
+ * Simulated beat to beat interval in 1/1024 second, varying around the
+ * HEART_BEAT_PER_MINUTE rate as a real heart does.
+ */
+uint16_t hrs_next_rr_interval(void)
+{
+    static uint8_t beat = 0;
+    static const int8_t variation[] = { 0, 12, 20, 12, 0, -12, -20, -12 };
+
+    beat = (beat + 1) % sizeof(variation);
+    return (60 * HRS_RR_UNITS_PER_S) / HEART_BEAT_PER_MINUTE + variation[beat];
+}
+
+/*
+ * Queue an RR interval until it is notified, the oldest one is dropped if the
+ * link could not keep up.
+ */
+void hrs_rr_queue_push(uint16_t rr)
+{
+    if (hrs_app_cb.rr_count == HRS_RR_QUEUE_SIZE)
+    {
+        WICED_BT_TRACE("RR queue full, oldest interval dropped\n");
+        hrs_app_cb.rr_first = (hrs_app_cb.rr_first + 1) % HRS_RR_QUEUE_SIZE;
+        hrs_app_cb.rr_count--;
+    }
+    hrs_app_cb.rr_queue[(hrs_app_cb.rr_first + hrs_app_cb.rr_count) % HRS_RR_QUEUE_SIZE] = rr;
+    hrs_app_cb.rr_count++;
+}
+
+/*
+ * Send Heart Rate Measurements with as many queued RR intervals as the MTU
+ * allows, until the queue is empty. The HRS library does not support RR
+ * intervals, the measurement is formatted here. If the link is congested or
+ * out of buffers the remaining intervals are kept for later.
+ */
+void hrs_send_measurements(void)
 {
     wiced_bt_gatt_status_t status;
-    static uint32_t count = 0;
-    wiced_bt_hrs_notification_data_t  heart_rate_notification;
+    uint8_t   hrm[HRS_HRM_MAX_LEN];
+    uint16_t  max_len = hrs_app_cb.mtu - 3;
+    uint16_t  len;
+    uint8_t   num_rr;
+    uint16_t  rr;
 
-    memset(&heart_rate_notification, 0, sizeof(heart_rate_notification));
+    if (max_len > sizeof(hrm))
+        max_len = sizeof(hrm);
 
-#define HEART_BEAT_PER_MINUTE                   72 //typical value
-    heart_rate_notification.heart_rate  = HEART_BEAT_PER_MINUTE;
+    do
+    {
+        if (hrs_app_cb.congested)
+        {
+            WICED_BT_TRACE("congested, %d RR intervals kept\n", hrs_app_cb.rr_count);
+            return;
+        }
+
+        len = 1;
+        hrm[0] = 0;
+        hrm[len++] = HEART_BEAT_PER_MINUTE;
+
+        if (hrs_app_cb.energy_expended_due)
+        {
+            hrm[0] |= HRS_HRM_FLAG_ENERGY_EXPENDED;
+            hrm[len++] = (uint8_t)hrs_app_cb.energy_expended;
+            hrm[len++] = (uint8_t)(hrs_app_cb.energy_expended >> 8);
+        }
+
+        /* RR intervals oldest first */
+        for (num_rr = 0; (num_rr < hrs_app_cb.rr_count) && (len + 2 <= max_len); num_rr++)
+        {
+            rr = hrs_app_cb.rr_queue[(hrs_app_cb.rr_first + num_rr) % HRS_RR_QUEUE_SIZE];
+            hrm[len++] = (uint8_t)rr;
+            hrm[len++] = (uint8_t)(rr >> 8);
+        }
+        if (num_rr != 0)
+            hrm[0] |= HRS_HRM_FLAG_RR_INTERVAL;
+
+        status = wiced_bt_gatt_send_notification(hrs_app_cb.conn_id, HDLC_HRS_HEART_RATE_MEASUREMENT_VALUE, len, hrm);
+        WICED_BT_TRACE("notify heart rate %d RR intervals %d status %d\n", HEART_BEAT_PER_MINUTE, num_rr, status);
+        if (status != WICED_BT_GATT_SUCCESS)
+        {
+            return;
+        }
+
+        hrs_app_cb.energy_expended_due = WICED_FALSE;
+        hrs_app_cb.rr_first  = (hrs_app_cb.rr_first + num_rr) % HRS_RR_QUEUE_SIZE;
+        hrs_app_cb.rr_count -= num_rr;
+    } while (hrs_app_cb.rr_count != 0);
+}
+
+void heart_rate_notify_timeout(uint32_t arg)
+{
+    static uint32_t count = 0;
+    uint16_t        rr;
 
     if (hrs_app_cb.energy_expended == 0)
     {
@@ -762,14 +909,27 @@ void heart_rate_notify_timeout(uint32_t arg)
     /* Typically once on every 10 heart rate measurements energy expended value get notified */
     if ( !(++count % 10) )
     {
-        heart_rate_notification.energy_expended_present = 1;
-        heart_rate_notification.energy_expended         = hrs_app_cb.energy_expended;
+        hrs_app_cb.energy_expended_due = WICED_TRUE;
     }
 
-    //Todo Add RR intervals once wiced bt HRS supports RR intervals
+    /* Queue the RR intervals of the beats since the last measurement */
+    hrs_app_cb.rr_elapsed += ((uint32_t)HRS_NOTIFY_PERIOD_MS * HRS_RR_UNITS_PER_S) / 1000;
+    while (hrs_app_cb.rr_elapsed >= (rr = hrs_next_rr_interval()))
+    {
+        hrs_rr_queue_push(rr);
+        hrs_app_cb.rr_elapsed -= rr;
+    }
+
+    /* A notification per connection event at most, the next one carries the
+     * RR intervals of the measurements in between */
+    hrs_app_cb.coalesced_ms += HRS_NOTIFY_PERIOD_MS;
+    if (hrs_app_cb.coalesced_ms < ((uint32_t)hrs_app_cb.conn_interval * 5) / 4)
+    {
+        return;
+    }
+    hrs_app_cb.coalesced_ms = 0;
 
-    status = wiced_bt_hrs_send_heart_rate( hrs_app_cb.conn_id, &heart_rate_notification );
-    WICED_BT_TRACE("notify heart rate %d \n", status);
+    hrs_send_measurements();
 }
 
 void hrs_event_cback(wiced_bt_hrs_event_t event, wiced_bt_hrs_event_data_t *p_data)
@@ -781,10 +941,10 @@ void hrs_event_cback(wiced_bt_hrs_event_t event, wiced_bt_hrs_event_data_t *p_da
     {
     case WICED_BT_HRS_EVENT_HEART_RATE_NOTIFICATIONS_ENABLED:
         WICED_BT_TRACE("[%s]Notification Enabled\n", __FUNCTION__);
-        /* on every 1 minute heart rate value notified to client*/
+        /* on every HRS_NOTIFY_PERIOD_MS heart rate value notified to client*/
         nvram_write = 1;
         hrs_host_info.heart_rate_notifications_enabled = 1;
-        wiced_start_timer(&hrs_app_cb.heart_rate_notify_timer, 60);
+        wiced_start_timer(&hrs_app_cb.heart_rate_notify_timer, HRS_NOTIFY_PERIOD_MS);
         break;
 
     case WICED_BT_HRS_EVENT_HEART_RATE_NOTIFICATIONS_DISABLED:
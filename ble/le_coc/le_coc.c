@@ -58,9 +58,16 @@
 #include "wiced_result.h"
 #include "wiced_transport.h"
 #include "wiced_hal_nvram.h"
+#include "wiced_memory.h"
 #include "wiced_bt_trace.h"
 #include "wiced_bt_stack.h"
 #include "hci_control_api.h"
+#include "hci_control_dispatch.h"
+#include "hci_trace_ring.h"
+#include "app_log.h"
+#include "buf_pool_stats.h"
+#include "latency_probe.h"
+#include "bond_store.h"
 #include "wiced_bt_ble.h"
 #include "wiced_platform.h"
 /******************************************************
@@ -91,17 +98,18 @@ void le_coc_connect(wiced_bt_device_address_t bd_addr, wiced_bt_ble_address_type
 void le_coc_data_cback(void *context, UINT16 local_cid, UINT8 *p_buff, UINT16 buf_len);
 void le_coc_disconnect_cfm_cback(void *context, UINT16 local_cid, UINT16 result);
 void le_coc_disconnect_ind_cback(void *context, UINT16 local_cid, BOOLEAN ack);
-void le_coc_disconnect(void);
+void le_coc_disconnect(uint16_t local_cid);
 void le_coc_hci_trace_cback(wiced_bt_hci_trace_type_t type, uint16_t length, uint8_t* p_data);
 void le_coc_init(void);
-void le_coc_send_to_client_control(uint16_t code, uint8_t* p_data, uint16_t length);
+wiced_bool_t le_coc_rx_pool_update(void);
 void le_coc_set_advertisement_data(void);
 void le_coc_transport_status(wiced_transport_type_t type);
 void le_coc_tx_complete_cback(void *context, uint16_t local_cid, uint16_t bufcount);
+static void le_coc_tx_queue_drain(le_coc_chan_t *p_chan);
+static void le_coc_tx_queue_flush(le_coc_chan_t *p_chan);
 wiced_bt_dev_status_t le_coc_management_callback(wiced_bt_management_evt_t event, wiced_bt_management_evt_data_t *p_event_data);
 
 const char* getStackEventStr(wiced_bt_management_evt_t event);
-const char* getOpcodeStr(uint16_t opcode);
 
 const wiced_transport_cfg_t transport_cfg =
 {
@@ -139,10 +147,20 @@ wiced_bt_l2cap_le_appl_information_t l2c_appl_info =
     le_coc_tx_complete_cback };
 
 le_coc_cb_t le_coc_cb;
+bond_store_t le_coc_bond_store;
 uint16_t psm;
 uint16_t mtu;
 wiced_transport_buffer_pool_t* rxBuffPoolPtr = NULL;
 
+/* Requested and currently allocated RX transport pool geometry */
+le_coc_rx_pool_cfg_t le_coc_rx_pool = { 0, 0 };
+static le_coc_rx_pool_cfg_t le_coc_rx_pool_allocated = { 0, 0 };
+
+/* HCI traces are kept in the ring and sent up through the UART in the background */
+static const hci_trace_ring_cfg_t le_coc_trace_ring_cfg = HCI_TRACE_RING_CFG_DEFAULT(NULL);
+static uint8_t le_coc_trace_ring_buf[HCI_TRACE_RING_BUF_SIZE(HCI_TRACE_RING_SLOTS, HCI_TRACE_RING_MAX_PAYLOAD)];
+static hci_trace_ring_t le_coc_trace_ring;
+
 /******************************************************
  *               Function Definitions
  ******************************************************/
@@ -154,24 +172,15 @@ APPLICATION_START()
     WICED_BT_TRACE("[%s]  ***** LE COC ***** \r\n", __func__);
 
     /* Initialize Bluetooth controller and host stack */
+    buf_pool_stats_init(wiced_bt_cfg_buf_pools);
     wiced_bt_stack_init(le_coc_management_callback, &wiced_bt_cfg_settings, wiced_bt_cfg_buf_pools);
 }
 
 void le_coc_load_keys_for_address_resolution(void)
 {
-    wiced_bt_device_link_keys_t link_keys;
-    wiced_result_t result;
-    uint8_t *p;
-
-    memset(&link_keys, 0, sizeof(wiced_bt_device_link_keys_t));
-
-    p = (uint8_t*) &link_keys;
-    wiced_hal_read_nvram( LE_COC_PAIRED_KEYS_VS_ID, sizeof(wiced_bt_device_link_keys_t), p, &result);
-
-    if (result == WICED_BT_SUCCESS)
-    {
-        result = wiced_bt_dev_add_device_to_address_resolution_db(&link_keys);
-    }
+    /* One NVRAM read for all the bonded peers */
+    bond_store_init(&le_coc_bond_store, LE_COC_PAIRED_KEYS_VS_ID, LE_COC_MAX_BONDS);
+    bond_store_load_addr_resolution_db(&le_coc_bond_store);
 }
 
 /* Bluetooth management event handler */
@@ -188,6 +197,7 @@ wiced_bt_dev_status_t le_coc_management_callback(wiced_bt_management_evt_t event
         case BTM_ENABLED_EVT:
 
             /* Register callback for receiving hci traces */
+            hci_trace_ring_init(&le_coc_trace_ring, &le_coc_trace_ring_cfg, le_coc_trace_ring_buf, sizeof(le_coc_trace_ring_buf));
             wiced_bt_dev_register_hci_trace(le_coc_hci_trace_cback);
 
             /* Allow peer to pair */
@@ -220,14 +230,12 @@ wiced_bt_dev_status_t le_coc_management_callback(wiced_bt_management_evt_t event
 
         case BTM_PAIRED_DEVICE_LINK_KEYS_UPDATE_EVT:
             /* save keys to NVRAM */
-            p_keys = (uint8_t*) &p_event_data->paired_device_link_keys_update;
-            wiced_hal_write_nvram( LE_COC_PAIRED_KEYS_VS_ID, sizeof(wiced_bt_device_link_keys_t), p_keys, &status);
+            status = bond_store_save(&le_coc_bond_store, &p_event_data->paired_device_link_keys_update) ? WICED_BT_SUCCESS : WICED_BT_ERROR;
             break;
 
         case BTM_PAIRED_DEVICE_LINK_KEYS_REQUEST_EVT:
             /* read keys from NVRAM */
-            p_keys = (uint8_t *) &p_event_data->paired_device_link_keys_request;
-            wiced_hal_read_nvram( LE_COC_PAIRED_KEYS_VS_ID, sizeof(wiced_bt_device_link_keys_t), p_keys, &status);
+            status = bond_store_read(&le_coc_bond_store, &p_event_data->paired_device_link_keys_request) ? WICED_BT_SUCCESS : WICED_BT_ERROR;
             break;
 
         case BTM_LOCAL_IDENTITY_KEYS_UPDATE_EVT:
@@ -254,64 +262,321 @@ wiced_bt_dev_status_t le_coc_management_callback(wiced_bt_management_evt_t event
     return (status);
 }
 
+/* Find the channel context of an open channel */
+le_coc_chan_t* le_coc_find_chan(uint16_t local_cid)
+{
+    int i;
+
+    if (local_cid == LE_COC_INVALID_CID)
+        return NULL;
+
+    for (i = 0; i < LE_COC_MAX_CHANNELS; i++)
+    {
+        if (le_coc_cb.chan[i].local_cid == local_cid)
+            return &le_coc_cb.chan[i];
+    }
+
+    return NULL;
+}
+
+/* Find an unused channel context */
+static le_coc_chan_t* le_coc_find_free_chan(void)
+{
+    int i;
+
+    for (i = 0; i < LE_COC_MAX_CHANNELS; i++)
+    {
+        if (le_coc_cb.chan[i].local_cid == LE_COC_INVALID_CID)
+            return &le_coc_cb.chan[i];
+    }
+
+    return NULL;
+}
+
+/* Claim a free channel context for a new channel */
+static le_coc_chan_t* le_coc_alloc_chan(uint16_t local_cid)
+{
+    le_coc_chan_t *p_chan = le_coc_find_free_chan();
+
+    if (p_chan != NULL)
+    {
+        memset(p_chan, 0, sizeof(le_coc_chan_t));
+        p_chan->local_cid = local_cid;
+    }
+
+    return p_chan;
+}
+
+/* Release a channel context, dropping whatever was still queued */
+static void le_coc_free_chan(le_coc_chan_t *p_chan)
+{
+    int i;
+
+    le_coc_bench_chan_closed(p_chan->local_cid);
+    le_coc_bulk_chan_closed(p_chan->local_cid);
+    le_coc_tx_queue_flush(p_chan);
+
+    p_chan->local_cid = LE_COC_INVALID_CID;
+    memset(p_chan->peer_bda, 0, BD_ADDR_LEN);
+
+    /* Let the commands without a CID fall back to another open channel */
+    if (le_coc_find_chan(le_coc_cb.default_cid) == NULL)
+    {
+        le_coc_cb.default_cid = LE_COC_INVALID_CID;
+
+        for (i = 0; i < LE_COC_MAX_CHANNELS; i++)
+        {
+            if (le_coc_cb.chan[i].local_cid != LE_COC_INVALID_CID)
+            {
+                le_coc_cb.default_cid = le_coc_cb.chan[i].local_cid;
+                break;
+            }
+        }
+    }
+}
+
+/* Returns WICED_TRUE if any channel is open or being opened */
+wiced_bool_t le_coc_is_any_chan_open(void)
+{
+    int i;
+
+    for (i = 0; i < LE_COC_MAX_CHANNELS; i++)
+    {
+        if (le_coc_cb.chan[i].local_cid != LE_COC_INVALID_CID)
+            return WICED_TRUE;
+    }
+
+    return WICED_FALSE;
+}
+
+/*
+ * Send a channel event to the client control. With CID tagging enabled the
+ * CID tagged variant of the event is sent with the CID ahead of the payload,
+ * otherwise the legacy event the client control expects.
+ */
+static wiced_result_t le_coc_send_chan_event(le_coc_chan_t *p_chan, uint16_t code, uint16_t cid_code, uint8_t* p_data, uint16_t length)
+{
+    uint8_t evt[LE_COC_CID_TAG_LEN + BD_ADDR_LEN + 2], *p = evt;
+    uint8_t *dataPtr;
+    wiced_result_t result;
+
+    if (!le_coc_cb.cid_events)
+        return le_coc_send_to_client_control(code, p_data, length);
+
+    /* Small payloads such as the connection events are built on the stack */
+    if (length <= (sizeof(evt) - LE_COC_CID_TAG_LEN))
+    {
+        UINT16_TO_STREAM(p, p_chan->local_cid);
+        memcpy(p, p_data, length);
+        return le_coc_send_to_client_control(cid_code, evt, length + LE_COC_CID_TAG_LEN);
+    }
+
+    /* Larger ones are framed directly in a transport buffer so the data is copied only once */
+    if (length + LE_COC_CID_TAG_LEN > le_coc_rx_pool_allocated.buffer_size)
+    {
+        WICED_BT_TRACE("[%s] 0x%x length %d larger than the transport buffers\r\n", __func__, cid_code, length);
+        return WICED_BADARG;
+    }
+    if ((rxBuffPoolPtr == NULL) || ((dataPtr = wiced_transport_allocate_buffer(rxBuffPoolPtr)) == NULL))
+        return WICED_NO_MEMORY;
+
+    p = dataPtr;
+    UINT16_TO_STREAM(p, p_chan->local_cid);
+    memcpy(p, p_data, length);
+
+    if ((result = wiced_transport_send_buffer(cid_code, dataPtr, length + LE_COC_CID_TAG_LEN)) != WICED_SUCCESS)
+        WICED_BT_TRACE("[%s] wiced_transport_send_buffer failed 0x%x length %d \r\n", __func__, cid_code, length);
+
+    return result;
+}
+
+/* Request the connection parameters, data length and PHY of the selected link profile for a channel */
+static void le_coc_apply_link_profile(le_coc_chan_t *p_chan)
+{
+    const le_coc_link_profile_t *p_profile = &le_coc_link_profiles[le_coc_cb.link_profile];
+    wiced_bt_ble_phy_preferences_t phy_preferences;
+    wiced_bt_device_address_t bda;
+    uint8_t *p = p_chan->peer_bda;
+
+    STREAM_TO_BDADDR(bda, p);
+
+    if (p_profile->conn_min_interval != 0)
+    {
+        if (!wiced_bt_l2cap_update_ble_conn_params(bda, p_profile->conn_min_interval, p_profile->conn_max_interval,
+                p_profile->conn_latency, p_profile->supervision_timeout))
+            WICED_BT_TRACE("[%s] conn params update failed\r\n", __func__);
+    }
+
+#if defined(CYW20719B2) || defined(CYW20721B2) || defined(CYW20819A1) || defined (CYW20820A1)
+    if (p_profile->tx_pdu_length != 0)
+    {
+        wiced_bt_ble_set_data_packet_length(bda, p_profile->tx_pdu_length);
+    }
+#endif
+
+    if (p_profile->phys != 0)
+    {
+        memcpy(phy_preferences.remote_bd_addr, bda, BD_ADDR_LEN);
+        phy_preferences.rx_phys = phy_preferences.tx_phys = p_profile->phys;
+#if defined(CYW20721B2) || defined(CYW20719B2)
+        phy_preferences.phy_opts = BTM_BLE_PREFER_NO_LELR;
+#else
+        phy_preferences.phy_opts = BTM_BLE_PREFER_CODED_PHY_NONE;
+#endif
+        if (wiced_bt_ble_set_phy(&phy_preferences) != WICED_BT_SUCCESS)
+            WICED_BT_TRACE("[%s] set PHY failed\r\n", __func__);
+    }
+
+    WICED_BT_TRACE("[%s] CID %d profile %d\r\n", __func__, p_chan->local_cid, le_coc_cb.link_profile);
+}
+
+/* Handle HCI_CONTROL_LE_COC_COMMAND_SET_LINK_PROFILE */
+static uint8_t le_coc_set_link_profile(uint8_t* p_data, uint32_t data_len)
+{
+    int i;
+
+    if ((data_len != 1) || (p_data[0] >= LE_COC_LINK_PROFILE_MAX))
+        return HCI_CONTROL_STATUS_INVALID_ARGS;
+
+    le_coc_cb.link_profile = p_data[0];
+
+    for (i = 0; i < LE_COC_MAX_CHANNELS; i++)
+    {
+        if ((le_coc_cb.chan[i].local_cid != LE_COC_INVALID_CID) && (le_coc_cb.chan[i].peer_mtu != 0))
+            le_coc_apply_link_profile(&le_coc_cb.chan[i]);
+    }
+
+    return HCI_CONTROL_STATUS_SUCCESS;
+}
+
+/* Indicate an open (or failed) channel to the client control */
+static void le_coc_send_connected(le_coc_chan_t *p_chan)
+{
+    uint8_t evt[BD_ADDR_LEN + 2], *p = &evt[BD_ADDR_LEN];
+
+    memcpy(evt, p_chan->peer_bda, BD_ADDR_LEN);
+    UINT16_TO_STREAM(p, p_chan->peer_mtu);
+
+    /* The legacy event carries the address only */
+    le_coc_send_chan_event(p_chan, HCI_CONTROL_LE_COC_EVENT_CONNECTED, HCI_CONTROL_LE_COC_EVENT_CHAN_CONNECTED,
+            evt, le_coc_cb.cid_events ? sizeof(evt) : BD_ADDR_LEN);
+}
+
 /* L2CAP Data RX callback */
 void le_coc_data_cback(void *context, UINT16 local_cid, UINT8 *p_data, UINT16 len)
 {
-    WICED_BT_TRACE("[%s] received %d bytes\r\n", __func__, len);
+    le_coc_chan_t *p_chan = le_coc_find_chan(local_cid);
+    uint8_t evt[6], *p = evt;
+
+    APP_LOG_DBG("[le_coc_data_cback] CID %d received %d bytes\r\n", local_cid, len);
+
+    if (p_chan == NULL)
+        return;
+
+    p_chan->rx_sdus++;
+    p_chan->rx_bytes += len;
+
+    /* Benchmark traffic is consumed on the device */
+    if (le_coc_bench_rx(p_chan, p_data, len))
+        return;
+
+    /* So are the frames of a bulk transfer, the sink forwards the data */
+    if (le_coc_bulk_rx(p_chan, p_data, len))
+        return;
 
     /* send the received data to the client control */
-    le_coc_send_to_client_control(HCI_CONTROL_LE_COC_EVENT_RX_DATA, p_data, len);
+    if (le_coc_send_chan_event(p_chan, HCI_CONTROL_LE_COC_EVENT_RX_DATA, HCI_CONTROL_LE_COC_EVENT_CHAN_RX_DATA, p_data, len) == WICED_SUCCESS)
+    {
+        p_chan->rx_dropping = WICED_FALSE;
+        return;
+    }
 
-    return;
+    p_chan->rx_dropped++;
+
+    /* Report only the first drop of a run so that the event does not add to the load on the transport */
+    if (!p_chan->rx_dropping)
+    {
+        p_chan->rx_dropping = WICED_TRUE;
+        UINT16_TO_STREAM(p, local_cid);
+        UINT32_TO_STREAM(p, p_chan->rx_dropped);
+        le_coc_send_to_client_control(HCI_CONTROL_LE_COC_EVENT_RX_DROPPED, evt, sizeof(evt));
+    }
 }
 
 /* L2CAP connection management callback */
 void le_coc_connect_ind_cback(void *context, BD_ADDR bda, UINT16 local_cid, UINT16 psm, UINT8 id, UINT16 mtu_peer)
 {
-    uint8_t *p_data = le_coc_cb.peer_bda;
+    le_coc_chan_t *p_chan;
+    uint8_t *p_data;
 
     WICED_BT_TRACE("[%s] from %B CID %d PSM 0x%x MTU %d \r\n", __func__, bda, local_cid, psm, mtu_peer);
 
+    if ((p_chan = le_coc_alloc_chan(local_cid)) == NULL)
+    {
+        WICED_BT_TRACE("[%s] no free channel context\r\n", __func__);
+        wiced_bt_l2cap_le_connect_rsp(bda, id, local_cid, L2CAP_CONN_NO_RESOURCES, mtu, L2CAP_DEFAULT_BLE_CB_POOL_ID);
+        return;
+    }
+
     /* Accept the connection */
     wiced_bt_l2cap_le_connect_rsp(bda, id, local_cid, L2CAP_CONN_OK, mtu, L2CAP_DEFAULT_BLE_CB_POOL_ID);
 
     /* Store peer info for reference*/
-    le_coc_cb.local_cid = local_cid;
+    p_data = p_chan->peer_bda;
     BDADDR_TO_STREAM(p_data, bda);
-    le_coc_cb.peer_mtu = mtu_peer;
+    p_chan->peer_mtu = mtu_peer;
+    le_coc_cb.default_cid = local_cid;
 
-    /* Stop advertising */
-    wiced_bt_start_advertisements(BTM_BLE_ADVERT_OFF, 0, NULL);
+    /* Keep advertising while there is room for another channel */
+    if (le_coc_find_free_chan() == NULL)
+    {
+        wiced_bt_start_advertisements(BTM_BLE_ADVERT_OFF, 0, NULL);
+    }
 
     /* Indicate to client control */
-    le_coc_send_to_client_control(HCI_CONTROL_LE_COC_EVENT_CONNECTED, le_coc_cb.peer_bda, BD_ADDR_LEN);
+    le_coc_send_connected(p_chan);
+
+    le_coc_apply_link_profile(p_chan);
 }
 
 void le_coc_connect_cfm_cback(void *context, UINT16 local_cid, UINT16 result, UINT16 mtu_peer)
 {
-    WICED_BT_TRACE("[%s] result :%02x MTU %d \r\n", __func__, result, mtu_peer);
+    le_coc_chan_t *p_chan = le_coc_find_chan(local_cid);
+
+    WICED_BT_TRACE("[%s] CID %d result :%02x MTU %d \r\n", __func__, local_cid, result, mtu_peer);
+
+    if (p_chan == NULL)
+        return;
 
     if (result == 0)
     {
         /* Store peer info for reference*/
-        le_coc_cb.local_cid = local_cid;
-        le_coc_cb.peer_mtu = mtu_peer;
+        p_chan->peer_mtu = mtu_peer;
+        le_coc_cb.default_cid = local_cid;
+
+        /* Indicate to client control */
+        le_coc_send_connected(p_chan);
+
+        le_coc_apply_link_profile(p_chan);
     }
     else
     {
         /* For now sending NULL bd address can be accept by CC to consider connection failure. Todo: proper error code handshake */
-        memset(le_coc_cb.peer_bda, 0, BD_ADDR_LEN);
-    }
+        memset(p_chan->peer_bda, 0, BD_ADDR_LEN);
 
-    /* Indicate to client control */
-    le_coc_send_to_client_control(HCI_CONTROL_LE_COC_EVENT_CONNECTED, le_coc_cb.peer_bda, BD_ADDR_LEN);
+        /* Indicate to client control */
+        le_coc_send_connected(p_chan);
+
+        le_coc_free_chan(p_chan);
+    }
 }
 
 void le_coc_disconnect_ind_cback(void *context, UINT16 local_cid, BOOLEAN ack)
 {
+    le_coc_chan_t *p_chan = le_coc_find_chan(local_cid);
     wiced_bt_device_address_t bda;
     uint16_t reason;
-    uint8_t* peer_address = le_coc_cb.peer_bda;
+    uint8_t* peer_address;
 
     WICED_BT_TRACE("[%s] CID %d \r\n", __func__, local_cid);
 
@@ -321,8 +586,9 @@ void le_coc_disconnect_ind_cback(void *context, UINT16 local_cid, BOOLEAN ack)
         wiced_bt_l2cap_le_disconnect_rsp(local_cid);
     }
 
-    if (le_coc_cb.local_cid == local_cid)
+    if (p_chan != NULL)
     {
+        peer_address = p_chan->peer_bda;
         STREAM_TO_BDADDR(bda, peer_address);
 
         /* Get the disconnect reason - MUST call wiced_bt_l2cap_get_disconnect_reason w/in this context */
@@ -330,50 +596,79 @@ void le_coc_disconnect_ind_cback(void *context, UINT16 local_cid, BOOLEAN ack)
         WICED_BT_TRACE("Disconnect reason %x\n", reason);
 
         /* Indicate to client control */
-        le_coc_send_to_client_control(HCI_CONTROL_LE_COC_EVENT_DISCONNECTED, le_coc_cb.peer_bda, BD_ADDR_LEN);
+        le_coc_send_chan_event(p_chan, HCI_CONTROL_LE_COC_EVENT_DISCONNECTED, HCI_CONTROL_LE_COC_EVENT_CHAN_DISCONNECTED, p_chan->peer_bda, BD_ADDR_LEN);
 
-        le_coc_cb.local_cid = 0xFFFF;
-        memset(le_coc_cb.peer_bda, 0, BD_ADDR_LEN);
+        le_coc_free_chan(p_chan);
     }
 }
 
 void le_coc_disconnect_cfm_cback(void *context, UINT16 local_cid, UINT16 result)
 {
+    le_coc_chan_t *p_chan = le_coc_find_chan(local_cid);
+
     WICED_BT_TRACE("[%s] CID %d \r\n", __func__, local_cid);
 
-    if (le_coc_cb.local_cid == local_cid)
+    if (p_chan != NULL)
     {
         /* Indicate to client control */
-        le_coc_send_to_client_control(HCI_CONTROL_LE_COC_EVENT_DISCONNECTED, le_coc_cb.peer_bda, BD_ADDR_LEN);
+        le_coc_send_chan_event(p_chan, HCI_CONTROL_LE_COC_EVENT_DISCONNECTED, HCI_CONTROL_LE_COC_EVENT_CHAN_DISCONNECTED, p_chan->peer_bda, BD_ADDR_LEN);
 
-        le_coc_cb.local_cid = 0xFFFF;
-        memset(le_coc_cb.peer_bda, 0, BD_ADDR_LEN);
+        le_coc_free_chan(p_chan);
     }
 }
 
 void le_coc_congestion_cback(void *context, UINT16 local_cid, BOOLEAN congested)
 {
-    WICED_BT_TRACE("[%s] CID %d \r\n", __func__, local_cid);
+    le_coc_chan_t *p_chan = le_coc_find_chan(local_cid);
+
+    WICED_BT_TRACE("[%s] CID %d congested %d\r\n", __func__, local_cid, congested);
+
+    if (p_chan == NULL)
+        return;
+
+    p_chan->congested = congested;
 
     if (!(congested))
     {
-        //TODO: send data if pending
+        /* Credits are available again, send whatever was held back */
+        le_coc_tx_queue_drain(p_chan);
+        le_coc_bench_tx_ready(p_chan);
+        le_coc_bulk_tx_ready(p_chan);
     }
 }
 
 void le_coc_tx_complete_cback(void *context, uint16_t local_cid, uint16_t bufcount)
 {
-    uint8_t status;
+    le_coc_chan_t *p_chan = le_coc_find_chan(local_cid);
+    uint8_t status = HCI_CONTROL_STATUS_SUCCESS;
 
     WICED_BT_TRACE("[%s] CID %d bufcount %d\r\n", __func__, local_cid, bufcount);
+    LATENCY_PROBE(LATENCY_PROBE_TX_COMPLETE, local_cid);
 
-    le_coc_send_to_client_control(HCI_CONTROL_LE_COC_EVENT_TX_COMPLETE, &status, 1);
+    if (p_chan == NULL)
+        return;
+
+    le_coc_tx_queue_drain(p_chan);
+
+    /* A TX complete event per benchmark SDU would load the UART more than the data itself */
+    if (le_coc_bench_active(p_chan))
+    {
+        le_coc_bench_tx_ready(p_chan);
+        return;
+    }
+    if (le_coc_bulk_active(p_chan))
+    {
+        le_coc_bulk_tx_ready(p_chan);
+        return;
+    }
+
+    le_coc_send_chan_event(p_chan, HCI_CONTROL_LE_COC_EVENT_TX_COMPLETE, HCI_CONTROL_LE_COC_EVENT_CHAN_TX_COMPLETE, &status, 1);
 }
 
-void le_coc_disconnect(void)
+void le_coc_disconnect(uint16_t local_cid)
 {
-    if (le_coc_cb.local_cid)
-        wiced_bt_l2cap_le_disconnect_req(le_coc_cb.local_cid);
+    if (le_coc_find_chan(local_cid) != NULL)
+        wiced_bt_l2cap_le_disconnect_req(local_cid);
 }
 
 void le_coc_set_advertisement_data(void)
@@ -402,47 +697,358 @@ void le_coc_set_advertisement_data(void)
 /* Initialize Extended Data Packet Server/Client */
 void le_coc_init(void)
 {
-    /* Clear app control block */
-    memset(&le_coc_cb, 0, sizeof(le_coc_cb_t));
-    le_coc_cb.local_cid = 0xFFFF;
+    int i;
+
+    /* Release anything still queued before clearing the channel table */
+    for (i = 0; i < LE_COC_MAX_CHANNELS; i++)
+    {
+        if (le_coc_cb.chan[i].local_cid != LE_COC_INVALID_CID)
+            le_coc_tx_queue_flush(&le_coc_cb.chan[i]);
+    }
+
+    /* Settings chosen by the client control (event format, link profile) are kept */
+    memset(le_coc_cb.chan, 0, sizeof(le_coc_cb.chan));
+    for (i = 0; i < LE_COC_MAX_CHANNELS; i++)
+    {
+        le_coc_cb.chan[i].local_cid = LE_COC_INVALID_CID;
+    }
+    le_coc_cb.default_cid = LE_COC_INVALID_CID;
 
     /* Register LE l2cap callbacks */
     wiced_bt_l2cap_le_register(psm, &l2c_appl_info, NULL);
 
-    rxBuffPoolPtr = wiced_transport_create_buffer_pool(mtu + 64, 5);
+    if (le_coc_rx_pool.buffer_count == 0)
+    {
+        le_coc_rx_pool = le_coc_rx_pool_cfg;
+    }
+
+    le_coc_rx_pool_update();
+}
+
+/*
+ * Make sure the RX transport pool matches the requested geometry. The transport
+ * can not release a pool once created, so an existing pool that is already
+ * large enough is kept and a new one is created only when more or larger
+ * buffers are needed. A buffer size set by the client control is grown when a
+ * later SET_MTU makes it too small for an SDU. Must not be called while a
+ * channel is open since buffers of the old pool may still be queued on the
+ * transport.
+ */
+wiced_bool_t le_coc_rx_pool_update(void)
+{
+    wiced_transport_buffer_pool_t* p_pool;
+    uint16_t buffer_size = le_coc_rx_pool.buffer_size;
+
+    if (buffer_size == 0)
+    {
+        buffer_size = mtu + LE_COC_RX_POOL_HEADROOM;
+    }
+    else if (buffer_size < (mtu + LE_COC_CID_TAG_LEN))
+    {
+        buffer_size = mtu + LE_COC_CID_TAG_LEN;
+    }
+
+    if ((rxBuffPoolPtr != NULL) &&
+        (le_coc_rx_pool_allocated.buffer_size >= buffer_size) &&
+        (le_coc_rx_pool_allocated.buffer_count >= le_coc_rx_pool.buffer_count))
+    {
+        return WICED_TRUE;
+    }
+
+    if ((p_pool = wiced_transport_create_buffer_pool(buffer_size, le_coc_rx_pool.buffer_count)) == NULL)
+    {
+        WICED_BT_TRACE("[%s] unable to create %d x %d pool\r\n", __func__, le_coc_rx_pool.buffer_count, buffer_size);
+        return WICED_FALSE;
+    }
+
+    WICED_BT_TRACE("[%s] %d x %d bytes\r\n", __func__, le_coc_rx_pool.buffer_count, buffer_size);
+
+    rxBuffPoolPtr = p_pool;
+    le_coc_rx_pool_allocated.buffer_size  = buffer_size;
+    le_coc_rx_pool_allocated.buffer_count = le_coc_rx_pool.buffer_count;
+
+    return WICED_TRUE;
+}
+
+/* Handle HCI_CONTROL_LE_COC_COMMAND_SET_RX_POOL */
+uint8_t le_coc_set_rx_pool(uint8_t* p_data, uint32_t data_len)
+{
+    uint16_t buffer_size;
+    uint8_t buffer_count;
+
+    if (data_len != 3)
+        return HCI_CONTROL_STATUS_INVALID_ARGS;
+
+    STREAM_TO_UINT16(buffer_size, p_data);
+    STREAM_TO_UINT8(buffer_count, p_data);
+
+    /* An SDU of the local MTU, CID tagged, has to fit in one buffer */
+    if ((buffer_count == 0) ||
+        ((buffer_size != 0) && ((buffer_size < LE_COC_TRANSPORT_MAX_INLINE_DATA) || (buffer_size < (mtu + LE_COC_CID_TAG_LEN)))))
+        return HCI_CONTROL_STATUS_INVALID_ARGS;
+
+    /* Buffers of the current pool may be in flight while a channel is open */
+    if ((rxBuffPoolPtr != NULL) && le_coc_is_any_chan_open())
+        return HCI_CONTROL_STATUS_WRONG_STATE;
+
+    le_coc_rx_pool.buffer_size  = buffer_size;
+    le_coc_rx_pool.buffer_count = buffer_count;
+
+    /* Until SET_MTU initializes LE COC the new geometry is only recorded */
+    if ((rxBuffPoolPtr != NULL) && !le_coc_rx_pool_update())
+        return HCI_CONTROL_STATUS_FAILED;
+
+    return HCI_CONTROL_STATUS_SUCCESS;
 }
 
-uint32_t le_coc_send_data(uint8_t* p_data, uint32_t data_len)
+/* Report the TX queue state of a channel to the client control */
+static void le_coc_tx_queue_report(le_coc_chan_t *p_chan, uint8_t state)
 {
-    uint8_t ret_val = 0;
+    uint8_t evt[4], *p = evt;
 
-    //TODO: Check if the received data_len is larger that the peer MTU
-    ret_val = wiced_bt_l2cap_le_data_write(le_coc_cb.local_cid, p_data, data_len, 0);
-    WICED_BT_TRACE("[%s] ret_val : %d data_len : %d\r\n", __func__, ret_val, data_len);
+    UINT16_TO_STREAM(p, p_chan->local_cid);
+    UINT8_TO_STREAM(p, state);
+    UINT8_TO_STREAM(p, p_chan->tx_queue.count);
+
+    le_coc_send_to_client_control(HCI_CONTROL_LE_COC_EVENT_TX_FLOW, evt, sizeof(evt));
+}
+
+/* Copy an SDU to the tail of the TX queue. Returns WICED_FALSE if the queue is full or out of buffers */
+static wiced_bool_t le_coc_tx_queue_put(le_coc_chan_t *p_chan, uint8_t *p_data, uint16_t data_len)
+{
+    le_coc_tx_queue_t *p_queue = &p_chan->tx_queue;
+    uint8_t *p_sdu;
+    uint8_t tail;
+
+    if (p_queue->count >= LE_COC_TX_QUEUE_SIZE)
+        return WICED_FALSE;
+
+    if ((p_sdu = (uint8_t *) buf_pool_stats_get_buffer(data_len)) == NULL)
+        return WICED_FALSE;
+
+    memcpy(p_sdu, p_data, data_len);
+
+    tail = (p_queue->head + p_queue->count) % LE_COC_TX_QUEUE_SIZE;
+    p_queue->p_sdu[tail]   = p_sdu;
+    p_queue->sdu_len[tail] = data_len;
+    p_queue->count++;
+    LATENCY_PROBE(LATENCY_PROBE_TX_QUEUED, p_chan->local_cid);
+
+    if (!p_queue->flow_off && (p_queue->count >= LE_COC_TX_QUEUE_HIGH_WATER))
+    {
+        p_queue->flow_off = WICED_TRUE;
+        le_coc_tx_queue_report(p_chan, LE_COC_TX_FLOW_OFF);
+    }
+
+    return WICED_TRUE;
+}
+
+/* Release the SDU at the head of the TX queue */
+static void le_coc_tx_queue_pop(le_coc_tx_queue_t *p_queue)
+{
+    wiced_bt_free_buffer(p_queue->p_sdu[p_queue->head]);
+    p_queue->p_sdu[p_queue->head] = NULL;
+    p_queue->head = (p_queue->head + 1) % LE_COC_TX_QUEUE_SIZE;
+    p_queue->count--;
+}
+
+/* Write queued SDUs to the channel until it becomes congested or the queue is empty */
+static void le_coc_tx_queue_drain(le_coc_chan_t *p_chan)
+{
+    le_coc_tx_queue_t *p_queue = &p_chan->tx_queue;
+    uint8_t ret_val;
+
+    while ((p_queue->count != 0) && !p_chan->congested)
+    {
+        LATENCY_PROBE(LATENCY_PROBE_TX_SENT, p_chan->local_cid);
+        ret_val = wiced_bt_l2cap_le_data_write(p_chan->local_cid, p_queue->p_sdu[p_queue->head], p_queue->sdu_len[p_queue->head], 0);
+
+        if (ret_val == L2CAP_DATAWRITE_FAILED)
+        {
+            WICED_BT_TRACE("[%s] write failed, dropping %d bytes\r\n", __func__, p_queue->sdu_len[p_queue->head]);
+            p_chan->tx_dropped++;
+            le_coc_tx_queue_report(p_chan, LE_COC_TX_FLOW_DROPPED);
+        }
+        else
+        {
+            p_chan->tx_sdus++;
+            p_chan->tx_bytes += p_queue->sdu_len[p_queue->head];
+
+            /* The SDU was accepted but no more can be sent until the congestion callback clears it */
+            if (ret_val == L2CAP_DATAWRITE_CONGESTED)
+                p_chan->congested = WICED_TRUE;
+        }
+
+        le_coc_tx_queue_pop(p_queue);
+    }
+
+    if (p_queue->flow_off && (p_queue->count <= LE_COC_TX_QUEUE_LOW_WATER))
+    {
+        p_queue->flow_off = WICED_FALSE;
+        le_coc_tx_queue_report(p_chan, LE_COC_TX_FLOW_ON);
+    }
+}
+
+/* Drop everything queued, e.g. when the channel goes away */
+static void le_coc_tx_queue_flush(le_coc_chan_t *p_chan)
+{
+    le_coc_tx_queue_t *p_queue = &p_chan->tx_queue;
+
+    while (p_queue->count != 0)
+    {
+        le_coc_tx_queue_pop(p_queue);
+    }
+
+    p_chan->congested = WICED_FALSE;
+
+    if (p_queue->flow_off)
+    {
+        p_queue->flow_off = WICED_FALSE;
+        le_coc_tx_queue_report(p_chan, LE_COC_TX_FLOW_ON);
+    }
+}
+
+/* Send one SDU, writing straight through only when nothing is queued ahead so SDU order is preserved */
+static uint8_t le_coc_send_sdu(le_coc_chan_t *p_chan, uint8_t* p_data, uint16_t sdu_len)
+{
+    uint8_t ret_val = L2CAP_DATAWRITE_SUCCESS;
+
+    if (!p_chan->congested && (p_chan->tx_queue.count == 0))
+    {
+        LATENCY_PROBE(LATENCY_PROBE_TX_SENT, p_chan->local_cid);
+        ret_val = wiced_bt_l2cap_le_data_write(p_chan->local_cid, p_data, sdu_len, 0);
+
+        if (ret_val != L2CAP_DATAWRITE_FAILED)
+        {
+            p_chan->tx_sdus++;
+            p_chan->tx_bytes += sdu_len;
+        }
+
+        if (ret_val == L2CAP_DATAWRITE_CONGESTED)
+        {
+            p_chan->congested = WICED_TRUE;
+        }
+    }
+    else if (!le_coc_tx_queue_put(p_chan, p_data, sdu_len))
+    {
+        ret_val = L2CAP_DATAWRITE_FAILED;
+    }
+
+    return ret_val;
+}
+
+/*
+ * Send host data to the peer on the given channel. Payloads larger than the
+ * peer MTU are split into MTU sized SDUs which go out back-to-back (L2CAP
+ * further fragments each SDU to the negotiated MPS). Segments that do not fit
+ * in the TX queue are dropped and reported to the client control.
+ */
+uint32_t le_coc_send_data(uint16_t local_cid, uint8_t* p_data, uint32_t data_len)
+{
+    le_coc_chan_t *p_chan = le_coc_find_chan(local_cid);
+    uint8_t ret_val = L2CAP_DATAWRITE_SUCCESS;
+    uint16_t sdu_max;
+    uint16_t sdu_len;
+    uint32_t offset = 0;
+
+    if (p_chan == NULL)
+    {
+        WICED_BT_TRACE("[%s] CID %d not open\r\n", __func__, local_cid);
+        return L2CAP_DATAWRITE_FAILED;
+    }
+
+    sdu_max = p_chan->peer_mtu;
+    if ((sdu_max == 0) || (sdu_max > LE_COC_TX_MAX_SDU_SIZE))
+    {
+        sdu_max = LE_COC_TX_MAX_SDU_SIZE;
+    }
+
+    while (offset < data_len)
+    {
+        sdu_len = ((data_len - offset) > sdu_max) ? sdu_max : (uint16_t) (data_len - offset);
+
+        if (le_coc_send_sdu(p_chan, &p_data[offset], sdu_len) == L2CAP_DATAWRITE_FAILED)
+        {
+            ret_val = L2CAP_DATAWRITE_FAILED;
+            break;
+        }
+
+        if (p_chan->congested)
+        {
+            ret_val = L2CAP_DATAWRITE_CONGESTED;
+        }
+
+        offset += sdu_len;
+    }
+
+    if (ret_val == L2CAP_DATAWRITE_FAILED)
+    {
+        p_chan->tx_dropped++;
+        le_coc_tx_queue_report(p_chan, LE_COC_TX_FLOW_DROPPED);
+    }
+
+    WICED_BT_TRACE("[%s] CID %d ret_val : %d data_len : %d sent : %d queued : %d\r\n", __func__, local_cid, ret_val, data_len, offset, p_chan->tx_queue.count);
 
     return ret_val;
 }
 
+/* Report the counters of a channel to the client control */
+uint8_t le_coc_send_chan_stats(uint16_t local_cid)
+{
+    le_coc_chan_t *p_chan = le_coc_find_chan(local_cid);
+    uint8_t evt[2 + 6 * 4], *p = evt;
+
+    if (p_chan == NULL)
+        return HCI_CONTROL_STATUS_INVALID_ARGS;
+
+    UINT16_TO_STREAM(p, p_chan->local_cid);
+    UINT32_TO_STREAM(p, p_chan->tx_sdus);
+    UINT32_TO_STREAM(p, p_chan->tx_bytes);
+    UINT32_TO_STREAM(p, p_chan->tx_dropped);
+    UINT32_TO_STREAM(p, p_chan->rx_sdus);
+    UINT32_TO_STREAM(p, p_chan->rx_bytes);
+    UINT32_TO_STREAM(p, p_chan->rx_dropped);
+
+    le_coc_send_to_client_control(HCI_CONTROL_LE_COC_EVENT_CHAN_STATS, evt, sizeof(evt));
+
+    return HCI_CONTROL_STATUS_SUCCESS;
+}
+
 /* Initiate connection */
 void le_coc_connect(wiced_bt_device_address_t bd_addr, wiced_bt_ble_address_type_t bd_addr_type)
 {
     uint8_t req_security = 0;
     uint8_t req_encr_key_size = 0;
-    uint8_t *p_data = le_coc_cb.peer_bda;
+    le_coc_chan_t *p_chan;
+    uint16_t local_cid;
+    uint8_t *p_data;
+
+    if (le_coc_find_free_chan() == NULL)
+    {
+        WICED_BT_TRACE("[%s] no free channel context\r\n", __func__);
+        return;
+    }
 
     /* Initiate the connection L2CAP connection */
-    wiced_bt_l2cap_le_connect_req(psm, (uint8_t*) bd_addr, bd_addr_type, BLE_CONN_MODE_HIGH_DUTY, mtu,
+    local_cid = wiced_bt_l2cap_le_connect_req(psm, (uint8_t*) bd_addr, bd_addr_type, BLE_CONN_MODE_HIGH_DUTY, mtu,
     L2CAP_DEFAULT_BLE_CB_POOL_ID, req_security, req_encr_key_size);
 
+    if ((local_cid == 0) || ((p_chan = le_coc_alloc_chan(local_cid)) == NULL))
+    {
+        WICED_BT_TRACE("[%s] connect request failed\r\n", __func__);
+        return;
+    }
+
+    p_data = p_chan->peer_bda;
     BDADDR_TO_STREAM(p_data, bd_addr);
 }
 
 /*
- *  Pass protocol traces up through the UART
+ *  Pass protocol traces up through the UART, in the background from the ring
  */
 void le_coc_hci_trace_cback(wiced_bt_hci_trace_type_t type, uint16_t length, uint8_t* p_data)
 {
-    wiced_transport_send_hci_trace( NULL, type, length, p_data);
+    hci_trace_ring_put(&le_coc_trace_ring, type, length, p_data);
 }
 
 /*
@@ -478,104 +1084,180 @@ void le_coc_scan_result_cback(wiced_bt_ble_scan_results_t *p_scan_result, uint8_
     }
 }
 
-void le_coc_handle_le_coc_group(uint16_t cmd_opcode, uint8_t* p_data, uint32_t data_len)
+/*
+ * Acknowledge a command that reports success to the host. Failures are
+ * reported by le_coc_proc_rx_cmd().
+ */
+static uint8_t le_coc_cmd_ack(uint8_t status)
 {
-    uint16_t i = 0;
-    uint8_t peer_addr[BD_ADDR_LEN], *peer_addr_ptr;
-    wiced_bt_ble_phy_preferences_t phy_preferences;
-    wiced_bt_dev_status_t return_val;
+    if (status == HCI_CONTROL_STATUS_SUCCESS)
+        le_coc_send_to_client_control(HCI_CONTROL_EVENT_COMMAND_STATUS, &status, 1);
 
-    switch (cmd_opcode)
-    {
-        case HCI_CONTROL_LE_COC_COMMAND_CONNECT:
+    return status;
+}
 
-            for (i = 0; i < BD_ADDR_LEN; i++)
-                peer_addr[i] = p_data[BD_ADDR_LEN - 1 - i];
+static uint8_t le_coc_cmd_connect(uint16_t opcode, uint8_t* p_data, uint32_t data_len)
+{
+    uint16_t i;
+    uint8_t peer_addr[BD_ADDR_LEN];
 
-            le_coc_connect(peer_addr, BLE_ADDR_PUBLIC);
-            break;
+    for (i = 0; i < BD_ADDR_LEN; i++)
+        peer_addr[i] = p_data[BD_ADDR_LEN - 1 - i];
 
-        case HCI_CONTROL_LE_COC_COMMAND_DISCONNECT:
-            le_coc_disconnect();
-            break;
+    le_coc_connect(peer_addr, BLE_ADDR_PUBLIC);
+    return HCI_CONTROL_STATUS_SUCCESS;
+}
 
-        case HCI_CONTROL_LE_COC_COMMAND_SEND_DATA:
-            le_coc_send_data(p_data, data_len);
-            break;
+static uint8_t le_coc_cmd_disconnect(uint16_t opcode, uint8_t* p_data, uint32_t data_len)
+{
+    le_coc_disconnect(le_coc_cb.default_cid);
+    return HCI_CONTROL_STATUS_SUCCESS;
+}
 
-        case HCI_CONTROL_LE_COC_COMMAND_SET_MTU:
-            if (2 == data_len)
-            {
-                mtu = *((uint16_t*) p_data);
-            }
+static uint8_t le_coc_cmd_send_data(uint16_t opcode, uint8_t* p_data, uint32_t data_len)
+{
+    le_coc_send_data(le_coc_cb.default_cid, p_data, data_len);
+    return HCI_CONTROL_STATUS_SUCCESS;
+}
 
-            /* now that we have MTU and PSM .. initialize LE COC */
-            le_coc_init();
-            break;
+static uint8_t le_coc_cmd_set_mtu(uint16_t opcode, uint8_t* p_data, uint32_t data_len)
+{
+    if (data_len >= 2)
+    {
+        mtu = *((uint16_t*) p_data);
+    }
 
-        case HCI_CONTROL_LE_COC_COMMAND_SET_PSM:
-            if (2 == data_len)
-            {
-                psm = *((uint16_t*) p_data);
-            }
-            break;
+    /* now that we have MTU and PSM .. initialize LE COC */
+    le_coc_init();
+    return HCI_CONTROL_STATUS_SUCCESS;
+}
+
+static uint8_t le_coc_cmd_set_psm(uint16_t opcode, uint8_t* p_data, uint32_t data_len)
+{
+    psm = *((uint16_t*) p_data);
+    return HCI_CONTROL_STATUS_SUCCESS;
+}
 
-        case HCI_CONTROL_LE_COC_COMMAND_ENABLE_LE2M:
+static uint8_t le_coc_cmd_enable_le2m(uint16_t opcode, uint8_t* p_data, uint32_t data_len)
+{
+    uint8_t *peer_addr_ptr;
+    le_coc_chan_t *p_chan;
+    wiced_bt_ble_phy_preferences_t phy_preferences;
+    wiced_bt_dev_status_t return_val;
 
-            phy_preferences.rx_phys = phy_preferences.tx_phys = ((1 == *p_data) ? BTM_BLE_PREFER_2M_PHY : BTM_BLE_PREFER_1M_PHY);
+    phy_preferences.rx_phys = phy_preferences.tx_phys = ((1 == *p_data) ? BTM_BLE_PREFER_2M_PHY : BTM_BLE_PREFER_1M_PHY);
 #if defined(CYW20721B2) || defined(CYW20719B2)
-            phy_preferences.phy_opts = BTM_BLE_PREFER_NO_LELR;
+    phy_preferences.phy_opts = BTM_BLE_PREFER_NO_LELR;
 #else
-            phy_preferences.phy_opts = BTM_BLE_PREFER_CODED_PHY_NONE;
+    phy_preferences.phy_opts = BTM_BLE_PREFER_CODED_PHY_NONE;
 #endif
-            peer_addr_ptr = le_coc_cb.peer_bda;
-            STREAM_TO_BDADDR(phy_preferences.remote_bd_addr, peer_addr_ptr);
+    if ((p_chan = le_coc_find_chan(le_coc_cb.default_cid)) == NULL)
+        return HCI_CONTROL_STATUS_NOT_CONNECTED;
 
-            return_val = wiced_bt_ble_set_phy(&phy_preferences);
+    peer_addr_ptr = p_chan->peer_bda;
+    STREAM_TO_BDADDR(phy_preferences.remote_bd_addr, peer_addr_ptr);
 
-            WICED_BT_TRACE("[%s] phy_preferences.remote_bd_addr %B \r\n", __func__, phy_preferences.remote_bd_addr);
-            WICED_BT_TRACE("[%s] return_val %d \r\n", __func__, return_val);
-            break;
+    return_val = wiced_bt_ble_set_phy(&phy_preferences);
 
-        default:
-            break;
-    }
+    WICED_BT_TRACE("[%s] phy_preferences.remote_bd_addr %B \r\n", __func__, phy_preferences.remote_bd_addr);
+    WICED_BT_TRACE("[%s] return_val %d \r\n", __func__, return_val);
+    return HCI_CONTROL_STATUS_SUCCESS;
+}
+
+static uint8_t le_coc_cmd_set_rx_pool(uint16_t opcode, uint8_t* p_data, uint32_t data_len)
+{
+    return le_coc_cmd_ack(le_coc_set_rx_pool(p_data, data_len));
+}
+
+static uint8_t le_coc_cmd_chan_send_data(uint16_t opcode, uint8_t* p_data, uint32_t data_len)
+{
+    uint16_t cid;
+
+    STREAM_TO_UINT16(cid, p_data);
+    le_coc_send_data(cid, p_data, data_len - 2);
+    return HCI_CONTROL_STATUS_SUCCESS;
+}
+
+static uint8_t le_coc_cmd_chan_disconnect(uint16_t opcode, uint8_t* p_data, uint32_t data_len)
+{
+    uint16_t cid;
+
+    STREAM_TO_UINT16(cid, p_data);
+    le_coc_disconnect(cid);
+    return HCI_CONTROL_STATUS_SUCCESS;
+}
+
+static uint8_t le_coc_cmd_enable_cid_events(uint16_t opcode, uint8_t* p_data, uint32_t data_len)
+{
+    le_coc_cb.cid_events = (*p_data != 0);
+    return HCI_CONTROL_STATUS_SUCCESS;
 }
 
-void le_coc_handle_le_group(uint16_t cmd_opcode, uint8_t* p_data, uint32_t data_len)
+static uint8_t le_coc_cmd_get_chan_stats(uint16_t opcode, uint8_t* p_data, uint32_t data_len)
+{
+    uint16_t cid;
+
+    STREAM_TO_UINT16(cid, p_data);
+    return le_coc_send_chan_stats(cid);
+}
+
+static uint8_t le_coc_cmd_bench_start(uint16_t opcode, uint8_t* p_data, uint32_t data_len)
+{
+    return le_coc_cmd_ack(le_coc_bench_start(p_data, data_len));
+}
+
+static uint8_t le_coc_cmd_bench_stop(uint16_t opcode, uint8_t* p_data, uint32_t data_len)
+{
+    le_coc_bench_stop();
+    return HCI_CONTROL_STATUS_SUCCESS;
+}
+
+static uint8_t le_coc_cmd_set_link_profile(uint16_t opcode, uint8_t* p_data, uint32_t data_len)
+{
+    return le_coc_cmd_ack(le_coc_set_link_profile(p_data, data_len));
+}
+
+static uint8_t le_coc_cmd_bulk_send(uint16_t opcode, uint8_t* p_data, uint32_t data_len)
+{
+    return le_coc_cmd_ack(le_coc_bulk_send(p_data, data_len));
+}
+
+static uint8_t le_coc_cmd_bulk_abort(uint16_t opcode, uint8_t* p_data, uint32_t data_len)
+{
+    le_coc_bulk_abort();
+    return HCI_CONTROL_STATUS_SUCCESS;
+}
+
+static uint8_t le_coc_cmd_le_scan(uint16_t opcode, uint8_t* p_data, uint32_t data_len)
 {
     wiced_result_t status;
-    wiced_bool_t enable = TRUE;
+    wiced_bool_t enable;
     wiced_bt_ble_scan_type_t scan_type;
     uint8_t hci_status;
 
-    switch (cmd_opcode)
-    {
-        case HCI_CONTROL_LE_COMMAND_SCAN:
-            enable = (wiced_bool_t) p_data[0];
+    enable = (wiced_bool_t) p_data[0];
 
-            WICED_BT_TRACE("[%s] enable %d \r\n", __func__, enable);
+    WICED_BT_TRACE("[%s] enable %d \r\n", __func__, enable);
 
-            scan_type = (1 == enable) ? BTM_BLE_SCAN_TYPE_HIGH_DUTY : BTM_BLE_SCAN_TYPE_NONE;
-            status = wiced_bt_ble_scan(scan_type, 0, le_coc_scan_result_cback);
+    scan_type = (1 == enable) ? BTM_BLE_SCAN_TYPE_HIGH_DUTY : BTM_BLE_SCAN_TYPE_NONE;
+    status = wiced_bt_ble_scan(scan_type, 0, le_coc_scan_result_cback);
 
-            WICED_BT_TRACE("[%s] status %d \r\n", __func__, status);
-            hci_status = ((status == WICED_BT_SUCCESS) || (status == WICED_BT_PENDING)) ? HCI_CONTROL_STATUS_SUCCESS : HCI_CONTROL_STATUS_FAILED;
+    WICED_BT_TRACE("[%s] status %d \r\n", __func__, status);
+    hci_status = ((status == WICED_BT_SUCCESS) || (status == WICED_BT_PENDING)) ? HCI_CONTROL_STATUS_SUCCESS : HCI_CONTROL_STATUS_FAILED;
 
-            le_coc_send_to_client_control( HCI_CONTROL_LE_EVENT_COMMAND_STATUS, &hci_status, 1);
-            break;
+    le_coc_send_to_client_control( HCI_CONTROL_LE_EVENT_COMMAND_STATUS, &hci_status, 1);
+    return HCI_CONTROL_STATUS_SUCCESS;
+}
 
-        case HCI_CONTROL_LE_COMMAND_ADVERTISE:
-            enable = (wiced_bool_t) p_data[0];
-            wiced_bt_start_advertisements(((1 == enable) ? BTM_BLE_ADVERT_UNDIRECTED_HIGH : BTM_BLE_ADVERT_OFF), 0, NULL);
-            break;
+static uint8_t le_coc_cmd_le_advertise(uint16_t opcode, uint8_t* p_data, uint32_t data_len)
+{
+    wiced_bool_t enable = (wiced_bool_t) p_data[0];
 
-        default:
-            break;
-    }
+    wiced_bt_start_advertisements(((1 == enable) ? BTM_BLE_ADVERT_UNDIRECTED_HIGH : BTM_BLE_ADVERT_OFF), 0, NULL);
+    return HCI_CONTROL_STATUS_SUCCESS;
 }
 
-void le_coc_handle_get_version(void)
+static uint8_t le_coc_cmd_get_version(uint16_t opcode, uint8_t* p_data, uint32_t data_len)
 {
     uint8_t   tx_buf[20];
     uint8_t   cmd = 0;
@@ -608,9 +1290,40 @@ void le_coc_handle_get_version(void)
     tx_buf[cmd++] = HCI_CONTROL_GROUP_LE_COC;
 
     wiced_transport_send_data(HCI_CONTROL_MISC_EVENT_VERSION, tx_buf, cmd);
-
+    return HCI_CONTROL_STATUS_SUCCESS;
 }
 
+/*
+ * Commands handled by the application, sorted by opcode: LE group, LE COC
+ * group, then the MISC group.
+ */
+static const hci_control_cmd_entry_t le_coc_cmd_table[] =
+{
+    HCI_CONTROL_CMD_ENTRY(HCI_CONTROL_LE_COMMAND_SCAN,                      1,                  le_coc_cmd_le_scan),
+    HCI_CONTROL_CMD_ENTRY(HCI_CONTROL_LE_COMMAND_ADVERTISE,                 1,                  le_coc_cmd_le_advertise),
+    HCI_CONTROL_CMD_ENTRY(HCI_CONTROL_LE_COC_COMMAND_CONNECT,               BD_ADDR_LEN,        le_coc_cmd_connect),
+    HCI_CONTROL_CMD_ENTRY(HCI_CONTROL_LE_COC_COMMAND_DISCONNECT,            0,                  le_coc_cmd_disconnect),
+    HCI_CONTROL_CMD_ENTRY(HCI_CONTROL_LE_COC_COMMAND_SEND_DATA,             0,                  le_coc_cmd_send_data),
+    HCI_CONTROL_CMD_ENTRY(HCI_CONTROL_LE_COC_COMMAND_SET_MTU,               0,                  le_coc_cmd_set_mtu),
+    HCI_CONTROL_CMD_ENTRY(HCI_CONTROL_LE_COC_COMMAND_SET_PSM,               2,                  le_coc_cmd_set_psm),
+    HCI_CONTROL_CMD_ENTRY(HCI_CONTROL_LE_COC_COMMAND_ENABLE_LE2M,           1,                  le_coc_cmd_enable_le2m),
+    HCI_CONTROL_CMD_ENTRY(HCI_CONTROL_LE_COC_COMMAND_SET_RX_POOL,           0,                  le_coc_cmd_set_rx_pool),
+    HCI_CONTROL_CMD_ENTRY(HCI_CONTROL_LE_COC_COMMAND_CHAN_SEND_DATA,        3,                  le_coc_cmd_chan_send_data),
+    HCI_CONTROL_CMD_ENTRY(HCI_CONTROL_LE_COC_COMMAND_CHAN_DISCONNECT,       2,                  le_coc_cmd_chan_disconnect),
+    HCI_CONTROL_CMD_ENTRY(HCI_CONTROL_LE_COC_COMMAND_ENABLE_CID_EVENTS,     1,                  le_coc_cmd_enable_cid_events),
+    HCI_CONTROL_CMD_ENTRY(HCI_CONTROL_LE_COC_COMMAND_GET_CHAN_STATS,        2,                  le_coc_cmd_get_chan_stats),
+    HCI_CONTROL_CMD_ENTRY(HCI_CONTROL_LE_COC_COMMAND_BENCH_START,           0,                  le_coc_cmd_bench_start),
+    HCI_CONTROL_CMD_ENTRY(HCI_CONTROL_LE_COC_COMMAND_BENCH_STOP,            0,                  le_coc_cmd_bench_stop),
+    HCI_CONTROL_CMD_ENTRY(HCI_CONTROL_LE_COC_COMMAND_SET_LINK_PROFILE,      0,                  le_coc_cmd_set_link_profile),
+    HCI_CONTROL_CMD_ENTRY(HCI_CONTROL_LE_COC_COMMAND_BULK_SEND,             0,                  le_coc_cmd_bulk_send),
+    HCI_CONTROL_CMD_ENTRY(HCI_CONTROL_LE_COC_COMMAND_BULK_ABORT,            0,                  le_coc_cmd_bulk_abort),
+    HCI_CONTROL_CMD_ENTRY(HCI_CONTROL_MISC_COMMAND_GET_VERSION,             0,                  le_coc_cmd_get_version),
+    HCI_CONTROL_CMD_ENTRY(HCI_CONTROL_MISC_COMMAND_READ_BUF_POOLS,          0,                  buf_pool_stats_cmd_read),
+#ifdef LATENCY_PROBES
+    HCI_CONTROL_CMD_ENTRY(HCI_CONTROL_MISC_COMMAND_READ_PROBES,             0,                  latency_probe_cmd_read),
+#endif
+};
+
 /*
  * Handle received command over UART.
  *
@@ -620,6 +1333,7 @@ uint32_t le_coc_proc_rx_cmd(uint8_t *p_data, uint32_t length)
     uint16_t opcode;
     uint16_t payload_len;
     uint8_t *p_data_copy = p_data;
+    uint8_t status;
 
     //Expected minimum 4 byte as the wiced header
     if ((length < 4) || (!p_data))
@@ -630,29 +1344,20 @@ uint32_t le_coc_proc_rx_cmd(uint8_t *p_data, uint32_t length)
 
     STREAM_TO_UINT16(opcode, p_data);  // Get OpCode
     STREAM_TO_UINT16(payload_len, p_data);  // Get Payload Length
+    LATENCY_PROBE(LATENCY_PROBE_HCI_CMD_RX, opcode);
 
-    WICED_BT_TRACE("[%s] Received %s event \r\n", __func__, getOpcodeStr(opcode));
-
-    if(opcode == HCI_CONTROL_MISC_COMMAND_GET_VERSION)
-    {
-        WICED_BT_TRACE("HCI_CONTROL_MISC_COMMAND_GET_VERSION\n");
-        le_coc_handle_get_version();
-    }
+    WICED_BT_TRACE("[%s] Received %s event \r\n", __func__,
+            hci_control_cmd_name(le_coc_cmd_table, HCI_CONTROL_CMD_TABLE_SIZE(le_coc_cmd_table), opcode));
 
-    switch ((opcode >> 8) & 0xff)
-    {
-        case HCI_CONTROL_GROUP_LE_COC:
-            le_coc_handle_le_coc_group(opcode, p_data, payload_len);
-            break;
-
-        case HCI_CONTROL_GROUP_LE:
-            le_coc_handle_le_group(opcode, p_data, payload_len);
-            break;
+    /* never trust the header length beyond what was actually received */
+    if (payload_len > length - 4)
+        status = HCI_CONTROL_STATUS_INVALID_ARGS;
+    else
+        status = hci_control_dispatch(le_coc_cmd_table, HCI_CONTROL_CMD_TABLE_SIZE(le_coc_cmd_table), opcode, p_data, payload_len);
+    LATENCY_PROBE(LATENCY_PROBE_HCI_CMD_DONE, opcode);
 
-        default:
-            WICED_BT_TRACE("[%s] Opcode (0x%x) not processed \r\n", __func__, opcode);
-            break;
-    }
+    if (status != HCI_CONTROL_STATUS_SUCCESS)
+        le_coc_send_to_client_control(HCI_CONTROL_EVENT_COMMAND_STATUS, &status, 1);
 
     wiced_transport_free_buffer(p_data_copy);
 
@@ -661,76 +1366,54 @@ uint32_t le_coc_proc_rx_cmd(uint8_t *p_data, uint32_t length)
 
 void le_coc_transport_status(wiced_transport_type_t type)
 {
+#ifdef WICED_BT_TRACE_ENABLE
+    hci_control_check_cmd_table(le_coc_cmd_table, HCI_CONTROL_CMD_TABLE_SIZE(le_coc_cmd_table));
+#endif
+
     le_coc_send_to_client_control( HCI_CONTROL_EVENT_DEVICE_STARTED, NULL, 0);
 }
 
-void le_coc_send_to_client_control(uint16_t code, uint8_t* p_data, uint16_t length)
+/*
+ * Send an event to the client control. Short events go through the transport's
+ * own buffer. Longer ones are copied once into a buffer from rxBuffPoolPtr that
+ * is handed to the transport as is; the transport adds the frame header in the
+ * space it reserves ahead of the payload and frees the buffer after sending.
+ * The stack owns p_data and frees it when the callback returns, so this single
+ * copy is the minimum. Returns WICED_NO_MEMORY if the pool is exhausted.
+ */
+wiced_result_t le_coc_send_to_client_control(uint16_t code, uint8_t* p_data, uint16_t length)
 {
     uint8_t *dataPtr = NULL;
+    wiced_result_t result;
 
     WICED_BT_TRACE("[%s] Sending 0x%x length %d \r\n", __func__, code, length);
 
-    if (length < (268 - 16))
+    if (length < LE_COC_TRANSPORT_MAX_INLINE_DATA)
     {
-        wiced_transport_send_data(code, p_data, length);
+        return wiced_transport_send_data(code, p_data, length);
     }
-    else
+
+    if (length > le_coc_rx_pool_allocated.buffer_size)
     {
-        dataPtr = wiced_transport_allocate_buffer(rxBuffPoolPtr);
-        if (dataPtr)
-        {
-            memcpy(dataPtr, p_data, length);
-            if(wiced_transport_send_buffer(code, dataPtr, length) !=  WICED_SUCCESS)
-                WICED_BT_TRACE("[%s] wiced_transport_send_buffer failed 0x%x length %d \r\n", __func__, code, length);
-        }
+        WICED_BT_TRACE("[%s] 0x%x length %d larger than the transport buffers\r\n", __func__, code, length);
+        return WICED_BADARG;
+    }
+    if ((rxBuffPoolPtr == NULL) || ((dataPtr = wiced_transport_allocate_buffer(rxBuffPoolPtr)) == NULL))
+    {
+        WICED_BT_TRACE("[%s] no transport buffer for 0x%x length %d \r\n", __func__, code, length);
+        return WICED_NO_MEMORY;
     }
+
+    memcpy(dataPtr, p_data, length);
+
+    if ((result = wiced_transport_send_buffer(code, dataPtr, length)) != WICED_SUCCESS)
+        WICED_BT_TRACE("[%s] wiced_transport_send_buffer failed 0x%x length %d \r\n", __func__, code, length);
+
+    return result;
 }
 
 #define STR(x) #x
 
-const char* lecocCmdStr[] =
-{
-    STR(HCI_CONTROL_LE_COC_COMMAND_CONNECT),
-    STR(HCI_CONTROL_LE_COC_COMMAND_DISCONNECT),
-    STR(HCI_CONTROL_LE_COC_COMMAND_SEND_DATA),
-    STR(HCI_CONTROL_LE_COC_COMMAND_SET_MTU),
-    STR(HCI_CONTROL_LE_COC_COMMAND_SET_PSM),
-    STR(HCI_CONTROL_LE_COC_COMMAND_ENABLE_LE2M), };
-
-const char* leCmdStr[] =
-{
-    STR(HCI_CONTROL_LE_COMMAND_SCAN),
-    STR(HCI_CONTROL_LE_COMMAND_ADVERTISE),
-    STR(HCI_CONTROL_LE_COMMAND_CONNECT),
-    STR(HCI_CONTROL_LE_COMMAND_CANCEL_CONNECT),
-    STR(HCI_CONTROL_LE_COMMAND_DISCONNECT),
-    STR(HCI_CONTROL_LE_RE_PAIR),
-    STR(HCI_CONTROL_LE_COMMAND_GET_IDENTITY_ADDRESS),
-    STR(HCI_CONTROL_LE_COMMAND_SET_CHANNEL_CLASSIFICATION),
-    STR(HCI_CONTROL_LE_COMMAND_SET_CONN_PARAMS),
-    STR(HCI_CONTROL_LE_COMMAND_SET_RAW_ADVERTISE_DATA), };
-
-const char* deviceCmdStr[] =
-{
-    STR(HCI_CONTROL_COMMAND_RESET),
-    STR(HCI_CONTROL_COMMAND_TRACE_ENABLE),
-    STR(HCI_CONTROL_COMMAND_SET_LOCAL_BDA),
-    STR(HCI_CONTROL_COMMAND_SET_BAUD_RATE),
-    STR(HCI_CONTROL_COMMAND_PUSH_NVRAM_DATA),
-    STR(HCI_CONTROL_COMMAND_DELETE_NVRAM_DATA),
-    STR(HCI_CONTROL_COMMAND_INQUIRY),
-    STR(HCI_CONTROL_COMMAND_SET_VISIBILITY),
-    STR(HCI_CONTROL_COMMAND_SET_PAIRING_MODE),
-    STR(HCI_CONTROL_COMMAND_UNBOND),
-    STR(HCI_CONTROL_COMMAND_USER_CONFIRMATION),
-    STR(HCI_CONTROL_COMMAND_ENABLE_COEX),
-    STR(HCI_CONTROL_COMMAND_DISABLE_COEX),
-    STR(HCI_CONTROL_COMMAND_SET_BATTERY_LEVEL),
-    STR(HCI_CONTROL_COMMAND_READ_LOCAL_BDA),
-    STR(HCI_CONTROL_COMMAND_BOND),
-    STR(HCI_CONTROL_COMMAND_READ_BUFF_STATS),
-    STR(HCI_CONTROL_COMMAND_SET_LOCAL_NAME), };
-
 const char* eventStr[] =
 {
     STR(BTM_ENABLED_EVT),
@@ -776,28 +1459,3 @@ const char* getStackEventStr(wiced_bt_management_evt_t event)
     return eventStr[event];
 }
 
-const char* getOpcodeStr(uint16_t opcode)
-{
-    const char *str = NULL;
-
-    switch ((opcode >> 8) & 0xff)
-    {
-        case HCI_CONTROL_GROUP_LE_COC:
-            str = lecocCmdStr[((opcode) & 0xff) - 1];
-            break;
-
-        case HCI_CONTROL_GROUP_LE:
-            str = leCmdStr[((opcode) & 0xff) - 1];
-            break;
-
-        case HCI_CONTROL_GROUP_DEVICE:
-            str = deviceCmdStr[((opcode) & 0xff) - 1];
-            break;
-
-        default:
-            str = "** UNKNOWN **";
-            break;
-    }
-
-    return str;
-}
@@ -59,16 +59,156 @@ enum
     LE_COC_STATE_WAIT_FOR_BUFS
 };
 
+/* Number of LE COC channels that can be open at the same time */
+#define LE_COC_MAX_CHANNELS                 4
+
+#define LE_COC_INVALID_CID                  0xFFFF
+
+/* Depth of the TX queue holding SDUs while the channel is congested */
+#define LE_COC_TX_QUEUE_SIZE                8
+
+/* Upper bound for one segment when the peer MTU is not known or larger */
+#define LE_COC_TX_MAX_SDU_SIZE              512
+
+/* Queue fill levels at which flow off / flow on is reported to the host */
+#define LE_COC_TX_QUEUE_HIGH_WATER          ( LE_COC_TX_QUEUE_SIZE - 2 )
+#define LE_COC_TX_QUEUE_LOW_WATER           2
+
+/* Largest event payload sent through the transport's internal buffer (268 byte buffer less header) */
+#define LE_COC_TRANSPORT_MAX_INLINE_DATA    ( 268 - 16 )
+
+/* TX flow states reported in HCI_CONTROL_LE_COC_EVENT_TX_FLOW */
+#define LE_COC_TX_FLOW_ON                   0
+#define LE_COC_TX_FLOW_OFF                  1
+#define LE_COC_TX_FLOW_DROPPED              2
+
+/* Room left in each RX transport buffer beyond the local MTU */
+#define LE_COC_RX_POOL_HEADROOM             64
+
+/* CID ahead of the payload of the CID tagged events */
+#define LE_COC_CID_TAG_LEN                  2
+
+/*
+ * Application specific LE COC commands and events, numbered above the ones defined in
+ * hci_control_api.h so that they do not collide with the SDK definitions
+ */
+#ifndef HCI_CONTROL_LE_COC_COMMAND_SET_RX_POOL
+#define HCI_CONTROL_LE_COC_COMMAND_SET_RX_POOL  ( ( HCI_CONTROL_GROUP_LE_COC << 8 ) | 0x10 ) /* RX transport pool, payload: buffer size (uint16), buffer count */
+#endif
+#ifndef HCI_CONTROL_LE_COC_COMMAND_CHAN_SEND_DATA
+#define HCI_CONTROL_LE_COC_COMMAND_CHAN_SEND_DATA       ( ( HCI_CONTROL_GROUP_LE_COC << 8 ) | 0x11 ) /* payload: CID, data */
+#define HCI_CONTROL_LE_COC_COMMAND_CHAN_DISCONNECT      ( ( HCI_CONTROL_GROUP_LE_COC << 8 ) | 0x12 ) /* payload: CID */
+#define HCI_CONTROL_LE_COC_COMMAND_ENABLE_CID_EVENTS    ( ( HCI_CONTROL_GROUP_LE_COC << 8 ) | 0x13 ) /* payload: 1 to send CID tagged events */
+#define HCI_CONTROL_LE_COC_COMMAND_GET_CHAN_STATS       ( ( HCI_CONTROL_GROUP_LE_COC << 8 ) | 0x14 ) /* payload: CID */
+#endif
+#ifndef HCI_CONTROL_LE_COC_COMMAND_BENCH_START
+#define HCI_CONTROL_LE_COC_COMMAND_BENCH_START          ( ( HCI_CONTROL_GROUP_LE_COC << 8 ) | 0x15 ) /* payload: CID, mode, SDU length (uint16), report interval (s) */
+#define HCI_CONTROL_LE_COC_COMMAND_BENCH_STOP           ( ( HCI_CONTROL_GROUP_LE_COC << 8 ) | 0x16 ) /* no payload */
+#endif
+#ifndef HCI_CONTROL_LE_COC_COMMAND_SET_LINK_PROFILE
+#define HCI_CONTROL_LE_COC_COMMAND_SET_LINK_PROFILE     ( ( HCI_CONTROL_GROUP_LE_COC << 8 ) | 0x17 ) /* payload: LE_COC_LINK_PROFILE_xx */
+#endif
+#ifndef HCI_CONTROL_LE_COC_COMMAND_BULK_SEND
+#define HCI_CONTROL_LE_COC_COMMAND_BULK_SEND            ( ( HCI_CONTROL_GROUP_LE_COC << 8 ) | 0x18 ) /* payload: CID, transfer id (uint32), length (uint32), chunk length (uint16), window */
+#define HCI_CONTROL_LE_COC_COMMAND_BULK_ABORT           ( ( HCI_CONTROL_GROUP_LE_COC << 8 ) | 0x19 ) /* no payload */
+#endif
+#ifndef HCI_CONTROL_LE_COC_EVENT_TX_FLOW
+#define HCI_CONTROL_LE_COC_EVENT_TX_FLOW    ( ( HCI_CONTROL_GROUP_LE_COC << 8 ) | 0x10 )    /* TX queue flow on/off, payload: CID, state, queued count */
+#endif
+#ifndef HCI_CONTROL_LE_COC_EVENT_RX_DROPPED
+#define HCI_CONTROL_LE_COC_EVENT_RX_DROPPED ( ( HCI_CONTROL_GROUP_LE_COC << 8 ) | 0x11 )    /* RX data dropped, payload: CID, total drop count (uint32) */
+#endif
+#ifndef HCI_CONTROL_LE_COC_EVENT_CHAN_CONNECTED
+/* CID tagged variants of the connection and data events, sent once enabled with ENABLE_CID_EVENTS */
+#define HCI_CONTROL_LE_COC_EVENT_CHAN_CONNECTED     ( ( HCI_CONTROL_GROUP_LE_COC << 8 ) | 0x12 )    /* payload: CID, peer BDA, peer MTU */
+#define HCI_CONTROL_LE_COC_EVENT_CHAN_DISCONNECTED  ( ( HCI_CONTROL_GROUP_LE_COC << 8 ) | 0x13 )    /* payload: CID, peer BDA */
+#define HCI_CONTROL_LE_COC_EVENT_CHAN_RX_DATA       ( ( HCI_CONTROL_GROUP_LE_COC << 8 ) | 0x14 )    /* payload: CID, data */
+#define HCI_CONTROL_LE_COC_EVENT_CHAN_TX_COMPLETE   ( ( HCI_CONTROL_GROUP_LE_COC << 8 ) | 0x15 )    /* payload: CID, status */
+#define HCI_CONTROL_LE_COC_EVENT_CHAN_STATS         ( ( HCI_CONTROL_GROUP_LE_COC << 8 ) | 0x16 )    /* payload: CID, TX SDUs/bytes/drops, RX SDUs/bytes/drops (uint32 each) */
+#endif
+#ifndef HCI_CONTROL_LE_COC_EVENT_BENCH_REPORT
+/* payload: CID, mode, then uint32 each: elapsed ms, TX bytes/s, TX SDUs/s, RX bytes/s, RX SDUs/s, lost SDUs, RTT min/avg/max us, RTT samples */
+#define HCI_CONTROL_LE_COC_EVENT_BENCH_REPORT       ( ( HCI_CONTROL_GROUP_LE_COC << 8 ) | 0x17 )
+#endif
+#ifndef HCI_CONTROL_LE_COC_EVENT_BULK_DATA
+#define HCI_CONTROL_LE_COC_EVENT_BULK_DATA          ( ( HCI_CONTROL_GROUP_LE_COC << 8 ) | 0x18 )    /* payload: CID, offset (uint32), data */
+#define HCI_CONTROL_LE_COC_EVENT_BULK_STATUS        ( ( HCI_CONTROL_GROUP_LE_COC << 8 ) | 0x19 )    /* payload: CID, direction, BULK_XFER_STATUS_xx, transfer id (uint32), offset (uint32) */
+#endif
+
+/* Directions of HCI_CONTROL_LE_COC_EVENT_BULK_STATUS */
+#define LE_COC_BULK_SENT                    0
+#define LE_COC_BULK_RECEIVED                1
+
+/* Benchmark modes for HCI_CONTROL_LE_COC_COMMAND_BENCH_START */
+#define LE_COC_BENCH_MODE_OFF               0
+#define LE_COC_BENCH_MODE_TX                1   /* generate SDUs, measure RTT from echoes */
+#define LE_COC_BENCH_MODE_RX                2   /* sink SDUs and count gaps */
+#define LE_COC_BENCH_MODE_ECHO              3   /* sink SDUs and echo their header back */
+
 /******************************************************
  *                    Structures
  ******************************************************/
-/* Application control block */
+/* Bounded ring of SDUs waiting for the channel to become uncongested */
+typedef struct
+{
+    uint8_t  *p_sdu[LE_COC_TX_QUEUE_SIZE];
+    uint16_t sdu_len[LE_COC_TX_QUEUE_SIZE];
+    uint8_t  head;
+    uint8_t  count;
+    uint8_t  flow_off;
+} le_coc_tx_queue_t;
+
+/* Link profiles for HCI_CONTROL_LE_COC_COMMAND_SET_LINK_PROFILE */
+enum
+{
+    LE_COC_LINK_PROFILE_DEFAULT,        /* leave the link as negotiated */
+    LE_COC_LINK_PROFILE_BULK,           /* short interval, max data length, 2M PHY */
+    LE_COC_LINK_PROFILE_LOW_POWER,      /* long interval with slave latency, 1M PHY */
+    LE_COC_LINK_PROFILE_MAX
+};
+
+/* Connection parameters, data length and PHY requested for a link profile */
+typedef struct
+{
+    uint16_t conn_min_interval;         /* 1.25 ms units, 0 to leave the connection parameters unchanged */
+    uint16_t conn_max_interval;
+    uint16_t conn_latency;
+    uint16_t supervision_timeout;       /* 10 ms units */
+    uint16_t tx_pdu_length;             /* LE data length, 0 to leave unchanged */
+    uint8_t  phys;                      /* BTM_BLE_PREFER_xx_PHY mask, 0 to leave unchanged */
+} le_coc_link_profile_t;
+
+/* RX transport buffer pool configuration */
 typedef struct
 {
-    uint16_t local_cid;
+    uint16_t buffer_size;       /* 0 to size buffers from the local MTU */
+    uint8_t  buffer_count;
+} le_coc_rx_pool_cfg_t;
+
+/* Per channel context, keyed by the local CID */
+typedef struct
+{
+    uint16_t local_cid;         /* LE_COC_INVALID_CID if the context is free */
     wiced_bt_device_address_t peer_bda;
     uint8_t congested;
     uint16_t peer_mtu;
+    le_coc_tx_queue_t tx_queue;
+    uint32_t tx_sdus;
+    uint32_t tx_bytes;
+    uint32_t tx_dropped;        /* host payloads that could not be sent or queued */
+    uint32_t rx_sdus;
+    uint32_t rx_bytes;
+    uint32_t rx_dropped;        /* SDUs that could not be forwarded to the client control */
+    uint8_t  rx_dropping;       /* set while consecutive SDUs are being dropped */
+} le_coc_chan_t;
+
+/* Application control block */
+typedef struct
+{
+    le_coc_chan_t chan[LE_COC_MAX_CHANNELS];
+    uint16_t default_cid;       /* channel used by the commands and events that carry no CID */
+    uint8_t  cid_events;        /* send the CID tagged events instead of the legacy ones */
+    uint8_t  link_profile;      /* LE_COC_LINK_PROFILE_xx applied to every channel's link */
 } le_coc_cb_t;
 
 /*****************************************************************************
@@ -77,12 +217,38 @@ typedef struct
 /* Stack and buffer pool configuration tables */
 extern const wiced_bt_cfg_settings_t wiced_bt_cfg_settings;
 extern const wiced_bt_cfg_buf_pool_t wiced_bt_cfg_buf_pools[];
+extern const le_coc_rx_pool_cfg_t le_coc_rx_pool_cfg;
+extern const le_coc_link_profile_t le_coc_link_profiles[LE_COC_LINK_PROFILE_MAX];
 
 #define LE_COC_LARGE_POOL_BUFFER_COUNT            5
 #define LE_COC_VS_ID                      WICED_NVRAM_VSID_START
 #define LE_COC_LOCAL_KEYS_VS_ID          ( WICED_NVRAM_VSID_START + 1 )
-#define LE_COC_PAIRED_KEYS_VS_ID          ( WICED_NVRAM_VSID_START + 2 )
+#define LE_COC_PAIRED_KEYS_VS_ID          ( WICED_NVRAM_VSID_START + 2 )   /* BOND_STORE_NUM_VS_ID( LE_COC_MAX_BONDS ) ids */
+
+/* Peers whose keys are saved, and loaded to the address resolution database at startup */
+#ifndef LE_COC_MAX_BONDS
+#define LE_COC_MAX_BONDS                  BOND_STORE_MAX_DEVICES
+#endif
 
 /*****************************************************************************
  * Function Prototypes
  *****************************************************************************/
+le_coc_chan_t* le_coc_find_chan(uint16_t local_cid);
+uint32_t le_coc_send_data(uint16_t local_cid, uint8_t* p_data, uint32_t data_len);
+wiced_result_t le_coc_send_to_client_control(uint16_t code, uint8_t* p_data, uint16_t length);
+
+/* le_coc_bench.c */
+uint8_t le_coc_bench_start(uint8_t *p_data, uint32_t data_len);
+void le_coc_bench_stop(void);
+wiced_bool_t le_coc_bench_active(le_coc_chan_t *p_chan);
+void le_coc_bench_tx_ready(le_coc_chan_t *p_chan);
+wiced_bool_t le_coc_bench_rx(le_coc_chan_t *p_chan, uint8_t *p_data, uint16_t len);
+void le_coc_bench_chan_closed(uint16_t local_cid);
+
+/* le_coc_bulk.c */
+uint8_t le_coc_bulk_send(uint8_t *p_data, uint32_t data_len);
+void le_coc_bulk_abort(void);
+wiced_bool_t le_coc_bulk_active(le_coc_chan_t *p_chan);
+void le_coc_bulk_tx_ready(le_coc_chan_t *p_chan);
+wiced_bool_t le_coc_bulk_rx(le_coc_chan_t *p_chan, uint8_t *p_data, uint16_t len);
+void le_coc_bulk_chan_closed(uint16_t local_cid);
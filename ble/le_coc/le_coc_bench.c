@@ -0,0 +1,328 @@
+/*
+ * Copyright 2016-2020, Cypress Semiconductor Corporation or a subsidiary of
+ * Cypress Semiconductor Corporation. All Rights Reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software"), is owned by Cypress Semiconductor Corporation
+ * or one of its subsidiaries ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products. Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ */
+
+/** @file
+ *
+ * LE COC throughput and latency benchmark
+ *
+ * The generator sends sequence numbered, timestamped SDUs on a channel as fast
+ * as the channel credits permit. The sink checks the sequence numbers for gaps
+ * and, in echo mode, returns the header of every SDU so that the generator can
+ * measure the round trip time. Benchmark SDUs are consumed on the device, not
+ * forwarded to the client control, so the UART does not limit the result.
+ * Rates, latency and loss are reported periodically with
+ * HCI_CONTROL_LE_COC_EVENT_BENCH_REPORT.
+ */
+
+#include <string.h>
+#include "le_coc.h"
+
+#include "wiced_bt_l2c.h"
+#include "wiced_bt_trace.h"
+#include "wiced_timer.h"
+#include "hci_control_api.h"
+
+/******************************************************
+ *                    Constants
+ ******************************************************/
+#define LE_COC_BENCH_MAGIC          0x424C      /* "LB" */
+
+#define LE_COC_BENCH_TYPE_DATA      0
+#define LE_COC_BENCH_TYPE_ECHO      1
+
+/* magic (2), type (1), sequence number (4), timestamp in us (4) */
+#define LE_COC_BENCH_HDR_LEN        11
+
+/******************************************************
+ *                 Type Definitions
+ ******************************************************/
+typedef struct
+{
+    uint32_t sdus;
+    uint32_t bytes;
+} le_coc_bench_count_t;
+
+typedef struct
+{
+    uint8_t  mode;
+    uint16_t local_cid;
+    uint16_t sdu_len;
+    uint32_t tx_seq;
+    uint32_t rx_seq;                /* next expected sequence number */
+    uint32_t start_us;
+    uint32_t report_us;             /* time of the previous report */
+    le_coc_bench_count_t tx;        /* since the previous report */
+    le_coc_bench_count_t rx;
+    uint32_t lost;                  /* total since start */
+    uint32_t lat_min;               /* round trip time in us, since the previous report */
+    uint32_t lat_max;
+    uint32_t lat_sum;
+    uint32_t lat_count;
+    wiced_timer_t report_timer;
+    uint8_t  timer_initialized;
+} le_coc_bench_t;
+
+/******************************************************
+ *               Variable Definitions
+ ******************************************************/
+static le_coc_bench_t le_coc_bench;
+static uint8_t le_coc_bench_sdu[LE_COC_TX_MAX_SDU_SIZE];
+
+/******************************************************
+ *               Function Definitions
+ ******************************************************/
+static uint32_t le_coc_bench_now_us(void)
+{
+    return (uint32_t) clock_SystemTimeMicroseconds64();
+}
+
+static void le_coc_bench_reset_interval(void)
+{
+    memset(&le_coc_bench.tx, 0, sizeof(le_coc_bench.tx));
+    memset(&le_coc_bench.rx, 0, sizeof(le_coc_bench.rx));
+    le_coc_bench.lat_min   = 0xFFFFFFFF;
+    le_coc_bench.lat_max   = 0;
+    le_coc_bench.lat_sum   = 0;
+    le_coc_bench.lat_count = 0;
+}
+
+/* Scale a count over the elapsed interval to a per second rate */
+static uint32_t le_coc_bench_rate(uint32_t count, uint32_t elapsed_us)
+{
+    if (elapsed_us == 0)
+        return 0;
+
+    return (uint32_t) (((uint64_t) count * 1000000) / elapsed_us);
+}
+
+static void le_coc_bench_report(void)
+{
+    uint8_t evt[2 + 1 + 4 * 10], *p = evt;
+    uint32_t now = le_coc_bench_now_us();
+    uint32_t elapsed = now - le_coc_bench.report_us;
+
+    UINT16_TO_STREAM(p, le_coc_bench.local_cid);
+    UINT8_TO_STREAM(p, le_coc_bench.mode);
+    UINT32_TO_STREAM(p, (now - le_coc_bench.start_us) / 1000);
+    UINT32_TO_STREAM(p, le_coc_bench_rate(le_coc_bench.tx.bytes, elapsed));
+    UINT32_TO_STREAM(p, le_coc_bench_rate(le_coc_bench.tx.sdus, elapsed));
+    UINT32_TO_STREAM(p, le_coc_bench_rate(le_coc_bench.rx.bytes, elapsed));
+    UINT32_TO_STREAM(p, le_coc_bench_rate(le_coc_bench.rx.sdus, elapsed));
+    UINT32_TO_STREAM(p, le_coc_bench.lost);
+    UINT32_TO_STREAM(p, le_coc_bench.lat_count ? le_coc_bench.lat_min : 0);
+    UINT32_TO_STREAM(p, le_coc_bench.lat_count ? (le_coc_bench.lat_sum / le_coc_bench.lat_count) : 0);
+    UINT32_TO_STREAM(p, le_coc_bench.lat_max);
+    UINT32_TO_STREAM(p, le_coc_bench.lat_count);
+
+    le_coc_send_to_client_control(HCI_CONTROL_LE_COC_EVENT_BENCH_REPORT, evt, sizeof(evt));
+
+    le_coc_bench.report_us = now;
+    le_coc_bench_reset_interval();
+}
+
+static void le_coc_bench_report_timeout(uint32_t arg)
+{
+    if (le_coc_bench.mode != LE_COC_BENCH_MODE_OFF)
+        le_coc_bench_report();
+}
+
+/* Build the header of a benchmark SDU */
+static void le_coc_bench_build_hdr(uint8_t *p, uint8_t type, uint32_t seq, uint32_t timestamp)
+{
+    UINT16_TO_STREAM(p, LE_COC_BENCH_MAGIC);
+    UINT8_TO_STREAM(p, type);
+    UINT32_TO_STREAM(p, seq);
+    UINT32_TO_STREAM(p, timestamp);
+}
+
+/*
+ * Called whenever the channel may accept more data. Keeps the channel full as
+ * long as it has credits, without building up the application TX queue.
+ */
+void le_coc_bench_tx_ready(le_coc_chan_t *p_chan)
+{
+    int burst = 0;
+
+    if ((le_coc_bench.mode != LE_COC_BENCH_MODE_TX) || (p_chan->local_cid != le_coc_bench.local_cid))
+        return;
+
+    /* The burst is bounded so one callback never runs for long; TX complete resumes it */
+    while (!p_chan->congested && (p_chan->tx_queue.count == 0) && (burst++ < LE_COC_TX_QUEUE_SIZE))
+    {
+        le_coc_bench_build_hdr(le_coc_bench_sdu, LE_COC_BENCH_TYPE_DATA, le_coc_bench.tx_seq, le_coc_bench_now_us());
+
+        if (le_coc_send_data(p_chan->local_cid, le_coc_bench_sdu, le_coc_bench.sdu_len) == L2CAP_DATAWRITE_FAILED)
+            break;
+
+        le_coc_bench.tx_seq++;
+        le_coc_bench.tx.sdus++;
+        le_coc_bench.tx.bytes += le_coc_bench.sdu_len;
+    }
+}
+
+/*
+ * Called for every SDU received on a channel. Returns WICED_TRUE if the SDU
+ * belonged to the benchmark and was consumed.
+ */
+wiced_bool_t le_coc_bench_rx(le_coc_chan_t *p_chan, uint8_t *p_data, uint16_t len)
+{
+    uint8_t echo[LE_COC_BENCH_HDR_LEN];
+    uint16_t magic;
+    uint8_t type;
+    uint32_t seq, timestamp, rtt;
+
+    if ((le_coc_bench.mode == LE_COC_BENCH_MODE_OFF) || (p_chan->local_cid != le_coc_bench.local_cid) ||
+        (len < LE_COC_BENCH_HDR_LEN))
+        return WICED_FALSE;
+
+    STREAM_TO_UINT16(magic, p_data);
+    STREAM_TO_UINT8(type, p_data);
+    STREAM_TO_UINT32(seq, p_data);
+    STREAM_TO_UINT32(timestamp, p_data);
+
+    if (magic != LE_COC_BENCH_MAGIC)
+        return WICED_FALSE;
+
+    le_coc_bench.rx.sdus++;
+    le_coc_bench.rx.bytes += len;
+
+    if (type == LE_COC_BENCH_TYPE_ECHO)
+    {
+        rtt = le_coc_bench_now_us() - timestamp;
+
+        if (rtt < le_coc_bench.lat_min)
+            le_coc_bench.lat_min = rtt;
+        if (rtt > le_coc_bench.lat_max)
+            le_coc_bench.lat_max = rtt;
+        le_coc_bench.lat_sum += rtt;
+        le_coc_bench.lat_count++;
+        return WICED_TRUE;
+    }
+
+    /* Anything above the expected sequence number means SDUs went missing */
+    if (seq > le_coc_bench.rx_seq)
+        le_coc_bench.lost += seq - le_coc_bench.rx_seq;
+    le_coc_bench.rx_seq = seq + 1;
+
+    if (le_coc_bench.mode == LE_COC_BENCH_MODE_ECHO)
+    {
+        le_coc_bench_build_hdr(echo, LE_COC_BENCH_TYPE_ECHO, seq, timestamp);
+        le_coc_send_data(p_chan->local_cid, echo, sizeof(echo));
+    }
+
+    return WICED_TRUE;
+}
+
+/* Returns WICED_TRUE if the benchmark is running on the channel */
+wiced_bool_t le_coc_bench_active(le_coc_chan_t *p_chan)
+{
+    return (le_coc_bench.mode != LE_COC_BENCH_MODE_OFF) && (p_chan->local_cid == le_coc_bench.local_cid);
+}
+
+/* Stop the benchmark if its channel goes away */
+void le_coc_bench_chan_closed(uint16_t local_cid)
+{
+    if ((le_coc_bench.mode != LE_COC_BENCH_MODE_OFF) && (local_cid == le_coc_bench.local_cid))
+        le_coc_bench_stop();
+}
+
+void le_coc_bench_stop(void)
+{
+    if (le_coc_bench.mode == LE_COC_BENCH_MODE_OFF)
+        return;
+
+    wiced_stop_timer(&le_coc_bench.report_timer);
+
+    /* Final report for the last partial interval */
+    le_coc_bench_report();
+    le_coc_bench.mode = LE_COC_BENCH_MODE_OFF;
+}
+
+/*
+ * Handle HCI_CONTROL_LE_COC_COMMAND_BENCH_START
+ * payload: CID (2), mode (1), SDU length (2), report interval in seconds (1)
+ */
+uint8_t le_coc_bench_start(uint8_t *p_data, uint32_t data_len)
+{
+    le_coc_chan_t *p_chan;
+    uint16_t local_cid, sdu_len;
+    uint8_t mode, interval;
+
+    if (data_len != 6)
+        return HCI_CONTROL_STATUS_INVALID_ARGS;
+
+    STREAM_TO_UINT16(local_cid, p_data);
+    STREAM_TO_UINT8(mode, p_data);
+    STREAM_TO_UINT16(sdu_len, p_data);
+    STREAM_TO_UINT8(interval, p_data);
+
+    if ((mode == LE_COC_BENCH_MODE_OFF) || (mode > LE_COC_BENCH_MODE_ECHO) || (interval == 0) ||
+        (sdu_len < LE_COC_BENCH_HDR_LEN) || (sdu_len > LE_COC_TX_MAX_SDU_SIZE))
+        return HCI_CONTROL_STATUS_INVALID_ARGS;
+
+    if ((p_chan = le_coc_find_chan(local_cid)) == NULL)
+        return HCI_CONTROL_STATUS_WRONG_STATE;
+
+    /* Every SDU has to fit in one segment so the header is not split */
+    if ((p_chan->peer_mtu != 0) && (sdu_len > p_chan->peer_mtu))
+        sdu_len = p_chan->peer_mtu;
+
+    le_coc_bench_stop();
+
+    if (!le_coc_bench.timer_initialized)
+    {
+        wiced_init_timer(&le_coc_bench.report_timer, le_coc_bench_report_timeout, 0, WICED_SECONDS_PERIODIC_TIMER);
+        le_coc_bench.timer_initialized = WICED_TRUE;
+    }
+
+    le_coc_bench.mode      = mode;
+    le_coc_bench.local_cid = local_cid;
+    le_coc_bench.sdu_len   = sdu_len;
+    le_coc_bench.tx_seq    = 0;
+    le_coc_bench.rx_seq    = 0;
+    le_coc_bench.lost      = 0;
+    le_coc_bench.start_us  = le_coc_bench.report_us = le_coc_bench_now_us();
+    le_coc_bench_reset_interval();
+
+    /* Fixed fill pattern behind the header */
+    for (sdu_len = LE_COC_BENCH_HDR_LEN; sdu_len < sizeof(le_coc_bench_sdu); sdu_len++)
+        le_coc_bench_sdu[sdu_len] = (uint8_t) sdu_len;
+
+    wiced_start_timer(&le_coc_bench.report_timer, interval);
+
+    WICED_BT_TRACE("[%s] CID %d mode %d SDU %d\r\n", __func__, local_cid, mode, le_coc_bench.sdu_len);
+
+    le_coc_bench_tx_ready(p_chan);
+
+    return HCI_CONTROL_STATUS_SUCCESS;
+}
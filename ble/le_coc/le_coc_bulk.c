@@ -0,0 +1,286 @@
+/*
+ * Copyright 2016-2020, Cypress Semiconductor Corporation or a subsidiary of
+ * Cypress Semiconductor Corporation. All Rights Reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software"), is owned by Cypress Semiconductor Corporation
+ * or one of its subsidiaries ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products. Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ */
+
+/** @file
+ *
+ * LE COC bulk transfers
+ *
+ * Runs the bulk transfer protocol of bulk_xfer.c on an LE COC channel, one
+ * transfer at a time in each direction context:
+ *  - HCI_CONTROL_LE_COC_COMMAND_BULK_SEND sends a test pattern of the
+ *    requested length, each byte a function of its offset and of the
+ *    transfer id so that the receiving side can check it;
+ *  - a transfer started by the peer on any channel is received by a sink
+ *    forwarding the data to the client control in
+ *    HCI_CONTROL_LE_COC_EVENT_BULK_DATA events. When the UART cannot keep
+ *    up the sink fails, the transfer is aborted and the sink resumes it from
+ *    the last offset forwarded when the peer starts it again.
+ * The end of a transfer either way is reported in
+ * HCI_CONTROL_LE_COC_EVENT_BULK_STATUS.
+ */
+
+#include <string.h>
+#include "le_coc.h"
+
+#include "wiced_bt_l2c.h"
+#include "wiced_bt_trace.h"
+#include "hci_control_api.h"
+#include "bulk_xfer.h"
+
+/******************************************************
+ *                 Type Definitions
+ ******************************************************/
+typedef struct
+{
+    bulk_xfer_t xfer;
+    uint16_t    local_cid;          /* channel of the running transfer */
+    uint8_t     direction;          /* LE_COC_BULK_SENT or LE_COC_BULK_RECEIVED */
+    uint32_t    sink_id;            /* last transfer received, resumed from sink_offset */
+    uint32_t    sink_length;
+    uint32_t    sink_offset;
+} le_coc_bulk_t;
+
+/******************************************************
+ *               Function Declarations
+ ******************************************************/
+static wiced_bool_t le_coc_bulk_send_frame(void *p_context, uint8_t *p_frame, uint16_t len);
+static uint32_t     le_coc_bulk_sink_open(void *p_context, uint32_t xfer_id, uint32_t length);
+static wiced_bool_t le_coc_bulk_sink_write(void *p_context, uint32_t offset, const uint8_t *p_data, uint16_t len);
+static void         le_coc_bulk_sink_close(void *p_context, uint8_t status, uint32_t offset);
+static wiced_bool_t le_coc_bulk_pattern_read(void *p_context, uint32_t offset, uint8_t *p_buf, uint16_t len);
+static void         le_coc_bulk_pattern_done(void *p_context, uint8_t status, uint32_t offset);
+
+/******************************************************
+ *               Variable Definitions
+ ******************************************************/
+static le_coc_bulk_t le_coc_bulk;
+static wiced_bool_t  le_coc_bulk_initialized;
+
+/* CID (2), offset (4), then the data */
+static uint8_t le_coc_bulk_evt[2 + 4 + BULK_XFER_MAX_CHUNK_LEN];
+
+static const bulk_xfer_sink_t le_coc_bulk_sink =
+{
+    .p_open  = le_coc_bulk_sink_open,
+    .p_write = le_coc_bulk_sink_write,
+    .p_close = le_coc_bulk_sink_close,
+};
+
+static const bulk_xfer_source_t le_coc_bulk_pattern =
+{
+    .p_read = le_coc_bulk_pattern_read,
+    .p_done = le_coc_bulk_pattern_done,
+};
+
+/******************************************************
+ *               Function Definitions
+ ******************************************************/
+static void le_coc_bulk_init(void)
+{
+    if (le_coc_bulk_initialized)
+        return;
+
+    bulk_xfer_init(&le_coc_bulk.xfer, le_coc_bulk_send_frame, NULL, &le_coc_bulk_sink, NULL);
+    le_coc_bulk.local_cid   = LE_COC_INVALID_CID;
+    le_coc_bulk_initialized = WICED_TRUE;
+}
+
+/*
+ * Frames are sent only while the channel has credits and nothing queued,
+ * the protocol window bounds what is in flight, not the application TX queue.
+ */
+static wiced_bool_t le_coc_bulk_send_frame(void *p_context, uint8_t *p_frame, uint16_t len)
+{
+    le_coc_chan_t *p_chan = le_coc_find_chan(le_coc_bulk.local_cid);
+
+    if ((p_chan == NULL) || p_chan->congested || (p_chan->tx_queue.count != 0))
+        return WICED_FALSE;
+
+    return le_coc_send_data(p_chan->local_cid, p_frame, len) != L2CAP_DATAWRITE_FAILED;
+}
+
+static void le_coc_bulk_report(uint8_t status, uint32_t xfer_id, uint32_t offset)
+{
+    uint8_t evt[2 + 1 + 1 + 4 + 4], *p = evt;
+
+    UINT16_TO_STREAM(p, le_coc_bulk.local_cid);
+    UINT8_TO_STREAM(p, le_coc_bulk.direction);
+    UINT8_TO_STREAM(p, status);
+    UINT32_TO_STREAM(p, xfer_id);
+    UINT32_TO_STREAM(p, offset);
+
+    le_coc_send_to_client_control(HCI_CONTROL_LE_COC_EVENT_BULK_STATUS, evt, sizeof(evt));
+}
+
+/* A transfer of the same id and length resumes where the forwarding stopped */
+static uint32_t le_coc_bulk_sink_open(void *p_context, uint32_t xfer_id, uint32_t length)
+{
+    if ((xfer_id != le_coc_bulk.sink_id) || (length != le_coc_bulk.sink_length))
+    {
+        le_coc_bulk.sink_id     = xfer_id;
+        le_coc_bulk.sink_length = length;
+        le_coc_bulk.sink_offset = 0;
+    }
+    le_coc_bulk.direction = LE_COC_BULK_RECEIVED;
+    return le_coc_bulk.sink_offset;
+}
+
+static wiced_bool_t le_coc_bulk_sink_write(void *p_context, uint32_t offset, const uint8_t *p_data, uint16_t len)
+{
+    uint8_t *p = le_coc_bulk_evt;
+
+    UINT16_TO_STREAM(p, le_coc_bulk.local_cid);
+    UINT32_TO_STREAM(p, offset);
+    memcpy(p, p_data, len);
+
+    if (le_coc_send_to_client_control(HCI_CONTROL_LE_COC_EVENT_BULK_DATA, le_coc_bulk_evt, 2 + 4 + len) != WICED_SUCCESS)
+        return WICED_FALSE;
+
+    le_coc_bulk.sink_offset = offset + len;
+    return WICED_TRUE;
+}
+
+static void le_coc_bulk_sink_close(void *p_context, uint8_t status, uint32_t offset)
+{
+    le_coc_bulk_report(status, le_coc_bulk.sink_id, offset);
+
+    /* Nothing left to resume */
+    if (status == BULK_XFER_STATUS_OK)
+        le_coc_bulk.sink_id = le_coc_bulk.sink_length = le_coc_bulk.sink_offset = 0;
+}
+
+static wiced_bool_t le_coc_bulk_pattern_read(void *p_context, uint32_t offset, uint8_t *p_buf, uint16_t len)
+{
+    uint32_t xfer_id = le_coc_bulk.xfer.xfer_id;
+
+    while (len--)
+    {
+        *p_buf++ = (uint8_t)(offset ^ (offset >> 8) ^ xfer_id);
+        offset++;
+    }
+    return WICED_TRUE;
+}
+
+static void le_coc_bulk_pattern_done(void *p_context, uint8_t status, uint32_t offset)
+{
+    le_coc_bulk_report(status, le_coc_bulk.xfer.xfer_id, offset);
+}
+
+/*
+ * Handle HCI_CONTROL_LE_COC_COMMAND_BULK_SEND
+ * payload: CID (2), transfer id (4), length (4), chunk length (2), window (1)
+ */
+uint8_t le_coc_bulk_send(uint8_t *p_data, uint32_t data_len)
+{
+    le_coc_chan_t *p_chan;
+    uint32_t xfer_id, length;
+    uint16_t local_cid, chunk_len;
+    uint8_t window;
+
+    if (data_len != 13)
+        return HCI_CONTROL_STATUS_INVALID_ARGS;
+
+    STREAM_TO_UINT16(local_cid, p_data);
+    STREAM_TO_UINT32(xfer_id, p_data);
+    STREAM_TO_UINT32(length, p_data);
+    STREAM_TO_UINT16(chunk_len, p_data);
+    STREAM_TO_UINT8(window, p_data);
+
+    if ((chunk_len == 0) || (window == 0))
+        return HCI_CONTROL_STATUS_INVALID_ARGS;
+
+    le_coc_bulk_init();
+
+    if (((p_chan = le_coc_find_chan(local_cid)) == NULL) || bulk_xfer_active(&le_coc_bulk.xfer))
+        return HCI_CONTROL_STATUS_WRONG_STATE;
+
+    /* Every frame has to fit in one SDU of the peer */
+    if ((p_chan->peer_mtu != 0) && (chunk_len > p_chan->peer_mtu - BULK_XFER_DATA_HDR_LEN))
+        chunk_len = p_chan->peer_mtu - BULK_XFER_DATA_HDR_LEN;
+
+    le_coc_bulk.local_cid = local_cid;
+    le_coc_bulk.direction = LE_COC_BULK_SENT;
+
+    WICED_BT_TRACE("[%s] CID %d id 0x%x length %d chunk %d\r\n", __func__, local_cid, xfer_id, length, chunk_len);
+
+    bulk_xfer_send(&le_coc_bulk.xfer, &le_coc_bulk_pattern, NULL, xfer_id, length, chunk_len, window);
+    return HCI_CONTROL_STATUS_SUCCESS;
+}
+
+void le_coc_bulk_abort(void)
+{
+    if (le_coc_bulk_initialized)
+        bulk_xfer_abort(&le_coc_bulk.xfer, BULK_XFER_STATUS_ABORTED);
+}
+
+/* Returns WICED_TRUE if a transfer is running on the channel */
+wiced_bool_t le_coc_bulk_active(le_coc_chan_t *p_chan)
+{
+    return le_coc_bulk_initialized && bulk_xfer_active(&le_coc_bulk.xfer) && (p_chan->local_cid == le_coc_bulk.local_cid);
+}
+
+/* Called whenever the channel may accept more data */
+void le_coc_bulk_tx_ready(le_coc_chan_t *p_chan)
+{
+    if (le_coc_bulk_initialized && (p_chan->local_cid == le_coc_bulk.local_cid))
+        bulk_xfer_tx_ready(&le_coc_bulk.xfer);
+}
+
+/*
+ * Called for every SDU received on a channel. Returns WICED_TRUE if the SDU
+ * was a bulk transfer frame and was consumed. Frames on another channel than
+ * the one of the running transfer are left to the client control.
+ */
+wiced_bool_t le_coc_bulk_rx(le_coc_chan_t *p_chan, uint8_t *p_data, uint16_t len)
+{
+    le_coc_bulk_init();
+
+    if (p_chan->local_cid != le_coc_bulk.local_cid)
+    {
+        if (bulk_xfer_active(&le_coc_bulk.xfer))
+            return WICED_FALSE;
+        le_coc_bulk.local_cid = p_chan->local_cid;
+    }
+
+    return bulk_xfer_rx(&le_coc_bulk.xfer, p_data, len);
+}
+
+/* Stop the transfer if its channel goes away, a received one can be resumed */
+void le_coc_bulk_chan_closed(uint16_t local_cid)
+{
+    if (le_coc_bulk_initialized && (local_cid == le_coc_bulk.local_cid))
+    {
+        bulk_xfer_abort(&le_coc_bulk.xfer, BULK_XFER_STATUS_CHANNEL);
+        le_coc_bulk.local_cid = LE_COC_INVALID_CID;
+    }
+}
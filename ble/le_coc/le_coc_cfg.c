@@ -41,6 +41,7 @@
 #include "wiced_bt_gatt.h"
 #include "wiced_bt_cfg.h"
 #include "le_coc.h"
+#include "bond_store.h"
 
 /*****************************************************************************
  * wiced_bt core stack configuration
@@ -142,7 +143,7 @@ const wiced_bt_cfg_settings_t wiced_bt_cfg_settings =
 
     .l2cap_application =                                            /* Application managed l2cap protocol configuration */
     {
-        .max_links                      = 2,                                                           /**< Maximum number of application-managed l2cap links (BR/EDR and LE) */
+        .max_links                      = 3,                                                           /**< Maximum number of application-managed l2cap links (BR/EDR and LE) */
 
         /* BR EDR l2cap configuration */
         .max_psm                        = 0,                                                           /**< Maximum number of application-managed BR/EDR PSMs */
@@ -150,7 +151,7 @@ const wiced_bt_cfg_settings_t wiced_bt_cfg_settings =
 
         /* LE L2cap connection-oriented channels configuration */
         .max_le_psm                     = 2,                                                           /**< Maximum number of application-managed LE PSMs */
-        .max_le_channels                = 2,                                                           /**< Maximum number of application-managed LE channels */
+        .max_le_channels                = LE_COC_MAX_CHANNELS,                                         /**< Maximum number of application-managed LE channels */
 #if !defined(CYW20706A2)
         /* LE L2cap fixed channel configuration */
         .max_le_l2cap_fixed_channels    = 1                                                            /**< Maximum number of application managed fixed channels supported (in addition to mandatory channels 4, 5 and 6). > */
@@ -173,7 +174,7 @@ const wiced_bt_cfg_settings_t wiced_bt_cfg_settings =
     },
 
     /* LE Address Resolution DB size  */
-    .addr_resolution_db_size            = 5,                                                           /**< LE Address Resolution DB settings - effective only for pre 4.2 controller*/
+    .addr_resolution_db_size            = BOND_STORE_ADDR_RESOLUTION_DB_SIZE,                          /**< LE Address Resolution DB settings - effective only for pre 4.2 controller*/
 
 #ifdef CYW20706A2
     .max_mtu_size                       = 256,                                                         /**< Maximum MTU size for GATT connections, should be between 23 and (max_attr_len + 5) */
@@ -209,3 +210,35 @@ const wiced_bt_cfg_buf_pool_t wiced_bt_cfg_buf_pools[WICED_BT_CFG_NUM_BUF_POOLS]
         { 512+64, 5},      /* Large Buffer Pool  (used for HCI ACL messages) */
         { 700, 2}       /* Extra Large Buffer Pool - Used for avdt media packets and miscellaneous (if not needed, set buf_count to 0) */
     };
+
+/*****************************************************************************
+ * Transport buffer pool used to forward received LE COC data to the host
+ *
+ * Each buffer must hold one SDU of the local MTU. More buffers allow deeper RX
+ * bursts at the cost of RAM. Can be changed at runtime with
+ * HCI_CONTROL_LE_COC_COMMAND_SET_RX_POOL while no channel is open.
+ *****************************************************************************/
+const le_coc_rx_pool_cfg_t le_coc_rx_pool_cfg =
+{
+    .buffer_size  = 0,                      /* 0: local MTU + LE_COC_RX_POOL_HEADROOM */
+    .buffer_count = 5
+};
+
+/*****************************************************************************
+ * Link profiles selectable with HCI_CONTROL_LE_COC_COMMAND_SET_LINK_PROFILE
+ *
+ * The selected profile is requested for the link of every open channel and
+ * again whenever a new channel opens. The peer may reject or adjust any of
+ * the requested values.
+ *****************************************************************************/
+const le_coc_link_profile_t le_coc_link_profiles[LE_COC_LINK_PROFILE_MAX] =
+{
+    /* LE_COC_LINK_PROFILE_DEFAULT */
+    { 0, 0, 0, 0, 0, 0 },
+
+    /* LE_COC_LINK_PROFILE_BULK: 7.5 - 15 ms interval, no latency, 251 byte PDUs, 2M PHY */
+    { 6, 12, 0, 500, 251, BTM_BLE_PREFER_2M_PHY },
+
+    /* LE_COC_LINK_PROFILE_LOW_POWER: 100 - 125 ms interval, 4 events latency, 1M PHY */
+    { 80, 100, 4, 600, 0, BTM_BLE_PREFER_1M_PHY },
+};
@@ -0,0 +1,575 @@
+#!/usr/bin/env python3
+#
+# Copyright 2016-2020, Cypress Semiconductor Corporation or a subsidiary of
+# Cypress Semiconductor Corporation. All Rights Reserved.
+#
+# This software, including source code, documentation and related
+# materials ("Software"), is owned by Cypress Semiconductor Corporation
+# or one of its subsidiaries ("Cypress") and is protected by and subject to
+# worldwide patent protection (United States and foreign),
+# United States copyright laws and international treaty provisions.
+# Therefore, you may use this Software only as provided in the license
+# agreement accompanying the software package from which you
+# obtained this Software ("EULA").
+# If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+# non-transferable license to copy, modify, and compile the Software
+# source code solely for use in connection with Cypress's
+# integrated circuit products. Any reproduction, modification, translation,
+# compilation, or representation of this Software except as specified
+# above is prohibited without the express written permission of Cypress.
+#
+# Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+# EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+# WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+# reserves the right to make changes to the Software without notice. Cypress
+# does not assume any liability arising out of the application or use of the
+# Software or any product or circuit described in the Software. Cypress does
+# not authorize its products for use in any products where a malfunction or
+# failure of the Cypress product may reasonably be expected to result in
+# significant property damage, injury or death ("High Risk Product"). By
+# including Cypress's product in a High Risk Product, the manufacturer
+# of such system or application assumes all risk of such use and in doing
+# so agrees to indemnify Cypress against all liability.
+#
+
+"""
+Benchmark workloads for the BLE examples, driven over WICED HCI.
+
+Each workload talks to one board over its HCI UART, uses the commands and
+events the application already has, and returns a result with a flat
+dictionary of metrics. A suite file lists the workloads to run, the
+results are written as one JSON report, and two reports are compared to
+catch regressions between SDK drops. See read_me.txt.
+
+The opcodes are not repeated here, they are read from the headers: the
+hci_control_api.h of the SDK and the definitions of the applications and
+of ble/common.
+"""
+
+import argparse
+import json
+import os
+import re
+import struct
+import sys
+import time
+
+TOOL_VERSION = 1
+
+WICED_HCI_PACKET = 0x19
+WICED_HCI_HDR_LEN = 5           # packet type, opcode (uint16), length (uint16)
+
+BLE_DIR = os.path.normpath(os.path.join(os.path.dirname(os.path.abspath(__file__)), '..', '..'))
+
+# Files of the tree with opcode definitions, on top of the SDK header
+TREE_HEADERS = [
+    'common/app_stats.h',
+    'common/buf_pool_stats.h',
+    'common/latency_probe.h',
+    'common/conn_timing.h',
+    'le_coc/le_coc.h',
+    'hello_client/hello_client.c',
+    'hrc/hrc.c',
+]
+
+# Values of the tree the workloads need besides the opcodes
+LE_COC_BENCH_MODES = {'tx': 1, 'rx': 2, 'echo': 3}
+CONN_TIMING_STAGE_CONNECTED = 0
+CONN_TIMING_STAGE_ENCRYPTED = 1
+CONN_TIMING_NONE = 0xFFFFFFFF
+HCI_CONTROL_STATUS_SUCCESS = 0
+
+
+class BenchError(Exception):
+    pass
+
+
+#
+# Opcodes
+#
+
+class Opcodes(object):
+    """#define NAME value of the headers, evaluated on demand."""
+
+    DEFINE = re.compile(r'^\s*#\s*define\s+(HCI_CONTROL_\w+)\s+(.+?)\s*(?:/\*.*)?$')
+    SAFE = re.compile(r'^[\s0-9a-fA-FxX()<>|+]*$')
+
+    def __init__(self, headers):
+        self.exprs = {}
+        for path in headers:
+            with open(path) as f:
+                for line in f:
+                    m = self.DEFINE.match(line)
+                    if m and m.group(1) not in self.exprs:
+                        self.exprs[m.group(1)] = m.group(2)
+        self.values = {}
+
+    def __getitem__(self, name):
+        if name not in self.values:
+            if name not in self.exprs:
+                raise BenchError('%s not defined in the headers, check --sdk-include' % name)
+            expr = re.sub(r'\b(HCI_CONTROL_\w+)\b', lambda m: str(self[m.group(1)]), self.exprs[name])
+            if not self.SAFE.match(expr):
+                raise BenchError('cannot evaluate %s = %s' % (name, self.exprs[name]))
+            self.values[name] = eval(expr, {'__builtins__': {}})
+        return self.values[name]
+
+
+def find_sdk_header(sdk_include):
+    candidates = []
+    if sdk_include:
+        candidates.append(sdk_include)
+    if os.environ.get('CY_SHARED_PATH'):
+        candidates.append(os.path.join(os.environ['CY_SHARED_PATH'], 'dev-kit', 'btsdk-include'))
+    candidates.append(os.path.join(BLE_DIR, '..', '..', 'wiced_btsdk', 'dev-kit', 'btsdk-include'))
+    for path in candidates:
+        header = path if path.endswith('.h') else os.path.join(path, 'hci_control_api.h')
+        if os.path.isfile(header):
+            return header
+    raise BenchError('hci_control_api.h not found, give the btsdk-include folder with --sdk-include')
+
+
+#
+# WICED HCI transport
+#
+
+class Device(object):
+    """One board on its HCI UART."""
+
+    def __init__(self, port, baud, ops):
+        try:
+            import serial
+        except ImportError:
+            raise BenchError('pyserial is needed: pip install pyserial')
+        self.ser = serial.Serial(port, baud, timeout=0.05, rtscts=True)
+        self.ops = ops
+        self.rx = bytearray()
+        self.pending = []
+
+    def close(self):
+        self.ser.close()
+
+    def send(self, name, payload=b''):
+        opcode = self.ops[name]
+        self.ser.write(struct.pack('<BHH', WICED_HCI_PACKET, opcode, len(payload)) + payload)
+
+    def _read_event(self, timeout):
+        deadline = time.monotonic() + timeout
+        while True:
+            while len(self.rx) >= WICED_HCI_HDR_LEN:
+                if self.rx[0] != WICED_HCI_PACKET:
+                    # out of sync or another packet type, drop a byte
+                    del self.rx[0]
+                    continue
+                _, opcode, length = struct.unpack_from('<BHH', self.rx)
+                if len(self.rx) < WICED_HCI_HDR_LEN + length:
+                    break
+                payload = bytes(self.rx[WICED_HCI_HDR_LEN:WICED_HCI_HDR_LEN + length])
+                del self.rx[:WICED_HCI_HDR_LEN + length]
+                return opcode, payload, time.monotonic()
+            if time.monotonic() >= deadline:
+                return None
+            self.rx += self.ser.read(max(1, self.ser.in_waiting))
+
+    def events(self, timeout):
+        """Events received within timeout seconds, (opcode, payload, host time)."""
+        deadline = time.monotonic() + timeout
+        while self.pending:
+            yield self.pending.pop(0)
+        while True:
+            left = deadline - time.monotonic()
+            if left <= 0:
+                return
+            event = self._read_event(left)
+            if event is None:
+                return
+            yield event
+
+    def wait(self, names, timeout, match=None):
+        """First event of one of the names, the others are kept for later."""
+        wanted = set(self.ops[n] for n in names)
+        skipped = []
+        found = None
+        for event in self.events(timeout):
+            if event[0] in wanted and (match is None or match(event[1])):
+                found = event
+                break
+            skipped.append(event)
+        self.pending = skipped + self.pending
+        return found
+
+    def command(self, name, payload=b'', timeout=2.0):
+        """Send a command and wait for its HCI_CONTROL_EVENT_COMMAND_STATUS."""
+        self.send(name, payload)
+        event = self.wait(['HCI_CONTROL_EVENT_COMMAND_STATUS'], timeout)
+        if event is None:
+            raise BenchError('%s: no command status' % name)
+        if event[1][:1] != bytes([HCI_CONTROL_STATUS_SUCCESS]):
+            raise BenchError('%s: status %d' % (name, event[1][0]))
+
+
+def bda_to_wire(bda):
+    """aa:bb:cc:dd:ee:ff as sent by BDADDR_TO_STREAM, least significant byte first."""
+    return bytes(reversed(bytes.fromhex(bda.replace(':', ''))))
+
+
+def bda_from_wire(data):
+    return ':'.join('%02x' % b for b in reversed(data[:6]))
+
+
+#
+# Statistics
+#
+
+def summary(values, prefix, unit):
+    """min, avg, median, p90 and max of the samples, under prefix_xx_unit names."""
+    metrics = {prefix + '_samples': len(values)}
+    if not values:
+        return metrics
+    values = sorted(values)
+    n = len(values)
+    metrics[prefix + '_min_' + unit] = values[0]
+    metrics[prefix + '_avg_' + unit] = int(sum(values) / n)
+    metrics[prefix + '_median_' + unit] = values[n // 2]
+    metrics[prefix + '_p90_' + unit] = values[min(n - 1, (n * 9) // 10)]
+    metrics[prefix + '_max_' + unit] = values[-1]
+    return metrics
+
+
+#
+# Workloads
+#
+
+def workload_le_coc(dev, params):
+    """
+    Throughput and round trip time of LE COC SDUs, le_coc benchmark mode.
+    The peer board runs le_coc in echo mode for the round trip time, or in
+    rx mode to measure the throughput alone.
+    """
+    mode = params.get('mode', 'tx')
+    sdu_len = int(params.get('sdu_len', 512))
+    duration = float(params.get('duration', 10))
+    interval = int(params.get('interval', 1))
+    cid = params.get('cid')
+
+    if params.get('link_profile') is not None:
+        dev.command('HCI_CONTROL_LE_COC_COMMAND_SET_LINK_PROFILE', bytes([int(params['link_profile'])]))
+
+    if cid is None:
+        if 'peer' not in params:
+            raise BenchError('le_coc: give the cid of a connected channel or the peer to connect')
+        dev.command('HCI_CONTROL_LE_COC_COMMAND_ENABLE_CID_EVENTS', b'\x01')
+        dev.command('HCI_CONTROL_LE_COC_COMMAND_CONNECT', bda_to_wire(params['peer']))
+        event = dev.wait(['HCI_CONTROL_LE_COC_EVENT_CHAN_CONNECTED'], float(params.get('connect_timeout', 10)))
+        if event is None:
+            raise BenchError('le_coc: no channel to %s' % params['peer'])
+        cid = struct.unpack_from('<H', event[1])[0]
+    cid = int(cid)
+
+    dev.command('HCI_CONTROL_LE_COC_COMMAND_BENCH_START',
+                struct.pack('<HBHB', cid, LE_COC_BENCH_MODES[mode], sdu_len, interval))
+
+    reports = []
+    report_op = dev.ops['HCI_CONTROL_LE_COC_EVENT_BENCH_REPORT']
+    for opcode, payload, _ in dev.events(duration):
+        if opcode == report_op and len(payload) >= 43:
+            fields = struct.unpack_from('<HB10I', payload)
+            if fields[0] == cid:
+                reports.append(fields[2:])
+    dev.command('HCI_CONTROL_LE_COC_COMMAND_BENCH_STOP')
+
+    if not reports:
+        raise BenchError('le_coc: no benchmark report')
+
+    # The rates are over the report interval, the first one covers the ramp up of the channel
+    intervals = [reports[0][0]] + [b[0] - a[0] for a, b in zip(reports, reports[1:])]
+    if len(reports) > 1:
+        reports, intervals = reports[1:], intervals[1:]
+    total_ms = float(sum(intervals)) or 1.0
+
+    def weighted(i):
+        return int(sum(r[i] * t for r, t in zip(reports, intervals)) / total_ms)
+
+    rtt = [r for r in reports if r[9] != 0]
+    rtt_samples = sum(r[9] for r in rtt)
+    metrics = {
+        'tx_bytes_per_s': weighted(1),
+        'tx_sdus_per_s': weighted(2),
+        'rx_bytes_per_s': weighted(3),
+        'rx_sdus_per_s': weighted(4),
+        'lost_sdus': reports[-1][5],
+        'rtt_samples': rtt_samples,
+    }
+    if rtt_samples:
+        metrics['rtt_min_us'] = min(r[6] for r in rtt)
+        metrics['rtt_avg_us'] = int(sum(r[7] * r[9] for r in rtt) / rtt_samples)
+        metrics['rtt_max_us'] = max(r[8] for r in rtt)
+    return metrics, {'cid': cid, 'reports': len(reports)}
+
+
+def workload_notify(dev, params):
+    """
+    Rate of the GATT notifications received by a client from its servers:
+    hello_client from hello_sensor, or hrc from hrs.
+    """
+    app = params.get('app', 'hello_client')
+    duration = float(params.get('duration', 10))
+
+    if app == 'hello_client':
+        dev.command('HCI_CONTROL_LE_COMMAND_RESET_PEER_STATS')
+        start = time.monotonic()
+        for _ in dev.events(duration):
+            pass
+        dev.send('HCI_CONTROL_LE_COMMAND_READ_PEER_STATS')
+        elapsed = time.monotonic() - start
+        peers = {}
+        stats_op = dev.ops['HCI_CONTROL_LE_EVENT_PEER_STATS']
+        for opcode, payload, _ in dev.events(1.0):
+            if opcode == stats_op and len(payload) >= 24:
+                notifications, indications, nbytes, gaps = struct.unpack_from('<4I', payload, 8)
+                peers[bda_from_wire(payload)] = (notifications, nbytes, gaps)
+        if not peers:
+            raise BenchError('notify: no connected sensor')
+        metrics = {
+            'peers': len(peers),
+            'notifications_per_s': round(sum(p[0] for p in peers.values()) / elapsed, 2),
+            'bytes_per_s': round(sum(p[1] for p in peers.values()) / elapsed, 2),
+            'gaps': sum(p[2] for p in peers.values()),
+        }
+        details = {bda: {'notifications': n, 'bytes': b, 'gaps': g} for bda, (n, b, g) in peers.items()}
+        return metrics, {'peers': details}
+
+    if app == 'hrc':
+        single_op = dev.ops['HCI_CONTROL_HRC_EVENT_MEASUREMENT']
+        batch_op = dev.ops['HCI_CONTROL_HRC_EVENT_MEASUREMENTS']
+        count = 0
+        servers = set()
+        start = time.monotonic()
+        for opcode, payload, _ in dev.events(duration):
+            if opcode == single_op and payload:
+                count += 1
+                servers.add(payload[0])
+            elif opcode == batch_op and len(payload) >= 5:
+                offset = 5
+                # entries have a variable length, the index is enough for the server count.
+                # A truncated batch counts the entries read up to the cut.
+                for _ in range(payload[4]):
+                    if offset + 6 > len(payload):
+                        break
+                    servers.add(payload[offset])
+                    flags = payload[offset + 3]
+                    offset += 6
+                    if flags & 0x08:
+                        offset += 2
+                    if flags & 0x10:
+                        if offset >= len(payload):
+                            break
+                        offset += 1 + 2 * payload[offset]
+                    if offset > len(payload):
+                        break
+                    count += 1
+        elapsed = time.monotonic() - start
+        if count == 0:
+            raise BenchError('notify: no measurement from hrs')
+        return {'peers': len(servers), 'notifications_per_s': round(count / elapsed, 2)}, {}
+
+    raise BenchError('notify: unknown app %s' % app)
+
+
+def workload_connect(dev, params):
+    """
+    Scan to connection time and reconnection time with bonded keys, from the
+    HCI_CONTROL_MISC_EVENT_CONN_TIMING events of hello_client or hrc. Each
+    cycle disconnects the peer and scans for it again. The first connection
+    pairs when the peer is not bonded yet, it is reported apart.
+    """
+    peer = params['peer'].lower()
+    cycles = int(params.get('cycles', 10))
+    timeout = float(params.get('timeout', 15))
+    settle = float(params.get('settle', 1.0))
+
+    def for_peer(payload):
+        return bda_from_wire(payload) == peer
+
+    scan_to_connect = []
+    bonded_from_scan = []
+    bonded_from_connect = []
+    pairing = []
+    failures = 0
+
+    for cycle in range(cycles + 1):
+        dev.command('HCI_CONTROL_LE_COMMAND_SCAN', b'\x01')
+        stages = {}
+        deadline = time.monotonic() + timeout
+        while len(stages) < 2 and time.monotonic() < deadline:
+            event = dev.wait(['HCI_CONTROL_MISC_EVENT_CONN_TIMING'], deadline - time.monotonic(), for_peer)
+            if event is None:
+                break
+            stage, bonded, status, from_scan, from_connect = struct.unpack_from('<BBBII', event[1], 6)
+            stages[stage] = (bonded, status, from_scan, from_connect)
+
+        if CONN_TIMING_STAGE_ENCRYPTED not in stages or stages[CONN_TIMING_STAGE_ENCRYPTED][1] != 0:
+            failures += 1
+        else:
+            bonded, _, from_scan, from_connect = stages[CONN_TIMING_STAGE_ENCRYPTED]
+            if not bonded:
+                pairing.append(from_scan if from_scan != CONN_TIMING_NONE else from_connect)
+            else:
+                if from_scan != CONN_TIMING_NONE:
+                    bonded_from_scan.append(from_scan)
+                if from_connect != CONN_TIMING_NONE:
+                    bonded_from_connect.append(from_connect)
+        if CONN_TIMING_STAGE_CONNECTED in stages and stages[CONN_TIMING_STAGE_CONNECTED][2] != CONN_TIMING_NONE:
+            scan_to_connect.append(stages[CONN_TIMING_STAGE_CONNECTED][2])
+
+        if cycle == cycles:
+            break
+        if CONN_TIMING_STAGE_CONNECTED in stages:
+            dev.command('HCI_CONTROL_LE_COMMAND_DISCONNECT', bda_to_wire(peer))
+        time.sleep(settle)
+
+    if not scan_to_connect:
+        raise BenchError('connect: %s never connected' % peer)
+
+    metrics = {'failures': failures}
+    metrics.update(summary(scan_to_connect, 'scan_to_connect', 'us'))
+    metrics.update(summary(bonded_from_scan, 'reconnect_from_scan', 'us'))
+    metrics.update(summary(bonded_from_connect, 'reconnect_from_connect', 'us'))
+    if pairing:
+        metrics['pairing_us'] = pairing[0]
+    return metrics, {}
+
+
+WORKLOADS = {
+    'le_coc': workload_le_coc,
+    'notify': workload_notify,
+    'connect': workload_connect,
+}
+
+
+#
+# Suites and reports
+#
+
+def run_suite(suite, ops, baud):
+    results = []
+    names = set()
+    for entry in suite['workloads']:
+        params = dict(entry)
+        kind = params.pop('workload')
+        name = params.pop('name', kind)
+        # compare() matches the results by name
+        if name in names:
+            name = '%s_%d' % (name, len(results))
+        names.add(name)
+        port = params.pop('port')
+        result = {'name': name, 'workload': kind, 'params': params}
+        print('%s: %s on %s' % (name, kind, port), file=sys.stderr)
+        dev = None
+        try:
+            if kind not in WORKLOADS:
+                raise BenchError('unknown workload %s' % kind)
+            dev = Device(port, int(params.pop('baud', baud)), ops)
+            metrics, details = WORKLOADS[kind](dev, params)
+            result.update({'status': 'ok', 'metrics': metrics, 'details': details})
+        except BenchError as e:
+            result.update({'status': 'error', 'error': str(e)})
+        finally:
+            if dev is not None:
+                dev.close()
+        print('  %s' % json.dumps(result.get('metrics', result.get('error'))), file=sys.stderr)
+        results.append(result)
+
+    return {
+        'tool': 'ble_bench',
+        'version': TOOL_VERSION,
+        'suite': suite.get('name', ''),
+        'sdk': suite.get('sdk', ''),
+        'started': time.strftime('%Y-%m-%dT%H:%M:%S%z'),
+        'results': results,
+    }
+
+
+def higher_is_better(metric):
+    return metric.endswith('_per_s')
+
+
+def lower_is_better(metric):
+    return metric.endswith('_us') or metric in ('failures', 'lost_sdus', 'gaps')
+
+
+def compare(baseline, current, tolerance):
+    """Metrics worse than the baseline by more than tolerance percent."""
+    regressions = []
+    base = {r['name']: r for r in baseline['results'] if r.get('status') == 'ok'}
+    for result in current['results']:
+        if result['name'] not in base:
+            continue
+        if result.get('status') != 'ok':
+            regressions.append({'name': result['name'], 'metric': 'status', 'error': result.get('error')})
+            continue
+        old = base[result['name']]['metrics']
+        for metric, value in sorted(result['metrics'].items()):
+            if metric not in old or not isinstance(value, (int, float)):
+                continue
+            ref = old[metric]
+            if higher_is_better(metric):
+                worse = value < ref * (1 - tolerance / 100.0)
+            elif lower_is_better(metric):
+                worse = value > ref * (1 + tolerance / 100.0) if ref else value > 0
+            else:
+                continue
+            if worse:
+                regressions.append({'name': result['name'], 'metric': metric, 'baseline': ref, 'current': value})
+    return regressions
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Benchmark workloads of the BLE examples over WICED HCI')
+    sub = parser.add_subparsers(dest='cmd')
+
+    run = sub.add_parser('run', help='run a suite and write its report')
+    run.add_argument('suite', help='suite file, JSON')
+    run.add_argument('-o', '--output', help='report file, standard output by default')
+    run.add_argument('--sdk-include', help='btsdk-include folder, or its hci_control_api.h')
+    run.add_argument('--baud', type=int, default=3000000, help='HCI UART baud rate (default 3000000)')
+
+    cmp_ = sub.add_parser('compare', help='list the regressions of a report against a baseline')
+    cmp_.add_argument('baseline')
+    cmp_.add_argument('current')
+    cmp_.add_argument('--tolerance', type=float, default=10.0, help='percent (default 10)')
+
+    args = parser.parse_args()
+
+    try:
+        if args.cmd == 'run':
+            ops = Opcodes([find_sdk_header(args.sdk_include)] +
+                          [os.path.join(BLE_DIR, h) for h in TREE_HEADERS])
+            with open(args.suite) as f:
+                report = run_suite(json.load(f), ops, args.baud)
+            text = json.dumps(report, indent=2, sort_keys=True)
+            if args.output:
+                with open(args.output, 'w') as f:
+                    f.write(text + '\n')
+            else:
+                print(text)
+            return 0 if all(r['status'] == 'ok' for r in report['results']) else 1
+
+        if args.cmd == 'compare':
+            with open(args.baseline) as f:
+                baseline = json.load(f)
+            with open(args.current) as f:
+                current = json.load(f)
+            regressions = compare(baseline, current, args.tolerance)
+            print(json.dumps({'tolerance': args.tolerance, 'regressions': regressions}, indent=2, sort_keys=True))
+            return 1 if regressions else 0
+    except BenchError as e:
+        print('ble_bench: %s' % e, file=sys.stderr)
+        return 2
+
+    parser.print_help()
+    return 2
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,359 @@
+#!/usr/bin/env python3
+#
+# Copyright 2016-2020, Cypress Semiconductor Corporation or a subsidiary of
+# Cypress Semiconductor Corporation. All Rights Reserved.
+#
+# This software, including source code, documentation and related
+# materials ("Software"), is owned by Cypress Semiconductor Corporation
+# or one of its subsidiaries ("Cypress") and is protected by and subject to
+# worldwide patent protection (United States and foreign),
+# United States copyright laws and international treaty provisions.
+# Therefore, you may use this Software only as provided in the license
+# agreement accompanying the software package from which you
+# obtained this Software ("EULA").
+# If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+# non-transferable license to copy, modify, and compile the Software
+# source code solely for use in connection with Cypress's
+# integrated circuit products. Any reproduction, modification, translation,
+# compilation, or representation of this Software except as specified
+# above is prohibited without the express written permission of Cypress.
+#
+# Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+# EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+# WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+# reserves the right to make changes to the Software without notice. Cypress
+# does not assume any liability arising out of the application or use of the
+# Software or any product or circuit described in the Software. Cypress does
+# not authorize its products for use in any products where a malfunction or
+# failure of the Cypress product may reasonably be expected to result in
+# significant property damage, injury or death ("High Risk Product"). By
+# including Cypress's product in a High Risk Product, the manufacturer
+# of such system or application assumes all risk of such use and in doing
+# so agrees to indemnify Cypress against all liability.
+#
+
+"""
+Code and RAM report of a BLE example, run by "make mem_report".
+
+The code, rodata, data and bss of each module come from the linker map of
+the last build, after the unused sections are dropped, or from the object
+files when there is no map. The buffer pools are not in the image, the
+stack and the transport allocate them at start, so they are read from the
+configuration in the sources of the application. The report is printed,
+written as JSON, and compared with a baseline report when there is one.
+"""
+
+import argparse
+import glob
+import json
+import os
+import re
+import subprocess
+import sys
+
+CLASSES = ('code', 'rodata', 'data', 'bss')
+
+
+class ReportError(Exception):
+    pass
+
+
+def section_class(name):
+    """code, rodata, data or bss of an input section, None for the others."""
+    if name.startswith('.text') or name.startswith('.init') or name.startswith('.fini'):
+        return 'code'
+    if name.startswith('.rodata') or name.startswith('.const'):
+        return 'rodata'
+    if name.startswith('.data') or name.startswith('.setup') or name.startswith('.ram'):
+        return 'data'
+    if name.startswith('.bss') or name == 'COMMON' or name.startswith('.noinit'):
+        return 'bss'
+    return None
+
+
+def module_name(path):
+    """Object file of a path, with the library of an archive member."""
+    m = re.match(r'(.*)\((.*)\)$', path)
+    if m:
+        return '%s(%s)' % (os.path.basename(m.group(1)), m.group(2))
+    return os.path.basename(path)
+
+
+def add(modules, module, cls, size):
+    sizes = modules.setdefault(module, dict((c, 0) for c in CLASSES))
+    sizes[cls] += size
+
+
+#
+# Modules
+#
+
+def modules_from_map(path):
+    """Sizes of the modules from the memory map part of a GNU ld map file."""
+    modules = {}
+    in_map = False
+    pending = None
+    entry = re.compile(r'^\s+(0x[0-9a-fA-F]+)\s+(0x[0-9a-fA-F]+)\s+(\S.*)$')
+
+    with open(path) as f:
+        for line in f:
+            if line.startswith('Linker script and memory map'):
+                in_map = True
+                continue
+            if not in_map:
+                continue
+            line = line.rstrip('\n')
+
+            # " .text.name  0xaddr  0xsize  file.o", or the name alone on its line when it is long
+            m = re.match(r'^ (\.\S+|COMMON)(?:\s+(0x[0-9a-fA-F]+)\s+(0x[0-9a-fA-F]+)\s+(\S.*))?$', line)
+            if m:
+                if m.group(2) is None:
+                    pending = m.group(1)
+                    continue
+                name, size, obj = m.group(1), int(m.group(3), 16), m.group(4)
+            elif pending is not None:
+                m = entry.match(line)
+                pending, name = None, pending
+                if not m:
+                    continue
+                size, obj = int(m.group(2), 16), m.group(3)
+            else:
+                continue
+
+            cls = section_class(name)
+            if cls is None or size == 0 or obj.startswith('*'):
+                continue
+            add(modules, module_name(obj.strip()), cls, size)
+    return modules
+
+
+def modules_from_objects(objects, size_tool):
+    """Sizes of the modules with size -A on each object file, before the unused sections are dropped."""
+    modules = {}
+    for obj in objects:
+        try:
+            out = subprocess.check_output([size_tool, '-A', obj], universal_newlines=True)
+        except (OSError, subprocess.CalledProcessError) as e:
+            raise ReportError('%s -A %s: %s' % (size_tool, obj, e))
+        for line in out.splitlines():
+            fields = line.split()
+            if len(fields) >= 2 and fields[1].isdigit():
+                cls = section_class(fields[0])
+                if cls is not None:
+                    add(modules, os.path.basename(obj), cls, int(fields[1]))
+    return modules
+
+
+def newest(paths):
+    return max(paths, key=os.path.getmtime) if paths else None
+
+
+#
+# Buffer pools
+#
+
+def strip_comments(text):
+    text = re.sub(r'/\*.*?\*/', ' ', text, flags=re.S)
+    return re.sub(r'//[^\n]*', ' ', text)
+
+
+class Defines(object):
+    """Integer #defines of the sources, the first definition wins as with #ifndef defaults."""
+
+    SAFE = re.compile(r'^[\s0-9()+\-*/<>|&xXa-fA-FuUlL]*$')
+
+    def __init__(self, files):
+        self.exprs = {}
+        for path in files:
+            with open(path, errors='replace') as f:
+                for line in f:
+                    m = re.match(r'^\s*#\s*define\s+(\w+)\s+([^/\n]+?)\s*(?:/[/*].*)?$', line)
+                    if m and m.group(1) not in self.exprs:
+                        self.exprs[m.group(1)] = m.group(2)
+
+    def value(self, expr, depth=0):
+        """Integer value of an expression, None when it cannot be resolved."""
+        if depth > 16:
+            return None
+        unresolved = []
+
+        def resolve(m):
+            name = m.group(0)
+            if re.match(r'^(0[xX][0-9a-fA-F]+|\d+)[uUlL]*$', name):
+                return name
+            if name in self.exprs:
+                v = self.value(self.exprs[name], depth + 1)
+                if v is not None:
+                    return str(v)
+            unresolved.append(name)
+            return '0'
+
+        text = re.sub(r'\b\w+\b', resolve, expr.strip())
+        text = re.sub(r'\b(0[xX][0-9a-fA-F]+|\d+)[uUlL]+\b', r'\1', text)
+        if unresolved or not self.SAFE.match(text):
+            return None
+        try:
+            return int(eval(text.replace('/', '//'), {'__builtins__': {}}))
+        except Exception:
+            return None
+
+
+def pool(name, where, size_expr, count_expr, defines):
+    size = defines.value(size_expr)
+    count = defines.value(count_expr)
+    entry = {'name': name, 'file': where, 'buffer_size': size if size is not None else size_expr.strip(),
+             'buffer_count': count if count is not None else count_expr.strip()}
+    if size == 0 and count:
+        entry['note'] = 'buffer size set at run time'
+    elif size == 0 and count == 0:
+        entry['note'] = 'default of the SDK'
+    if isinstance(size, int) and isinstance(count, int):
+        entry['bytes'] = size * count
+    return entry
+
+
+def pools_from_sources(sources, defines):
+    """Stack buffer pools and transport pools configured in the sources."""
+    pools = []
+    for path in sources:
+        with open(path, errors='replace') as f:
+            text = strip_comments(f.read())
+        where = os.path.basename(path)
+
+        # const wiced_bt_cfg_buf_pool_t name[N] = { { size, count }, ... };
+        for m in re.finditer(r'wiced_bt_cfg_buf_pool_t\s+(\w+)\s*\[[^\]]*\]\s*=\s*\{(.*?)\}\s*;', text, re.S):
+            for index, e in enumerate(re.finditer(r'\{\s*([^,{}]+?)\s*,\s*([^,{}]+?)\s*\}', m.group(2))):
+                pools.append(pool('%s[%d]' % (m.group(1), index), where, e.group(1), e.group(2), defines))
+
+        # designated initializers with buffer_size/buffer_count fields, rx_ and tx_ ones included
+        for m in re.finditer(r'(\w+)\s*=\s*\{([^{}]*)\}', text):
+            fields = dict(re.findall(r'\.(\w+)\s*=\s*([^,]+)', m.group(2)))
+            for prefix in ('', 'rx_', 'tx_'):
+                size_field, count_field = prefix + 'buffer_size', prefix + 'buffer_count'
+                if size_field in fields and count_field in fields:
+                    name = m.group(1) + ('.' + prefix.rstrip('_') if prefix else '')
+                    pools.append(pool(name, where, fields[size_field], fields[count_field], defines))
+    return pools
+
+
+#
+# Report
+#
+
+def totals(modules):
+    return dict((c, sum(m[c] for m in modules.values())) for c in CLASSES)
+
+
+def build_report(app, modules, pools, source):
+    total = totals(modules)
+    pool_bytes = sum(p.get('bytes', 0) for p in pools)
+    return {
+        'app': app,
+        'source': source,
+        'modules': modules,
+        'totals': total,
+        'flash': total['code'] + total['rodata'] + total['data'],
+        'ram': total['data'] + total['bss'],
+        'pools': pools,
+        'pool_bytes': pool_bytes,
+        'ram_with_pools': total['data'] + total['bss'] + pool_bytes,
+    }
+
+
+def delta(value, base):
+    d = value - base
+    return '%+d' % d if d else ''
+
+
+def print_report(report, baseline, out):
+    base_modules = baseline['modules'] if baseline else {}
+    names = sorted(set(report['modules']) | set(base_modules),
+                   key=lambda n: -sum(report['modules'].get(n, {}).get(c, 0) for c in CLASSES))
+    zero = dict((c, 0) for c in CLASSES)
+
+    out.write('%s, from %s\n\n' % (report['app'], report['source']))
+    out.write('%-36s %8s %8s %8s %8s' % ('module', 'code', 'rodata', 'data', 'bss'))
+    out.write('  %s\n' % ('delta vs baseline (code rodata data bss)' if baseline else ''))
+    for name in names:
+        cur = report['modules'].get(name, zero)
+        out.write('%-36s %8d %8d %8d %8d' % ((name[:36],) + tuple(cur[c] for c in CLASSES)))
+        if baseline:
+            old = base_modules.get(name, zero)
+            out.write('  %s' % ' '.join('%7s' % delta(cur[c], old[c]) for c in CLASSES))
+        out.write('\n')
+    t = report['totals']
+    out.write('%-36s %8d %8d %8d %8d' % (('total',) + tuple(t[c] for c in CLASSES)))
+    if baseline:
+        out.write('  %s' % ' '.join('%7s' % delta(t[c], baseline['totals'][c]) for c in CLASSES))
+    out.write('\n\n')
+
+    out.write('%-36s %8s %8s %8s\n' % ('buffer pool', 'size', 'count', 'bytes'))
+    for p in report['pools']:
+        out.write('%-36s %8s %8s %8s  %s\n' % (p['name'][:36], p['buffer_size'], p['buffer_count'],
+                                               p.get('bytes', '?'), p.get('note', p['file'])))
+    out.write('\n')
+
+    for key in ('flash', 'ram', 'pool_bytes', 'ram_with_pools'):
+        line = '%-36s %8d' % (key, report[key])
+        if baseline and key in baseline:
+            line += '  %s' % delta(report[key], baseline[key])
+        out.write(line + '\n')
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Code and RAM report of a BLE example')
+    parser.add_argument('--app', required=True, help='application name')
+    parser.add_argument('--build-dir', required=True, help='build output folder, searched for the map and the objects')
+    parser.add_argument('--src', action='append', default=[], help='folder with the configuration of the pools')
+    parser.add_argument('--include', action='append', default=[], help='folder with more #defines')
+    parser.add_argument('--size', default='arm-none-eabi-size', help='size tool, when there is no map')
+    parser.add_argument('--baseline', help='report to compare with, ignored when missing')
+    parser.add_argument('--output', help='JSON report to write')
+    parser.add_argument('--max-ram-growth', type=int, help='fail when ram_with_pools grew by more bytes than this')
+    args = parser.parse_args()
+
+    try:
+        maps = glob.glob(os.path.join(args.build_dir, '**', '*.map'), recursive=True)
+        app_maps = [m for m in maps if os.path.basename(m).startswith(args.app)]
+        map_file = newest(app_maps or maps)
+        if map_file:
+            modules, source = modules_from_map(map_file), map_file
+        else:
+            objects = glob.glob(os.path.join(args.build_dir, '**', '*.o'), recursive=True)
+            if not objects:
+                raise ReportError('no map and no object in %s, build the application first' % args.build_dir)
+            modules, source = modules_from_objects(objects, args.size), '%d objects' % len(objects)
+        if not modules:
+            raise ReportError('no section found in %s' % source)
+
+        sources = sorted(set(p for d in args.src for p in glob.glob(os.path.join(d, '*.c'))))
+        headers = sorted(set(p for d in args.src + args.include for p in glob.glob(os.path.join(d, '*.[ch]'))))
+        pools = pools_from_sources(sources, Defines(headers))
+
+        report = build_report(args.app, modules, pools, source)
+
+        baseline = None
+        if args.baseline and os.path.isfile(args.baseline):
+            with open(args.baseline) as f:
+                baseline = json.load(f)
+
+        print_report(report, baseline, sys.stdout)
+
+        if args.output:
+            with open(args.output, 'w') as f:
+                json.dump(report, f, indent=2, sort_keys=True)
+                f.write('\n')
+
+        if baseline and args.max_ram_growth is not None:
+            growth = report['ram_with_pools'] - baseline.get('ram_with_pools', 0)
+            if growth > args.max_ram_growth:
+                sys.stderr.write('mem_report: RAM grew by %d bytes, more than %d\n' % (growth, args.max_ram_growth))
+                return 1
+    except (ReportError, IOError, ValueError) as e:
+        sys.stderr.write('mem_report: %s\n' % e)
+        return 2
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())